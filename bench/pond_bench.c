@@ -0,0 +1,136 @@
+/*
+ * Compares reading a feed through libpond in-process with running the quacker CLI once
+ * per operation, which is what other programs had to do before the library existed.
+ *
+ * usage: pond_bench <database_filename> <user_id> <password> [iterations] [cli_path]
+ *
+ * The CLI run logs in (which loads the feed), logs out and exits. The in-process runs
+ * read a page of the same feed and fetch that page's quacks by ID in one call.
+ */
+#define _POSIX_C_SOURCE 200809L
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "pond_c.h"
+
+#define PAGE_SIZE 20
+#define TEXT_CAPACITY (64 * 1024)
+#define CLI_RUNS 10
+
+static double now_ms(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+/* Runs one CLI session with the given input; returns its exit status, or -1. */
+static int run_cli(const char* cli_path, const char* db_filename, const char* input) {
+  int in[2];
+  if (pipe(in) != 0) {
+    return -1;
+  }
+
+  pid_t pid = fork();
+  if (pid < 0) {
+    close(in[0]);
+    close(in[1]);
+    return -1;
+  }
+  if (pid == 0) {
+    int null = open("/dev/null", O_WRONLY);
+    dup2(in[0], STDIN_FILENO);
+    dup2(null, STDOUT_FILENO);
+    dup2(null, STDERR_FILENO);
+    close(in[0]);
+    close(in[1]);
+    execl(cli_path, cli_path, db_filename, (char*)NULL);
+    _exit(127);
+  }
+
+  close(in[0]);
+  ssize_t written = write(in[1], input, strlen(input));
+  close(in[1]);
+
+  int status = 0;
+  waitpid(pid, &status, 0);
+  return written < 0 || !WIFEXITED(status) ? -1 : WEXITSTATUS(status);
+}
+
+int main(int argc, char** argv) {
+  if (argc < 4) {
+    fprintf(stderr, "usage: %s <database_filename> <user_id> <password> [iterations] [cli_path]\n", argv[0]);
+    return 1;
+  }
+  const char* db_filename = argv[1];
+  const int32_t user_id = atoi(argv[2]);
+  const char* password = argv[3];
+  const int iterations = argc > 4 ? atoi(argv[4]) : 1000;
+  const char* cli_path = argc > 5 ? argv[5] : "build/quacker";
+
+  pond_handle* pond = NULL;
+  if (pond_open(db_filename, &pond) != POND_OK) {
+    fprintf(stderr, "Can't open %s\n", db_filename);
+    return 1;
+  }
+
+  static pond_feed_entry entries[PAGE_SIZE];
+  static pond_quack quacks[PAGE_SIZE];
+  static int32_t tids[PAGE_SIZE];
+  static char text[TEXT_CAPACITY];
+  size_t written = 0;
+  size_t total = 0;
+
+  // The first page pays for producing the feed; later pages come from the feed cache
+  double start = now_ms();
+  if (pond_get_feed_page(pond, user_id, POND_FEED_CHRONOLOGICAL, 0, PAGE_SIZE, entries, text, TEXT_CAPACITY, &written, &total) != POND_OK) {
+    fprintf(stderr, "Feed failed: %s\n", pond_last_error(pond));
+    pond_close(pond);
+    return 1;
+  }
+  const double first_page_ms = now_ms() - start;
+  const size_t pages = total / PAGE_SIZE + 1;
+
+  start = now_ms();
+  for (int i = 0; i < iterations; ++i) {
+    pond_get_feed_page(pond, user_id, POND_FEED_CHRONOLOGICAL, (i % pages) * PAGE_SIZE, PAGE_SIZE, entries, text, TEXT_CAPACITY, &written, NULL);
+  }
+  const double page_us = (now_ms() - start) * 1e3 / iterations;
+
+  pond_get_feed_page(pond, user_id, POND_FEED_CHRONOLOGICAL, 0, PAGE_SIZE, entries, text, TEXT_CAPACITY, &written, NULL);
+  for (size_t i = 0; i < written; ++i) {
+    tids[i] = entries[i].tid;
+  }
+  const size_t page_size = written;
+  start = now_ms();
+  for (int i = 0; i < iterations; ++i) {
+    pond_get_quacks(pond, tids, page_size, quacks, text, TEXT_CAPACITY, &written);
+  }
+  const double quacks_us = (now_ms() - start) * 1e3 / iterations;
+  pond_close(pond);
+
+  // Choose "Log in", log in, log out, exit
+  char input[256];
+  snprintf(input, sizeof(input), "1\n%d\n%s\n8\n3\n", user_id, password);
+  start = now_ms();
+  for (int i = 0; i < CLI_RUNS; ++i) {
+    if (run_cli(cli_path, db_filename, input) != 0) {
+      fprintf(stderr, "CLI run failed: %s\n", cli_path);
+      return 1;
+    }
+  }
+  const double cli_ms = (now_ms() - start) / CLI_RUNS;
+
+  printf("feed of user %d: %zu entries\n", user_id, total);
+  printf("in-process first feed page   %10.3f ms\n", first_page_ms);
+  printf("in-process feed page (%d)    %10.3f us/op  (%d ops)\n", PAGE_SIZE, page_us, iterations);
+  printf("in-process bulk get (%zu)     %10.3f us/op  (%d ops)\n", page_size, quacks_us, iterations);
+  printf("CLI login + feed + exit      %10.3f ms/op  (%d runs)\n", cli_ms, CLI_RUNS);
+  printf("CLI / in-process feed page   %10.0fx\n", cli_ms * 1e3 / page_us);
+  return 0;
+}
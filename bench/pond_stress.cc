@@ -0,0 +1,428 @@
+/*
+ * Runs simulated quacker sessions concurrently against one database and reports
+ * throughput, latency and lock contention, to find how many sessions a database file
+ * can take before writes start to fail.
+ *
+ * usage: pond_stress <database_filename> [--sessions N | --sweep N,N,...] [--processes]
+ *                    [--seconds S] [--mix feed=60,quack=20,follow=10,requack=10,search=0]
+ *                    [--wal] [--shared-indexes] [--seed N]
+ *
+ * Sessions are threads unless --processes is given, each with its own connection and
+ * its caches off, so every read reaches the database. The sessions write to the
+ * database: run the harness on a copy. --wal switches the database file to
+ * write-ahead logging before the run; the setting is stored in the file.
+ * --shared-indexes gives every thread session's connection the same in-memory indexes,
+ * as `AsyncPond` and `PondRegistry` do, instead of one set each.
+ */
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <sstream>
+#include <string>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "Pond.hh"
+
+namespace {
+
+enum Operation { FEED, QUACK, FOLLOW, REQUACK, SEARCH, OPERATION_COUNT };
+
+const char* const OPERATION_NAMES[OPERATION_COUNT] = {"feed", "quack", "follow", "requack", "search"};
+
+// Latency histogram buckets; bucket b counts latencies below 2^b microseconds
+constexpr int LATENCY_BUCKETS = 32;
+
+/**
+ * @brief What one session measured. Plain data, so processes can send it over a pipe.
+ */
+struct SessionResult {
+  uint64_t ops[OPERATION_COUNT] = {};
+  uint64_t failed[OPERATION_COUNT] = {};   // the operation reported failure
+  uint64_t locked[OPERATION_COUNT] = {};   // a statement of the operation gave up waiting for a lock
+  uint64_t latency[OPERATION_COUNT][LATENCY_BUCKETS] = {};
+  Pond::LockStats locks;
+  bool opened = false;
+
+  void add(const SessionResult& other) {
+    for (int op = 0; op < OPERATION_COUNT; ++op) {
+      this->ops[op] += other.ops[op];
+      this->failed[op] += other.failed[op];
+      this->locked[op] += other.locked[op];
+      for (int b = 0; b < LATENCY_BUCKETS; ++b) {
+        this->latency[op][b] += other.latency[op][b];
+      }
+    }
+    this->locks.waits += other.locks.waits;
+    this->locks.retries += other.locks.retries;
+    this->locks.timeouts += other.locks.timeouts;
+    this->locks.wait_us += other.locks.wait_us;
+    this->locks.max_wait_us = std::max(this->locks.max_wait_us, other.locks.max_wait_us);
+  }
+};
+
+/**
+ * @brief Settings shared by every session of a run.
+ */
+struct Workload {
+  std::string db_filename;
+  int mix[OPERATION_COUNT] = {60, 20, 10, 10, 0};   // percentages
+  std::vector<int32_t> user_ids;
+  std::vector<int32_t> quack_ids;
+  std::shared_ptr<Pond::Indexes> indexes;   // shared by every session; nullptr for one set each
+  std::chrono::steady_clock::time_point deadline;
+};
+
+/**
+ * @brief Estimates a latency percentile from a histogram, as the bucket's upper bound.
+ */
+uint64_t percentile(const uint64_t (&histogram)[LATENCY_BUCKETS], const double& fraction) {
+  uint64_t total = 0;
+  for (uint64_t count : histogram) total += count;
+  if (total == 0) return 0;
+
+  uint64_t seen = 0;
+  for (int b = 0; b < LATENCY_BUCKETS; ++b) {
+    seen += histogram[b];
+    if (seen >= fraction * total) return uint64_t(1) << b;
+  }
+  return uint64_t(1) << (LATENCY_BUCKETS - 1);
+}
+
+/**
+ * @brief Runs one session's operations until the deadline.
+ */
+SessionResult runSession(const Workload& workload, const uint32_t& seed) {
+  SessionResult result;
+  Pond pond;
+  if (pond.loadDatabase(workload.db_filename)) {
+    return result;
+  }
+  pond.setCaches(nullptr);
+  if (workload.indexes) {
+    pond.setIndexes(workload.indexes);
+  }
+  result.opened = true;
+
+  std::mt19937 random(seed);
+  std::uniform_int_distribution<size_t> pick_user(0, workload.user_ids.size() - 1);
+  std::uniform_int_distribution<size_t> pick_quack(0, std::max<size_t>(workload.quack_ids.size(), 1) - 1);
+  std::uniform_int_distribution<int> pick_percent(0, 99);
+
+  uint64_t sequence = 0;
+  while (std::chrono::steady_clock::now() < workload.deadline) {
+    int roll = pick_percent(random);
+    int op = 0;
+    while (op < OPERATION_COUNT - 1 && roll >= workload.mix[op]) {
+      roll -= workload.mix[op];
+      ++op;
+    }
+    const int32_t user_id = workload.user_ids[pick_user(random)];
+    const uint64_t timeouts = pond.getLockStats().timeouts;
+
+    bool ok = true;
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    switch (op) {
+      case FEED:
+        pond.getFeedEntries(user_id);
+        break;
+      case QUACK: {
+        int32_t* quack_id = pond.addQuack(user_id, "stress quack " + std::to_string(++sequence) + " #stress");
+        ok = quack_id != nullptr;
+        delete quack_id;
+        break;
+      }
+      case FOLLOW: {
+        // Toggle, so the operation is a write whether or not the pair already follows
+        const int32_t other = workload.user_ids[pick_user(random)];
+        const std::vector<int32_t> follows = pond.getFollows(user_id);
+        if (other == user_id) break;
+        ok = std::find(follows.begin(), follows.end(), other) == follows.end()
+          ? pond.follow(user_id, other)
+          : pond.unfollow(user_id, other);
+        break;
+      }
+      case REQUACK: {
+        if (workload.quack_ids.empty()) break;
+        const int32_t status = pond.addRequack(user_id, workload.quack_ids[pick_quack(random)]);
+        ok = status == 0 || status == 1;
+        break;
+      }
+      case SEARCH:
+        // Served by the in-memory indexes: the text arena and the name completions
+        if (result.ops[SEARCH] % 2 == 0) {
+          pond.searchQuackText("quack " + std::to_string(pick_percent(random)), 20);
+        } else {
+          pond.complete(std::string(1, char('a' + pick_percent(random) % 26)), Pond::CompletionKind::USER, 10);
+        }
+        break;
+    }
+    const uint64_t elapsed_us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+
+    int bucket = 0;
+    while (bucket < LATENCY_BUCKETS - 1 && (uint64_t(1) << bucket) <= elapsed_us) ++bucket;
+    ++result.latency[op][bucket];
+    ++result.ops[op];
+    result.failed[op] += !ok;
+    result.locked[op] += pond.getLockStats().timeouts > timeouts;
+  }
+
+  result.locks = pond.getLockStats();
+  return result;
+}
+
+/**
+ * @brief Runs `sessions` sessions at once, as threads or as processes.
+ */
+SessionResult runLevel(Workload workload, const int& sessions, const bool& processes, const double& seconds, const uint32_t& seed) {
+  workload.deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(static_cast<int64_t>(seconds * 1000));
+  std::vector<SessionResult> results(sessions);
+
+  if (!processes) {
+    std::vector<std::thread> threads;
+    for (int i = 0; i < sessions; ++i) {
+      threads.emplace_back([&, i]() {
+        results[i] = runSession(workload, seed + i);
+      });
+    }
+    for (std::thread& thread : threads) thread.join();
+  } else {
+    std::vector<std::pair<pid_t, int>> children;
+    for (int i = 0; i < sessions; ++i) {
+      int fds[2];
+      if (pipe(fds) != 0) break;
+      pid_t pid = fork();
+      if (pid == 0) {
+        close(fds[0]);
+        SessionResult result = runSession(workload, seed + i);
+        const char* data = reinterpret_cast<const char*>(&result);
+        size_t sent = 0;
+        while (sent < sizeof(result)) {
+          ssize_t count = write(fds[1], data + sent, sizeof(result) - sent);
+          if (count <= 0) break;
+          sent += count;
+        }
+        _exit(0);
+      }
+      close(fds[1]);
+      if (pid < 0) {
+        close(fds[0]);
+        break;
+      }
+      children.push_back({pid, fds[0]});
+    }
+    for (size_t i = 0; i < children.size(); ++i) {
+      char* data = reinterpret_cast<char*>(&results[i]);
+      size_t received = 0;
+      while (received < sizeof(SessionResult)) {
+        ssize_t count = read(children[i].second, data + received, sizeof(SessionResult) - received);
+        if (count <= 0) break;
+        received += count;
+      }
+      close(children[i].second);
+      waitpid(children[i].first, nullptr, 0);
+    }
+  }
+
+  SessionResult total;
+  int opened = 0;
+  for (const SessionResult& result : results) {
+    total.add(result);
+    opened += result.opened;
+  }
+  total.opened = opened == sessions;
+  if (!total.opened) {
+    std::fprintf(stderr, "%d of %d sessions could not open the database\n", sessions - opened, sessions);
+  }
+  return total;
+}
+
+/**
+ * @brief Prints the full report of one run.
+ */
+void printReport(const SessionResult& total, const int& sessions, const double& seconds) {
+  std::printf("%-8s %10s %10s %8s %8s %10s %10s\n", "op", "ops", "ops/s", "failed", "locked", "p50 us", "p99 us");
+  uint64_t ops = 0;
+  for (int op = 0; op < OPERATION_COUNT; ++op) {
+    ops += total.ops[op];
+    std::printf("%-8s %10lu %10.0f %8lu %8lu %10lu %10lu\n", OPERATION_NAMES[op],
+                total.ops[op], total.ops[op] / seconds, total.failed[op], total.locked[op],
+                percentile(total.latency[op], 0.5), percentile(total.latency[op], 0.99));
+  }
+  std::printf("%-8s %10lu %10.0f\n\n", "total", ops, ops / seconds);
+  std::printf("lock waits %lu, retries %lu, timeouts %lu, waited %.1f ms in total (%.2f ms per session-second), longest wait %.1f ms\n",
+              total.locks.waits, total.locks.retries, total.locks.timeouts, total.locks.wait_us / 1e3,
+              total.locks.wait_us / 1e3 / (sessions * seconds), total.locks.max_wait_us / 1e3);
+}
+
+/**
+ * @brief Loads the users and a sample of quacks the sessions pick from.
+ */
+bool loadIds(const std::string& db_filename, const bool& wal, std::vector<int32_t>& user_ids, std::vector<int32_t>& quack_ids) {
+  sqlite3* db;
+  if (sqlite3_open(db_filename.c_str(), &db) != SQLITE_OK) {
+    std::fprintf(stderr, "Can't open database: %s\n", sqlite3_errmsg(db));
+    sqlite3_close(db);
+    return false;
+  }
+  if (wal) {
+    sqlite3_exec(db, "PRAGMA journal_mode = WAL", nullptr, nullptr, nullptr);
+  }
+
+  const std::pair<const char*, std::vector<int32_t>*> queries[] = {
+    {"SELECT usr FROM users", &user_ids},
+    {"SELECT tid FROM tweets ORDER BY random() LIMIT 1000", &quack_ids},
+  };
+  for (const auto& [query, ids] : queries) {
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db, query, -1, &stmt, nullptr) == SQLITE_OK) {
+      while (sqlite3_step(stmt) == SQLITE_ROW) {
+        ids->push_back(sqlite3_column_int(stmt, 0));
+      }
+    }
+    sqlite3_finalize(stmt);
+  }
+  sqlite3_close(db);
+  return !user_ids.empty();
+}
+
+/**
+ * @brief Parses a comma-separated list of positive integers.
+ */
+std::vector<int> parseLevels(const std::string& text) {
+  std::vector<int> levels;
+  std::stringstream stream(text);
+  std::string item;
+  while (std::getline(stream, item, ',')) {
+    const int level = std::atoi(item.c_str());
+    if (level > 0) levels.push_back(level);
+  }
+  return levels;
+}
+
+/**
+ * @brief Parses an operation mix such as `feed=60,quack=20,follow=10,requack=10,search=0`.
+ */
+bool parseMix(const std::string& text, int (&mix)[OPERATION_COUNT]) {
+  int parsed[OPERATION_COUNT] = {};
+  std::stringstream stream(text);
+  std::string item;
+  while (std::getline(stream, item, ',')) {
+    const size_t equals = item.find('=');
+    if (equals == std::string::npos) return false;
+    const std::string name = item.substr(0, equals);
+    int op = 0;
+    while (op < OPERATION_COUNT && name != OPERATION_NAMES[op]) ++op;
+    if (op == OPERATION_COUNT) return false;
+    parsed[op] = std::atoi(item.c_str() + equals + 1);
+  }
+
+  int sum = 0;
+  for (int share : parsed) sum += share;
+  if (sum != 100) return false;
+  std::copy(std::begin(parsed), std::end(parsed), std::begin(mix));
+  return true;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    std::fprintf(stderr, "usage: %s <database_filename> [--sessions N | --sweep N,N,...] [--processes] "
+                         "[--seconds S] [--mix feed=60,quack=20,follow=10,requack=10,search=0] [--wal] [--shared-indexes] [--seed N]\n", argv[0]);
+    return 1;
+  }
+
+  Workload workload;
+  workload.db_filename = argv[1];
+  std::vector<int> levels = {8};
+  bool sweep = false;
+  bool processes = false;
+  bool wal = false;
+  double seconds = 5;
+  uint32_t seed = 1;
+
+  for (int i = 2; i < argc; ++i) {
+    const std::string arg = argv[i];
+    const bool has_value = i + 1 < argc;
+    if (arg == "--sessions" && has_value) {
+      levels = parseLevels(argv[++i]);
+    } else if (arg == "--sweep" && has_value) {
+      levels = parseLevels(argv[++i]);
+      sweep = true;
+    } else if (arg == "--processes") {
+      processes = true;
+    } else if (arg == "--wal") {
+      wal = true;
+    } else if (arg == "--shared-indexes") {
+      workload.indexes = std::make_shared<Pond::Indexes>();
+    } else if (arg == "--seconds" && has_value) {
+      seconds = std::atof(argv[++i]);
+    } else if (arg == "--seed" && has_value) {
+      seed = std::strtoul(argv[++i], nullptr, 10);
+    } else if (arg == "--mix" && has_value) {
+      if (!parseMix(argv[++i], workload.mix)) {
+        std::fprintf(stderr, "Invalid mix (shares of feed, quack, follow, requack, search must add up to 100): %s\n", argv[i]);
+        return 1;
+      }
+    } else {
+      std::fprintf(stderr, "Unknown or incomplete option: %s\n", arg.c_str());
+      return 1;
+    }
+  }
+  if (levels.empty() || seconds <= 0) {
+    std::fprintf(stderr, "Sessions and seconds must be positive\n");
+    return 1;
+  }
+  if (processes && workload.indexes) {
+    std::fprintf(stderr, "Processes cannot share indexes\n");
+    return 1;
+  }
+  if (!loadIds(workload.db_filename, wal, workload.user_ids, workload.quack_ids)) {
+    std::fprintf(stderr, "No users to simulate in %s\n", workload.db_filename.c_str());
+    return 1;
+  }
+
+  std::printf("%s, %s, %.1f s per run, mix feed=%d quack=%d follow=%d requack=%d search=%d%s%s\n\n",
+              workload.db_filename.c_str(), processes ? "processes" : "threads", seconds,
+              workload.mix[FEED], workload.mix[QUACK], workload.mix[FOLLOW], workload.mix[REQUACK], workload.mix[SEARCH],
+              wal ? ", WAL" : "", workload.indexes ? ", shared indexes" : "");
+
+  if (!sweep) {
+    SessionResult total = runLevel(workload, levels.front(), processes, seconds, seed);
+    std::printf("%d sessions\n", levels.front());
+    printReport(total, levels.front(), seconds);
+    if (workload.indexes) {
+      std::printf("shared indexes loaded or invalidated %lu times\n", workload.indexes->loads());
+    }
+    return total.opened ? 0 : 1;
+  }
+
+  // One line per level; the safe limit is the largest level with no failed writes
+  std::printf("%8s %10s %8s %8s %10s %12s %14s %12s\n", "sessions", "ops/s", "failed", "locked", "lock waits", "wait ms/s", "longest wait", "write p99 us");
+  int safe = 0;
+  for (int sessions : levels) {
+    SessionResult total = runLevel(workload, sessions, processes, seconds, seed);
+    uint64_t ops = 0, failed = 0, locked = 0;
+    uint64_t writes[LATENCY_BUCKETS] = {};
+    for (int op = 0; op < OPERATION_COUNT; ++op) {
+      ops += total.ops[op];
+      failed += op == FEED ? 0 : total.failed[op];
+      locked += total.locked[op];
+      for (int b = 0; op != FEED && b < LATENCY_BUCKETS; ++b) writes[b] += total.latency[op][b];
+    }
+    std::printf("%8d %10.0f %8lu %8lu %10lu %12.2f %11.1f ms %12lu\n", sessions, ops / seconds, failed, locked,
+                total.locks.waits, total.locks.wait_us / 1e3 / (sessions * seconds), total.locks.max_wait_us / 1e3,
+                percentile(writes, 0.99));
+    if (failed == 0 && locked == 0 && total.opened && sessions > safe) {
+      safe = sessions;
+    }
+  }
+  std::printf("\nlargest level with no failed or locked writes: %d sessions\n", safe);
+  return 0;
+}
@@ -0,0 +1,339 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+#include "Async.hh"
+
+/**
+ * @class AdmissionController
+ * @brief Per-user rate limits and a fair concurrency limit in front of Pond writes.
+ *
+ * SQLite has one writer, so a single client posting as fast as it can would make every
+ * other user's writes wait behind its own. Each write is first checked against a token
+ * bucket of its user and operation: a bucket holds up to `Limit::burst` tokens, refills
+ * at `Limit::per_minute`, and a write that finds it empty is rejected with the time
+ * until the next token. Buckets live in a table split into independently locked shards
+ * and are refilled lazily when touched, so idle users cost nothing; full buckets are
+ * dropped, since a missing bucket is a full one.
+ *
+ * Writes that pass are then limited to `Options::max_concurrent` in flight. Waiting
+ * writes are queued per user and served round-robin across users, so a user with
+ * several writes queued delays others by at most one write; a user with
+ * `Options::max_queued` writes queued is rejected instead, with a retry hint derived
+ * from how long writes have been holding their slot.
+ *
+ * ### Features:
+ * - Token buckets per user and operation with configurable rates and bursts.
+ * - Rejections carry the time after which a retry would be admitted.
+ * - Awaitable write slots, granted fairly across users, released by `Ticket`.
+ * - Counts of admitted, throttled, queued and shed writes for reports.
+ */
+class AdmissionController
+{
+public:
+  /**
+   * @brief The kinds of writes limited separately.
+   */
+  enum class Operation {
+    QUACK,
+    REPLY,
+    REQUACK,
+    FOLLOW,
+    DELETE
+  };
+
+  /**
+   * @brief Number of operations.
+   */
+  static constexpr size_t OPERATIONS = 5;
+
+  /**
+   * @brief Number of independently locked shards of the bucket table.
+   */
+  static constexpr size_t SHARDS = 16;
+
+  /**
+   * @brief The rate limit of one operation.
+   */
+  struct Limit {
+    double per_minute = 0;   // sustained rate; 0 for no limit
+    double burst = 1;        // writes allowed at once after being idle
+  };
+
+  /**
+   * @brief Configuration of a controller.
+   */
+  struct Options {
+    std::array<Limit, OPERATIONS> limits = {{
+      {30, 10},    // QUACK
+      {30, 10},    // REPLY
+      {60, 20},    // REQUACK
+      {60, 30},    // FOLLOW
+      {60, 20},    // DELETE
+    }};
+    uint32_t max_concurrent = 1;   // writes in flight across users (SQLite runs one at a time); 0 for no limit
+    uint32_t max_queued = 4;       // writes of one user waiting for a slot
+  };
+
+  /**
+   * @brief The outcome of checking a write against its rate limit.
+   */
+  struct Decision {
+    bool admitted = true;
+    std::chrono::milliseconds retry_after{0};   // until a retry would be admitted, if rejected
+  };
+
+  /**
+   * @brief Counters of a controller.
+   */
+  struct Stats {
+    uint64_t admitted = 0;    // writes that passed their rate limit
+    uint64_t throttled = 0;   // writes rejected by their rate limit
+    uint64_t queued = 0;      // writes that waited for a slot
+    uint64_t shed = 0;        // writes rejected because their user's queue was full
+  };
+
+  /**
+   * @class Ticket
+   * @brief A write slot, held until the ticket is destroyed or released.
+   *
+   * A ticket that holds no slot carries the delay before a retry in `retryAfter`.
+   */
+  class Ticket
+  {
+  public:
+    Ticket() = default;
+    Ticket(AdmissionController* controller, std::chrono::steady_clock::time_point granted)
+      : _controller(controller), _granted(granted) {}
+    explicit Ticket(const std::chrono::milliseconds& retry_after) : _retry_after(retry_after) {}
+    Ticket(Ticket&& other) noexcept { *this = std::move(other); }
+    Ticket& operator=(Ticket&& other) noexcept {
+      if (this != &other) {
+        this->release();
+        this->_controller = std::exchange(other._controller, nullptr);
+        this->_granted = other._granted;
+        this->_retry_after = other._retry_after;
+      }
+      return *this;
+    }
+    ~Ticket() { this->release(); }
+
+    /**
+     * @brief Checks whether the ticket holds a slot.
+     */
+    explicit operator bool() const { return this->_controller != nullptr; }
+
+    /**
+     * @brief Retrieves how long to wait before retrying, if no slot was granted.
+     */
+    std::chrono::milliseconds retryAfter() const { return this->_retry_after; }
+
+    /**
+     * @brief Gives the slot back early, handing it to the next waiting write.
+     */
+    void release() {
+      if (this->_controller) {
+        std::exchange(this->_controller, nullptr)->_release(this->_granted);
+      }
+    }
+
+  private:
+    AdmissionController* _controller = nullptr;
+    std::chrono::steady_clock::time_point _granted;
+    std::chrono::milliseconds _retry_after{0};
+  };
+
+  /**
+   * @class Enter
+   * @brief Awaitable that waits for a write slot.
+   *
+   * Completes at once if a slot is free or the user's queue is full; otherwise the
+   * awaiting coroutine is queued and resumed, on the executor it suspended on, when a
+   * slot is handed to it.
+   */
+  class Enter
+  {
+  public:
+    Enter(AdmissionController& controller, int32_t user_id) : _controller(controller), _user_id(user_id) {}
+
+    bool await_ready() { return this->_controller._tryEnter(this->_user_id, this->_ticket); }
+
+    bool await_suspend(std::coroutine_handle<> handle) {
+      return this->_controller._wait(this->_user_id, handle, this->_ticket);
+    }
+
+    Ticket await_resume() { return std::move(this->_ticket); }
+
+  private:
+    AdmissionController& _controller;
+    int32_t _user_id;
+    Ticket _ticket;
+  };
+
+  /**
+   * @brief Constructs a controller with the default limits.
+   */
+  AdmissionController();
+
+  /**
+   * @brief Constructs a controller with the given limits.
+   *
+   * @param options The limits.
+   */
+  AdmissionController(const Options& options);
+
+  AdmissionController(const AdmissionController&) = delete;
+  AdmissionController& operator=(const AdmissionController&) = delete;
+
+  /**
+   * @brief Takes a token from the bucket of a user and operation.
+   *
+   * @param user_id The unique ID of the user writing.
+   * @param operation The kind of write.
+   * @return Whether the write is admitted, and if not, when to retry.
+   */
+  Decision admit(const int32_t& user_id, const Operation& operation);
+
+  /**
+   * @brief Waits for a write slot.
+   *
+   * @param user_id The unique ID of the user writing; slots are granted fairly across users.
+   * @return The awaitable slot; a ticket without a slot if the user's queue is full.
+   */
+  Enter enter(const int32_t& user_id);
+
+  /**
+   * @brief Retrieves the counters.
+   *
+   * @return The counters.
+   */
+  Stats stats() const;
+
+  /**
+   * @brief Prints the counters as one line.
+   *
+   * @param out The stream to print to.
+   */
+  void report(std::ostream& out) const;
+
+  /**
+   * @brief Parses a limit given as `<operation>=<per minute>/<burst>`, e.g. `quack=30/10`.
+   *
+   * @param text The text to parse.
+   * @param operation Set to the operation.
+   * @param limit Set to the limit.
+   * @return true if the text is well-formed; false otherwise.
+   */
+  static bool parseLimit(const std::string& text, Operation& operation, Limit& limit);
+
+  /**
+   * @brief Formats a retry delay for people, rounded up to whole seconds.
+   *
+   * @param retry_after The delay.
+   * @return The delay, e.g. "12 seconds".
+   */
+  static std::string describe(const std::chrono::milliseconds& retry_after);
+
+private:
+  /**
+   * @brief The tokens left to one user for one operation.
+   */
+  struct Bucket {
+    double tokens;
+    std::chrono::steady_clock::time_point refilled;
+  };
+
+  /**
+   * @brief One independently locked part of the bucket table.
+   */
+  struct alignas(64) Shard {
+    std::mutex lock;
+    std::unordered_map<uint64_t, Bucket> buckets;   // by user ID and operation
+    std::chrono::steady_clock::time_point last_sweep;
+  };
+
+  /**
+   * @brief A write waiting for a slot.
+   */
+  struct Waiter {
+    std::coroutine_handle<> handle;
+    Executor* home;
+    Ticket* ticket;
+  };
+
+  /**
+   * @brief Takes a free slot if there is one, or rejects a user whose queue is full.
+   *
+   * @param user_id The unique ID of the user writing.
+   * @param ticket Set to the slot, or to the rejection.
+   * @return true if the caller need not wait; false if it should queue.
+   */
+  bool _tryEnter(const int32_t& user_id, Ticket& ticket);
+
+  /**
+   * @brief Queues a write for a slot, unless one was freed or the queue filled meanwhile.
+   *
+   * @param user_id The unique ID of the user writing.
+   * @param handle The coroutine to resume with the slot.
+   * @param ticket Set to the slot when it is granted.
+   * @return true if the coroutine was queued; false if `ticket` is already set.
+   */
+  bool _wait(const int32_t& user_id, std::coroutine_handle<> handle, Ticket& ticket);
+
+  /**
+   * @brief Takes a free slot if there is one, or rejects a user whose queue is full; the
+   *        lock must be held.
+   *
+   * @param user_id The unique ID of the user writing.
+   * @param ticket Set to the slot, or to the rejection.
+   * @return true if the caller need not wait; false if it should queue.
+   */
+  bool _claim(const int32_t& user_id, Ticket& ticket);
+
+  /**
+   * @brief Returns a slot, handing it to the next user in turn if any write is waiting.
+   *
+   * @param granted When the slot was granted, to estimate how long writes hold one.
+   */
+  void _release(const std::chrono::steady_clock::time_point& granted);
+
+  /**
+   * @brief Estimates how long a user with a full queue should wait; the lock must be held.
+   *
+   * @return The delay.
+   */
+  std::chrono::milliseconds _queueDelay() const;
+
+  /**
+   * @brief Drops the buckets of a shard that have refilled completely; its lock must be held.
+   *
+   * @param shard The shard.
+   * @param now The current time.
+   */
+  void _sweep(Shard& shard, const std::chrono::steady_clock::time_point& now);
+
+  Options _options;
+  std::array<Shard, SHARDS> _shards;
+
+  std::mutex _slots_lock;
+  uint32_t _in_flight = 0;
+  std::unordered_map<int32_t, std::deque<Waiter>> _waiting;   // by user, oldest first
+  std::deque<int32_t> _turns;                                 // users with waiting writes, next first
+  double _hold_ms = 1.0;                                      // moving average of slot hold time
+
+  std::atomic<uint64_t> _admitted{0};
+  std::atomic<uint64_t> _throttled{0};
+  std::atomic<uint64_t> _queued{0};
+  std::atomic<uint64_t> _shed{0};
+};
@@ -0,0 +1,226 @@
+#pragma once
+
+#include <atomic>
+#include <coroutine>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <utility>
+
+/**
+ * @class Executor
+ * @brief Something that runs posted work, typically on one specific thread.
+ *
+ * Awaitables capture the executor of the thread a coroutine suspends on and post its
+ * resumption back there, so a coroutine never continues on a thread it did not start
+ * on (e.g. an I/O pool thread). A thread announces its executor with `setCurrent`.
+ */
+class Executor
+{
+public:
+  virtual ~Executor() = default;
+
+  /**
+   * @brief Queues work to run on the executor.
+   *
+   * @param work The work to run. Safe to call from any thread.
+   */
+  virtual void post(std::function<void()> work) = 0;
+
+  /**
+   * @brief Retrieves the executor of the calling thread.
+   *
+   * @return The executor, or nullptr if the thread has none.
+   */
+  static Executor* current();
+
+  /**
+   * @brief Sets the executor of the calling thread.
+   *
+   * @param executor The executor, or nullptr to clear it.
+   */
+  static void setCurrent(Executor* executor);
+};
+
+/**
+ * @class CancellationToken
+ * @brief A read-only view of a cancellation flag.
+ *
+ * A default-constructed token is never cancelled.
+ */
+class CancellationToken
+{
+public:
+  CancellationToken() = default;
+
+  /**
+   * @brief Checks whether cancellation was requested.
+   *
+   * @return true if the owning source was cancelled.
+   */
+  bool cancelled() const {
+    return this->_flag && this->_flag->load(std::memory_order_relaxed);
+  }
+
+private:
+  friend class CancellationSource;
+  explicit CancellationToken(std::shared_ptr<const std::atomic<bool>> flag) : _flag(std::move(flag)) {}
+
+  std::shared_ptr<const std::atomic<bool>> _flag;
+};
+
+/**
+ * @class CancellationSource
+ * @brief Owns a cancellation flag and hands out tokens that observe it.
+ */
+class CancellationSource
+{
+public:
+  CancellationSource() : _flag(std::make_shared<std::atomic<bool>>(false)) {}
+
+  /**
+   * @brief Requests cancellation of everything holding one of this source's tokens.
+   */
+  void cancel() {
+    this->_flag->store(true, std::memory_order_relaxed);
+  }
+
+  /**
+   * @brief Retrieves a token observing this source.
+   *
+   * @return The token.
+   */
+  CancellationToken token() const {
+    return CancellationToken(this->_flag);
+  }
+
+private:
+  std::shared_ptr<std::atomic<bool>> _flag;
+};
+
+template <typename T>
+class Task;
+
+namespace detail {
+
+/**
+ * @brief Resumes whoever awaited a finished task, or nobody if it was never awaited.
+ */
+struct FinalAwaiter {
+  bool await_ready() const noexcept { return false; }
+
+  template <typename Promise>
+  std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) const noexcept {
+    std::coroutine_handle<> continuation = handle.promise().continuation;
+    return continuation ? continuation : std::noop_coroutine();
+  }
+
+  void await_resume() const noexcept {}
+};
+
+/**
+ * @brief The parts of a task's promise that do not depend on its result type.
+ */
+struct PromiseBase {
+  std::coroutine_handle<> continuation;
+
+  std::suspend_always initial_suspend() const noexcept { return {}; }
+  FinalAwaiter final_suspend() const noexcept { return {}; }
+  void unhandled_exception() const noexcept { std::terminate(); }
+};
+
+template <typename T>
+struct Promise : PromiseBase {
+  std::optional<T> value;
+
+  Task<T> get_return_object();
+  void return_value(T result) { this->value.emplace(std::move(result)); }
+};
+
+template <>
+struct Promise<void> : PromiseBase {
+  Task<void> get_return_object();
+  void return_void() const noexcept {}
+};
+
+} // namespace detail
+
+/**
+ * @class Task
+ * @brief A lazily started coroutine that produces a `T`.
+ *
+ * The body does not run until the task is awaited; the awaiting coroutine is resumed,
+ * by symmetric transfer, as soon as the body returns. Tasks must not throw.
+ */
+template <typename T>
+class Task
+{
+public:
+  using promise_type = detail::Promise<T>;
+
+  explicit Task(std::coroutine_handle<promise_type> handle) : _handle(handle) {}
+  Task(Task&& other) noexcept : _handle(std::exchange(other._handle, nullptr)) {}
+  Task(const Task&) = delete;
+  Task& operator=(const Task&) = delete;
+
+  ~Task() {
+    if (this->_handle) {
+      this->_handle.destroy();
+    }
+  }
+
+  bool await_ready() const noexcept { return false; }
+
+  std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+    this->_handle.promise().continuation = awaiting;
+    return this->_handle;
+  }
+
+  T await_resume() {
+    if constexpr (!std::is_void_v<T>) {
+      return std::move(*this->_handle.promise().value);
+    }
+  }
+
+private:
+  std::coroutine_handle<promise_type> _handle;
+};
+
+template <typename T>
+Task<T> detail::Promise<T>::get_return_object() {
+  return Task<T>(std::coroutine_handle<Promise<T>>::from_promise(*this));
+}
+
+inline Task<void> detail::Promise<void>::get_return_object() {
+  return Task<void>(std::coroutine_handle<Promise<void>>::from_promise(*this));
+}
+
+namespace detail {
+
+/**
+ * @brief A coroutine that starts immediately and frees itself when it finishes.
+ */
+struct Detached {
+  struct promise_type {
+    Detached get_return_object() const noexcept { return {}; }
+    std::suspend_never initial_suspend() const noexcept { return {}; }
+    std::suspend_never final_suspend() const noexcept { return {}; }
+    void return_void() const noexcept {}
+    void unhandled_exception() const noexcept { std::terminate(); }
+  };
+};
+
+} // namespace detail
+
+/**
+ * @brief Starts a task on the calling thread without waiting for it.
+ *
+ * The task runs until its first suspension before `spawn` returns, and its frame is
+ * freed when it finishes.
+ *
+ * @param task The task to start.
+ */
+inline detail::Detached spawn(Task<void> task) {
+  co_await std::move(task);
+}
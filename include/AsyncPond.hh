@@ -0,0 +1,271 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "Async.hh"
+#include "Pond.hh"
+
+class PondRegistry;
+
+/**
+ * @brief How an asynchronous Pond call ended.
+ */
+enum class AsyncStatus {
+  OK,            // the call ran to completion
+  CANCELLED,     // the caller's token was cancelled before or while it ran
+  TIMED_OUT,     // the deadline passed before or while it ran
+  UNAVAILABLE    // the I/O thread could not open the database
+};
+
+/**
+ * @brief The outcome of an asynchronous Pond call; `value` is only meaningful when
+ *        `status` is `OK`.
+ */
+template <typename T>
+struct AsyncResult {
+  AsyncStatus status = AsyncStatus::OK;
+  T value{};
+
+  bool ok() const { return this->status == AsyncStatus::OK; }
+};
+
+/**
+ * @brief Cancellation and deadline of a single call.
+ */
+struct AsyncCallOptions {
+  CancellationToken cancel;
+  std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max();
+
+  /**
+   * @brief Builds options whose deadline is a duration from now.
+   *
+   * @param timeout How long the call may take, including time queued.
+   * @param cancel The token that cancels the call.
+   * @return The options.
+   */
+  static AsyncCallOptions within(const std::chrono::milliseconds& timeout, const CancellationToken& cancel = {}) {
+    return {cancel, std::chrono::steady_clock::now() + timeout};
+  }
+};
+
+/**
+ * @class AsyncPond
+ * @brief An asynchronous facade over Pond whose calls are awaited from coroutines.
+ *
+ * Blocking SQLite work runs on a dedicated pool of I/O threads, each with its own Pond
+ * connection to the same database file; the connections share one set of in-memory
+ * indexes, which a write through any of them keeps current for all. Awaiting a call suspends the coroutine;
+ * when the call finishes, the coroutine is resumed on the executor it suspended on, or
+ * directly on the I/O thread if it had none.
+ *
+ * ### Features:
+ * - Each call returns an awaitable yielding an `AsyncResult`.
+ * - Calls carry an optional cancellation token and deadline. A call whose token is
+ *   cancelled or whose deadline passes is skipped if still queued, and interrupted
+ *   through SQLite's progress handler if already running.
+ * - `run` accepts any function of `Pond&` for operations without a wrapper.
+ * - A `PondRegistry` hands out facades that run on its shared I/O threads instead of
+ *   their own.
+ */
+class AsyncPond
+{
+public:
+  using CallOptions = AsyncCallOptions;
+
+  /**
+   * @class Call
+   * @brief The awaitable returned by every asynchronous Pond operation.
+   *
+   * Nothing is queued until the call is awaited.
+   */
+  template <typename T>
+  class Call
+  {
+  public:
+    Call(AsyncPond& pond, std::function<T(Pond&)> operation, const CallOptions& options)
+      : _pond(pond), _operation(std::move(operation)), _options(options) {}
+
+    bool await_ready() const noexcept { return false; }
+
+    void await_suspend(std::coroutine_handle<> handle) {
+      Executor* home = Executor::current();
+      this->_pond._submit([this, handle, home](Pond* pond) {
+        this->_result.status = AsyncPond::_execute(pond, this->_options, [this](Pond& connection) {
+          this->_result.value = this->_operation(connection);
+        });
+        if (home) {
+          home->post([handle] { handle.resume(); });
+        } else {
+          handle.resume();
+        }
+      });
+    }
+
+    AsyncResult<T> await_resume() { return std::move(this->_result); }
+
+  private:
+    AsyncPond& _pond;
+    std::function<T(Pond&)> _operation;
+    CallOptions _options;
+    AsyncResult<T> _result;
+  };
+
+  /**
+   * @brief Starts the I/O threads, each opening its own connection.
+   *
+   * @param db_filename The database file to open.
+   * @param io_threads The number of I/O threads (at least 1).
+   */
+  AsyncPond(const std::string& db_filename, const uint32_t& io_threads = 1);
+
+  /**
+   * @brief Constructs a facade whose calls run on a registry's I/O threads.
+   *
+   * @param registry The registry.
+   * @param tenant The tenant the calls are for.
+   */
+  AsyncPond(PondRegistry& registry, const std::string& tenant);
+
+  /**
+   * @brief Finishes every queued call, then stops the I/O threads.
+   */
+  ~AsyncPond();
+
+  AsyncPond(const AsyncPond&) = delete;
+  AsyncPond& operator=(const AsyncPond&) = delete;
+
+  /**
+   * @brief Runs an arbitrary operation on an I/O thread.
+   *
+   * @param operation Called with the I/O thread's Pond; its result becomes the value.
+   * @param options The cancellation token and deadline of the call.
+   * @return The awaitable call.
+   */
+  template <typename F>
+  auto run(F operation, const CallOptions& options = {}) {
+    using T = std::invoke_result_t<F&, Pond&>;
+    return Call<T>(*this, std::move(operation), options);
+  }
+
+  /**
+   * @brief Checks a user's credentials; the value is the user ID if they match.
+   */
+  Call<std::optional<int32_t>> checkLogin(const int32_t& user_id, const std::string& password, const CallOptions& options = {});
+
+  /**
+   * @brief Retrieves a user's stored password hash; empty if the user does not exist.
+   */
+  Call<std::string> getPasswordHash(const int32_t& user_id, const CallOptions& options = {});
+
+  /**
+   * @brief Replaces a user's stored password hash; the value is whether it was replaced.
+   */
+  Call<bool> setPasswordHash(const int32_t& user_id, const std::string& hash, const CallOptions& options = {});
+
+  /**
+   * @brief Retrieves a user's name.
+   */
+  Call<std::string> getUsername(const int32_t& user_id, const CallOptions& options = {});
+
+  /**
+   * @brief Posts a quack; the value is its ID if it was added.
+   */
+  Call<std::optional<int32_t>> addQuack(const int32_t& user_id, const std::string& text, const CallOptions& options = {});
+
+  /**
+   * @brief Requacks a quack; the value is 0 if added, 1 if already requacked, else an error.
+   */
+  Call<int32_t> addRequack(const int32_t& user_id, const int32_t& quack_id, const CallOptions& options = {});
+
+  /**
+   * @brief Follows a user; the value is whether the follow was added.
+   */
+  Call<bool> follow(const int32_t& user_id, const int32_t& follow_id, const CallOptions& options = {});
+
+  /**
+   * @brief Unfollows a user; the value is whether the unfollow succeeded.
+   */
+  Call<bool> unfollow(const int32_t& user_id, const int32_t& follow_id, const CallOptions& options = {});
+
+  /**
+   * @brief Deletes one of a user's quacks; the value is whether it was deleted.
+   */
+  Call<bool> deleteQuack(const int32_t& user_id, const int32_t& quack_id, const CallOptions& options = {});
+
+  /**
+   * @brief Retrieves a user's feed entries.
+   */
+  Call<std::vector<Pond::FeedEntry>> getFeedEntries(const int32_t& user_id, const Pond::FeedMode& mode, const CallOptions& options = {});
+
+  /**
+   * @brief Retrieves up to `count` of a user's feed entries, starting at `offset`.
+   */
+  Call<std::vector<Pond::FeedEntry>> getFeedPage(const int32_t& user_id, const Pond::FeedMode& mode, const size_t& offset, const size_t& count, const CallOptions& options = {});
+
+  /**
+   * @brief Searches quacks by keywords or hashtags.
+   */
+  Call<std::vector<Pond::Quack>> searchForQuacks(const std::string& search_terms, const CallOptions& options = {});
+
+  /**
+   * @brief Searches users by name.
+   */
+  Call<std::vector<Pond::User>> searchForUsers(const std::string& search_terms, const CallOptions& options = {});
+
+  /**
+   * @brief Retrieves a page of a user's notifications, older than `before` (0 for the newest).
+   */
+  Call<std::vector<Pond::Notification>> getNotifications(const int32_t& user_id, const int64_t& before, const CallOptions& options = {});
+
+  /**
+   * @brief Retrieves the number of calls waiting for an I/O thread.
+   *
+   * @return The queue length.
+   */
+  size_t queued() const;
+
+private:
+  /**
+   * @brief Queues a job for the next free I/O thread, the registry's if any.
+   *
+   * @param job Called with the thread's Pond, or nullptr if it failed to open.
+   */
+  void _submit(std::function<void(Pond*)> job);
+
+  /**
+   * @brief Runs one call's operation unless it is cancelled or out of time.
+   *
+   * @param pond The I/O thread's connection, or nullptr if it failed to open.
+   * @param options The cancellation token and deadline of the call.
+   * @param body Runs the operation and stores its result.
+   * @return How the call ended.
+   */
+  static AsyncStatus _execute(Pond* pond, const CallOptions& options, const std::function<void(Pond&)>& body);
+
+  /**
+   * @brief Runs queued jobs on one I/O thread until the facade is destroyed.
+   */
+  void _work();
+
+  std::string _db_filename;
+  std::shared_ptr<Pond::Indexes> _indexes;   // shared by the connections of `_threads`
+  PondRegistry* _registry = nullptr;   // runs the calls instead of `_threads` when set
+  std::string _tenant;
+  std::vector<std::thread> _threads;
+
+  mutable std::mutex _lock;
+  std::condition_variable _ready;
+  std::deque<std::function<void(Pond*)>> _jobs;
+  bool _stopping = false;
+};
@@ -0,0 +1,267 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Counters and sizes of one managed cache.
+ */
+struct CacheStats {
+  std::string name;
+  uint64_t hits = 0;
+  uint64_t misses = 0;
+  uint64_t stores = 0;
+  uint64_t rejected = 0;     // stores of results computed from an older generation
+  uint64_t refused = 0;      // results the admission policy judged less useful than what they would evict
+  uint64_t evictions = 0;    // current entries dropped for room
+  uint64_t ghost_hits = 0;   // misses on recently evicted keys: the hits a larger budget would have added
+  size_t entries = 0;
+  size_t bytes = 0;
+  size_t budget = 0;
+};
+
+/**
+ * @class ManagedCache
+ * @brief A cache whose memory budget is set by a `CacheManager`.
+ */
+class ManagedCache
+{
+public:
+  virtual ~ManagedCache() = default;
+
+  /**
+   * @brief Retrieves the cache's counters and sizes.
+   *
+   * @return A snapshot of the counters.
+   */
+  virtual CacheStats cacheStats() const = 0;
+
+  /**
+   * @brief Sets the cache's budget, evicting entries until it fits.
+   *
+   * @param bytes The budget in bytes.
+   */
+  virtual void setBudget(const size_t& bytes) = 0;
+
+  /**
+   * @brief Retrieves the ghost hits counted since the last call.
+   *
+   * @return The number of ghost hits.
+   */
+  virtual uint64_t takeGhostHits() = 0;
+};
+
+/**
+ * @class CacheManager
+ * @brief Divides one memory budget among every cache of the process.
+ *
+ * SQLite's own memory, page caches included, is charged against the budget first;
+ * the rest is split among the registered caches. Each cache keeps a floor of
+ * `MIN_CACHE_BUDGET` and shares the remainder in proportion to its recent ghost hits,
+ * the misses on keys it evicted for lack of room, which is how many more hits a larger
+ * budget would have bought it. When SQLite and the caches together still exceed the
+ * budget, the pressure callbacks are asked to give memory back.
+ *
+ * Caches can be put in groups, e.g. the caches of one database among many, and a group
+ * can be capped: its caches never get more than the cap together, and what the cap
+ * takes from them goes to the other caches.
+ *
+ * ### Features:
+ * - Register caches and pressure callbacks from any thread.
+ * - Cap the combined budget of a group of caches.
+ * - Rebalance budgets every `REBALANCE_INTERVAL` stores, or on demand.
+ * - Account for `sqlite3_memory_used` and the SQLite page cache in the budget.
+ * - Report hits, misses, evictions and bytes of every cache in one place.
+ */
+class CacheManager
+{
+public:
+  /**
+   * @brief Default budget for SQLite and every cache together.
+   */
+  static constexpr size_t DEFAULT_BUDGET = size_t(64) << 20;
+
+  /**
+   * @brief Smallest budget a cache is given, unless so many caches are registered that
+   *        the floors alone would exceed the budget.
+   */
+  static constexpr size_t MIN_CACHE_BUDGET = size_t(256) << 10;
+
+  /**
+   * @brief Number of stores, across all caches, between two rebalances.
+   */
+  static constexpr uint32_t REBALANCE_INTERVAL = 256;
+
+  /**
+   * @brief Memory accounting of the whole process.
+   */
+  struct Stats {
+    size_t budget = 0;
+    int64_t sqlite_bytes = 0;       // everything SQLite has allocated, page caches included
+    int64_t page_cache_bytes = 0;   // of which page caches
+    size_t cache_bytes = 0;
+    uint64_t rebalances = 0;
+    uint64_t pressure_events = 0;
+    std::vector<CacheStats> caches;
+  };
+
+  /**
+   * @brief Retrieves the process-wide manager.
+   *
+   * @return The shared manager, with `DEFAULT_BUDGET`.
+   */
+  static CacheManager& shared();
+
+  /**
+   * @brief Constructs a manager with no caches.
+   *
+   * @param budget The budget in bytes.
+   */
+  explicit CacheManager(const size_t& budget = DEFAULT_BUDGET);
+
+  CacheManager(const CacheManager&) = delete;
+  CacheManager& operator=(const CacheManager&) = delete;
+
+  /**
+   * @brief Sets the budget and rebalances.
+   *
+   * @param bytes The budget in bytes.
+   */
+  void setBudget(const size_t& bytes);
+
+  /**
+   * @brief Retrieves the budget.
+   *
+   * @return The budget in bytes.
+   */
+  size_t budget() const;
+
+  /**
+   * @brief Registers a cache and rebalances to give it a budget.
+   *
+   * @param cache The cache; must be removed before it is destroyed.
+   */
+  void add(ManagedCache& cache);
+
+  /**
+   * @brief Unregisters a cache and gives its budget to the others.
+   *
+   * @param cache The cache.
+   */
+  void remove(ManagedCache& cache);
+
+  /**
+   * @brief Creates a group of caches whose budgets together stay within a cap.
+   *
+   * @param limit The cap in bytes, or 0 for none.
+   * @return The group's ID, never 0.
+   */
+  uint64_t addGroup(const size_t& limit);
+
+  /**
+   * @brief Deletes a group; its caches, if any remain, are no longer capped.
+   *
+   * @param group The group's ID.
+   */
+  void removeGroup(const uint64_t& group);
+
+  /**
+   * @brief Moves a registered cache into a group and rebalances.
+   *
+   * @param cache The cache.
+   * @param group The group's ID, or 0 for none.
+   */
+  void setGroup(ManagedCache& cache, const uint64_t& group);
+
+  /**
+   * @brief Retrieves the bytes held by the caches of a group.
+   *
+   * @param group The group's ID.
+   * @return The number of bytes.
+   */
+  size_t groupBytes(const uint64_t& group) const;
+
+  /**
+   * @brief Registers a callback asked to free memory when the budget is exceeded.
+   *
+   * Callbacks run on whichever thread rebalances, after the manager is unlocked but while
+   * no callback can be added or removed, so they must not call back into the manager.
+   * They should only ask for memory back, e.g. by setting a flag the owner of the memory
+   * checks, rather than touch state owned by another thread.
+   *
+   * @param release Called with the number of bytes over budget.
+   * @return An ID for `removePressureCallback`.
+   */
+  uint64_t addPressureCallback(std::function<void(const size_t&)> release);
+
+  /**
+   * @brief Unregisters a pressure callback; it is not running once this returns.
+   *
+   * @param id The ID `addPressureCallback` returned.
+   */
+  void removePressureCallback(const uint64_t& id);
+
+  /**
+   * @brief Counts a store into a cache, rebalancing every `REBALANCE_INTERVAL` stores.
+   */
+  void noteStore();
+
+  /**
+   * @brief Divides the budget among the caches now.
+   */
+  void rebalance();
+
+  /**
+   * @brief Retrieves the memory accounting and the counters of every cache.
+   *
+   * @return A snapshot of the accounting.
+   */
+  Stats stats() const;
+
+  /**
+   * @brief Prints the accounting as a table, one row per cache.
+   *
+   * @param out The stream to print to.
+   */
+  void report(std::ostream& out) const;
+
+private:
+  struct Member {
+    ManagedCache* cache;
+    double weight;       // decaying sum of ghost hits
+    uint64_t group = 0;
+  };
+
+  /**
+   * @brief Divides the budget among the caches; the caller holds `_lock`.
+   *
+   * @return The number of bytes still over the budget.
+   */
+  size_t _rebalance();
+
+  /**
+   * @brief Asks the pressure callbacks to free memory; the caller must not hold `_lock`.
+   *
+   * @param excess The number of bytes over budget, or 0 if there is nothing to free.
+   */
+  void _relieve(const size_t& excess);
+
+  mutable std::mutex _lock;
+  size_t _budget;
+  std::vector<Member> _caches;
+  std::map<uint64_t, size_t> _group_limits;
+  uint64_t _next_group_id = 1;
+  std::mutex _callback_lock;   // guards the callbacks; never taken while holding `_lock`
+  std::map<uint64_t, std::function<void(const size_t&)>> _pressure_callbacks;
+  uint64_t _next_callback_id = 1;
+  std::atomic<uint32_t> _stores{0};
+  uint64_t _rebalances = 0;
+  std::atomic<uint64_t> _pressure_events{0};
+};
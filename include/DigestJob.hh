@@ -0,0 +1,142 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <sqlite3.h>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "TaskScheduler.hh"
+
+/**
+ * @class DigestJob
+ * @brief Batch job that writes a "top quacks from people you follow" digest per user.
+ *
+ * The job reads the database once up front instead of running a feed query per user:
+ * the follow graph is loaded into memory and each author's recent quacks are scanned
+ * and ranked a single time, keeping only that author's best `top_k`. Every follower of
+ * the author then shares that list, since a user's top `top_k` can only come from the
+ * top `top_k` of each account they follow.
+ *
+ * ### Features:
+ * - Users are split into chunks that run as background tasks on a `TaskScheduler`.
+ * - Each user's entries are ranked with a bounded min-heap of size `top_k`.
+ * - Digests stream into `shards` output files (`digest-<date>-<shard>.txt`).
+ * - Progress is reported on `std::cerr` while the workers run.
+ * - Re-running an interrupted job resumes it: the date it started on is kept in the
+ *   output directory until it completes, completed digests are found through their
+ *   end markers, any partially written digest is truncated away, and only the
+ *   remaining users are processed.
+ * - Quack text and names are escaped onto one line, so nothing but an end marker
+ *   starts with one.
+ */
+class DigestJob
+{
+public:
+  /**
+   * @brief Configuration of a digest run.
+   */
+  struct Options {
+    std::string db_filename;
+    std::string output_dir;
+    uint32_t threads = 0;   // 0 uses the shared scheduler
+    uint32_t shards = 8;
+    uint32_t top_k = 10;
+    uint32_t days = 1;      // how far back "recent" quacks reach
+  };
+
+  /**
+   * @brief Constructs a digest job with the given options.
+   *
+   * @param options The configuration of the run.
+   */
+  DigestJob(const Options& options);
+
+  /**
+   * @brief Runs the job to completion, resuming any earlier interrupted run.
+   *
+   * @return true if every user's digest was written; false if the database could not
+   *         be read or an output file could not be opened.
+   */
+  bool run();
+
+private:
+  /**
+   * @brief A recent quack that can appear in digests.
+   */
+  struct Entry {
+    int32_t tid;
+    int32_t writer_id;
+    std::string author;
+    std::string text;
+    std::string date;
+    std::string time;
+    uint32_t requacks;
+    uint32_t replies;
+    uint64_t score;
+  };
+
+  /**
+   * @brief Loads users, the follow graph and every author's ranked recent quacks.
+   *
+   * @param db The open database connection.
+   * @return true if all shared data was loaded; false otherwise.
+   */
+  bool _load(sqlite3* db);
+
+  /**
+   * @brief Picks up the date of an interrupted run, scans its shard files for completed
+   *        digests and truncates partial ones.
+   *
+   * @return true if every shard file is ready for appending; false otherwise.
+   */
+  bool _resume();
+
+  /**
+   * @brief Writes the digests of a chunk of users.
+   *
+   * @param begin The index of the first user of the chunk.
+   * @param end One past the index of the last user of the chunk.
+   */
+  void _work(const size_t& begin, const size_t& end);
+
+  /**
+   * @brief Builds the digest text of a single user.
+   *
+   * @param user_id The unique ID of the user.
+   * @return The formatted digest, or an empty string if the user has nothing to read.
+   */
+  std::string _buildDigest(const int32_t& user_id);
+
+  /**
+   * @brief Retrieves the path of a shard's output file.
+   *
+   * @param shard The shard index.
+   * @return The path of the shard file.
+   */
+  std::string _shardPath(const uint32_t& shard) const;
+
+  /**
+   * @brief Escapes text written into a digest so it stays on one line.
+   *
+   * @param text The text of a quack or a name.
+   * @return The escaped text.
+   */
+  static std::string _escape(const std::string& text);
+
+  Options _options;
+  std::string _date;   // UTC date the run started on, persisted until it completes
+  std::vector<int32_t> _users;
+  std::unordered_map<int32_t, std::string> _names;
+  std::unordered_map<int32_t, std::vector<int32_t>> _follows;
+  std::unordered_map<int32_t, std::vector<Entry>> _top_by_author;
+  std::unordered_set<int32_t> _completed;
+
+  std::vector<std::ofstream> _shard_files;
+  std::vector<std::mutex> _shard_locks;
+  std::atomic<size_t> _processed{0};
+};
@@ -0,0 +1,234 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <sqlite3.h>
+#include <vector>
+
+#include "IndexVersion.hh"
+#include "Leaderboard.hh"
+
+/**
+ * @class EngagementBoards
+ * @brief Rolling leaderboards of the most engaging quacks and accounts.
+ *
+ * Quacks are ranked by the requacks and replies they received; accounts by the
+ * requacks and replies their quacks received and by the followers they gained. Each
+ * ranking is kept over the last hour, day and week in a `Leaderboard`, so reading a
+ * top list or a rank never touches the database. Every connection to a database can
+ * share one set of leaderboards; a lock guards them.
+ *
+ * Follows, and requacks stored before `retweets` had an `rtime` column, have a date but
+ * no time, so those loaded from the database count from the start of their day; the
+ * ones recorded as they are made count from the moment they were made.
+ *
+ * ### Features:
+ * - Loaded lazily from the last week of `retweets`, `tweets` and `follows` the first
+ *   time it is read, leaving out spam and deleted quacks and users.
+ * - Kept current by the connections writing through them with `recordRequack`,
+ *   `recordReply`, `recordFollow` and `removeQuacks`, or reloaded after `invalidate`.
+ * - Reloaded when their `IndexVersion` shows a write made outside the connections
+ *   sharing them.
+ */
+class EngagementBoards
+{
+public:
+  /**
+   * @brief What a leaderboard ranks by.
+   */
+  enum class Metric {
+    REQUACKS,
+    REPLIES,
+    FOLLOWERS   // accounts only
+  };
+
+  /**
+   * @brief The rolling windows kept for every leaderboard.
+   *
+   * - `HOUR`: 12 buckets of 5 minutes.
+   * - `DAY`: 24 buckets of 1 hour.
+   * - `WEEK`: 28 buckets of 6 hours.
+   */
+  enum class Window {
+    HOUR,
+    DAY,
+    WEEK
+  };
+
+  /**
+   * @brief Constructs empty leaderboards, loaded on first read.
+   */
+  EngagementBoards();
+
+  /**
+   * @brief Loads the leaderboards if they have not been loaded or the database has
+   *        changed since they were.
+   *
+   * @param db The connection to read through.
+   * @return true if the leaderboards are current; false if they could not be loaded.
+   */
+  bool refresh(sqlite3* db);
+
+  /**
+   * @brief Forgets the loaded leaderboards, so the next read loads them again; for
+   *        changes a connection made without recording them, e.g. deletions.
+   */
+  void invalidate();
+
+  /**
+   * @brief Moves the leaderboards past a write whose changes were recorded in them.
+   *
+   * @param from The version of the tables when the write began.
+   * @param to The version of the tables once the write is done.
+   */
+  void advance(const int64_t& from, const int64_t& to);
+
+  /**
+   * @brief Retrieves the number of loads and invalidations of the leaderboards so far.
+   *
+   * @return The count.
+   */
+  uint64_t loads() const;
+
+  /**
+   * @brief Records requacks of a quack made through a connection sharing the leaderboards.
+   *
+   * @param quack_id The unique ID of the requacked quack.
+   * @param author_id The unique ID of its author.
+   * @param count 1 for a new requack, -1 for one flagged as spam.
+   * @param time When the requack was made, in seconds since the epoch; a requack flagged
+   *             as spam is taken out of the buckets it was added to.
+   */
+  void recordRequack(const int32_t& quack_id, const int32_t& author_id, const int64_t& count, const int64_t& time);
+
+  /**
+   * @brief Records a reply made through a connection sharing the leaderboards.
+   *
+   * @param quack_id The unique ID of the quack replied to.
+   * @param author_id The unique ID of its author.
+   */
+  void recordReply(const int32_t& quack_id, const int32_t& author_id);
+
+  /**
+   * @brief Records follows made through a connection sharing the leaderboards.
+   *
+   * @param followee_id The unique ID of the followed user.
+   * @param count 1 for a follow, -1 for an unfollow.
+   */
+  void recordFollow(const int32_t& followee_id, const int64_t& count);
+
+  /**
+   * @brief Takes the engagement of quacks being deleted through a connection sharing the
+   *        leaderboards out of them.
+   *
+   * @param db The connection deleting the quacks, while they are still live.
+   * @param quack_ids The unique IDs of the quacks.
+   * @return true if the leaderboards were updated or not loaded; false if they were
+   *         forgotten because the engagement could not be read.
+   */
+  bool removeQuacks(sqlite3* db, const std::vector<int32_t>& quack_ids);
+
+  /**
+   * @brief Retrieves the quacks with the most engagement.
+   *
+   * @param db The connection to load the leaderboards through.
+   * @param metric What to rank by; `FOLLOWERS` ranks no quacks.
+   * @param window The rolling window.
+   * @param count The number of quacks.
+   * @return Up to `count` quack IDs and totals, highest first.
+   */
+  std::vector<Leaderboard::Entry> topQuacks(sqlite3* db, const Metric& metric, const Window& window, const size_t& count);
+
+  /**
+   * @brief Retrieves the accounts with the most engagement.
+   *
+   * @param db The connection to load the leaderboards through.
+   * @param metric What to rank by.
+   * @param window The rolling window.
+   * @param count The number of accounts.
+   * @return Up to `count` user IDs and totals, highest first.
+   */
+  std::vector<Leaderboard::Entry> topAccounts(sqlite3* db, const Metric& metric, const Window& window, const size_t& count);
+
+  /**
+   * @brief Retrieves the rank of a quack.
+   *
+   * @param db The connection to load the leaderboards through.
+   * @param quack_id The unique ID of the quack.
+   * @param metric What to rank by.
+   * @param window The rolling window.
+   * @return The 1-based rank, or 0 if the quack is unranked.
+   */
+  size_t quackRank(sqlite3* db, const int32_t& quack_id, const Metric& metric, const Window& window);
+
+  /**
+   * @brief Retrieves the rank of an account.
+   *
+   * @param db The connection to load the leaderboards through.
+   * @param user_id The unique ID of the user.
+   * @param metric What to rank by.
+   * @param window The rolling window.
+   * @return The 1-based rank, or 0 if the account is unranked.
+   */
+  size_t accountRank(sqlite3* db, const int32_t& user_id, const Metric& metric, const Window& window);
+
+private:
+  /**
+   * @brief Loads the leaderboards unless they are current; the caller holds `_lock`.
+   *
+   * @param db The connection to read through.
+   * @return true if the leaderboards are current; false if they could not be loaded.
+   */
+  bool _refresh(sqlite3* db);
+
+  /**
+   * @brief Reads the last week of engagement into empty leaderboards.
+   *
+   * @param db The connection to read through.
+   * @return true if the tables were read; false otherwise.
+   */
+  bool _load(sqlite3* db);
+
+  /**
+   * @brief Adds the engagement a query returns to the leaderboards; the caller holds `_lock`.
+   *
+   * @param db The connection to read through.
+   * @param query The SQL query.
+   * @param metric What the rows count towards.
+   * @param has_quack Whether column 0 is a quack and column 1 its author, rather than a user.
+   * @param quack_id The quack bound to `?2`, or 0 for none.
+   * @param score What each row adds; -1 to take rows out.
+   * @param now The current time, in seconds since the epoch.
+   * @return true if the query ran; false otherwise.
+   */
+  bool _read(sqlite3* db, const char* query, const Metric& metric, const bool& has_quack,
+             const int32_t& quack_id, const int64_t& score, const int64_t& now);
+
+  /**
+   * @brief Adds a score to one ranking in every window.
+   *
+   * @param accounts Whether the ranking is of accounts rather than quacks.
+   * @param metric What the ranking is by.
+   * @param id The quack or user ID.
+   * @param score The score.
+   * @param time When it happened, in seconds since the epoch.
+   * @param now The current time, in seconds since the epoch.
+   */
+  void _add(const bool& accounts, const Metric& metric, const int32_t& id, const int64_t& score,
+            const int64_t& time, const int64_t& now);
+
+  /**
+   * @brief Retrieves one ranking, with expired buckets dropped.
+   *
+   * @param accounts Whether the ranking is of accounts rather than quacks.
+   * @param metric What the ranking is by.
+   * @param window The rolling window.
+   * @return The ranking.
+   */
+  Leaderboard& _board(const bool& accounts, const Metric& metric, const Window& window);
+
+  mutable std::mutex _lock;          // guards everything below; held while loading
+  IndexVersion _version;
+  std::vector<Leaderboard> _boards;  // by subject, then metric, then window
+};
@@ -0,0 +1,221 @@
+#pragma once
+
+#include <atomic>
+#include <coroutine>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+
+#include "Async.hh"
+
+/**
+ * @class EventLoop
+ * @brief A single-threaded epoll loop that is also the executor of its coroutines.
+ *
+ * File descriptors are watched edge-triggered for reading, writing and hang-ups; each
+ * has one handler called with the epoll event mask. Work posted from other threads is
+ * queued and runs on the loop thread after an `eventfd` wakes it.
+ */
+class EventLoop : public Executor
+{
+public:
+  /**
+   * @brief Creates the epoll instance and the wake-up `eventfd`.
+   */
+  EventLoop();
+
+  /**
+   * @brief Closes the epoll instance and the wake-up `eventfd`.
+   */
+  ~EventLoop() override;
+
+  EventLoop(const EventLoop&) = delete;
+  EventLoop& operator=(const EventLoop&) = delete;
+
+  /**
+   * @brief Checks whether the loop was created successfully.
+   *
+   * @return true if the loop can run.
+   */
+  bool valid() const;
+
+  /**
+   * @brief Queues work to run on the loop thread.
+   *
+   * @param work The work to run. Safe to call from any thread.
+   */
+  void post(std::function<void()> work) override;
+
+  /**
+   * @brief Starts watching a file descriptor.
+   *
+   * @param fd The non-blocking file descriptor.
+   * @param handler Called on the loop thread with the epoll events of each wake-up.
+   * @return true if the descriptor is now watched.
+   */
+  bool watch(const int& fd, std::function<void(uint32_t)> handler);
+
+  /**
+   * @brief Stops watching a file descriptor; its handler is not called again.
+   *
+   * @param fd The file descriptor.
+   */
+  void unwatch(const int& fd);
+
+  /**
+   * @brief Dispatches events and posted work until `stop` is called.
+   */
+  void run();
+
+  /**
+   * @brief Makes `run` return after the current iteration. Safe to call from any thread.
+   */
+  void stop();
+
+private:
+  /**
+   * @brief Runs the work posted since the last wake-up.
+   */
+  void _drainPosted();
+
+  int _epoll = -1;
+  int _wakeup = -1;
+  std::atomic<bool> _stopping{false};
+
+  std::mutex _posted_lock;
+  std::deque<std::function<void()>> _posted;
+
+  std::unordered_map<int, std::function<void(uint32_t)>> _handlers;
+};
+
+/**
+ * @class Connection
+ * @brief A non-blocking socket on an `EventLoop`, read and written by awaiting.
+ *
+ * Lines are read into a buffer as they arrive; writes go out immediately and only
+ * suspend the writer while the socket's send buffer is full.
+ */
+class Connection : public std::enable_shared_from_this<Connection>
+{
+public:
+  /**
+   * @brief Longest line accepted; longer input closes the connection.
+   */
+  static constexpr size_t MAX_LINE = 64 * 1024;
+
+  /**
+   * @brief Awaitable that yields the next line, without its line ending.
+   */
+  struct ReadLine {
+    Connection& connection;
+
+    bool await_ready() const;
+    void await_suspend(std::coroutine_handle<> handle);
+    std::optional<std::string> await_resume();
+  };
+
+  /**
+   * @brief Awaitable that completes once its data has been handed to the kernel.
+   */
+  struct Write {
+    Connection& connection;
+
+    bool await_ready() const;
+    void await_suspend(std::coroutine_handle<> handle);
+    bool await_resume() const;
+  };
+
+  /**
+   * @brief Takes ownership of an accepted, non-blocking socket.
+   *
+   * @param loop The loop that watches the socket.
+   * @param fd The socket.
+   */
+  Connection(EventLoop& loop, const int& fd);
+
+  /**
+   * @brief Stops watching and closes the socket.
+   */
+  ~Connection();
+
+  Connection(const Connection&) = delete;
+  Connection& operator=(const Connection&) = delete;
+
+  /**
+   * @brief Registers the socket with the loop; call once the connection is owned by a
+   *        `std::shared_ptr`.
+   *
+   * @return true if the socket is watched.
+   */
+  bool start();
+
+  /**
+   * @brief Reads the next line.
+   *
+   * @return An awaitable yielding the line, or nothing once the peer has closed the
+   *         connection or sent a line longer than `MAX_LINE`.
+   */
+  Connection::ReadLine readLine();
+
+  /**
+   * @brief Sends data.
+   *
+   * @param data The bytes to send.
+   * @return An awaitable yielding false if the connection failed.
+   */
+  Connection::Write write(const std::string& data);
+
+  /**
+   * @brief Retrieves a token cancelled when the connection fails or is reset.
+   *
+   * @return The token.
+   */
+  CancellationToken hangup() const;
+
+private:
+  /**
+   * @brief Handles the epoll events of the socket and resumes waiting coroutines.
+   *
+   * @param events The epoll event mask.
+   */
+  void _onEvents(const uint32_t& events);
+
+  /**
+   * @brief Reads everything the socket has into the input buffer.
+   */
+  void _fill();
+
+  /**
+   * @brief Writes as much of the output buffer as the socket accepts.
+   */
+  void _flush();
+
+  /**
+   * @brief Checks whether a complete line is buffered.
+   *
+   * @return true if the input buffer holds a line ending.
+   */
+  bool _hasLine() const;
+
+  /**
+   * @brief Marks the connection failed and cancels its hang-up token.
+   */
+  void _fail();
+
+  EventLoop& _loop;
+  int _fd;
+  bool _watched = false;
+  bool _eof = false;
+  bool _failed = false;
+
+  std::string _in;
+  std::string _out;
+  std::coroutine_handle<> _reader;
+  std::coroutine_handle<> _writer;
+  CancellationSource _hangup;
+};
@@ -0,0 +1,164 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <sqlite3.h>
+#include <unordered_map>
+#include <vector>
+
+#include "IndexVersion.hh"
+
+/**
+ * @class FollowGraph
+ * @brief An in-memory copy of the `follows` table, queryable from SQL.
+ *
+ * The graph keeps sorted forward (follower -> followees) and reverse (followee ->
+ * followers) adjacency lists, so both "who does X follow" and "who follows X" are a
+ * hash lookup instead of a B-tree scan; `follows` is only keyed on the follower.
+ *
+ * Attaching the graph to a connection registers the eponymous virtual table
+ * `follow_graph(flwer, flwee)`. Its `xBestIndex` pushes equality constraints on
+ * either column (or both) down to the adjacency lists, so ordinary SQL can join
+ * against it in place of `follows`. One graph can be attached to every connection to
+ * a database; a lock guards it, and each scan copies its edges out under the lock.
+ *
+ * ### Features:
+ * - Loaded lazily from `follows` the first time it is read.
+ * - Kept current by the connections writing through it with `addFollow` /
+ *   `removeFollow`, or reloaded after `invalidate`.
+ * - Reloaded when its `IndexVersion` shows a write made outside the connections
+ *   sharing it.
+ */
+class FollowGraph
+{
+public:
+  /**
+   * @brief Registers the `follow_graph` virtual table on a connection.
+   *
+   * @param db The connection to query and to register the table on.
+   * @return true if the module was registered; false otherwise.
+   */
+  bool attach(sqlite3* db);
+
+  /**
+   * @brief Loads the graph if it has not been loaded or the database has changed
+   *        since it was.
+   *
+   * @param db The connection to read through.
+   * @return true if the graph is current; false if it could not be loaded.
+   */
+  bool refresh(sqlite3* db);
+
+  /**
+   * @brief Records a follow made through a connection sharing the graph.
+   *
+   * @param follower_id The unique ID of the follower.
+   * @param followee_id The unique ID of the followed user.
+   */
+  void addFollow(const int32_t& follower_id, const int32_t& followee_id);
+
+  /**
+   * @brief Records an unfollow made through a connection sharing the graph.
+   *
+   * @param follower_id The unique ID of the follower.
+   * @param followee_id The unique ID of the unfollowed user.
+   */
+  void removeFollow(const int32_t& follower_id, const int32_t& followee_id);
+
+  /**
+   * @brief Forgets the loaded graph, so the next read loads it again; for edges a
+   *        connection removed without going through `removeFollow`.
+   */
+  void invalidate();
+
+  /**
+   * @brief Moves the graph past a write whose changes were recorded in it.
+   *
+   * @param from The version of the tables when the write began.
+   * @param to The version of the tables once the write is done.
+   */
+  void advance(const int64_t& from, const int64_t& to);
+
+  /**
+   * @brief Retrieves the number of loads and invalidations of the graph so far.
+   *
+   * @return The count.
+   */
+  uint64_t loads() const;
+
+  /**
+   * @brief Retrieves the number of follow edges in the graph.
+   *
+   * @return The number of edges.
+   */
+  size_t size() const;
+
+private:
+  /**
+   * @brief Loads the graph unless it is current; the caller holds `_lock`.
+   *
+   * @param db The connection to read through.
+   * @return true if the graph is current; false if it could not be loaded.
+   */
+  bool _refresh(sqlite3* db);
+
+  /**
+   * @brief Reads every edge of `follows` into the adjacency lists.
+   *
+   * @param db The connection to read through.
+   * @return true if the table was read; false otherwise.
+   */
+  bool _load(sqlite3* db);
+
+  /**
+   * @brief Retrieves the users a user follows; the caller holds `_lock`.
+   *
+   * @param follower_id The unique ID of the follower.
+   * @return The followed user IDs in ascending order.
+   */
+  const std::vector<int32_t>& _followingOf(const int32_t& follower_id) const;
+
+  /**
+   * @brief Retrieves the followers of a user; the caller holds `_lock`.
+   *
+   * @param followee_id The unique ID of the followed user.
+   * @return The follower IDs in ascending order.
+   */
+  const std::vector<int32_t>& _followersOf(const int32_t& followee_id) const;
+
+  /**
+   * @brief Inserts a value into a sorted list unless already present.
+   *
+   * @param list The sorted list.
+   * @param value The value to insert.
+   * @return true if the value was inserted; false if it was already present.
+   */
+  static bool _insertSorted(std::vector<int32_t>& list, const int32_t& value);
+
+  /**
+   * @brief Removes a value from a sorted list if present.
+   *
+   * @param list The sorted list.
+   * @param value The value to remove.
+   */
+  static void _eraseSorted(std::vector<int32_t>& list, const int32_t& value);
+
+  // sqlite3_module callbacks; see FollowGraph.cc
+  static int _xConnect(sqlite3* db, void* aux, int argc, const char* const* argv, sqlite3_vtab** vtab, char** error);
+  static int _xDisconnect(sqlite3_vtab* vtab);
+  static int _xBestIndex(sqlite3_vtab* vtab, sqlite3_index_info* info);
+  static int _xOpen(sqlite3_vtab* vtab, sqlite3_vtab_cursor** cursor);
+  static int _xClose(sqlite3_vtab_cursor* cursor);
+  static int _xFilter(sqlite3_vtab_cursor* cursor, int idx_num, const char* idx_str, int argc, sqlite3_value** argv);
+  static int _xNext(sqlite3_vtab_cursor* cursor);
+  static int _xEof(sqlite3_vtab_cursor* cursor);
+  static int _xColumn(sqlite3_vtab_cursor* cursor, sqlite3_context* context, int column);
+  static int _xRowid(sqlite3_vtab_cursor* cursor, sqlite3_int64* rowid);
+
+  mutable std::mutex _lock;   // guards everything below; held while loading
+  IndexVersion _version;
+  size_t _edges = 0;
+  std::unordered_map<int32_t, std::vector<int32_t>> _following;
+  std::unordered_map<int32_t, std::vector<int32_t>> _followers;
+};
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * @class FrequencySketch
+ * @brief A count-min sketch of how often keys were recently used, for cache admission.
+ *
+ * Each key hash increments one 4-bit counter in each of `SKETCH_DEPTH` rows, and its
+ * estimated frequency is the smallest of those counters. Once the number of increments
+ * reaches ten times the width, every counter is halved, so the sketch follows the
+ * recent workload instead of all-time popularity.
+ *
+ * ### Features:
+ * - Count key hashes in constant memory per expected entry.
+ * - Estimate a key's recent frequency, saturating at 15.
+ * - Age every counter periodically so old popularity fades.
+ */
+class FrequencySketch
+{
+public:
+  /**
+   * @brief Number of counter rows, each indexed by a differently seeded hash.
+   */
+  static constexpr uint32_t SKETCH_DEPTH = 4;
+
+  /**
+   * @brief Largest value of a counter.
+   */
+  static constexpr uint8_t MAX_FREQUENCY = 15;
+
+  /**
+   * @brief Constructs a sketch sized for a number of distinct keys.
+   *
+   * @param expected_entries The number of keys the sketch should tell apart.
+   */
+  explicit FrequencySketch(const size_t& expected_entries = 256);
+
+  /**
+   * @brief Grows the sketch if it is too small for a number of keys, forgetting
+   *        what it counted.
+   *
+   * @param expected_entries The number of keys the sketch should tell apart.
+   */
+  void ensureCapacity(const size_t& expected_entries);
+
+  /**
+   * @brief Counts one use of a key.
+   *
+   * @param hash The key's hash.
+   */
+  void increment(const uint64_t& hash);
+
+  /**
+   * @brief Estimates how often a key was used recently.
+   *
+   * @param hash The key's hash.
+   * @return The estimate, between 0 and `MAX_FREQUENCY`.
+   */
+  uint8_t frequency(const uint64_t& hash) const;
+
+  /**
+   * @brief Resets every counter to zero.
+   */
+  void clear();
+
+private:
+  /**
+   * @brief Selects the counter of a key in one row.
+   *
+   * @param hash The key's hash.
+   * @param row The row.
+   * @return The index of the counter within `_counters`.
+   */
+  size_t _index(const uint64_t& hash, const uint32_t& row) const;
+
+  /**
+   * @brief Halves every counter.
+   */
+  void _age();
+
+  std::vector<uint8_t> _counters;   // SKETCH_DEPTH rows of `_width` counters
+  size_t _width = 0;                // a power of two
+  uint64_t _increments = 0;         // since the last aging
+};
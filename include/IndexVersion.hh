@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstdint>
+#include <sqlite3.h>
+
+/**
+ * @class IndexVersion
+ * @brief Which write to the database an in-memory index was built at, for indexes that
+ *        several connections to the database share.
+ *
+ * Triggers on every table the indexes are built from count each inserted, updated or
+ * deleted row in `pond_meta.index_version`, whichever connection or program changes it.
+ * `PRAGMA data_version` cannot serve here: it tells a connection that someone else
+ * committed, not whether that commit was already applied to an index it shares with
+ * the committer. An index is current while its version is no older than the database's.
+ *
+ * A connection writing through a shared index applies its changes to it before it
+ * commits, while it still holds the write lock, and then moves the index past its own
+ * write with `advance`; other connections reload the index only for writes made outside
+ * the indexes, e.g. by another program or by a connection not sharing them.
+ *
+ * Inside a write the database's version already counts the write's own changes, which
+ * the indexes have as well; the writing thread pins the version the write began at, so
+ * its reads compare the indexes with that instead of reloading them.
+ *
+ * Not synchronized: the index owning the version guards it with its own lock.
+ *
+ * ### Features:
+ * - Read the database's version with `read`.
+ * - Count loads and invalidations, so a writer can tell nobody reloaded the index
+ *   while its transaction was open.
+ */
+class IndexVersion
+{
+public:
+  /**
+   * @brief Reads the version of the indexed tables, or the one pinned on the connection.
+   *
+   * @param db The connection to read through.
+   * @return The version, or -1 if it could not be read.
+   */
+  static int64_t read(sqlite3* db);
+
+  /**
+   * @brief Pins the version `read` returns for a connection on this thread while it writes.
+   *
+   * @param db The connection.
+   * @param version The version the write began at, or -1 to unpin.
+   */
+  static void pin(sqlite3* db, const int64_t& version);
+
+  /**
+   * @brief Checks whether the index is loaded and reflects a version of the tables.
+   *
+   * @param version The version read from the database.
+   * @return true if the index need not be reloaded.
+   */
+  bool current(const int64_t& version) const;
+
+  /**
+   * @brief Checks whether the index has been loaded since it was last invalidated.
+   *
+   * @return true if changes should be applied to it.
+   */
+  bool isLoaded() const;
+
+  /**
+   * @brief Records a load of the index.
+   *
+   * @param version The version read before the load began, or -1 if the load failed.
+   */
+  void loaded(const int64_t& version);
+
+  /**
+   * @brief Forgets the load, so the index is reloaded on its next use.
+   */
+  void invalidate();
+
+  /**
+   * @brief Moves the index past a write whose changes were applied to it.
+   *
+   * @param from The version of the tables when the write began.
+   * @param to The version of the tables once the write is done.
+   */
+  void advance(const int64_t& from, const int64_t& to);
+
+  /**
+   * @brief Retrieves the number of loads and invalidations so far.
+   *
+   * @return The count.
+   */
+  uint64_t loads() const;
+
+private:
+  int64_t _version = -1;   // version of the tables the index reflects; -1 if unloaded
+  uint64_t _loads = 0;
+};
@@ -0,0 +1,198 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <string_view>
+
+#include "Pond.hh"
+
+/**
+ * @class JsonWriter
+ * @brief A streaming JSON serializer that writes JSON lines into a reusable buffer.
+ *
+ * Values are appended as they are written; there is no document tree. Integers are
+ * formatted with `std::to_chars`, the row helpers write their keys as precomposed
+ * literals, and strings are escaped 16 bytes at a time with SSE2,
+ * copying runs of bytes that need no escape in one append. When the writer streams to
+ * an `std::ostream`, the buffer is written out and reused whenever a line ends with more
+ * than `flush_bytes` in it, so memory stays bounded however many rows are exported.
+ *
+ * Separators are inserted automatically: after `beginObject`/`beginArray` or `key` no
+ * comma is written, after any value or `end*` the next value or key gets one.
+ *
+ * ### Features:
+ * - Objects, arrays, keys, strings, integers, booleans and null.
+ * - One-call serialization of quacks, feed entries, users and notifications.
+ * - Stream to an `std::ostream`, or collect into the buffer and `take` it.
+ */
+class JsonWriter
+{
+public:
+  /**
+   * @brief Default buffer size at which a streaming writer flushes.
+   */
+  static constexpr size_t FLUSH_BYTES = 64 * 1024;
+
+  /**
+   * @brief Constructs a writer.
+   *
+   * @param out The stream to flush to, or nullptr to keep everything in the buffer.
+   * @param flush_bytes The buffer size at which a line end flushes.
+   */
+  explicit JsonWriter(std::ostream* out = nullptr, const size_t& flush_bytes = FLUSH_BYTES);
+
+  /**
+   * @brief Flushes whatever is left in the buffer.
+   */
+  ~JsonWriter();
+
+  JsonWriter(const JsonWriter&) = delete;
+  JsonWriter& operator=(const JsonWriter&) = delete;
+
+  /**
+   * @brief Opens an object.
+   */
+  JsonWriter& beginObject();
+
+  /**
+   * @brief Closes the innermost object.
+   */
+  JsonWriter& endObject();
+
+  /**
+   * @brief Opens an array.
+   */
+  JsonWriter& beginArray();
+
+  /**
+   * @brief Closes the innermost array.
+   */
+  JsonWriter& endArray();
+
+  /**
+   * @brief Writes an object key; the next call writes its value.
+   *
+   * @param name The key, escaped like any string.
+   */
+  JsonWriter& key(const std::string_view& name);
+
+  /**
+   * @brief Writes a string value.
+   *
+   * @param text The text, escaped as needed.
+   */
+  JsonWriter& value(const std::string_view& text);
+
+  /**
+   * @brief Writes a string value.
+   *
+   * @param text The NUL-terminated text, escaped as needed.
+   */
+  JsonWriter& value(const char* text);
+
+  /**
+   * @brief Writes an integer value.
+   *
+   * @param number The number.
+   */
+  JsonWriter& value(const int64_t& number);
+
+  /**
+   * @brief Writes a boolean value.
+   *
+   * @param flag The flag.
+   */
+  JsonWriter& value(const bool& flag);
+
+  /**
+   * @brief Writes null.
+   */
+  JsonWriter& null();
+
+  /**
+   * @brief Writes a quack as one object.
+   *
+   * @param quack The quack.
+   */
+  JsonWriter& quack(const Pond::Quack& quack);
+
+  /**
+   * @brief Writes a feed entry as one object.
+   *
+   * @param entry The feed entry.
+   */
+  JsonWriter& feedEntry(const Pond::FeedEntry& entry);
+
+  /**
+   * @brief Writes a user as one object.
+   *
+   * @param user The user.
+   */
+  JsonWriter& user(const Pond::User& user);
+
+  /**
+   * @brief Writes a notification as one object.
+   *
+   * @param notification The notification.
+   */
+  JsonWriter& notification(const Pond::Notification& notification);
+
+  /**
+   * @brief Ends a JSON line, flushing the buffer if it has grown past the threshold.
+   */
+  void endLine();
+
+  /**
+   * @brief Writes the buffer to the stream, if any, and empties it.
+   */
+  void flush();
+
+  /**
+   * @brief Retrieves everything written and not yet flushed.
+   *
+   * @return The buffer.
+   */
+  const std::string& buffer() const;
+
+  /**
+   * @brief Takes everything written and not yet flushed, leaving the buffer empty.
+   *
+   * @return The text.
+   */
+  std::string take();
+
+  /**
+   * @brief Appends a string's JSON escape, without quotes.
+   *
+   * @param out The text to append to.
+   * @param text The text to escape.
+   */
+  static void escape(std::string& out, const std::string_view& text);
+
+private:
+  /**
+   * @brief Writes the comma before a value or key, if one is due.
+   */
+  void _separate();
+
+  /**
+   * @brief Appends a quoted, escaped string.
+   *
+   * @param text The text.
+   */
+  void _string(const std::string_view& text);
+
+  /**
+   * @brief Appends an integer, formatted without a locale or a stream.
+   *
+   * @param number The number.
+   */
+  void _number(const int64_t& number);
+
+  std::string _buffer;
+  std::ostream* _out;
+  size_t _flush_bytes;
+  bool _need_comma = false;   // a value was written at the current nesting level
+};
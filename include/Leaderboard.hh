@@ -0,0 +1,129 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <ext/pb_ds/assoc_container.hpp>
+#include <ext/pb_ds/tree_policy.hpp>
+#include <functional>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/**
+ * @class Leaderboard
+ * @brief A ranking of IDs by the sum of their scores over a rolling window.
+ *
+ * The window is split into `buckets` buckets of `bucket_seconds` each; every score
+ * lands in the bucket of its time, and when a bucket falls out of the window each of
+ * its IDs is decremented by what the bucket added. The window therefore covers the
+ * last `buckets - 1` whole buckets plus the current one.
+ *
+ * Totals are kept in an order-statistic tree ordered by total, highest first, so
+ * reading the top N and the rank of any ID both take O(log n + N), and adding a score
+ * or expiring one ID of a bucket takes O(log n). IDs whose total drops to 0 or below
+ * leave the ranking.
+ *
+ * ### Features:
+ * - Add positive or negative scores at any time within the window, in any order.
+ * - Expire whole buckets as the clock moves forward.
+ * - Read the top N, the rank and the total of an ID.
+ */
+class Leaderboard
+{
+public:
+  /**
+   * @brief An ID and its total in the window.
+   */
+  struct Entry {
+    int32_t id;
+    int64_t score;
+  };
+
+  /**
+   * @brief Constructs an empty leaderboard.
+   *
+   * @param bucket_seconds The width of one bucket, in seconds.
+   * @param buckets The number of buckets in the window.
+   */
+  Leaderboard(const int64_t& bucket_seconds, const size_t& buckets);
+
+  /**
+   * @brief Adds a score to an ID.
+   *
+   * @param id The ID.
+   * @param score The score, e.g. 1 for one more requack.
+   * @param time When it happened, in seconds since the epoch; scores older than the
+   *             window are ignored, and scores from the future count as now.
+   * @param now The current time, in seconds since the epoch.
+   */
+  void add(const int32_t& id, const int64_t& score, const int64_t& time, const int64_t& now);
+
+  /**
+   * @brief Expires the buckets that have fallen out of the window.
+   *
+   * @param now The current time, in seconds since the epoch.
+   */
+  void advance(const int64_t& now);
+
+  /**
+   * @brief Retrieves the IDs with the highest totals.
+   *
+   * @param count The number of IDs.
+   * @return Up to `count` entries, highest total first; ties go to the lower ID.
+   */
+  std::vector<Entry> top(const size_t& count) const;
+
+  /**
+   * @brief Retrieves the rank of an ID.
+   *
+   * @param id The ID.
+   * @return The 1-based rank, or 0 if the ID has no positive total.
+   */
+  size_t rank(const int32_t& id) const;
+
+  /**
+   * @brief Retrieves the total of an ID.
+   *
+   * @param id The ID.
+   * @return The total in the window.
+   */
+  int64_t score(const int32_t& id) const;
+
+  /**
+   * @brief Retrieves the number of ranked IDs.
+   *
+   * @return The number of IDs with a positive total.
+   */
+  size_t size() const;
+
+  /**
+   * @brief Removes every score.
+   */
+  void clear();
+
+private:
+  // (total, -id) in descending order: highest total first, then lowest ID
+  using Key = std::pair<int64_t, int32_t>;
+  using Ranking = __gnu_pbds::tree<Key, __gnu_pbds::null_type, std::greater<Key>,
+                                   __gnu_pbds::rb_tree_tag, __gnu_pbds::tree_order_statistics_node_update>;
+
+  struct Bucket {
+    int64_t index;                                // time / bucket width
+    std::unordered_map<int32_t, int64_t> scores;  // what the bucket added to each ID
+  };
+
+  /**
+   * @brief Changes the total of an ID and moves it in the ranking.
+   *
+   * @param id The ID.
+   * @param delta The change.
+   */
+  void _adjust(const int32_t& id, const int64_t& delta);
+
+  int64_t _bucket_seconds;
+  size_t _buckets;
+  std::deque<Bucket> _window;                     // by ascending index
+  std::unordered_map<int32_t, int64_t> _totals;
+  Ranking _ranking;
+};
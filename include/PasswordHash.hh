@@ -0,0 +1,82 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/**
+ * @class PasswordHash
+ * @brief Salted, deliberately slow password hashes (PBKDF2-HMAC-SHA256).
+ *
+ * A stored hash is the text `pbkdf2-sha256$<iterations>$<salt>$<key>`, with the 16-byte
+ * salt and 32-byte key in hex, so the iteration count can be raised later without
+ * invalidating existing hashes. Older databases store passwords in plain text; those
+ * are still accepted by `verify` and reported by `needsRehash`, so they can be replaced
+ * the next time their owner logs in.
+ *
+ * ### Features:
+ * - Hash a password with a fresh random salt.
+ * - Verify a password in time independent of where it differs from the stored one.
+ * - Recognize plain-text and under-strength hashes that should be replaced.
+ */
+class PasswordHash
+{
+public:
+  /**
+   * @brief Iterations of new hashes; tens of milliseconds of one core each.
+   */
+  static constexpr uint32_t ITERATIONS = 100000;
+
+  /**
+   * @brief Hashes a password with a fresh random salt.
+   *
+   * @param password The password.
+   * @param iterations The number of PBKDF2 iterations.
+   * @return The hash, ready to store.
+   */
+  static std::string hash(const std::string& password, const uint32_t& iterations = ITERATIONS);
+
+  /**
+   * @brief Checks a password against a stored hash, or a stored plain-text password.
+   *
+   * @param password The password entered.
+   * @param stored The stored hash or plain-text password.
+   * @return true if the password matches; false otherwise, or if `stored` is empty.
+   */
+  static bool verify(const std::string& password, const std::string& stored);
+
+  /**
+   * @brief Checks whether a stored password should be hashed again.
+   *
+   * @param stored The stored hash or plain-text password.
+   * @return true if it is plain text or uses fewer than `ITERATIONS` iterations.
+   */
+  static bool needsRehash(const std::string& stored);
+
+private:
+  using Digest = std::array<uint8_t, 32>;
+
+  /**
+   * @brief Derives a 32-byte key with PBKDF2-HMAC-SHA256.
+   *
+   * @param password The password.
+   * @param salt The salt.
+   * @param salt_length The length of the salt.
+   * @param iterations The number of iterations.
+   * @return The key.
+   */
+  static Digest _pbkdf2(const std::string& password, const uint8_t* salt, const size_t& salt_length,
+                        const uint32_t& iterations);
+
+  /**
+   * @brief Splits a stored hash into its parts.
+   *
+   * @param stored The stored hash.
+   * @param iterations Set to the iteration count.
+   * @param salt Set to the decoded salt.
+   * @param key Set to the decoded key.
+   * @return true if `stored` is a well-formed hash; false if it is plain text.
+   */
+  static bool _parse(const std::string& stored, uint32_t& iterations, std::string& salt, Digest& key);
+};
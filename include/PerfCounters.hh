@@ -0,0 +1,173 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <ostream>
+#include <string>
+#include <thread>
+
+/**
+ * @class PerfCounters
+ * @brief Profiles operations with the CPU's hardware performance counters.
+ *
+ * Counters are opened with `perf_event_open` for the thread that constructs the
+ * profiler, counting user-space events only, and read at the start and end of every
+ * `Scope`. Totals are kept per operation name, so a report shows not just which
+ * operations are slow but whether they stall on memory (low IPC, many cache misses
+ * per row) or on branches.
+ *
+ * ### Features:
+ * - Count cycles, instructions, cache misses and branch misses as one group, so their
+ *   ratios come from the same time slices, scaled up if the kernel multiplexed them.
+ * - Count page faults separately, as a software event that is available where
+ *   hardware counters are not.
+ * - Degrade to wall time alone, naming the reason, when counters cannot be opened,
+ *   as in most containers and virtual machines.
+ * - Report IPC and misses per returned row for every operation.
+ */
+class PerfCounters
+{
+public:
+  /**
+   * @brief The counted events.
+   */
+  enum Event {
+    CYCLES,
+    INSTRUCTIONS,
+    CACHE_MISSES,
+    BRANCH_MISSES,
+    PAGE_FAULTS,
+    EVENT_COUNT
+  };
+
+  /**
+   * @brief Totals of one operation.
+   */
+  struct Totals {
+    uint64_t calls = 0;
+    uint64_t rows = 0;
+    uint64_t wall_ns = 0;
+    uint64_t counts[EVENT_COUNT] = {};
+  };
+
+  /**
+   * @brief Counts one run of an operation, from construction to destruction.
+   *
+   * Scopes may nest; each counts everything that runs inside it. A scope does nothing
+   * if it has no profiler or runs on a thread other than the profiler's.
+   */
+  class Scope
+  {
+  public:
+    /**
+     * @brief Starts counting an operation.
+     *
+     * @param counters The profiler, or nullptr to count nothing.
+     * @param operation The operation's name; must outlive the profiler.
+     */
+    Scope(PerfCounters* counters, const char* operation);
+
+    /**
+     * @brief Stops counting and adds the run to its operation's totals.
+     */
+    ~Scope();
+
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+
+    /**
+     * @brief Records how many rows the operation produced, for per-row figures.
+     *
+     * @param rows The number of rows.
+     */
+    void setRows(const size_t& rows);
+
+  private:
+    PerfCounters* _counters;
+    const char* _operation;
+    size_t _rows = 0;
+    uint64_t _start[EVENT_COUNT] = {};
+    std::chrono::steady_clock::time_point _start_time;
+  };
+
+  /**
+   * @brief Opens the counters for the calling thread.
+   */
+  PerfCounters();
+
+  /**
+   * @brief Closes the counters.
+   */
+  ~PerfCounters();
+
+  PerfCounters(const PerfCounters&) = delete;
+  PerfCounters& operator=(const PerfCounters&) = delete;
+
+  /**
+   * @brief Checks whether an event is being counted.
+   *
+   * @param event The event.
+   * @return true if its counter is open.
+   */
+  bool available(const Event& event) const;
+
+  /**
+   * @brief Retrieves why counters are missing, if any are.
+   *
+   * @return The reason, or an empty string if every counter is open.
+   */
+  const std::string& unavailableReason() const;
+
+  /**
+   * @brief Retrieves the totals of every operation counted so far.
+   *
+   * @return The totals, by operation name.
+   */
+  const std::map<std::string, Totals>& totals() const;
+
+  /**
+   * @brief Prints a table of the totals: calls, time, IPC, and misses per row.
+   *
+   * @param out The stream to print to.
+   */
+  void report(std::ostream& out) const;
+
+  /**
+   * @brief Discards the totals counted so far.
+   */
+  void reset();
+
+private:
+  /**
+   * @brief Reads every open counter.
+   *
+   * @param[out] counts The current values, scaled for multiplexing; 0 for events that
+   *             are not counted.
+   */
+  void _read(uint64_t (&counts)[EVENT_COUNT]) const;
+
+  /**
+   * @brief Opens one counter.
+   *
+   * @param type The `perf_event_attr` type.
+   * @param config The `perf_event_attr` config.
+   * @param group_fd The group leader's descriptor, or -1 to open a leader.
+   * @param read_format The `perf_event_attr` read format.
+   * @return The descriptor, or -1 if the counter could not be opened.
+   */
+  int _open(const uint32_t& type, const uint64_t& config, const int& group_fd, const uint64_t& read_format);
+
+  // Descriptors of the open counters, -1 where an event is not counted
+  int _fds[EVENT_COUNT];
+
+  // The hardware group's leader, and each event's position within a read of the group
+  int _group_fd = -1;
+  int _group_slot[EVENT_COUNT];
+  size_t _group_size = 0;
+
+  std::thread::id _thread;
+  std::string _unavailable_reason;
+  std::map<std::string, Totals> _totals;
+};
@@ -1,16 +1,35 @@
 #pragma once
 
+#include <cctype>
+#include <cstdio>
+#include <cstring>
 #include <iostream>
 #include <sqlite3.h>
 #include <string>
 #include <vector>
 #include <chrono>
 #include <ctime>
+#include <unordered_map>
 #include <unordered_set>
 #include <sstream>
 #include <algorithm>
+#include <cmath>
+#include <functional>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <thread>
 
 #include "definitions.hh"
+#include "TermDictionary.hh"
+#include "HyperLogLog.hh"
+#include "PrefixIndex.hh"
+#include "FollowGraph.hh"
+#include "EngagementBoards.hh"
+#include "TextScanEngine.hh"
+#include "VersionedCache.hh"
+#include "PerfCounters.hh"
 
 /**
  * @class Pond
@@ -22,10 +41,21 @@
  * lists, and interactions.
  *
  * ### Features:
- * - Manage users with functions for adding, retrieving, and authenticating.
+ * - Manage users with functions for adding, retrieving, and authenticating against salted password hashes.
  * - Handle quacks, including creation, replies, requacks, and searching by content or hashtags.
  * - Manage lists of quacks for users.
  * - Enable user interactions such as following, unfollowing, and feed generation.
+ * - Index mentions and fan notifications out to each user's inbox as events happen.
+ * - Autocomplete hashtags and user names from an in-memory prefix index.
+ * - Find users by misspelled names with a typo-tolerant fuzzy search.
+ * - Serve follow lookups from an in-memory graph exposed to SQL as `follow_graph`.
+ * - Find any fragment of quack text with a parallel SIMD scan of an in-memory text arena.
+ * - Rank the most requacked and replied-to quacks and accounts over rolling windows.
+ * - Cache feeds and profile reads in caches that other connections can fill ahead of time.
+ * - Search quacks with a query language compiled to plans driven by the most selective index.
+ * - Cache quack searches, and size every cache in bytes within one process-wide budget.
+ * - Wait out other connections' locks with jittered exponential backoff, and count the waits.
+ * - Count hardware performance events around the feed, search, profile and write operations.
  *
  * The class interacts with an SQLite database to persistently store and retrieve data.
  * It ensures proper validation of data and handles unique ID generation for users and quacks.
@@ -81,6 +111,280 @@ public:
     std::string name;
   };
 
+  /**
+   * @brief Represents the estimated audience of a quack's requack cascade.
+   *
+   * The reach is estimated from a HyperLogLog sketch of the author's followers merged
+   * with the followers of every requacker. The cascade depth is the longest chain of
+   * requacks (author's followers -> requacker -> requacker of a requacker ...).
+   */
+  struct Reach {
+    uint64_t estimated_reach;
+    uint32_t cascade_depth;
+  };
+
+  /**
+   * @brief Orderings in which a user's feed can be produced.
+   *
+   * - `CHRONOLOGICAL`: every quack and requack from followed users, newest first.
+   * - `RANKED`: the most engaging entries among the most recent candidates.
+   */
+  enum class FeedMode {
+    CHRONOLOGICAL,
+    RANKED
+  };
+
+  /**
+   * @brief Number of most recent chronological entries scored by the ranked feed.
+   */
+  static constexpr uint32_t RANKED_FEED_WINDOW = 500;
+
+  /**
+   * @brief Number of entries kept by the ranked feed.
+   */
+  static constexpr uint32_t RANKED_FEED_SIZE = 50;
+
+  /**
+   * @brief Represents a single entry of a user's feed.
+   *
+   * For requacks, `writer_id` and `author` identify the followed user who requacked the
+   * quack and `date` is the requack date.
+   */
+  struct FeedEntry {
+    std::string type;
+    int32_t tid;
+    std::string author;
+    int32_t writer_id;
+    std::string date;
+    std::string time;
+    std::string text;
+  };
+
+  /**
+   * @brief The kinds of activity counted by the time-bucketed rollups.
+   */
+  enum class Activity {
+    QUACKS,
+    REPLIES,
+    REQUACKS,
+    SPAM_REQUACKS,
+    NEW_USERS,
+    FOLLOWS,
+    HASHTAG_MENTIONS
+  };
+
+  /**
+   * @brief The bucket sizes kept by the activity rollups.
+   *
+   * Buckets are keyed by the prefix of a GMT timestamp: `YYYY-MM-DD HH` for hours,
+   * `YYYY-MM-DD` for days and `YYYY-MM` for months.
+   */
+  enum class Granularity {
+    HOUR,
+    DAY,
+    MONTH
+  };
+
+  /**
+   * @brief A single bucket of an activity series.
+   */
+  struct ActivityBucket {
+    std::string bucket;
+    uint64_t count;
+  };
+
+  /**
+   * @brief The vocabularies that search terms can be completed from.
+   *
+   * - `HASHTAG`: hashtags ranked by how many quacks mention them.
+   * - `USER`: user names ranked by follower count.
+   */
+  enum class CompletionKind {
+    HASHTAG,
+    USER
+  };
+
+  /**
+   * @brief The events that place a notification in a user's inbox.
+   */
+  enum class NotificationKind {
+    MENTION,
+    REPLY,
+    REQUACK,
+    FOLLOW
+  };
+
+  /**
+   * @brief The things that can be deleted; the values are stored in `tombstones.kind`.
+   */
+  enum class DeletedKind {
+    QUACK = 0,
+    USER = 1,
+    LIST = 2
+  };
+
+  /**
+   * @brief How long a statement waits for another connection's lock before failing.
+   */
+  static constexpr int BUSY_TIMEOUT_MS = 5000;
+
+  /**
+   * @brief Longest sleep of the first retry of a locked statement; each retry doubles it.
+   */
+  static constexpr int BUSY_BACKOFF_INITIAL_MS = 1;
+
+  /**
+   * @brief Longest sleep of any retry of a locked statement.
+   */
+  static constexpr int BUSY_BACKOFF_MAX_MS = 100;
+
+  /**
+   * @brief Counters describing how this connection waited on other connections' locks.
+   */
+  struct LockStats {
+    uint64_t waits = 0;         // statements that found the database locked
+    uint64_t retries = 0;       // sleeps before retrying a locked statement
+    uint64_t timeouts = 0;      // waits abandoned after `BUSY_TIMEOUT_MS`; the statement failed
+    uint64_t wait_us = 0;       // total time slept
+    uint64_t max_wait_us = 0;   // longest time slept by one statement
+  };
+
+  /**
+   * @brief Virtual machine instructions between polls of the interrupt check.
+   */
+  static constexpr int INTERRUPT_CHECK_INTERVAL = 1000;
+
+  /**
+   * @brief Number of notifications returned per page unless asked otherwise.
+   */
+  static constexpr uint32_t NOTIFICATION_PAGE_SIZE = 10;
+
+  /**
+   * @brief Maximum number of bytes of quack text copied into a notification.
+   */
+  static constexpr size_t NOTIFICATION_SNIPPET_LENGTH = 60;
+
+  /**
+   * @brief Days a spam-flagged requack is kept before it is folded into the spam ledger.
+   */
+  static constexpr uint32_t SPAM_RETENTION_DAYS = 30;
+
+  /**
+   * @brief Spam-flagged requacks moved to the ledger per transaction.
+   */
+  static constexpr uint32_t SPAM_PRUNE_BATCH = 500;
+
+  /**
+   * @brief Maximum number of rows a purge transaction removes.
+   */
+  static constexpr uint32_t PURGE_BATCH = 200;
+
+  /**
+   * @brief Time after which a purge transaction commits, even if its batch is not full.
+   */
+  static constexpr std::chrono::milliseconds PURGE_SLICE{20};
+
+  /**
+   * @brief A single entry of a user's notifications inbox.
+   *
+   * The actor's name and a snippet of the quack are copied in when the notification is
+   * written, so reading the inbox never touches the base tables. `tid` is 0 for follow
+   * notifications.
+   */
+  struct Notification {
+    int64_t nid;
+    Pond::NotificationKind kind;
+    int32_t actor;
+    std::string actor_name;
+    int32_t tid;
+    std::string snippet;
+    std::string date;
+    std::string time;
+    bool unread;
+  };
+
+  /**
+   * @brief How long a cached feed is served; ranked feeds change with the clock alone.
+   */
+  static constexpr std::chrono::seconds FEED_CACHE_TTL{60};
+
+  /**
+   * @brief Read caches that several connections to the same database can share.
+   *
+   * Every entry is stamped with `generation`, which the owning connection bumps after
+   * each of its own writes and whenever `PRAGMA data_version` shows another connection
+   * has written, so it is never served results older than the newest write it has seen.
+   * The caches' sizes are set in bytes by `CacheManager::shared()`, within the cap of
+   * `group` if one is given.
+   */
+  struct Caches {
+    explicit Caches(const uint64_t& group = 0);
+
+    /**
+     * @brief Retrieves the bytes held by all the caches.
+     *
+     * @return The number of bytes.
+     */
+    size_t bytes() const;
+
+    std::atomic<uint64_t> generation{0};
+    VersionedCache<int64_t, std::shared_ptr<const std::vector<Pond::FeedEntry>>> feeds;
+    VersionedCache<int32_t, std::string> usernames;
+    VersionedCache<int32_t, std::vector<Pond::User>> followers;
+    VersionedCache<int32_t, std::vector<int32_t>> follows;
+    VersionedCache<int32_t, std::vector<Pond::Quack>> quacks;
+    VersionedCache<std::string, std::vector<Pond::Quack>> searches;
+  };
+
+  /**
+   * @brief In-memory indexes that every connection to the same database can share.
+   *
+   * Each index is built from the database on first use and guarded by its own lock. A
+   * connection writing through the indexes records its changes in them before it
+   * commits and then moves them past its write (see `IndexVersion`), so the connections
+   * sharing them reload an index only after a write made without them.
+   */
+  struct Indexes {
+    /**
+     * @brief A user as held by the in-memory fuzzy search index.
+     */
+    struct IndexedUser {
+      std::string name;
+      uint32_t followers;
+    };
+
+    /**
+     * @brief Retrieves the number of loads and invalidations of all the indexes.
+     *
+     * @return The count.
+     */
+    uint64_t loads() const;
+
+    /**
+     * @brief Moves every index past a write whose changes were recorded in them.
+     *
+     * @param from The version of the tables when the write began.
+     * @param to The version of the tables once the write is done.
+     */
+    void advance(const int64_t& from, const int64_t& to);
+
+    /**
+     * @brief Forgets every index, so each is rebuilt on its next use.
+     */
+    void invalidate();
+
+    FollowGraph follow_graph;   // backs the `follow_graph` virtual table
+    EngagementBoards engagement;
+    TextScanEngine text_scan;
+
+    mutable std::mutex search_lock;   // guards the completion and fuzzy name indexes
+    IndexVersion search_version;
+    PrefixIndex hashtag_completions;
+    PrefixIndex user_completions;
+    TermDictionary name_tokens;
+    std::unordered_map<int32_t, IndexedUser> indexed_users;
+  };
+
   /**
   * @brief Opens a connection to the SQLite database specified by the filename.
   *
@@ -90,6 +394,85 @@ public:
   */
   int loadDatabase(const std::string& db_filename);
 
+  /**
+   * @brief Sets a check that interrupts long-running statements.
+   *
+   * While set, the check is polled every `INTERRUPT_CHECK_INTERVAL` virtual machine
+   * instructions of any statement; returning true aborts the statement, and the
+   * running method fails as if the query had returned an error.
+   *
+   * @param should_stop The check, or an empty function to remove it.
+   */
+  void setInterruptCheck(std::function<bool()> should_stop);
+
+  /**
+   * @brief Retrieves the lock-wait counters of this connection.
+   *
+   * @return A snapshot of the counters.
+   */
+  Pond::LockStats getLockStats() const;
+
+  /**
+   * @brief Resets the lock-wait counters of this connection to zero.
+   */
+  void resetLockStats();
+
+  /**
+   * @brief Sets a profiler that counts performance events around this connection's
+   *        feed, search, profile and write operations.
+   *
+   * @param profiler The profiler, or nullptr to stop profiling. It must outlive the
+   *                 connection or be unset first.
+   */
+  void setProfiler(PerfCounters* profiler);
+
+  /**
+   * @brief Retrieves the read caches used by this connection.
+   *
+   * @return The caches, or nullptr if caching is disabled.
+   */
+  std::shared_ptr<Pond::Caches> getCaches() const;
+
+  /**
+   * @brief Replaces the read caches used by this connection.
+   *
+   * Passing another connection's caches lets this one fill them from another thread,
+   * e.g. to load data before it is asked for; the connection that created them stays
+   * responsible for invalidating them, unless this one is made an owner too.
+   *
+   * @param caches The caches to read and fill, or nullptr to disable caching.
+   * @param owner Whether this connection also invalidates the caches when it sees
+   *              writes from other connections.
+   */
+  void setCaches(std::shared_ptr<Pond::Caches> caches, const bool& owner = false);
+
+  /**
+   * @brief Retrieves the in-memory indexes used by this connection.
+   *
+   * @return The indexes.
+   */
+  std::shared_ptr<Pond::Indexes> getIndexes() const;
+
+  /**
+   * @brief Replaces the in-memory indexes used by this connection.
+   *
+   * Connections to the same database that share one set of indexes, such as the
+   * connections of a pool, hold one copy of them and keep each other's writes in it
+   * instead of reloading it whenever another of them commits.
+   *
+   * @param indexes The indexes of another connection to the same database, or nullptr
+   *                for indexes of this connection's own.
+   */
+  void setIndexes(std::shared_ptr<Pond::Indexes> indexes);
+
+  /**
+   * @brief Caps the SQLite page cache of this connection.
+   *
+   * @param kib The cap in KiB.
+   * @return true if the cap was set; false otherwise.
+   */
+  bool setPageCacheLimit(const uint32_t& kib);
+
   /**
   * @brief Adds a new user to the users table in the database.
   *
@@ -149,13 +532,32 @@ public:
    *
    * @param user_id The ID of the user who is posting the quack.
    * @param text The text of the quack.
-   * @return A pointer to the unique ID of the quack if it was successfully added; nullptr otherwise.
+   * @return A pointer to the unique ID of the quack if it was successfully added; nullptr
+   *         otherwise, e.g. if the user has been deleted.
    */
   int32_t* addQuack(
     const int32_t& user_id,
     const std::string& text
   );
 
+  /**
+   * @brief Adds several quacks in one transaction.
+   *
+   * Each post goes through `addQuack`, so hashtags, mentions and activity are recorded
+   * as usual; sharing one transaction saves a commit per quack. Each post runs under its
+   * own savepoint, so a rejected post leaves none of its rows behind.
+   *
+   * @param posts Pairs of the posting user's ID and the quack's text.
+   * @param[out] quack_ids The ID of each new quack, in order, or 0 for a post that was
+   *                       rejected. Every entry is 0 if the transaction failed.
+   * @return true if the transaction was committed; false if it could not be begun or
+   *         committed, in which case no quack was added.
+   */
+  bool addQuacks(
+    const std::vector<std::pair<int32_t, std::string>>& posts,
+    std::vector<int32_t>& quack_ids
+  );
+
   /**
   * @brief Adds a reply quack to the quacks table in the database.
   *
@@ -183,6 +585,7 @@ public:
    *         - 0: A new requack was successfully added.
    *         - 1: The requack already exists and was marked as spam.
    *         - 3: An error occurred during the process.
+   *         - -1: The quack or the user has been deleted.
    *
    * @note The method uses parameterized SQL queries to prevent SQL injection and ensures
    *       proper database interaction. Dates for new requacks are recorded using the current
@@ -190,9 +593,9 @@ public:
    *
    * @details 
    * - **Spam Handling**: If a requack already exists for the user and quack, the method updates
-   *   the existing record, setting the `spam` flag to `1`.
+   *   the existing record, setting the `spam` flag to `1` unless it is already set.
    * - **New Requack**: If no requack exists, a new entry is added to the `retweets` table,
-   *   linking the `quack_id` to the `user_id` and recording the `writer_id` and current date.
+   *   linking the `quack_id` to the `user_id` and recording the `writer_id` and current date and time.
    */
   int32_t addRequack(
       const int32_t &user_id,
@@ -225,9 +628,60 @@ public:
     const std::string& list_name
   );
 
+  /**
+   * @brief Deletes a quack, together with its replies, requacks, hashtags, mentions and
+   *        list entries.
+   *
+   * The quack and every reply under it, however deep, are hidden from every read at once,
+   * and taken out of the shared indexes; their rows are removed later by `purgeDeleted`.
+   *
+   * @param user_id The ID of the user deleting the quack; must be its author.
+   * @param quack_id The ID of the quack.
+   * @return true if the quack was deleted; false if it does not exist, was already
+   *         deleted, was written by someone else, or the write failed.
+   */
+  bool deleteQuack(
+    const int32_t& user_id,
+    const int32_t& quack_id
+  );
+
+  /**
+   * @brief Deletes a user, together with their quacks, requacks, follows, lists and
+   *        notifications.
+   *
+   * The user and everything they wrote are hidden from every read at once, and they can
+   * no longer log in; their rows are removed later by `purgeDeleted`.
+   *
+   * @param user_id The ID of the user.
+   * @return true if the user was deleted; false if they do not exist, were already
+   *         deleted, or the write failed.
+   */
+  bool deleteUser(
+    const int32_t& user_id
+  );
+
+  /**
+   * @brief Deletes a list and its entries.
+   *
+   * The list is hidden at once; its rows are removed later by `purgeDeleted`, and a list
+   * of the same name can only be created again once they are.
+   *
+   * @param user_id The ID of the user who owns the list.
+   * @param list_name The name of the list.
+   * @return true if the list was deleted; false if it does not exist, was already
+   *         deleted, or the write failed.
+   */
+  bool deleteList(
+    const int32_t& user_id,
+    const std::string& list_name
+  );
+
   /**
   * @brief Checks if the provided user ID and password are valid for login.
   *
+  * A plain-text password left by an older database, or a hash weaker than the current
+  * strength, is replaced by a fresh hash once it has been matched.
+  *
   * @param user_id The user ID to check in the database.
   * @param password The password corresponding to the user ID.
   * @return true if the login credentials are valid; false otherwise.
@@ -237,12 +691,43 @@ public:
     const std::string& password
   );
 
+  /**
+   * @brief Retrieves the stored password of a user.
+   *
+   * @param user_id The unique ID of the user.
+   * @return The salted hash, or the plain text of a password not yet hashed; empty if the
+   *         user does not exist or was deleted.
+   */
+  std::string getPasswordHash(
+    const int32_t& user_id
+  );
+
+  /**
+   * @brief Replaces the stored password of a user.
+   *
+   * @param user_id The unique ID of the user.
+   * @param hash The new hash, from `PasswordHash::hash`.
+   * @return true if the password was replaced; false otherwise.
+   */
+  bool setPasswordHash(
+    const int32_t& user_id,
+    const std::string& hash
+  );
+
+  /**
+   * @brief Replaces every plain-text password with a salted hash.
+   *
+   * @return The number of passwords replaced, or -1 if they could not be read or written.
+   */
+  int64_t hashPasswords();
+
   /**
    * @brief Adds a follow relationship between two users.
    *
    * @param user_id The ID of the user who is following.
    * @param follow_id The ID of the user to be followed.
-   * @return true if the follow was successfully added, false otherwise.
+   * @return true if the follow was successfully added, false otherwise, e.g. if either
+   *         user has been deleted.
    */
   bool follow(
     const int32_t& user_id,
@@ -272,31 +757,356 @@ public:
   );
 
   /**
-   * @brief search for quacks containing specific keywords or hashtags.
+   * @brief Searches for users whose names approximately match the search terms.
+   *
+   * Every word of the search must be within `max_distance` edits of some word of a
+   * user's name. Short words tolerate fewer edits (one per three letters), so that a
+   * two-letter word does not match every name. Matches come from an in-memory sorted
+   * dictionary of the distinct name words and are ranked by total distance, then follower count.
+   *
+   * @param search_terms The (possibly misspelled) name to search for.
+   * @param max_distance The most edits accepted per word.
+   * @param limit The maximum number of users to return.
+   * @return The best matching users, closest and most followed first.
+   */
+  std::vector<Pond::User> searchForUsersFuzzy(
+    const std::string& search_terms,
+    const uint32_t& max_distance = 2,
+    const uint32_t& limit = 10
+  );
+
+  /**
+   * @brief Searches for quacks matching a query of the search language.
+   *
+   * The query is parsed by `SearchQuery` and compiled by `SearchPlanner` into a plan
+   * driven by its most selective term: see `SearchQuery` for the syntax, e.g.
+   * `#pond from:janedoe since:2024-01-01 -is:reply "rubber duck"`. A comma-separated
+   * list of keywords, as accepted by older versions, is still a valid query, with two
+   * changes in what it returns: the quacks are sorted newest first across all the
+   * keywords, where they used to come keyword by keyword, each newest first; and
+   * spaces around each keyword are trimmed, so `#nice, staff` also finds `staff`,
+   * returning 8 quacks on the test database where it used to return 2.
    *
-   * @param search_terms A string of keywords or hashtags to search for in quacks.
-   * @return A vector of quacks that contain the specified keywords or hashtags, ordered by date and time.
+   * @param search_terms The query.
+   * @return The matching quacks, newest first.
    *
-   * @note case insensitive search, space seperated keywoards
+   * @note Words match case-insensitively as whole words or hashtags. A keyword wrapped
+   *       in `*`, such as `*ack*`, matches anywhere in the text, even inside a word.
    */
   std::vector<Pond::Quack> searchForQuacks(
     const std::string& search_terms
   );
+
+  /**
+   * @brief Describes how a search query would be run, without running it.
+   *
+   * @param search_terms The query, as given to `searchForQuacks`.
+   * @return The plan, one step per line, with the number of quacks each step is
+   *         expected to list.
+   */
+  std::string explainSearch(
+    const std::string& search_terms
+  );
+
+  /**
+   * @brief Searches for quacks containing a fragment of text anywhere, even inside a word.
+   *
+   * Served by scanning an in-memory copy of every quack's text in parallel rather than
+   * by SQL, which would test each row through `LIKE`. The copy is loaded on first use,
+   * kept current by the posts of every connection sharing it and reloaded when the
+   * database was changed some other way.
+   *
+   * @param fragment The text to look for; ASCII letters match either case.
+   * @param limit The most quacks to return; 0 returns every match.
+   * @return The matching quacks, newest first.
+   */
+  std::vector<Pond::Quack> searchQuackText(
+    const std::string& fragment,
+    const size_t& limit = 0
+  );
+
+  /**
+   * @brief Completes a hashtag or user name prefix with its most popular matches.
+   *
+   * Completions are served from an in-memory compressed trie that is built on first use,
+   * kept current by the writes of every connection sharing it and rebuilt when the
+   * database was changed some other way.
+   *
+   * @param prefix The prefix to complete (case-insensitive; a leading `#` is optional
+   *        for hashtags).
+   * @param kind Whether to complete hashtags or user names.
+   * @param k The maximum number of completions to return.
+   * @return The completions with their popularity, most popular first.
+   */
+  std::vector<PrefixIndex::Entry> complete(
+    const std::string& prefix,
+    const Pond::CompletionKind& kind,
+    const uint32_t& k = PrefixIndex::TOP_K
+  );
   
   /**
    * @brief Retrieves a feed of quacks and requacks for a given user.
    *
    * @param user_id The unique identifier of the user for whom the feed is generated.
+   * @param mode Whether the feed is chronological or ranked by engagement.
    * @return A vector of strings where each string represents a formatted entry in the feed.
    */
   std::vector<std::string> getFeed(
-    const int32_t& user_id
+    const int32_t& user_id,
+    const Pond::FeedMode& mode = Pond::FeedMode::CHRONOLOGICAL
+  );
+
+  /**
+   * @brief Retrieves the entries of a user's feed without formatting them.
+   *
+   * In `RANKED` mode, the `RANKED_FEED_WINDOW` most recent chronological entries are
+   * scored in a single query that joins the precomputed engagement counters
+   * (`quack_stats`) and the viewer's affinity with each followed user (`affinity`).
+   * The score combines recency decay (24 hour half-life), requack and reply counts,
+   * affinity and a spam penalty, and a bounded min-heap keeps the best
+   * `RANKED_FEED_SIZE` entries.
+   *
+   * @param user_id The unique identifier of the user for whom the feed is generated.
+   * @param mode Whether the feed is chronological or ranked by engagement.
+   * @return The feed entries in display order.
+   */
+  std::vector<Pond::FeedEntry> getFeedEntries(
+    const int32_t& user_id,
+    const Pond::FeedMode& mode = Pond::FeedMode::CHRONOLOGICAL
+  );
+
+  /**
+   * @brief Retrieves one page of a user's feed.
+   *
+   * The whole feed is produced (or found in the feed cache) as by `getFeedEntries`, but
+   * only the requested entries are copied out.
+   *
+   * @param user_id The unique identifier of the user for whom the feed is generated.
+   * @param mode Whether the feed is chronological or ranked by engagement.
+   * @param offset The index of the first entry of the page.
+   * @param count The maximum number of entries in the page.
+   * @param total Receives the number of entries in the whole feed.
+   * @return The entries of the page in display order.
+   */
+  std::vector<Pond::FeedEntry> getFeedPage(
+    const int32_t& user_id,
+    const Pond::FeedMode& mode,
+    const size_t& offset,
+    const size_t& count,
+    size_t& total
   );
 
   uint32_t getRequackCount(const int32_t& quack_id);
   
   std::vector<int32_t> getReplies(const int32_t& quack_id);
+
+  /**
+   * @brief Retrieves the estimated unique reach and cascade depth of a quack.
+   *
+   * The reach sketch is maintained incrementally by `addRequack`. Quacks requacked
+   * before reach tracking existed have theirs worked out on each read, without writing
+   * it, until their next requack stores it.
+   *
+   * @param quack_id The unique ID of the quack.
+   * @return A `Pond::Reach` with the estimated number of distinct users who could see the
+   *         quack and the deepest requack chain; zeros if the quack does not exist.
+   */
+  Pond::Reach getReach(const int32_t& quack_id);
+
+  /**
+   * @brief Retrieves the quacks with the most engagement over a rolling window.
+   *
+   * Served from in-memory leaderboards kept current by `addRequack` and `addReply`.
+   *
+   * @param metric What to rank by: requacks or replies received.
+   * @param window The rolling window.
+   * @param count The number of quacks.
+   * @return Up to `count` quack IDs with their totals, highest first.
+   */
+  std::vector<Leaderboard::Entry> getTopQuacks(
+    const EngagementBoards::Metric& metric,
+    const EngagementBoards::Window& window,
+    const size_t& count = 10
+  );
+
+  /**
+   * @brief Retrieves the accounts with the most engagement over a rolling window.
+   *
+   * Served from in-memory leaderboards kept current by `addRequack`, `addReply`,
+   * `follow` and `unfollow`.
+   *
+   * @param metric What to rank by: requacks or replies their quacks received, or
+   *               followers gained.
+   * @param window The rolling window.
+   * @param count The number of accounts.
+   * @return Up to `count` user IDs with their totals, highest first.
+   */
+  std::vector<Leaderboard::Entry> getTopAccounts(
+    const EngagementBoards::Metric& metric,
+    const EngagementBoards::Window& window,
+    const size_t& count = 10
+  );
+
+  /**
+   * @brief Retrieves the rank of a quack on a leaderboard.
+   *
+   * @param quack_id The unique ID of the quack.
+   * @param metric What to rank by.
+   * @param window The rolling window.
+   * @return The 1-based rank, or 0 if the quack had no such engagement in the window.
+   */
+  size_t getQuackRank(
+    const int32_t& quack_id,
+    const EngagementBoards::Metric& metric,
+    const EngagementBoards::Window& window
+  );
+
+  /**
+   * @brief Retrieves the rank of an account on a leaderboard.
+   *
+   * @param user_id The unique ID of the user.
+   * @param metric What to rank by.
+   * @param window The rolling window.
+   * @return The 1-based rank, or 0 if the account had no such engagement in the window.
+   */
+  size_t getAccountRank(
+    const int32_t& user_id,
+    const EngagementBoards::Metric& metric,
+    const EngagementBoards::Window& window
+  );
   
+  /**
+   * @brief Counts an activity over an arbitrary range of hours.
+   *
+   * The range is split into at most five aligned segments (leading hours, leading days,
+   * whole months, trailing days, trailing hours), each answered by one range read of the
+   * rollup table. The cost depends on the length of the range, never on the amount of
+   * data in the base tables.
+   *
+   * @param activity The kind of activity to count.
+   * @param from Inclusive start, as `YYYY-MM-DD` or `YYYY-MM-DD HH` (GMT).
+   * @param to Exclusive end, as `YYYY-MM-DD` or `YYYY-MM-DD HH` (GMT).
+   * @return The number of events in the range; 0 if the bounds are malformed.
+   */
+  uint64_t getActivityCount(
+    const Pond::Activity& activity,
+    const std::string& from,
+    const std::string& to
+  );
+
+  /**
+   * @brief Retrieves the non-empty buckets of an activity between two bucket keys.
+   *
+   * @param activity The kind of activity to read.
+   * @param granularity The bucket size to read.
+   * @param from Inclusive first bucket key.
+   * @param to Exclusive last bucket key.
+   * @return The buckets in ascending order.
+   */
+  std::vector<Pond::ActivityBucket> getActivitySeries(
+    const Pond::Activity& activity,
+    const Pond::Granularity& granularity,
+    const std::string& from,
+    const std::string& to
+  );
+
+  /**
+   * @brief Rebuilds the activity rollups from the base tables.
+   *
+   * Quacks, replies and hashtag mentions are bucketed by hour, day and month. Requacks,
+   * spam requacks and follows only carry a date, so they are backfilled into day and
+   * month buckets; their hour buckets, recorded live, are kept. Users have no creation
+   * date, so new-user counts are only ever recorded live and are left untouched. Runs in
+   * a single write, or inside the caller's transaction.
+   *
+   * @return true if the rollups were rebuilt; false otherwise.
+   */
+  bool backfillActivity();
+
+  /**
+   * @brief Folds requacks flagged as spam longer ago than the retention period into the
+   *        spam ledger and deletes them.
+   *
+   * Retention is measured from when a requack was flagged. The ledger keeps, per
+   * requacker, author and day, how many requacks were flagged. Rows are moved in batches
+   * of `batch_size`, each in its own transaction, so other sessions can write between
+   * batches.
+   *
+   * @param retention_days Days since flagging past which spam requacks are moved.
+   * @param batch_size Maximum number of requacks moved per transaction.
+   * @return The number of requacks moved, or -1 if a batch failed.
+   */
+  int64_t pruneSpamRequacks(
+    const uint32_t& retention_days = SPAM_RETENTION_DAYS,
+    const uint32_t& batch_size = SPAM_PRUNE_BATCH
+  );
+
+  /**
+   * @brief Removes rows of deleted quacks, users and lists in one short transaction.
+   *
+   * Deletions are worked through oldest first, quacks before users and lists. The
+   * transaction commits once it has removed `max_rows` rows or run for `max_time`, so
+   * other sessions never wait long for the write lock; call it again until it returns 0.
+   *
+   * @param max_rows Maximum number of rows to remove.
+   * @param max_time Time after which the transaction commits.
+   * @return The number of rows removed, 0 once no deletion is left to purge, or -1 if
+   *         the transaction failed.
+   */
+  int64_t purgeDeleted(
+    const uint32_t& max_rows = PURGE_BATCH,
+    const std::chrono::milliseconds& max_time = PURGE_SLICE
+  );
+
+  /**
+   * @brief Retrieves the quacks that mention a user, newest first.
+   *
+   * @param user_id The unique ID of the mentioned user.
+   * @return The IDs of the mentioning quacks.
+   */
+  std::vector<int32_t> getMentions(
+    const int32_t& user_id
+  );
+
+  /**
+   * @brief Retrieves one page of a user's notifications, newest first.
+   *
+   * Pages are addressed by cursor rather than offset: pass the `nid` of the last
+   * notification of the previous page as `before` to read the next one. Each page is a
+   * single range read of the inbox index.
+   *
+   * @param user_id The unique ID of the user.
+   * @param before Only notifications older than this `nid` are returned; 0 starts at the
+   *        newest notification.
+   * @param limit The maximum number of notifications to return.
+   * @return The notifications of the page; empty once the inbox is exhausted.
+   */
+  std::vector<Pond::Notification> getNotifications(
+    const int32_t& user_id,
+    const int64_t& before = 0,
+    const uint32_t& limit = NOTIFICATION_PAGE_SIZE
+  );
+
+  /**
+   * @brief Retrieves the number of notifications a user has not read yet.
+   *
+   * @param user_id The unique ID of the user.
+   * @return The unread count; 0 if the user has never been notified.
+   */
+  uint32_t getUnreadNotificationCount(
+    const int32_t& user_id
+  );
+
+  /**
+   * @brief Marks every notification currently in a user's inbox as read.
+   *
+   * @param user_id The unique ID of the user.
+   * @return true if the inbox was updated; false otherwise.
+   */
+  bool markNotificationsRead(
+    const int32_t& user_id
+  );
+
   /**
    * @brief Retrieves the username associated with a given user ID from the database.
    *
@@ -317,6 +1127,16 @@ public:
     const int32_t& quack_id
   );
 
+  /**
+   * @brief Retrieves several quacks by ID, reusing one prepared statement.
+   *
+   * @param quack_ids The unique IDs of the quacks to retrieve.
+   * @return One quack per ID, in the same order; `tid` is 0 for an ID that does not exist.
+   */
+  std::vector<Pond::Quack> getQuacksFromIDs(
+    const std::vector<int32_t>& quack_ids
+  );
+
   /**
    * @brief Retrieves the list of followers for a specified user.
    *
@@ -379,7 +1199,271 @@ public:
   );
 
 private:
+  friend class SearchPlanner;   // plans searches over the connection, text scan and word matcher
+
   sqlite3* _db;
+  std::shared_ptr<Pond::Indexes> _indexes;
+  int64_t _write_index_version = -1;   // index version when this connection's write began; -1 otherwise
+  uint64_t _write_index_loads = 0;     // index loads when this connection's write began
+  std::function<bool()> _interrupt_check;
+  Pond::LockStats _lock_stats;
+  uint64_t _lock_wait_us = 0;   // time slept by the current lock wait
+  PerfCounters* _profiler = nullptr;
+  std::minstd_rand _backoff_random{std::random_device{}()};
+  std::shared_ptr<Pond::Caches> _caches;
+  bool _owns_caches = true;       // false once given another connection's caches as a filler
+  uint64_t _pressure_callback = 0;   // ID of the callback releasing this connection's memory
+  std::atomic<bool> _release_memory{false};   // set by the callback, acted on by `_relieveMemoryPressure`
+  int64_t _caches_version = -1;   // data_version last checked against the caches; -1 if never
+
+  /**
+   * @brief Invalidates the caches if another connection has changed the database since
+   *        this connection last checked.
+   *
+   * @return The cache generation to stamp results computed from now on.
+   */
+  uint64_t _validateCaches();
+
+  /**
+   * @brief Releases this connection's page cache if the cache manager asked for memory
+   *        back since the last call.
+   */
+  void _relieveMemoryPressure();
+
+  /**
+   * @brief Invalidates the caches after a write through this connection.
+   */
+  void _invalidateCaches();
+
+  /**
+   * @brief Computes the key of a feed in the feed cache.
+   *
+   * @param user_id The user whose feed it is.
+   * @param mode The feed mode.
+   * @return The key.
+   */
+  static int64_t _feedKey(const int32_t& user_id, const Pond::FeedMode& mode);
+
+  /**
+   * @brief Builds the in-memory search indexes (completion tries and fuzzy name index)
+   *        if they are missing or the database has changed since they were built.
+   *
+   * @param[out] lock Receives `search_lock`, held whether or not the indexes are current.
+   * @return true if the indexes are current; false if they could not be built.
+   */
+  bool _refreshSearchIndexes(std::unique_lock<std::mutex>& lock);
+
+  /**
+   * @brief Splits a user name into its distinct lowercase words.
+   *
+   * @param name The user's name.
+   * @return The words the name is fuzzy-searched by.
+   */
+  static std::vector<std::string> _nameWords(
+    const std::string& name
+  );
+
+  /**
+   * @brief Normalizes a term into the key it is completed by.
+   *
+   * @param term The hashtag or user name.
+   * @return The term in lowercase, without a leading `#`.
+   */
+  static std::string _completionKey(
+    const std::string& term
+  );
+
+  /**
+   * @brief Registers Pond's native SQL functions on the open connection.
+   *
+   * @return true if every function was registered; false otherwise.
+   */
+  bool _registerFunctions();
+
+  /**
+   * @brief SQLite progress handler that polls `_interrupt_check`.
+   *
+   * @param pond The Pond whose check is polled.
+   * @return Non-zero to interrupt the running statement.
+   */
+  static int _progressHandler(void* pond);
+
+  /**
+   * @brief SQLite busy handler that retries a locked statement with jittered
+   *        exponential backoff, for up to `BUSY_TIMEOUT_MS`.
+   *
+   * @param pond The Pond whose connection is waiting.
+   * @param attempt The number of times the handler was already called for this lock.
+   * @return Non-zero to retry the statement; 0 to fail it with `SQLITE_BUSY`.
+   */
+  static int _busyHandler(void* pond, int attempt);
+
+  /**
+   * @brief Starts a write transaction, taking the write lock up front, unless the caller
+   *        is already inside a transaction.
+   *
+   * @param[out] own_transaction Whether this call started the transaction.
+   * @return true if the write can go ahead; false if the lock could not be taken.
+   */
+  bool _beginWrite(bool& own_transaction);
+
+  /**
+   * @brief Commits a transaction started by `_beginWrite`, or rolls it back if the write
+   *        failed or the commit does.
+   *
+   * @param own_transaction The value `_beginWrite` returned through its parameter.
+   * @param succeeded Whether every statement of the write succeeded.
+   * @return true if the write is (or, within an outer transaction, will be) kept.
+   */
+  bool _endWrite(const bool& own_transaction, const bool& succeeded);
+
+  /**
+   * @brief Implements the SQL function `qk_has_word(text, keyword)`.
+   *
+   * Returns 1 if `keyword` or `#keyword` appears in `text` bounded by spaces or the ends
+   * of the text, comparing ASCII letters case-insensitively; 0 if not; NULL if either
+   * argument is NULL.
+   *
+   * @param context The SQLite function context.
+   * @param argc The number of arguments (always 2).
+   * @param argv The `text` and `keyword` arguments.
+   */
+  static void _hasWordFunction(
+    sqlite3_context* context,
+    int argc,
+    sqlite3_value** argv
+  );
+
+  /**
+   * @brief Checks whether a keyword appears in a text as a whole, space-bounded word.
+   *
+   * @param text The text to scan.
+   * @param size The length of `text` in bytes.
+   * @param keyword The keyword, already lowercased.
+   * @return true if `keyword` or `#keyword` starts a word and ends one; false otherwise.
+   */
+  static bool _hasWord(
+    const char* text,
+    const size_t& size,
+    const std::string& keyword
+  );
+
+  /**
+   * @brief Creates the derived tables Pond maintains alongside the base schema.
+   *
+   * Databases created from older copies of `schema.sql` do not contain the derived
+   * tables, so they are created with `IF NOT EXISTS` every time a database is loaded.
+   *
+   * @return true if every table exists after the call; false otherwise.
+   */
+  bool _ensureSchema();
+
+  /**
+   * @brief Adds a column to a base table of a database created before the column existed.
+   *
+   * @param table The table.
+   * @param column The column's name.
+   * @param type The column's declared type.
+   * @return true if the column exists after the call; false otherwise.
+   */
+  bool _ensureColumn(
+    const char* table,
+    const char* column,
+    const char* type
+  );
+
+  /**
+   * @brief Loads the follower sketch of a user, building it from `follows` if needed.
+   *
+   * @param user_id The unique ID of the user whose followers are sketched.
+   * @param[out] sketch The sketch that will hold the user's followers.
+   * @param store Whether a sketch built here is stored; only inside a write.
+   * @return true if the sketch was loaded or built; false if an error occurred.
+   */
+  bool _loadFollowerSketch(
+    const int32_t& user_id,
+    HyperLogLog& sketch,
+    const bool& store
+  );
+
+  /**
+   * @brief Adds a new follower to a user's stored follower sketch.
+   *
+   * If the user has no stored sketch yet, nothing is done; it will be built from the
+   * `follows` table (including the new follower) the first time it is needed.
+   *
+   * @param user_id The unique ID of the user being followed.
+   * @param follower_id The unique ID of the new follower.
+   * @return true if the sketch is up to date; false if an error occurred.
+   */
+  bool _addFollowerToSketch(
+    const int32_t& user_id,
+    const int32_t& follower_id
+  );
+
+  /**
+   * @brief Computes how deep in a quack's cascade a new requack sits.
+   *
+   * A requacker who follows the author is at depth 1. Otherwise the depth is one more
+   * than the shallowest requacker of the quack they follow, or 1 if they follow none.
+   *
+   * @param quack_id The unique ID of the quack being requacked.
+   * @param user_id The unique ID of the requacker.
+   * @param writer_id The unique ID of the quack's author.
+   * @return The cascade depth of the requack.
+   */
+  uint32_t _getCascadeDepth(
+    const int32_t& quack_id,
+    const int32_t& user_id,
+    const int32_t& writer_id
+  );
+
+  /**
+   * @brief Folds a new requack into the quack's reach sketch and cascade depth.
+   *
+   * @param quack_id The unique ID of the requacked quack.
+   * @param user_id The unique ID of the requacker.
+   * @param writer_id The unique ID of the quack's author.
+   * @return true if the reach was updated; false if an error occurred.
+   */
+  bool _updateReach(
+    const int32_t& quack_id,
+    const int32_t& user_id,
+    const int32_t& writer_id
+  );
+
+  /**
+   * @brief Builds a quack's reach sketch from scratch by replaying its requacks.
+   *
+   * @param quack_id The unique ID of the quack.
+   * @param[out] reach The quack's reach sketch.
+   * @param[out] max_depth The deepest requack chain.
+   * @param store Whether to store the sketch, the depths and any follower sketch built
+   *              on the way; only inside a write.
+   * @return true if the sketch was built, and stored if asked; false if the quack does
+   *         not exist or an error occurred.
+   */
+  bool _buildReach(
+    const int32_t& quack_id,
+    HyperLogLog& reach,
+    uint32_t& max_depth,
+    const bool& store
+  );
+
+  /**
+   * @brief Works out the cascade depth of a requack being replayed, from the depths of
+   *        the quack's requacks known so far.
+   *
+   * @param user_id The unique ID of the requacker.
+   * @param writer_id The unique ID of the quack's author.
+   * @param depths The depth of each requacker of the quack known so far.
+   * @return The cascade depth of the requack.
+   */
+  uint32_t _replayCascadeDepth(
+    const int32_t& user_id,
+    const int32_t& writer_id,
+    const std::unordered_map<int32_t, uint32_t>& depths
+  );
 
 /**
  * @brief Generates a unique ID for a new user by determining the maximum existing user ID.
@@ -419,19 +1503,151 @@ private:
     int32_t& unique_id
   );
   
+  /**
+   * @brief Builds the engagement counters from the base tables the first time a
+   *        database is loaded with ranked-feed support.
+   *
+   * @return true if the counters exist; false if building them failed.
+   */
+  bool _ensureEngagementCounters();
+
+  /**
+   * @brief Creates the counter of changes to the tables the in-memory indexes are built
+   *        from, and the triggers that count them, the first time a database is loaded.
+   *
+   * @return true if the counter exists; false if creating it failed.
+   */
+  bool _ensureIndexVersion();
+
+  /**
+   * @brief Adjusts the engagement counters of a quack.
+   *
+   * @param quack_id The unique ID of the quack.
+   * @param requacks Change in legitimate requacks.
+   * @param replies Change in replies.
+   * @param spam_requacks Change in spam-flagged requacks.
+   * @return true if the counters were updated; false otherwise.
+   */
+  bool _bumpQuackStats(
+    const int32_t& quack_id,
+    const int32_t& requacks,
+    const int32_t& replies,
+    const int32_t& spam_requacks
+  );
+
+  /**
+   * @brief Strengthens a viewer's affinity with an author after an interaction.
+   *
+   * @param viewer_id The unique ID of the user who interacted.
+   * @param author_id The unique ID of the user they interacted with.
+   * @param weight How much the interaction adds to the affinity.
+   * @return true if the affinity was updated; false otherwise.
+   */
+  bool _bumpAffinity(
+    const int32_t& viewer_id,
+    const int32_t& author_id,
+    const int32_t& weight
+  );
+
+  /**
+   * @brief Formats a feed entry the way it is displayed in the feed.
+   *
+   * @param entry The entry to format.
+   * @return The formatted entry.
+   */
+  std::string _formatFeedEntry(
+    const Pond::FeedEntry& entry
+  );
+
+  /**
+   * @brief Extracts the `@name` and `@id` mentions of a new quack and notifies the
+   *        mentioned users.
+   *
+   * @param quack_id The unique ID of the quack.
+   * @param author_id The unique ID of the quack's author.
+   * @param text The text of the quack.
+   * @param notified_id A user who was already notified about this quack and is not
+   *        notified again, or 0.
+   * @return true if every mention was recorded; false otherwise.
+   */
+  bool _recordMentions(
+    const int32_t& quack_id,
+    const int32_t& author_id,
+    const std::string& text,
+    const int32_t& notified_id
+  );
+
+  /**
+   * @brief Appends a notification to a user's inbox and bumps their unread count.
+   *
+   * Users are never notified about their own actions.
+   *
+   * @param user_id The unique ID of the user to notify.
+   * @param kind The kind of event.
+   * @param actor_id The unique ID of the user who caused the event.
+   * @param quack_id The unique ID of the quack involved, or 0.
+   * @param text The text of the quack involved, shortened into the snippet.
+   * @return true if the notification was written or skipped; false otherwise.
+   */
+  bool _notify(
+    const int32_t& user_id,
+    const Pond::NotificationKind& kind,
+    const int32_t& actor_id,
+    const int32_t& quack_id,
+    const std::string& text
+  );
+
+  /**
+   * @brief Bumps the current hour, day and month buckets of an activity by one.
+   *
+   * @param activity The kind of activity that just happened.
+   * @return true if the rollups were updated; false otherwise.
+   */
+  bool _recordActivity(
+    const Pond::Activity& activity
+  );
+
+  /**
+   * @brief Adds the sum of one bucket range to a running total.
+   *
+   * @param activity The kind of activity to sum.
+   * @param granularity The bucket size to read.
+   * @param from Inclusive first bucket key.
+   * @param to Exclusive last bucket key.
+   * @param[out] total The running total to add to.
+   * @return true if the range was read; false otherwise.
+   */
+  bool _sumActivity(
+    const Pond::Activity& activity,
+    const Pond::Granularity& granularity,
+    const std::string& from,
+    const std::string& to,
+    uint64_t& total
+  );
+
+  /**
+   * @brief Retrieves the name an activity is stored under in the rollup table.
+   *
+   * @param activity The kind of activity.
+   * @return The stored metric name.
+   */
+  static const char* _activityName(
+    const Pond::Activity& activity
+  );
+
   /**
   * @brief Retrieves the current time in GMT as a formatted string (HH:MM:SS).
   *
   * @return A string representing the current time in "HH:MM:SS" format.
   */
-  char* _getTime();
+  std::string _getTime();
   
   /**
   * @brief Retrieves the current date in GMT as a formatted string (YYYY-MM-DD).
   *
   * @return A string representing the current date in "YYYY-MM-DD" format.
   */
-  char* _getDate();
+  std::string _getDate();
 
   /**
    * @brief Checks if a list exists for a given user in the database.
@@ -449,6 +1665,46 @@ private:
     const int32_t& user_id
   );
 
+  /**
+   * @brief Checks whether a quack or user exists and has not been deleted.
+   *
+   * A quack is also gone once its author or the quack it replies to is deleted.
+   *
+   * @param kind `DeletedKind::QUACK` or `DeletedKind::USER`.
+   * @param id The quack or user ID.
+   * @return true if the quack or user can be read.
+   */
+  bool _isLive(
+    const Pond::DeletedKind& kind,
+    const int32_t& id
+  );
+
+  /**
+   * @brief Records a deletion of a user or a list, hiding the deleted rows from every read.
+   *
+   * @param query An `INSERT OR IGNORE INTO tombstones` statement.
+   * @param bind Binds the statement's parameters.
+   * @return true if a tombstone was added; false if there was nothing to delete.
+   */
+  bool _addTombstone(
+    const char* query,
+    const std::function<void(sqlite3_stmt*)>& bind
+  );
+
+  /**
+   * @brief Takes the notifications a deletion is about to hide out of their users'
+   *        unread counts.
+   *
+   * @param match The condition on `live_notifications n` selecting the notifications,
+   *        with the deleted ID as `?1`.
+   * @param id The ID of the deleted quack or user.
+   * @return true if the counts were adjusted; false if the write failed.
+   */
+  bool _hideNotifications(
+    const std::string& match,
+    const int32_t& id
+  );
+
   /**
    * @brief Formats a tweet's text to fit within a specified line width.
    *
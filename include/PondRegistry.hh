@@ -0,0 +1,301 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "AsyncPond.hh"
+#include "Pond.hh"
+
+/**
+ * @class PondRegistry
+ * @brief Hosts many Pond databases, one per tenant, in one process.
+ *
+ * Every tenant is a database file with a name, e.g. one community. Tenants share one
+ * pool of I/O threads; each call names its tenant through that tenant's `AsyncPond`
+ * facade, and the next free thread runs it on one of the tenant's connections. Tenants
+ * with queued calls take turns, one call each, so a busy tenant cannot starve a quiet
+ * one, and a tenant never holds more connections than its quota allows.
+ *
+ * Connections are opened when a tenant is first called and closed once they have been
+ * idle for `Options::idle_timeout`; a tenant with no open connection costs a few
+ * hundred bytes. A tenant's connections share one set of read caches, which sits in its
+ * own `CacheManager` group, so every tenant draws from the process-wide memory budget
+ * within its quota, and one set of in-memory indexes, which a write through any of them
+ * keeps current for all.
+ *
+ * ### Features:
+ * - Register tenants one by one or every `*.db` file of a directory.
+ * - Share the I/O threads fairly, with a per-tenant cap on concurrent connections.
+ * - Open connections lazily, close idle ones, and close the least recently used idle
+ *   connection early when more than `Options::max_open` are open.
+ * - Cap each tenant's read caches and SQLite page cache.
+ * - Run background jobs, e.g. purging deleted rows, when no call is waiting.
+ * - Report calls, queueing, connections and cache memory per tenant.
+ */
+class PondRegistry
+{
+public:
+  /**
+   * @brief Resources one tenant may use.
+   */
+  struct Quota {
+    uint32_t max_connections = 2;            // open connections, and so concurrent calls
+    size_t cache_bytes = size_t(4) << 20;    // read caches together; 0 for no cap
+    uint32_t page_cache_kib = 512;           // SQLite page cache of each connection
+  };
+
+  /**
+   * @brief Configuration of a registry.
+   */
+  struct Options {
+    uint32_t io_threads = 1;
+    std::chrono::seconds idle_timeout{60};
+    uint32_t max_open = 256;   // connections across tenants before idle ones are closed early
+    Quota quota;               // of tenants added without their own
+  };
+
+  /**
+   * @brief Counters of one tenant.
+   */
+  struct TenantStats {
+    std::string name;
+    uint64_t calls = 0;           // calls run, failed ones included
+    uint64_t background = 0;      // background job steps run
+    uint64_t opens = 0;
+    uint64_t closes = 0;
+    uint64_t failures = 0;        // connections that could not be opened
+    double wait_ms = 0;           // total time calls spent queued
+    uint32_t open = 0;            // connections open now
+    uint32_t busy = 0;            // of which running a call
+    size_t queued = 0;
+    size_t cache_bytes = 0;
+  };
+
+  /**
+   * @brief Counters of the whole registry.
+   */
+  struct Stats {
+    uint32_t open = 0;
+    uint64_t opens = 0;
+    uint64_t closes = 0;
+    std::vector<TenantStats> tenants;
+  };
+
+  /**
+   * @brief Starts the I/O threads; no tenant is registered yet.
+   *
+   * @param options The configuration of the registry.
+   */
+  PondRegistry(const Options& options);
+
+  /**
+   * @brief Finishes every queued call, drops queued background jobs, then stops the
+   *        I/O threads and closes every connection.
+   */
+  ~PondRegistry();
+
+  PondRegistry(const PondRegistry&) = delete;
+  PondRegistry& operator=(const PondRegistry&) = delete;
+
+  /**
+   * @brief Registers a tenant with the default quota.
+   *
+   * @param name The tenant's name: letters, digits, `-` and `_`.
+   * @param db_filename The tenant's database file; it is not opened yet.
+   * @return true if the tenant was added; false if the name is invalid or taken.
+   */
+  bool add(const std::string& name, const std::string& db_filename);
+
+  /**
+   * @brief Registers a tenant.
+   *
+   * @param name The tenant's name: letters, digits, `-` and `_`.
+   * @param db_filename The tenant's database file; it is not opened yet.
+   * @param quota The tenant's quota.
+   * @return true if the tenant was added; false if the name is invalid or taken.
+   */
+  bool add(const std::string& name, const std::string& db_filename, const Quota& quota);
+
+  /**
+   * @brief Registers every `<name>.db` file of a directory as tenant `<name>`.
+   *
+   * @param directory The directory.
+   * @return The number of tenants added.
+   */
+  size_t addDirectory(const std::string& directory);
+
+  /**
+   * @brief Retrieves the facade through which a tenant is called.
+   *
+   * @param name The tenant's name.
+   * @return The facade, valid for the registry's lifetime, or nullptr if there is no
+   *         such tenant.
+   */
+  AsyncPond* tenant(const std::string& name);
+
+  /**
+   * @brief Retrieves the names of every tenant.
+   *
+   * @return The names, sorted.
+   */
+  std::vector<std::string> tenants() const;
+
+  /**
+   * @brief Queues a background job for a tenant, run when no call is waiting.
+   *
+   * @param name The tenant's name.
+   * @param step Called with one of the tenant's connections; returning true queues
+   *             it again, e.g. until a purge has nothing left.
+   * @return true if the job was queued; false if there is no such tenant.
+   */
+  bool background(const std::string& name, std::function<bool(Pond&)> step);
+
+  /**
+   * @brief Queues a background purge of a tenant's deleted rows.
+   *
+   * @param name The tenant's name.
+   * @return true if the purge was queued; false if there is no such tenant.
+   */
+  bool purge(const std::string& name);
+
+  /**
+   * @brief Closes every connection idle for longer than `Options::idle_timeout`.
+   *
+   * Called by the I/O threads when they have been idle themselves; calling it directly
+   * is only needed to reclaim memory at once.
+   *
+   * @return The number of connections closed.
+   */
+  size_t closeIdle();
+
+  /**
+   * @brief Retrieves the counters of the registry and every tenant.
+   *
+   * @return A snapshot of the counters.
+   */
+  Stats stats() const;
+
+  /**
+   * @brief Prints the counters as a table, one row per tenant.
+   *
+   * @param out The stream to print to.
+   */
+  void report(std::ostream& out) const;
+
+private:
+  friend class AsyncPond;
+
+  using Clock = std::chrono::steady_clock;
+
+  struct Job {
+    std::function<void(Pond*)> run;
+    Clock::time_point queued;
+  };
+
+  struct Connection {
+    std::unique_ptr<Pond> pond;
+    Clock::time_point last_used;
+  };
+
+  /**
+   * @brief What a tenant's connections share, released once none of them is open.
+   */
+  struct Shared {
+    std::shared_ptr<Pond::Caches> caches;
+    std::shared_ptr<Pond::Indexes> indexes;
+  };
+
+  struct Tenant {
+    std::string name;
+    std::string db_filename;
+    Quota quota;
+    std::unique_ptr<AsyncPond> facade;
+
+    std::deque<Job> jobs;
+    std::deque<std::function<bool(Pond&)>> background;
+    std::vector<Connection> idle;               // most recently used last
+    Shared shared;                              // while any connection is open
+    uint64_t cache_group = 0;
+    uint32_t open = 0;
+    uint32_t busy = 0;
+    bool ready = false;                         // in `_ready`
+    bool background_ready = false;              // in `_background_ready`
+    bool resumed = false;                       // leftover deletions queued for purging
+
+    TenantStats stats;
+  };
+
+  /**
+   * @brief Queues a call for a tenant; called by the tenant's facade.
+   *
+   * @param name The tenant's name.
+   * @param job Called with one of the tenant's connections, or nullptr if none could
+   *            be opened.
+   */
+  void _submit(const std::string& name, std::function<void(Pond*)> job);
+
+  /**
+   * @brief Retrieves the number of calls queued for a tenant.
+   *
+   * @param name The tenant's name.
+   * @return The queue length.
+   */
+  size_t _queued(const std::string& name) const;
+
+  /**
+   * @brief Puts a tenant in the ready queues it has work for; the caller holds `_lock`.
+   *
+   * @param tenant The tenant.
+   */
+  void _schedule(Tenant& tenant);
+
+  /**
+   * @brief Opens a connection for a tenant, outside `_lock`.
+   *
+   * @param tenant The tenant.
+   * @param shared The tenant's caches and indexes.
+   * @return The connection, or nullptr if it could not be opened.
+   */
+  std::unique_ptr<Pond> _connect(const Tenant& tenant, const Shared& shared);
+
+  /**
+   * @brief Closes idle connections, least recently used first; the caller holds `_lock`.
+   *
+   * @param idle_before Close connections last used before this time.
+   * @param excess Also close this many more, whenever they were last used.
+   * @param[out] closed Receives the closed connections, destroyed outside `_lock`.
+   * @param[out] released Receives the released caches and indexes, destroyed outside `_lock`.
+   */
+  void _closeIdle(const Clock::time_point& idle_before, size_t excess,
+                  std::vector<std::unique_ptr<Pond>>& closed,
+                  std::vector<Shared>& released);
+
+  /**
+   * @brief Runs calls and background jobs on one I/O thread until the registry is
+   *        destroyed.
+   */
+  void _work();
+
+  Options _options;
+  std::vector<std::thread> _threads;
+
+  mutable std::mutex _lock;
+  std::condition_variable _ready_cv;
+  std::map<std::string, std::unique_ptr<Tenant>> _tenants;
+  std::deque<Tenant*> _ready;              // tenants with a queued call and a free connection
+  std::deque<Tenant*> _background_ready;   // tenants with a background job and a free connection
+  uint32_t _open = 0;
+  uint64_t _opens = 0;
+  uint64_t _closes = 0;
+  bool _stopping = false;
+};
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "Pond.hh"
+#include "TaskScheduler.hh"
+
+/**
+ * @class Prefetcher
+ * @brief Loads data the user is likely to ask for next into a Pond's caches.
+ *
+ * Prefetches run as background tasks on a `TaskScheduler`, through a second connection
+ * to the database that shares the foreground Pond's caches, so the foreground thread
+ * finds the results there instead of querying while the user waits. Prefetches only
+ * read; anything written in the meantime invalidates their results like any other
+ * cached data.
+ *
+ * ### Features:
+ * - Load a session's first feed page and profile while its password is checked.
+ * - Load the other feed mode and profiles of users shown in search results.
+ * - Run prefetches one at a time, newest hints first, dropping the oldest once
+ *   `MAX_PENDING` are waiting.
+ * - Open the prefetch connection on first use, off the foreground thread.
+ */
+class Prefetcher
+{
+public:
+  /**
+   * @brief Maximum number of prefetches waiting to run.
+   */
+  static constexpr size_t MAX_PENDING = 32;
+
+  /**
+   * @brief Constructs a prefetcher; no connection is opened until the first prefetch.
+   *
+   * @param db_filename The database the foreground Pond has open.
+   * @param caches The foreground Pond's caches, filled by the prefetches.
+   * @param scheduler The scheduler prefetches run on.
+   */
+  Prefetcher(const std::string& db_filename, std::shared_ptr<Pond::Caches> caches,
+             TaskScheduler& scheduler = TaskScheduler::shared());
+
+  /**
+   * @brief Drops the waiting prefetches and waits for the running one to finish.
+   */
+  ~Prefetcher();
+
+  Prefetcher(const Prefetcher&) = delete;
+  Prefetcher& operator=(const Prefetcher&) = delete;
+
+  /**
+   * @brief Loads what the main page of a session shows first: the user's name, feed
+   *        and followers.
+   *
+   * @param user_id The user logging in.
+   * @param mode The feed mode the main page opens in.
+   */
+  void prefetchSession(const int32_t& user_id, const Pond::FeedMode& mode);
+
+  /**
+   * @brief Loads a user's feed.
+   *
+   * @param user_id The user whose feed is loaded.
+   * @param mode The feed mode.
+   */
+  void prefetchFeed(const int32_t& user_id, const Pond::FeedMode& mode);
+
+  /**
+   * @brief Loads what a user's profile page shows: name, followers, follows and quacks.
+   *
+   * @param user_ids The users whose profiles are loaded, most likely first.
+   */
+  void prefetchProfiles(const std::vector<int32_t>& user_ids);
+
+  /**
+   * @brief Blocks until no prefetch is waiting or running.
+   */
+  void wait();
+
+private:
+  /**
+   * @brief Queues a prefetch and starts a drain task if none is running.
+   *
+   * @param job The prefetch, run with the prefetch connection.
+   */
+  void _enqueue(std::function<void(Pond&)> job);
+
+  /**
+   * @brief Runs queued prefetches until the queue is empty.
+   */
+  void _drain();
+
+  std::string _db_filename;
+  std::shared_ptr<Pond::Caches> _caches;
+  TaskScheduler& _scheduler;
+  std::unique_ptr<Pond> _pond;   // only touched by the drain task
+  bool _unavailable = false;
+
+  std::mutex _lock;
+  std::condition_variable _idle;
+  std::deque<std::function<void(Pond&)>> _pending;
+  bool _draining = false;
+};
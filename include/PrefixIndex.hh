@@ -0,0 +1,136 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * @class PrefixIndex
+ * @brief An in-memory compressed trie that maps prefixes to their most popular terms.
+ *
+ * Terms are stored in a radix trie whose edges carry whole substrings, so chains of
+ * single-child nodes collapse into one node and the trie holds roughly one node per
+ * term. Every node caches the `TOP_K` heaviest terms below it, which makes a completion
+ * a walk of at most `prefix.size()` bytes followed by a copy of that cached list.
+ *
+ * ### Features:
+ * - Look up terms by a normalized key while returning their display form.
+ * - Adjust a term's weight incrementally; only the caches on its path are refreshed.
+ * - Complete a prefix with its top terms by weight (ties broken alphabetically).
+ * - Report an estimate of the memory held by the index.
+ */
+class PrefixIndex
+{
+public:
+  /**
+   * @brief Number of completions cached per node.
+   */
+  static constexpr uint32_t TOP_K = 10;
+
+  /**
+   * @brief A completion returned by the index.
+   */
+  struct Entry {
+    std::string term;
+    uint64_t weight;
+  };
+
+  /**
+   * @brief Constructs an empty index.
+   */
+  PrefixIndex();
+
+  /**
+   * @brief Adds to the weight of a term, inserting the term if needed.
+   *
+   * Weights never drop below zero; a term whose weight reaches zero stays completable.
+   *
+   * @param key The normalized key the term is looked up by.
+   * @param display The form of the term returned by completions.
+   * @param delta The change in weight.
+   */
+  void add(const std::string& key, const std::string& display, const int64_t& delta);
+
+  /**
+   * @brief Retrieves the heaviest terms whose key starts with a prefix.
+   *
+   * @param prefix The normalized prefix to complete.
+   * @param k The maximum number of completions to return.
+   * @return The completions, heaviest first.
+   */
+  std::vector<PrefixIndex::Entry> complete(const std::string& prefix, const uint32_t& k) const;
+
+  /**
+   * @brief Removes every term from the index.
+   */
+  void clear();
+
+  /**
+   * @brief Retrieves the number of terms in the index.
+   *
+   * @return The number of distinct keys added.
+   */
+  size_t size() const;
+
+  /**
+   * @brief Estimates the heap memory held by the index.
+   *
+   * @return The approximate number of bytes used by nodes, labels, caches and terms.
+   */
+  size_t memoryUsage() const;
+
+private:
+  /**
+   * @brief A trie node; `label` is the substring on the edge from its parent.
+   */
+  struct Node {
+    std::string label;
+    std::vector<uint32_t> children;
+    int32_t term = -1;
+    std::vector<uint32_t> top;
+  };
+
+  /**
+   * @brief A term stored in the index.
+   */
+  struct Term {
+    std::string display;
+    uint64_t weight;
+  };
+
+  /**
+   * @brief Walks to the node of a key, creating and splitting nodes along the way.
+   *
+   * @param key The key to insert.
+   * @param[out] path The nodes from the root to the key's node.
+   */
+  void _insert(const std::string& key, std::vector<uint32_t>& path);
+
+  /**
+   * @brief Finds the child of a node whose label starts with a byte.
+   *
+   * @param node The index of the parent node.
+   * @param byte The first byte of the child's label.
+   * @return The index of the child, or -1 if there is none.
+   */
+  int64_t _findChild(const uint32_t& node, const char& byte) const;
+
+  /**
+   * @brief Rebuilds a node's cached top terms from its own term and its children's caches.
+   *
+   * @param node The index of the node.
+   */
+  void _refresh(const uint32_t& node);
+
+  /**
+   * @brief Checks whether one term ranks ahead of another.
+   *
+   * @param a The ID of the first term.
+   * @param b The ID of the second term.
+   * @return true if `a` is heavier, or equally heavy and alphabetically first.
+   */
+  bool _ranksBefore(const uint32_t& a, const uint32_t& b) const;
+
+  std::vector<Node> _nodes;
+  std::vector<Term> _terms;
+};
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "Pond.hh"
+#include "TaskScheduler.hh"
+
+/**
+ * @class PurgeWorker
+ * @brief Removes the rows of deleted quacks, users and lists in the background.
+ *
+ * Deleting only writes a tombstone, which hides the deleted rows from every read. The
+ * worker then purges them through its own connection to the database, calling
+ * `Pond::purgeDeleted` until nothing is left: each call is one transaction bounded in
+ * rows and time, and the worker pauses between them so interactive writes waiting on
+ * the lock always get it before the next batch.
+ *
+ * ### Features:
+ * - Purge as a single background task on a `TaskScheduler`, woken after each delete.
+ * - Resume deletions left over from an earlier run the first time it is woken.
+ * - Open the purge connection on first use, off the foreground thread.
+ * - Stop between two transactions when destroyed.
+ */
+class PurgeWorker
+{
+public:
+  /**
+   * @brief Pause between two purge transactions.
+   */
+  static constexpr std::chrono::milliseconds PURGE_PAUSE{10};
+
+  /**
+   * @brief Constructs a worker; no connection is opened until it is first woken.
+   *
+   * @param db_filename The database to purge.
+   * @param scheduler The scheduler the purge runs on.
+   */
+  PurgeWorker(const std::string& db_filename, TaskScheduler& scheduler = TaskScheduler::shared());
+
+  /**
+   * @brief Stops the purge after its current transaction and waits for it.
+   */
+  ~PurgeWorker();
+
+  PurgeWorker(const PurgeWorker&) = delete;
+  PurgeWorker& operator=(const PurgeWorker&) = delete;
+
+  /**
+   * @brief Starts purging unless the purge is already running.
+   */
+  void wake();
+
+  /**
+   * @brief Blocks until the purge has stopped.
+   */
+  void wait();
+
+  /**
+   * @brief Retrieves the number of rows purged so far.
+   *
+   * @return The number of rows.
+   */
+  uint64_t purged() const;
+
+private:
+  /**
+   * @brief Purges until no deletion is left, then marks the worker idle.
+   */
+  void _run();
+
+  std::string _db_filename;
+  TaskScheduler& _scheduler;
+  std::unique_ptr<Pond> _pond;   // only touched by the purge task
+  std::atomic<uint64_t> _purged{0};
+
+  std::mutex _lock;
+  std::condition_variable _idle;
+  bool _running = false;
+  bool _again = false;      // woken while running; purge once more before going idle
+  bool _stopping = false;
+};
@@ -9,10 +9,15 @@
 #include <algorithm>
 #include <numeric>
 #include <iomanip>
+#include <memory>
 #include <termios.h>
 #include <unistd.h>
 
+#include "AdmissionController.hh"
+#include "PerfCounters.hh"
 #include "Pond.hh"
+#include "Prefetcher.hh"
+#include "PurgeWorker.hh"
 
 static const std::string QUACKER_BANNER  = "[38;5;44m [39m[38;5;44m [39m[38;5;44m [39m[38;5;44m_[39m[38;5;44m_[39m[38;5;44m_[39m[38;5;43m_[39m[38;5;49m [39m[38;5;49m [39m[38;5;49m [39m[38;5;49m [39m[38;5;49m [39m[38;5;49m [39m[38;5;49m [39m[38;5;49m [39m[38;5;49m [39m[38;5;48m [39m[38;5;48m [39m[38;5;48m [39m[38;5;48m [39m[38;5;48m [39m[38;5;48m [39m[38;5;48m [39m[38;5;48m [39m[38;5;48m [39m[38;5;84m_[39m[38;5;83m [39m[38;5;83m [39m[38;5;83m [39m[38;5;83m [39m[38;5;83m [39m[38;5;83m [39m[38;5;83m [39m[38;5;83m [39m[38;5;83m [39m[38;5;83m [39m[38;5;83m [39m[38;5;119m [39m[38;5;118m [39m[38;5;118m[39m\n"
 "[38;5;44m [39m[38;5;44m [39m[38;5;44m/[39m[38;5;43m_[39m[38;5;49m_[39m[38;5;49m_[39m[38;5;49m [39m[38;5;49m\\[39m[38;5;49m_[39m[38;5;49m [39m[38;5;49m [39m[38;5;49m [39m[38;5;49m_[39m[38;5;48m [39m[38;5;48m [39m[38;5;48m_[39m[38;5;48m_[39m[38;5;48m [39m[38;5;48m_[39m[38;5;48m [39m[38;5;48m [39m[38;5;48m_[39m[38;5;84m_[39m[38;5;83m_[39m[38;5;83m|[39m[38;5;83m [39m[38;5;83m|[39m[38;5;83m [39m[38;5;83m_[39m[38;5;83m_[39m[38;5;83m_[39m[38;5;83m_[39m[38;5;83m_[39m[38;5;83m [39m[38;5;119m_[39m[38;5;118m [39m[38;5;118m_[39m[38;5;118m_[39m[38;5;118m [39m[38;5;118m [39m[38;5;118m [39m[38;5;118m [39m[38;5;118m [39m[38;5;118m [39m[38;5;154m_[39m[38;5;154m_[39m[38;5;154m[39m\n"
@@ -36,6 +41,8 @@ static const std::string QUACKER_BANNER  = "[38;5;44m [39m[38;5;44m [39m[38
  * - Posting and replying to quacks.
  * - Searching users and quacks with pagination.
  * - Validating user input for email, phone numbers, and IDs.
+ * - Prefetching the feed and profiles the user is likely to open next.
+ * - Optionally profiling database operations and rendering with performance counters.
  */
 class Quacker
 {
@@ -49,17 +56,20 @@ public:
    * a status code of ERROR_SQL.
    *
    * @param db_filename The name of the database file to load.
+   * @param profile Whether to count performance events around database operations
+   *                and rendering, reported when the program exits.
    *
    * @note Ensure that the provided `db_filename` points to a valid and
    * accessible database file to prevent the program from terminating.
    */
-  Quacker(const std::string& db_filename);
+  Quacker(const std::string& db_filename, const bool& profile = false);
 
   /**
    * @brief Destructor for the Quacker class.
    *
    * This destructor clears the console by executing the `clear` system command 
-   * and releases the memory allocated for the `_user_id` member variable.
+   * and releases the memory allocated for the `_user_id` member variable. When
+   * profiling, it prints the performance counter report to `std::cerr`.
    */
   ~Quacker();
 
@@ -125,6 +135,8 @@ private:
    * - Displays the user feed and adjusts the number of visible posts based on user selection.
    * - Validates user input to ensure actions correspond to available menu options.
    * - Provides options for replying to or retweeting posts directly from the feed.
+   * - Toggles between the chronological and the engagement-ranked feed.
+   * - Shows the unread notification count and opens the notifications inbox.
    * - Handles logging out by cleaning up the session and redirecting to the start page.
    */
   void mainPage();
@@ -150,6 +162,7 @@ private:
    *
    * @details
    * - Retrieves and displays search results based on the input query.
+   * - Falls back to a typo-tolerant search when no name contains the query exactly.
    * - Allows users to interact with search results by selecting a user to view or follow.
    * - Handles navigation through paginated search results.
    */
@@ -211,6 +224,7 @@ private:
    * - Users can reply to the Quack, which redirects to the reply interface.
    * - Users can requack the post, with validation to prevent duplicate requacks.
    * - Handles errors during requacking and provides feedback.
+   * - Lets authors delete their own quack, which hides it at once and purges it in the background.
    * - Allows users to exit the interface by selecting the return option.
    */
   void quackPage(const Pond::Quack& reply);
@@ -229,6 +243,34 @@ private:
    * - Handles cases where there are no followers gracefully by displaying an appropriate message.
    */
   void followersPage();
+
+  /**
+   * @brief Displays the user's notifications inbox.
+   *
+   * Shows mentions, replies, requacks and new followers, newest first, one page at a
+   * time. Notifications that arrived since the inbox was last opened are flagged as new,
+   * and leaving the page marks them all as read.
+   *
+   * @details
+   * - Pages through the inbox with the cursor returned by each page (older/newer).
+   * - Opens the quack behind a mention, reply or requack, or the profile of a new follower.
+   * - Validates user input for navigation and selection.
+   */
+  void notificationsPage();
+
+  /**
+   * @brief Displays what is trending: the most requacked and replied-to quacks and the
+   *        accounts gaining the most followers.
+   *
+   * Every list is read from the in-memory leaderboards, so switching windows is instant.
+   *
+   * @details
+   * - Switches between the past hour, day and week.
+   * - Shows the user's own rank among accounts by followers gained.
+   * - Opens a listed quack, or the profile of a listed account.
+   * - Validates user input for navigation and selection.
+   */
+  void trendingPage();
   
   /**
  * @brief Processes and formats the current user's feed for display.
@@ -244,6 +286,7 @@ private:
  *   - Ensures `FeedDisplayCount` does not go below zero.
  *   - Limits displayed Quacks to the requested count or the maximum available.
  * - Populates a list of visible Quack IDs for interaction with displayed items.
+ * - Uses the chronological or ranked feed depending on `feed_mode`.
  *
  * @param FeedDisplayCount The number of Quacks to display, adjusted as needed.
  * @param error A reference to an error message string, set if display limits are exceeded.
@@ -313,6 +356,22 @@ private:
     std::string str
   );
 
+  /**
+   * @brief Lets the user pick a completion for a search term that ends in `*`.
+   *
+   * Quack searches complete their last keyword against hashtags; user searches
+   * complete the whole term against user names.
+   *
+   * @param search_term The search term, ending in `*`.
+   * @param kind Whether to complete hashtags or user names.
+   * @return The search term with the completed part replaced by the chosen completion,
+   *         or simply without the `*` if none was chosen.
+   */
+  std::string completeSearchTerm(
+    const std::string& search_term,
+    const Pond::CompletionKind& kind
+  );
+
   /**
    * @brief Trims leading and trailing whitespace from a string.
    * 
@@ -355,8 +414,13 @@ private:
   );
 
   Pond pond;
+  std::unique_ptr<Prefetcher> prefetcher;
+  std::unique_ptr<PurgeWorker> purger;
+  std::unique_ptr<PerfCounters> profiler;   // set when profiling
+  AdmissionController admission;            // rate limits of the user's writes
   int32_t* _user_id = nullptr;
   bool logged_in = false;
   std::vector<int32_t> feed_quack_ids;
+  Pond::FeedMode feed_mode = Pond::FeedMode::CHRONOLOGICAL;
 
 };
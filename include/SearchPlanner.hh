@@ -0,0 +1,229 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <sqlite3.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Pond.hh"
+#include "SearchQuery.hh"
+
+/**
+ * @class SearchPlanner
+ * @brief Compiles a parsed search query into an execution plan over Pond's indexes and
+ *        runs it.
+ *
+ * Every term that an index can list is counted before anything is read: hashtags through
+ * `hashtag_mentions_by_term`, authors through `tweets_by_writer`, date ranges through
+ * `tweets_by_date` and replies through `tweets_by_reply`. Text terms have no index; the
+ * in-memory text scan lists the quacks containing them, checking words and phrases as
+ * whole words as it goes.
+ *
+ * A conjunction is driven by its cheapest term. The other terms whose lists are at most
+ * `INTERSECT_RATIO` times longer than the driver's are listed and intersected with it,
+ * or subtracted from it if negated; the rest are checked against the rows that survive.
+ * Exact counts are taken first, and each later count stops once it is too long to be
+ * intersected, so a query costs about as much as its most selective term whatever else
+ * it contains.
+ *
+ * A planner reads through one connection and is meant to serve one search: it keeps the
+ * rows it has read so that no quack is fetched twice.
+ *
+ * ### Features:
+ * - Selectivity estimates from index counts, bounded by the most selective term.
+ * - Conjunctions driven by their cheapest term, with intersections, exclusions and row checks.
+ * - Disjunctions as unions of the lists of their terms.
+ * - A readable explanation of every plan.
+ */
+class SearchPlanner
+{
+public:
+  /**
+   * @brief How much longer than the driver's a list may be and still be intersected
+   *        rather than checked per row.
+   */
+  static constexpr uint64_t INTERSECT_RATIO = 4;
+
+  /**
+   * @brief Budget below which text terms are checked per row without running a scan.
+   */
+  static constexpr uint64_t SCAN_ROWS = 1024;
+
+  /**
+   * @brief How a step of a plan lists its quacks.
+   */
+  enum class Access {
+    HASHTAG_INDEX,
+    AUTHOR_INDEX,
+    DATE_INDEX,
+    REPLY_INDEX,
+    TEXT_SCAN,
+    FULL_SCAN,
+    INTERSECT,
+    UNION,
+    NONE   // cannot be listed, only checked per row
+  };
+
+  /**
+   * @brief What a step does for its parent.
+   */
+  enum class Role {
+    ROOT,
+    DRIVER,      // lists the candidates of a conjunction
+    INTERSECT,   // list intersected with the driver's
+    FILTER,      // checked against each candidate's row
+    EXCLUDE,     // negation whose term's list is subtracted from the driver's
+    BRANCH,      // list added to a union
+    NEGATED      // the term of a negation
+  };
+
+  /**
+   * @brief A step of an execution plan, mirroring a node of the query.
+   */
+  struct Plan {
+    const SearchQuery::Node* node = nullptr;   // nullptr for a full scan driving only filters
+    Access access = Access::NONE;
+    Role role = Role::ROOT;
+    uint64_t estimate = 0;                     // quacks expected to match
+    bool capped = false;                       // counting stopped early: more than `estimate` match
+    uint64_t cost = 0;                         // index entries or candidates read to list them
+    std::vector<int32_t> authors;              // AUTHOR_INDEX: the authors' IDs
+    std::vector<int32_t> candidates;           // TEXT_SCAN: quacks matching the text, ascending
+    bool scanned = false;                      // TEXT_SCAN: `candidates` was filled while planning
+    std::vector<Plan> children;                // a conjunction's driver comes first
+  };
+
+  /**
+   * @brief Constructs a planner reading from a Pond's connection.
+   *
+   * @param pond The Pond to search.
+   */
+  explicit SearchPlanner(Pond& pond);
+
+  /**
+   * @brief Releases the statements prepared by the planner.
+   */
+  ~SearchPlanner();
+
+  SearchPlanner(const SearchPlanner&) = delete;
+  SearchPlanner& operator=(const SearchPlanner&) = delete;
+
+  /**
+   * @brief Compiles a query into a plan.
+   *
+   * @param query The parsed query, which must outlive the plan.
+   * @return The plan.
+   */
+  Plan compile(const SearchQuery::Node& query);
+
+  /**
+   * @brief Runs a plan.
+   *
+   * @param plan The plan, from `compile`.
+   * @param results Set to the matching quacks, newest first.
+   * @return true if every step ran to the end; false if a statement failed.
+   */
+  bool execute(const Plan& plan, std::vector<Pond::Quack>& results);
+
+  /**
+   * @brief Describes a plan, one step per line.
+   *
+   * @param plan The plan.
+   * @return The description.
+   */
+  static std::string explain(const Plan& plan);
+
+private:
+  /**
+   * @brief Compiles one node.
+   *
+   * @param node The node.
+   * @param budget The longest list worth counting; counts stop past it.
+   * @return The node's plan.
+   */
+  Plan _compile(const SearchQuery::Node& node, const uint64_t& budget);
+
+  /**
+   * @brief Compiles a conjunction, choosing its driver, intersections and filters.
+   *
+   * @param node The conjunction.
+   * @param budget The longest list worth counting.
+   * @return The conjunction's plan.
+   */
+  Plan _compileAnd(const SearchQuery::Node& node, const uint64_t& budget);
+
+  /**
+   * @brief Decides how the terms of a conjunction narrow its driver's list.
+   *
+   * @param plan The conjunction, whose only child is its driver.
+   * @param terms The other terms, moved into `plan`.
+   */
+  void _assign(Plan& plan, std::vector<Plan>& terms);
+
+  /**
+   * @brief Lists the quacks matching a step.
+   *
+   * @param plan The step, which must have an access other than NONE.
+   * @return The IDs of the matching quacks, ascending; deleted quacks may be included.
+   */
+  std::vector<int32_t> _produce(const Plan& plan);
+
+  /**
+   * @brief Checks whether a quack matches a step.
+   *
+   * @param plan The step.
+   * @param quack The quack's row.
+   * @return true if it matches.
+   */
+  bool _matches(const Plan& plan, const Pond::Quack& quack);
+
+  /**
+   * @brief Lists the quacks matching a text term with the in-memory text scan.
+   *
+   * @param node The word, phrase or fragment.
+   * @return The IDs of the matching quacks, newest first.
+   */
+  std::vector<int32_t> _scanText(const SearchQuery::Node& node);
+
+  /**
+   * @brief Reads the rows of quacks not read yet, in one batch.
+   *
+   * @param quack_ids The quacks.
+   */
+  void _fetch(const std::vector<int32_t>& quack_ids);
+
+  /**
+   * @brief Runs a query and collects its first column.
+   *
+   * @param query The SQL query.
+   * @param bind Binds the query's parameters.
+   * @return The values, in the order returned.
+   */
+  std::vector<int32_t> _column(const char* query, const std::function<void(sqlite3_stmt*)>& bind);
+
+  /**
+   * @brief Counts the rows of a query, stopping past a budget.
+   *
+   * @param from The query's `FROM ... WHERE ...` clause.
+   * @param bind Binds the clause's parameters.
+   * @param budget The most rows worth counting.
+   * @param plan Set to the count.
+   */
+  void _count(const std::string& from, const std::function<void(sqlite3_stmt*)>& bind, const uint64_t& budget, Plan& plan);
+
+  /**
+   * @brief Retrieves an upper bound on the number of quacks.
+   *
+   * @return The bound.
+   */
+  uint64_t _total();
+
+  Pond& _pond;
+  std::unordered_map<int32_t, Pond::Quack> _rows;   // rows read so far; `tid` 0 if deleted
+  sqlite3_stmt* _tag_check = nullptr;
+  uint64_t _quacks = 0;                             // `_total`, once known
+  bool _failed = false;                             // a statement failed
+};
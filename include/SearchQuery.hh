@@ -0,0 +1,135 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+/**
+ * @class SearchQuery
+ * @brief Parses the quack search language into a tree of terms and operators.
+ *
+ * A query is a list of terms, all of which must match. Terms can be combined with `OR`
+ * (or a comma, as in older versions), negated with `NOT` or a leading `-`, and grouped
+ * with parentheses; `AND` may be written out but is implied. A term is one of:
+ * - a word, matching it as a whole word or hashtag (`duck`);
+ * - a quoted phrase, matching consecutive whole words (`"rubber duck"`);
+ * - a fragment wrapped in `*`, matching anywhere, even inside a word (`*uck*`);
+ * - a hashtag (`#pond`);
+ * - an author, by user ID or by name without spaces (`from:42`, `from:janedoe`);
+ * - a first or last day, inclusive (`since:2024-01-31`, `until:2024-02-29`);
+ * - `is:reply`, matching replies.
+ *
+ * Parsing never fails: stray parentheses and operators are ignored, an unclosed quote
+ * ends at the end of the query, and a malformed `since:`/`until:` is searched as a word.
+ * The tree is normalized: nested `AND`s and `OR`s are flattened, double negations
+ * removed, and the date bounds of one `AND` merged into a single range.
+ *
+ * ### Features:
+ * - Parse a query into a normalized tree.
+ * - Print a tree back as a canonical query, e.g. for explaining plans.
+ */
+class SearchQuery
+{
+public:
+  /**
+   * @brief The kinds of nodes of a query tree.
+   */
+  enum class Kind {
+    AND,
+    OR,
+    NOT,
+    WORD,
+    PHRASE,
+    FRAGMENT,
+    HASHTAG,
+    AUTHOR,
+    DATES,
+    REPLY
+  };
+
+  /**
+   * @brief A node of a query tree.
+   */
+  struct Node {
+    Kind kind = Kind::AND;
+    std::string text;              // lowercased word, phrase, fragment, hashtag or author
+    std::string since;             // DATES: first day (YYYY-MM-DD), or empty if unbounded
+    std::string until;             // DATES: last day (YYYY-MM-DD), or empty if unbounded
+    std::vector<Node> children;    // AND, OR and NOT
+  };
+
+  /**
+   * @brief Parses a query.
+   *
+   * @param query The query text.
+   * @return The normalized tree; an `AND` without children if the query has no terms.
+   */
+  static Node parse(const std::string& query);
+
+  /**
+   * @brief Prints a tree as a canonical query.
+   *
+   * @param node The tree.
+   * @return The query, with explicit operators and parentheses.
+   */
+  static std::string describe(const Node& node);
+
+private:
+  /**
+   * @brief A lexical token of a query.
+   */
+  struct Token {
+    enum class Type { TERM, AND, OR, NOT, OPEN, CLOSE } type;
+    Node term;   // TERM: the term
+  };
+
+  /**
+   * @brief Splits a query into tokens.
+   *
+   * @param query The query text.
+   * @return The tokens.
+   */
+  static std::vector<Token> _tokenize(const std::string& query);
+
+  /**
+   * @brief Classifies a bare (unquoted) term.
+   *
+   * @param word The term as written.
+   * @return The term's node.
+   */
+  static Node _term(const std::string& word);
+
+  /**
+   * @brief Parses alternatives: `and (OR and)*`.
+   *
+   * @param tokens The tokens.
+   * @param at The next token, advanced past the alternatives.
+   * @return The alternatives' node.
+   */
+  static Node _parseOr(const std::vector<Token>& tokens, size_t& at);
+
+  /**
+   * @brief Parses conjunctions: `unary ([AND] unary)*`.
+   *
+   * @param tokens The tokens.
+   * @param at The next token, advanced past the conjunction.
+   * @return The conjunction's node.
+   */
+  static Node _parseAnd(const std::vector<Token>& tokens, size_t& at);
+
+  /**
+   * @brief Parses a negation, a parenthesized group or a term.
+   *
+   * @param tokens The tokens.
+   * @param at The next token, advanced past what was parsed.
+   * @param node Set to the node parsed.
+   * @return true if a node was parsed; false at the end of a group or of the query.
+   */
+  static bool _parseUnary(const std::vector<Token>& tokens, size_t& at, Node& node);
+
+  /**
+   * @brief Flattens, simplifies and merges date bounds, bottom up.
+   *
+   * @param node The tree to normalize in place.
+   */
+  static void _normalize(Node& node);
+};
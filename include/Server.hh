@@ -0,0 +1,177 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <unordered_map>
+
+#include "AdmissionController.hh"
+#include "AsyncPond.hh"
+#include "EventLoop.hh"
+#include "PondRegistry.hh"
+#include "SessionManager.hh"
+
+/**
+ * @class Server
+ * @brief A line-based network front end to one or many Pond databases.
+ *
+ * One event-loop thread runs every connection as a coroutine, and the SQLite work of
+ * their commands runs on a `PondRegistry`'s I/O threads, so thousands of mostly idle
+ * sessions cost a coroutine frame each rather than a thread each. Serving a directory
+ * hosts each of its `<community>.db` files as a community, chosen per session with
+ * `USE`; serving a file hosts that file alone, already selected.
+ *
+ * ### Protocol:
+ * Every command is one line; every reply starts with `OK` or `ERR`. Replies that carry
+ * rows are `OK <count>` followed by that many tab-separated lines, or, after `FORMAT json`,
+ * that many JSON objects one per line; any other `OK` reply is bare or continues with a
+ * word (e.g. `OK quacked <quack id>`).
+ * - `COMMUNITIES` and `USE <community>`
+ * - `LOGIN <user id> <password>`, replying `OK session <token> <name>`
+ * - `RESUME <token>` and `LOGOUT`
+ * - `FEED [ranked|chronological|more]`
+ * - `QUACK <text>`, `REQUACK <quack id>` and `UNQUACK <quack id>`
+ * - `SEARCH <keywords>` and `USERS <keywords>`
+ * - `FOLLOW <user id>` and `UNFOLLOW <user id>`
+ * - `NOTIFICATIONS [before nid]`
+ * - `FORMAT text|json`
+ * - `HELP` and `QUIT`
+ *
+ * Every command runs under a deadline, and is cancelled if its connection fails. Deleted
+ * quacks disappear at once; the registry removes their rows in the background.
+ *
+ * A login is kept in a `SessionManager` under a token, so later commands, and later
+ * connections through `RESUME`, are authenticated without a database query. A write
+ * rejected because its user has been deleted ends every session of that user. Passwords
+ * are checked on the shared worker pool rather than the I/O threads. The session also
+ * remembers the preferred feed order and how far the feed has been read, so `FEED`
+ * returns one page of `FEED_PAGE` entries and `FEED more` the next.
+ *
+ * Writes pass through an `AdmissionController` of their community before reaching its
+ * database: each user's quacks, requacks, follows and deletions are rate limited, and
+ * the writes admitted take turns, user by user, at the community's write slots. A
+ * rejected write replies `ERR rate limited, retry after <ms> ms`, or `ERR busy, retry
+ * after <ms> ms` if the user already has too many writes waiting, so one client flooding
+ * writes cannot hold back everyone else's.
+ */
+class Server
+{
+public:
+  /**
+   * @brief Configuration of a server.
+   */
+  struct Options {
+    std::string db_filename;       // a database, or a directory of community databases
+    std::string address = "127.0.0.1";
+    uint16_t port = 0;
+    uint32_t io_threads = 1;
+    uint32_t deadline_ms = 2000;   // per command, including time queued
+    uint32_t idle_timeout_s = 60;  // before an unused database connection is closed
+    PondRegistry::Quota quota;     // of each community
+    uint32_t session_timeout_s = 1800;   // before an unused login expires
+    bool json = false;                   // rows of new sessions are JSON lines
+    AdmissionController::Options admission;   // write limits of each community
+  };
+
+  /**
+   * @brief Number of feed entries per `FEED` reply.
+   */
+  static constexpr size_t FEED_PAGE = 20;
+
+  /**
+   * @brief Constructs a server with the given options.
+   *
+   * @param options The configuration of the server.
+   */
+  Server(const Options& options);
+
+  /**
+   * @brief Serves connections until SIGINT or SIGTERM.
+   *
+   * @return true if the server shut down cleanly; false if it could not start.
+   */
+  bool run();
+
+private:
+  /**
+   * @brief State of one client session.
+   */
+  struct Session {
+    std::string tenant;              // empty until `USE` when serving a directory
+    AsyncPond* pond = nullptr;       // the tenant's facade
+    std::string token;               // of the login, set by `LOGIN` and `RESUME`
+    bool json = false;               // rows are JSON lines, set by `FORMAT`
+  };
+
+  /**
+   * @brief Accepts every pending connection and starts a session for each.
+   */
+  void _accept();
+
+  /**
+   * @brief Runs one client session until it quits or disconnects.
+   *
+   * @param connection The client's connection.
+   * @return The session coroutine.
+   */
+  Task<void> _session(std::shared_ptr<Connection> connection);
+
+  /**
+   * @brief Executes one command line and builds its reply.
+   *
+   * @param line The command line.
+   * @param session The session, updated by `USE`, `LOGIN`, `RESUME`, `LOGOUT` and `FORMAT`.
+   * @param hangup Cancelled if the client's connection fails.
+   * @return The reply, ending in a newline.
+   */
+  Task<std::string> _execute(const std::string& line, Session& session, const CancellationToken& hangup);
+
+  /**
+   * @brief Builds the reply to a rejected write, ending the user's sessions if the write
+   *        was rejected because the user has been deleted.
+   *
+   * @param session The session, logged out if the user has been deleted.
+   * @param user_id The unique ID of the user.
+   * @param reply The reply if the user still exists.
+   * @param options The deadline and cancellation of the command.
+   * @return The reply, ending in a newline.
+   */
+  Task<std::string> _rejected(Session& session, const int32_t& user_id, const std::string& reply,
+                              const AsyncPond::CallOptions& options);
+
+  /**
+   * @brief Retrieves the admission controller of a community, creating it on first use.
+   *
+   * @param tenant The community.
+   * @return The controller.
+   */
+  AdmissionController& _admissionOf(const std::string& tenant);
+
+  /**
+   * @brief Formats the error reply of a call that did not complete.
+   *
+   * @param status How the call ended.
+   * @return The reply.
+   */
+  static std::string _failure(const AsyncStatus& status);
+
+  /**
+   * @brief Replaces tabs and line breaks so a field fits in one reply column.
+   *
+   * @param field The field.
+   * @return The field, safe to join with tabs.
+   */
+  static std::string _field(const std::string& field);
+
+  Options _options;
+  // Outlives the loop, so a session frame released with it can still return its slot
+  std::unordered_map<std::string, std::unique_ptr<AdmissionController>> _admissions;   // by community, used on the loop thread
+  std::unique_ptr<EventLoop> _loop;
+  std::unique_ptr<PondRegistry> _registry;
+  std::unique_ptr<SessionManager> _logins;
+  std::string _default_tenant;     // selected for new sessions when serving one file
+  int _listener = -1;
+  uint64_t _sessions = 0;
+};
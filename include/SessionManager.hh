@@ -0,0 +1,222 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+
+#include "Async.hh"
+#include "Pond.hh"
+#include "TaskScheduler.hh"
+
+/**
+ * @class SessionManager
+ * @brief Logged-in sessions of a multi-client server, looked up by token.
+ *
+ * A successful login mints a random 128-bit token; every later request presents the
+ * token and is authenticated by one hash lookup, without touching the database. The
+ * table is split into shards, each with its own lock, so lookups from different threads
+ * rarely contend. A session unused for longer than the idle timeout expires: lookups
+ * ignore it, and each shard drops its expired sessions while creating new ones.
+ *
+ * Checking a password is deliberately slow (see `PasswordHash`), so `verify` runs it on
+ * a `TaskScheduler` and resumes the awaiting coroutine on its own executor; a burst of
+ * logins then occupies the worker pool instead of the threads serving requests.
+ *
+ * ### Features:
+ * - Create, look up, update and remove sessions by token, or every session of a user.
+ * - Keep each session's community, user, feed cursor and feed preference.
+ * - Expire idle sessions lazily, or all at once with `expire`.
+ * - Verify passwords off the request threads, reporting plain-text or weak hashes to
+ *   replace.
+ */
+class SessionManager
+{
+public:
+  /**
+   * @brief Number of independently locked shards.
+   */
+  static constexpr size_t SHARDS = 16;
+
+  /**
+   * @brief State of one logged-in session.
+   */
+  struct Session {
+    std::string tenant;                                          // community the user belongs to
+    int32_t user_id = 0;
+    Pond::FeedMode feed_mode = Pond::FeedMode::CHRONOLOGICAL;    // preferred feed order
+    size_t feed_offset = 0;                                      // feed entries already sent
+    std::chrono::steady_clock::time_point last_used;
+  };
+
+  /**
+   * @brief The outcome of checking a password.
+   */
+  struct Verification {
+    bool valid = false;
+    std::string rehashed;   // a stronger hash to store in place of the old one; empty if none
+  };
+
+  /**
+   * @class Verify
+   * @brief Awaitable that checks a password on the worker pool.
+   *
+   * The check is queued when the awaitable is awaited; the awaiting coroutine resumes
+   * on the executor it suspended on, or on the worker if it had none.
+   */
+  class Verify
+  {
+  public:
+    Verify(TaskScheduler& scheduler, std::string password, std::string stored)
+      : _scheduler(scheduler), _password(std::move(password)), _stored(std::move(stored)) {}
+
+    bool await_ready() const noexcept { return false; }
+
+    void await_suspend(std::coroutine_handle<> handle) {
+      Executor* home = Executor::current();
+      this->_scheduler.submit([this, handle, home] {
+        this->_result = SessionManager::_verify(this->_password, this->_stored);
+        if (home) {
+          home->post([handle] { handle.resume(); });
+        } else {
+          handle.resume();
+        }
+      }, TaskScheduler::Priority::INTERACTIVE);
+    }
+
+    Verification await_resume() { return std::move(this->_result); }
+
+  private:
+    TaskScheduler& _scheduler;
+    std::string _password;
+    std::string _stored;
+    Verification _result;
+  };
+
+  /**
+   * @brief Constructs an empty session table.
+   *
+   * @param idle_timeout How long a session may go unused before it expires.
+   * @param scheduler The worker pool passwords are checked on.
+   */
+  SessionManager(const std::chrono::seconds& idle_timeout = std::chrono::minutes(30),
+                 TaskScheduler& scheduler = TaskScheduler::shared());
+
+  SessionManager(const SessionManager&) = delete;
+  SessionManager& operator=(const SessionManager&) = delete;
+
+  /**
+   * @brief Checks a password against a stored hash on the worker pool.
+   *
+   * An empty `stored` (no such user) is checked against a dummy hash, so an unknown user
+   * takes as long to reject as a wrong password.
+   *
+   * @param password The password entered.
+   * @param stored The stored hash or plain-text password, or empty if there is none.
+   * @return The awaitable check.
+   */
+  Verify verify(const std::string& password, const std::string& stored);
+
+  /**
+   * @brief Starts a session for a logged-in user.
+   *
+   * @param tenant The community the user belongs to.
+   * @param user_id The unique ID of the user.
+   * @return The session's token.
+   */
+  std::string create(const std::string& tenant, const int32_t& user_id);
+
+  /**
+   * @brief Looks up a session and marks it used.
+   *
+   * @param token The session's token.
+   * @return A copy of the session, or nothing if the token is unknown or expired.
+   */
+  std::optional<SessionManager::Session> find(const std::string& token);
+
+  /**
+   * @brief Changes a session and marks it used.
+   *
+   * @param token The session's token.
+   * @param change Called with the session, under its shard's lock.
+   * @return true if the session exists; false if the token is unknown or expired.
+   */
+  bool update(const std::string& token, const std::function<void(Session&)>& change);
+
+  /**
+   * @brief Ends a session.
+   *
+   * @param token The session's token.
+   * @return true if the session existed.
+   */
+  bool remove(const std::string& token);
+
+  /**
+   * @brief Ends every session of a user, e.g. once the user has been deleted.
+   *
+   * @param tenant The community the user belongs to.
+   * @param user_id The unique ID of the user.
+   * @return The number of sessions ended.
+   */
+  size_t revoke(const std::string& tenant, const int32_t& user_id);
+
+  /**
+   * @brief Drops every expired session.
+   *
+   * @return The number of sessions dropped.
+   */
+  size_t expire();
+
+  /**
+   * @brief Retrieves the number of sessions, including expired ones not yet dropped.
+   *
+   * @return The number of sessions.
+   */
+  size_t size() const;
+
+private:
+  /**
+   * @brief One independently locked part of the table.
+   */
+  struct alignas(64) Shard {
+    mutable std::mutex lock;
+    std::unordered_map<std::string, Session> sessions;
+    std::chrono::steady_clock::time_point last_sweep;
+  };
+
+  /**
+   * @brief Checks a password against a stored hash.
+   *
+   * @param password The password entered.
+   * @param stored The stored hash or plain-text password, or empty if there is none.
+   * @return Whether it matches, and the hash to store instead if the old one is weak.
+   */
+  static SessionManager::Verification _verify(const std::string& password, const std::string& stored);
+
+  /**
+   * @brief Retrieves the shard of a token.
+   *
+   * @param token The token.
+   * @return The shard.
+   */
+  Shard& _shard(const std::string& token);
+
+  /**
+   * @brief Drops the expired sessions of a shard; its lock must be held.
+   *
+   * @param shard The shard.
+   * @param now The current time.
+   * @return The number of sessions dropped.
+   */
+  size_t _sweep(Shard& shard, const std::chrono::steady_clock::time_point& now);
+
+  std::chrono::steady_clock::duration _idle_timeout;
+  TaskScheduler& _scheduler;
+  std::array<Shard, SHARDS> _shards;
+};
@@ -0,0 +1,287 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @class TaskScheduler
+ * @brief A work-stealing thread pool shared by Pond's background and parallel work.
+ *
+ * Every worker owns a deque per priority. Tasks submitted from a worker go to the back
+ * of its own deque and are popped from there (newest first, while their data is still
+ * in cache); idle workers steal from the front of other workers' deques (oldest first).
+ * Tasks submitted from other threads go to a shared injection queue.
+ *
+ * Interactive tasks always run before background ones, and background tasks may only
+ * occupy all but one worker at a time, so a burst of batch work cannot keep an
+ * interactive call waiting for a whole batch task to finish.
+ *
+ * ### Features:
+ * - Fire-and-forget submission at interactive or background priority.
+ * - Fork-join through `TaskGroup`; a thread waiting on a group runs queued tasks
+ *   instead of blocking.
+ * - `parallelFor` and `parallelReduce` over index ranges split into chunks.
+ * - Metrics on queue depth, executed tasks and steals.
+ *
+ * Tasks must not throw.
+ */
+class TaskScheduler
+{
+public:
+  /**
+   * @brief Scheduling priority of a task.
+   */
+  enum class Priority {
+    INTERACTIVE,   // work a user is waiting on
+    BACKGROUND     // maintenance and batch jobs
+  };
+
+  /**
+   * @brief A snapshot of the scheduler's counters.
+   */
+  struct Metrics {
+    uint32_t workers;
+    uint64_t submitted;
+    uint64_t executed;
+    uint64_t steals;
+    size_t queued_interactive;
+    size_t queued_background;
+    size_t peak_queued;
+  };
+
+  /**
+   * @class TaskGroup
+   * @brief A set of tasks that can be waited on together.
+   */
+  class TaskGroup
+  {
+  public:
+    /**
+     * @brief Constructs an empty group.
+     *
+     * @param scheduler The scheduler that runs the group's tasks.
+     * @param priority The priority of every task in the group.
+     */
+    TaskGroup(TaskScheduler& scheduler, const Priority& priority = Priority::INTERACTIVE);
+
+    /**
+     * @brief Waits for any tasks still running.
+     */
+    ~TaskGroup();
+
+    TaskGroup(const TaskGroup&) = delete;
+    TaskGroup& operator=(const TaskGroup&) = delete;
+
+    /**
+     * @brief Submits a task to the group.
+     *
+     * @param task The task to run.
+     */
+    void run(std::function<void()> task);
+
+    /**
+     * @brief Runs queued tasks until every task of the group has finished.
+     */
+    void wait();
+
+    /**
+     * @brief Checks whether every task of the group has finished.
+     *
+     * @return true if no task of the group is queued or running.
+     */
+    bool done() const;
+
+  private:
+    TaskScheduler& _scheduler;
+    Priority _priority;
+    std::atomic<size_t> _pending{0};
+    std::mutex _lock;
+    std::condition_variable _finished;
+  };
+
+  /**
+   * @brief Default number of indices per chunk in `parallelFor` and `parallelReduce`.
+   */
+  static constexpr size_t DEFAULT_GRAIN = 1024;
+
+  /**
+   * @brief Starts a scheduler.
+   *
+   * @param threads The number of workers; 0 uses every hardware thread.
+   */
+  explicit TaskScheduler(const uint32_t& threads = 0);
+
+  /**
+   * @brief Runs every queued task, then stops the workers.
+   */
+  ~TaskScheduler();
+
+  TaskScheduler(const TaskScheduler&) = delete;
+  TaskScheduler& operator=(const TaskScheduler&) = delete;
+
+  /**
+   * @brief Retrieves the process-wide scheduler, sized to the machine's cores.
+   *
+   * @return The shared scheduler, started on first use.
+   */
+  static TaskScheduler& shared();
+
+  /**
+   * @brief Queues a task that nobody waits on.
+   *
+   * @param task The task to run.
+   * @param priority The priority of the task.
+   */
+  void submit(std::function<void()> task, const Priority& priority = Priority::BACKGROUND);
+
+  /**
+   * @brief Runs a function over `[begin, end)` in chunks and waits for all of them.
+   *
+   * @param begin The first index.
+   * @param end One past the last index.
+   * @param body Called with the bounds of each chunk.
+   * @param grain The largest number of indices per chunk.
+   * @param priority The priority of the chunks.
+   */
+  void parallelFor(
+    const size_t& begin,
+    const size_t& end,
+    const std::function<void(size_t, size_t)>& body,
+    const size_t& grain = DEFAULT_GRAIN,
+    const Priority& priority = Priority::INTERACTIVE
+  );
+
+  /**
+   * @brief Maps chunks of `[begin, end)` in parallel and folds the results in order.
+   *
+   * @param begin The first index.
+   * @param end One past the last index.
+   * @param identity The result of an empty range.
+   * @param map Called with the bounds of each chunk; returns the chunk's result.
+   * @param reduce Combines two results; applied left to right over the chunks.
+   * @param grain The largest number of indices per chunk.
+   * @param priority The priority of the chunks.
+   * @return The folded result.
+   */
+  template <typename T, typename Map, typename Reduce>
+  T parallelReduce(
+    const size_t& begin,
+    const size_t& end,
+    T identity,
+    const Map& map,
+    const Reduce& reduce,
+    const size_t& grain = DEFAULT_GRAIN,
+    const Priority& priority = Priority::INTERACTIVE
+  ) {
+    const size_t step = std::max<size_t>(grain, 1);
+    const size_t chunks = end > begin ? (end - begin + step - 1) / step : 0;
+    std::vector<T> partials(chunks, identity);
+    this->parallelFor(0, chunks, [&](size_t first, size_t last) {
+      for (size_t chunk = first; chunk < last; ++chunk) {
+        const size_t from = begin + chunk * step;
+        partials[chunk] = map(from, std::min(end, from + step));
+      }
+    }, 1, priority);
+
+    T result = std::move(identity);
+    for (T& partial : partials) {
+      result = reduce(std::move(result), std::move(partial));
+    }
+    return result;
+  }
+
+  /**
+   * @brief Retrieves the number of workers.
+   *
+   * @return The number of worker threads.
+   */
+  uint32_t size() const;
+
+  /**
+   * @brief Retrieves a snapshot of the scheduler's counters.
+   *
+   * @return The current metrics.
+   */
+  TaskScheduler::Metrics metrics() const;
+
+private:
+  /**
+   * @brief A worker's thread and its deques, one per priority.
+   */
+  struct alignas(64) Worker {
+    std::thread thread;
+    mutable std::mutex lock;
+    std::deque<std::function<void()>> queues[2];
+  };
+
+  /**
+   * @brief Queues a task on the current worker, or the injection queue elsewhere.
+   *
+   * @param task The task to run.
+   * @param priority The priority of the task.
+   */
+  void _push(std::function<void()> task, const Priority& priority);
+
+  /**
+   * @brief Takes and runs one queued task.
+   *
+   * @param lowest The lowest priority the caller may run.
+   * @return true if a task was run; false if none was available.
+   */
+  bool _runOne(const Priority& lowest);
+
+  /**
+   * @brief Takes a task of one priority: own deque, then injection queue, then steals.
+   *
+   * @param priority The priority to take.
+   * @param[out] task The task taken.
+   * @return true if a task was taken.
+   */
+  bool _take(const Priority& priority, std::function<void()>& task);
+
+  /**
+   * @brief Checks whether a worker has a task it may run right now.
+   *
+   * @return true if an interactive task is queued, or a background task is queued and
+   *         a background slot is free.
+   */
+  bool _hasRunnable() const;
+
+  /**
+   * @brief Runs tasks until the scheduler stops.
+   *
+   * @param index The index of the worker.
+   */
+  void _work(const uint32_t& index);
+
+  /**
+   * @brief Wakes one sleeping worker.
+   */
+  void _wakeOne();
+
+  std::vector<std::unique_ptr<Worker>> _workers;
+  uint32_t _background_limit;   // background tasks that may run at once
+
+  mutable std::mutex _injection_lock;
+  std::deque<std::function<void()>> _injection[2];
+
+  std::mutex _sleep_lock;
+  std::condition_variable _wake;
+  bool _stopping = false;
+
+  std::atomic<size_t> _queued[2] = {{0}, {0}};
+  std::atomic<uint32_t> _background_running{0};
+  std::atomic<uint64_t> _submitted{0};
+  std::atomic<uint64_t> _executed{0};
+  std::atomic<uint64_t> _steals{0};
+  std::atomic<size_t> _peak_queued{0};
+};
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * @class TermDictionary
+ * @brief A sorted term dictionary searchable by Levenshtein distance.
+ *
+ * Terms are kept sorted, so a search can walk them as if they were the leaves of a trie:
+ * the dynamic-programming row for each prefix of a term is computed once and reused by
+ * every following term that shares the prefix. As soon as every cell of a prefix's row
+ * exceeds the allowed distance, no term with that prefix can match, and the whole
+ * contiguous run of such terms is skipped with a binary search. This is the search a
+ * Levenshtein automaton performs against a sorted dictionary, without building the
+ * automaton.
+ *
+ * ### Features:
+ * - Insert terms, each carrying a list of integer values (e.g. user IDs).
+ * - Find every term within a maximum edit distance of a query, with its distance.
+ * - Bulk-load from scratch, or insert incrementally: recent inserts are buffered and
+ *   merged into the sorted terms in batches.
+ */
+class TermDictionary
+{
+public:
+  /**
+   * @brief Number of buffered inserts that triggers a merge into the sorted terms.
+   */
+  static constexpr size_t MERGE_THRESHOLD = 1024;
+
+  /**
+   * @brief A term found by a search.
+   */
+  struct Match {
+    const std::string* term;
+    uint32_t distance;
+    const std::vector<int32_t>* values;
+  };
+
+  /**
+   * @brief Adds a value under a term, inserting the term if needed.
+   *
+   * @param term The term to index.
+   * @param value The value to store with the term.
+   */
+  void insert(const std::string& term, const int32_t& value);
+
+  /**
+   * @brief Replaces the contents of the dictionary in one sort.
+   *
+   * Preferred over repeated `insert` calls when building from scratch.
+   *
+   * @param postings (term, value) pairs; a term may appear any number of times.
+   */
+  void load(std::vector<std::pair<std::string, int32_t>> postings);
+
+  /**
+   * @brief Finds every term within an edit distance of a query.
+   *
+   * @param query The term to search for.
+   * @param max_distance The largest edit distance accepted.
+   * @return The matching terms in no particular order. Pointers stay valid until the
+   *         next insert or clear.
+   */
+  std::vector<TermDictionary::Match> search(const std::string& query, const uint32_t& max_distance) const;
+
+  /**
+   * @brief Removes every term from the dictionary.
+   */
+  void clear();
+
+  /**
+   * @brief Retrieves the number of distinct terms in the dictionary.
+   *
+   * @return The number of terms.
+   */
+  size_t size() const;
+
+private:
+  /**
+   * @brief A term and the values stored under it.
+   */
+  struct Entry {
+    std::string term;
+    std::vector<int32_t> values;
+  };
+
+  /**
+   * @brief Sorts the buffered inserts into the dictionary.
+   */
+  void _merge();
+
+  /**
+   * @brief Computes one row of the edit-distance table.
+   *
+   * @param query The search query.
+   * @param previous The row of the prefix one byte shorter.
+   * @param byte The byte appended to the prefix.
+   * @param[out] row The row of the longer prefix.
+   * @return The smallest value in the new row.
+   */
+  static uint32_t _nextRow(
+    const std::string& query,
+    const std::vector<uint32_t>& previous,
+    const char& byte,
+    std::vector<uint32_t>& row
+  );
+
+  std::vector<Entry> _sorted;
+  std::vector<Entry> _pending;
+};
@@ -0,0 +1,178 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <sqlite3.h>
+#include <string>
+#include <vector>
+
+#include "IndexVersion.hh"
+#include "TaskScheduler.hh"
+
+/**
+ * @class TextScanEngine
+ * @brief Brute-force, case-insensitive substring search over the text of every quack.
+ *
+ * Token indexes only find whole words; a fragment such as "ack" inside "quacked" can
+ * only be found by reading every quack. The engine keeps the lowercased text of all live
+ * quacks in one contiguous arena, oldest first, each quack followed by a `'\0'`, with an
+ * offset array marking where each one starts. A search splits the arena into chunks of
+ * whole quacks that are scanned in parallel on a `TaskScheduler`.
+ *
+ * On CPUs with AVX2, 32 positions are tested at a time by comparing the first and last
+ * byte of the fragment; only positions where both match are verified byte by byte.
+ * Elsewhere the scan falls back to `memchr` on the first byte. Case is folded for ASCII
+ * letters only; other bytes must match exactly.
+ *
+ * Every connection to a database can share one engine; a lock guards it, and is held
+ * for the length of a search.
+ *
+ * ### Features:
+ * - Loaded lazily from `live_tweets` the first time it is searched.
+ * - Kept current by the connections writing through it with `addQuack` and
+ *   `removeQuacks`, or reloaded after `invalidate`.
+ * - Reloaded when its `IndexVersion` shows a write made outside the connections
+ *   sharing it.
+ */
+class TextScanEngine
+{
+public:
+  /**
+   * @brief Constructs an empty engine, loaded on first search.
+   *
+   * @param scheduler The scheduler the chunks of a search run on.
+   */
+  explicit TextScanEngine(TaskScheduler& scheduler = TaskScheduler::shared());
+
+  /**
+   * @brief Loads the text if it has not been loaded or the database has changed since
+   *        it was.
+   *
+   * @param db The connection to read through.
+   * @return true if the text is current; false if it could not be loaded.
+   */
+  bool refresh(sqlite3* db);
+
+  /**
+   * @brief Forgets the loaded text, so the next search loads it again; for changes a
+   *        connection made without recording them, e.g. deletions.
+   */
+  void invalidate();
+
+  /**
+   * @brief Moves the text past a write whose quacks were recorded in it.
+   *
+   * @param from The version of the tables when the write began.
+   * @param to The version of the tables once the write is done.
+   */
+  void advance(const int64_t& from, const int64_t& to);
+
+  /**
+   * @brief Retrieves the number of loads and invalidations of the text so far.
+   *
+   * @return The count.
+   */
+  uint64_t loads() const;
+
+  /**
+   * @brief Records a quack posted through a connection sharing the engine, as the
+   *        newest one.
+   *
+   * Ignored until the text has been loaded, since the load will read it.
+   *
+   * @param quack_id The unique ID of the quack.
+   * @param text The text of the quack.
+   */
+  void addQuack(const int32_t& quack_id, const std::string& text);
+
+  /**
+   * @brief Takes quacks deleted through a connection sharing the engine out of the text.
+   *
+   * Ignored until the text has been loaded, since the load will leave the quacks out.
+   *
+   * @param quack_ids The unique IDs of the quacks.
+   */
+  void removeQuacks(const std::vector<int32_t>& quack_ids);
+
+  /**
+   * @brief Finds the quacks whose text contains a fragment, ignoring ASCII case.
+   *
+   * @param db The connection to load the text through.
+   * @param fragment The text to look for, anywhere in a quack, even inside a word.
+   * @param limit The most quacks to return; 0 returns every match.
+   * @param accept If set, also checks the lowercased text of each quack containing the
+   *        fragment, e.g. for whole words; called concurrently from the scan's tasks.
+   * @return The IDs of the matching quacks, newest first.
+   */
+  std::vector<int32_t> search(
+    sqlite3* db,
+    const std::string& fragment,
+    const size_t& limit = 0,
+    const std::function<bool(const char*, const size_t&)>& accept = nullptr
+  );
+
+  /**
+   * @brief Retrieves the number of quacks loaded.
+   *
+   * @return The number of quacks in the arena.
+   */
+  size_t size() const;
+
+  /**
+   * @brief Retrieves the memory held by the arena and offsets.
+   *
+   * @return The size in bytes.
+   */
+  size_t bytes() const;
+
+private:
+  /**
+   * @brief Loads the text unless it is current; the caller holds `_lock`.
+   *
+   * @param db The connection to read through.
+   * @return true if the text is current; false if it could not be loaded.
+   */
+  bool _refresh(sqlite3* db);
+
+  /**
+   * @brief Reads the text of every live quack, oldest first, into an empty arena.
+   *
+   * @param db The connection to read through.
+   * @return true if the table was read; false otherwise.
+   */
+  bool _load(sqlite3* db);
+
+  /**
+   * @brief Appends a quack to the arena.
+   *
+   * @param quack_id The unique ID of the quack.
+   * @param text The text, lowercased as it is copied.
+   * @param length The length of the text.
+   */
+  void _append(const int32_t& quack_id, const char* text, const size_t& length);
+
+  /**
+   * @brief Finds the quacks of a range that contain a fragment.
+   *
+   * @param first The index of the first quack.
+   * @param last One past the index of the last quack.
+   * @param needle The lowercased fragment.
+   * @param accept If set, also checks the text of each quack containing the fragment.
+   * @return The IDs of the matching quacks, oldest first.
+   */
+  std::vector<int32_t> _scan(
+    const size_t& first,
+    const size_t& last,
+    const std::string& needle,
+    const std::function<bool(const char*, const size_t&)>& accept
+  ) const;
+
+  TaskScheduler& _scheduler;
+  mutable std::mutex _lock;       // guards everything below; held while loading and scanning
+  IndexVersion _version;
+  std::string _arena;             // lowercased text of every quack, each followed by '\0'
+  std::vector<size_t> _offsets;   // start of each quack in the arena, plus its end
+  std::vector<int32_t> _tids;     // quack IDs, oldest first
+};
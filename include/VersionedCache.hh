@@ -0,0 +1,455 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+
+#include "CacheManager.hh"
+#include "FrequencySketch.hh"
+
+/**
+ * @class VersionedCache
+ * @brief A thread-safe map of computed results, each stamped with the generation of
+ *        the data it was computed from.
+ *
+ * Several caches share one generation counter owned by whoever watches the data.
+ * Bumping the counter invalidates every entry at once; stale entries are dropped when
+ * they are next looked up, or all together the first time room is needed after the
+ * bump, before any current entry is evicted. A result is only stored if the
+ * counter has not moved since its computation started, so a slow reader can never
+ * overwrite the cache with data older than a concurrent write.
+ *
+ * Entries are sized in bytes and kept within a budget set by a `CacheManager`, using
+ * W-TinyLFU: new entries enter a small LRU window, and an entry leaving the window
+ * only displaces an entry of the main segmented LRU if a frequency sketch says it was
+ * used more often recently. One-off lookups therefore cannot flush the entries that
+ * are used again and again.
+ *
+ * ### Features:
+ * - Look up and store results from any thread.
+ * - Expire entries after a fixed time to live, for results that depend on the clock.
+ * - Account the bytes of every entry and stay within the budget the manager sets.
+ * - Admit entries by recent frequency, evicting stale entries before current ones.
+ * - Count hits, misses, evictions, refused and rejected stores, and ghost hits.
+ */
+template <typename Key, typename Value>
+class VersionedCache : public ManagedCache
+{
+public:
+  /**
+   * @brief Share of the budget given to the admission window, in percent.
+   */
+  static constexpr size_t WINDOW_PERCENT = 1;
+
+  /**
+   * @brief Share of the main segment given to entries hit at least twice, in percent.
+   */
+  static constexpr size_t PROTECTED_PERCENT = 80;
+
+  /**
+   * @brief Number of evicted keys remembered to count ghost hits.
+   */
+  static constexpr size_t GHOST_ENTRIES = 1024;
+
+  /**
+   * @brief Measures the bytes a value holds, including what it points to.
+   */
+  using Sizer = std::function<size_t(const Value&)>;
+
+  /**
+   * @brief Constructs an empty cache and registers it with a manager.
+   *
+   * @param name The name the cache is reported under.
+   * @param generation The counter entries are validated against; must outlive the cache.
+   * @param sizer Measures the bytes of a value.
+   * @param ttl How long an entry stays valid, or `duration::max()` for no limit.
+   * @param manager The manager that sets the cache's budget.
+   */
+  VersionedCache(std::string name, const std::atomic<uint64_t>& generation, Sizer sizer,
+                 const std::chrono::steady_clock::duration& ttl = std::chrono::steady_clock::duration::max(),
+                 CacheManager& manager = CacheManager::shared())
+    : _name(std::move(name)), _generation(generation), _sizer(std::move(sizer)), _ttl(ttl), _manager(manager) {
+    this->_manager.add(*this);
+  }
+
+  /**
+   * @brief Unregisters the cache from its manager.
+   */
+  ~VersionedCache() override {
+    this->_manager.remove(*this);
+  }
+
+  VersionedCache(const VersionedCache&) = delete;
+  VersionedCache& operator=(const VersionedCache&) = delete;
+
+  /**
+   * @brief Retrieves a current entry.
+   *
+   * @param key The key to look up.
+   * @return A copy of the value, or nothing if it is missing, stale or expired.
+   */
+  std::optional<Value> get(const Key& key) {
+    const uint64_t hash = _hash(key);
+    std::lock_guard<std::mutex> lock(this->_lock);
+    this->_sketch.increment(hash);
+
+    auto entry = this->_entries.find(key);
+    if (entry == this->_entries.end()) {
+      ++this->_stats.misses;
+      if (this->_ghosts.count(hash)) {
+        ++this->_stats.ghost_hits;
+        ++this->_ghost_hits_since_taken;
+      }
+      return std::nullopt;
+    }
+    if (!this->_current(entry->second, std::chrono::steady_clock::now())) {
+      this->_erase(entry);
+      ++this->_stats.misses;
+      return std::nullopt;
+    }
+    ++this->_stats.hits;
+    this->_touch(entry->second);
+    return entry->second.value;
+  }
+
+  /**
+   * @brief Checks whether a current entry exists, without counting a hit or miss.
+   *
+   * @param key The key to look up.
+   * @return true if `get` would return a value.
+   */
+  bool contains(const Key& key) const {
+    std::lock_guard<std::mutex> lock(this->_lock);
+    auto entry = this->_entries.find(key);
+    return entry != this->_entries.end() && this->_current(entry->second, std::chrono::steady_clock::now());
+  }
+
+  /**
+   * @brief Stores a result unless the data changed while it was computed.
+   *
+   * The result enters the admission window; it may still be refused later, when it
+   * leaves the window, if it was used less often than what it would displace.
+   *
+   * @param key The key to store under.
+   * @param value The result.
+   * @param generation The value of the generation counter read before computing it.
+   * @return true if the result was stored.
+   */
+  bool put(const Key& key, Value value, const uint64_t& generation) {
+    const uint64_t hash = _hash(key);
+    const size_t bytes = this->_sizer(value) + _overhead();
+    {
+      std::lock_guard<std::mutex> lock(this->_lock);
+      if (generation != this->_generation.load(std::memory_order_acquire)) {
+        ++this->_stats.rejected;
+        return false;
+      }
+      this->_sketch.increment(hash);
+
+      auto existing = this->_entries.find(key);
+      if (existing != this->_entries.end()) {
+        this->_erase(existing);
+      }
+      if (bytes > this->_budget) {
+        ++this->_stats.refused;
+        return false;
+      }
+
+      this->_segments[WINDOW].push_front(key);
+      Entry entry{std::move(value), generation, std::chrono::steady_clock::now(), bytes, hash, WINDOW, this->_segments[WINDOW].begin()};
+      this->_entries.emplace(key, std::move(entry));
+      this->_segment_bytes[Segment::WINDOW] += bytes;
+      ++this->_stats.stores;
+      this->_sketch.ensureCapacity(this->_entries.size() * 2);
+      this->_drainWindow();
+    }
+    this->_manager.noteStore();
+    return true;
+  }
+
+  /**
+   * @brief Removes every entry.
+   */
+  void clear() {
+    std::lock_guard<std::mutex> lock(this->_lock);
+    this->_entries.clear();
+    for (std::list<Key>& segment : this->_segments) {
+      segment.clear();
+    }
+    std::fill(std::begin(this->_segment_bytes), std::end(this->_segment_bytes), 0);
+  }
+
+  /**
+   * @brief Retrieves the number of entries held, including stale ones not yet dropped.
+   *
+   * @return The number of entries.
+   */
+  size_t size() const {
+    std::lock_guard<std::mutex> lock(this->_lock);
+    return this->_entries.size();
+  }
+
+  /**
+   * @brief Retrieves the usage counters and sizes.
+   *
+   * @return A snapshot of the counters.
+   */
+  CacheStats stats() const {
+    std::lock_guard<std::mutex> lock(this->_lock);
+    CacheStats stats = this->_stats;
+    stats.name = this->_name;
+    stats.entries = this->_entries.size();
+    stats.bytes = this->_bytes();
+    stats.budget = this->_budget;
+    return stats;
+  }
+
+  CacheStats cacheStats() const override {
+    return this->stats();
+  }
+
+  void setBudget(const size_t& bytes) override {
+    std::lock_guard<std::mutex> lock(this->_lock);
+    this->_budget = bytes;
+    this->_sweep();
+    this->_drainWindow();
+    while (this->_bytes() > this->_budget) {
+      this->_evict(this->_victim());
+    }
+  }
+
+  uint64_t takeGhostHits() override {
+    std::lock_guard<std::mutex> lock(this->_lock);
+    const uint64_t ghost_hits = this->_ghost_hits_since_taken;
+    this->_ghost_hits_since_taken = 0;
+    return ghost_hits;
+  }
+
+private:
+  enum Segment { WINDOW, PROBATION, PROTECTED, SEGMENT_COUNT };
+
+  struct Entry {
+    Value value;
+    uint64_t generation;
+    std::chrono::steady_clock::time_point stored;
+    size_t bytes;
+    uint64_t hash;
+    Segment segment;
+    typename std::list<Key>::iterator position;
+  };
+
+  using EntryMap = std::unordered_map<Key, Entry>;
+
+  /**
+   * @brief Hashes a key for the frequency sketch and the ghost list.
+   */
+  static uint64_t _hash(const Key& key) {
+    return static_cast<uint64_t>(std::hash<Key>()(key));
+  }
+
+  /**
+   * @brief Estimates the bytes an entry costs beyond its value's own allocations.
+   */
+  static constexpr size_t _overhead() {
+    return sizeof(Key) * 2 + sizeof(Entry) + 8 * sizeof(void*);
+  }
+
+  /**
+   * @brief Checks whether an entry is of the current generation and within its time to live.
+   *
+   * @param entry The entry.
+   * @param now The current time.
+   * @return true if the entry may be returned.
+   */
+  bool _current(const Entry& entry, const std::chrono::steady_clock::time_point& now) const {
+    return entry.generation == this->_generation.load(std::memory_order_acquire) &&
+           now - entry.stored <= this->_ttl;
+  }
+
+  /**
+   * @brief Adds up the bytes of every segment.
+   */
+  size_t _bytes() const {
+    return this->_segment_bytes[WINDOW] + this->_segment_bytes[PROBATION] + this->_segment_bytes[PROTECTED];
+  }
+
+  /**
+   * @brief Moves an entry to the front of a segment.
+   *
+   * @param entry The entry.
+   * @param segment The segment it moves to.
+   */
+  void _move(Entry& entry, const Segment& segment) {
+    std::list<Key>& from = this->_segments[entry.segment];
+    std::list<Key>& to = this->_segments[segment];
+    to.splice(to.begin(), from, entry.position);
+    this->_segment_bytes[entry.segment] -= entry.bytes;
+    this->_segment_bytes[segment] += entry.bytes;
+    entry.segment = segment;
+  }
+
+  /**
+   * @brief Records a hit: window and protected entries move to the front of their
+   *        segment, and probation entries are promoted to protected, demoting the
+   *        least recently used protected entries if it overflows.
+   *
+   * @param entry The entry hit.
+   */
+  void _touch(Entry& entry) {
+    if (entry.segment != PROBATION) {
+      this->_move(entry, entry.segment);
+      return;
+    }
+    this->_move(entry, PROTECTED);
+    const size_t protected_budget = this->_mainBudget() * PROTECTED_PERCENT / 100;
+    while (this->_segment_bytes[PROTECTED] > protected_budget && this->_segments[PROTECTED].size() > 1) {
+      this->_move(this->_entries.find(this->_segments[PROTECTED].back())->second, PROBATION);
+    }
+  }
+
+  /**
+   * @brief Retrieves the budget of the probation and protected segments together.
+   */
+  size_t _mainBudget() const {
+    return this->_budget - this->_budget * WINDOW_PERCENT / 100;
+  }
+
+  /**
+   * @brief Moves entries out of an overfull window into the main segments, each
+   *        admitted only if it is used more often than the entries it displaces.
+   */
+  void _drainWindow() {
+    const size_t window_budget = this->_budget * WINDOW_PERCENT / 100;
+    if (this->_segment_bytes[WINDOW] > window_budget) {
+      this->_sweep();
+    }
+    while (this->_segment_bytes[WINDOW] > window_budget && !this->_segments[WINDOW].empty()) {
+      auto candidate = this->_entries.find(this->_segments[WINDOW].back());
+      this->_move(candidate->second, PROBATION);
+
+      // The candidate now sits at the front of probation; it competes with the back
+      const uint8_t frequency = this->_sketch.frequency(candidate->second.hash);
+      while (this->_segment_bytes[PROBATION] + this->_segment_bytes[PROTECTED] > this->_mainBudget()) {
+        auto victim = this->_victim();
+        if (victim == candidate) {
+          this->_evict(candidate);
+          break;
+        }
+        const bool stale = !this->_current(victim->second, std::chrono::steady_clock::now());
+        if (!stale && this->_sketch.frequency(victim->second.hash) >= frequency) {
+          ++this->_stats.refused;
+          this->_evict(candidate);
+          break;
+        }
+        this->_evict(victim);
+      }
+    }
+  }
+
+  /**
+   * @brief Drops every entry of an older generation, if the cache is over its budget
+   *        and has not been swept since the generation last changed.
+   *
+   * Each entry is dropped at most once, so the sweeps cost no more than the stores.
+   */
+  void _sweep() {
+    const uint64_t generation = this->_generation.load(std::memory_order_acquire);
+    if (generation == this->_swept || this->_bytes() <= this->_budget) {
+      return;
+    }
+    this->_swept = generation;
+    for (auto entry = this->_entries.begin(); entry != this->_entries.end();) {
+      auto next = std::next(entry);
+      if (entry->second.generation != generation) {
+        this->_erase(entry);
+      }
+      entry = next;
+    }
+  }
+
+  /**
+   * @brief Picks the next entry to evict from the main segments: the least recently
+   *        used probation entry, else protected, else window.
+   *
+   * @return The entry; the map must not be empty.
+   */
+  typename EntryMap::iterator _victim() {
+    for (Segment segment : {PROBATION, PROTECTED, WINDOW}) {
+      if (!this->_segments[segment].empty()) {
+        return this->_entries.find(this->_segments[segment].back());
+      }
+    }
+    return this->_entries.end();
+  }
+
+  /**
+   * @brief Evicts an entry for room, remembering its key if it was still current.
+   *
+   * @param entry The entry.
+   */
+  void _evict(typename EntryMap::iterator entry) {
+    if (entry == this->_entries.end()) {
+      return;
+    }
+    if (this->_current(entry->second, std::chrono::steady_clock::now())) {
+      ++this->_stats.evictions;
+      this->_remember(entry->second.hash);
+    }
+    this->_erase(entry);
+  }
+
+  /**
+   * @brief Removes an entry from its segment and the map.
+   *
+   * @param entry The entry.
+   */
+  void _erase(typename EntryMap::iterator entry) {
+    this->_segments[entry->second.segment].erase(entry->second.position);
+    this->_segment_bytes[entry->second.segment] -= entry->second.bytes;
+    this->_entries.erase(entry);
+  }
+
+  /**
+   * @brief Adds an evicted key's hash to the ghost list, forgetting the oldest.
+   *
+   * @param hash The key's hash.
+   */
+  void _remember(const uint64_t& hash) {
+    ++this->_ghosts[hash];
+    this->_ghost_order.push_back(hash);
+    if (this->_ghost_order.size() > GHOST_ENTRIES) {
+      auto oldest = this->_ghosts.find(this->_ghost_order.front());
+      if (--oldest->second == 0) {
+        this->_ghosts.erase(oldest);
+      }
+      this->_ghost_order.pop_front();
+    }
+  }
+
+  std::string _name;
+  const std::atomic<uint64_t>& _generation;
+  Sizer _sizer;
+  std::chrono::steady_clock::duration _ttl;
+  CacheManager& _manager;
+
+  mutable std::mutex _lock;
+  size_t _budget = CacheManager::MIN_CACHE_BUDGET;
+  EntryMap _entries;
+  uint64_t _swept = 0;                       // generation of the last `_sweep`
+  std::list<Key> _segments[SEGMENT_COUNT];   // most recently used first
+  size_t _segment_bytes[SEGMENT_COUNT] = {};
+  FrequencySketch _sketch;
+  std::unordered_map<uint64_t, uint32_t> _ghosts;   // hash -> occurrences in `_ghost_order`
+  std::deque<uint64_t> _ghost_order;
+  uint64_t _ghost_hits_since_taken = 0;
+  CacheStats _stats;
+};
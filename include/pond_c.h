@@ -0,0 +1,123 @@
+#ifndef POND_C_H
+#define POND_C_H
+
+/*
+ * libpond: a C interface to a Pond database, for embedding in other programs.
+ *
+ * Calls are batch-oriented: each one fills caller-owned arrays, and any strings it
+ * returns are copied into a caller-owned text buffer that the returned structs point
+ * into, so a whole page of results costs one call and no allocations the caller has
+ * to free. A call that runs out of room in the text buffer returns POND_TRUNCATED
+ * with every fully written result counted; the caller can grow the buffer or continue
+ * from where it stopped.
+ *
+ * A handle is a single connection and must not be used by two threads at once; open
+ * one handle per thread instead. The ABI only ever grows: structs and enums keep
+ * their layout, and POND_ABI_VERSION is bumped when functions are added.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define POND_ABI_VERSION 1
+
+#if defined(__GNUC__)
+#define POND_API __attribute__((visibility("default")))
+#else
+#define POND_API
+#endif
+
+/* An open connection to a Pond database. */
+typedef struct pond_handle pond_handle;
+
+typedef enum pond_status {
+  POND_OK = 0,
+  POND_ERROR = 1,       /* the database failed; see pond_last_error */
+  POND_INVALID = 2,     /* a required argument was NULL */
+  POND_TRUNCATED = 3    /* the text buffer filled up before every result was written */
+} pond_status;
+
+typedef enum pond_feed_mode {
+  POND_FEED_CHRONOLOGICAL = 0,
+  POND_FEED_RANKED = 1
+} pond_feed_mode;
+
+/* A quack. tid is 0 if the requested quack does not exist. */
+typedef struct pond_quack {
+  int32_t tid;
+  int32_t writer_id;
+  int32_t replyto_tid;   /* 0 if the quack is not a reply */
+  char date[11];         /* YYYY-MM-DD */
+  char time[9];          /* HH:MM:SS */
+  const char* text;      /* points into the caller's text buffer */
+} pond_quack;
+
+/* An entry of a user's feed. For requacks, writer_id and author are the requacker. */
+typedef struct pond_feed_entry {
+  int32_t tid;
+  int32_t writer_id;
+  int32_t is_requack;
+  char date[11];
+  char time[9];
+  const char* author;    /* points into the caller's text buffer */
+  const char* text;      /* points into the caller's text buffer */
+} pond_feed_entry;
+
+/* A quack to post. */
+typedef struct pond_post {
+  int32_t user_id;
+  const char* text;
+} pond_post;
+
+/* Returns the POND_ABI_VERSION the library was built with. */
+POND_API int pond_abi_version(void);
+
+/* Opens a database; *out is set to a new handle, or NULL on failure. */
+POND_API pond_status pond_open(const char* db_filename, pond_handle** out);
+
+/* Closes a handle. Accepts NULL. */
+POND_API void pond_close(pond_handle* handle);
+
+/* Returns the message of the handle's last error; valid until the next call on it. */
+POND_API const char* pond_last_error(const pond_handle* handle);
+
+/*
+ * Retrieves quacks by ID: quacks[i] is the quack with ID tids[i]. *written receives
+ * the number of leading entries that were filled in.
+ */
+POND_API pond_status pond_get_quacks(pond_handle* handle,
+                                     const int32_t* tids, size_t count,
+                                     pond_quack* quacks,
+                                     char* text_buffer, size_t text_capacity,
+                                     size_t* written);
+
+/*
+ * Posts quacks in one transaction: tids[i] receives the ID of posts[i], or 0 if it was
+ * rejected. *posted receives the number of quacks added. Returns POND_ERROR, with every
+ * ID 0, if the transaction could not be begun or committed.
+ */
+POND_API pond_status pond_post_quacks(pond_handle* handle,
+                                      const pond_post* posts, size_t count,
+                                      int32_t* tids, size_t* posted);
+
+/*
+ * Retrieves up to `count` entries of a user's feed starting at entry `offset`.
+ * *written receives the number of entries filled in and, if not NULL, *total the
+ * number of entries in the whole feed.
+ */
+POND_API pond_status pond_get_feed_page(pond_handle* handle,
+                                        int32_t user_id, pond_feed_mode mode,
+                                        size_t offset, size_t count,
+                                        pond_feed_entry* entries,
+                                        char* text_buffer, size_t text_capacity,
+                                        size_t* written, size_t* total);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
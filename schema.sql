@@ -5,6 +5,22 @@ drop table if exists include;
 drop table if exists tweets;
 drop table if exists retweets;
 drop table if exists hashtag_mentions;
+drop table if exists follower_sketches;
+drop table if exists quack_reach;
+drop table if exists requack_cascades;
+drop table if exists activity_rollups;
+drop table if exists pond_meta;
+drop table if exists quack_stats;
+drop table if exists affinity;
+drop table if exists mentions;
+drop table if exists notifications;
+drop table if exists notification_state;
+drop table if exists spam_ledger;
+drop table if exists tombstones;
+drop view if exists live_users;
+drop view if exists live_tweets;
+drop view if exists live_retweets;
+drop view if exists live_notifications;
 
 CREATE TABLE users (
     usr         int,
@@ -58,15 +74,226 @@ CREATE TABLE retweets (
     writer_id      int, 
     spam        int,
     rdate       date,
+    rtime       time,
+    flagged_at  datetime,
     PRIMARY KEY (tid, retweeter_id),
     FOREIGN KEY (tid) REFERENCES tweets(tid) ON DELETE CASCADE,
     FOREIGN KEY (retweeter_id) REFERENCES users(usr) ON DELETE CASCADE,
     FOREIGN KEY (writer_id) REFERENCES users(usr) ON DELETE CASCADE
 );
 
+-- Only legitimate requacks; the feed reads requacks through this index alone
+CREATE INDEX retweets_legit ON retweets (retweeter_id, rdate, tid) WHERE spam = 0;
+CREATE INDEX retweets_flagged ON retweets (IFNULL(flagged_at, rdate)) WHERE spam = 1;
+
 CREATE TABLE hashtag_mentions (
     tid         int,
     term        text,
     primary key (tid, term),
     FOREIGN KEY (tid) REFERENCES tweets(tid) ON DELETE CASCADE
-);
\ No newline at end of file
+);
+
+-- Derived tables maintained by Pond (also created on load if missing)
+
+CREATE TABLE follower_sketches (
+    usr         int,
+    sketch      blob,
+    primary key (usr)
+);
+
+CREATE TABLE quack_reach (
+    tid         int,
+    sketch      blob,
+    max_depth   int,
+    primary key (tid)
+);
+
+CREATE TABLE requack_cascades (
+    tid            int,
+    retweeter_id   int,
+    depth          int,
+    primary key (tid, retweeter_id)
+);
+
+-- granularity: 0 = hour (YYYY-MM-DD HH), 1 = day (YYYY-MM-DD), 2 = month (YYYY-MM)
+CREATE TABLE activity_rollups (
+    granularity int,
+    bucket      text,
+    metric      text,
+    count       int,
+    primary key (granularity, metric, bucket)
+);
+
+CREATE TABLE pond_meta (
+    key         text,
+    value       text,
+    primary key (key)
+);
+
+CREATE TABLE quack_stats (
+    tid            int,
+    requacks       int,
+    replies        int,
+    spam_requacks  int,
+    primary key (tid)
+);
+
+CREATE TABLE affinity (
+    viewer      int,
+    author      int,
+    score       int,
+    primary key (viewer, author)
+);
+
+CREATE TABLE mentions (
+    usr         int,
+    tid         int,
+    primary key (usr, tid)
+);
+
+CREATE INDEX users_by_handle ON users (REPLACE(LOWER(name), ' ', ''));
+
+-- kind: 0 = mention, 1 = reply, 2 = requack, 3 = follow
+CREATE TABLE notifications (
+    nid         integer primary key autoincrement,
+    usr         int,
+    kind        int,
+    actor       int,
+    actor_name  text,
+    tid         int,
+    snippet     text,
+    ndate       date,
+    ntime       time
+);
+
+CREATE INDEX notifications_by_user ON notifications (usr, nid);
+
+CREATE TABLE notification_state (
+    usr         int,
+    unread      int,
+    last_read   int,
+    primary key (usr)
+);
+
+-- Spam requacks past retention, counted per requacker, author and day
+CREATE TABLE spam_ledger (
+    retweeter_id int,
+    writer_id    int,
+    day          date,
+    requacks     int,
+    primary key (retweeter_id, writer_id, day)
+);
+
+-- kind: 0 = quack (id = tid), 1 = user (id = usr), 2 = list (id = owner_id, lname)
+-- Deleted rows are hidden through the live_* views until the purge removes them
+CREATE TABLE tombstones (
+    kind        int,
+    id          int,
+    lname       text,
+    deleted_at  text,
+    primary key (kind, id, lname)
+);
+
+CREATE VIEW live_users AS
+    SELECT * FROM users
+    WHERE usr NOT IN (SELECT id FROM tombstones WHERE kind = 1);
+
+CREATE VIEW live_tweets AS
+    SELECT * FROM tweets
+    WHERE tid NOT IN (SELECT id FROM tombstones WHERE kind = 0)
+      AND writer_id NOT IN (SELECT id FROM tombstones WHERE kind = 1)
+      AND IFNULL(replyto_tid, 0) NOT IN (SELECT id FROM tombstones WHERE kind = 0);
+
+CREATE VIEW live_retweets AS
+    SELECT * FROM retweets
+    WHERE tid NOT IN (SELECT id FROM tombstones WHERE kind = 0)
+      AND retweeter_id NOT IN (SELECT id FROM tombstones WHERE kind = 1)
+      AND writer_id NOT IN (SELECT id FROM tombstones WHERE kind = 1);
+
+CREATE VIEW live_notifications AS
+    SELECT * FROM notifications
+    WHERE actor NOT IN (SELECT id FROM tombstones WHERE kind = 1)
+      AND tid NOT IN (SELECT id FROM tombstones WHERE kind = 0);
+
+CREATE INDEX tweets_by_writer ON tweets (writer_id);
+CREATE INDEX tweets_by_reply ON tweets (replyto_tid);
+CREATE INDEX follows_by_followee ON follows (flwee);
+CREATE INDEX mentions_by_quack ON mentions (tid);
+CREATE INDEX notifications_by_quack ON notifications (tid);
+CREATE INDEX notifications_by_actor ON notifications (actor);
+
+-- Counts every change to the tables the in-memory indexes are built from, so
+-- connections sharing the indexes can tell whether someone else changed them
+INSERT INTO pond_meta (key, value) VALUES ('index_version', '0');
+
+CREATE TRIGGER index_version_users_insert AFTER INSERT ON users BEGIN
+    UPDATE pond_meta SET value = value + 1 WHERE key = 'index_version';
+END;
+
+CREATE TRIGGER index_version_users_update AFTER UPDATE ON users BEGIN
+    UPDATE pond_meta SET value = value + 1 WHERE key = 'index_version';
+END;
+
+CREATE TRIGGER index_version_users_delete AFTER DELETE ON users BEGIN
+    UPDATE pond_meta SET value = value + 1 WHERE key = 'index_version';
+END;
+
+CREATE TRIGGER index_version_follows_insert AFTER INSERT ON follows BEGIN
+    UPDATE pond_meta SET value = value + 1 WHERE key = 'index_version';
+END;
+
+CREATE TRIGGER index_version_follows_update AFTER UPDATE ON follows BEGIN
+    UPDATE pond_meta SET value = value + 1 WHERE key = 'index_version';
+END;
+
+CREATE TRIGGER index_version_follows_delete AFTER DELETE ON follows BEGIN
+    UPDATE pond_meta SET value = value + 1 WHERE key = 'index_version';
+END;
+
+CREATE TRIGGER index_version_tweets_insert AFTER INSERT ON tweets BEGIN
+    UPDATE pond_meta SET value = value + 1 WHERE key = 'index_version';
+END;
+
+CREATE TRIGGER index_version_tweets_update AFTER UPDATE ON tweets BEGIN
+    UPDATE pond_meta SET value = value + 1 WHERE key = 'index_version';
+END;
+
+CREATE TRIGGER index_version_tweets_delete AFTER DELETE ON tweets BEGIN
+    UPDATE pond_meta SET value = value + 1 WHERE key = 'index_version';
+END;
+
+CREATE TRIGGER index_version_retweets_insert AFTER INSERT ON retweets BEGIN
+    UPDATE pond_meta SET value = value + 1 WHERE key = 'index_version';
+END;
+
+CREATE TRIGGER index_version_retweets_update AFTER UPDATE ON retweets BEGIN
+    UPDATE pond_meta SET value = value + 1 WHERE key = 'index_version';
+END;
+
+CREATE TRIGGER index_version_retweets_delete AFTER DELETE ON retweets BEGIN
+    UPDATE pond_meta SET value = value + 1 WHERE key = 'index_version';
+END;
+
+CREATE TRIGGER index_version_hashtag_mentions_insert AFTER INSERT ON hashtag_mentions BEGIN
+    UPDATE pond_meta SET value = value + 1 WHERE key = 'index_version';
+END;
+
+CREATE TRIGGER index_version_hashtag_mentions_update AFTER UPDATE ON hashtag_mentions BEGIN
+    UPDATE pond_meta SET value = value + 1 WHERE key = 'index_version';
+END;
+
+CREATE TRIGGER index_version_hashtag_mentions_delete AFTER DELETE ON hashtag_mentions BEGIN
+    UPDATE pond_meta SET value = value + 1 WHERE key = 'index_version';
+END;
+
+CREATE TRIGGER index_version_tombstones_insert AFTER INSERT ON tombstones BEGIN
+    UPDATE pond_meta SET value = value + 1 WHERE key = 'index_version';
+END;
+
+CREATE TRIGGER index_version_tombstones_update AFTER UPDATE ON tombstones BEGIN
+    UPDATE pond_meta SET value = value + 1 WHERE key = 'index_version';
+END;
+
+CREATE TRIGGER index_version_tombstones_delete AFTER DELETE ON tombstones BEGIN
+    UPDATE pond_meta SET value = value + 1 WHERE key = 'index_version';
+END;
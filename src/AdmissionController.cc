@@ -0,0 +1,306 @@
+#include "AdmissionController.hh"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+// Names of the operations, in `Operation` order, as accepted by `parseLimit`
+static const char* const OPERATION_NAMES[AdmissionController::OPERATIONS] = {
+  "quack", "reply", "requack", "follow", "delete"
+};
+
+// Weight of the newest sample in the moving average of slot hold times
+static constexpr double HOLD_SMOOTHING = 0.1;
+
+// =============================================================================
+// Public Methods
+// =============================================================================
+
+/**
+ * @brief Constructs a controller with the default limits.
+ */
+AdmissionController::AdmissionController()
+  : AdmissionController(Options()) {}
+
+/**
+ * @brief Constructs a controller with the given limits.
+ *
+ * @param options The limits.
+ */
+AdmissionController::AdmissionController(const Options& options)
+  : _options(options) {}
+
+/**
+ * @brief Takes a token from the bucket of a user and operation.
+ *
+ * The bucket is refilled for the time since it was last touched before the token is
+ * taken, so refilling costs nothing while a user is idle. A rejected write takes no
+ * token, and a client that retries after `retry_after` is admitted.
+ *
+ * @param user_id The unique ID of the user writing.
+ * @param operation The kind of write.
+ * @return Whether the write is admitted, and if not, when to retry.
+ */
+AdmissionController::Decision AdmissionController::admit(const int32_t& user_id, const Operation& operation) {
+  const Limit& limit = this->_options.limits[static_cast<size_t>(operation)];
+  if (limit.per_minute <= 0) {
+    ++this->_admitted;
+    return {};
+  }
+
+  const double per_ms = limit.per_minute / 60000.0;
+  const double burst = std::max(limit.burst, 1.0);
+  const uint64_t key = (static_cast<uint64_t>(static_cast<uint32_t>(user_id)) << 8) | static_cast<uint64_t>(operation);
+  const auto now = std::chrono::steady_clock::now();
+
+  Shard& shard = this->_shards[std::hash<uint64_t>{}(key) % SHARDS];
+  std::lock_guard<std::mutex> lock(shard.lock);
+  // Sweep about once a minute, so the table holds only users active recently
+  if (now - shard.last_sweep >= std::chrono::minutes(1)) {
+    this->_sweep(shard, now);
+    shard.last_sweep = now;
+  }
+
+  auto [it, added] = shard.buckets.try_emplace(key, Bucket{burst, now});
+  Bucket& bucket = it->second;
+  if (!added) {
+    const double elapsed_ms = std::chrono::duration<double, std::milli>(now - bucket.refilled).count();
+    bucket.tokens = std::min(burst, bucket.tokens + elapsed_ms * per_ms);
+    bucket.refilled = now;
+  }
+
+  if (bucket.tokens >= 1.0) {
+    bucket.tokens -= 1.0;
+    ++this->_admitted;
+    return {};
+  }
+  ++this->_throttled;
+  const double wait_ms = std::ceil((1.0 - bucket.tokens) / per_ms);
+  return {false, std::chrono::milliseconds(static_cast<int64_t>(wait_ms))};
+}
+
+/**
+ * @brief Waits for a write slot.
+ *
+ * @param user_id The unique ID of the user writing; slots are granted fairly across users.
+ * @return The awaitable slot; a ticket without a slot if the user's queue is full.
+ */
+AdmissionController::Enter AdmissionController::enter(const int32_t& user_id) {
+  return Enter(*this, user_id);
+}
+
+/**
+ * @brief Retrieves the counters.
+ *
+ * @return The counters.
+ */
+AdmissionController::Stats AdmissionController::stats() const {
+  Stats stats;
+  stats.admitted = this->_admitted.load();
+  stats.throttled = this->_throttled.load();
+  stats.queued = this->_queued.load();
+  stats.shed = this->_shed.load();
+  return stats;
+}
+
+/**
+ * @brief Prints the counters as one line.
+ *
+ * @param out The stream to print to.
+ */
+void AdmissionController::report(std::ostream& out) const {
+  const Stats stats = this->stats();
+  out << "writes: " << stats.admitted << " admitted, " << stats.throttled << " throttled, "
+      << stats.queued << " queued for a slot, " << stats.shed << " shed" << std::endl;
+}
+
+/**
+ * @brief Parses a limit given as `<operation>=<per minute>/<burst>`, e.g. `quack=30/10`.
+ *
+ * A rate of 0 disables the limit of the operation.
+ *
+ * @param text The text to parse.
+ * @param operation Set to the operation.
+ * @param limit Set to the limit.
+ * @return true if the text is well-formed; false otherwise.
+ */
+bool AdmissionController::parseLimit(const std::string& text, Operation& operation, Limit& limit) {
+  const size_t equals = text.find('=');
+  const size_t slash = text.find('/', equals);
+  if (equals == std::string::npos || slash == std::string::npos) {
+    return false;
+  }
+
+  const std::string name = text.substr(0, equals);
+  const auto* found = std::find_if(std::begin(OPERATION_NAMES), std::end(OPERATION_NAMES), [&name](const char* candidate) {
+    return name == candidate;
+  });
+  if (found == std::end(OPERATION_NAMES)) {
+    return false;
+  }
+
+  char* end = nullptr;
+  const double per_minute = std::strtod(text.c_str() + equals + 1, &end);
+  if (end != text.c_str() + slash || per_minute < 0) {
+    return false;
+  }
+  const double burst = std::strtod(text.c_str() + slash + 1, &end);
+  if (*end != '\0' || burst < 1) {
+    return false;
+  }
+
+  operation = static_cast<Operation>(found - std::begin(OPERATION_NAMES));
+  limit = Limit{per_minute, burst};
+  return true;
+}
+
+/**
+ * @brief Formats a retry delay for people, rounded up to whole seconds.
+ *
+ * @param retry_after The delay.
+ * @return The delay, e.g. "12 seconds".
+ */
+std::string AdmissionController::describe(const std::chrono::milliseconds& retry_after) {
+  const int64_t seconds = std::max<int64_t>(1, (retry_after.count() + 999) / 1000);
+  return std::to_string(seconds) + (seconds == 1 ? " second" : " seconds");
+}
+
+// =============================================================================
+// Private Methods
+// =============================================================================
+
+/**
+ * @brief Takes a free slot if there is one, or rejects a user whose queue is full.
+ *
+ * @param user_id The unique ID of the user writing.
+ * @param ticket Set to the slot, or to the rejection.
+ * @return true if the caller need not wait; false if it should queue.
+ */
+bool AdmissionController::_tryEnter(const int32_t& user_id, Ticket& ticket) {
+  std::lock_guard<std::mutex> lock(this->_slots_lock);
+  return this->_claim(user_id, ticket);
+}
+
+/**
+ * @brief Queues a write for a slot, unless one was freed or the queue filled meanwhile.
+ *
+ * @param user_id The unique ID of the user writing.
+ * @param handle The coroutine to resume with the slot.
+ * @param ticket Set to the slot when it is granted.
+ * @return true if the coroutine was queued; false if `ticket` is already set.
+ */
+bool AdmissionController::_wait(const int32_t& user_id, std::coroutine_handle<> handle, Ticket& ticket) {
+  std::lock_guard<std::mutex> lock(this->_slots_lock);
+  // The lock was dropped since `_tryEnter`, so check again before queueing
+  if (this->_claim(user_id, ticket)) {
+    return false;
+  }
+
+  std::deque<Waiter>& queue = this->_waiting[user_id];
+  if (queue.empty()) {
+    this->_turns.push_back(user_id);
+  }
+  queue.push_back(Waiter{handle, Executor::current(), &ticket});
+  ++this->_queued;
+  return true;
+}
+
+/**
+ * @brief Takes a free slot if there is one, or rejects a user whose queue is full; the
+ *        lock must be held.
+ *
+ * A free slot is only taken when nobody is waiting, so a newcomer cannot overtake the
+ * writes already queued.
+ *
+ * @param user_id The unique ID of the user writing.
+ * @param ticket Set to the slot, or to the rejection.
+ * @return true if the caller need not wait; false if it should queue.
+ */
+bool AdmissionController::_claim(const int32_t& user_id, Ticket& ticket) {
+  if (this->_options.max_concurrent == 0 ||
+      (this->_in_flight < this->_options.max_concurrent && this->_turns.empty())) {
+    ++this->_in_flight;
+    ticket = Ticket(this, std::chrono::steady_clock::now());
+    return true;
+  }
+
+  auto it = this->_waiting.find(user_id);
+  if (it != this->_waiting.end() && it->second.size() >= this->_options.max_queued) {
+    ++this->_shed;
+    ticket = Ticket(this->_queueDelay());
+    return true;
+  }
+  return false;
+}
+
+/**
+ * @brief Returns a slot, handing it to the next user in turn if any write is waiting.
+ *
+ * The user served goes to the back of the turns if it still has writes waiting, so
+ * users are served round-robin whatever the length of their queues. The slot moves to
+ * the waiter directly rather than being freed, so it cannot be taken by a newcomer.
+ *
+ * @param granted When the slot was granted, to estimate how long writes hold one.
+ */
+void AdmissionController::_release(const std::chrono::steady_clock::time_point& granted) {
+  const auto now = std::chrono::steady_clock::now();
+  Waiter next{};
+  {
+    std::lock_guard<std::mutex> lock(this->_slots_lock);
+    const double held_ms = std::chrono::duration<double, std::milli>(now - granted).count();
+    this->_hold_ms += HOLD_SMOOTHING * (held_ms - this->_hold_ms);
+
+    if (this->_turns.empty()) {
+      --this->_in_flight;
+      return;
+    }
+    const int32_t user_id = this->_turns.front();
+    this->_turns.pop_front();
+    std::deque<Waiter>& queue = this->_waiting[user_id];
+    next = queue.front();
+    queue.pop_front();
+    if (queue.empty()) {
+      this->_waiting.erase(user_id);
+    } else {
+      this->_turns.push_back(user_id);
+    }
+    *next.ticket = Ticket(this, now);
+  }
+
+  if (next.home) {
+    next.home->post([handle = next.handle] { handle.resume(); });
+  } else {
+    next.handle.resume();
+  }
+}
+
+/**
+ * @brief Estimates how long a user with a full queue should wait; the lock must be held.
+ *
+ * Every waiting write is served in about one average hold time per slot.
+ *
+ * @return The delay.
+ */
+std::chrono::milliseconds AdmissionController::_queueDelay() const {
+  size_t waiting = 0;
+  for (const auto& [user_id, queue] : this->_waiting) {
+    waiting += queue.size();
+  }
+  const double slots = std::max<uint32_t>(this->_options.max_concurrent, 1);
+  const double delay_ms = this->_hold_ms * (static_cast<double>(waiting) / slots + 1.0);
+  return std::chrono::milliseconds(static_cast<int64_t>(std::ceil(delay_ms)));
+}
+
+/**
+ * @brief Drops the buckets of a shard that have refilled completely; its lock must be held.
+ *
+ * @param shard The shard.
+ * @param now The current time.
+ */
+void AdmissionController::_sweep(Shard& shard, const std::chrono::steady_clock::time_point& now) {
+  std::erase_if(shard.buckets, [&](const auto& entry) {
+    const Limit& limit = this->_options.limits[entry.first & 0xff];
+    const double elapsed_ms = std::chrono::duration<double, std::milli>(now - entry.second.refilled).count();
+    return entry.second.tokens + elapsed_ms * limit.per_minute / 60000.0 >= std::max(limit.burst, 1.0);
+  });
+}
@@ -0,0 +1,26 @@
+#include "Async.hh"
+
+namespace {
+
+// The executor of the current thread, if it has one
+thread_local Executor* t_executor = nullptr;
+
+} // namespace
+
+/**
+ * @brief Retrieves the executor of the calling thread.
+ *
+ * @return The executor, or nullptr if the thread has none.
+ */
+Executor* Executor::current() {
+  return t_executor;
+}
+
+/**
+ * @brief Sets the executor of the calling thread.
+ *
+ * @param executor The executor, or nullptr to clear it.
+ */
+void Executor::setCurrent(Executor* executor) {
+  t_executor = executor;
+}
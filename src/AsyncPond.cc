@@ -0,0 +1,274 @@
+#include "AsyncPond.hh"
+
+#include <iostream>
+
+#include "PondRegistry.hh"
+
+// =============================================================================
+// Public Methods
+// =============================================================================
+
+/**
+ * @brief Starts the I/O threads, each opening its own connection to shared indexes.
+ *
+ * @param db_filename The database file to open.
+ * @param io_threads The number of I/O threads (at least 1).
+ */
+AsyncPond::AsyncPond(const std::string& db_filename, const uint32_t& io_threads)
+  : _db_filename(db_filename), _indexes(std::make_shared<Pond::Indexes>()) {
+  for (uint32_t i = 0; i < std::max(io_threads, 1u); ++i) {
+    this->_threads.emplace_back(&AsyncPond::_work, this);
+  }
+}
+
+/**
+ * @brief Constructs a facade whose calls run on a registry's I/O threads.
+ *
+ * @param registry The registry.
+ * @param tenant The tenant the calls are for.
+ */
+AsyncPond::AsyncPond(PondRegistry& registry, const std::string& tenant)
+  : _registry(&registry), _tenant(tenant) {}
+
+/**
+ * @brief Finishes every queued call, then stops the I/O threads.
+ */
+AsyncPond::~AsyncPond() {
+  {
+    std::lock_guard<std::mutex> lock(this->_lock);
+    this->_stopping = true;
+  }
+  this->_ready.notify_all();
+  for (std::thread& thread : this->_threads) {
+    thread.join();
+  }
+}
+
+/**
+ * @brief Checks a user's credentials; the value is the user ID if they match.
+ */
+AsyncPond::Call<std::optional<int32_t>> AsyncPond::checkLogin(const int32_t& user_id, const std::string& password, const CallOptions& options) {
+  return this->run([user_id, password](Pond& pond) -> std::optional<int32_t> {
+    std::unique_ptr<int32_t> id(pond.checkLogin(user_id, password));
+    return id ? std::optional<int32_t>(*id) : std::nullopt;
+  }, options);
+}
+
+/**
+ * @brief Retrieves a user's stored password hash; empty if the user does not exist.
+ */
+AsyncPond::Call<std::string> AsyncPond::getPasswordHash(const int32_t& user_id, const CallOptions& options) {
+  return this->run([user_id](Pond& pond) {
+    return pond.getPasswordHash(user_id);
+  }, options);
+}
+
+/**
+ * @brief Replaces a user's stored password hash; the value is whether it was replaced.
+ */
+AsyncPond::Call<bool> AsyncPond::setPasswordHash(const int32_t& user_id, const std::string& hash, const CallOptions& options) {
+  return this->run([user_id, hash](Pond& pond) {
+    return pond.setPasswordHash(user_id, hash);
+  }, options);
+}
+
+/**
+ * @brief Retrieves a user's name.
+ */
+AsyncPond::Call<std::string> AsyncPond::getUsername(const int32_t& user_id, const CallOptions& options) {
+  return this->run([user_id](Pond& pond) {
+    return pond.getUsername(user_id);
+  }, options);
+}
+
+/**
+ * @brief Posts a quack; the value is its ID if it was added.
+ */
+AsyncPond::Call<std::optional<int32_t>> AsyncPond::addQuack(const int32_t& user_id, const std::string& text, const CallOptions& options) {
+  return this->run([user_id, text](Pond& pond) -> std::optional<int32_t> {
+    std::unique_ptr<int32_t> id(pond.addQuack(user_id, text));
+    return id ? std::optional<int32_t>(*id) : std::nullopt;
+  }, options);
+}
+
+/**
+ * @brief Requacks a quack; the value is 0 if added, 1 if already requacked, else an error.
+ */
+AsyncPond::Call<int32_t> AsyncPond::addRequack(const int32_t& user_id, const int32_t& quack_id, const CallOptions& options) {
+  return this->run([user_id, quack_id](Pond& pond) {
+    return pond.addRequack(user_id, quack_id);
+  }, options);
+}
+
+/**
+ * @brief Follows a user; the value is whether the follow was added.
+ */
+AsyncPond::Call<bool> AsyncPond::follow(const int32_t& user_id, const int32_t& follow_id, const CallOptions& options) {
+  return this->run([user_id, follow_id](Pond& pond) {
+    return pond.follow(user_id, follow_id);
+  }, options);
+}
+
+/**
+ * @brief Unfollows a user; the value is whether the unfollow succeeded.
+ */
+AsyncPond::Call<bool> AsyncPond::unfollow(const int32_t& user_id, const int32_t& follow_id, const CallOptions& options) {
+  return this->run([user_id, follow_id](Pond& pond) {
+    return pond.unfollow(user_id, follow_id);
+  }, options);
+}
+
+/**
+ * @brief Deletes one of a user's quacks; the value is whether it was deleted.
+ */
+AsyncPond::Call<bool> AsyncPond::deleteQuack(const int32_t& user_id, const int32_t& quack_id, const CallOptions& options) {
+  return this->run([user_id, quack_id](Pond& pond) {
+    return pond.deleteQuack(user_id, quack_id);
+  }, options);
+}
+
+/**
+ * @brief Retrieves a user's feed entries.
+ */
+AsyncPond::Call<std::vector<Pond::FeedEntry>> AsyncPond::getFeedEntries(const int32_t& user_id, const Pond::FeedMode& mode, const CallOptions& options) {
+  return this->run([user_id, mode](Pond& pond) {
+    return pond.getFeedEntries(user_id, mode);
+  }, options);
+}
+
+/**
+ * @brief Retrieves up to `count` of a user's feed entries, starting at `offset`.
+ */
+AsyncPond::Call<std::vector<Pond::FeedEntry>> AsyncPond::getFeedPage(const int32_t& user_id, const Pond::FeedMode& mode, const size_t& offset, const size_t& count, const CallOptions& options) {
+  return this->run([user_id, mode, offset, count](Pond& pond) {
+    size_t total = 0;
+    return pond.getFeedPage(user_id, mode, offset, count, total);
+  }, options);
+}
+
+/**
+ * @brief Searches quacks by keywords or hashtags.
+ */
+AsyncPond::Call<std::vector<Pond::Quack>> AsyncPond::searchForQuacks(const std::string& search_terms, const CallOptions& options) {
+  return this->run([search_terms](Pond& pond) {
+    return pond.searchForQuacks(search_terms);
+  }, options);
+}
+
+/**
+ * @brief Searches users by name.
+ */
+AsyncPond::Call<std::vector<Pond::User>> AsyncPond::searchForUsers(const std::string& search_terms, const CallOptions& options) {
+  return this->run([search_terms](Pond& pond) {
+    return pond.searchForUsers(search_terms);
+  }, options);
+}
+
+/**
+ * @brief Retrieves a page of a user's notifications, older than `before` (0 for the newest).
+ */
+AsyncPond::Call<std::vector<Pond::Notification>> AsyncPond::getNotifications(const int32_t& user_id, const int64_t& before, const CallOptions& options) {
+  return this->run([user_id, before](Pond& pond) {
+    return pond.getNotifications(user_id, before);
+  }, options);
+}
+
+/**
+ * @brief Retrieves the number of calls waiting for an I/O thread.
+ *
+ * @return The queue length.
+ */
+size_t AsyncPond::queued() const {
+  if (this->_registry) {
+    return this->_registry->_queued(this->_tenant);
+  }
+  std::lock_guard<std::mutex> lock(this->_lock);
+  return this->_jobs.size();
+}
+
+// =============================================================================
+// Private Methods
+// =============================================================================
+
+/**
+ * @brief Queues a job for the next free I/O thread, the registry's if any.
+ *
+ * @param job Called with the thread's Pond, or nullptr if it failed to open.
+ */
+void AsyncPond::_submit(std::function<void(Pond*)> job) {
+  if (this->_registry) {
+    this->_registry->_submit(this->_tenant, std::move(job));
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(this->_lock);
+    this->_jobs.push_back(std::move(job));
+  }
+  this->_ready.notify_one();
+}
+
+/**
+ * @brief Runs one call's operation unless it is cancelled or out of time.
+ *
+ * The token and deadline are checked before the operation starts and then polled by
+ * the connection's progress handler while it runs, so a statement that outlives its
+ * call is aborted rather than finished for nobody.
+ *
+ * @param pond The I/O thread's connection, or nullptr if it failed to open.
+ * @param options The cancellation token and deadline of the call.
+ * @param body Runs the operation and stores its result.
+ * @return How the call ended.
+ */
+AsyncStatus AsyncPond::_execute(Pond* pond, const CallOptions& options, const std::function<void(Pond&)>& body) {
+  auto status = [&options]() {
+    if (options.cancel.cancelled()) return AsyncStatus::CANCELLED;
+    if (std::chrono::steady_clock::now() >= options.deadline) return AsyncStatus::TIMED_OUT;
+    return AsyncStatus::OK;
+  };
+
+  if (!pond) {
+    return AsyncStatus::UNAVAILABLE;
+  }
+  if (status() != AsyncStatus::OK) {
+    return status();
+  }
+
+  pond->setInterruptCheck([&status]() {
+    return status() != AsyncStatus::OK;
+  });
+  body(*pond);
+  pond->setInterruptCheck(nullptr);
+  return status();
+}
+
+/**
+ * @brief Runs queued jobs on one I/O thread until the facade is destroyed.
+ *
+ * A thread whose connection cannot be opened still drains the queue, so its calls end
+ * as `UNAVAILABLE` instead of hanging.
+ */
+void AsyncPond::_work() {
+  std::unique_ptr<Pond> pond = std::make_unique<Pond>();
+  if (pond->loadDatabase(this->_db_filename)) {
+    std::cerr << "Can't open database for I/O thread: " << this->_db_filename << std::endl;
+    pond.reset();
+  } else {
+    pond->setIndexes(this->_indexes);
+  }
+
+  while (true) {
+    std::function<void(Pond*)> job;
+    {
+      std::unique_lock<std::mutex> lock(this->_lock);
+      this->_ready.wait(lock, [this] {
+        return this->_stopping || !this->_jobs.empty();
+      });
+      if (this->_jobs.empty()) {
+        return;
+      }
+      job = std::move(this->_jobs.front());
+      this->_jobs.pop_front();
+    }
+    job(pond.get());
+  }
+}
@@ -0,0 +1,354 @@
+#include "CacheManager.hh"
+
+#include <algorithm>
+#include <iomanip>
+#include <sqlite3.h>
+
+// Weight a cache keeps from earlier rebalances, so one quiet interval does not
+// take away everything a cache has earned
+static constexpr double WEIGHT_DECAY = 0.5;
+
+// =============================================================================
+// Public Methods
+// =============================================================================
+
+/**
+ * @brief Retrieves the process-wide manager.
+ *
+ * The manager is never destroyed, so caches that outlive static destruction can still
+ * unregister from it.
+ *
+ * @return The shared manager, with `DEFAULT_BUDGET`.
+ */
+CacheManager& CacheManager::shared() {
+  static CacheManager* manager = new CacheManager();
+  return *manager;
+}
+
+/**
+ * @brief Constructs a manager with no caches.
+ *
+ * @param budget The budget in bytes.
+ */
+CacheManager::CacheManager(const size_t& budget) : _budget(budget) {}
+
+/**
+ * @brief Sets the budget and rebalances.
+ *
+ * @param bytes The budget in bytes.
+ */
+void CacheManager::setBudget(const size_t& bytes) {
+  size_t excess;
+  {
+    std::lock_guard<std::mutex> lock(this->_lock);
+    this->_budget = bytes;
+    excess = this->_rebalance();
+  }
+  this->_relieve(excess);
+}
+
+/**
+ * @brief Retrieves the budget.
+ *
+ * @return The budget in bytes.
+ */
+size_t CacheManager::budget() const {
+  std::lock_guard<std::mutex> lock(this->_lock);
+  return this->_budget;
+}
+
+/**
+ * @brief Registers a cache and rebalances to give it a budget.
+ *
+ * @param cache The cache; must be removed before it is destroyed.
+ */
+void CacheManager::add(ManagedCache& cache) {
+  size_t excess;
+  {
+    std::lock_guard<std::mutex> lock(this->_lock);
+    this->_caches.push_back({&cache, 0});
+    excess = this->_rebalance();
+  }
+  this->_relieve(excess);
+}
+
+/**
+ * @brief Unregisters a cache and gives its budget to the others.
+ *
+ * @param cache The cache.
+ */
+void CacheManager::remove(ManagedCache& cache) {
+  size_t excess;
+  {
+    std::lock_guard<std::mutex> lock(this->_lock);
+    this->_caches.erase(std::remove_if(this->_caches.begin(), this->_caches.end(), [&](const Member& member) {
+      return member.cache == &cache;
+    }), this->_caches.end());
+    excess = this->_rebalance();
+  }
+  this->_relieve(excess);
+}
+
+/**
+ * @brief Creates a group of caches whose budgets together stay within a cap.
+ *
+ * @param limit The cap in bytes, or 0 for none.
+ * @return The group's ID, never 0.
+ */
+uint64_t CacheManager::addGroup(const size_t& limit) {
+  std::lock_guard<std::mutex> lock(this->_lock);
+  const uint64_t id = this->_next_group_id++;
+  this->_group_limits.emplace(id, limit);
+  return id;
+}
+
+/**
+ * @brief Deletes a group; its caches, if any remain, are no longer capped.
+ *
+ * @param group The group's ID.
+ */
+void CacheManager::removeGroup(const uint64_t& group) {
+  std::lock_guard<std::mutex> lock(this->_lock);
+  this->_group_limits.erase(group);
+  for (Member& member : this->_caches) {
+    if (member.group == group) {
+      member.group = 0;
+    }
+  }
+}
+
+/**
+ * @brief Moves a registered cache into a group and rebalances.
+ *
+ * @param cache The cache.
+ * @param group The group's ID, or 0 for none.
+ */
+void CacheManager::setGroup(ManagedCache& cache, const uint64_t& group) {
+  size_t excess;
+  {
+    std::lock_guard<std::mutex> lock(this->_lock);
+    for (Member& member : this->_caches) {
+      if (member.cache == &cache) {
+        member.group = group;
+      }
+    }
+    excess = this->_rebalance();
+  }
+  this->_relieve(excess);
+}
+
+/**
+ * @brief Retrieves the bytes held by the caches of a group.
+ *
+ * @param group The group's ID.
+ * @return The number of bytes.
+ */
+size_t CacheManager::groupBytes(const uint64_t& group) const {
+  std::lock_guard<std::mutex> lock(this->_lock);
+  size_t bytes = 0;
+  for (const Member& member : this->_caches) {
+    if (member.group == group) {
+      bytes += member.cache->cacheStats().bytes;
+    }
+  }
+  return bytes;
+}
+
+/**
+ * @brief Registers a callback asked to free memory when the budget is exceeded.
+ *
+ * Callbacks run on whichever thread rebalances, after the manager is unlocked but while
+ * no callback can be added or removed, so they must not call back into the manager.
+ * They should only ask for memory back, e.g. by setting a flag the owner of the memory
+ * checks, rather than touch state owned by another thread.
+ *
+ * @param release Called with the number of bytes over budget.
+ * @return An ID for `removePressureCallback`.
+ */
+uint64_t CacheManager::addPressureCallback(std::function<void(const size_t&)> release) {
+  std::lock_guard<std::mutex> lock(this->_callback_lock);
+  const uint64_t id = this->_next_callback_id++;
+  this->_pressure_callbacks.emplace(id, std::move(release));
+  return id;
+}
+
+/**
+ * @brief Unregisters a pressure callback; it is not running once this returns.
+ *
+ * @param id The ID `addPressureCallback` returned.
+ */
+void CacheManager::removePressureCallback(const uint64_t& id) {
+  std::lock_guard<std::mutex> lock(this->_callback_lock);
+  this->_pressure_callbacks.erase(id);
+}
+
+/**
+ * @brief Counts a store into a cache, rebalancing every `REBALANCE_INTERVAL` stores.
+ *
+ * Must not be called while holding a cache's lock, since rebalancing locks every cache.
+ */
+void CacheManager::noteStore() {
+  if (this->_stores.fetch_add(1, std::memory_order_relaxed) % REBALANCE_INTERVAL == REBALANCE_INTERVAL - 1) {
+    this->rebalance();
+  }
+}
+
+/**
+ * @brief Divides the budget among the caches now.
+ */
+void CacheManager::rebalance() {
+  size_t excess;
+  {
+    std::lock_guard<std::mutex> lock(this->_lock);
+    excess = this->_rebalance();
+  }
+  this->_relieve(excess);
+}
+
+/**
+ * @brief Retrieves the memory accounting and the counters of every cache.
+ *
+ * @return A snapshot of the accounting.
+ */
+CacheManager::Stats CacheManager::stats() const {
+  Stats stats;
+  sqlite3_int64 page_cache = 0;
+  sqlite3_int64 page_cache_highwater = 0;
+  sqlite3_status64(SQLITE_STATUS_PAGECACHE_OVERFLOW, &page_cache, &page_cache_highwater, 0);
+  stats.sqlite_bytes = sqlite3_memory_used();
+  stats.page_cache_bytes = page_cache;
+
+  std::lock_guard<std::mutex> lock(this->_lock);
+  stats.budget = this->_budget;
+  stats.rebalances = this->_rebalances;
+  stats.pressure_events = this->_pressure_events.load(std::memory_order_relaxed);
+  for (const Member& member : this->_caches) {
+    stats.caches.push_back(member.cache->cacheStats());
+    stats.cache_bytes += stats.caches.back().bytes;
+  }
+  return stats;
+}
+
+/**
+ * @brief Prints the accounting as a table, one row per cache.
+ *
+ * @param out The stream to print to.
+ */
+void CacheManager::report(std::ostream& out) const {
+  const Stats stats = this->stats();
+  auto kib = [](const double& bytes) {
+    return static_cast<uint64_t>(bytes / 1024 + 0.5);
+  };
+
+  out << "Cache memory: " << kib(stats.cache_bytes) << " KiB in caches, "
+      << kib(stats.sqlite_bytes) << " KiB in SQLite (" << kib(stats.page_cache_bytes) << " KiB page cache), of "
+      << kib(stats.budget) << " KiB; " << stats.rebalances << " rebalances, "
+      << stats.pressure_events << " under pressure\n";
+  out << std::left << std::setw(12) << "cache" << std::right
+      << std::setw(10) << "hits" << std::setw(10) << "misses" << std::setw(9) << "hit %"
+      << std::setw(11) << "evictions" << std::setw(9) << "refused" << std::setw(8) << "ghost"
+      << std::setw(9) << "entries" << std::setw(10) << "KiB" << std::setw(12) << "budget KiB" << "\n";
+  for (const CacheStats& cache : stats.caches) {
+    const uint64_t lookups = cache.hits + cache.misses;
+    out << std::left << std::setw(12) << cache.name << std::right
+        << std::setw(10) << cache.hits << std::setw(10) << cache.misses
+        << std::setw(9) << std::fixed << std::setprecision(1) << (lookups ? 100.0 * cache.hits / lookups : 0.0)
+        << std::setw(11) << cache.evictions << std::setw(9) << cache.refused << std::setw(8) << cache.ghost_hits
+        << std::setw(9) << cache.entries << std::setw(10) << kib(cache.bytes) << std::setw(12) << kib(cache.budget) << "\n";
+  }
+}
+
+// =============================================================================
+// Private Methods
+// =============================================================================
+
+/**
+ * @brief Asks the pressure callbacks to free memory; the caller must not hold `_lock`.
+ *
+ * @param excess The number of bytes over budget, or 0 if there is nothing to free.
+ */
+void CacheManager::_relieve(const size_t& excess) {
+  if (excess == 0) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(this->_callback_lock);
+  if (this->_pressure_callbacks.empty()) {
+    return;
+  }
+  this->_pressure_events.fetch_add(1, std::memory_order_relaxed);
+  for (auto& [id, release] : this->_pressure_callbacks) {
+    release(excess);
+  }
+}
+
+/**
+ * @brief Divides the budget among the caches; the caller holds `_lock`.
+ *
+ * What SQLite holds is taken off the top. Every cache gets `MIN_CACHE_BUDGET`, or an
+ * even split of what is available if that is less, and the rest is shared by weight:
+ * half the previous weight plus the ghost hits since the last rebalance, plus one so a
+ * cache with no ghost hits keeps a small share. Shares of a capped group that would
+ * exceed its cap are scaled down, and what they give up is shared among the caches
+ * outside capped groups.
+ *
+ * @return The number of bytes SQLite and the caches still hold over the budget, for
+ *         `_relieve` once the caller has released `_lock`.
+ */
+size_t CacheManager::_rebalance() {
+  ++this->_rebalances;
+  if (this->_caches.empty()) {
+    return 0;
+  }
+
+  const size_t sqlite_bytes = static_cast<size_t>(std::max<sqlite3_int64>(sqlite3_memory_used(), 0));
+  const size_t available = this->_budget > sqlite_bytes ? this->_budget - sqlite_bytes : 0;
+  const size_t floor = std::min(MIN_CACHE_BUDGET, available / this->_caches.size());
+  const size_t spare = available - floor * this->_caches.size();
+
+  double total_weight = 0;
+  for (Member& member : this->_caches) {
+    member.weight = member.weight * WEIGHT_DECAY + static_cast<double>(member.cache->takeGhostHits());
+    total_weight += member.weight + 1;
+  }
+
+  std::vector<size_t> budgets(this->_caches.size());
+  std::map<uint64_t, size_t> group_bytes;
+  for (size_t i = 0; i < this->_caches.size(); ++i) {
+    const Member& member = this->_caches[i];
+    budgets[i] = floor + static_cast<size_t>(static_cast<double>(spare) * (member.weight + 1) / total_weight);
+    group_bytes[member.group] += budgets[i];
+  }
+
+  // Scale capped groups down to their caps, and hand what they give up to everyone else
+  size_t freed = 0;
+  double free_weight = 0;
+  for (size_t i = 0; i < this->_caches.size(); ++i) {
+    const Member& member = this->_caches[i];
+    auto limit = this->_group_limits.find(member.group);
+    if (member.group == 0 || limit == this->_group_limits.end() || limit->second == 0) {
+      free_weight += member.weight + 1;
+      continue;
+    }
+    const size_t total = group_bytes[member.group];
+    if (total > limit->second) {
+      const size_t capped = static_cast<size_t>(static_cast<double>(budgets[i]) * limit->second / total);
+      freed += budgets[i] - capped;
+      budgets[i] = capped;
+    }
+  }
+
+  size_t cache_bytes = 0;
+  for (size_t i = 0; i < this->_caches.size(); ++i) {
+    Member& member = this->_caches[i];
+    auto limit = this->_group_limits.find(member.group);
+    const bool capped = member.group != 0 && limit != this->_group_limits.end() && limit->second != 0;
+    if (!capped && free_weight > 0) {
+      budgets[i] += static_cast<size_t>(static_cast<double>(freed) * (member.weight + 1) / free_weight);
+    }
+    member.cache->setBudget(budgets[i]);
+    cache_bytes += member.cache->cacheStats().bytes;
+  }
+
+  // The caches now fit their budgets; anything still over is SQLite's
+  return sqlite_bytes + cache_bytes > this->_budget ? sqlite_bytes + cache_bytes - this->_budget : 0;
+}
@@ -0,0 +1,413 @@
+#include "DigestJob.hh"
+
+#include <algorithm>
+#include <chrono>
+#include <ctime>
+#include <filesystem>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+// Users written by one task
+static const size_t DIGEST_CHUNK_SIZE = 64;
+
+// Holds the date of a run until it completes, so a resumed run keeps writing that day's
+// shards and reads the same window of quacks
+static const char* DIGEST_STATE_FILE = "digest-in-progress.txt";
+
+// =============================================================================
+// Public Methods
+// =============================================================================
+
+/**
+ * @brief Constructs a digest job with the given options.
+ *
+ * @param options The configuration of the run.
+ */
+DigestJob::DigestJob(const Options& options)
+  : _options(options),
+    _shard_locks(std::max<uint32_t>(options.shards, 1)) {
+  this->_options.shards = std::max<uint32_t>(options.shards, 1);
+  this->_options.top_k = std::max<uint32_t>(options.top_k, 1);
+}
+
+/**
+ * @brief Runs the job to completion, resuming any earlier interrupted run.
+ *
+ * @return true if every user's digest was written; false if the database could not
+ *         be read or an output file could not be opened.
+ */
+bool DigestJob::run() {
+  if (!this->_resume()) {
+    return false;
+  }
+
+  sqlite3* db = nullptr;
+  if (sqlite3_open_v2(this->_options.db_filename.c_str(), &db, SQLITE_OPEN_READONLY, nullptr) != SQLITE_OK) {
+    std::cerr << "Can't open database: " << sqlite3_errmsg(db) << std::endl;
+    sqlite3_close(db);
+    return false;
+  }
+  bool loaded = this->_load(db);
+  sqlite3_close(db);
+  if (!loaded) {
+    return false;
+  }
+
+  // A dedicated pool only when a thread count is given; otherwise share the process's
+  std::unique_ptr<TaskScheduler> dedicated;
+  if (this->_options.threads > 0) {
+    dedicated = std::make_unique<TaskScheduler>(this->_options.threads);
+  }
+  TaskScheduler& scheduler = dedicated ? *dedicated : TaskScheduler::shared();
+
+  const size_t total = this->_users.size();
+  TaskScheduler::TaskGroup chunks(scheduler, TaskScheduler::Priority::BACKGROUND);
+  for (size_t begin = 0; begin < total; begin += DIGEST_CHUNK_SIZE) {
+    const size_t end = std::min(total, begin + DIGEST_CHUNK_SIZE);
+    chunks.run([this, begin, end] {
+      this->_work(begin, end);
+    });
+  }
+
+  // Report progress roughly once a second until every user has been handled
+  auto last_report = std::chrono::steady_clock::now();
+  while (!chunks.done()) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    auto now = std::chrono::steady_clock::now();
+    if (now - last_report >= std::chrono::seconds(1)) {
+      std::cerr << "Digest: " << this->_processed << "/" << total << " users" << std::endl;
+      last_report = now;
+    }
+  }
+  chunks.wait();
+
+  bool written = true;
+  for (std::ofstream& file : this->_shard_files) {
+    file.close();
+    written = written && !file.fail();
+  }
+
+  std::cerr << "Digest: " << total << "/" << total << " users ("
+            << this->_completed.size() << " resumed)" << std::endl;
+
+  // The next run starts a new day's digest
+  if (written) {
+    std::error_code error;
+    std::filesystem::remove(this->_options.output_dir + "/" + DIGEST_STATE_FILE, error);
+  }
+  return written;
+}
+
+// =============================================================================
+// Private Methods
+// =============================================================================
+
+/**
+ * @brief Loads users, the follow graph and every author's ranked recent quacks.
+ *
+ * Requack and reply counts are computed with one grouped pass each over the recent
+ * quacks rather than a correlated count per quack.
+ *
+ * @param db The open database connection.
+ * @return true if all shared data was loaded; false otherwise.
+ */
+bool DigestJob::_load(sqlite3* db) {
+  sqlite3_stmt* stmt;
+
+  // Once Pond has opened the database, deleted users and quacks are hidden by its views
+  const bool has_views = sqlite3_prepare_v2(db, "SELECT 1 FROM live_tweets", -1, &stmt, nullptr) == SQLITE_OK;
+  sqlite3_finalize(stmt);
+  const std::string users = has_views ? "live_users" : "users";
+  const std::string tweets = has_views ? "live_tweets" : "tweets";
+  const std::string retweets = has_views ? "live_retweets" : "retweets";
+
+  const std::string users_query =
+    "SELECT usr, name FROM " + users + " ORDER BY usr";
+
+  if (sqlite3_prepare_v2(db, users_query.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
+    sqlite3_finalize(stmt);
+    return false;
+  }
+  while (sqlite3_step(stmt) == SQLITE_ROW) {
+    int32_t user_id = sqlite3_column_int(stmt, 0);
+    const unsigned char* name = sqlite3_column_text(stmt, 1);
+    this->_users.push_back(user_id);
+    this->_names[user_id] = name ? reinterpret_cast<const char*>(name) : "";
+  }
+  sqlite3_finalize(stmt);
+
+  const char* follows_query =
+    "SELECT flwer, flwee FROM follows";
+
+  if (sqlite3_prepare_v2(db, follows_query, -1, &stmt, nullptr) != SQLITE_OK) {
+    sqlite3_finalize(stmt);
+    return false;
+  }
+  while (sqlite3_step(stmt) == SQLITE_ROW) {
+    this->_follows[sqlite3_column_int(stmt, 0)].push_back(sqlite3_column_int(stmt, 1));
+  }
+  sqlite3_finalize(stmt);
+
+  const std::string quacks_query =
+    "WITH recent AS ("
+    "  SELECT tid, writer_id, text, tdate, ttime "
+    "  FROM " + tweets + " "
+    "  WHERE tdate >= date(?1, ?2)"
+    "), "
+    "requacks AS ("
+    "  SELECT tid, COUNT(*) AS n FROM " + retweets + " "
+    "  WHERE spam = 0 AND tid IN (SELECT tid FROM recent) "
+    "  GROUP BY tid"
+    "), "
+    "replies AS ("
+    "  SELECT replyto_tid AS tid, COUNT(*) AS n FROM " + tweets + " "
+    "  WHERE replyto_tid IN (SELECT tid FROM recent) "
+    "  GROUP BY replyto_tid"
+    ") "
+    "SELECT r.tid, r.writer_id, r.text, r.tdate, r.ttime, IFNULL(rq.n, 0), IFNULL(rp.n, 0) "
+    "FROM recent r "
+    "LEFT JOIN requacks rq ON rq.tid = r.tid "
+    "LEFT JOIN replies rp ON rp.tid = r.tid";
+
+  if (sqlite3_prepare_v2(db, quacks_query.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
+    sqlite3_finalize(stmt);
+    return false;
+  }
+
+  // "Recent" is counted back from the day the job started, not the day it resumed
+  std::string window = "-" + std::to_string(this->_options.days) + " days";
+  sqlite3_bind_text(stmt, 1, this->_date.c_str(), -1, SQLITE_STATIC);
+  sqlite3_bind_text(stmt, 2, window.c_str(), -1, SQLITE_STATIC);
+
+  while (sqlite3_step(stmt) == SQLITE_ROW) {
+    Entry entry;
+    entry.tid = sqlite3_column_int(stmt, 0);
+    entry.writer_id = sqlite3_column_int(stmt, 1);
+    const unsigned char* text = sqlite3_column_text(stmt, 2);
+    const unsigned char* date = sqlite3_column_text(stmt, 3);
+    const unsigned char* time = sqlite3_column_text(stmt, 4);
+    entry.text = text ? reinterpret_cast<const char*>(text) : "";
+    entry.date = date ? reinterpret_cast<const char*>(date) : "";
+    entry.time = time ? reinterpret_cast<const char*>(time) : "";
+    entry.requacks = sqlite3_column_int(stmt, 5);
+    entry.replies = sqlite3_column_int(stmt, 6);
+    entry.score = 2 * static_cast<uint64_t>(entry.requacks) + entry.replies;
+
+    auto name = this->_names.find(entry.writer_id);
+    entry.author = name != this->_names.end() ? name->second : "Unknown";
+    this->_top_by_author[entry.writer_id].push_back(std::move(entry));
+  }
+  sqlite3_finalize(stmt);
+
+  // Rank each author's quacks once and keep only what can reach any digest
+  for (auto& [writer_id, entries] : this->_top_by_author) {
+    std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) {
+      if (a.score != b.score) return a.score > b.score;
+      if (a.date != b.date) return a.date > b.date;
+      if (a.time != b.time) return a.time > b.time;
+      return a.tid > b.tid;
+    });
+    if (entries.size() > this->_options.top_k) {
+      entries.resize(this->_options.top_k);
+    }
+  }
+
+  return true;
+}
+
+/**
+ * @brief Picks up the date of an interrupted run, scans its shard files for completed
+ *        digests and truncates partial ones.
+ *
+ * The date of a run is the UTC date it first started on, kept in the output directory
+ * until the run completes; a run resumed after midnight still writes the shards it
+ * started. Every digest ends with an `=== End <user id> ===` line, and no other line
+ * starts that way since quack text and names are escaped. Anything after the last such
+ * line belongs to a digest that was being written when the previous run stopped, so it
+ * is cut off and that user is processed again.
+ *
+ * @return true if every shard file is ready for appending; false otherwise.
+ */
+bool DigestJob::_resume() {
+  std::error_code error;
+  std::filesystem::create_directories(this->_options.output_dir, error);
+  if (error) {
+    std::cerr << "Can't create output directory: " << this->_options.output_dir << std::endl;
+    return false;
+  }
+
+  const std::string state_path = this->_options.output_dir + "/" + DIGEST_STATE_FILE;
+  std::ifstream state(state_path);
+  std::getline(state, this->_date);
+  state.close();
+  if (this->_date.size() != 10) {
+    std::time_t rn = std::time(nullptr);
+    std::tm gmt;
+    char date[11];
+    std::strftime(date, sizeof(date), "%F", gmtime_r(&rn, &gmt));
+    this->_date = date;
+
+    std::ofstream started(state_path, std::ios::trunc);
+    started << this->_date << "\n";
+    started.close();
+    if (started.fail()) {
+      std::cerr << "Can't write job state: " << state_path << std::endl;
+      return false;
+    }
+  }
+
+  const std::string end_marker = "=== End ";
+  for (uint32_t shard = 0; shard < this->_options.shards; ++shard) {
+    const std::string path = this->_shardPath(shard);
+
+    if (std::filesystem::exists(path)) {
+      std::ifstream existing(path, std::ios::binary);
+      std::string line;
+      std::streamoff offset = 0;
+      std::streamoff complete_until = 0;
+      while (std::getline(existing, line)) {
+        offset += line.size() + 1;
+        if (line.compare(0, end_marker.size(), end_marker) == 0) {
+          this->_completed.insert(std::atoi(line.c_str() + end_marker.size()));
+          complete_until = offset;
+        }
+      }
+      existing.close();
+      std::filesystem::resize_file(path, complete_until, error);
+      if (error) {
+        std::cerr << "Can't truncate shard: " << path << std::endl;
+        return false;
+      }
+    }
+
+    this->_shard_files.emplace_back(path, std::ios::app | std::ios::binary);
+    if (!this->_shard_files.back().is_open()) {
+      std::cerr << "Can't open shard: " << path << std::endl;
+      return false;
+    }
+  }
+
+  return true;
+}
+
+/**
+ * @brief Writes the digests of a chunk of users.
+ *
+ * @param begin The index of the first user of the chunk.
+ * @param end One past the index of the last user of the chunk.
+ */
+void DigestJob::_work(const size_t& begin, const size_t& end) {
+  for (size_t i = begin; i < end; ++i) {
+    const int32_t user_id = this->_users[i];
+    if (this->_completed.find(user_id) == this->_completed.end()) {
+      std::string digest = this->_buildDigest(user_id);
+      if (!digest.empty()) {
+        uint32_t shard = static_cast<uint32_t>(user_id) % this->_options.shards;
+        std::lock_guard<std::mutex> lock(this->_shard_locks[shard]);
+        this->_shard_files[shard] << digest;
+        this->_shard_files[shard].flush();
+      }
+    }
+    ++this->_processed;
+  }
+}
+
+/**
+ * @brief Builds the digest text of a single user.
+ *
+ * Keeps the user's best `top_k` entries in a min-heap. Each followed author's list is
+ * already sorted, so scanning it stops at the first entry that cannot enter the heap.
+ *
+ * @param user_id The unique ID of the user.
+ * @return The formatted digest, or an empty string if the user has nothing to read.
+ */
+std::string DigestJob::_buildDigest(const int32_t& user_id) {
+  auto follows = this->_follows.find(user_id);
+  if (follows == this->_follows.end()) {
+    return "";
+  }
+
+  // "Greater" ordering turns the std heap into a min-heap on rank
+  auto better = [](const Entry* a, const Entry* b) {
+    if (a->score != b->score) return a->score > b->score;
+    if (a->date != b->date) return a->date > b->date;
+    if (a->time != b->time) return a->time > b->time;
+    return a->tid > b->tid;
+  };
+
+  std::vector<const Entry*> heap;
+  for (const int32_t& followee : follows->second) {
+    auto entries = this->_top_by_author.find(followee);
+    if (entries == this->_top_by_author.end()) continue;
+
+    for (const Entry& entry : entries->second) {
+      if (heap.size() < this->_options.top_k) {
+        heap.push_back(&entry);
+        std::push_heap(heap.begin(), heap.end(), better);
+      } else if (better(&entry, heap.front())) {
+        std::pop_heap(heap.begin(), heap.end(), better);
+        heap.back() = &entry;
+        std::push_heap(heap.begin(), heap.end(), better);
+      } else {
+        break;
+      }
+    }
+  }
+
+  if (heap.empty()) {
+    return "";
+  }
+  std::sort(heap.begin(), heap.end(), better);
+
+  auto name = this->_names.find(user_id);
+  std::ostringstream oss;
+  oss << "=== Digest for User " << user_id << " (" << _escape(name != this->_names.end() ? name->second : "Unknown")
+      << ") " << this->_date << " ===\n";
+  int32_t rank = 1;
+  for (const Entry* entry : heap) {
+    oss << rank++ << ". Quack Id: " << entry->tid << ", Author: " << _escape(entry->author)
+        << ", Date and Time: " << entry->date << " " << entry->time
+        << ", Requacks: " << entry->requacks << ", Replies: " << entry->replies << "\n"
+        << "   Text: " << _escape(entry->text) << "\n";
+  }
+  oss << "=== End " << user_id << " ===\n";
+
+  return oss.str();
+}
+
+/**
+ * @brief Retrieves the path of a shard's output file.
+ *
+ * @param shard The shard index.
+ * @return The path of the shard file.
+ */
+std::string DigestJob::_shardPath(const uint32_t& shard) const {
+  return this->_options.output_dir + "/digest-" + this->_date + "-" + std::to_string(shard) + ".txt";
+}
+
+/**
+ * @brief Escapes text written into a digest so it stays on one line.
+ *
+ * Backslashes, line feeds and carriage returns become `\\`, `\n` and `\r`, so text
+ * cannot start a line of its own and pass for an end marker.
+ *
+ * @param text The text of a quack or a name.
+ * @return The escaped text.
+ */
+std::string DigestJob::_escape(const std::string& text) {
+  if (text.find_first_of("\\\n\r") == std::string::npos) {
+    return text;
+  }
+  std::string escaped;
+  escaped.reserve(text.size() + 8);
+  for (const char& c : text) {
+    switch (c) {
+      case '\\': escaped += "\\\\"; break;
+      case '\n': escaped += "\\n"; break;
+      case '\r': escaped += "\\r"; break;
+      default: escaped += c;
+    }
+  }
+  return escaped;
+}
@@ -0,0 +1,381 @@
+#include "EngagementBoards.hh"
+
+#include <ctime>
+#include <iostream>
+
+// Bucket width and count of each window, in `Window` order
+static constexpr int64_t WINDOW_BUCKET_SECONDS[] = {5 * 60, 60 * 60, 6 * 60 * 60};
+static constexpr size_t WINDOW_BUCKETS[] = {12, 24, 28};
+static constexpr size_t WINDOWS = 3;
+static constexpr size_t METRICS = 3;
+
+// The widest window: everything older is outside every leaderboard
+static constexpr int64_t LOAD_SECONDS = WINDOW_BUCKET_SECONDS[2] * static_cast<int64_t>(WINDOW_BUCKETS[2]);
+
+// =============================================================================
+// Public Methods
+// =============================================================================
+
+/**
+ * @brief Constructs empty leaderboards, loaded on first read.
+ */
+EngagementBoards::EngagementBoards() {
+  this->_boards.reserve(2 * METRICS * WINDOWS);
+  for (size_t i = 0; i < 2 * METRICS * WINDOWS; ++i) {
+    this->_boards.emplace_back(WINDOW_BUCKET_SECONDS[i % WINDOWS], WINDOW_BUCKETS[i % WINDOWS]);
+  }
+}
+
+/**
+ * @brief Loads the leaderboards if they have not been loaded or the database has
+ *        changed since they were.
+ *
+ * Writes made through the connections sharing the leaderboards are recorded in them
+ * and move their version past them, so only a write made elsewhere reloads them.
+ *
+ * @param db The connection to read through.
+ * @return true if the leaderboards are current; false if they could not be loaded.
+ */
+bool EngagementBoards::refresh(sqlite3* db) {
+  std::lock_guard<std::mutex> lock(this->_lock);
+  return this->_refresh(db);
+}
+
+/**
+ * @brief Forgets the loaded leaderboards, so the next read loads them again; for
+ *        changes a connection made without recording them, e.g. deletions.
+ */
+void EngagementBoards::invalidate() {
+  std::lock_guard<std::mutex> lock(this->_lock);
+  this->_version.invalidate();
+}
+
+/**
+ * @brief Moves the leaderboards past a write whose changes were recorded in them.
+ *
+ * @param from The version of the tables when the write began.
+ * @param to The version of the tables once the write is done.
+ */
+void EngagementBoards::advance(const int64_t& from, const int64_t& to) {
+  std::lock_guard<std::mutex> lock(this->_lock);
+  this->_version.advance(from, to);
+}
+
+/**
+ * @brief Retrieves the number of loads and invalidations of the leaderboards so far.
+ *
+ * @return The count.
+ */
+uint64_t EngagementBoards::loads() const {
+  std::lock_guard<std::mutex> lock(this->_lock);
+  return this->_version.loads();
+}
+
+/**
+ * @brief Records requacks of a quack made through a connection sharing the leaderboards.
+ *
+ * Ignored until the leaderboards have been loaded, since the load will read them.
+ *
+ * @param quack_id The unique ID of the requacked quack.
+ * @param author_id The unique ID of its author.
+ * @param count 1 for a new requack, -1 for one flagged as spam.
+ * @param time When the requack was made, in seconds since the epoch; a requack flagged
+ *             as spam is taken out of the buckets it was added to.
+ */
+void EngagementBoards::recordRequack(const int32_t& quack_id, const int32_t& author_id, const int64_t& count, const int64_t& time) {
+  std::lock_guard<std::mutex> lock(this->_lock);
+  if (!this->_version.isLoaded()) {
+    return;
+  }
+  const int64_t now = std::time(nullptr);
+  this->_add(false, Metric::REQUACKS, quack_id, count, time, now);
+  this->_add(true, Metric::REQUACKS, author_id, count, time, now);
+}
+
+/**
+ * @brief Records a reply made through a connection sharing the leaderboards.
+ *
+ * Ignored until the leaderboards have been loaded, since the load will read it.
+ *
+ * @param quack_id The unique ID of the quack replied to.
+ * @param author_id The unique ID of its author.
+ */
+void EngagementBoards::recordReply(const int32_t& quack_id, const int32_t& author_id) {
+  std::lock_guard<std::mutex> lock(this->_lock);
+  if (!this->_version.isLoaded()) {
+    return;
+  }
+  const int64_t now = std::time(nullptr);
+  this->_add(false, Metric::REPLIES, quack_id, 1, now, now);
+  this->_add(true, Metric::REPLIES, author_id, 1, now, now);
+}
+
+/**
+ * @brief Records follows made through a connection sharing the leaderboards.
+ *
+ * Ignored until the leaderboards have been loaded, since the load will read them.
+ *
+ * @param followee_id The unique ID of the followed user.
+ * @param count 1 for a follow, -1 for an unfollow.
+ */
+void EngagementBoards::recordFollow(const int32_t& followee_id, const int64_t& count) {
+  std::lock_guard<std::mutex> lock(this->_lock);
+  if (!this->_version.isLoaded()) {
+    return;
+  }
+  const int64_t now = std::time(nullptr);
+  this->_add(true, Metric::FOLLOWERS, followee_id, count, now, now);
+}
+
+/**
+ * @brief Takes the engagement of quacks being deleted through a connection sharing the
+ *        leaderboards out of them.
+ *
+ * Must be called while the quacks are still live, inside the write deleting them: the
+ * requacks they received and the replies they are come off every board they were
+ * counted on. Ignored until the leaderboards have been loaded, since the load will
+ * leave the quacks out.
+ *
+ * @param db The connection deleting the quacks.
+ * @param quack_ids The unique IDs of the quacks.
+ * @return true if the leaderboards were updated or not loaded; false if they were
+ *         forgotten because the engagement could not be read.
+ */
+bool EngagementBoards::removeQuacks(sqlite3* db, const std::vector<int32_t>& quack_ids) {
+  std::lock_guard<std::mutex> lock(this->_lock);
+  if (!this->_version.isLoaded()) {
+    return true;
+  }
+
+  const char* requacks =
+    "SELECT tid, writer_id, CAST(strftime('%s', rdate || ' ' || IFNULL(rtime, '00:00:00')) AS INTEGER) "
+    "FROM live_retweets "
+    "WHERE spam = 0 AND rdate >= date(?1, 'unixepoch') AND tid = ?2;";
+  const char* replies =
+    "SELECT c.replyto_tid, p.writer_id, CAST(strftime('%s', c.tdate || ' ' || c.ttime) AS INTEGER) "
+    "FROM live_tweets c JOIN live_tweets p ON p.tid = c.replyto_tid "
+    "WHERE c.tdate >= date(?1, 'unixepoch') AND c.tid = ?2;";
+  const int64_t now = std::time(nullptr);
+  for (const int32_t& quack_id : quack_ids) {
+    if (!this->_read(db, requacks, Metric::REQUACKS, true, quack_id, -1, now) ||
+        !this->_read(db, replies, Metric::REPLIES, true, quack_id, -1, now)) {
+      this->_version.invalidate();
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * @brief Retrieves the quacks with the most engagement.
+ *
+ * @param db The connection to load the leaderboards through.
+ * @param metric What to rank by; `FOLLOWERS` ranks no quacks.
+ * @param window The rolling window.
+ * @param count The number of quacks.
+ * @return Up to `count` quack IDs and totals, highest first.
+ */
+std::vector<Leaderboard::Entry> EngagementBoards::topQuacks(sqlite3* db, const Metric& metric, const Window& window, const size_t& count) {
+  std::lock_guard<std::mutex> lock(this->_lock);
+  if (!this->_refresh(db)) {
+    return {};
+  }
+  return this->_board(false, metric, window).top(count);
+}
+
+/**
+ * @brief Retrieves the accounts with the most engagement.
+ *
+ * @param db The connection to load the leaderboards through.
+ * @param metric What to rank by.
+ * @param window The rolling window.
+ * @param count The number of accounts.
+ * @return Up to `count` user IDs and totals, highest first.
+ */
+std::vector<Leaderboard::Entry> EngagementBoards::topAccounts(sqlite3* db, const Metric& metric, const Window& window, const size_t& count) {
+  std::lock_guard<std::mutex> lock(this->_lock);
+  if (!this->_refresh(db)) {
+    return {};
+  }
+  return this->_board(true, metric, window).top(count);
+}
+
+/**
+ * @brief Retrieves the rank of a quack.
+ *
+ * @param db The connection to load the leaderboards through.
+ * @param quack_id The unique ID of the quack.
+ * @param metric What to rank by.
+ * @param window The rolling window.
+ * @return The 1-based rank, or 0 if the quack is unranked.
+ */
+size_t EngagementBoards::quackRank(sqlite3* db, const int32_t& quack_id, const Metric& metric, const Window& window) {
+  std::lock_guard<std::mutex> lock(this->_lock);
+  if (!this->_refresh(db)) {
+    return 0;
+  }
+  return this->_board(false, metric, window).rank(quack_id);
+}
+
+/**
+ * @brief Retrieves the rank of an account.
+ *
+ * @param db The connection to load the leaderboards through.
+ * @param user_id The unique ID of the user.
+ * @param metric What to rank by.
+ * @param window The rolling window.
+ * @return The 1-based rank, or 0 if the account is unranked.
+ */
+size_t EngagementBoards::accountRank(sqlite3* db, const int32_t& user_id, const Metric& metric, const Window& window) {
+  std::lock_guard<std::mutex> lock(this->_lock);
+  if (!this->_refresh(db)) {
+    return 0;
+  }
+  return this->_board(true, metric, window).rank(user_id);
+}
+
+// =============================================================================
+// Private Methods
+// =============================================================================
+
+/**
+ * @brief Loads the leaderboards unless they are current; the caller holds `_lock`.
+ *
+ * @param db The connection to read through.
+ * @return true if the leaderboards are current; false if they could not be loaded.
+ */
+bool EngagementBoards::_refresh(sqlite3* db) {
+  const int64_t version = IndexVersion::read(db);
+  if (version < 0) {
+    return false;
+  }
+  if (this->_version.current(version)) {
+    return true;
+  }
+  const bool loaded = this->_load(db);
+  this->_version.loaded(loaded ? version : -1);
+  return loaded;
+}
+
+/**
+ * @brief Reads the last week of engagement into empty leaderboards.
+ *
+ * Only rows dated within the widest window are read; each one is then added to every
+ * window it still falls in.
+ *
+ * @param db The connection to read through.
+ * @return true if the tables were read; false otherwise.
+ */
+bool EngagementBoards::_load(sqlite3* db) {
+  for (Leaderboard& board : this->_boards) {
+    board.clear();
+  }
+
+  struct Source {
+    const char* query;
+    Metric metric;
+    bool has_quack;   // column 0 is a quack, column 1 its author; otherwise column 0 is a user
+  };
+  const Source sources[] = {
+    {"SELECT tid, writer_id, CAST(strftime('%s', rdate || ' ' || IFNULL(rtime, '00:00:00')) AS INTEGER) "
+     "FROM live_retweets "
+     "WHERE spam = 0 AND rdate >= date(?1, 'unixepoch');",
+     Metric::REQUACKS, true},
+    {"SELECT c.replyto_tid, p.writer_id, CAST(strftime('%s', c.tdate || ' ' || c.ttime) AS INTEGER) "
+     "FROM live_tweets c JOIN live_tweets p ON p.tid = c.replyto_tid "
+     "WHERE c.tdate >= date(?1, 'unixepoch');",
+     Metric::REPLIES, true},
+    {"SELECT flwee, 0, CAST(strftime('%s', start_date) AS INTEGER) FROM follows "
+     "WHERE start_date >= date(?1, 'unixepoch') "
+     "AND flwer IN (SELECT usr FROM live_users) AND flwee IN (SELECT usr FROM live_users);",
+     Metric::FOLLOWERS, false},
+  };
+
+  const int64_t now = std::time(nullptr);
+  for (const Source& source : sources) {
+    if (!this->_read(db, source.query, source.metric, source.has_quack, 0, 1, now)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * @brief Adds the engagement a query returns to the leaderboards.
+ *
+ * The query binds the start of the widest window to `?1` and, if given, a quack to
+ * `?2`; it returns an ID, the quack's author or 0, and a time in seconds since the epoch.
+ *
+ * @param db The connection to read through.
+ * @param query The SQL query.
+ * @param metric What the rows count towards.
+ * @param has_quack Whether column 0 is a quack and column 1 its author, rather than a user.
+ * @param quack_id The quack bound to `?2`, or 0 for none.
+ * @param score What each row adds; -1 to take rows out.
+ * @param now The current time, in seconds since the epoch.
+ * @return true if the query ran; false otherwise.
+ */
+bool EngagementBoards::_read(sqlite3* db, const char* query, const Metric& metric, const bool& has_quack,
+                             const int32_t& quack_id, const int64_t& score, const int64_t& now) {
+  sqlite3_stmt* stmt;
+  if (sqlite3_prepare_v2(db, query, -1, &stmt, nullptr) != SQLITE_OK) {
+    std::cerr << "SQL Error (leaderboards): " << sqlite3_errmsg(db) << std::endl;
+    sqlite3_finalize(stmt);
+    return false;
+  }
+  sqlite3_bind_int64(stmt, 1, now - LOAD_SECONDS);
+  if (quack_id != 0) {
+    sqlite3_bind_int(stmt, 2, quack_id);
+  }
+
+  int rc;
+  while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+    const int32_t id = sqlite3_column_int(stmt, 0);
+    const int64_t time = sqlite3_column_int64(stmt, 2);
+    if (has_quack) {
+      this->_add(false, metric, id, score, time, now);
+      this->_add(true, metric, sqlite3_column_int(stmt, 1), score, time, now);
+    } else {
+      this->_add(true, metric, id, score, time, now);
+    }
+  }
+  sqlite3_finalize(stmt);
+  if (rc != SQLITE_DONE) {
+    std::cerr << "SQL Error (leaderboards): " << sqlite3_errmsg(db) << std::endl;
+    return false;
+  }
+  return true;
+}
+
+/**
+ * @brief Adds a score to one ranking in every window.
+ *
+ * @param accounts Whether the ranking is of accounts rather than quacks.
+ * @param metric What the ranking is by.
+ * @param id The quack or user ID.
+ * @param score The score.
+ * @param time When it happened, in seconds since the epoch.
+ * @param now The current time, in seconds since the epoch.
+ */
+void EngagementBoards::_add(const bool& accounts, const Metric& metric, const int32_t& id, const int64_t& score,
+                            const int64_t& time, const int64_t& now) {
+  for (size_t window = 0; window < WINDOWS; ++window) {
+    const size_t index = ((accounts ? METRICS : 0) + static_cast<size_t>(metric)) * WINDOWS + window;
+    this->_boards[index].add(id, score, time, now);
+  }
+}
+
+/**
+ * @brief Retrieves one ranking, with expired buckets dropped.
+ *
+ * @param accounts Whether the ranking is of accounts rather than quacks.
+ * @param metric What the ranking is by.
+ * @param window The rolling window.
+ * @return The ranking.
+ */
+Leaderboard& EngagementBoards::_board(const bool& accounts, const Metric& metric, const Window& window) {
+  const size_t index = ((accounts ? METRICS : 0) + static_cast<size_t>(metric)) * WINDOWS + static_cast<size_t>(window);
+  Leaderboard& board = this->_boards[index];
+  board.advance(std::time(nullptr));
+  return board;
+}
@@ -0,0 +1,351 @@
+#include "EventLoop.hh"
+
+#include <cerrno>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// Events dispatched per epoll_wait call
+static const int EVENT_BATCH = 128;
+
+// =============================================================================
+// EventLoop
+// =============================================================================
+
+/**
+ * @brief Creates the epoll instance and the wake-up `eventfd`.
+ */
+EventLoop::EventLoop() {
+  this->_epoll = epoll_create1(EPOLL_CLOEXEC);
+  this->_wakeup = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (this->_epoll < 0 || this->_wakeup < 0) {
+    return;
+  }
+
+  epoll_event event = {};
+  event.events = EPOLLIN;
+  event.data.fd = this->_wakeup;
+  epoll_ctl(this->_epoll, EPOLL_CTL_ADD, this->_wakeup, &event);
+}
+
+/**
+ * @brief Closes the epoll instance and the wake-up `eventfd`.
+ */
+EventLoop::~EventLoop() {
+  if (this->_wakeup >= 0) close(this->_wakeup);
+  if (this->_epoll >= 0) close(this->_epoll);
+}
+
+/**
+ * @brief Checks whether the loop was created successfully.
+ *
+ * @return true if the loop can run.
+ */
+bool EventLoop::valid() const {
+  return this->_epoll >= 0 && this->_wakeup >= 0;
+}
+
+/**
+ * @brief Queues work to run on the loop thread.
+ *
+ * @param work The work to run. Safe to call from any thread.
+ */
+void EventLoop::post(std::function<void()> work) {
+  {
+    std::lock_guard<std::mutex> lock(this->_posted_lock);
+    this->_posted.push_back(std::move(work));
+  }
+  uint64_t one = 1;
+  [[maybe_unused]] ssize_t written = ::write(this->_wakeup, &one, sizeof(one));
+}
+
+/**
+ * @brief Starts watching a file descriptor.
+ *
+ * @param fd The non-blocking file descriptor.
+ * @param handler Called on the loop thread with the epoll events of each wake-up.
+ * @return true if the descriptor is now watched.
+ */
+bool EventLoop::watch(const int& fd, std::function<void(uint32_t)> handler) {
+  epoll_event event = {};
+  event.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+  event.data.fd = fd;
+  if (epoll_ctl(this->_epoll, EPOLL_CTL_ADD, fd, &event) != 0) {
+    return false;
+  }
+  this->_handlers[fd] = std::move(handler);
+  return true;
+}
+
+/**
+ * @brief Stops watching a file descriptor; its handler is not called again.
+ *
+ * @param fd The file descriptor.
+ */
+void EventLoop::unwatch(const int& fd) {
+  epoll_ctl(this->_epoll, EPOLL_CTL_DEL, fd, nullptr);
+  this->_handlers.erase(fd);
+}
+
+/**
+ * @brief Dispatches events and posted work until `stop` is called.
+ *
+ * Handlers are looked up per event, so a descriptor unwatched by an earlier event of
+ * the same batch is skipped, and copied before the call, so a handler may unwatch its
+ * own descriptor.
+ */
+void EventLoop::run() {
+  Executor* previous = Executor::current();
+  Executor::setCurrent(this);
+
+  epoll_event events[EVENT_BATCH];
+  while (!this->_stopping) {
+    int count = epoll_wait(this->_epoll, events, EVENT_BATCH, -1);
+    if (count < 0 && errno != EINTR) {
+      break;
+    }
+    for (int i = 0; i < count; ++i) {
+      const int fd = events[i].data.fd;
+      if (fd == this->_wakeup) {
+        uint64_t value;
+        while (::read(this->_wakeup, &value, sizeof(value)) > 0) {}
+        this->_drainPosted();
+        continue;
+      }
+      auto handler = this->_handlers.find(fd);
+      if (handler != this->_handlers.end()) {
+        std::function<void(uint32_t)> call = handler->second;
+        call(events[i].events);
+      }
+    }
+  }
+
+  Executor::setCurrent(previous);
+}
+
+/**
+ * @brief Makes `run` return after the current iteration. Safe to call from any thread.
+ */
+void EventLoop::stop() {
+  this->_stopping = true;
+  this->post([] {});
+}
+
+/**
+ * @brief Runs the work posted since the last wake-up.
+ *
+ * Work posted while draining waits for the next wake-up, which its `post` has already
+ * signalled.
+ */
+void EventLoop::_drainPosted() {
+  std::deque<std::function<void()>> posted;
+  {
+    std::lock_guard<std::mutex> lock(this->_posted_lock);
+    posted.swap(this->_posted);
+  }
+  for (std::function<void()>& work : posted) {
+    work();
+  }
+}
+
+// =============================================================================
+// Connection
+// =============================================================================
+
+/**
+ * @brief Takes ownership of an accepted, non-blocking socket.
+ *
+ * @param loop The loop that watches the socket.
+ * @param fd The socket.
+ */
+Connection::Connection(EventLoop& loop, const int& fd)
+  : _loop(loop), _fd(fd) {}
+
+/**
+ * @brief Stops watching and closes the socket.
+ */
+Connection::~Connection() {
+  if (this->_watched) {
+    this->_loop.unwatch(this->_fd);
+  }
+  close(this->_fd);
+}
+
+/**
+ * @brief Registers the socket with the loop; call once the connection is owned by a
+ *        `std::shared_ptr`.
+ *
+ * The handler only holds a weak reference, and keeps the connection alive while it
+ * resumes coroutines that may drop the last strong one.
+ *
+ * @return true if the socket is watched.
+ */
+bool Connection::start() {
+  std::weak_ptr<Connection> weak = this->weak_from_this();
+  this->_watched = this->_loop.watch(this->_fd, [weak](uint32_t events) {
+    if (std::shared_ptr<Connection> self = weak.lock()) {
+      self->_onEvents(events);
+    }
+  });
+  return this->_watched;
+}
+
+/**
+ * @brief Reads the next line.
+ *
+ * @return An awaitable yielding the line, or nothing once the peer has closed the
+ *         connection or sent a line longer than `MAX_LINE`.
+ */
+Connection::ReadLine Connection::readLine() {
+  return ReadLine{*this};
+}
+
+/**
+ * @brief Sends data.
+ *
+ * The data is written right away; the awaitable only suspends if some of it is left
+ * over once the socket's send buffer is full.
+ *
+ * @param data The bytes to send.
+ * @return An awaitable yielding false if the connection failed.
+ */
+Connection::Write Connection::write(const std::string& data) {
+  this->_out += data;
+  this->_flush();
+  return Write{*this};
+}
+
+/**
+ * @brief Retrieves a token cancelled when the connection fails or is reset.
+ *
+ * @return The token.
+ */
+CancellationToken Connection::hangup() const {
+  return this->_hangup.token();
+}
+
+bool Connection::ReadLine::await_ready() const {
+  return this->connection._hasLine() || this->connection._eof || this->connection._failed;
+}
+
+void Connection::ReadLine::await_suspend(std::coroutine_handle<> handle) {
+  this->connection._reader = handle;
+}
+
+std::optional<std::string> Connection::ReadLine::await_resume() {
+  std::string& in = this->connection._in;
+  size_t end = in.find('\n');
+  if (end == std::string::npos || this->connection._failed) {
+    return std::nullopt;
+  }
+  std::string line = in.substr(0, end);
+  in.erase(0, end + 1);
+  if (!line.empty() && line.back() == '\r') {
+    line.pop_back();
+  }
+  return line;
+}
+
+bool Connection::Write::await_ready() const {
+  return this->connection._out.empty() || this->connection._failed;
+}
+
+void Connection::Write::await_suspend(std::coroutine_handle<> handle) {
+  this->connection._writer = handle;
+}
+
+bool Connection::Write::await_resume() const {
+  return !this->connection._failed;
+}
+
+/**
+ * @brief Handles the epoll events of the socket and resumes waiting coroutines.
+ *
+ * @param events The epoll event mask.
+ */
+void Connection::_onEvents(const uint32_t& events) {
+  if (events & (EPOLLERR | EPOLLHUP)) {
+    this->_fail();
+  }
+  if (events & (EPOLLIN | EPOLLRDHUP)) {
+    this->_fill();
+  }
+  if (events & EPOLLOUT) {
+    this->_flush();
+  }
+
+  if (this->_writer && (this->_out.empty() || this->_failed)) {
+    std::exchange(this->_writer, nullptr).resume();
+  }
+  if (this->_reader && (this->_hasLine() || this->_eof || this->_failed)) {
+    std::exchange(this->_reader, nullptr).resume();
+  }
+}
+
+/**
+ * @brief Reads everything the socket has into the input buffer.
+ *
+ * A buffer that grows past `MAX_LINE` without a line ending fails the connection.
+ */
+void Connection::_fill() {
+  char buffer[16384];
+  while (!this->_failed) {
+    ssize_t count = ::recv(this->_fd, buffer, sizeof(buffer), 0);
+    if (count > 0) {
+      this->_in.append(buffer, count);
+      if (this->_in.size() > MAX_LINE && !this->_hasLine()) {
+        this->_fail();
+      }
+    } else if (count == 0) {
+      this->_eof = true;
+      return;
+    } else if (errno == EINTR) {
+      continue;
+    } else {
+      if (errno != EAGAIN && errno != EWOULDBLOCK) {
+        this->_fail();
+      }
+      return;
+    }
+  }
+}
+
+/**
+ * @brief Writes as much of the output buffer as the socket accepts.
+ */
+void Connection::_flush() {
+  size_t sent = 0;
+  while (sent < this->_out.size() && !this->_failed) {
+    ssize_t count = ::send(this->_fd, this->_out.data() + sent, this->_out.size() - sent, MSG_NOSIGNAL);
+    if (count > 0) {
+      sent += count;
+    } else if (count < 0 && errno == EINTR) {
+      continue;
+    } else {
+      if (count < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+        this->_fail();
+      }
+      break;
+    }
+  }
+  this->_out.erase(0, sent);
+}
+
+/**
+ * @brief Checks whether a complete line is buffered.
+ *
+ * @return true if the input buffer holds a line ending.
+ */
+bool Connection::_hasLine() const {
+  return this->_in.find('\n') != std::string::npos;
+}
+
+/**
+ * @brief Marks the connection failed and cancels its hang-up token.
+ */
+void Connection::_fail() {
+  this->_failed = true;
+  this->_out.clear();
+  this->_hangup.cancel();
+}
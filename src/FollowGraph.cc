@@ -0,0 +1,491 @@
+#include "FollowGraph.hh"
+
+#include <algorithm>
+#include <iostream>
+#include <limits>
+#include <utility>
+
+namespace {
+
+/**
+ * @brief The `follow_graph` table; SQLite owns the base, the graph outlives it.
+ */
+struct GraphTable : sqlite3_vtab {
+  FollowGraph* graph;
+  sqlite3* db;   // the connection the table is on, which loads the graph for it
+};
+
+/**
+ * @brief A scan of `follow_graph`.
+ *
+ * The matching edges are copied out under the graph's lock when the scan starts, so
+ * neither a reload triggered by another scan nor a write through another connection
+ * sharing the graph can invalidate them.
+ */
+struct GraphCursor : sqlite3_vtab_cursor {
+  std::vector<std::pair<int32_t, int32_t>> rows;
+  size_t pos = 0;
+};
+
+// xBestIndex plan bits: which columns have an equality constraint
+constexpr int FLWER_EQ = 1;
+constexpr int FLWEE_EQ = 2;
+
+const std::vector<int32_t> NO_USERS;
+
+/**
+ * @brief Reads a constraint value as a user ID.
+ *
+ * @param value The value of the constraint.
+ * @param[out] id The user ID.
+ * @return true if the value can equal a user ID; false if no edge can match it.
+ */
+bool toUserID(sqlite3_value* value, int32_t& id) {
+  const int type = sqlite3_value_numeric_type(value);
+  if (type != SQLITE_INTEGER) {
+    return false;
+  }
+  const sqlite3_int64 raw = sqlite3_value_int64(value);
+  if (raw < std::numeric_limits<int32_t>::min() || raw > std::numeric_limits<int32_t>::max()) {
+    return false;
+  }
+  id = static_cast<int32_t>(raw);
+  return true;
+}
+
+} // namespace
+
+// =============================================================================
+// Public Methods
+// =============================================================================
+
+/**
+ * @brief Registers the `follow_graph` virtual table on a connection.
+ *
+ * The module is eponymous-only (no `xCreate`), so the table exists on the connection
+ * as soon as the module is registered and nothing is written to the schema. The graph
+ * is kept: connections to the same database can all be attached to one graph, and
+ * registering another graph on a connection replaces this one.
+ *
+ * @param db The connection to query and to register the table on.
+ * @return true if the module was registered; false otherwise.
+ */
+bool FollowGraph::attach(sqlite3* db) {
+  static const sqlite3_module module = [] {
+    sqlite3_module m = {};
+    m.xConnect = &FollowGraph::_xConnect;
+    m.xBestIndex = &FollowGraph::_xBestIndex;
+    m.xDisconnect = &FollowGraph::_xDisconnect;
+    m.xOpen = &FollowGraph::_xOpen;
+    m.xClose = &FollowGraph::_xClose;
+    m.xFilter = &FollowGraph::_xFilter;
+    m.xNext = &FollowGraph::_xNext;
+    m.xEof = &FollowGraph::_xEof;
+    m.xColumn = &FollowGraph::_xColumn;
+    m.xRowid = &FollowGraph::_xRowid;
+    return m;
+  }();
+
+  return sqlite3_create_module_v2(db, "follow_graph", &module, this, nullptr) == SQLITE_OK;
+}
+
+/**
+ * @brief Loads the graph if it has not been loaded or the database has changed
+ *        since it was.
+ *
+ * Writes made through the connections sharing the graph reach it through `addFollow`
+ * and `removeFollow` and move its version past them, so only a write made elsewhere
+ * reloads it.
+ *
+ * @param db The connection to read through.
+ * @return true if the graph is current; false if it could not be loaded.
+ */
+bool FollowGraph::refresh(sqlite3* db) {
+  std::lock_guard<std::mutex> lock(this->_lock);
+  return this->_refresh(db);
+}
+
+/**
+ * @brief Records a follow made through a connection sharing the graph.
+ *
+ * Ignored until the graph has been loaded, since the load will read the edge.
+ *
+ * @param follower_id The unique ID of the follower.
+ * @param followee_id The unique ID of the followed user.
+ */
+void FollowGraph::addFollow(const int32_t& follower_id, const int32_t& followee_id) {
+  std::lock_guard<std::mutex> lock(this->_lock);
+  if (!this->_version.isLoaded()) {
+    return;
+  }
+  if (_insertSorted(this->_following[follower_id], followee_id)) {
+    _insertSorted(this->_followers[followee_id], follower_id);
+    ++this->_edges;
+  }
+}
+
+/**
+ * @brief Records an unfollow made through a connection sharing the graph.
+ *
+ * @param follower_id The unique ID of the follower.
+ * @param followee_id The unique ID of the unfollowed user.
+ */
+void FollowGraph::removeFollow(const int32_t& follower_id, const int32_t& followee_id) {
+  std::lock_guard<std::mutex> lock(this->_lock);
+  auto following = this->_following.find(follower_id);
+  if (following == this->_following.end()) {
+    return;
+  }
+  const size_t before = following->second.size();
+  _eraseSorted(following->second, followee_id);
+  if (following->second.size() == before) {
+    return;
+  }
+
+  auto followers = this->_followers.find(followee_id);
+  if (followers != this->_followers.end()) {
+    _eraseSorted(followers->second, follower_id);
+  }
+  --this->_edges;
+}
+
+/**
+ * @brief Forgets the loaded graph, so the next read loads it again; for edges a
+ *        connection removed without going through `removeFollow`.
+ */
+void FollowGraph::invalidate() {
+  std::lock_guard<std::mutex> lock(this->_lock);
+  this->_version.invalidate();
+}
+
+/**
+ * @brief Moves the graph past a write whose changes were recorded in it.
+ *
+ * @param from The version of the tables when the write began.
+ * @param to The version of the tables once the write is done.
+ */
+void FollowGraph::advance(const int64_t& from, const int64_t& to) {
+  std::lock_guard<std::mutex> lock(this->_lock);
+  this->_version.advance(from, to);
+}
+
+/**
+ * @brief Retrieves the number of loads and invalidations of the graph so far.
+ *
+ * @return The count.
+ */
+uint64_t FollowGraph::loads() const {
+  std::lock_guard<std::mutex> lock(this->_lock);
+  return this->_version.loads();
+}
+
+/**
+ * @brief Retrieves the number of follow edges in the graph.
+ *
+ * @return The number of edges.
+ */
+size_t FollowGraph::size() const {
+  std::lock_guard<std::mutex> lock(this->_lock);
+  return this->_edges;
+}
+
+// =============================================================================
+// Private Methods
+// =============================================================================
+
+/**
+ * @brief Loads the graph unless it is current; the caller holds `_lock`.
+ *
+ * @param db The connection to read through.
+ * @return true if the graph is current; false if it could not be loaded.
+ */
+bool FollowGraph::_refresh(sqlite3* db) {
+  const int64_t version = IndexVersion::read(db);
+  if (version < 0) {
+    return false;
+  }
+  if (this->_version.current(version)) {
+    return true;
+  }
+  const bool loaded = this->_load(db);
+  this->_version.loaded(loaded ? version : -1);
+  return loaded;
+}
+
+/**
+ * @brief Reads every edge of `follows` into the adjacency lists.
+ *
+ * Rows come out in primary-key order, so the forward lists are built already sorted;
+ * the reverse lists are sorted once at the end.
+ *
+ * @param db The connection to read through.
+ * @return true if the table was read; false otherwise.
+ */
+bool FollowGraph::_load(sqlite3* db) {
+  sqlite3_stmt* stmt;
+  if (sqlite3_prepare_v2(db, "SELECT flwer, flwee FROM follows", -1, &stmt, nullptr) != SQLITE_OK) {
+    std::cerr << "SQL Error (follow graph): " << sqlite3_errmsg(db) << std::endl;
+    sqlite3_finalize(stmt);
+    return false;
+  }
+
+  this->_following.clear();
+  this->_followers.clear();
+  this->_edges = 0;
+
+  int rc;
+  while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+    const int32_t follower = sqlite3_column_int(stmt, 0);
+    const int32_t followee = sqlite3_column_int(stmt, 1);
+    this->_following[follower].push_back(followee);
+    this->_followers[followee].push_back(follower);
+    ++this->_edges;
+  }
+  sqlite3_finalize(stmt);
+
+  for (auto* lists : {&this->_following, &this->_followers}) {
+    for (auto& [user, list] : *lists) {
+      std::sort(list.begin(), list.end());
+      list.erase(std::unique(list.begin(), list.end()), list.end());
+    }
+  }
+  return rc == SQLITE_DONE;
+}
+
+/**
+ * @brief Retrieves the users a user follows; the caller holds `_lock`.
+ *
+ * @param follower_id The unique ID of the follower.
+ * @return The followed user IDs in ascending order.
+ */
+const std::vector<int32_t>& FollowGraph::_followingOf(const int32_t& follower_id) const {
+  auto it = this->_following.find(follower_id);
+  return it == this->_following.end() ? NO_USERS : it->second;
+}
+
+/**
+ * @brief Retrieves the followers of a user; the caller holds `_lock`.
+ *
+ * @param followee_id The unique ID of the followed user.
+ * @return The follower IDs in ascending order.
+ */
+const std::vector<int32_t>& FollowGraph::_followersOf(const int32_t& followee_id) const {
+  auto it = this->_followers.find(followee_id);
+  return it == this->_followers.end() ? NO_USERS : it->second;
+}
+
+/**
+ * @brief Inserts a value into a sorted list unless already present.
+ *
+ * @param list The sorted list.
+ * @param value The value to insert.
+ * @return true if the value was inserted; false if it was already present.
+ */
+bool FollowGraph::_insertSorted(std::vector<int32_t>& list, const int32_t& value) {
+  auto at = std::lower_bound(list.begin(), list.end(), value);
+  if (at != list.end() && *at == value) {
+    return false;
+  }
+  list.insert(at, value);
+  return true;
+}
+
+/**
+ * @brief Removes a value from a sorted list if present.
+ *
+ * @param list The sorted list.
+ * @param value The value to remove.
+ */
+void FollowGraph::_eraseSorted(std::vector<int32_t>& list, const int32_t& value) {
+  auto at = std::lower_bound(list.begin(), list.end(), value);
+  if (at != list.end() && *at == value) {
+    list.erase(at);
+  }
+}
+
+/**
+ * @brief Connects to the table; `aux` is the graph passed to `attach`.
+ */
+int FollowGraph::_xConnect(sqlite3* db, void* aux, int, const char* const*, sqlite3_vtab** vtab, char**) {
+  int rc = sqlite3_declare_vtab(db, "CREATE TABLE x(flwer INTEGER, flwee INTEGER)");
+  if (rc != SQLITE_OK) {
+    return rc;
+  }
+  sqlite3_vtab_config(db, SQLITE_VTAB_INNOCUOUS);
+
+  GraphTable* table = new GraphTable();
+  table->graph = static_cast<FollowGraph*>(aux);
+  table->db = db;
+  *vtab = table;
+  return SQLITE_OK;
+}
+
+/**
+ * @brief Releases the table.
+ */
+int FollowGraph::_xDisconnect(sqlite3_vtab* vtab) {
+  sqlite3_free(vtab->zErrMsg);
+  delete static_cast<GraphTable*>(vtab);
+  return SQLITE_OK;
+}
+
+/**
+ * @brief Plans a scan, pushing equality constraints down to the adjacency lists.
+ *
+ * An equality on `flwer` reads one forward list, on `flwee` one reverse list, and on
+ * both a single membership test. The constraints are consumed (`omit`), so SQLite does
+ * not re-check them. Without any, the scan visits every edge. `idxNum` records which
+ * columns are constrained; `flwer`'s value, when present, is passed first.
+ */
+int FollowGraph::_xBestIndex(sqlite3_vtab* vtab, sqlite3_index_info* info) {
+  int flwer = -1;
+  int flwee = -1;
+  for (int i = 0; i < info->nConstraint; ++i) {
+    const auto& constraint = info->aConstraint[i];
+    if (!constraint.usable || constraint.op != SQLITE_INDEX_CONSTRAINT_EQ) {
+      continue;
+    }
+    if (constraint.iColumn == 0) {
+      flwer = i;
+    } else if (constraint.iColumn == 1) {
+      flwee = i;
+    }
+  }
+
+  const FollowGraph* graph = static_cast<GraphTable*>(vtab)->graph;
+  double edges;
+  double degree;
+  {
+    std::lock_guard<std::mutex> lock(graph->_lock);
+    edges = graph->_version.isLoaded() ? std::max<double>(graph->_edges, 1.0) : 100000.0;
+    degree = std::max(edges / std::max<double>(graph->_following.size(), 1.0), 1.0);
+  }
+
+  int argv_index = 0;
+  info->idxNum = 0;
+  if (flwer >= 0) {
+    info->idxNum |= FLWER_EQ;
+    info->aConstraintUsage[flwer].argvIndex = ++argv_index;
+    info->aConstraintUsage[flwer].omit = 1;
+  }
+  if (flwee >= 0) {
+    info->idxNum |= FLWEE_EQ;
+    info->aConstraintUsage[flwee].argvIndex = ++argv_index;
+    info->aConstraintUsage[flwee].omit = 1;
+  }
+
+  if (info->idxNum == (FLWER_EQ | FLWEE_EQ)) {
+    info->estimatedCost = 1.0;
+    info->estimatedRows = 1;
+    info->idxFlags = SQLITE_INDEX_SCAN_UNIQUE;
+  } else if (info->idxNum != 0) {
+    info->estimatedCost = 5.0 + degree;
+    info->estimatedRows = static_cast<sqlite3_int64>(degree);
+  } else {
+    info->estimatedCost = edges;
+    info->estimatedRows = static_cast<sqlite3_int64>(edges);
+  }
+  return SQLITE_OK;
+}
+
+/**
+ * @brief Opens a scan.
+ */
+int FollowGraph::_xOpen(sqlite3_vtab*, sqlite3_vtab_cursor** cursor) {
+  *cursor = new GraphCursor();
+  return SQLITE_OK;
+}
+
+/**
+ * @brief Closes a scan.
+ */
+int FollowGraph::_xClose(sqlite3_vtab_cursor* cursor) {
+  delete static_cast<GraphCursor*>(cursor);
+  return SQLITE_OK;
+}
+
+/**
+ * @brief Starts a scan with the constraint values chosen by `_xBestIndex`, reloading
+ *        the graph first if the database changed underneath it.
+ */
+int FollowGraph::_xFilter(sqlite3_vtab_cursor* cursor, int idx_num, const char*, int argc, sqlite3_value** argv) {
+  GraphCursor* scan = static_cast<GraphCursor*>(cursor);
+  GraphTable* table = static_cast<GraphTable*>(cursor->pVtab);
+  FollowGraph* graph = table->graph;
+  scan->rows.clear();
+  scan->pos = 0;
+
+  std::lock_guard<std::mutex> lock(graph->_lock);
+  if (!graph->_refresh(table->db)) {
+    sqlite3_free(table->zErrMsg);
+    table->zErrMsg = sqlite3_mprintf("follow_graph: cannot load follows");
+    return SQLITE_ERROR;
+  }
+
+  int32_t follower = 0;
+  int32_t followee = 0;
+  int arg = 0;
+  if ((idx_num & FLWER_EQ) && (arg >= argc || !toUserID(argv[arg++], follower))) {
+    return SQLITE_OK;
+  }
+  if ((idx_num & FLWEE_EQ) && (arg >= argc || !toUserID(argv[arg++], followee))) {
+    return SQLITE_OK;
+  }
+
+  if (idx_num == (FLWER_EQ | FLWEE_EQ)) {
+    const std::vector<int32_t>& following = graph->_followingOf(follower);
+    if (std::binary_search(following.begin(), following.end(), followee)) {
+      scan->rows.emplace_back(follower, followee);
+    }
+  } else if (idx_num == FLWER_EQ) {
+    for (const int32_t& id : graph->_followingOf(follower)) {
+      scan->rows.emplace_back(follower, id);
+    }
+  } else if (idx_num == FLWEE_EQ) {
+    for (const int32_t& id : graph->_followersOf(followee)) {
+      scan->rows.emplace_back(id, followee);
+    }
+  } else {
+    scan->rows.reserve(graph->_edges);
+    for (const auto& [user, following] : graph->_following) {
+      for (const int32_t& id : following) {
+        scan->rows.emplace_back(user, id);
+      }
+    }
+  }
+  return SQLITE_OK;
+}
+
+/**
+ * @brief Advances a scan.
+ */
+int FollowGraph::_xNext(sqlite3_vtab_cursor* cursor) {
+  ++static_cast<GraphCursor*>(cursor)->pos;
+  return SQLITE_OK;
+}
+
+/**
+ * @brief Checks whether a scan is past its last edge.
+ */
+int FollowGraph::_xEof(sqlite3_vtab_cursor* cursor) {
+  const GraphCursor* scan = static_cast<GraphCursor*>(cursor);
+  return scan->pos >= scan->rows.size();
+}
+
+/**
+ * @brief Reads `flwer` (column 0) or `flwee` (column 1) of the current edge.
+ */
+int FollowGraph::_xColumn(sqlite3_vtab_cursor* cursor, sqlite3_context* context, int column) {
+  const GraphCursor* scan = static_cast<GraphCursor*>(cursor);
+  const auto& row = scan->rows[scan->pos];
+  sqlite3_result_int(context, column == 0 ? row.first : row.second);
+  return SQLITE_OK;
+}
+
+/**
+ * @brief Reads the position of the current edge in the scan as its rowid.
+ */
+int FollowGraph::_xRowid(sqlite3_vtab_cursor* cursor, sqlite3_int64* rowid) {
+  *rowid = static_cast<sqlite3_int64>(static_cast<GraphCursor*>(cursor)->pos);
+  return SQLITE_OK;
+}
@@ -0,0 +1,119 @@
+#include "FrequencySketch.hh"
+
+#include <algorithm>
+
+namespace {
+
+/**
+ * @brief Mixes a hash with a seed so each row indexes independently (splitmix64 finalizer).
+ */
+uint64_t mix(uint64_t value) {
+  value ^= value >> 30;
+  value *= 0xbf58476d1ce4e5b9ULL;
+  value ^= value >> 27;
+  value *= 0x94d049bb133111ebULL;
+  value ^= value >> 31;
+  return value;
+}
+
+}  // namespace
+
+// =============================================================================
+// Public Methods
+// =============================================================================
+
+/**
+ * @brief Constructs a sketch sized for a number of distinct keys.
+ *
+ * @param expected_entries The number of keys the sketch should tell apart.
+ */
+FrequencySketch::FrequencySketch(const size_t& expected_entries) {
+  this->ensureCapacity(expected_entries);
+}
+
+/**
+ * @brief Grows the sketch if it is too small for a number of keys, forgetting
+ *        what it counted.
+ *
+ * The width is the next power of two of at least the number of keys, which keeps
+ * the chance that a rarely used key collides with a popular one in every row low.
+ *
+ * @param expected_entries The number of keys the sketch should tell apart.
+ */
+void FrequencySketch::ensureCapacity(const size_t& expected_entries) {
+  size_t width = 16;
+  while (width < expected_entries) {
+    width <<= 1;
+  }
+  if (width <= this->_width) {
+    return;
+  }
+  this->_width = width;
+  this->_counters.assign(static_cast<size_t>(SKETCH_DEPTH) * width, 0);
+  this->_increments = 0;
+}
+
+/**
+ * @brief Counts one use of a key.
+ *
+ * @param hash The key's hash.
+ */
+void FrequencySketch::increment(const uint64_t& hash) {
+  for (uint32_t row = 0; row < SKETCH_DEPTH; ++row) {
+    uint8_t& counter = this->_counters[this->_index(hash, row)];
+    if (counter < MAX_FREQUENCY) {
+      ++counter;
+    }
+  }
+  if (++this->_increments >= 10 * this->_width) {
+    this->_age();
+  }
+}
+
+/**
+ * @brief Estimates how often a key was used recently.
+ *
+ * @param hash The key's hash.
+ * @return The estimate, between 0 and `MAX_FREQUENCY`.
+ */
+uint8_t FrequencySketch::frequency(const uint64_t& hash) const {
+  uint8_t frequency = MAX_FREQUENCY;
+  for (uint32_t row = 0; row < SKETCH_DEPTH; ++row) {
+    frequency = std::min(frequency, this->_counters[this->_index(hash, row)]);
+  }
+  return frequency;
+}
+
+/**
+ * @brief Resets every counter to zero.
+ */
+void FrequencySketch::clear() {
+  std::fill(this->_counters.begin(), this->_counters.end(), 0);
+  this->_increments = 0;
+}
+
+// =============================================================================
+// Private Methods
+// =============================================================================
+
+/**
+ * @brief Selects the counter of a key in one row.
+ *
+ * @param hash The key's hash.
+ * @param row The row.
+ * @return The index of the counter within `_counters`.
+ */
+size_t FrequencySketch::_index(const uint64_t& hash, const uint32_t& row) const {
+  const uint64_t seeded = mix(hash + 0x9e3779b97f4a7c15ULL * (row + 1));
+  return row * this->_width + (seeded & (this->_width - 1));
+}
+
+/**
+ * @brief Halves every counter.
+ */
+void FrequencySketch::_age() {
+  for (uint8_t& counter : this->_counters) {
+    counter >>= 1;
+  }
+  this->_increments /= 2;
+}
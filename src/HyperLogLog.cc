@@ -0,0 +1,121 @@
+#include "HyperLogLog.hh"
+
+#include <cmath>
+#include <cstring>
+
+// =============================================================================
+// Public Methods
+// =============================================================================
+
+/**
+ * @brief Constructs an empty sketch with all registers set to zero.
+ */
+HyperLogLog::HyperLogLog()
+  : _registers(HLL_REGISTERS, 0) {
+}
+
+/**
+ * @brief Adds a user ID to the sketch.
+ *
+ * The low `HLL_PRECISION` bits of the hash select a register, and the register keeps
+ * the longest run of leading zeros (plus one) seen in the remaining bits.
+ *
+ * @param user_id The unique ID of the user to add.
+ */
+void HyperLogLog::add(const int32_t& user_id) {
+  uint64_t hash = _hash(static_cast<uint32_t>(user_id));
+  uint32_t index = hash & (HLL_REGISTERS - 1);
+  uint64_t rest = hash >> HLL_PRECISION;
+
+  // Rank is the position of the first set bit in the remaining (64 - p) bits
+  uint8_t rank = 1;
+  while (rank <= 64 - HLL_PRECISION && !(rest & 1)) {
+    rest >>= 1;
+    ++rank;
+  }
+
+  if (rank > this->_registers[index]) {
+    this->_registers[index] = rank;
+  }
+}
+
+/**
+ * @brief Merges another sketch into this one.
+ *
+ * @param other The sketch to merge into this one.
+ */
+void HyperLogLog::merge(const HyperLogLog& other) {
+  for (uint32_t i = 0; i < HLL_REGISTERS; ++i) {
+    if (other._registers[i] > this->_registers[i]) {
+      this->_registers[i] = other._registers[i];
+    }
+  }
+}
+
+/**
+ * @brief Estimates the number of distinct user IDs added to the sketch.
+ *
+ * Uses the standard HyperLogLog harmonic mean estimator, falling back to linear
+ * counting while the raw estimate is small and empty registers remain.
+ *
+ * @return The estimated cardinality.
+ */
+uint64_t HyperLogLog::estimate() const {
+  const double m = HLL_REGISTERS;
+  const double alpha = 0.7213 / (1.0 + 1.079 / m);
+
+  double sum = 0.0;
+  uint32_t zeros = 0;
+  for (uint8_t reg : this->_registers) {
+    sum += std::ldexp(1.0, -reg);
+    if (reg == 0) ++zeros;
+  }
+
+  double raw = alpha * m * m / sum;
+  if (raw <= 2.5 * m && zeros > 0) {
+    raw = m * std::log(m / zeros);
+  }
+
+  return static_cast<uint64_t>(std::llround(raw));
+}
+
+/**
+ * @brief Serializes the registers into a byte string.
+ *
+ * @return A string of exactly `HLL_REGISTERS` bytes.
+ */
+std::string HyperLogLog::toBytes() const {
+  return std::string(this->_registers.begin(), this->_registers.end());
+}
+
+/**
+ * @brief Restores a sketch from bytes produced by `toBytes`.
+ *
+ * @param data Pointer to the serialized registers.
+ * @param size Number of bytes available at `data`.
+ * @return true if the size matched and the sketch was restored; false otherwise.
+ */
+bool HyperLogLog::fromBytes(const void* data, const int& size) {
+  if (data == nullptr || size != static_cast<int>(HLL_REGISTERS)) {
+    return false;
+  }
+  std::memcpy(this->_registers.data(), data, HLL_REGISTERS);
+  return true;
+}
+
+// =============================================================================
+// Private Methods
+// =============================================================================
+
+/**
+ * @brief Mixes a user ID into a well-distributed 64-bit hash (splitmix64 finalizer).
+ *
+ * @param value The value to hash.
+ * @return The 64-bit hash of `value`.
+ */
+uint64_t HyperLogLog::_hash(const uint64_t& value) {
+  uint64_t z = value + 0x9e3779b97f4a7c15ULL;
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
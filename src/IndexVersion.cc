@@ -0,0 +1,117 @@
+#include "IndexVersion.hh"
+
+// The connection writing on this thread, if any, and the version pinned for it
+static thread_local sqlite3* pinned_db = nullptr;
+static thread_local int64_t pinned_version = -1;
+
+// =============================================================================
+// Public Methods
+// =============================================================================
+
+/**
+ * @brief Reads the version of the indexed tables, or the one pinned on the connection.
+ *
+ * @param db The connection to read through.
+ * @return The version, or -1 if it could not be read.
+ */
+int64_t IndexVersion::read(sqlite3* db) {
+  if (db == pinned_db) {
+    return pinned_version;
+  }
+
+  sqlite3_stmt* stmt;
+  if (sqlite3_prepare_v2(db, "SELECT value FROM pond_meta WHERE key = 'index_version'", -1, &stmt, nullptr) != SQLITE_OK) {
+    sqlite3_finalize(stmt);
+    return -1;
+  }
+  const int64_t version = sqlite3_step(stmt) == SQLITE_ROW ? sqlite3_column_int64(stmt, 0) : -1;
+  sqlite3_finalize(stmt);
+  return version;
+}
+
+/**
+ * @brief Pins the version `read` returns for a connection on this thread while it writes.
+ *
+ * The write's changes are recorded in the indexes as they are made, so an index that
+ * was current when the write began is current for the writing connection throughout.
+ * A write runs on one thread from start to end, so one pin per thread is enough.
+ *
+ * @param db The connection.
+ * @param version The version the write began at, or -1 to unpin.
+ */
+void IndexVersion::pin(sqlite3* db, const int64_t& version) {
+  if (version >= 0) {
+    pinned_db = db;
+    pinned_version = version;
+  } else if (pinned_db == db) {
+    pinned_db = nullptr;
+    pinned_version = -1;
+  }
+}
+
+/**
+ * @brief Checks whether the index is loaded and reflects a version of the tables.
+ *
+ * The index may be ahead of the version read: a writer sharing it advances it just
+ * before committing, and a reader may still see the tables from before the commit.
+ *
+ * @param version The version read from the database.
+ * @return true if the index need not be reloaded.
+ */
+bool IndexVersion::current(const int64_t& version) const {
+  return version >= 0 && this->_version >= version;
+}
+
+/**
+ * @brief Checks whether the index has been loaded since it was last invalidated.
+ *
+ * @return true if changes should be applied to it.
+ */
+bool IndexVersion::isLoaded() const {
+  return this->_version >= 0;
+}
+
+/**
+ * @brief Records a load of the index.
+ *
+ * The version must be read before the load begins: a write committed during the load
+ * may or may not be in it, and recording the older version makes it load again.
+ *
+ * @param version The version read before the load began, or -1 if the load failed.
+ */
+void IndexVersion::loaded(const int64_t& version) {
+  this->_version = version;
+  ++this->_loads;
+}
+
+/**
+ * @brief Forgets the load, so the index is reloaded on its next use.
+ */
+void IndexVersion::invalidate() {
+  this->_version = -1;
+  ++this->_loads;
+}
+
+/**
+ * @brief Moves the index past a write whose changes were applied to it.
+ *
+ * Only an index that was current when the write began is moved; one that was behind
+ * is still missing someone else's write.
+ *
+ * @param from The version of the tables when the write began.
+ * @param to The version of the tables once the write is done.
+ */
+void IndexVersion::advance(const int64_t& from, const int64_t& to) {
+  if (this->_version >= 0 && this->_version == from) {
+    this->_version = to;
+  }
+}
+
+/**
+ * @brief Retrieves the number of loads and invalidations so far.
+ *
+ * @return The count.
+ */
+uint64_t IndexVersion::loads() const {
+  return this->_loads;
+}
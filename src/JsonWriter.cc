@@ -0,0 +1,416 @@
+#include "JsonWriter.hh"
+
+#include <charconv>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/**
+ * @brief Checks whether a byte must be escaped inside a JSON string.
+ *
+ * @param c The byte.
+ * @return true for quotes, backslashes and control characters.
+ */
+static inline bool needsEscape(const unsigned char& c) {
+  return c < 0x20 || c == '"' || c == '\\';
+}
+
+/**
+ * @brief Appends the escape sequence of one byte that needs escaping.
+ *
+ * @param out The text to append to.
+ * @param c The byte.
+ */
+static void appendEscaped(std::string& out, const unsigned char& c) {
+  static const char* const digits = "0123456789abcdef";
+  switch (c) {
+    case '"':  out += "\\\""; break;
+    case '\\': out += "\\\\"; break;
+    case '\n': out += "\\n"; break;
+    case '\r': out += "\\r"; break;
+    case '\t': out += "\\t"; break;
+    case '\b': out += "\\b"; break;
+    case '\f': out += "\\f"; break;
+    default: {
+      const char sequence[6] = {'\\', 'u', '0', '0', digits[c >> 4], digits[c & 0xf]};
+      out.append(sequence, sizeof(sequence));
+    }
+  }
+}
+
+/**
+ * @brief Retrieves the JSON name of a notification kind.
+ *
+ * @param kind The kind.
+ * @return The name.
+ */
+static const char* kindName(const Pond::NotificationKind& kind) {
+  switch (kind) {
+    case Pond::NotificationKind::MENTION: return "mention";
+    case Pond::NotificationKind::REPLY:   return "reply";
+    case Pond::NotificationKind::REQUACK: return "requack";
+    case Pond::NotificationKind::FOLLOW:  return "follow";
+  }
+  return "";
+}
+
+// =============================================================================
+// Public Methods
+// =============================================================================
+
+/**
+ * @brief Constructs a writer.
+ *
+ * @param out The stream to flush to, or nullptr to keep everything in the buffer.
+ * @param flush_bytes The buffer size at which a line end flushes.
+ */
+JsonWriter::JsonWriter(std::ostream* out, const size_t& flush_bytes)
+  : _out(out), _flush_bytes(flush_bytes) {
+  if (this->_out) {
+    this->_buffer.reserve(this->_flush_bytes + this->_flush_bytes / 4);
+  }
+}
+
+/**
+ * @brief Flushes whatever is left in the buffer.
+ */
+JsonWriter::~JsonWriter() {
+  if (this->_out) {
+    this->flush();
+  }
+}
+
+/**
+ * @brief Opens an object.
+ */
+JsonWriter& JsonWriter::beginObject() {
+  this->_separate();
+  this->_buffer += '{';
+  this->_need_comma = false;
+  return *this;
+}
+
+/**
+ * @brief Closes the innermost object.
+ */
+JsonWriter& JsonWriter::endObject() {
+  this->_buffer += '}';
+  this->_need_comma = true;
+  return *this;
+}
+
+/**
+ * @brief Opens an array.
+ */
+JsonWriter& JsonWriter::beginArray() {
+  this->_separate();
+  this->_buffer += '[';
+  this->_need_comma = false;
+  return *this;
+}
+
+/**
+ * @brief Closes the innermost array.
+ */
+JsonWriter& JsonWriter::endArray() {
+  this->_buffer += ']';
+  this->_need_comma = true;
+  return *this;
+}
+
+/**
+ * @brief Writes an object key; the next call writes its value.
+ *
+ * @param name The key, escaped like any string.
+ */
+JsonWriter& JsonWriter::key(const std::string_view& name) {
+  this->_separate();
+  this->_buffer += '"';
+  JsonWriter::escape(this->_buffer, name);
+  this->_buffer += "\":";
+  this->_need_comma = false;
+  return *this;
+}
+
+/**
+ * @brief Writes a string value.
+ *
+ * @param text The text, escaped as needed.
+ */
+JsonWriter& JsonWriter::value(const std::string_view& text) {
+  this->_separate();
+  this->_string(text);
+  this->_need_comma = true;
+  return *this;
+}
+
+/**
+ * @brief Writes a string value.
+ *
+ * @param text The NUL-terminated text, escaped as needed.
+ */
+JsonWriter& JsonWriter::value(const char* text) {
+  return this->value(std::string_view(text));
+}
+
+/**
+ * @brief Writes an integer value.
+ *
+ * @param number The number.
+ */
+JsonWriter& JsonWriter::value(const int64_t& number) {
+  this->_separate();
+  this->_number(number);
+  this->_need_comma = true;
+  return *this;
+}
+
+/**
+ * @brief Writes a boolean value.
+ *
+ * @param flag The flag.
+ */
+JsonWriter& JsonWriter::value(const bool& flag) {
+  this->_separate();
+  this->_buffer += flag ? "true" : "false";
+  this->_need_comma = true;
+  return *this;
+}
+
+/**
+ * @brief Writes null.
+ */
+JsonWriter& JsonWriter::null() {
+  this->_separate();
+  this->_buffer += "null";
+  this->_need_comma = true;
+  return *this;
+}
+
+/**
+ * @brief Writes a quack as one object.
+ *
+ * A quack that is not a reply has a null `replyto`.
+ *
+ * @param quack The quack.
+ */
+JsonWriter& JsonWriter::quack(const Pond::Quack& quack) {
+  this->_separate();
+  this->_buffer += "{\"tid\":";
+  this->_number(quack.tid);
+  this->_buffer += ",\"writer_id\":";
+  this->_number(quack.writer_id);
+  this->_buffer += ",\"date\":";
+  this->_string(quack.date);
+  this->_buffer += ",\"time\":";
+  this->_string(quack.time);
+  this->_buffer += ",\"text\":";
+  this->_string(quack.text);
+  this->_buffer += ",\"replyto\":";
+  if (quack.replyto_tid > 0) {
+    this->_number(quack.replyto_tid);
+  } else {
+    this->_buffer += "null";
+  }
+  return this->endObject();
+}
+
+/**
+ * @brief Writes a feed entry as one object.
+ *
+ * @param entry The feed entry.
+ */
+JsonWriter& JsonWriter::feedEntry(const Pond::FeedEntry& entry) {
+  this->_separate();
+  this->_buffer += "{\"type\":";
+  this->_string(entry.type);
+  this->_buffer += ",\"tid\":";
+  this->_number(entry.tid);
+  this->_buffer += ",\"author\":";
+  this->_string(entry.author);
+  this->_buffer += ",\"writer_id\":";
+  this->_number(entry.writer_id);
+  this->_buffer += ",\"date\":";
+  this->_string(entry.date);
+  this->_buffer += ",\"time\":";
+  this->_string(entry.time);
+  this->_buffer += ",\"text\":";
+  this->_string(entry.text);
+  return this->endObject();
+}
+
+/**
+ * @brief Writes a user as one object.
+ *
+ * @param user The user.
+ */
+JsonWriter& JsonWriter::user(const Pond::User& user) {
+  this->_separate();
+  this->_buffer += "{\"usr\":";
+  this->_number(user.usr);
+  this->_buffer += ",\"name\":";
+  this->_string(user.name);
+  return this->endObject();
+}
+
+/**
+ * @brief Writes a notification as one object.
+ *
+ * A follow notification, which has no quack, has a null `tid`.
+ *
+ * @param notification The notification.
+ */
+JsonWriter& JsonWriter::notification(const Pond::Notification& notification) {
+  this->_separate();
+  this->_buffer += "{\"nid\":";
+  this->_number(notification.nid);
+  this->_buffer += ",\"kind\":\"";
+  this->_buffer += kindName(notification.kind);
+  this->_buffer += "\",\"actor\":";
+  this->_number(notification.actor);
+  this->_buffer += ",\"actor_name\":";
+  this->_string(notification.actor_name);
+  this->_buffer += ",\"tid\":";
+  if (notification.tid > 0) {
+    this->_number(notification.tid);
+  } else {
+    this->_buffer += "null";
+  }
+  this->_buffer += ",\"snippet\":";
+  this->_string(notification.snippet);
+  this->_buffer += ",\"date\":";
+  this->_string(notification.date);
+  this->_buffer += ",\"time\":";
+  this->_string(notification.time);
+  this->_buffer += notification.unread ? ",\"unread\":true" : ",\"unread\":false";
+  return this->endObject();
+}
+
+/**
+ * @brief Ends a JSON line, flushing the buffer if it has grown past the threshold.
+ */
+void JsonWriter::endLine() {
+  this->_buffer += '\n';
+  this->_need_comma = false;
+  if (this->_out && this->_buffer.size() >= this->_flush_bytes) {
+    this->flush();
+  }
+}
+
+/**
+ * @brief Writes the buffer to the stream, if any, and empties it.
+ *
+ * The buffer keeps its capacity, so a streaming writer allocates only while its first
+ * few lines are written.
+ */
+void JsonWriter::flush() {
+  if (this->_out && !this->_buffer.empty()) {
+    this->_out->write(this->_buffer.data(), static_cast<std::streamsize>(this->_buffer.size()));
+  }
+  this->_buffer.clear();
+}
+
+/**
+ * @brief Retrieves everything written and not yet flushed.
+ *
+ * @return The buffer.
+ */
+const std::string& JsonWriter::buffer() const {
+  return this->_buffer;
+}
+
+/**
+ * @brief Takes everything written and not yet flushed, leaving the buffer empty.
+ *
+ * @return The text.
+ */
+std::string JsonWriter::take() {
+  std::string text;
+  text.swap(this->_buffer);
+  this->_need_comma = false;
+  return text;
+}
+
+/**
+ * @brief Appends a string's JSON escape, without quotes.
+ *
+ * Most text needs no escaping at all, so the bytes are tested 16 at a time and every
+ * run of clean bytes is appended in one copy; only the bytes that need an escape are
+ * handled one by one. Bytes of 0x80 and above (UTF-8 sequences) are copied unchanged.
+ *
+ * @param out The text to append to.
+ * @param text The text to escape.
+ */
+void JsonWriter::escape(std::string& out, const std::string_view& text) {
+  const char* data = text.data();
+  const size_t length = text.size();
+  size_t clean = 0;   // start of the run of bytes not yet appended
+  size_t i = 0;
+
+#if defined(__SSE2__)
+  const __m128i quote = _mm_set1_epi8('"');
+  const __m128i backslash = _mm_set1_epi8('\\');
+  const __m128i control = _mm_set1_epi8(0x1F);
+  for (; i + 16 <= length; i += 16) {
+    const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+    // An unsigned byte is at most 0x1F exactly when max(byte, 0x1F) is 0x1F
+    const __m128i special = _mm_or_si128(
+      _mm_or_si128(_mm_cmpeq_epi8(block, quote), _mm_cmpeq_epi8(block, backslash)),
+      _mm_cmpeq_epi8(_mm_max_epu8(block, control), control));
+    uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(special));
+    while (mask) {
+      const size_t at = i + static_cast<size_t>(__builtin_ctz(mask));
+      out.append(data + clean, at - clean);
+      appendEscaped(out, static_cast<unsigned char>(data[at]));
+      clean = at + 1;
+      mask &= mask - 1;
+    }
+  }
+#endif
+
+  for (; i < length; ++i) {
+    const unsigned char c = static_cast<unsigned char>(data[i]);
+    if (needsEscape(c)) {
+      out.append(data + clean, i - clean);
+      appendEscaped(out, c);
+      clean = i + 1;
+    }
+  }
+  out.append(data + clean, length - clean);
+}
+
+// =============================================================================
+// Private Methods
+// =============================================================================
+
+/**
+ * @brief Writes the comma before a value or key, if one is due.
+ */
+void JsonWriter::_separate() {
+  if (this->_need_comma) {
+    this->_buffer += ',';
+  }
+}
+
+/**
+ * @brief Appends a quoted, escaped string.
+ *
+ * @param text The text.
+ */
+void JsonWriter::_string(const std::string_view& text) {
+  this->_buffer += '"';
+  JsonWriter::escape(this->_buffer, text);
+  this->_buffer += '"';
+}
+
+/**
+ * @brief Appends an integer, formatted without a locale or a stream.
+ *
+ * @param number The number.
+ */
+void JsonWriter::_number(const int64_t& number) {
+  char digits[24];
+  const std::to_chars_result result = std::to_chars(digits, digits + sizeof(digits), number);
+  this->_buffer.append(digits, result.ptr);
+}
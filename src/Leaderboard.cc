@@ -0,0 +1,152 @@
+#include "Leaderboard.hh"
+
+#include <algorithm>
+
+// =============================================================================
+// Public Methods
+// =============================================================================
+
+/**
+ * @brief Constructs an empty leaderboard.
+ *
+ * @param bucket_seconds The width of one bucket, in seconds.
+ * @param buckets The number of buckets in the window.
+ */
+Leaderboard::Leaderboard(const int64_t& bucket_seconds, const size_t& buckets)
+  : _bucket_seconds(std::max<int64_t>(bucket_seconds, 1)), _buckets(std::max<size_t>(buckets, 1)) {}
+
+/**
+ * @brief Adds a score to an ID.
+ *
+ * @param id The ID.
+ * @param score The score, e.g. 1 for one more requack.
+ * @param time When it happened, in seconds since the epoch; scores older than the
+ *             window are ignored, and scores from the future count as now.
+ * @param now The current time, in seconds since the epoch.
+ */
+void Leaderboard::add(const int32_t& id, const int64_t& score, const int64_t& time, const int64_t& now) {
+  this->advance(now);
+  const int64_t current = now / this->_bucket_seconds;
+  const int64_t index = std::min(time, now) / this->_bucket_seconds;
+  if (score == 0 || index <= current - static_cast<int64_t>(this->_buckets)) {
+    return;
+  }
+
+  // Scores mostly arrive in time order, so the bucket is almost always the last one
+  auto it = this->_window.end();
+  while (it != this->_window.begin() && std::prev(it)->index > index) {
+    --it;
+  }
+  if (it == this->_window.begin() || std::prev(it)->index != index) {
+    it = this->_window.insert(it, Bucket{index, {}});
+  } else {
+    --it;
+  }
+  it->scores[id] += score;
+  this->_adjust(id, score);
+}
+
+/**
+ * @brief Expires the buckets that have fallen out of the window.
+ *
+ * @param now The current time, in seconds since the epoch.
+ */
+void Leaderboard::advance(const int64_t& now) {
+  const int64_t oldest = now / this->_bucket_seconds - static_cast<int64_t>(this->_buckets) + 1;
+  while (!this->_window.empty() && this->_window.front().index < oldest) {
+    for (const auto& [id, score] : this->_window.front().scores) {
+      this->_adjust(id, -score);
+    }
+    this->_window.pop_front();
+  }
+}
+
+/**
+ * @brief Retrieves the IDs with the highest totals.
+ *
+ * @param count The number of IDs.
+ * @return Up to `count` entries, highest total first; ties go to the lower ID.
+ */
+std::vector<Leaderboard::Entry> Leaderboard::top(const size_t& count) const {
+  std::vector<Entry> entries;
+  entries.reserve(std::min(count, this->_ranking.size()));
+  for (auto it = this->_ranking.begin(); it != this->_ranking.end() && entries.size() < count; ++it) {
+    entries.push_back({-it->second, it->first});
+  }
+  return entries;
+}
+
+/**
+ * @brief Retrieves the rank of an ID.
+ *
+ * @param id The ID.
+ * @return The 1-based rank, or 0 if the ID has no positive total.
+ */
+size_t Leaderboard::rank(const int32_t& id) const {
+  const int64_t total = this->score(id);
+  if (total <= 0) {
+    return 0;
+  }
+  return this->_ranking.order_of_key({total, -id}) + 1;
+}
+
+/**
+ * @brief Retrieves the total of an ID.
+ *
+ * @param id The ID.
+ * @return The total in the window.
+ */
+int64_t Leaderboard::score(const int32_t& id) const {
+  auto it = this->_totals.find(id);
+  return it == this->_totals.end() ? 0 : it->second;
+}
+
+/**
+ * @brief Retrieves the number of ranked IDs.
+ *
+ * @return The number of IDs with a positive total.
+ */
+size_t Leaderboard::size() const {
+  return this->_ranking.size();
+}
+
+/**
+ * @brief Removes every score.
+ */
+void Leaderboard::clear() {
+  this->_window.clear();
+  this->_totals.clear();
+  this->_ranking.clear();
+}
+
+// =============================================================================
+// Private Methods
+// =============================================================================
+
+/**
+ * @brief Changes the total of an ID and moves it in the ranking.
+ *
+ * @param id The ID.
+ * @param delta The change.
+ */
+void Leaderboard::_adjust(const int32_t& id, const int64_t& delta) {
+  auto it = this->_totals.find(id);
+  const int64_t before = it == this->_totals.end() ? 0 : it->second;
+  const int64_t after = before + delta;
+
+  if (before > 0) {
+    this->_ranking.erase({before, -id});
+  }
+  if (after > 0) {
+    this->_ranking.insert({after, -id});
+  }
+  if (after == 0) {
+    if (it != this->_totals.end()) {
+      this->_totals.erase(it);
+    }
+  } else if (it == this->_totals.end()) {
+    this->_totals.emplace(id, after);
+  } else {
+    it->second = after;
+  }
+}
@@ -0,0 +1,309 @@
+#include "PasswordHash.hh"
+
+#include <algorithm>
+#include <cstring>
+#include <random>
+
+static const char* const HASH_PREFIX = "pbkdf2-sha256$";
+static constexpr size_t SALT_BYTES = 16;
+
+static constexpr uint32_t SHA256_K[64] = {
+  0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+  0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+  0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+  0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+  0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+  0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+  0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+  0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+/**
+ * @brief An incremental SHA-256 computation.
+ */
+struct Sha256 {
+  uint32_t state[8] = {0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+  uint8_t block[64];
+  size_t used = 0;      // bytes waiting in `block`
+  uint64_t length = 0;  // total bytes absorbed
+
+  static uint32_t rotate(const uint32_t& x, const int& n) {
+    return (x >> n) | (x << (32 - n));
+  }
+
+  void compress(const uint8_t* data) {
+    uint32_t w[64];
+    for (int i = 0; i < 16; ++i) {
+      w[i] = (uint32_t(data[4 * i]) << 24) | (uint32_t(data[4 * i + 1]) << 16) |
+             (uint32_t(data[4 * i + 2]) << 8) | uint32_t(data[4 * i + 3]);
+    }
+    for (int i = 16; i < 64; ++i) {
+      const uint32_t s0 = rotate(w[i - 15], 7) ^ rotate(w[i - 15], 18) ^ (w[i - 15] >> 3);
+      const uint32_t s1 = rotate(w[i - 2], 17) ^ rotate(w[i - 2], 19) ^ (w[i - 2] >> 10);
+      w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+    uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+    for (int i = 0; i < 64; ++i) {
+      const uint32_t t1 = h + (rotate(e, 6) ^ rotate(e, 11) ^ rotate(e, 25)) + ((e & f) ^ (~e & g)) + SHA256_K[i] + w[i];
+      const uint32_t t2 = (rotate(a, 2) ^ rotate(a, 13) ^ rotate(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+      h = g; g = f; f = e; e = d + t1;
+      d = c; c = b; b = a; a = t1 + t2;
+    }
+    state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+    state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+  }
+
+  void update(const uint8_t* data, size_t size) {
+    this->length += size;
+    while (size > 0) {
+      const size_t take = std::min(size, sizeof(block) - used);
+      std::memcpy(block + used, data, take);
+      used += take;
+      data += take;
+      size -= take;
+      if (used == sizeof(block)) {
+        compress(block);
+        used = 0;
+      }
+    }
+  }
+
+  void finish(uint8_t* digest) {
+    const uint64_t bits = this->length * 8;
+    const uint8_t pad = 0x80;
+    update(&pad, 1);
+    const uint8_t zero = 0;
+    while (used != 56) {
+      update(&zero, 1);
+    }
+    uint8_t size[8];
+    for (int i = 0; i < 8; ++i) {
+      size[i] = static_cast<uint8_t>(bits >> (56 - 8 * i));
+    }
+    update(size, 8);
+    for (int i = 0; i < 8; ++i) {
+      digest[4 * i] = static_cast<uint8_t>(state[i] >> 24);
+      digest[4 * i + 1] = static_cast<uint8_t>(state[i] >> 16);
+      digest[4 * i + 2] = static_cast<uint8_t>(state[i] >> 8);
+      digest[4 * i + 3] = static_cast<uint8_t>(state[i]);
+    }
+  }
+};
+
+/**
+ * @brief Encodes bytes as lowercase hex.
+ *
+ * @param data The bytes.
+ * @param size The number of bytes.
+ * @return The hex text.
+ */
+static std::string toHex(const uint8_t* data, const size_t& size) {
+  static const char* const digits = "0123456789abcdef";
+  std::string hex(2 * size, '0');
+  for (size_t i = 0; i < size; ++i) {
+    hex[2 * i] = digits[data[i] >> 4];
+    hex[2 * i + 1] = digits[data[i] & 0xf];
+  }
+  return hex;
+}
+
+/**
+ * @brief Decodes hex text.
+ *
+ * @param hex The hex text.
+ * @param bytes Set to the decoded bytes.
+ * @return true if `hex` was valid hex of even length; false otherwise.
+ */
+static bool fromHex(const std::string& hex, std::string& bytes) {
+  auto value = [](const char& c) -> int {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+  };
+  if (hex.size() % 2 != 0) {
+    return false;
+  }
+  bytes.resize(hex.size() / 2);
+  for (size_t i = 0; i < bytes.size(); ++i) {
+    const int high = value(hex[2 * i]);
+    const int low = value(hex[2 * i + 1]);
+    if (high < 0 || low < 0) {
+      return false;
+    }
+    bytes[i] = static_cast<char>((high << 4) | low);
+  }
+  return true;
+}
+
+/**
+ * @brief Compares two byte strings in time that depends only on their lengths.
+ *
+ * @param a The first string.
+ * @param b The second string.
+ * @param size The number of bytes of each.
+ * @return true if they are equal.
+ */
+static bool equalConstantTime(const uint8_t* a, const uint8_t* b, const size_t& size) {
+  uint8_t difference = 0;
+  for (size_t i = 0; i < size; ++i) {
+    difference |= a[i] ^ b[i];
+  }
+  return difference == 0;
+}
+
+// =============================================================================
+// Public Methods
+// =============================================================================
+
+/**
+ * @brief Hashes a password with a fresh random salt.
+ *
+ * @param password The password.
+ * @param iterations The number of PBKDF2 iterations.
+ * @return The hash, ready to store.
+ */
+std::string PasswordHash::hash(const std::string& password, const uint32_t& iterations) {
+  std::random_device random;
+  uint8_t salt[SALT_BYTES];
+  for (size_t i = 0; i < SALT_BYTES; i += 4) {
+    const uint32_t word = random();
+    std::memcpy(salt + i, &word, 4);
+  }
+
+  const Digest key = _pbkdf2(password, salt, SALT_BYTES, std::max(iterations, 1u));
+  return HASH_PREFIX + std::to_string(std::max(iterations, 1u)) + "$" + toHex(salt, SALT_BYTES) + "$" +
+         toHex(key.data(), key.size());
+}
+
+/**
+ * @brief Checks a password against a stored hash, or a stored plain-text password.
+ *
+ * @param password The password entered.
+ * @param stored The stored hash or plain-text password.
+ * @return true if the password matches; false otherwise, or if `stored` is empty.
+ */
+bool PasswordHash::verify(const std::string& password, const std::string& stored) {
+  uint32_t iterations;
+  std::string salt;
+  Digest key;
+  if (!_parse(stored, iterations, salt, key)) {
+    // Plain text: compare every byte, so the time taken does not reveal the first mismatch
+    return !stored.empty() && password.size() == stored.size() &&
+           equalConstantTime(reinterpret_cast<const uint8_t*>(password.data()),
+                             reinterpret_cast<const uint8_t*>(stored.data()), stored.size());
+  }
+  const Digest derived = _pbkdf2(password, reinterpret_cast<const uint8_t*>(salt.data()), salt.size(), iterations);
+  return equalConstantTime(derived.data(), key.data(), key.size());
+}
+
+/**
+ * @brief Checks whether a stored password should be hashed again.
+ *
+ * @param stored The stored hash or plain-text password.
+ * @return true if it is plain text or uses fewer than `ITERATIONS` iterations.
+ */
+bool PasswordHash::needsRehash(const std::string& stored) {
+  uint32_t iterations;
+  std::string salt;
+  Digest key;
+  return !_parse(stored, iterations, salt, key) || iterations < ITERATIONS;
+}
+
+// =============================================================================
+// Private Methods
+// =============================================================================
+
+/**
+ * @brief Derives a 32-byte key with PBKDF2-HMAC-SHA256.
+ *
+ * The HMAC's inner and outer pads are absorbed once, so each iteration costs two
+ * SHA-256 compressions.
+ *
+ * @param password The password.
+ * @param salt The salt.
+ * @param salt_length The length of the salt.
+ * @param iterations The number of iterations.
+ * @return The key.
+ */
+PasswordHash::Digest PasswordHash::_pbkdf2(const std::string& password, const uint8_t* salt,
+                                           const size_t& salt_length, const uint32_t& iterations) {
+  // HMAC keys longer than a block are hashed first
+  uint8_t key[64] = {};
+  if (password.size() > sizeof(key)) {
+    Sha256 digest;
+    digest.update(reinterpret_cast<const uint8_t*>(password.data()), password.size());
+    digest.finish(key);
+  } else {
+    std::memcpy(key, password.data(), password.size());
+  }
+
+  uint8_t pad[64];
+  Sha256 inner, outer;
+  for (size_t i = 0; i < sizeof(pad); ++i) pad[i] = key[i] ^ 0x36;
+  inner.update(pad, sizeof(pad));
+  for (size_t i = 0; i < sizeof(pad); ++i) pad[i] = key[i] ^ 0x5c;
+  outer.update(pad, sizeof(pad));
+
+  auto hmac = [&](const uint8_t* data, const size_t& size, uint8_t* out) {
+    Sha256 first = inner;
+    first.update(data, size);
+    first.finish(out);
+    Sha256 second = outer;
+    second.update(out, 32);
+    second.finish(out);
+  };
+
+  // One block: U1 = HMAC(salt || INT(1)), Ui = HMAC(Ui-1), key = U1 ^ ... ^ Un
+  std::string first_input(reinterpret_cast<const char*>(salt), salt_length);
+  first_input.append("\x00\x00\x00\x01", 4);
+
+  Digest result;
+  uint8_t u[32];
+  hmac(reinterpret_cast<const uint8_t*>(first_input.data()), first_input.size(), u);
+  std::memcpy(result.data(), u, sizeof(u));
+  for (uint32_t i = 1; i < iterations; ++i) {
+    hmac(u, sizeof(u), u);
+    for (size_t j = 0; j < sizeof(u); ++j) {
+      result[j] ^= u[j];
+    }
+  }
+  return result;
+}
+
+/**
+ * @brief Splits a stored hash into its parts.
+ *
+ * @param stored The stored hash.
+ * @param iterations Set to the iteration count.
+ * @param salt Set to the decoded salt.
+ * @param key Set to the decoded key.
+ * @return true if `stored` is a well-formed hash; false if it is plain text.
+ */
+bool PasswordHash::_parse(const std::string& stored, uint32_t& iterations, std::string& salt, Digest& key) {
+  const size_t prefix = std::strlen(HASH_PREFIX);
+  if (stored.compare(0, prefix, HASH_PREFIX) != 0) {
+    return false;
+  }
+  const size_t salt_start = stored.find('$', prefix);
+  const size_t key_start = salt_start == std::string::npos ? std::string::npos : stored.find('$', salt_start + 1);
+  if (key_start == std::string::npos || salt_start == prefix) {
+    return false;
+  }
+
+  const std::string count = stored.substr(prefix, salt_start - prefix);
+  if (count.size() > 9 || count.find_first_not_of("0123456789") != std::string::npos) {
+    return false;
+  }
+  iterations = static_cast<uint32_t>(std::stoul(count));
+
+  std::string key_bytes;
+  if (iterations == 0 || !fromHex(stored.substr(salt_start + 1, key_start - salt_start - 1), salt) ||
+      !fromHex(stored.substr(key_start + 1), key_bytes) || key_bytes.size() != key.size()) {
+    return false;
+  }
+  std::memcpy(key.data(), key_bytes.data(), key.size());
+  return true;
+}
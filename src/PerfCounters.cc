@@ -0,0 +1,301 @@
+#include "PerfCounters.hh"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <linux/perf_event.h>
+#include <sstream>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+const char* const EVENT_NAMES[PerfCounters::EVENT_COUNT] = {
+  "cycles", "instructions", "cache-misses", "branch-misses", "page-faults"
+};
+
+/**
+ * @brief Formats a per-call or per-row figure, or "-" if the event is not counted.
+ */
+std::string formatRate(const bool& counted, const double& total, const double& divisor, const int& precision) {
+  if (!counted || divisor == 0) {
+    return "-";
+  }
+  std::ostringstream oss;
+  oss << std::fixed << std::setprecision(precision) << total / divisor;
+  return oss.str();
+}
+
+}  // namespace
+
+// =============================================================================
+// Public Methods
+// =============================================================================
+
+/**
+ * @brief Starts counting an operation.
+ *
+ * @param counters The profiler, or nullptr to count nothing.
+ * @param operation The operation's name; must outlive the profiler.
+ */
+PerfCounters::Scope::Scope(PerfCounters* counters, const char* operation)
+  : _counters(counters && counters->_thread == std::this_thread::get_id() ? counters : nullptr),
+    _operation(operation) {
+  if (this->_counters) {
+    this->_start_time = std::chrono::steady_clock::now();
+    this->_counters->_read(this->_start);
+  }
+}
+
+/**
+ * @brief Stops counting and adds the run to its operation's totals.
+ */
+PerfCounters::Scope::~Scope() {
+  if (!this->_counters) {
+    return;
+  }
+  uint64_t end[EVENT_COUNT];
+  this->_counters->_read(end);
+  const uint64_t wall_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - this->_start_time).count();
+
+  Totals& totals = this->_counters->_totals[this->_operation];
+  ++totals.calls;
+  totals.rows += this->_rows;
+  totals.wall_ns += wall_ns;
+  for (int event = 0; event < EVENT_COUNT; ++event) {
+    totals.counts[event] += end[event] > this->_start[event] ? end[event] - this->_start[event] : 0;
+  }
+}
+
+/**
+ * @brief Records how many rows the operation produced, for per-row figures.
+ *
+ * @param rows The number of rows.
+ */
+void PerfCounters::Scope::setRows(const size_t& rows) {
+  this->_rows = rows;
+}
+
+/**
+ * @brief Opens the counters for the calling thread.
+ *
+ * The hardware events form one group led by the first event that opens; events the
+ * CPU or the kernel's `perf_event_paranoid` setting refuse are left out, and the
+ * reason is kept for the report.
+ */
+PerfCounters::PerfCounters() : _thread(std::this_thread::get_id()) {
+  std::fill(std::begin(this->_fds), std::end(this->_fds), -1);
+  std::fill(std::begin(this->_group_slot), std::end(this->_group_slot), -1);
+
+  const std::pair<Event, uint64_t> hardware_events[] = {
+    {CYCLES, PERF_COUNT_HW_CPU_CYCLES},
+    {INSTRUCTIONS, PERF_COUNT_HW_INSTRUCTIONS},
+    {CACHE_MISSES, PERF_COUNT_HW_CACHE_MISSES},
+    {BRANCH_MISSES, PERF_COUNT_HW_BRANCH_MISSES},
+  };
+  const uint64_t group_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+  std::vector<std::string> missing;
+  int error = 0;
+  for (const auto& [event, config] : hardware_events) {
+    const int fd = this->_open(PERF_TYPE_HARDWARE, config, this->_group_fd, group_format);
+    if (fd < 0) {
+      missing.push_back(EVENT_NAMES[event]);
+      error = error ? error : errno;
+      continue;
+    }
+    this->_group_fd = this->_group_fd < 0 ? fd : this->_group_fd;
+    this->_fds[event] = fd;
+    this->_group_slot[event] = static_cast<int>(this->_group_size++);
+  }
+
+  this->_fds[PAGE_FAULTS] = this->_open(PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS, -1, 0);
+  if (this->_fds[PAGE_FAULTS] < 0) {
+    missing.push_back(EVENT_NAMES[PAGE_FAULTS]);
+    error = error ? error : errno;
+  }
+
+  if (!missing.empty()) {
+    std::ostringstream oss;
+    for (size_t i = 0; i < missing.size(); ++i) {
+      oss << (i ? ", " : "") << missing[i];
+    }
+    oss << " not counted (" << std::strerror(error);
+    if (error == EACCES || error == EPERM) {
+      std::ifstream paranoid("/proc/sys/kernel/perf_event_paranoid");
+      int level;
+      if (paranoid >> level) {
+        oss << "; kernel.perf_event_paranoid is " << level;
+      }
+    } else if (error == ENOENT || error == EOPNOTSUPP) {
+      oss << "; the CPU or virtual machine exposes no such counter";
+    }
+    oss << ")";
+    this->_unavailable_reason = oss.str();
+  }
+}
+
+/**
+ * @brief Closes the counters.
+ */
+PerfCounters::~PerfCounters() {
+  for (int fd : this->_fds) {
+    if (fd >= 0) {
+      close(fd);
+    }
+  }
+}
+
+/**
+ * @brief Checks whether an event is being counted.
+ *
+ * @param event The event.
+ * @return true if its counter is open.
+ */
+bool PerfCounters::available(const Event& event) const {
+  return this->_fds[event] >= 0;
+}
+
+/**
+ * @brief Retrieves why counters are missing, if any are.
+ *
+ * @return The reason, or an empty string if every counter is open.
+ */
+const std::string& PerfCounters::unavailableReason() const {
+  return this->_unavailable_reason;
+}
+
+/**
+ * @brief Retrieves the totals of every operation counted so far.
+ *
+ * @return The totals, by operation name.
+ */
+const std::map<std::string, PerfCounters::Totals>& PerfCounters::totals() const {
+  return this->_totals;
+}
+
+/**
+ * @brief Prints a table of the totals: calls, time, IPC, and misses per row.
+ *
+ * Misses are divided by the rows an operation produced; for operations that record
+ * no rows they are per call, marked with `*`. Columns of events that are not counted
+ * show `-`.
+ *
+ * @param out The stream to print to.
+ */
+void PerfCounters::report(std::ostream& out) const {
+  out << "Performance counters per operation";
+  if (!this->_unavailable_reason.empty()) {
+    out << ": " << this->_unavailable_reason;
+  }
+  out << "\n";
+
+  out << std::left << std::setw(28) << "operation" << std::right
+      << std::setw(8) << "calls" << std::setw(11) << "us/call" << std::setw(10) << "rows/call"
+      << std::setw(13) << "cycles/call" << std::setw(13) << "instr/call" << std::setw(7) << "IPC"
+      << std::setw(16) << "cache-miss/row" << std::setw(17) << "branch-miss/row" << std::setw(13) << "faults/call" << "\n";
+
+  bool per_call_misses = false;
+  for (const auto& [operation, totals] : this->_totals) {
+    const double calls = static_cast<double>(totals.calls);
+    const double rows = totals.rows ? static_cast<double>(totals.rows) : calls;
+    const std::string unit = totals.rows ? "" : "*";
+    per_call_misses = per_call_misses || !totals.rows;
+
+    const bool counts_ipc = this->available(CYCLES) && this->available(INSTRUCTIONS);
+    const std::string cache_misses = formatRate(this->available(CACHE_MISSES), totals.counts[CACHE_MISSES], rows, 1);
+    const std::string branch_misses = formatRate(this->available(BRANCH_MISSES), totals.counts[BRANCH_MISSES], rows, 1);
+
+    out << std::left << std::setw(28) << operation << std::right
+        << std::setw(8) << totals.calls
+        << std::setw(11) << formatRate(true, totals.wall_ns / 1e3, calls, 1)
+        << std::setw(10) << formatRate(totals.rows > 0, totals.rows, calls, 1)
+        << std::setw(13) << formatRate(this->available(CYCLES), totals.counts[CYCLES], calls, 0)
+        << std::setw(13) << formatRate(this->available(INSTRUCTIONS), totals.counts[INSTRUCTIONS], calls, 0)
+        << std::setw(7) << formatRate(counts_ipc, totals.counts[INSTRUCTIONS], totals.counts[CYCLES], 2)
+        << std::setw(16) << (cache_misses == "-" ? cache_misses : cache_misses + unit)
+        << std::setw(17) << (branch_misses == "-" ? branch_misses : branch_misses + unit)
+        << std::setw(13) << formatRate(this->available(PAGE_FAULTS), totals.counts[PAGE_FAULTS], calls, 1) << "\n";
+  }
+  if (per_call_misses && (this->available(CACHE_MISSES) || this->available(BRANCH_MISSES))) {
+    out << "* per call: the operation produces no rows\n";
+  }
+}
+
+/**
+ * @brief Discards the totals counted so far.
+ */
+void PerfCounters::reset() {
+  this->_totals.clear();
+}
+
+// =============================================================================
+// Private Methods
+// =============================================================================
+
+/**
+ * @brief Reads every open counter.
+ *
+ * A group read returns the time the group was enabled and running; if the kernel
+ * multiplexed it with other groups, the counts are scaled up by their ratio.
+ *
+ * @param[out] counts The current values, scaled for multiplexing; 0 for events that
+ *             are not counted.
+ */
+void PerfCounters::_read(uint64_t (&counts)[EVENT_COUNT]) const {
+  std::fill(std::begin(counts), std::end(counts), 0);
+
+  if (this->_group_fd >= 0) {
+    // nr, time_enabled, time_running, then one value per event
+    uint64_t values[3 + EVENT_COUNT];
+    const ssize_t expected = static_cast<ssize_t>((3 + this->_group_size) * sizeof(uint64_t));
+    if (read(this->_group_fd, values, sizeof(values)) == expected) {
+      const uint64_t enabled = values[1];
+      const uint64_t running = values[2];
+      for (int event = 0; event < EVENT_COUNT; ++event) {
+        if (this->_group_slot[event] < 0) continue;
+        uint64_t value = values[3 + this->_group_slot[event]];
+        if (running > 0 && running < enabled) {
+          value = static_cast<uint64_t>(static_cast<double>(value) * enabled / running);
+        }
+        counts[event] = value;
+      }
+    }
+  }
+
+  if (this->_fds[PAGE_FAULTS] >= 0) {
+    uint64_t value;
+    if (read(this->_fds[PAGE_FAULTS], &value, sizeof(value)) == sizeof(value)) {
+      counts[PAGE_FAULTS] = value;
+    }
+  }
+}
+
+/**
+ * @brief Opens one counter.
+ *
+ * Counters count the calling thread on any CPU, in user space only, which is all an
+ * unprivileged process may count under the default `perf_event_paranoid` of 2.
+ *
+ * @param type The `perf_event_attr` type.
+ * @param config The `perf_event_attr` config.
+ * @param group_fd The group leader's descriptor, or -1 to open a leader.
+ * @param read_format The `perf_event_attr` read format.
+ * @return The descriptor, or -1 if the counter could not be opened.
+ */
+int PerfCounters::_open(const uint32_t& type, const uint64_t& config, const int& group_fd, const uint64_t& read_format) {
+  perf_event_attr attr;
+  std::memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = type;
+  attr.config = config;
+  attr.read_format = read_format;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+
+  const long fd = syscall(SYS_perf_event_open, &attr, 0, -1, group_fd, PERF_FLAG_FD_CLOEXEC);
+  return fd < 0 ? -1 : static_cast<int>(fd);
+}
@@ -1,5 +1,10 @@
 #include "Pond.hh"
 
+#include "PasswordHash.hh"
+#include "SearchPlanner.hh"
+#include "SearchQuery.hh"
+#include "TaskScheduler.hh"
+
 // =============================================================================
 // Public Methods
 // =============================================================================
@@ -14,7 +19,7 @@
  *       Use the `loadDatabase` method to open a database connection.
  */
 Pond::Pond()
-  : _db(nullptr) {
+  : _db(nullptr), _indexes(std::make_shared<Pond::Indexes>()), _caches(std::make_shared<Pond::Caches>()) {
 }
 
 /**
@@ -27,11 +32,146 @@ Pond::Pond()
  *       this method safely does nothing.
  */
 Pond::~Pond() {
+  if (this->_pressure_callback) {
+    CacheManager::shared().removePressureCallback(this->_pressure_callback);
+  }
   if (_db) {
     sqlite3_close(_db);
   }
 }
 
+namespace {
+
+/**
+ * @brief Estimates the bytes a string holds on the heap, beyond the object itself.
+ */
+size_t heapBytes(const std::string& text) {
+  return text.capacity() > 15 ? text.capacity() + 1 : 0;
+}
+
+/**
+ * @brief Estimates the bytes a quack holds, including its strings.
+ */
+size_t quackBytes(const Pond::Quack& quack) {
+  return sizeof(quack) + heapBytes(quack.text) + heapBytes(quack.date) + heapBytes(quack.time);
+}
+
+/**
+ * @brief Estimates the bytes a list of quacks holds.
+ */
+size_t quacksBytes(const std::vector<Pond::Quack>& quacks) {
+  size_t bytes = (quacks.capacity() - quacks.size()) * sizeof(Pond::Quack);
+  for (const Pond::Quack& quack : quacks) {
+    bytes += quackBytes(quack);
+  }
+  return bytes;
+}
+
+/**
+ * @brief Builds the statement taking notifications out of their users' unread counts
+ *        before a tombstone hides them.
+ *
+ * @param match The condition on `live_notifications n` selecting the notifications.
+ */
+std::string hideNotificationsQuery(const std::string& match) {
+  return "UPDATE notification_state SET unread = MAX(unread - ("
+         "  SELECT COUNT(*) FROM live_notifications n "
+         "  WHERE " + match + " AND n.usr = notification_state.usr "
+         "    AND n.nid > notification_state.last_read), 0) "
+         "WHERE usr IN (SELECT n.usr FROM live_notifications n WHERE " + match + ")";
+}
+
+}  // namespace
+
+/**
+ * @brief Constructs empty caches registered with the process-wide cache manager.
+ */
+Pond::Caches::Caches(const uint64_t& group)
+  : feeds("feeds", generation, [](const std::shared_ptr<const std::vector<Pond::FeedEntry>>& feed) {
+      size_t bytes = sizeof(*feed) + feed->capacity() * sizeof(Pond::FeedEntry);
+      for (const Pond::FeedEntry& entry : *feed) {
+        bytes += heapBytes(entry.type) + heapBytes(entry.author) + heapBytes(entry.date) +
+                 heapBytes(entry.time) + heapBytes(entry.text);
+      }
+      return bytes;
+    }, FEED_CACHE_TTL),
+    usernames("usernames", generation, [](const std::string& name) {
+      return heapBytes(name);
+    }),
+    followers("followers", generation, [](const std::vector<Pond::User>& users) {
+      size_t bytes = users.capacity() * sizeof(Pond::User);
+      for (const Pond::User& user : users) {
+        bytes += heapBytes(user.name);
+      }
+      return bytes;
+    }),
+    follows("follows", generation, [](const std::vector<int32_t>& follows) {
+      return follows.capacity() * sizeof(int32_t);
+    }),
+    quacks("quacks", generation, quacksBytes),
+    searches("searches", generation, quacksBytes) {
+  if (group) {
+    CacheManager& manager = CacheManager::shared();
+    manager.setGroup(this->feeds, group);
+    manager.setGroup(this->usernames, group);
+    manager.setGroup(this->followers, group);
+    manager.setGroup(this->follows, group);
+    manager.setGroup(this->quacks, group);
+    manager.setGroup(this->searches, group);
+  }
+}
+
+/**
+ * @brief Retrieves the bytes held by all the caches.
+ *
+ * @return The number of bytes.
+ */
+size_t Pond::Caches::bytes() const {
+  return this->feeds.cacheStats().bytes + this->usernames.cacheStats().bytes +
+         this->followers.cacheStats().bytes + this->follows.cacheStats().bytes +
+         this->quacks.cacheStats().bytes + this->searches.cacheStats().bytes;
+}
+
+/**
+ * @brief Retrieves the number of loads and invalidations of all the indexes.
+ *
+ * A writer compares it before and after its transaction: if any index was loaded or
+ * invalidated meanwhile, the changes the writer recorded may be missing from it, so
+ * none of them is advanced and each reloads instead.
+ *
+ * @return The count.
+ */
+uint64_t Pond::Indexes::loads() const {
+  const uint64_t loads = this->follow_graph.loads() + this->engagement.loads() + this->text_scan.loads();
+  std::lock_guard<std::mutex> lock(this->search_lock);
+  return loads + this->search_version.loads();
+}
+
+/**
+ * @brief Moves every index past a write whose changes were recorded in them.
+ *
+ * @param from The version of the tables when the write began.
+ * @param to The version of the tables once the write is done.
+ */
+void Pond::Indexes::advance(const int64_t& from, const int64_t& to) {
+  this->follow_graph.advance(from, to);
+  this->engagement.advance(from, to);
+  this->text_scan.advance(from, to);
+  std::lock_guard<std::mutex> lock(this->search_lock);
+  this->search_version.advance(from, to);
+}
+
+/**
+ * @brief Forgets every index, so each is rebuilt on its next use.
+ */
+void Pond::Indexes::invalidate() {
+  this->follow_graph.invalidate();
+  this->engagement.invalidate();
+  this->text_scan.invalidate();
+  std::lock_guard<std::mutex> lock(this->search_lock);
+  this->search_version.invalidate();
+}
+
 /**
  * @brief Opens a connection to the SQLite database specified by the filename.
  *
@@ -45,9 +185,149 @@ int Pond::loadDatabase(const std::string& db_filename) {
     std::cerr << "Can't open database: " << sqlite3_errmsg(this->_db) << std::endl;
     return exit_code;
   }
+  sqlite3_busy_handler(this->_db, &Pond::_busyHandler, this);
+
+  if (!this->_registerFunctions() || !this->_indexes->follow_graph.attach(this->_db) || !this->_ensureSchema()) {
+    std::cerr << "Can't prepare database: " << sqlite3_errmsg(this->_db) << std::endl;
+    return sqlite3_errcode(this->_db);
+  }
+
+  // Record the version the caches start from, so any later write invalidates them
+  this->_validateCaches();
+
+  // Give back this connection's page cache when SQLite and the caches exceed the budget.
+  // The callback runs on whichever thread rebalances, so it only asks; the thread using
+  // this connection releases the memory at its next read or write.
+  if (!this->_pressure_callback) {
+    this->_pressure_callback = CacheManager::shared().addPressureCallback([this](const size_t&) {
+      this->_release_memory.store(true, std::memory_order_release);
+    });
+  }
   return 0;
 }
 
+/**
+ * @brief Sets a check that interrupts long-running statements.
+ *
+ * While set, the check is polled every `INTERRUPT_CHECK_INTERVAL` virtual machine
+ * instructions of any statement; returning true aborts the statement, and the
+ * running method fails as if the query had returned an error.
+ *
+ * @param should_stop The check, or an empty function to remove it.
+ */
+void Pond::setInterruptCheck(std::function<bool()> should_stop) {
+  this->_interrupt_check = std::move(should_stop);
+  if (this->_interrupt_check) {
+    sqlite3_progress_handler(this->_db, INTERRUPT_CHECK_INTERVAL, &Pond::_progressHandler, this);
+  } else {
+    sqlite3_progress_handler(this->_db, 0, nullptr, nullptr);
+  }
+}
+
+/**
+ * @brief Retrieves the lock-wait counters of this connection.
+ *
+ * @return A snapshot of the counters.
+ */
+Pond::LockStats Pond::getLockStats() const {
+  return this->_lock_stats;
+}
+
+/**
+ * @brief Resets the lock-wait counters of this connection to zero.
+ */
+void Pond::resetLockStats() {
+  this->_lock_stats = Pond::LockStats();
+}
+
+/**
+ * @brief Sets a profiler that counts performance events around this connection's
+ *        feed, search, profile and write operations.
+ *
+ * Each operation is counted under its method name, with the rows it returned.
+ *
+ * @param profiler The profiler, or nullptr to stop profiling. It must outlive the
+ *                 connection or be unset first.
+ */
+void Pond::setProfiler(PerfCounters* profiler) {
+  this->_profiler = profiler;
+}
+
+/**
+ * @brief Retrieves the read caches used by this connection.
+ *
+ * @return The caches, or nullptr if caching is disabled.
+ */
+std::shared_ptr<Pond::Caches> Pond::getCaches() const {
+  return this->_caches;
+}
+
+/**
+ * @brief Replaces the read caches used by this connection.
+ *
+ * Passing another connection's caches lets this one fill them from another thread,
+ * e.g. to load data before it is asked for; the connection that created them stays
+ * responsible for invalidating them. A filling connection never needs to: it reads the
+ * generation before each query, so its results are at least as new as anything the
+ * owner has seen, and a write it notices first is caught by the owner's next lookup.
+ * Invalidating from both sides would only throw away entries after every write.
+ *
+ * Connections that share caches with no single long-lived owner, such as a pool whose
+ * connections come and go, must all be owners, so some open connection always notices
+ * writes made outside the pool.
+ *
+ * @param caches The caches to read and fill, or nullptr to disable caching.
+ * @param owner Whether this connection also invalidates the caches when it sees
+ *              writes from other connections.
+ */
+void Pond::setCaches(std::shared_ptr<Pond::Caches> caches, const bool& owner) {
+  this->_caches = std::move(caches);
+  this->_owns_caches = owner && this->_caches;
+  this->_caches_version = -1;
+}
+
+/**
+ * @brief Retrieves the in-memory indexes used by this connection.
+ *
+ * @return The indexes.
+ */
+std::shared_ptr<Pond::Indexes> Pond::getIndexes() const {
+  return this->_indexes;
+}
+
+/**
+ * @brief Replaces the in-memory indexes used by this connection.
+ *
+ * Connections to the same database that share one set of indexes, such as the
+ * connections of a pool, hold one copy of them and keep each other's writes in it
+ * instead of reloading it whenever another of them commits. Indexes must never be
+ * shared between databases, nor replaced while a statement of this connection runs.
+ *
+ * @param indexes The indexes of another connection to the same database, or nullptr
+ *                for indexes of this connection's own.
+ */
+void Pond::setIndexes(std::shared_ptr<Pond::Indexes> indexes) {
+  this->_indexes = indexes ? std::move(indexes) : std::make_shared<Pond::Indexes>();
+  if (this->_db) {
+    this->_indexes->follow_graph.attach(this->_db);
+  }
+}
+
+/**
+ * @brief Caps the SQLite page cache of this connection.
+ *
+ * @param kib The cap in KiB.
+ * @return true if the cap was set; false otherwise.
+ */
+bool Pond::setPageCacheLimit(const uint32_t& kib) {
+  const std::string query = "PRAGMA cache_size = -" + std::to_string(std::max(kib, 1u)) + ";";
+  if (sqlite3_exec(this->_db, query.c_str(), nullptr, nullptr, nullptr) != SQLITE_OK) {
+    std::cerr << "SQL Error (page cache): " << sqlite3_errmsg(this->_db) << std::endl;
+    return false;
+  }
+  return true;
+}
+
 /**
  * @brief Adds a new user to the users table in the database.
  *
@@ -59,10 +339,21 @@ int Pond::loadDatabase(const std::string& db_filename) {
  * @return true if the user was successfully added; false otherwise.
  */
 int32_t* Pond::addUser(const std::string& name, const std::string& email, const int64_t& phone, const std::string& password) {
+  // Hashing is slow on purpose, so it is done before the write lock is taken
+  const std::string hash = PasswordHash::hash(password);
+
+  // Claim the ID and insert under one write lock, and record the user in the shared
+  // indexes before the commit
+  bool own_transaction;
+  if (!this->_beginWrite(own_transaction)) {
+    return nullptr;
+  }
+
   int32_t user_id;
 
   // Get a unique user ID
   if (!_getUniqueUserID(user_id)) {
+    this->_endWrite(own_transaction, false);
     return nullptr;  // Return nullptr if we couldn't get a unique ID
   }
 
@@ -73,6 +364,7 @@ int32_t* Pond::addUser(const std::string& name, const std::string& email, const
   sqlite3_stmt* stmt;
   if (sqlite3_prepare_v2(this->_db, query, -1, &stmt, nullptr) != SQLITE_OK) {
     sqlite3_finalize(stmt);
+    this->_endWrite(own_transaction, false);
     return nullptr;
   }
 
@@ -81,7 +373,7 @@ int32_t* Pond::addUser(const std::string& name, const std::string& email, const
   sqlite3_bind_text(stmt, 2, name.c_str(), -1, SQLITE_STATIC);      // name
   sqlite3_bind_text(stmt, 3, email.c_str(), -1, SQLITE_STATIC);     // email
   sqlite3_bind_int(stmt, 4, phone);                                // phone
-  sqlite3_bind_text(stmt, 5, password.c_str(), -1, SQLITE_STATIC);  // pwd
+  sqlite3_bind_text(stmt, 5, hash.c_str(), -1, SQLITE_STATIC);      // pwd
 
   // Execute the query.
   int32_t* result = nullptr;
@@ -90,6 +382,24 @@ int32_t* Pond::addUser(const std::string& name, const std::string& email, const
   }
 
   sqlite3_finalize(stmt);
+
+  if (result) {
+    this->_invalidateCaches();
+    this->_recordActivity(Activity::NEW_USERS);
+    Pond::Indexes& indexes = *this->_indexes;
+    std::lock_guard<std::mutex> lock(indexes.search_lock);
+    if (indexes.search_version.isLoaded()) {
+      indexes.user_completions.add(_completionKey(name), name, 0);
+      indexes.indexed_users[user_id] = {name, 0};
+      for (const std::string& word : _nameWords(name)) {
+        indexes.name_tokens.insert(word, user_id);
+      }
+    }
+  }
+  if (!this->_endWrite(own_transaction, result != nullptr)) {
+    delete result;
+    return nullptr;
+  }
   return result;  // Return either the pointer to user_id or nullptr
 }
 
@@ -107,6 +417,11 @@ int32_t* Pond::addUser(const std::string& name, const std::string& email, const
  * @note Ensures case-insensitive uniqueness of hashtags for the specified quack.
  */
 bool Pond::addHashtag(const int32_t& quack_id, const std::string& hashtag) {
+  bool own_transaction;
+  if (!this->_beginWrite(own_transaction)) {
+    return false;
+  }
+
   const char *query =
       "INSERT INTO hashtag_mentions (tid, term) "
       "SELECT ?, ? "
@@ -117,7 +432,7 @@ bool Pond::addHashtag(const int32_t& quack_id, const std::string& hashtag) {
   sqlite3_stmt* stmt;
   if (sqlite3_prepare_v2(this->_db, query, -1, &stmt, nullptr) != SQLITE_OK) {
     sqlite3_finalize(stmt);
-    return false;
+    return this->_endWrite(own_transaction, false);
   }
 
   // Bind parameters to prevent SQL injection
@@ -128,7 +443,15 @@ bool Pond::addHashtag(const int32_t& quack_id, const std::string& hashtag) {
   bool added = sqlite3_step(stmt) == SQLITE_DONE;
   sqlite3_finalize(stmt);
 
-  return added;
+  if (added && sqlite3_changes(this->_db) > 0) {
+    this->_recordActivity(Activity::HASHTAG_MENTIONS);
+    Pond::Indexes& indexes = *this->_indexes;
+    std::lock_guard<std::mutex> lock(indexes.search_lock);
+    if (indexes.search_version.isLoaded()) {
+      indexes.hashtag_completions.add(_completionKey(hashtag), hashtag, 1);
+    }
+  }
+  return this->_endWrite(own_transaction, added);
 }
 
 /**
@@ -179,45 +502,100 @@ bool Pond::validateQuack(const int32_t& quack_id, const std::string& text) {
  *
  * @param user_id The ID of the user who is posting the quack.
  * @param text The text of the quack.
- * @return A pointer to the unique ID of the quack if it was successfully added; nullptr otherwise.
+ * @return A pointer to the unique ID of the quack if it was successfully added; nullptr
+ *         otherwise, e.g. if the user has been deleted.
  */
 int32_t* Pond::addQuack(const int32_t& user_id, const std::string& text) {
-  int32_t* result = nullptr;
-
-  int32_t quack_id;
-  if (!this->_getUniqueQuackID(quack_id)) {
-    return result;
+  PerfCounters::Scope profile(this->_profiler, "Pond::addQuack");
+  // Claim the next ID and insert under one write lock, so no other session claims it too
+  bool own_transaction;
+  if (!this->_beginWrite(own_transaction)) {
+    return nullptr;
   }
 
-  if (!validateQuack(quack_id, text)) {
-    return result;
-  }
+  // Checked under the write lock, so the user cannot be deleted before the quack lands
+  int32_t quack_id;
+  bool added = this->_isLive(DeletedKind::USER, user_id) && this->_getUniqueQuackID(quack_id) &&
+               validateQuack(quack_id, text);
 
   const char* query =
     "INSERT INTO tweets (tid, writer_id, text, tdate, ttime) "
     "VALUES (?, ?, ?, ?, ?)";
 
   // Prepare the SQL statement.
-  sqlite3_stmt* stmt;
-  if (sqlite3_prepare_v2(this->_db, query, -1, &stmt, nullptr) != SQLITE_OK) {
-    sqlite3_finalize(stmt);
-    return result;
+  sqlite3_stmt* stmt = nullptr;
+  if (added && sqlite3_prepare_v2(this->_db, query, -1, &stmt, nullptr) == SQLITE_OK) {
+    // Bind parameters to prevent SQL injection.
+    sqlite3_bind_int(stmt, 1, quack_id);                               // tid
+    sqlite3_bind_int(stmt, 2, user_id);                                // writer_id
+    sqlite3_bind_text(stmt, 3, text.c_str(), -1, SQLITE_STATIC);       // text
+    sqlite3_bind_text(stmt, 4, this->_getDate().c_str(), -1, SQLITE_TRANSIENT);   // tdate
+    sqlite3_bind_text(stmt, 5, this->_getTime().c_str(), -1, SQLITE_TRANSIENT);   // ttime
+
+    // Execute the query.
+    added = sqlite3_step(stmt) == SQLITE_DONE;
+  } else {
+    added = false;
   }
+  sqlite3_finalize(stmt);
 
-  // Bind parameters to prevent SQL injection.
-  sqlite3_bind_int(stmt, 1, quack_id);                               // tid
-  sqlite3_bind_int(stmt, 2, user_id);                                // writer_id
-  sqlite3_bind_text(stmt, 3, text.c_str(), -1, SQLITE_STATIC);       // text
-  sqlite3_bind_text(stmt, 4, this->_getDate(), -1, SQLITE_STATIC);   // tdate
-  sqlite3_bind_text(stmt, 5, this->_getTime(), -1, SQLITE_STATIC);   // ttime
+  if (added) {
+    this->_invalidateCaches();
+    this->_recordActivity(Activity::QUACKS);
+    this->_recordMentions(quack_id, user_id, text, 0);
+    this->_indexes->text_scan.addQuack(quack_id, text);
+  }
+  return this->_endWrite(own_transaction, added) ? new int32_t(quack_id) : nullptr;
+}
 
-  // Execute the query.
-  if (sqlite3_step(stmt) == SQLITE_DONE) {
-    result = new int32_t(quack_id);
+/**
+ * @brief Adds several quacks in one transaction.
+ *
+ * Each post goes through `addQuack`, so hashtags, mentions and activity are recorded
+ * as usual; sharing one transaction saves a commit per quack. Each post runs under its
+ * own savepoint, so whatever a rejected post wrote before it was rejected, such as its
+ * hashtags, is undone rather than left to the next quack, which gets the same ID; the
+ * in-memory indexes it was recorded in are then rebuilt on their next use, as they are
+ * if the transaction cannot be committed.
+ *
+ * @param posts Pairs of the posting user's ID and the quack's text.
+ * @param[out] quack_ids The ID of each new quack, in order, or 0 for a post that was
+ *                       rejected. Every entry is 0 if the transaction failed.
+ * @return true if the transaction was committed; false if it could not be begun or
+ *         committed, in which case no quack was added.
+ */
+bool Pond::addQuacks(const std::vector<std::pair<int32_t, std::string>>& posts, std::vector<int32_t>& quack_ids) {
+  quack_ids.assign(posts.size(), 0);
+
+  bool own_transaction;
+  if (!this->_beginWrite(own_transaction)) {
+    return false;
+  }
+
+  for (size_t i = 0; i < posts.size(); ++i) {
+    if (sqlite3_exec(this->_db, "SAVEPOINT post", nullptr, nullptr, nullptr) != SQLITE_OK) {
+      break;
+    }
+    const int64_t index_version = IndexVersion::read(this->_db);
+    int32_t* quack_id = this->addQuack(posts[i].first, posts[i].second);
+    if (quack_id) {
+      quack_ids[i] = *quack_id;
+      delete quack_id;
+    } else {
+      // Hashtags the post added before it was rejected are in the indexes already
+      if (IndexVersion::read(this->_db) != index_version) {
+        this->_indexes->invalidate();
+      }
+      sqlite3_exec(this->_db, "ROLLBACK TO post", nullptr, nullptr, nullptr);
+    }
+    sqlite3_exec(this->_db, "RELEASE post", nullptr, nullptr, nullptr);
   }
-  sqlite3_finalize(stmt);
 
-  return result;
+  if (!this->_endWrite(own_transaction, true)) {
+    std::fill(quack_ids.begin(), quack_ids.end(), 0);
+    return false;
+  }
+  return true;
 }
 
 /**
@@ -229,39 +607,53 @@ int32_t* Pond::addQuack(const int32_t& user_id, const std::string& text) {
 * @return true if the reply was successfully added; false otherwise.
 */
 int32_t* Pond::addReply(const int32_t& user_id, const int32_t& reply_quack_id, const std::string& text) {
-  int32_t* result = nullptr;
+  PerfCounters::Scope profile(this->_profiler, "Pond::addReply");
+  // Claim the next ID and insert under one write lock, so no other session claims it too
+  bool own_transaction;
+  if (!this->_beginWrite(own_transaction)) {
+    return nullptr;
+  }
+
+  // Checked under the write lock, so neither the quack nor the user can be deleted
+  // before the reply lands
+  int32_t reply_tid;
+  bool added = this->_isLive(DeletedKind::USER, user_id) && this->_isLive(DeletedKind::QUACK, reply_quack_id) &&
+               this->_getUniqueQuackID(reply_tid);
 
   const char* query =
     "INSERT INTO tweets (tid, writer_id, text, tdate, ttime, replyto_tid) "
     "VALUES (?, ?, ?, ?, ?, ?)";
 
   // Prepare the SQL statement.
-  sqlite3_stmt* stmt;
-  if (sqlite3_prepare_v2(this->_db, query, -1, &stmt, nullptr) != SQLITE_OK) {
-    sqlite3_finalize(stmt);
-    return result;
-  }
-
-  int32_t reply_tid;
-  if (!_getUniqueQuackID(reply_tid)) {
-    return result;  // Return nullptr if we couldn't get a unique ID
-  }
-
-  // Bind parameters to prevent SQL injection
-  sqlite3_bind_int(stmt, 1, reply_tid);                              // tid;
-  sqlite3_bind_int(stmt, 2, user_id);                                // writer_id
-  sqlite3_bind_text(stmt, 3, text.c_str(), -1, SQLITE_STATIC);       // text
-  sqlite3_bind_text(stmt, 4, this->_getDate(), -1, SQLITE_STATIC);   // tdate
-  sqlite3_bind_text(stmt, 5, this->_getTime(), -1, SQLITE_STATIC);   // ttime
-  sqlite3_bind_int(stmt, 6, reply_quack_id);                         // replyto_tid
-
-  // Execute the query.
-  if (sqlite3_step(stmt) == SQLITE_DONE) {
-    result = new int32_t(reply_tid);
+  sqlite3_stmt* stmt = nullptr;
+  if (added && sqlite3_prepare_v2(this->_db, query, -1, &stmt, nullptr) == SQLITE_OK) {
+    // Bind parameters to prevent SQL injection
+    sqlite3_bind_int(stmt, 1, reply_tid);                              // tid;
+    sqlite3_bind_int(stmt, 2, user_id);                                // writer_id
+    sqlite3_bind_text(stmt, 3, text.c_str(), -1, SQLITE_STATIC);       // text
+    sqlite3_bind_text(stmt, 4, this->_getDate().c_str(), -1, SQLITE_TRANSIENT);   // tdate
+    sqlite3_bind_text(stmt, 5, this->_getTime().c_str(), -1, SQLITE_TRANSIENT);   // ttime
+    sqlite3_bind_int(stmt, 6, reply_quack_id);                         // replyto_tid
+
+    // Execute the query.
+    added = sqlite3_step(stmt) == SQLITE_DONE;
+  } else {
+    added = false;
   }
   sqlite3_finalize(stmt);
 
-  return result;
+  if (added) {
+    this->_invalidateCaches();
+    const int32_t parent_writer_id = this->getQuackFromID(reply_quack_id).writer_id;
+    this->_recordActivity(Activity::REPLIES);
+    this->_bumpQuackStats(reply_quack_id, 0, 1, 0);
+    this->_indexes->engagement.recordReply(reply_quack_id, parent_writer_id);
+    this->_bumpAffinity(user_id, parent_writer_id, 3);
+    this->_notify(parent_writer_id, NotificationKind::REPLY, user_id, reply_tid, text);
+    this->_recordMentions(reply_tid, user_id, text, parent_writer_id);
+    this->_indexes->text_scan.addQuack(reply_tid, text);
+  }
+  return this->_endWrite(own_transaction, added) ? new int32_t(reply_tid) : nullptr;
 }
 
 /**
@@ -277,6 +669,7 @@ int32_t* Pond::addReply(const int32_t& user_id, const int32_t& reply_quack_id, c
  *         - 0: A new requack was successfully added.
  *         - 1: The requack already exists and was marked as spam.
  *         - 3: An error occurred during the process.
+ *         - -1: The quack or the user has been deleted.
  *
  * @note The method uses parameterized SQL queries to prevent SQL injection and ensures
  *       proper database interaction. Dates for new requacks are recorded using the current
@@ -284,12 +677,24 @@ int32_t* Pond::addReply(const int32_t& user_id, const int32_t& reply_quack_id, c
  *
  * @details 
  * - **Spam Handling**: If a requack already exists for the user and quack, the method updates
- *   the existing record, setting the `spam` flag to `1`.
+ *   the existing record, setting the `spam` flag to `1` unless it is already set.
  * - **New Requack**: If no requack exists, a new entry is added to the `retweets` table,
- *   linking the `quack_id` to the `user_id` and recording the `writer_id` and current date.
+ *   linking the `quack_id` to the `user_id` and recording the `writer_id` and current date and time.
  */
 int32_t Pond::addRequack(const int32_t &user_id, const int32_t &quack_id) {
-  int32_t requack_status = -1;
+  PerfCounters::Scope profile(this->_profiler, "Pond::addRequack");
+  int32_t requack_status = 3;
+
+  // Checked under the write lock, so neither the quack nor the user can be deleted
+  // before the requack lands
+  bool own_transaction;
+  if (!this->_beginWrite(own_transaction)) {
+    return 3;
+  }
+  if (!this->_isLive(DeletedKind::USER, user_id) || !this->_isLive(DeletedKind::QUACK, quack_id)) {
+    this->_endWrite(own_transaction, false);
+    return -1;
+  }
 
   // Check if the user has already requacked this quack
   const char *check_query =
@@ -298,6 +703,8 @@ int32_t Pond::addRequack(const int32_t &user_id, const int32_t &quack_id) {
   sqlite3_stmt *check_stmt;
   if (sqlite3_prepare_v2(this->_db, check_query, -1, &check_stmt, nullptr) != SQLITE_OK) {
     std::cerr << "SQL Error (prepare check): " << sqlite3_errmsg(this->_db) << std::endl;
+    sqlite3_finalize(check_stmt);
+    this->_endWrite(own_transaction, false);
     return 3;
   }
 
@@ -305,6 +712,7 @@ int32_t Pond::addRequack(const int32_t &user_id, const int32_t &quack_id) {
       sqlite3_bind_int(check_stmt, 2, user_id) != SQLITE_OK) {
     std::cerr << "SQL Error (bind check): " << sqlite3_errmsg(this->_db) << std::endl;
     sqlite3_finalize(check_stmt);
+    this->_endWrite(own_transaction, false);
     return 3;
   }
 
@@ -315,19 +723,24 @@ int32_t Pond::addRequack(const int32_t &user_id, const int32_t &quack_id) {
   else {
     std::cerr << "SQL Error (step check): " << sqlite3_errmsg(this->_db) << std::endl;
     sqlite3_finalize(check_stmt);
+    this->_endWrite(own_transaction, false);
     return 3;
   }
 
   sqlite3_finalize(check_stmt);
 
   if (already_requacked > 0) {
-    // User has already requacked; update the existing entry to mark as spam
+    // User has already requacked; mark the existing entry as spam. Only an entry not
+    // flagged yet is updated, so repeating the requack does not count it again, and
+    // the time it was made is returned so the leaderboards can take it back out.
     const char *update_query =
-        "UPDATE retweets SET spam = 1 WHERE tid = ? AND retweeter_id = ?";
+        "UPDATE retweets SET spam = 1, flagged_at = datetime('now') WHERE tid = ? AND retweeter_id = ? AND spam = 0 "
+        "RETURNING CAST(strftime('%s', rdate || ' ' || IFNULL(rtime, '00:00:00')) AS INTEGER)";
 
     sqlite3_stmt *update_stmt;
     if (sqlite3_prepare_v2(this->_db, update_query, -1, &update_stmt, nullptr) != SQLITE_OK) {
       std::cerr << "SQL Error (prepare update): " << sqlite3_errmsg(this->_db) << std::endl;
+      this->_endWrite(own_transaction, false);
       return 3;
     }
 
@@ -335,38 +748,60 @@ int32_t Pond::addRequack(const int32_t &user_id, const int32_t &quack_id) {
         sqlite3_bind_int(update_stmt, 2, user_id) != SQLITE_OK) {
       std::cerr << "SQL Error (bind update): " << sqlite3_errmsg(this->_db) << std::endl;
       sqlite3_finalize(update_stmt);
+      this->_endWrite(own_transaction, false);
       return 3;
     }
 
-    if (sqlite3_step(update_stmt) != SQLITE_DONE) {
+    int flagged = 0;
+    int64_t requacked_at = 0;
+    int rc;
+    while ((rc = sqlite3_step(update_stmt)) == SQLITE_ROW) {
+      requacked_at = sqlite3_column_int64(update_stmt, 0);
+      ++flagged;
+    }
+    bool updated = rc == SQLITE_DONE;
+    sqlite3_finalize(update_stmt);
+
+    if (!updated) {
       std::cerr << "SQL Error (step update): " << sqlite3_errmsg(this->_db) << std::endl;
     }
-    else {
-      requack_status = 1; // Status indicating spam update
+    else if (flagged > 0) {
+      this->_recordActivity(Activity::SPAM_REQUACKS);
+      updated = this->_bumpQuackStats(quack_id, -1, 0, 1);
+      if (updated) {
+        this->_indexes->engagement.recordRequack(quack_id, this->getQuackFromID(quack_id).writer_id, -1, requacked_at);
+      }
     }
 
-    sqlite3_finalize(update_stmt);
+    if (this->_endWrite(own_transaction, updated)) {
+      requack_status = 1; // Status indicating spam update
+      this->_invalidateCaches();
+    }
     return requack_status;
   }
 
-  // Proceed to insert the requack as a new entry
+  // Proceed to insert the requack as a new entry, recording it in the shared
+  // leaderboards before the commit
   const char *insert_query =
-      "INSERT INTO retweets (tid, retweeter_id, writer_id, rdate, spam) "
-      "VALUES (?, ?, ?, ?, ?)";
+      "INSERT INTO retweets (tid, retweeter_id, writer_id, rdate, rtime, spam) "
+      "VALUES (?, ?, ?, ?, ?, ?)";
 
   sqlite3_stmt *insert_stmt;
   if (sqlite3_prepare_v2(this->_db, insert_query, -1, &insert_stmt, nullptr) != SQLITE_OK) {
     std::cerr << "SQL Error (prepare insert): " << sqlite3_errmsg(this->_db) << std::endl;
+    this->_endWrite(own_transaction, false);
     return 3;
   }
 
   if (sqlite3_bind_int(insert_stmt, 1, quack_id) != SQLITE_OK ||
       sqlite3_bind_int(insert_stmt, 2, user_id) != SQLITE_OK ||
       sqlite3_bind_int(insert_stmt, 3, this->getQuackFromID(quack_id).writer_id) != SQLITE_OK ||
-      sqlite3_bind_text(insert_stmt, 4, this->_getDate(), -1, SQLITE_STATIC) != SQLITE_OK ||
-      sqlite3_bind_int(insert_stmt, 5, 0) != SQLITE_OK) { // No spam for new requack
+      sqlite3_bind_text(insert_stmt, 4, this->_getDate().c_str(), -1, SQLITE_TRANSIENT) != SQLITE_OK ||
+      sqlite3_bind_text(insert_stmt, 5, this->_getTime().c_str(), -1, SQLITE_TRANSIENT) != SQLITE_OK ||
+      sqlite3_bind_int(insert_stmt, 6, 0) != SQLITE_OK) { // No spam for new requack
     std::cerr << "SQL Error (bind insert): " << sqlite3_errmsg(this->_db) << std::endl;
     sqlite3_finalize(insert_stmt);
+    this->_endWrite(own_transaction, false);
     return 3;
   }
 
@@ -378,6 +813,21 @@ int32_t Pond::addRequack(const int32_t &user_id, const int32_t &quack_id) {
   }
 
   sqlite3_finalize(insert_stmt);
+
+  // Fold the requacker's followers into the cascade's reach and tell the author
+  if (requack_status == 0) {
+    this->_invalidateCaches();
+    const Pond::Quack quack = this->getQuackFromID(quack_id);
+    this->_recordActivity(Activity::REQUACKS);
+    this->_bumpQuackStats(quack_id, 1, 0, 0);
+    this->_indexes->engagement.recordRequack(quack_id, quack.writer_id, 1, std::time(nullptr));
+    this->_bumpAffinity(user_id, quack.writer_id, 2);
+    this->_updateReach(quack_id, user_id, quack.writer_id);
+    this->_notify(quack.writer_id, NotificationKind::REQUACK, user_id, quack_id, quack.text);
+  }
+  if (!this->_endWrite(own_transaction, requack_status == 0)) {
+    return 3;
+  }
   return requack_status;
 }
 
@@ -393,7 +843,7 @@ bool Pond::addToList(const std::string& list_name, const int32_t& quack_id, cons
   bool added_to_list = false;
 
   // check for existence first
-  if (!this->_listExists(list_name, user_id)) {
+  if (!this->_listExists(list_name, user_id) || !this->_isLive(DeletedKind::QUACK, quack_id)) {
     return added_to_list;
   }
 
@@ -457,98 +907,369 @@ bool Pond::createList(const int32_t& user_id, const std::string& list_name) {
 }
 
 /**
- * @brief Checks if the provided user ID and password are valid for login.
+ * @brief Deletes a quack, together with its replies, requacks, hashtags, mentions and
+ *        list entries.
  *
- * @param user_id The user ID to check in the database.
- * @param password The password corresponding to the user ID.
- * @return true if the login credentials are valid; false otherwise.
+ * The quack and every reply under it, however deep, are hidden from every read at once,
+ * and taken out of the shared indexes; their rows are removed later by `purgeDeleted`.
+ *
+ * @param user_id The ID of the user deleting the quack; must be its author.
+ * @param quack_id The ID of the quack.
+ * @return true if the quack was deleted; false if it does not exist, was already
+ *         deleted, was written by someone else, or the write failed.
  */
-int32_t* Pond::checkLogin(const int32_t& user_id, const std::string& password) {
-  int32_t* user_id_ptr = nullptr;
-
-  const char* query =
-    "SELECT * "
-    "FROM users "
-    "WHERE usr = ? "
-    "AND pwd = ?";
+bool Pond::deleteQuack(const int32_t& user_id, const int32_t& quack_id) {
+  // The thread is taken out of the shared indexes before the commit
+  bool own_transaction;
+  if (!this->_beginWrite(own_transaction)) {
+    return false;
+  }
 
-  // Prepare the SQL statement.
+  // Each quack of the thread gets its own tombstone, so `live_tweets` hides replies to
+  // replies without walking the thread on every read
+  const char* thread_query =
+    "WITH RECURSIVE thread(tid) AS ("
+    "  SELECT tid FROM live_tweets WHERE tid = ?1 AND writer_id = ?2 "
+    "  UNION SELECT t.tid FROM live_tweets t JOIN thread ON t.replyto_tid = thread.tid"
+    ") SELECT tid FROM thread;";
+  std::vector<int32_t> quack_ids;
   sqlite3_stmt* stmt;
-  if (sqlite3_prepare_v2(this->_db, query, -1, &stmt, nullptr) != SQLITE_OK) {
+  if (sqlite3_prepare_v2(this->_db, thread_query, -1, &stmt, nullptr) != SQLITE_OK) {
+    std::cerr << "SQL Error (delete): " << sqlite3_errmsg(this->_db) << std::endl;
     sqlite3_finalize(stmt);
-    return nullptr;
+    return this->_endWrite(own_transaction, false);
+  }
+  sqlite3_bind_int(stmt, 1, quack_id);
+  sqlite3_bind_int(stmt, 2, user_id);
+  int rc;
+  while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+    quack_ids.push_back(sqlite3_column_int(stmt, 0));
+  }
+  sqlite3_finalize(stmt);
+  if (rc != SQLITE_DONE || quack_ids.empty()) {
+    if (rc != SQLITE_DONE) {
+      std::cerr << "SQL Error (delete): " << sqlite3_errmsg(this->_db) << std::endl;
+    }
+    return this->_endWrite(own_transaction, false);
   }
 
-  // Bind parameters to prevent SQL injection.
-  sqlite3_bind_int(stmt, 1, user_id);                               // usr
-  sqlite3_bind_text(stmt, 2, password.c_str(), -1, SQLITE_STATIC);  // pwd
-
+  // The indexes read what they take out through the live views, so before the tombstones
+  Pond::Indexes& indexes = *this->_indexes;
+  indexes.engagement.removeQuacks(this->_db, quack_ids);
+  indexes.text_scan.removeQuacks(quack_ids);
+  {
+    std::lock_guard<std::mutex> lock(indexes.search_lock);
+    if (indexes.search_version.isLoaded() &&
+        sqlite3_prepare_v2(this->_db, "SELECT term FROM hashtag_mentions WHERE tid = ?", -1, &stmt, nullptr) == SQLITE_OK) {
+      for (const int32_t& tid : quack_ids) {
+        sqlite3_bind_int(stmt, 1, tid);
+        while (sqlite3_step(stmt) == SQLITE_ROW) {
+          const std::string term = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
+          indexes.hashtag_completions.add(_completionKey(term), term, -1);
+        }
+        sqlite3_reset(stmt);
+      }
+      sqlite3_finalize(stmt);
+    }
+  }
 
-  // Execute the query.
-  if (sqlite3_step(stmt) == SQLITE_ROW) {
-    int32_t retrieved_id = sqlite3_column_int(stmt, 0);
-    user_id_ptr = new int32_t(retrieved_id);
+  const char* query =
+    "INSERT OR IGNORE INTO tombstones (kind, id, lname, deleted_at) "
+    "VALUES (0, ?, '', datetime('now'))";
+  bool deleted = sqlite3_prepare_v2(this->_db, query, -1, &stmt, nullptr) == SQLITE_OK;
+  for (size_t i = 0; deleted && i < quack_ids.size(); ++i) {
+    deleted = this->_hideNotifications("n.tid = ?1", quack_ids[i]);
+    if (!deleted) {
+      break;
+    }
+    sqlite3_bind_int(stmt, 1, quack_ids[i]);
+    deleted = sqlite3_step(stmt) == SQLITE_DONE;
+    sqlite3_reset(stmt);
   }
   sqlite3_finalize(stmt);
 
-  return user_id_ptr;
+  if (!deleted) {
+    // The indexes no longer match what the rollback restores
+    std::cerr << "SQL Error (delete): " << sqlite3_errmsg(this->_db) << std::endl;
+    indexes.invalidate();
+    return this->_endWrite(own_transaction, false);
+  }
+  this->_invalidateCaches();
+  return this->_endWrite(own_transaction, true);
 }
 
 /**
- * @brief Adds a follow relationship between two users.
+ * @brief Deletes a user, together with their quacks, requacks, follows, lists and
+ *        notifications.
  *
- * @param user_id The ID of the user who is following.
- * @param follow_id The ID of the user to be followed.
- * @return true if the follow was successfully added, false otherwise.
+ * The user and everything they wrote are hidden from every read at once, and they can
+ * no longer log in; their rows are removed later by `purgeDeleted`.
+ *
+ * @param user_id The ID of the user.
+ * @return true if the user was deleted; false if they do not exist, were already
+ *         deleted, or the write failed.
  */
-bool Pond::follow(const int32_t& user_id, const int32_t& follow_id) {
-  bool follow_added = false;
-
+bool Pond::deleteUser(const int32_t& user_id) {
   const char* query =
-    "INSERT INTO follows (flwer, flwee, start_date) "
-    "VALUES (?, ?, ?)";
-
-  // Prepare the SQL statement.
-  sqlite3_stmt* stmt;
-  if (sqlite3_prepare_v2(this->_db, query, -1, &stmt, nullptr) != SQLITE_OK) {
-    sqlite3_finalize(stmt);
+    "INSERT OR IGNORE INTO tombstones (kind, id, lname, deleted_at) "
+    "SELECT 1, usr, '', datetime('now') FROM live_users "
+    "WHERE usr = ?1";
+  bool own_transaction;
+  if (!this->_beginWrite(own_transaction)) {
     return false;
   }
+  const bool deleted = this->_hideNotifications("n.actor = ?1", user_id) &&
+                       this->_addTombstone(query, [&](sqlite3_stmt* stmt) {
+    sqlite3_bind_int(stmt, 1, user_id);
+  });
 
-  // Bind parameters to prevent SQL injection.
-  sqlite3_bind_int(stmt, 1, user_id);                               // follower_id
-  sqlite3_bind_int(stmt, 2, follow_id);                             // followee_id
-  sqlite3_bind_text(stmt, 3, this->_getDate(), -1, SQLITE_STATIC);  // start_date
-
-  // Execute the query.
-  if (sqlite3_step(stmt) == SQLITE_DONE) {
-    follow_added = true;
+  // Everything the user wrote, followed or was followed by leaves the indexes at once,
+  // which is cheaper to reload than to take out row by row
+  if (deleted) {
+    this->_indexes->invalidate();
   }
-  sqlite3_finalize(stmt);
-
-  return follow_added;
+  return this->_endWrite(own_transaction, deleted);
 }
 
 /**
- * @brief Removes a follow relationship between two users.
+ * @brief Deletes a list and its entries.
  *
- * @param user_id The ID of the user who is unfollowing.
- * @param follow_id The ID of the user to be unfollowed.
- * @return true if the unfollow was successful, false otherwise.
+ * The list is hidden at once; its rows are removed later by `purgeDeleted`, and a list
+ * of the same name can only be created again once they are.
+ *
+ * @param user_id The ID of the user who owns the list.
+ * @param list_name The name of the list.
+ * @return true if the list was deleted; false if it does not exist, was already
+ *         deleted, or the write failed.
  */
-bool Pond::unfollow(const int32_t& user_id, const int32_t& follow_id) {
-  bool unfollowed = false;
-
+bool Pond::deleteList(const int32_t& user_id, const std::string& list_name) {
+  const char* query =
+    "INSERT OR IGNORE INTO tombstones (kind, id, lname, deleted_at) "
+    "SELECT 2, owner_id, lname, datetime('now') FROM lists "
+    "WHERE owner_id = ?1 AND lname = ?2";
+  return this->_addTombstone(query, [&](sqlite3_stmt* stmt) {
+    sqlite3_bind_int(stmt, 1, user_id);
+    sqlite3_bind_text(stmt, 2, list_name.c_str(), -1, SQLITE_STATIC);
+  });
+}
+
+/**
+ * @brief Checks if the provided user ID and password are valid for login.
+ *
+ * A plain-text password left by an older database, or a hash weaker than the current
+ * strength, is replaced by a fresh hash once it has been matched.
+ *
+ * @param user_id The user ID to check in the database.
+ * @param password The password corresponding to the user ID.
+ * @return true if the login credentials are valid; false otherwise.
+ */
+int32_t* Pond::checkLogin(const int32_t& user_id, const std::string& password) {
+  const std::string stored = this->getPasswordHash(user_id);
+  if (!PasswordHash::verify(password, stored)) {
+    return nullptr;
+  }
+  if (PasswordHash::needsRehash(stored)) {
+    this->setPasswordHash(user_id, PasswordHash::hash(password));
+  }
+  return new int32_t(user_id);
+}
+
+/**
+ * @brief Retrieves the stored password of a user.
+ *
+ * @param user_id The unique ID of the user.
+ * @return The salted hash, or the plain text of a password not yet hashed; empty if the
+ *         user does not exist or was deleted.
+ */
+std::string Pond::getPasswordHash(const int32_t& user_id) {
+  const char* query =
+    "SELECT pwd "
+    "FROM live_users "
+    "WHERE usr = ?";
+
+  sqlite3_stmt* stmt;
+  if (sqlite3_prepare_v2(this->_db, query, -1, &stmt, nullptr) != SQLITE_OK) {
+    sqlite3_finalize(stmt);
+    return "";
+  }
+  sqlite3_bind_int(stmt, 1, user_id);
+
+  std::string stored;
+  if (sqlite3_step(stmt) == SQLITE_ROW && sqlite3_column_text(stmt, 0)) {
+    stored = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
+  }
+  sqlite3_finalize(stmt);
+  return stored;
+}
+
+/**
+ * @brief Replaces the stored password of a user.
+ *
+ * @param user_id The unique ID of the user.
+ * @param hash The new hash, from `PasswordHash::hash`.
+ * @return true if the password was replaced; false otherwise.
+ */
+bool Pond::setPasswordHash(const int32_t& user_id, const std::string& hash) {
+  const char* query =
+    "UPDATE users SET pwd = ? "
+    "WHERE usr = ?";
+
+  sqlite3_stmt* stmt;
+  if (sqlite3_prepare_v2(this->_db, query, -1, &stmt, nullptr) != SQLITE_OK) {
+    sqlite3_finalize(stmt);
+    return false;
+  }
+  sqlite3_bind_text(stmt, 1, hash.c_str(), -1, SQLITE_STATIC);
+  sqlite3_bind_int(stmt, 2, user_id);
+
+  bool updated = sqlite3_step(stmt) == SQLITE_DONE && sqlite3_changes(this->_db) > 0;
+  sqlite3_finalize(stmt);
+  return updated;
+}
+
+/**
+ * @brief Replaces every plain-text password with a salted hash.
+ *
+ * The hashes are computed in parallel on the shared `TaskScheduler`, then written in
+ * one transaction. Hashes weaker than the current strength need their password, so
+ * they are left to be replaced at their owner's next login.
+ *
+ * @return The number of passwords replaced, or -1 if they could not be read or written.
+ */
+int64_t Pond::hashPasswords() {
+  std::vector<std::pair<int32_t, std::string>> passwords;
+
+  const char* query =
+    "SELECT usr, pwd "
+    "FROM users "
+    "WHERE pwd IS NOT NULL AND pwd != '' AND pwd NOT LIKE 'pbkdf2-sha256$%'";
+
+  sqlite3_stmt* stmt;
+  if (sqlite3_prepare_v2(this->_db, query, -1, &stmt, nullptr) != SQLITE_OK) {
+    std::cerr << "SQL Error (hash passwords): " << sqlite3_errmsg(this->_db) << std::endl;
+    sqlite3_finalize(stmt);
+    return -1;
+  }
+  int rc;
+  while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+    passwords.emplace_back(sqlite3_column_int(stmt, 0), reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1)));
+  }
+  sqlite3_finalize(stmt);
+  if (rc != SQLITE_DONE) {
+    std::cerr << "SQL Error (hash passwords): " << sqlite3_errmsg(this->_db) << std::endl;
+    return -1;
+  }
+
+  TaskScheduler::shared().parallelFor(0, passwords.size(), [&passwords](size_t first, size_t last) {
+    for (size_t i = first; i < last; ++i) {
+      passwords[i].second = PasswordHash::hash(passwords[i].second);
+    }
+  }, 1, TaskScheduler::Priority::BACKGROUND);
+
+  bool own_transaction;
+  if (!this->_beginWrite(own_transaction)) {
+    return -1;
+  }
+  bool ok = true;
+  for (const auto& [user_id, hash] : passwords) {
+    ok = ok && this->setPasswordHash(user_id, hash);
+  }
+  if (!this->_endWrite(own_transaction, ok)) {
+    return -1;
+  }
+  return static_cast<int64_t>(passwords.size());
+}
+
+/**
+ * @brief Adds a follow relationship between two users.
+ *
+ * @param user_id The ID of the user who is following.
+ * @param follow_id The ID of the user to be followed.
+ * @return true if the follow was successfully added, false otherwise, e.g. if either
+ *         user has been deleted.
+ */
+bool Pond::follow(const int32_t& user_id, const int32_t& follow_id) {
+  PerfCounters::Scope profile(this->_profiler, "Pond::follow");
+  bool follow_added = false;
+
+  const char* query =
+    "INSERT INTO follows (flwer, flwee, start_date) "
+    "VALUES (?, ?, ?)";
+
+  // The edge is recorded in the shared indexes before the commit
+  bool own_transaction;
+  if (!this->_beginWrite(own_transaction)) {
+    return false;
+  }
+
+  // Checked under the write lock, so neither user can be deleted before the edge lands
+  if (!this->_isLive(DeletedKind::USER, user_id) || !this->_isLive(DeletedKind::USER, follow_id)) {
+    return this->_endWrite(own_transaction, false);
+  }
+
+  // Prepare the SQL statement.
+  sqlite3_stmt* stmt;
+  if (sqlite3_prepare_v2(this->_db, query, -1, &stmt, nullptr) != SQLITE_OK) {
+    sqlite3_finalize(stmt);
+    return this->_endWrite(own_transaction, false);
+  }
+
+  // Bind parameters to prevent SQL injection.
+  sqlite3_bind_int(stmt, 1, user_id);                               // follower_id
+  sqlite3_bind_int(stmt, 2, follow_id);                             // followee_id
+  sqlite3_bind_text(stmt, 3, this->_getDate().c_str(), -1, SQLITE_TRANSIENT);  // start_date
+
+  // Execute the query.
+  if (sqlite3_step(stmt) == SQLITE_DONE) {
+    follow_added = true;
+  }
+  sqlite3_finalize(stmt);
+
+  if (follow_added) {
+    this->_invalidateCaches();
+    this->_indexes->follow_graph.addFollow(user_id, follow_id);
+    this->_indexes->engagement.recordFollow(follow_id, 1);
+    this->_recordActivity(Activity::FOLLOWS);
+    this->_addFollowerToSketch(follow_id, user_id);
+    this->_notify(follow_id, NotificationKind::FOLLOW, user_id, 0, "");
+    Pond::Indexes& indexes = *this->_indexes;
+    std::lock_guard<std::mutex> lock(indexes.search_lock);
+    if (indexes.search_version.isLoaded()) {
+      const std::string name = this->getUsername(follow_id);
+      indexes.user_completions.add(_completionKey(name), name, 1);
+      indexes.indexed_users[follow_id].followers += 1;
+    }
+  }
+  return this->_endWrite(own_transaction, follow_added);
+}
+
+/**
+ * @brief Removes a follow relationship between two users.
+ *
+ * @param user_id The ID of the user who is unfollowing.
+ * @param follow_id The ID of the user to be unfollowed.
+ * @return true if the unfollow was successful, false otherwise.
+ */
+bool Pond::unfollow(const int32_t& user_id, const int32_t& follow_id) {
+  PerfCounters::Scope profile(this->_profiler, "Pond::unfollow");
+  bool unfollowed = false;
+
   const char* query =
     "DELETE FROM follows "
     "WHERE flwer = ? "
     "AND flwee = ?";
 
+  // The edge is taken out of the shared indexes before the commit
+  bool own_transaction;
+  if (!this->_beginWrite(own_transaction)) {
+    return false;
+  }
+
   // Prepare the SQL statement.
   sqlite3_stmt* stmt;
   if (sqlite3_prepare_v2(this->_db, query, -1, &stmt, nullptr) != SQLITE_OK) {
     sqlite3_finalize(stmt);
-    return false;
+    return this->_endWrite(own_transaction, false);
   }
 
   // Bind parameters to prevent SQL injection.
@@ -560,8 +1281,34 @@ bool Pond::unfollow(const int32_t& user_id, const int32_t& follow_id) {
     unfollowed = true;
   }
   sqlite3_finalize(stmt);
+  const bool removed = unfollowed && sqlite3_changes(this->_db) > 0;
+
+  if (unfollowed) {
+    this->_invalidateCaches();
+    this->_indexes->follow_graph.removeFollow(user_id, follow_id);
+  }
+  if (removed) {
+    this->_indexes->engagement.recordFollow(follow_id, -1);
+    Pond::Indexes& indexes = *this->_indexes;
+    std::lock_guard<std::mutex> lock(indexes.search_lock);
+    if (indexes.search_version.isLoaded()) {
+      const std::string name = this->getUsername(follow_id);
+      indexes.user_completions.add(_completionKey(name), name, -1);
+      uint32_t& followers = indexes.indexed_users[follow_id].followers;
+      followers = followers > 0 ? followers - 1 : 0;
+    }
+  }
 
-  return unfollowed;
+  // Sketches cannot forget a follower, so drop it and let it be rebuilt on demand
+  if (unfollowed) {
+    const char* drop_query = "DELETE FROM follower_sketches WHERE usr = ?";
+    if (sqlite3_prepare_v2(this->_db, drop_query, -1, &stmt, nullptr) == SQLITE_OK) {
+      sqlite3_bind_int(stmt, 1, follow_id);
+      sqlite3_step(stmt);
+    }
+    sqlite3_finalize(stmt);
+  }
+  return this->_endWrite(own_transaction, unfollowed);
 }
 
 /**
@@ -571,11 +1318,12 @@ bool Pond::unfollow(const int32_t& user_id, const int32_t& follow_id) {
  * @return A vector of pairs containing user IDs and names that match the search terms.
  */
 std::vector<Pond::User> Pond::searchForUsers(const std::string& search_terms) {
+  PerfCounters::Scope profile(this->_profiler, "Pond::searchForUsers");
   std::vector<Pond::User> results;
 
   const char* query =
     "SELECT usr, name "
-    "FROM users "
+    "FROM live_users "
     // lower for case insensitive search
     "WHERE LOWER(name) LIKE '%' || LOWER(?) || '%' "
     "ORDER BY LENGTH(name)";
@@ -583,6 +1331,7 @@ std::vector<Pond::User> Pond::searchForUsers(const std::string& search_terms) {
   sqlite3_stmt* stmt;
   if (sqlite3_prepare_v2(this->_db, query, -1, &stmt, nullptr) != SQLITE_OK) {
     sqlite3_finalize(stmt);
+    profile.setRows(results.size());
     return results;
   }
 
@@ -598,184 +1347,394 @@ std::vector<Pond::User> Pond::searchForUsers(const std::string& search_terms) {
   }
 
   sqlite3_finalize(stmt);
+  profile.setRows(results.size());
   return results;
 }
 
 
 /**
- * @brief search for quacks containing specific keywords or hashtags.
+ * @brief Searches for users whose names approximately match the search terms.
  *
- * @param search_terms A string of keywords or hashtags to search for in quacks.
- * @return A vector of quacks that contain the specified keywords or hashtags, ordered by date and time.
+ * Every word of the search must be within `max_distance` edits of some word of a
+ * user's name. Short words tolerate fewer edits (one per three letters), so that a
+ * two-letter word does not match every name. Matches come from an in-memory sorted
+ * dictionary of the distinct name words and are ranked by total distance, then follower count.
  *
- * @note case insensitive search, space seperated keywoards
+ * @param search_terms The (possibly misspelled) name to search for.
+ * @param max_distance The most edits accepted per word.
+ * @param limit The maximum number of users to return.
+ * @return The best matching users, closest and most followed first.
  */
-std::vector<Pond::Quack> Pond::searchForQuacks(const std::string& search_terms) {
-  std::vector<Pond::Quack> results;
-  std::unordered_set<int32_t> quack_ids; // keep track of unique quack ids across searches
-
-  // Split the keyword input into individual keywords, using commas as delimiters
-  std::istringstream iss(search_terms);
-  std::vector<std::string> keywords;
-  std::string keyword;
-  while (std::getline(iss, keyword, ',')) { // specify comma as delimiter
-    keywords.push_back(keyword);
+std::vector<Pond::User> Pond::searchForUsersFuzzy(const std::string& search_terms, const uint32_t& max_distance, const uint32_t& limit) {
+  PerfCounters::Scope profile(this->_profiler, "Pond::searchForUsersFuzzy");
+  std::vector<Pond::User> results;
+  std::unique_lock<std::mutex> lock;
+  if (!this->_refreshSearchIndexes(lock)) {
+    profile.setRows(results.size());
+    return results;
   }
+  Pond::Indexes& indexes = *this->_indexes;
 
-  const char* hashtag_query =
-    "SELECT t.tid, t.writer_id, t.text, t.tdate, t.ttime, t.replyto_tid "
-    "FROM tweets t "
-    "JOIN hashtag_mentions ht ON t.tid = ht.tid "
-    "WHERE LOWER(ht.term) LIKE LOWER(?)"
-    "ORDER BY t.tdate DESC, t.ttime DESC";
+  std::string lowered = search_terms;
+  std::transform(lowered.begin(), lowered.end(), lowered.begin(), ::tolower);
 
+  std::vector<std::string> words;
+  std::istringstream iss(lowered);
+  std::string word;
+  while (iss >> word) {
+    words.push_back(word);
+  }
+  if (words.empty()) {
+    profile.setRows(results.size());
+    return results;
+  }
 
-  // Prepare to query 
-  sqlite3_stmt* stmt;
-  for (const std::string& kw : keywords) {
-    if (kw[0] == '#') {
-      // std::string hashtag = kw.substr(1);  // remove # prefix
-
-      if (sqlite3_prepare_v2(this->_db, hashtag_query, -1, &stmt, nullptr) != SQLITE_OK) {
-        sqlite3_finalize(stmt);
-        continue;
+  // user -> (search words matched so far, total distance); users drop out at the first miss
+  std::unordered_map<int32_t, std::pair<uint32_t, uint32_t>> candidates;
+  for (uint32_t w = 0; w < words.size(); ++w) {
+    const uint32_t allowed = std::min<uint32_t>(max_distance, words[w].size() / 3);
+
+    std::unordered_map<int32_t, uint32_t> closest;
+    for (const TermDictionary::Match& match : indexes.name_tokens.search(words[w], allowed)) {
+      for (const int32_t& user_id : *match.values) {
+        auto it = closest.find(user_id);
+        if (it == closest.end() || match.distance < it->second) {
+          closest[user_id] = match.distance;
+        }
       }
+    }
 
-      sqlite3_bind_text(stmt, 1, kw.c_str(), -1, SQLITE_STATIC);
-
-      // Retrieve results
-      while (sqlite3_step(stmt) == SQLITE_ROW) {
-        int32_t quack_id = sqlite3_column_int(stmt, 0);
-        if (quack_ids.find(quack_id) == quack_ids.end()) {
-          Pond::Quack quack;
-          quack.tid = quack_id;
-          quack.writer_id = sqlite3_column_int(stmt, 1);
-          quack.text = (const char*)(sqlite3_column_text(stmt, 2));
-          quack.date = (const char*)(sqlite3_column_text(stmt, 3));
-          quack.time = (const char*)(sqlite3_column_text(stmt, 4));
-          quack.replyto_tid = sqlite3_column_int(stmt, 5);
-
-          results.push_back(quack);
-          // quack_ids.insert(quack_id);
+    for (const auto& [user_id, distance] : closest) {
+      if (w == 0) {
+        candidates[user_id] = {1, distance};
+      } else {
+        auto candidate = candidates.find(user_id);
+        if (candidate != candidates.end() && candidate->second.first == w) {
+          candidate->second = {w + 1, candidate->second.second + distance};
         }
       }
-      sqlite3_finalize(stmt);
     }
+  }
 
-    else { // text keyword
-      const char *text_query =
-        "SELECT tid, writer_id, text, tdate, ttime, replyto_tid "
-        "FROM tweets "
-        "WHERE LOWER(text) LIKE '% ' || LOWER(?) || ' %' "
-        "OR LOWER(text) LIKE '% ' || LOWER(?) || ' %' "
-        "OR LOWER(text) LIKE '% ' || LOWER(?) "
-        "OR LOWER(text) LIKE '% ' || LOWER(?) "
-        "OR LOWER(text) LIKE LOWER(?) || ' %' "
-        "OR LOWER(text) LIKE LOWER(?) || ' %' "
-        "OR LOWER(text) = LOWER(?)"
-        "OR LOWER(text) = LOWER(?)"
-        "ORDER BY tdate DESC, ttime DESC";
-
-      if (sqlite3_prepare_v2(this->_db, text_query, -1, &stmt, nullptr) != SQLITE_OK) {
-        sqlite3_finalize(stmt);
-        continue;
-      }
+  struct Ranked {
+    int32_t usr;
+    uint32_t distance;
+    uint32_t followers;
+  };
+  std::vector<Ranked> ranked;
+  for (const auto& [user_id, candidate] : candidates) {
+    if (candidate.first == words.size()) {
+      ranked.push_back({user_id, candidate.second, indexes.indexed_users[user_id].followers});
+    }
+  }
 
-      // std::string kw_ht = "#"+kw;
-      sqlite3_bind_text(stmt, 1, kw.c_str(), -1, SQLITE_STATIC);
-      sqlite3_bind_text(stmt, 2, ("#"+kw).c_str(), -1, SQLITE_STATIC);
-      sqlite3_bind_text(stmt, 3, kw.c_str(), -1, SQLITE_STATIC);
-      sqlite3_bind_text(stmt, 4, ("#"+kw).c_str(), -1, SQLITE_STATIC);
-      sqlite3_bind_text(stmt, 5, kw.c_str(), -1, SQLITE_STATIC);
-      sqlite3_bind_text(stmt, 6, ("#"+kw).c_str(), -1, SQLITE_STATIC);
-      sqlite3_bind_text(stmt, 7, kw.c_str(), -1, SQLITE_STATIC);
-      sqlite3_bind_text(stmt, 8, ("#" + kw).c_str(), -1, SQLITE_STATIC);
-
-      // Retrieve results
-      while (sqlite3_step(stmt) == SQLITE_ROW) {
-        int32_t quack_id = sqlite3_column_int(stmt, 0);
-        if (quack_ids.find(quack_id) == quack_ids.end()) {
-          Quack quack;
-          quack.tid = quack_id;
-          quack.writer_id = sqlite3_column_int(stmt, 1);
-          quack.text = (const char*)(sqlite3_column_text(stmt, 2));
-          quack.date = (const char*)(sqlite3_column_text(stmt, 3));
-          quack.time = (const char*)(sqlite3_column_text(stmt, 4));
-          quack.replyto_tid = sqlite3_column_int(stmt, 5);
-
-          results.push_back(quack);
-          quack_ids.insert(quack_id);
-        }
-      }
-      sqlite3_finalize(stmt);
+  auto middle = ranked.begin() + std::min<size_t>(limit, ranked.size());
+  std::partial_sort(ranked.begin(), middle, ranked.end(), [](const Ranked& a, const Ranked& b) {
+    if (a.distance != b.distance) return a.distance < b.distance;
+    if (a.followers != b.followers) return a.followers > b.followers;
+    return a.usr < b.usr;
+  });
+
+  for (auto it = ranked.begin(); it != middle; ++it) {
+    results.push_back({it->usr, indexes.indexed_users[it->usr].name});
+  }
+  profile.setRows(results.size());
+  return results;
+}
+
+/**
+ * @brief Searches for quacks matching a query of the search language.
+ *
+ * The query is parsed by `SearchQuery` and compiled by `SearchPlanner` into a plan
+ * driven by its most selective term: see `SearchQuery` for the syntax, e.g.
+ * `#pond from:janedoe since:2024-01-01 -is:reply "rubber duck"`. A comma-separated
+ * list of keywords, as accepted by older versions, is still a valid query, with two
+ * changes in what it returns: the quacks are sorted newest first across all the
+ * keywords, where they used to come keyword by keyword, each newest first; and
+ * spaces around each keyword are trimmed, so `#nice, staff` also finds `staff`,
+ * returning 8 quacks on the test database where it used to return 2.
+ *
+ * @param search_terms The query.
+ * @return The matching quacks, newest first.
+ *
+ * @note Words match case-insensitively as whole words or hashtags. A keyword wrapped
+ *       in `*`, such as `*ack*`, matches anywhere in the text, even inside a word.
+ */
+std::vector<Pond::Quack> Pond::searchForQuacks(const std::string& search_terms) {
+  PerfCounters::Scope profile(this->_profiler, "Pond::searchForQuacks");
+  std::vector<Pond::Quack> results;
+
+  const uint64_t generation = this->_validateCaches();
+  if (this->_caches) {
+    if (std::optional<std::vector<Pond::Quack>> cached = this->_caches->searches.get(search_terms)) {
+      profile.setRows(cached->size());
+      return std::move(*cached);
     }
   }
 
+  const SearchQuery::Node query = SearchQuery::parse(search_terms);
+  SearchPlanner planner(*this);
+  const SearchPlanner::Plan plan = planner.compile(query);
+  // A failed statement leaves the results incomplete, so they are not cached
+  const bool searched_all = planner.execute(plan, results);
+
+  if (this->_caches && searched_all) {
+    this->_caches->searches.put(search_terms, results, generation);
+  }
+  profile.setRows(results.size());
+  return results;
+}
+
+/**
+ * @brief Describes how a search query would be run, without running it.
+ *
+ * Planning counts index entries and may scan the text of quacks, as a search does,
+ * but reads no rows.
+ *
+ * @param search_terms The query, as given to `searchForQuacks`.
+ * @return The plan, one step per line, with the number of quacks each step is
+ *         expected to list.
+ */
+std::string Pond::explainSearch(const std::string& search_terms) {
+  const SearchQuery::Node query = SearchQuery::parse(search_terms);
+  SearchPlanner planner(*this);
+  return SearchPlanner::explain(planner.compile(query));
+}
+
+/**
+ * @brief Searches for quacks containing a fragment of text anywhere, even inside a word.
+ *
+ * Served by scanning an in-memory copy of every quack's text in parallel rather than
+ * by SQL, which would test each row through `LIKE`. The copy is loaded on first use,
+ * kept current by the posts of every connection sharing it and reloaded when the
+ * database was changed some other way.
+ *
+ * @param fragment The text to look for; ASCII letters match either case.
+ * @param limit The most quacks to return; 0 returns every match.
+ * @return The matching quacks, newest first.
+ */
+std::vector<Pond::Quack> Pond::searchQuackText(const std::string& fragment, const size_t& limit) {
+  PerfCounters::Scope profile(this->_profiler, "Pond::searchQuackText");
+  std::vector<Pond::Quack> results = this->getQuacksFromIDs(this->_indexes->text_scan.search(this->_db, fragment, limit));
+
+  // A quack deleted by another connection since the scan has no row
+  results.erase(std::remove_if(results.begin(), results.end(), [](const Pond::Quack& quack) {
+    return quack.tid == 0;
+  }), results.end());
+  profile.setRows(results.size());
   return results;
 }
 
+/**
+ * @brief Completes a hashtag or user name prefix with its most popular matches.
+ *
+ * Completions are served from an in-memory compressed trie that is built on first use,
+ * kept current by the writes of every connection sharing it and rebuilt when the
+ * database was changed some other way.
+ *
+ * @param prefix The prefix to complete (case-insensitive; a leading `#` is optional
+ *        for hashtags).
+ * @param kind Whether to complete hashtags or user names.
+ * @param k The maximum number of completions to return.
+ * @return The completions with their popularity, most popular first.
+ */
+std::vector<PrefixIndex::Entry> Pond::complete(const std::string& prefix, const Pond::CompletionKind& kind, const uint32_t& k) {
+  std::unique_lock<std::mutex> lock;
+  if (!this->_refreshSearchIndexes(lock)) {
+    return {};
+  }
+
+  const PrefixIndex& index = kind == CompletionKind::HASHTAG ? this->_indexes->hashtag_completions : this->_indexes->user_completions;
+  return index.complete(_completionKey(prefix), k);
+}
+
 /**
  * @brief Retrieves a feed of quacks and requacks for a given user.
  *
  * @param user_id The unique identifier of the user for whom the feed is generated.
+ * @param mode Whether the feed is chronological or ranked by engagement.
  * @return A vector of strings where each string represents a formatted entry in the feed.
  */
-std::vector<std::string> Pond::getFeed(const int32_t& user_id) {
+std::vector<std::string> Pond::getFeed(const int32_t& user_id, const Pond::FeedMode& mode) {
+    PerfCounters::Scope profile(this->_profiler, "Pond::getFeed");
     std::vector<std::string> feed;
 
-    const char* query = 
+    for (const Pond::FeedEntry& entry : this->getFeedEntries(user_id, mode)) {
+        feed.push_back(this->_formatFeedEntry(entry));
+    }
+
+    profile.setRows(feed.size());
+    return feed;
+}
+
+/**
+ * @brief Retrieves the entries of a user's feed without formatting them.
+ *
+ * In `RANKED` mode, the `RANKED_FEED_WINDOW` most recent chronological entries are
+ * scored in a single query that joins the precomputed engagement counters
+ * (`quack_stats`) and the viewer's affinity with each followed user (`affinity`).
+ * The score combines recency decay (24 hour half-life), requack and reply counts,
+ * affinity and a spam penalty, and a bounded min-heap keeps the best
+ * `RANKED_FEED_SIZE` entries.
+ *
+ * @param user_id The unique identifier of the user for whom the feed is generated.
+ * @param mode Whether the feed is chronological or ranked by engagement.
+ * @return The feed entries in display order.
+ */
+std::vector<Pond::FeedEntry> Pond::getFeedEntries(const int32_t& user_id, const Pond::FeedMode& mode) {
+    PerfCounters::Scope profile(this->_profiler, "Pond::getFeedEntries");
+    std::vector<Pond::FeedEntry> feed;
+
+    const uint64_t generation = this->_validateCaches();
+    if (this->_caches) {
+        if (std::optional<std::shared_ptr<const std::vector<Pond::FeedEntry>>> cached = this->_caches->feeds.get(_feedKey(user_id, mode))) {
+            profile.setRows((*cached)->size());
+            return **cached;
+        }
+    }
+
+    const char* chronological_query =
         "SELECT 'tweet' AS type, t1.tid, u1.name, t1.writer_id, t1.tdate AS date, t1.ttime AS time, t1.text "
-        "FROM tweets t1 "
-        "JOIN follows f1 ON t1.writer_id = f1.flwee "
-        "JOIN users u1 ON t1.writer_id = u1.usr "
-        "WHERE f1.flwer = ? "
+        "FROM live_tweets t1 "
+        "JOIN follow_graph f1 ON t1.writer_id = f1.flwee "
+        "JOIN live_users u1 ON t1.writer_id = u1.usr "
+        "WHERE f1.flwer = ?1 "
         "UNION "
         "SELECT 'retweet' AS type, t2.tid, u2.name, r.retweeter_id AS writer_id, r.rdate AS date, t2.ttime AS time, t2.text "
-        "FROM retweets r "
-        "JOIN tweets t2 ON t2.tid = r.tid "
-        "JOIN follows f2 ON r.retweeter_id = f2.flwee "
-        "JOIN users u2 ON r.retweeter_id = u2.usr "
-        "WHERE f2.flwer = ? AND r.spam = 0 "
+        "FROM retweets r INDEXED BY retweets_legit "
+        "JOIN live_tweets t2 ON t2.tid = r.tid "
+        "JOIN follow_graph f2 ON r.retweeter_id = f2.flwee "
+        "JOIN live_users u2 ON r.retweeter_id = u2.usr "
+        "WHERE f2.flwer = ?1 AND r.spam = 0 "
         "ORDER BY date DESC, time DESC";
 
+    // Score features come from counters in the same query, never per candidate
+    std::string ranked_query =
+        std::string("SELECT c.type, c.tid, c.name, c.writer_id, c.date, c.time, c.text, "
+        "  (julianday('now') - julianday(c.date || ' ' || IFNULL(c.time, '00:00:00'))) * 24.0, "
+        "  IFNULL(s.requacks, 0), IFNULL(s.replies, 0), IFNULL(s.spam_requacks, 0), IFNULL(a.score, 0) "
+        "FROM (") + chronological_query + " LIMIT ?2) c "
+        "LEFT JOIN quack_stats s ON s.tid = c.tid "
+        "LEFT JOIN affinity a ON a.viewer = ?1 AND a.author = c.writer_id";
+
+    const bool ranked = mode == FeedMode::RANKED;
     sqlite3_stmt* stmt;
-    if (sqlite3_prepare_v2(this->_db, query, -1, &stmt, nullptr) != SQLITE_OK) {
+    if (sqlite3_prepare_v2(this->_db, ranked ? ranked_query.c_str() : chronological_query, -1, &stmt, nullptr) != SQLITE_OK) {
         sqlite3_finalize(stmt);
+        profile.setRows(feed.size());
         return feed;
     }
 
     sqlite3_bind_int(stmt, 1, user_id);
-    sqlite3_bind_int(stmt, 2, user_id);
-    
-    while (sqlite3_step(stmt) == SQLITE_ROW) {
-        const unsigned char* tweet_id = sqlite3_column_text(stmt, 1);  // Id of quack 
-        const unsigned char* username = sqlite3_column_text(stmt, 2);  // Username of the quack author
-        const unsigned char* date = sqlite3_column_text(stmt, 4);      // Date of quack/requack
-        const unsigned char* time = sqlite3_column_text(stmt, 5);      // Time of quack/requack
-        const unsigned char* text = sqlite3_column_text(stmt, 6);      // Text of quack/requack
+    if (ranked) {
+        sqlite3_bind_int(stmt, 2, RANKED_FEED_WINDOW);
+    }
 
-        std::ostringstream oss;
-        oss << "Quack Id: " << reinterpret_cast<const char*>(tweet_id);
-        oss << ", Author: " << (username ? reinterpret_cast<const char*>(username) : "Unknown");
-        oss << std::string(66 - oss.str().length(), ' '); 
-        oss << "Date and Time: " <<(date ? reinterpret_cast<const char*>(date) : "Unknown")
-            << " " << (time ? reinterpret_cast<const char*>(time) : "Unknown") << "\n\n";
-        oss << "Text: " <<(text ? formatTweetText(reinterpret_cast<const char*>(text), 94) : "") << "\n";
+    // Min-heap on score so the weakest of the kept entries is evicted first
+    using Scored = std::pair<double, size_t>;
+    std::vector<Scored> heap;
+    std::vector<Pond::FeedEntry> candidates;
+
+    int rc;
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        const unsigned char* type = sqlite3_column_text(stmt, 0);
+        const unsigned char* username = sqlite3_column_text(stmt, 2);
+        const unsigned char* date = sqlite3_column_text(stmt, 4);
+        const unsigned char* time = sqlite3_column_text(stmt, 5);
+        const unsigned char* text = sqlite3_column_text(stmt, 6);
+
+        Pond::FeedEntry entry;
+        entry.type = type ? reinterpret_cast<const char*>(type) : "";
+        entry.tid = sqlite3_column_int(stmt, 1);
+        entry.author = username ? reinterpret_cast<const char*>(username) : "Unknown";
+        entry.writer_id = sqlite3_column_int(stmt, 3);
+        entry.date = date ? reinterpret_cast<const char*>(date) : "Unknown";
+        entry.time = time ? reinterpret_cast<const char*>(time) : "Unknown";
+        entry.text = text ? reinterpret_cast<const char*>(text) : "";
+
+        if (!ranked) {
+            feed.push_back(entry);
+            continue;
+        }
 
-        feed.push_back(oss.str());
+        // Scores are kept in log space so old entries do not underflow to zero
+        double age_hours = std::max(0.0, sqlite3_column_double(stmt, 7));
+        double requacks = sqlite3_column_int(stmt, 8);
+        double replies = sqlite3_column_int(stmt, 9);
+        double spam = sqlite3_column_int(stmt, 10);
+        double affinity = sqlite3_column_int(stmt, 11);
+        double score = -std::log(2.0) * age_hours / 24.0
+                     + std::log1p(2.0 * requacks + replies)
+                     + 0.5 * std::log1p(affinity)
+                     - std::log1p(spam);
+
+        candidates.push_back(entry);
+        if (heap.size() < RANKED_FEED_SIZE) {
+            heap.push_back({score, candidates.size() - 1});
+            std::push_heap(heap.begin(), heap.end(), std::greater<Scored>());
+        } else if (score > heap.front().first) {
+            std::pop_heap(heap.begin(), heap.end(), std::greater<Scored>());
+            heap.back() = {score, candidates.size() - 1};
+            std::push_heap(heap.begin(), heap.end(), std::greater<Scored>());
+        }
     }
 
     sqlite3_finalize(stmt);
 
+    if (ranked) {
+        std::sort(heap.begin(), heap.end(), std::greater<Scored>());
+        for (const Scored& scored : heap) {
+            feed.push_back(std::move(candidates[scored.second]));
+        }
+    }
+
+    // An interrupted or failed query yields a partial feed, which must not be cached
+    if (this->_caches && rc == SQLITE_DONE) {
+        this->_caches->feeds.put(_feedKey(user_id, mode), std::make_shared<const std::vector<Pond::FeedEntry>>(feed), generation);
+    }
+    profile.setRows(feed.size());
     return feed;
 }
 
+/**
+ * @brief Retrieves one page of a user's feed.
+ *
+ * The whole feed is produced (or found in the feed cache) as by `getFeedEntries`, but
+ * only the requested entries are copied out, so paging through a cached feed costs
+ * one page of copies per call.
+ *
+ * @param user_id The unique identifier of the user for whom the feed is generated.
+ * @param mode Whether the feed is chronological or ranked by engagement.
+ * @param offset The index of the first entry of the page.
+ * @param count The maximum number of entries in the page.
+ * @param total Receives the number of entries in the whole feed.
+ * @return The entries of the page in display order.
+ */
+std::vector<Pond::FeedEntry> Pond::getFeedPage(const int32_t& user_id, const Pond::FeedMode& mode, const size_t& offset, const size_t& count, size_t& total) {
+    std::shared_ptr<const std::vector<Pond::FeedEntry>> feed;
+
+    this->_validateCaches();
+    if (this->_caches) {
+        if (std::optional<std::shared_ptr<const std::vector<Pond::FeedEntry>>> cached = this->_caches->feeds.get(_feedKey(user_id, mode))) {
+            feed = *cached;
+        }
+    }
+    if (!feed) {
+        feed = std::make_shared<const std::vector<Pond::FeedEntry>>(this->getFeedEntries(user_id, mode));
+    }
+
+    total = feed->size();
+    const size_t begin = std::min(offset, feed->size());
+    const size_t end = begin + std::min(count, feed->size() - begin);
+    return std::vector<Pond::FeedEntry>(feed->begin() + begin, feed->begin() + end);
+}
+
 uint32_t Pond::getRequackCount(const int32_t& quack_id) {
   uint32_t requack_count = 0;
 
   const char *query =
     "SELECT COUNT(tid) "
-    "FROM retweets "
+    "FROM live_retweets "
     "WHERE tid = ?";
 
   sqlite3_stmt *stmt;
@@ -800,7 +1759,7 @@ std::vector<int32_t> Pond::getReplies(const int32_t& quack_id) {
 
   const char* query =
     "SELECT tid "
-    "FROM tweets "
+    "FROM live_tweets "
     "WHERE replyto_tid = ?";
 
   sqlite3_stmt* stmt;
@@ -821,215 +1780,2442 @@ std::vector<int32_t> Pond::getReplies(const int32_t& quack_id) {
 }
 
 /**
- * @brief Retrieves the username associated with a given user ID from the database.
+ * @brief Retrieves the estimated unique reach and cascade depth of a quack.
  *
- * This function prepares an SQL statement to query the username of a specific user
- * from the `users` table using the provided user ID. If a matching user ID is found,
- * it retrieves the `name` column as the username. If no match is found or an error occurs,
- * it returns an empty string.
+ * The reach sketch is maintained incrementally by `addRequack`. Quacks requacked
+ * before reach tracking existed have no sketch yet; theirs is worked out on each read
+ * by replaying their requacks in date order, without writing it, and stored by their
+ * next requack.
  *
- * @param user_id The unique identifier of the user whose username is being retrieved.
- * @return A std::string containing the username if found, otherwise an empty string.
+ * @param quack_id The unique ID of the quack.
+ * @return A `Pond::Reach` with the estimated number of distinct users who could see the
+ *         quack and the deepest requack chain; zeros if the quack does not exist.
  */
-std::string Pond::getUsername(const int32_t& user_id) {
-  std::string username;
-  
+Pond::Reach Pond::getReach(const int32_t& quack_id) {
+  Pond::Reach reach = {0, 0};
+
   const char* query =
-    "SELECT name "
-    "FROM users "
-    "WHERE usr = ?";
+    "SELECT sketch, max_depth "
+    "FROM quack_reach "
+    "WHERE tid = ?";
 
   sqlite3_stmt* stmt;
   if (sqlite3_prepare_v2(this->_db, query, -1, &stmt, nullptr) != SQLITE_OK) {
     sqlite3_finalize(stmt);
-    return "";
+    return reach;
   }
 
-  sqlite3_bind_int(stmt, 1, user_id);
+  sqlite3_bind_int(stmt, 1, quack_id);
 
-  if (sqlite3_step(stmt) == SQLITE_ROW) {
-    const unsigned char* retrieved_username = sqlite3_column_text(stmt, 0);
-    if (retrieved_username != nullptr) {
-      username = reinterpret_cast<const char*>(retrieved_username);
-    }
-    else username = "";
+  HyperLogLog sketch;
+  uint32_t depth = 0;
+  bool found = false;
+  if (sqlite3_step(stmt) == SQLITE_ROW &&
+      sketch.fromBytes(sqlite3_column_blob(stmt, 0), sqlite3_column_bytes(stmt, 0))) {
+    depth = sqlite3_column_int(stmt, 1);
+    found = true;
   }
+  sqlite3_finalize(stmt);
+
+  if (found || this->_buildReach(quack_id, sketch, depth, false)) {
+    reach.estimated_reach = sketch.estimate();
+    reach.cascade_depth = depth;
+  }
+  return reach;
+}
+
+/**
+ * @brief Retrieves the quacks with the most engagement over a rolling window.
+ *
+ * Served from in-memory leaderboards kept current by `addRequack` and `addReply`.
+ *
+ * @param metric What to rank by: requacks or replies received.
+ * @param window The rolling window.
+ * @param count The number of quacks.
+ * @return Up to `count` quack IDs with their totals, highest first.
+ */
+std::vector<Leaderboard::Entry> Pond::getTopQuacks(
+  const EngagementBoards::Metric& metric,
+  const EngagementBoards::Window& window,
+  const size_t& count
+) {
+  PerfCounters::Scope profile(this->_profiler, "Pond::getTopQuacks");
+  return this->_indexes->engagement.topQuacks(this->_db, metric, window, count);
+}
+
+/**
+ * @brief Retrieves the accounts with the most engagement over a rolling window.
+ *
+ * Served from in-memory leaderboards kept current by `addRequack`, `addReply`,
+ * `follow` and `unfollow`.
+ *
+ * @param metric What to rank by: requacks or replies their quacks received, or
+ *               followers gained.
+ * @param window The rolling window.
+ * @param count The number of accounts.
+ * @return Up to `count` user IDs with their totals, highest first.
+ */
+std::vector<Leaderboard::Entry> Pond::getTopAccounts(
+  const EngagementBoards::Metric& metric,
+  const EngagementBoards::Window& window,
+  const size_t& count
+) {
+  PerfCounters::Scope profile(this->_profiler, "Pond::getTopAccounts");
+  return this->_indexes->engagement.topAccounts(this->_db, metric, window, count);
+}
+
+/**
+ * @brief Retrieves the rank of a quack on a leaderboard.
+ *
+ * @param quack_id The unique ID of the quack.
+ * @param metric What to rank by.
+ * @param window The rolling window.
+ * @return The 1-based rank, or 0 if the quack had no such engagement in the window.
+ */
+size_t Pond::getQuackRank(
+  const int32_t& quack_id,
+  const EngagementBoards::Metric& metric,
+  const EngagementBoards::Window& window
+) {
+  return this->_indexes->engagement.quackRank(this->_db, quack_id, metric, window);
+}
+
+/**
+ * @brief Retrieves the rank of an account on a leaderboard.
+ *
+ * @param user_id The unique ID of the user.
+ * @param metric What to rank by.
+ * @param window The rolling window.
+ * @return The 1-based rank, or 0 if the account had no such engagement in the window.
+ */
+size_t Pond::getAccountRank(
+  const int32_t& user_id,
+  const EngagementBoards::Metric& metric,
+  const EngagementBoards::Window& window
+) {
+  return this->_indexes->engagement.accountRank(this->_db, user_id, metric, window);
+}
+
+/**
+ * @brief Counts an activity over an arbitrary range of hours.
+ *
+ * The range is split into at most five aligned segments (leading hours, leading days,
+ * whole months, trailing days, trailing hours), each answered by one range read of the
+ * rollup table. The cost depends on the length of the range, never on the amount of
+ * data in the base tables.
+ *
+ * @param activity The kind of activity to count.
+ * @param from Inclusive start, as `YYYY-MM-DD` or `YYYY-MM-DD HH` (GMT).
+ * @param to Exclusive end, as `YYYY-MM-DD` or `YYYY-MM-DD HH` (GMT).
+ * @return The number of events in the range; 0 if the bounds are malformed.
+ */
+uint64_t Pond::getActivityCount(const Pond::Activity& activity, const std::string& from, const std::string& to) {
+  uint64_t total = 0;
+
+  // Normalize both bounds to hour bucket keys (YYYY-MM-DD HH)
+  auto to_hour = [](const std::string& bound) -> std::string {
+    if (bound.size() == 10) return bound + " 00";
+    if (bound.size() == 13) return bound;
+    return "";
+  };
+  // Day after a YYYY-MM-DD key
+  auto next_day = [](const std::string& day) -> std::string {
+    std::tm tm = {};
+    if (std::sscanf(day.c_str(), "%d-%d-%d", &tm.tm_year, &tm.tm_mon, &tm.tm_mday) != 3) return day;
+    tm.tm_year -= 1900;
+    tm.tm_mon -= 1;
+    std::time_t next = timegm(&tm) + 24 * 60 * 60;
+    std::tm next_tm;
+    char buffer[11];
+    std::strftime(buffer, sizeof(buffer), "%F", gmtime_r(&next, &next_tm));
+    return buffer;
+  };
+  // Month after a YYYY-MM key
+  auto next_month = [](const std::string& month) -> std::string {
+    int year = 0, mon = 0;
+    if (std::sscanf(month.c_str(), "%d-%d", &year, &mon) != 2) return month;
+    if (++mon > 12) { mon = 1; ++year; }
+    char buffer[16];
+    std::snprintf(buffer, sizeof(buffer), "%04d-%02d", year, mon);
+    return buffer;
+  };
+
+  const std::string start = to_hour(from);
+  const std::string end = to_hour(to);
+  if (start.empty() || end.empty() || start >= end) {
+    return total;
+  }
+
+  const std::string start_day = start.substr(0, 10);
+  const std::string end_day = end.substr(0, 10);
+  if (start_day == end_day) {
+    this->_sumActivity(activity, Granularity::HOUR, start, end, total);
+    return total;
+  }
+
+  // Leading and trailing partial days come from hour buckets
+  std::string first_day = start_day;
+  if (start.substr(11) != "00") {
+    first_day = next_day(start_day);
+    this->_sumActivity(activity, Granularity::HOUR, start, first_day + " 00", total);
+  }
+  this->_sumActivity(activity, Granularity::HOUR, end_day + " 00", end, total);
+
+  if (first_day >= end_day) {
+    return total;
+  }
+
+  // Whole days in between, using month buckets for every whole month
+  const std::string end_month = end_day.substr(0, 7);
+  if (first_day.substr(0, 7) == end_month) {
+    this->_sumActivity(activity, Granularity::DAY, first_day, end_day, total);
+    return total;
+  }
+
+  std::string first_month = first_day.substr(0, 7);
+  if (first_day.substr(8) != "01") {
+    first_month = next_month(first_month);
+    this->_sumActivity(activity, Granularity::DAY, first_day, first_month + "-01", total);
+  }
+  this->_sumActivity(activity, Granularity::MONTH, first_month, end_month, total);
+  this->_sumActivity(activity, Granularity::DAY, end_month + "-01", end_day, total);
+
+  return total;
+}
+
+/**
+ * @brief Retrieves the non-empty buckets of an activity between two bucket keys.
+ *
+ * @param activity The kind of activity to read.
+ * @param granularity The bucket size to read.
+ * @param from Inclusive first bucket key.
+ * @param to Exclusive last bucket key.
+ * @return The buckets in ascending order.
+ */
+std::vector<Pond::ActivityBucket> Pond::getActivitySeries(const Pond::Activity& activity, const Pond::Granularity& granularity, const std::string& from, const std::string& to) {
+  std::vector<Pond::ActivityBucket> results;
+
+  const char* query =
+    "SELECT bucket, count "
+    "FROM activity_rollups "
+    "WHERE granularity = ? AND metric = ? AND bucket >= ? AND bucket < ? "
+    "ORDER BY bucket";
+
+  sqlite3_stmt* stmt;
+  if (sqlite3_prepare_v2(this->_db, query, -1, &stmt, nullptr) != SQLITE_OK) {
+    sqlite3_finalize(stmt);
+    return results;
+  }
+
+  sqlite3_bind_int(stmt, 1, static_cast<int>(granularity));
+  sqlite3_bind_text(stmt, 2, _activityName(activity), -1, SQLITE_STATIC);
+  sqlite3_bind_text(stmt, 3, from.c_str(), -1, SQLITE_STATIC);
+  sqlite3_bind_text(stmt, 4, to.c_str(), -1, SQLITE_STATIC);
+
+  while (sqlite3_step(stmt) == SQLITE_ROW) {
+    Pond::ActivityBucket bucket;
+    bucket.bucket = (const char*)sqlite3_column_text(stmt, 0);
+    bucket.count = sqlite3_column_int64(stmt, 1);
+    results.push_back(bucket);
+  }
+
+  sqlite3_finalize(stmt);
+  return results;
+}
+
+/**
+ * @brief Rebuilds the activity rollups from the base tables.
+ *
+ * Quacks, replies and hashtag mentions are bucketed by hour, day and month. Requacks,
+ * spam requacks and follows only carry a date, so they are backfilled into day and
+ * month buckets; their hour buckets, recorded live, are kept. Users have no creation
+ * date, so new-user counts are only ever recorded live and are left untouched. Runs in
+ * a single write, or inside the caller's transaction.
+ *
+ * @return true if the rollups were rebuilt; false otherwise.
+ */
+bool Pond::backfillActivity() {
+  // metric, date column, time column (or nullptr), source, count
+  struct Source {
+    Activity activity;
+    const char* date;
+    const char* time;
+    const char* from;
+    const char* count;
+  };
+  // Spam requacks past retention only survive as counts in the ledger
+  const Source sources[] = {
+    {Activity::QUACKS, "tdate", "ttime", "tweets WHERE IFNULL(replyto_tid, 0) = 0", "COUNT(*)"},
+    {Activity::REPLIES, "tdate", "ttime", "tweets WHERE IFNULL(replyto_tid, 0) != 0", "COUNT(*)"},
+    {Activity::HASHTAG_MENTIONS, "t.tdate", "t.ttime", "hashtag_mentions h JOIN tweets t ON t.tid = h.tid", "COUNT(*)"},
+    {Activity::REQUACKS, "rdate", nullptr,
+     "(SELECT rdate, 1 AS n FROM retweets UNION ALL SELECT day, requacks FROM spam_ledger)", "SUM(n)"},
+    {Activity::SPAM_REQUACKS, "rdate", nullptr,
+     "(SELECT rdate, 1 AS n FROM retweets WHERE spam = 1 UNION ALL SELECT day, requacks FROM spam_ledger)", "SUM(n)"},
+    {Activity::FOLLOWS, "start_date", nullptr, "follows", "COUNT(*)"},
+  };
+
+  bool own_transaction;
+  if (!this->_beginWrite(own_transaction)) {
+    return false;
+  }
+
+  bool ok = true;
+  for (const Source& source : sources) {
+    const char* metric = _activityName(source.activity);
+    std::string date = std::string("substr(") + source.date + ", 1, 10)";
+
+    std::vector<std::pair<Granularity, std::string>> buckets = {
+      {Granularity::DAY, date},
+      {Granularity::MONTH, std::string("substr(") + source.date + ", 1, 7)"},
+    };
+    if (source.time) {
+      buckets.push_back({Granularity::HOUR, date + " || ' ' || substr(" + source.time + ", 1, 2)"});
+    }
+
+    // Only the granularities rebuilt here are cleared; hour buckets of date-only metrics
+    // were recorded live and cannot be rebuilt
+    for (const auto& [granularity, key] : buckets) {
+      const std::string queries[] = {
+        "DELETE FROM activity_rollups WHERE metric = ?1 AND granularity = ?2",
+        "INSERT INTO activity_rollups (granularity, bucket, metric, count) "
+        "SELECT ?2, " + key + ", ?1, " + source.count + " "
+        "FROM " + source.from + " "
+        "GROUP BY 2",
+      };
+      for (const std::string& query : queries) {
+        sqlite3_stmt* stmt;
+        ok = sqlite3_prepare_v2(this->_db, query.c_str(), -1, &stmt, nullptr) == SQLITE_OK;
+        if (ok) {
+          sqlite3_bind_text(stmt, 1, metric, -1, SQLITE_STATIC);
+          sqlite3_bind_int(stmt, 2, static_cast<int>(granularity));
+          ok = sqlite3_step(stmt) == SQLITE_DONE;
+        }
+        if (!ok) {
+          std::cerr << "SQL Error (backfill " << metric << "): " << sqlite3_errmsg(this->_db) << std::endl;
+        }
+        sqlite3_finalize(stmt);
+        if (!ok) {
+          break;
+        }
+      }
+      if (!ok) {
+        break;
+      }
+    }
+    if (!ok) {
+      break;
+    }
+  }
+
+  return this->_endWrite(own_transaction, ok);
+}
+
+/**
+ * @brief Folds requacks flagged as spam longer ago than the retention period into the
+ *        spam ledger and deletes them.
+ *
+ * Retention is measured from when a requack was flagged, so a requack repeated long
+ * after it was made is still kept for the whole period; requacks flagged before
+ * `flagged_at` was recorded are measured from the day they were made. The ledger keeps,
+ * per requacker, author and day, how many requacks were flagged. Rows are moved in
+ * batches of `batch_size`, each in its own transaction, so other sessions can write
+ * between batches. Engagement counters and activity rollups already count the moved
+ * requacks and are left as they are. Once its spam row is gone, the same user
+ * requacking the quack again starts a new requack.
+ *
+ * @param retention_days Days since flagging past which spam requacks are moved.
+ * @param batch_size Maximum number of requacks moved per transaction.
+ * @return The number of requacks moved, or -1 if a batch failed.
+ */
+int64_t Pond::pruneSpamRequacks(const uint32_t& retention_days, const uint32_t& batch_size) {
+  const char* batch_query =
+    "CREATE TEMP TABLE IF NOT EXISTS spam_batch (rid integer PRIMARY KEY);"
+    "DELETE FROM temp.spam_batch;";
+  const char* select_query =
+    "INSERT INTO temp.spam_batch "
+    "SELECT rowid FROM retweets INDEXED BY retweets_flagged "
+    "WHERE spam = 1 AND IFNULL(flagged_at, rdate) < datetime('now', '-' || ?1 || ' days') "
+    "ORDER BY IFNULL(flagged_at, rdate) "
+    "LIMIT ?2";
+  const char* ledger_query =
+    "INSERT INTO spam_ledger (retweeter_id, writer_id, day, requacks) "
+    "SELECT retweeter_id, writer_id, substr(rdate, 1, 10), COUNT(*) "
+    "FROM retweets WHERE rowid IN temp.spam_batch "
+    "GROUP BY 1, 2, 3 "
+    "ON CONFLICT (retweeter_id, writer_id, day) DO UPDATE SET "
+    "  requacks = requacks + excluded.requacks";
+  const char* delete_query =
+    "DELETE FROM retweets WHERE rowid IN temp.spam_batch";
+
+  auto run = [&](const char* query, const bool& bind) {
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(this->_db, query, -1, &stmt, nullptr) != SQLITE_OK) {
+      std::cerr << "SQL Error (prune spam): " << sqlite3_errmsg(this->_db) << std::endl;
+      sqlite3_finalize(stmt);
+      return false;
+    }
+    if (bind) {
+      sqlite3_bind_int(stmt, 1, retention_days);
+      sqlite3_bind_int(stmt, 2, batch_size);
+    }
+    const bool done = sqlite3_step(stmt) == SQLITE_DONE;
+    if (!done) {
+      std::cerr << "SQL Error (prune spam): " << sqlite3_errmsg(this->_db) << std::endl;
+    }
+    sqlite3_finalize(stmt);
+    return done;
+  };
+
+  int64_t moved = 0;
+  while (true) {
+    bool own_transaction;
+    if (!this->_beginWrite(own_transaction)) {
+      return -1;
+    }
+    bool ok = sqlite3_exec(this->_db, batch_query, nullptr, nullptr, nullptr) == SQLITE_OK &&
+              run(select_query, true);
+    const int batch = ok ? sqlite3_changes(this->_db) : 0;
+    ok = ok && (batch == 0 || (run(ledger_query, false) && run(delete_query, false)));
+    if (!this->_endWrite(own_transaction, ok)) {
+      return -1;
+    }
+    if (batch == 0) {
+      break;
+    }
+    moved += batch;
+    this->_invalidateCaches();
+  }
+  return moved;
+}
+
+/**
+ * @brief Removes rows of deleted quacks, users and lists in one short transaction.
+ *
+ * Each deletion is purged in steps, one dependent table at a time, ending with the
+ * deleted row and its tombstone. A step selects up to the rows still allowed into
+ * `temp.purge_batch`, adjusts whatever counts them (reply and requack counters,
+ * follower sketches, the follow graph) and deletes them, so a step cut short by the
+ * batch limit simply continues in the next transaction. Replies and a user's quacks are
+ * not deleted by their parent's steps but get tombstones of their own, since they have
+ * dependents too; quacks are purged first, so a user's quacks go before the user.
+ *
+ * Deletions are worked through oldest first, quacks before users and lists. The
+ * transaction commits once it has removed `max_rows` rows or run for `max_time`, so
+ * other sessions never wait long for the write lock; call it again until it returns 0.
+ *
+ * @param max_rows Maximum number of rows to remove.
+ * @param max_time Time after which the transaction commits.
+ * @return The number of rows removed, 0 once no deletion is left to purge, or -1 if
+ *         the transaction failed.
+ */
+int64_t Pond::purgeDeleted(const uint32_t& max_rows, const std::chrono::milliseconds& max_time) {
+  // ?1 is the deleted ID, ?2 the list name, ?3 the rows still allowed, ?4 the kind
+  struct Step {
+    const char* table;
+    const char* where;
+    const char* adjust;   // run on the selected rows first, or nullptr
+    bool remove;          // false when `adjust` tombstones the rows instead
+  };
+  // Tombstoned quacks leave the unread counts as any deleted quack does
+  const std::string mark_quacks =
+    hideNotificationsQuery("n.tid IN (SELECT tid FROM tweets WHERE rowid IN temp.purge_batch)") + "; "
+    "INSERT OR IGNORE INTO tombstones (kind, id, lname, deleted_at) "
+    "SELECT 0, tid, '', datetime('now') FROM tweets WHERE rowid IN temp.purge_batch";
+  const Step tombstone = {"tombstones", "kind = ?4 AND id = ?1 AND lname = ?2", nullptr, true};
+
+  const std::vector<Step> quack_steps = {
+    {"tweets", "replyto_tid = ?1 AND tid NOT IN (SELECT id FROM tombstones WHERE kind = 0)", mark_quacks.c_str(), false},
+    {"retweets", "tid = ?1", nullptr, true},
+    {"requack_cascades", "tid = ?1", nullptr, true},
+    {"hashtag_mentions", "tid = ?1", nullptr, true},
+    {"include", "tid = ?1", nullptr, true},
+    {"mentions", "tid = ?1", nullptr, true},
+    {"notifications", "tid = ?1", nullptr, true},
+    {"quack_stats", "tid = ?1", nullptr, true},
+    {"quack_reach", "tid = ?1", nullptr, true},
+    {"tweets", "tid = ?1",
+     "UPDATE quack_stats SET replies = MAX(replies - 1, 0) "
+     "WHERE tid IN (SELECT replyto_tid FROM tweets WHERE rowid IN temp.purge_batch)", true},
+    tombstone,
+  };
+  const std::vector<Step> user_steps = {
+    {"tweets", "writer_id = ?1 AND tid NOT IN (SELECT id FROM tombstones WHERE kind = 0)", mark_quacks.c_str(), false},
+    {"retweets", "retweeter_id = ?1",
+     "UPDATE quack_stats SET "
+     "  requacks = MAX(requacks - (SELECT COUNT(*) FROM retweets r "
+     "    WHERE r.rowid IN temp.purge_batch AND r.tid = quack_stats.tid AND r.spam = 0), 0), "
+     "  spam_requacks = MAX(spam_requacks - (SELECT COUNT(*) FROM retweets r "
+     "    WHERE r.rowid IN temp.purge_batch AND r.tid = quack_stats.tid AND r.spam = 1), 0) "
+     "WHERE tid IN (SELECT tid FROM retweets WHERE rowid IN temp.purge_batch)", true},
+    {"requack_cascades", "retweeter_id = ?1", nullptr, true},
+    // Sketches cannot forget a follower; see unfollow
+    {"follows", "flwer = ?1",
+     "DELETE FROM follower_sketches "
+     "WHERE usr IN (SELECT flwee FROM follows WHERE rowid IN temp.purge_batch)", true},
+    {"follows", "flwee = ?1", nullptr, true},
+    {"include", "owner_id = ?1", nullptr, true},
+    {"lists", "owner_id = ?1", nullptr, true},
+    {"mentions", "usr = ?1", nullptr, true},
+    {"notifications", "usr = ?1", nullptr, true},
+    {"notifications", "actor = ?1", nullptr, true},
+    {"notification_state", "usr = ?1", nullptr, true},
+    {"affinity", "viewer = ?1", nullptr, true},
+    {"affinity", "author = ?1", nullptr, true},
+    {"follower_sketches", "usr = ?1", nullptr, true},
+    {"users", "usr = ?1", nullptr, true},
+    tombstone,
+  };
+  const std::vector<Step> list_steps = {
+    {"include", "owner_id = ?1 AND lname = ?2", nullptr, true},
+    {"lists", "owner_id = ?1 AND lname = ?2", nullptr, true},
+    tombstone,
+  };
+
+  auto run = [&](const std::string& query, const int32_t& id, const std::string& list_name,
+                 const int64_t& allowed, const int& kind) {
+    // A query may hold several statements, run in order
+    const char* next = query.c_str();
+    while (*next) {
+      sqlite3_stmt* stmt;
+      if (sqlite3_prepare_v2(this->_db, next, -1, &stmt, &next) != SQLITE_OK) {
+        std::cerr << "SQL Error (purge): " << sqlite3_errmsg(this->_db) << std::endl;
+        sqlite3_finalize(stmt);
+        return false;
+      }
+      if (!stmt) {
+        continue;
+      }
+      // Statements that do not use a parameter reject its binding harmlessly
+      sqlite3_bind_int(stmt, 1, id);
+      sqlite3_bind_text(stmt, 2, list_name.c_str(), -1, SQLITE_STATIC);
+      sqlite3_bind_int64(stmt, 3, allowed);
+      sqlite3_bind_int(stmt, 4, kind);
+      const bool done = sqlite3_step(stmt) == SQLITE_DONE;
+      if (!done) {
+        std::cerr << "SQL Error (purge): " << sqlite3_errmsg(this->_db) << std::endl;
+      }
+      sqlite3_finalize(stmt);
+      if (!done) {
+        return false;
+      }
+    }
+    return true;
+  };
+
+  // Purged follows leave the follow graph and the search indexes' follower counts the
+  // way an unfollow does, so neither is rebuilt; the other indexes only ever read
+  // through the live views, which hid the purged rows at deletion
+  auto unindex_follows = [&]() {
+    const char* query =
+      "SELECT f.flwer, f.flwee, u.name FROM follows f "
+      "LEFT JOIN live_users u ON u.usr = f.flwee "
+      "WHERE f.rowid IN temp.purge_batch";
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(this->_db, query, -1, &stmt, nullptr) != SQLITE_OK) {
+      std::cerr << "SQL Error (purge): " << sqlite3_errmsg(this->_db) << std::endl;
+      sqlite3_finalize(stmt);
+      return false;
+    }
+    std::vector<std::pair<int32_t, int32_t>> edges;
+    std::vector<std::pair<int32_t, std::string>> followees;
+    int rc;
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+      edges.push_back({sqlite3_column_int(stmt, 0), sqlite3_column_int(stmt, 1)});
+      const unsigned char* name = sqlite3_column_text(stmt, 2);
+      if (name) {
+        followees.push_back({sqlite3_column_int(stmt, 1), reinterpret_cast<const char*>(name)});
+      }
+    }
+    sqlite3_finalize(stmt);
+    if (rc != SQLITE_DONE) {
+      return false;
+    }
+
+    Pond::Indexes& indexes = *this->_indexes;
+    for (const auto& [follower_id, followee_id] : edges) {
+      indexes.follow_graph.removeFollow(follower_id, followee_id);
+    }
+    std::lock_guard<std::mutex> lock(indexes.search_lock);
+    if (indexes.search_version.isLoaded()) {
+      for (const auto& [followee_id, name] : followees) {
+        indexes.user_completions.add(_completionKey(name), name, -1);
+        uint32_t& followers = indexes.indexed_users[followee_id].followers;
+        followers = followers > 0 ? followers - 1 : 0;
+      }
+    }
+    return true;
+  };
+
+  const auto deadline = std::chrono::steady_clock::now() + max_time;
+  bool own_transaction;
+  if (!this->_beginWrite(own_transaction)) {
+    return -1;
+  }
+  bool ok = sqlite3_exec(this->_db, "CREATE TEMP TABLE IF NOT EXISTS purge_batch (rid integer PRIMARY KEY)",
+                         nullptr, nullptr, nullptr) == SQLITE_OK;
+
+  int64_t removed = 0;
+  bool full = false;
+  while (ok && !full && removed < max_rows && std::chrono::steady_clock::now() < deadline) {
+    const char* next_query =
+      "SELECT kind, id, lname FROM tombstones ORDER BY kind, rowid LIMIT 1";
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(this->_db, next_query, -1, &stmt, nullptr) != SQLITE_OK) {
+      sqlite3_finalize(stmt);
+      ok = false;
+      break;
+    }
+    const int step_result = sqlite3_step(stmt);
+    if (step_result != SQLITE_ROW) {
+      ok = step_result == SQLITE_DONE;
+      sqlite3_finalize(stmt);
+      break;
+    }
+    const int kind = sqlite3_column_int(stmt, 0);
+    const int32_t id = sqlite3_column_int(stmt, 1);
+    const unsigned char* lname = sqlite3_column_text(stmt, 2);
+    const std::string list_name = lname ? reinterpret_cast<const char*>(lname) : "";
+    sqlite3_finalize(stmt);
+
+    const std::vector<Step>& steps = kind == static_cast<int>(DeletedKind::QUACK) ? quack_steps
+                                   : kind == static_cast<int>(DeletedKind::USER) ? user_steps
+                                   : list_steps;
+    for (const Step& step : steps) {
+      const int64_t allowed = static_cast<int64_t>(max_rows) - removed;
+      ok = sqlite3_exec(this->_db, "DELETE FROM temp.purge_batch", nullptr, nullptr, nullptr) == SQLITE_OK &&
+           run(std::string("INSERT INTO temp.purge_batch SELECT rowid FROM ") + step.table +
+               " WHERE " + step.where + " LIMIT ?3", id, list_name, allowed, kind);
+      if (!ok) {
+        break;
+      }
+      const int64_t selected = sqlite3_changes(this->_db);
+      if (selected == 0) {
+        continue;
+      }
+      ok = (!step.adjust || run(step.adjust, id, list_name, allowed, kind)) &&
+           (std::string(step.table) != "follows" || unindex_follows()) &&
+           (!step.remove || run(std::string("DELETE FROM ") + step.table + " WHERE rowid IN temp.purge_batch",
+                                id, list_name, allowed, kind));
+      removed += selected;
+
+      // A full batch may have left rows behind; the next transaction continues here
+      if (!ok || selected == allowed || std::chrono::steady_clock::now() >= deadline) {
+        full = true;
+        break;
+      }
+    }
+  }
+
+  if (!this->_endWrite(own_transaction, ok)) {
+    return -1;
+  }
+  if (removed > 0) {
+    this->_invalidateCaches();
+  }
+  return removed;
+}
+
+/**
+ * @brief Retrieves the quacks that mention a user, newest first.
+ *
+ * @param user_id The unique ID of the mentioned user.
+ * @return The IDs of the mentioning quacks.
+ */
+std::vector<int32_t> Pond::getMentions(const int32_t& user_id) {
+  std::vector<int32_t> mentions;
+
+  const char* query =
+    "SELECT m.tid FROM mentions m "
+    "JOIN live_tweets t ON t.tid = m.tid "
+    "WHERE m.usr = ? "
+    "ORDER BY m.tid DESC";
+
+  sqlite3_stmt* stmt;
+  if (sqlite3_prepare_v2(this->_db, query, -1, &stmt, nullptr) != SQLITE_OK) {
+    sqlite3_finalize(stmt);
+    return mentions;
+  }
+
+  sqlite3_bind_int(stmt, 1, user_id);
+
+  while (sqlite3_step(stmt) == SQLITE_ROW) {
+    mentions.push_back(sqlite3_column_int(stmt, 0));
+  }
+  sqlite3_finalize(stmt);
+
+  return mentions;
+}
+
+/**
+ * @brief Retrieves one page of a user's notifications, newest first.
+ *
+ * Pages are addressed by cursor rather than offset: pass the `nid` of the last
+ * notification of the previous page as `before` to read the next one. Each page is a
+ * single range read of the inbox index.
+ *
+ * @param user_id The unique ID of the user.
+ * @param before Only notifications older than this `nid` are returned; 0 starts at the
+ *        newest notification.
+ * @param limit The maximum number of notifications to return.
+ * @return The notifications of the page; empty once the inbox is exhausted.
+ */
+std::vector<Pond::Notification> Pond::getNotifications(const int32_t& user_id, const int64_t& before, const uint32_t& limit) {
+  PerfCounters::Scope profile(this->_profiler, "Pond::getNotifications");
+  std::vector<Pond::Notification> notifications;
+
+  const char* query =
+    "SELECT n.nid, n.kind, n.actor, n.actor_name, n.tid, n.snippet, n.ndate, n.ntime, "
+    "       n.nid > IFNULL(s.last_read, 0) "
+    "FROM live_notifications n "
+    "LEFT JOIN notification_state s ON s.usr = n.usr "
+    "WHERE n.usr = ? AND n.nid < ? "
+    "ORDER BY n.nid DESC "
+    "LIMIT ?";
+
+  sqlite3_stmt* stmt;
+  if (sqlite3_prepare_v2(this->_db, query, -1, &stmt, nullptr) != SQLITE_OK) {
+    sqlite3_finalize(stmt);
+    profile.setRows(notifications.size());
+    return notifications;
+  }
+
+  sqlite3_bind_int(stmt, 1, user_id);
+  sqlite3_bind_int64(stmt, 2, before > 0 ? before : INT64_MAX);
+  sqlite3_bind_int(stmt, 3, limit);
+
+  while (sqlite3_step(stmt) == SQLITE_ROW) {
+    Pond::Notification notification;
+    notification.nid = sqlite3_column_int64(stmt, 0);
+    notification.kind = static_cast<Pond::NotificationKind>(sqlite3_column_int(stmt, 1));
+    notification.actor = sqlite3_column_int(stmt, 2);
+    notification.actor_name = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 3));
+    notification.tid = sqlite3_column_int(stmt, 4);
+    notification.snippet = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 5));
+    notification.date = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 6));
+    notification.time = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 7));
+    notification.unread = sqlite3_column_int(stmt, 8) != 0;
+    notifications.push_back(notification);
+  }
+  sqlite3_finalize(stmt);
+
+  profile.setRows(notifications.size());
+  return notifications;
+}
+
+/**
+ * @brief Retrieves the number of notifications a user has not read yet.
+ *
+ * @param user_id The unique ID of the user.
+ * @return The unread count; 0 if the user has never been notified.
+ */
+uint32_t Pond::getUnreadNotificationCount(const int32_t& user_id) {
+  uint32_t unread = 0;
+
+  const char* query =
+    "SELECT unread FROM notification_state "
+    "WHERE usr = ?";
+
+  sqlite3_stmt* stmt;
+  if (sqlite3_prepare_v2(this->_db, query, -1, &stmt, nullptr) != SQLITE_OK) {
+    sqlite3_finalize(stmt);
+    return unread;
+  }
+
+  sqlite3_bind_int(stmt, 1, user_id);
+
+  if (sqlite3_step(stmt) == SQLITE_ROW) {
+    unread = sqlite3_column_int(stmt, 0);
+  }
+  sqlite3_finalize(stmt);
+
+  return unread;
+}
+
+/**
+ * @brief Marks every notification currently in a user's inbox as read.
+ *
+ * @param user_id The unique ID of the user.
+ * @return true if the inbox was updated; false otherwise.
+ */
+bool Pond::markNotificationsRead(const int32_t& user_id) {
+  bool marked = false;
+
+  // The newest notification is the last entry of the user's index range
+  const char* query =
+    "INSERT INTO notification_state (usr, unread, last_read) "
+    "VALUES (?1, 0, (SELECT IFNULL(MAX(nid), 0) FROM notifications WHERE usr = ?1)) "
+    "ON CONFLICT (usr) DO UPDATE SET unread = 0, last_read = excluded.last_read";
+
+  sqlite3_stmt* stmt;
+  if (sqlite3_prepare_v2(this->_db, query, -1, &stmt, nullptr) != SQLITE_OK) {
+    sqlite3_finalize(stmt);
+    return marked;
+  }
+
+  sqlite3_bind_int(stmt, 1, user_id);
+
+  if (sqlite3_step(stmt) == SQLITE_DONE) {
+    marked = true;
+  }
+  sqlite3_finalize(stmt);
+
+  return marked;
+}
+
+/**
+ * @brief Retrieves the username associated with a given user ID from the database.
+ *
+ * This function prepares an SQL statement to query the username of a specific user
+ * from the `users` table using the provided user ID. If a matching user ID is found,
+ * it retrieves the `name` column as the username. If no match is found or an error occurs,
+ * it returns an empty string.
+ *
+ * @param user_id The unique identifier of the user whose username is being retrieved.
+ * @return A std::string containing the username if found, otherwise an empty string.
+ */
+std::string Pond::getUsername(const int32_t& user_id) {
+  std::string username;
+
+  const uint64_t generation = this->_validateCaches();
+  if (this->_caches) {
+    if (std::optional<std::string> cached = this->_caches->usernames.get(user_id)) {
+      return *cached;
+    }
+  }
+
+  const char* query =
+    "SELECT name "
+    "FROM live_users "
+    "WHERE usr = ?";
+
+  sqlite3_stmt* stmt;
+  if (sqlite3_prepare_v2(this->_db, query, -1, &stmt, nullptr) != SQLITE_OK) {
+    sqlite3_finalize(stmt);
+    return "";
+  }
+
+  sqlite3_bind_int(stmt, 1, user_id);
+
+  int rc = sqlite3_step(stmt);
+  if (rc == SQLITE_ROW) {
+    const unsigned char* retrieved_username = sqlite3_column_text(stmt, 0);
+    if (retrieved_username != nullptr) {
+      username = reinterpret_cast<const char*>(retrieved_username);
+    }
+    else username = "";
+  }
+
+  sqlite3_finalize(stmt);
+
+  if (this->_caches && (rc == SQLITE_ROW || rc == SQLITE_DONE)) {
+    this->_caches->usernames.put(user_id, username, generation);
+  }
+  return username;
+}
+
+/**
+ * @brief Retrieves a quack from the database using its unique ID.
+ *
+ * @param quack_id The unique ID of the quack to retrieve.
+ * @return A Pond::Quack struct containing the quack's information.
+ */
+Pond::Quack Pond::getQuackFromID(const int32_t& quack_id) {
+  Pond::Quack quack;
+
+  const char* query =
+    "SELECT tid, writer_id, text, tdate, ttime, replyto_tid "
+    "FROM live_tweets "
+    "WHERE tid = ?";
+
+  sqlite3_stmt* stmt;
+  if (sqlite3_prepare_v2(this->_db, query, -1, &stmt, nullptr) != SQLITE_OK) {
+    sqlite3_finalize(stmt);
+    return quack;
+  }
+
+  sqlite3_bind_int(stmt, 1, quack_id);
+
+  if (sqlite3_step(stmt) == SQLITE_ROW) {
+    quack.tid = sqlite3_column_int(stmt, 0);
+    quack.writer_id = sqlite3_column_int(stmt, 1);
+    quack.text = (const char*)sqlite3_column_text(stmt, 2);
+    quack.date = (const char*)sqlite3_column_text(stmt, 3);
+    quack.time = (const char*)sqlite3_column_text(stmt, 4);
+    quack.replyto_tid = sqlite3_column_int(stmt, 5);
+  }
+
+  sqlite3_finalize(stmt);
+  return quack;
+}
+
+/**
+ * @brief Retrieves several quacks by ID, reusing one prepared statement.
+ *
+ * @param quack_ids The unique IDs of the quacks to retrieve.
+ * @return One quack per ID, in the same order; `tid` is 0 for an ID that does not exist.
+ */
+std::vector<Pond::Quack> Pond::getQuacksFromIDs(const std::vector<int32_t>& quack_ids) {
+  std::vector<Pond::Quack> results(quack_ids.size(), Pond::Quack{0, 0, "", "", "", 0});
+
+  const char* query =
+    "SELECT tid, writer_id, text, tdate, ttime, replyto_tid "
+    "FROM live_tweets "
+    "WHERE tid = ?";
+
+  sqlite3_stmt* stmt;
+  if (sqlite3_prepare_v2(this->_db, query, -1, &stmt, nullptr) != SQLITE_OK) {
+    sqlite3_finalize(stmt);
+    return results;
+  }
+
+  for (size_t i = 0; i < quack_ids.size(); ++i) {
+    sqlite3_bind_int(stmt, 1, quack_ids[i]);
+    if (sqlite3_step(stmt) == SQLITE_ROW) {
+      const unsigned char* text = sqlite3_column_text(stmt, 2);
+      const unsigned char* date = sqlite3_column_text(stmt, 3);
+      const unsigned char* time = sqlite3_column_text(stmt, 4);
+
+      Pond::Quack& quack = results[i];
+      quack.tid = sqlite3_column_int(stmt, 0);
+      quack.writer_id = sqlite3_column_int(stmt, 1);
+      quack.text = text ? reinterpret_cast<const char*>(text) : "";
+      quack.date = date ? reinterpret_cast<const char*>(date) : "";
+      quack.time = time ? reinterpret_cast<const char*>(time) : "";
+      quack.replyto_tid = sqlite3_column_int(stmt, 5);
+    }
+    sqlite3_reset(stmt);
+  }
+
+  sqlite3_finalize(stmt);
+  return results;
+}
+
+/**
+ * @brief Retrieves the list of followers for a specified user.
+ *
+ * This method queries the database to find all users who follow the specified user
+ * and returns their IDs and names.
+ *
+ * @param user_id The unique ID of the user whose followers are to be retrieved.
+ * @return A vector of `Pond::User` objects, where each object contains:
+ *         - `usr`: The unique ID of the follower.
+ *         - `name`: The name of the follower.
+ *
+ * @note If no followers are found or if an error occurs during the query, the method
+ *       returns an empty vector.
+ */
+std::vector<Pond::User> Pond::getFollowers(const int32_t& user_id) {
+  PerfCounters::Scope profile(this->_profiler, "Pond::getFollowers");
+  std::vector<Pond::User> results;
+
+  const uint64_t generation = this->_validateCaches();
+  if (this->_caches) {
+    if (std::optional<std::vector<Pond::User>> cached = this->_caches->followers.get(user_id)) {
+      profile.setRows(cached->size());
+      return *cached;
+    }
+  }
+
+  const char* query =
+    "SELECT u.usr, u.name "
+    "FROM follow_graph f "
+    "JOIN live_users u ON f.flwer = u.usr "
+    "WHERE f.flwee = ?";
+
+  sqlite3_stmt* stmt;
+  if (sqlite3_prepare_v2(this->_db, query, -1, &stmt, nullptr) != SQLITE_OK) {
+    sqlite3_finalize(stmt);
+    profile.setRows(results.size());
+    return results;
+  }
+
+  sqlite3_bind_int(stmt, 1, user_id);
+
+  int rc;
+  while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+    Pond::User user;
+    user.usr = sqlite3_column_int(stmt, 0); 
+    user.name = (const char*)(sqlite3_column_text(stmt, 1)); 
+    results.push_back(user);
+  }
+
+  sqlite3_finalize(stmt);
+
+  if (this->_caches && rc == SQLITE_DONE) {
+    this->_caches->followers.put(user_id, results, generation);
+  }
+  profile.setRows(results.size());
+  return results;
+}
+
+/**
+ * @brief Retrieves a list of users that a specified user is following.
+ *
+ * This method queries the database to find all user IDs of the users whom the 
+ * specified user has chosen to follow.
+ *
+ * @param user_id The unique ID of the user whose following list is to be retrieved.
+ * @return A vector of integers where each integer represents the unique ID of a user 
+ *         that the specified user is following.
+ *
+ * @note If the user is not following anyone or if an error occurs during the query, 
+ *       the method returns an empty vector.
+ */
+std::vector<int32_t> Pond::getFollows(const int32_t& user_id) {
+  PerfCounters::Scope profile(this->_profiler, "Pond::getFollows");
+  std::vector<int32_t> results;
+
+  const uint64_t generation = this->_validateCaches();
+  if (this->_caches) {
+    if (std::optional<std::vector<int32_t>> cached = this->_caches->follows.get(user_id)) {
+      profile.setRows(cached->size());
+      return *cached;
+    }
+  }
+
+  const char* query =
+  "SELECT flwee "
+  "FROM follow_graph "
+  "WHERE flwer = ? "
+  "AND flwee NOT IN (SELECT id FROM tombstones WHERE kind = 1)";
+
+  sqlite3_stmt* stmt;
+  if (sqlite3_prepare_v2(this->_db, query, -1, &stmt, nullptr) != SQLITE_OK) {
+    sqlite3_finalize(stmt);
+    profile.setRows(results.size());
+    return results;
+  }
+
+  sqlite3_bind_int(stmt, 1, user_id);
+
+  int rc;
+  while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+    results.push_back(sqlite3_column_int(stmt, 0));
+  }
+
+  sqlite3_finalize(stmt);
+
+  if (this->_caches && rc == SQLITE_DONE) {
+    this->_caches->follows.put(user_id, results, generation);
+  }
+  profile.setRows(results.size());
+  return results;
+}
+
+/**
+ * @brief Retrieves all quacks created by a specified user.
+ *
+ * This method queries the database to fetch all quacks (tweets) authored by the given 
+ * user, sorted by date and time in descending order (most recent first).
+ *
+ * @param user_id The unique ID of the user whose quacks are to be retrieved.
+ * @return A vector of `Pond::Quack` objects, where each object contains:
+ *         - `tid`: The unique ID of the quack.
+ *         - `writer_id`: The unique ID of the user who authored the quack.
+ *         - `text`: The text content of the quack.
+ *         - `date`: The date the quack was created (format: YYYY-MM-DD).
+ *         - `time`: The time the quack was created (format: HH:MM:SS).
+ *         - `replyto_tid`: The unique ID of the quack this quack is replying to, 
+ *           or 0 if it is not a reply.
+ *
+ * @note If the user has not authored any quacks or if an error occurs during the query, 
+ *       the method returns an empty vector.
+ */
+std::vector<Pond::Quack> Pond::getQuacks(const int32_t& user_id) {
+  PerfCounters::Scope profile(this->_profiler, "Pond::getQuacks");
+  std::vector<Pond::Quack> results;
+
+  const uint64_t generation = this->_validateCaches();
+  if (this->_caches) {
+    if (std::optional<std::vector<Pond::Quack>> cached = this->_caches->quacks.get(user_id)) {
+      profile.setRows(cached->size());
+      return *cached;
+    }
+  }
+
+  const char* query =
+    "SELECT tid, writer_id, text, tdate, ttime, replyto_tid "
+    "FROM live_tweets "
+    "WHERE writer_id = ? "
+    "ORDER BY tdate DESC, ttime DESC";
+
+  sqlite3_stmt* stmt;
+  if (sqlite3_prepare_v2(this->_db, query, -1, &stmt, nullptr) != SQLITE_OK) {
+    sqlite3_finalize(stmt);
+    profile.setRows(results.size());
+    return results;
+  }
+
+  sqlite3_bind_int(stmt, 1, user_id);
+
+  int rc;
+  while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+    Pond::Quack quack;
+    quack.tid =  sqlite3_column_int(stmt, 0);
+    quack.writer_id = sqlite3_column_int(stmt, 1);
+    quack.text = (const char*)(sqlite3_column_text(stmt, 2));
+    quack.date = (const char*)(sqlite3_column_text(stmt, 3));
+    quack.time = (const char*)(sqlite3_column_text(stmt, 4));
+    quack.replyto_tid = sqlite3_column_int(stmt, 5);
+
+    results.push_back(quack);
+  }
+
+  sqlite3_finalize(stmt);
+
+  if (this->_caches && rc == SQLITE_DONE) {
+    this->_caches->quacks.put(user_id, results, generation);
+  }
+  profile.setRows(results.size());
+  return results;
+}
+
+// =============================================================================
+// Private Methods
+// =============================================================================
+
+/**
+ * @brief Registers Pond's native SQL functions on the open connection.
+ *
+ * @return true if every function was registered; false otherwise.
+ */
+bool Pond::_registerFunctions() {
+  const int flags = SQLITE_UTF8 | SQLITE_DETERMINISTIC | SQLITE_INNOCUOUS;
+  return sqlite3_create_function_v2(this->_db, "qk_has_word", 2, flags, nullptr,
+                                    &Pond::_hasWordFunction, nullptr, nullptr, nullptr) == SQLITE_OK;
+}
+
+/**
+ * @brief SQLite progress handler that polls `_interrupt_check`.
+ *
+ * @param pond The Pond whose check is polled.
+ * @return Non-zero to interrupt the running statement.
+ */
+int Pond::_progressHandler(void* pond) {
+  return static_cast<Pond*>(pond)->_interrupt_check() ? 1 : 0;
+}
+
+/**
+ * @brief SQLite busy handler that retries a locked statement with jittered
+ *        exponential backoff, for up to `BUSY_TIMEOUT_MS`.
+ *
+ * Each retry sleeps a random time between half and all of a cap that starts at
+ * `BUSY_BACKOFF_INITIAL_MS` and doubles up to `BUSY_BACKOFF_MAX_MS`. The randomness
+ * keeps sessions that were blocked by the same writer from retrying in lockstep, which
+ * `sqlite3_busy_timeout`'s fixed schedule does.
+ *
+ * @param pond The Pond whose connection is waiting.
+ * @param attempt The number of times the handler was already called for this lock.
+ * @return Non-zero to retry the statement; 0 to fail it with `SQLITE_BUSY`.
+ */
+int Pond::_busyHandler(void* pond, int attempt) {
+  Pond* self = static_cast<Pond*>(pond);
+  Pond::LockStats& stats = self->_lock_stats;
+
+  if (attempt == 0) {
+    ++stats.waits;
+    self->_lock_wait_us = 0;
+  }
+  if (self->_lock_wait_us >= static_cast<uint64_t>(BUSY_TIMEOUT_MS) * 1000) {
+    ++stats.timeouts;
+    return 0;
+  }
+
+  const int64_t cap_us = static_cast<int64_t>(BUSY_BACKOFF_INITIAL_MS) * 1000 << std::min(attempt, 16);
+  const int64_t max_us = std::min<int64_t>(cap_us, static_cast<int64_t>(BUSY_BACKOFF_MAX_MS) * 1000);
+  std::uniform_int_distribution<int64_t> jitter(max_us / 2, max_us);
+  const int64_t sleep_us = std::min<int64_t>(jitter(self->_backoff_random),
+                                             static_cast<int64_t>(BUSY_TIMEOUT_MS) * 1000 - self->_lock_wait_us);
+
+  std::this_thread::sleep_for(std::chrono::microseconds(sleep_us));
+  ++stats.retries;
+  self->_lock_wait_us += sleep_us;
+  stats.wait_us += sleep_us;
+  stats.max_wait_us = std::max(stats.max_wait_us, self->_lock_wait_us);
+  return 1;
+}
+
+/**
+ * @brief Invalidates the caches if another connection has changed the database since
+ *        this connection last checked.
+ *
+ * Only the connection that owns the caches checks; see `setCaches`.
+ *
+ * @return The cache generation to stamp results computed from now on.
+ */
+uint64_t Pond::_validateCaches() {
+  this->_relieveMemoryPressure();
+  if (!this->_caches) {
+    return 0;
+  }
+  if (!this->_owns_caches) {
+    return this->_caches->generation.load(std::memory_order_acquire);
+  }
+
+  sqlite3_stmt* stmt;
+  if (sqlite3_prepare_v2(this->_db, "PRAGMA data_version", -1, &stmt, nullptr) == SQLITE_OK &&
+      sqlite3_step(stmt) == SQLITE_ROW) {
+    const int64_t version = sqlite3_column_int64(stmt, 0);
+    if (this->_caches_version >= 0 && version != this->_caches_version) {
+      this->_caches->generation.fetch_add(1, std::memory_order_acq_rel);
+    }
+    this->_caches_version = version;
+  }
+  sqlite3_finalize(stmt);
+
+  return this->_caches->generation.load(std::memory_order_acquire);
+}
+
+/**
+ * @brief Releases this connection's page cache if the cache manager asked for memory
+ *        back since the last call.
+ */
+void Pond::_relieveMemoryPressure() {
+  if (this->_release_memory.exchange(false, std::memory_order_acq_rel)) {
+    sqlite3_db_release_memory(this->_db);
+  }
+}
+
+/**
+ * @brief Starts a write transaction, taking the write lock up front, unless the caller
+ *        is already inside a transaction.
+ *
+ * Taking the lock with `BEGIN IMMEDIATE` makes a write that reads before it writes,
+ * such as claiming the next quack ID, atomic against other connections, and lets the
+ * busy handler wait for the lock before anything has been done.
+ *
+ * The index version and loads are noted once the lock is held, so `_endWrite` can tell
+ * whether the shared indexes were current when the write began. The version is pinned
+ * for the connection until then: the write records its changes in the indexes as it
+ * goes, so its own reads must not reload them for the version its changes add up to.
+ *
+ * @param[out] own_transaction Whether this call started the transaction.
+ * @return true if the write can go ahead; false if the lock could not be taken.
+ */
+bool Pond::_beginWrite(bool& own_transaction) {
+  this->_relieveMemoryPressure();
+  own_transaction = sqlite3_get_autocommit(this->_db) != 0;
+  if (own_transaction && sqlite3_exec(this->_db, "BEGIN IMMEDIATE", nullptr, nullptr, nullptr) != SQLITE_OK) {
+    std::cerr << "SQL Error (begin write): " << sqlite3_errmsg(this->_db) << std::endl;
+    return false;
+  }
+  if (own_transaction) {
+    this->_write_index_loads = this->_indexes->loads();
+    this->_write_index_version = IndexVersion::read(this->_db);
+    IndexVersion::pin(this->_db, this->_write_index_version);
+  }
+  return true;
+}
+
+/**
+ * @brief Commits a transaction started by `_beginWrite`, or rolls it back if the write
+ *        failed or the commit does.
+ *
+ * The write has recorded its changes in the shared indexes by now. Before committing,
+ * the indexes are moved past it, so no connection sharing them reloads them for this
+ * write; that is skipped if any of them was loaded or invalidated while the write was
+ * open, since a load may have missed changes recorded before it. Until the commit,
+ * other connections see indexes a write ahead of the tables, which is harmless: every
+ * result read from them is looked up in the tables. A rollback may undo rows the
+ * indexes already reflect, so if the write changed any indexed row they are rebuilt
+ * on their next use.
+ *
+ * @param own_transaction The value `_beginWrite` returned through its parameter.
+ * @param succeeded Whether every statement of the write succeeded.
+ * @return true if the write is (or, within an outer transaction, will be) kept.
+ */
+bool Pond::_endWrite(const bool& own_transaction, const bool& succeeded) {
+  if (!own_transaction) {
+    return succeeded;
+  }
+  const int64_t began_at = this->_write_index_version;
+  this->_write_index_version = -1;
+  IndexVersion::pin(this->_db, -1);
+  const int64_t index_version = IndexVersion::read(this->_db);
+  if (succeeded) {
+    if (began_at >= 0 && index_version > began_at && this->_indexes->loads() == this->_write_index_loads) {
+      this->_indexes->advance(began_at, index_version);
+    }
+    if (sqlite3_exec(this->_db, "COMMIT", nullptr, nullptr, nullptr) == SQLITE_OK) {
+      return true;
+    }
+    std::cerr << "SQL Error (commit write): " << sqlite3_errmsg(this->_db) << std::endl;
+  }
+  // Nothing to undo if `BEGIN` itself failed
+  const bool open = sqlite3_get_autocommit(this->_db) == 0;
+  sqlite3_exec(this->_db, "ROLLBACK", nullptr, nullptr, nullptr);
+  if (open && (began_at < 0 || index_version != began_at)) {
+    this->_indexes->invalidate();
+  }
+  this->_invalidateCaches();
+  return false;
+}
+
+/**
+ * @brief Invalidates the caches after a write through this connection.
+ *
+ * `PRAGMA data_version` does not change for a connection's own writes, so every
+ * method that writes data a cache holds calls this once the write succeeds.
+ */
+void Pond::_invalidateCaches() {
+  if (this->_caches) {
+    this->_caches->generation.fetch_add(1, std::memory_order_acq_rel);
+  }
+}
+
+/**
+ * @brief Computes the key of a feed in the feed cache.
+ *
+ * @param user_id The user whose feed it is.
+ * @param mode The feed mode.
+ * @return The key.
+ */
+int64_t Pond::_feedKey(const int32_t& user_id, const Pond::FeedMode& mode) {
+  return (static_cast<int64_t>(user_id) << 8) | static_cast<int64_t>(mode);
+}
+
+/**
+ * @brief Implements the SQL function `qk_has_word(text, keyword)`.
+ *
+ * Returns 1 if `keyword` or `#keyword` appears in `text` bounded by spaces or the ends
+ * of the text, comparing ASCII letters case-insensitively; 0 if not; NULL if either
+ * argument is NULL. This is the match the search used to spell out as eight `LIKE`
+ * patterns over `LOWER(text)`.
+ *
+ * The keyword is normally a bound parameter that stays the same for every row, so its
+ * lowercased form is cached as auxiliary data and folded only once per statement.
+ *
+ * @param context The SQLite function context.
+ * @param argc The number of arguments (always 2).
+ * @param argv The `text` and `keyword` arguments.
+ */
+void Pond::_hasWordFunction(sqlite3_context* context, int argc, sqlite3_value** argv) {
+  if (argc != 2 || sqlite3_value_type(argv[0]) == SQLITE_NULL || sqlite3_value_type(argv[1]) == SQLITE_NULL) {
+    sqlite3_result_null(context);
+    return;
+  }
+
+  const std::string* keyword = static_cast<const std::string*>(sqlite3_get_auxdata(context, 1));
+  std::string lowered;
+  if (!keyword) {
+    const char* raw = reinterpret_cast<const char*>(sqlite3_value_text(argv[1]));
+    lowered.assign(raw, sqlite3_value_bytes(argv[1]));
+    for (char& c : lowered) {
+      if (c >= 'A' && c <= 'Z') c += 'a' - 'A';
+    }
+    keyword = &lowered;
+    sqlite3_set_auxdata(context, 1, new std::string(lowered), [](void* cached) {
+      delete static_cast<std::string*>(cached);
+    });
+  }
+
+  const char* text = reinterpret_cast<const char*>(sqlite3_value_text(argv[0]));
+  sqlite3_result_int(context, _hasWord(text, sqlite3_value_bytes(argv[0]), *keyword) ? 1 : 0);
+}
+
+/**
+ * @brief Checks whether a keyword appears in a text as a whole, space-bounded word.
+ *
+ * Makes a single pass over the text, jumping from word start to word start with
+ * `memchr` and comparing the keyword only there.
+ *
+ * @param text The text to scan.
+ * @param size The length of `text` in bytes.
+ * @param keyword The keyword, already lowercased.
+ * @return true if `keyword` or `#keyword` starts a word and ends one; false otherwise.
+ */
+bool Pond::_hasWord(const char* text, const size_t& size, const std::string& keyword) {
+  const size_t length = keyword.size();
+  if (!text || length == 0) {
+    return false;
+  }
+
+  auto matches_at = [&](size_t at) {
+    if (at + length > size || (at + length < size && text[at + length] != ' ')) {
+      return false;
+    }
+    for (size_t k = 0; k < length; ++k) {
+      char c = text[at + k];
+      if (c >= 'A' && c <= 'Z') c += 'a' - 'A';
+      if (c != keyword[k]) return false;
+    }
+    return true;
+  };
+
+  size_t start = 0;
+  while (start < size) {
+    if (matches_at(start) || (text[start] == '#' && matches_at(start + 1))) {
+      return true;
+    }
+    const void* space = std::memchr(text + start, ' ', size - start);
+    if (!space) {
+      break;
+    }
+    start = static_cast<const char*>(space) - text + 1;
+  }
+  return false;
+}
+
+/**
+ * @brief Creates the derived tables Pond maintains alongside the base schema.
+ *
+ * Databases created from older copies of `schema.sql` do not contain the derived
+ * tables, so they are created with `IF NOT EXISTS` every time a database is loaded.
+ *
+ * @return true if every table exists after the call; false otherwise.
+ */
+bool Pond::_ensureSchema() {
+  const char* query =
+    // HyperLogLog sketch of each user's followers
+    "CREATE TABLE IF NOT EXISTS follower_sketches ("
+    "  usr         int,"
+    "  sketch      blob,"
+    "  PRIMARY KEY (usr)"
+    ");"
+    // Reach sketch and deepest requack chain of each requacked quack
+    "CREATE TABLE IF NOT EXISTS quack_reach ("
+    "  tid         int,"
+    "  sketch      blob,"
+    "  max_depth   int,"
+    "  PRIMARY KEY (tid)"
+    ");"
+    // Depth of every requack within its quack's cascade
+    "CREATE TABLE IF NOT EXISTS requack_cascades ("
+    "  tid           int,"
+    "  retweeter_id  int,"
+    "  depth         int,"
+    "  PRIMARY KEY (tid, retweeter_id)"
+    ");"
+    // Hour (0), day (1) and month (2) activity counters
+    "CREATE TABLE IF NOT EXISTS activity_rollups ("
+    "  granularity  int,"
+    "  bucket       text,"
+    "  metric       text,"
+    "  count        int,"
+    "  PRIMARY KEY (granularity, metric, bucket)"
+    ");"
+    // One-off markers for derived data that has been built
+    "CREATE TABLE IF NOT EXISTS pond_meta ("
+    "  key          text,"
+    "  value        text,"
+    "  PRIMARY KEY (key)"
+    ");"
+    // Engagement counters used to rank feeds
+    "CREATE TABLE IF NOT EXISTS quack_stats ("
+    "  tid           int,"
+    "  requacks      int,"
+    "  replies       int,"
+    "  spam_requacks int,"
+    "  PRIMARY KEY (tid)"
+    ");"
+    // How often a viewer has replied to or requacked an author
+    "CREATE TABLE IF NOT EXISTS affinity ("
+    "  viewer       int,"
+    "  author       int,"
+    "  score        int,"
+    "  PRIMARY KEY (viewer, author)"
+    ");"
+    // Users mentioned by each quack, keyed for "where was I mentioned"
+    "CREATE TABLE IF NOT EXISTS mentions ("
+    "  usr          int,"
+    "  tid          int,"
+    "  PRIMARY KEY (usr, tid)"
+    ");"
+    // Resolves @name mentions without scanning users
+    "CREATE INDEX IF NOT EXISTS users_by_handle ON users (REPLACE(LOWER(name), ' ', ''));"
+    // Per-user inbox written by fan-out; kind: 0 mention, 1 reply, 2 requack, 3 follow
+    "CREATE TABLE IF NOT EXISTS notifications ("
+    "  nid          integer PRIMARY KEY AUTOINCREMENT,"
+    "  usr          int,"
+    "  kind         int,"
+    "  actor        int,"
+    "  actor_name   text,"
+    "  tid          int,"
+    "  snippet      text,"
+    "  ndate        date,"
+    "  ntime        time"
+    ");"
+    "CREATE INDEX IF NOT EXISTS notifications_by_user ON notifications (usr, nid);"
+    // Unread count and read position of each inbox
+    "CREATE TABLE IF NOT EXISTS notification_state ("
+    "  usr          int,"
+    "  unread       int,"
+    "  last_read    int,"
+    "  PRIMARY KEY (usr)"
+    ");"
+    // Legitimate requacks by requacker, the only rows feeds read from `retweets`
+    "CREATE INDEX IF NOT EXISTS retweets_legit ON retweets (retweeter_id, rdate, tid) WHERE spam = 0;"
+    // Spam requacks past retention, counted per requacker, author and day
+    "CREATE TABLE IF NOT EXISTS spam_ledger ("
+    "  retweeter_id int,"
+    "  writer_id    int,"
+    "  day          date,"
+    "  requacks     int,"
+    "  PRIMARY KEY (retweeter_id, writer_id, day)"
+    ");"
+    // Deleted quacks (0), users (1) and lists (2) whose rows are still being purged
+    "CREATE TABLE IF NOT EXISTS tombstones ("
+    "  kind         int,"
+    "  id           int,"
+    "  lname        text,"
+    "  deleted_at   text,"
+    "  PRIMARY KEY (kind, id, lname)"
+    ");"
+    // What read paths query instead of the base tables, so deletes hide rows at once
+    "CREATE VIEW IF NOT EXISTS live_users AS "
+    "  SELECT * FROM users "
+    "  WHERE usr NOT IN (SELECT id FROM tombstones WHERE kind = 1);"
+    "CREATE VIEW IF NOT EXISTS live_tweets AS "
+    "  SELECT * FROM tweets "
+    "  WHERE tid NOT IN (SELECT id FROM tombstones WHERE kind = 0) "
+    "    AND writer_id NOT IN (SELECT id FROM tombstones WHERE kind = 1) "
+    "    AND IFNULL(replyto_tid, 0) NOT IN (SELECT id FROM tombstones WHERE kind = 0);"
+    "CREATE VIEW IF NOT EXISTS live_retweets AS "
+    "  SELECT * FROM retweets "
+    "  WHERE tid NOT IN (SELECT id FROM tombstones WHERE kind = 0) "
+    "    AND retweeter_id NOT IN (SELECT id FROM tombstones WHERE kind = 1) "
+    "    AND writer_id NOT IN (SELECT id FROM tombstones WHERE kind = 1);"
+    "CREATE VIEW IF NOT EXISTS live_notifications AS "
+    "  SELECT * FROM notifications "
+    "  WHERE actor NOT IN (SELECT id FROM tombstones WHERE kind = 1) "
+    "    AND tid NOT IN (SELECT id FROM tombstones WHERE kind = 0);"
+    // Child keys the purge deletes by, so each batch is an index range instead of a scan
+    "CREATE INDEX IF NOT EXISTS tweets_by_writer ON tweets (writer_id);"
+    "CREATE INDEX IF NOT EXISTS tweets_by_reply ON tweets (replyto_tid);"
+    "CREATE INDEX IF NOT EXISTS follows_by_followee ON follows (flwee);"
+    "CREATE INDEX IF NOT EXISTS mentions_by_quack ON mentions (tid);"
+    "CREATE INDEX IF NOT EXISTS notifications_by_quack ON notifications (tid);"
+    "CREATE INDEX IF NOT EXISTS notifications_by_actor ON notifications (actor);"
+    // Lists that the search planner counts and intersects
+    "CREATE INDEX IF NOT EXISTS hashtag_mentions_by_term ON hashtag_mentions (LOWER(term));"
+    "CREATE INDEX IF NOT EXISTS tweets_by_date ON tweets (tdate, tid);";
+
+  if (sqlite3_exec(this->_db, query, nullptr, nullptr, nullptr) != SQLITE_OK) {
+    return false;
+  }
+  // Time of day of each requack, which leaderboards rank by, and when it was flagged as
+  // spam, which the retention job measures from; rows flagged before the column existed
+  // fall back to the day of the requack
+  const char* flagged_query =
+    "DROP INDEX IF EXISTS retweets_spam;"
+    "CREATE INDEX IF NOT EXISTS retweets_flagged ON retweets (IFNULL(flagged_at, rdate)) WHERE spam = 1;";
+  return this->_ensureColumn("retweets", "rtime", "time") && this->_ensureColumn("retweets", "flagged_at", "datetime") &&
+         sqlite3_exec(this->_db, flagged_query, nullptr, nullptr, nullptr) == SQLITE_OK &&
+         this->_ensureEngagementCounters() && this->_ensureIndexVersion();
+}
+
+/**
+ * @brief Adds a column to a base table of a database created before the column existed.
+ *
+ * `ALTER TABLE` has no `IF NOT EXISTS`, so the column is looked up first, and again
+ * under the write lock in case another session added it meanwhile. Existing rows hold
+ * NULL in the new column.
+ *
+ * @param table The table.
+ * @param column The column's name.
+ * @param type The column's declared type.
+ * @return true if the column exists after the call; false otherwise.
+ */
+bool Pond::_ensureColumn(const char* table, const char* column, const char* type) {
+  auto column_exists = [&](bool& exists) {
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(this->_db, "SELECT 1 FROM pragma_table_info(?1) WHERE name = ?2", -1, &stmt, nullptr) != SQLITE_OK) {
+      sqlite3_finalize(stmt);
+      return false;
+    }
+    sqlite3_bind_text(stmt, 1, table, -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 2, column, -1, SQLITE_STATIC);
+    exists = sqlite3_step(stmt) == SQLITE_ROW;
+    sqlite3_finalize(stmt);
+    return true;
+  };
+
+  bool exists;
+  if (!column_exists(exists)) {
+    return false;
+  }
+  if (exists) {
+    return true;
+  }
+
+  bool own_transaction;
+  if (!this->_beginWrite(own_transaction) || !column_exists(exists)) {
+    return this->_endWrite(own_transaction, false);
+  }
+  if (exists) {
+    return this->_endWrite(own_transaction, true);
+  }
+
+  const std::string alter_query = std::string("ALTER TABLE ") + table + " ADD COLUMN " + column + " " + type;
+  return this->_endWrite(own_transaction, sqlite3_exec(this->_db, alter_query.c_str(), nullptr, nullptr, nullptr) == SQLITE_OK);
+}
+
+/**
+ * @brief Builds the engagement counters from the base tables the first time a
+ *        database is loaded with ranked-feed support.
+ *
+ * Legitimate requacks add 2 and replies add 3 to the viewer's affinity with the
+ * author, matching the weights used when the counters are maintained live.
+ *
+ * @return true if the counters exist; false if building them failed.
+ */
+bool Pond::_ensureEngagementCounters() {
+  const char* check_query =
+    "SELECT 1 FROM pond_meta WHERE key = 'engagement_counters'";
+  auto counters_built = [&](bool& built) {
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(this->_db, check_query, -1, &stmt, nullptr) != SQLITE_OK) {
+      sqlite3_finalize(stmt);
+      return false;
+    }
+    built = sqlite3_step(stmt) == SQLITE_ROW;
+    sqlite3_finalize(stmt);
+    return true;
+  };
+
+  bool built;
+  if (!counters_built(built)) {
+    return false;
+  }
+  if (built) {
+    return true;
+  }
+
+  // Check again under the write lock: sessions opening a new database at once build them once
+  bool own_transaction;
+  if (!this->_beginWrite(own_transaction) || !counters_built(built)) {
+    return this->_endWrite(own_transaction, false);
+  }
+  if (built) {
+    return this->_endWrite(own_transaction, true);
+  }
+
+  const char* build_query =
+    "DELETE FROM quack_stats;"
+    "INSERT INTO quack_stats (tid, requacks, replies, spam_requacks) "
+    "SELECT tid, SUM(requacks), SUM(replies), SUM(spam_requacks) FROM ("
+    "  SELECT tid, spam = 0 AS requacks, 0 AS replies, spam = 1 AS spam_requacks FROM retweets "
+    "  UNION ALL "
+    "  SELECT replyto_tid, 0, 1, 0 FROM tweets WHERE IFNULL(replyto_tid, 0) != 0"
+    ") GROUP BY tid;"
+    "DELETE FROM affinity;"
+    "INSERT INTO affinity (viewer, author, score) "
+    "SELECT viewer, author, SUM(weight) FROM ("
+    "  SELECT retweeter_id AS viewer, writer_id AS author, 2 AS weight FROM retweets WHERE spam = 0 "
+    "  UNION ALL "
+    "  SELECT c.writer_id, p.writer_id, 3 FROM tweets c JOIN tweets p ON p.tid = c.replyto_tid"
+    ") WHERE viewer != author GROUP BY viewer, author;"
+    "INSERT INTO pond_meta (key, value) VALUES ('engagement_counters', '1');";
+
+  return this->_endWrite(own_transaction, sqlite3_exec(this->_db, build_query, nullptr, nullptr, nullptr) == SQLITE_OK);
+}
+
+/**
+ * @brief Creates the counter of changes to the tables the in-memory indexes are built
+ *        from, and the triggers that count them, the first time a database is loaded.
+ *
+ * The triggers count every change however it is made, by any connection or program,
+ * so connections sharing the indexes reload them only for changes not applied to them.
+ *
+ * @return true if the counter exists; false if creating it failed.
+ */
+bool Pond::_ensureIndexVersion() {
+  const char* check_query =
+    "SELECT 1 FROM pond_meta WHERE key = 'index_version'";
+  auto counter_created = [&](bool& created) {
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(this->_db, check_query, -1, &stmt, nullptr) != SQLITE_OK) {
+      sqlite3_finalize(stmt);
+      return false;
+    }
+    created = sqlite3_step(stmt) == SQLITE_ROW;
+    sqlite3_finalize(stmt);
+    return true;
+  };
+
+  bool created;
+  if (!counter_created(created)) {
+    return false;
+  }
+  if (created) {
+    return true;
+  }
+
+  bool own_transaction;
+  if (!this->_beginWrite(own_transaction) || !counter_created(created)) {
+    return this->_endWrite(own_transaction, false);
+  }
+  if (created) {
+    return this->_endWrite(own_transaction, true);
+  }
+
+  std::string create_query = "INSERT INTO pond_meta (key, value) VALUES ('index_version', '0');";
+  for (const char* table : {"users", "follows", "tweets", "retweets", "hashtag_mentions", "tombstones"}) {
+    for (const char* event : {"insert", "update", "delete"}) {
+      create_query += std::string("CREATE TRIGGER IF NOT EXISTS index_version_") + table + "_" + event +
+                      " AFTER " + event + " ON " + table + " BEGIN "
+                      "  UPDATE pond_meta SET value = value + 1 WHERE key = 'index_version'; "
+                      "END;";
+    }
+  }
+  return this->_endWrite(own_transaction, sqlite3_exec(this->_db, create_query.c_str(), nullptr, nullptr, nullptr) == SQLITE_OK);
+}
+
+/**
+ * @brief Adjusts the engagement counters of a quack.
+ *
+ * @param quack_id The unique ID of the quack.
+ * @param requacks Change in legitimate requacks.
+ * @param replies Change in replies.
+ * @param spam_requacks Change in spam-flagged requacks.
+ * @return true if the counters were updated; false otherwise.
+ */
+bool Pond::_bumpQuackStats(const int32_t& quack_id, const int32_t& requacks, const int32_t& replies, const int32_t& spam_requacks) {
+  const char* query =
+    "INSERT INTO quack_stats (tid, requacks, replies, spam_requacks) "
+    "VALUES (?1, MAX(?2, 0), MAX(?3, 0), MAX(?4, 0)) "
+    "ON CONFLICT (tid) DO UPDATE SET "
+    "  requacks = MAX(requacks + ?2, 0), "
+    "  replies = MAX(replies + ?3, 0), "
+    "  spam_requacks = MAX(spam_requacks + ?4, 0)";
+
+  sqlite3_stmt* stmt;
+  if (sqlite3_prepare_v2(this->_db, query, -1, &stmt, nullptr) != SQLITE_OK) {
+    sqlite3_finalize(stmt);
+    return false;
+  }
+
+  sqlite3_bind_int(stmt, 1, quack_id);
+  sqlite3_bind_int(stmt, 2, requacks);
+  sqlite3_bind_int(stmt, 3, replies);
+  sqlite3_bind_int(stmt, 4, spam_requacks);
 
+  bool updated = sqlite3_step(stmt) == SQLITE_DONE;
   sqlite3_finalize(stmt);
 
-  return username;
+  return updated;
+}
+
+/**
+ * @brief Strengthens a viewer's affinity with an author after an interaction.
+ *
+ * Interactions with one's own quacks are ignored.
+ *
+ * @param viewer_id The unique ID of the user who interacted.
+ * @param author_id The unique ID of the user they interacted with.
+ * @param weight How much the interaction adds to the affinity.
+ * @return true if the affinity was updated; false otherwise.
+ */
+bool Pond::_bumpAffinity(const int32_t& viewer_id, const int32_t& author_id, const int32_t& weight) {
+  if (viewer_id == author_id) {
+    return true;
+  }
+
+  const char* query =
+    "INSERT INTO affinity (viewer, author, score) "
+    "VALUES (?1, ?2, ?3) "
+    "ON CONFLICT (viewer, author) DO UPDATE SET score = score + ?3";
+
+  sqlite3_stmt* stmt;
+  if (sqlite3_prepare_v2(this->_db, query, -1, &stmt, nullptr) != SQLITE_OK) {
+    sqlite3_finalize(stmt);
+    return false;
+  }
+
+  sqlite3_bind_int(stmt, 1, viewer_id);
+  sqlite3_bind_int(stmt, 2, author_id);
+  sqlite3_bind_int(stmt, 3, weight);
+
+  bool updated = sqlite3_step(stmt) == SQLITE_DONE;
+  sqlite3_finalize(stmt);
+
+  return updated;
+}
+
+/**
+ * @brief Formats a feed entry the way it is displayed in the feed.
+ *
+ * @param entry The entry to format.
+ * @return The formatted entry.
+ */
+std::string Pond::_formatFeedEntry(const Pond::FeedEntry& entry) {
+    std::ostringstream oss;
+    oss << "Quack Id: " << entry.tid;
+    oss << ", Author: " << entry.author;
+    oss << std::string(std::max<int>(0, 66 - static_cast<int>(oss.str().length())), ' ');
+    oss << "Date and Time: " << entry.date << " " << entry.time << "\n\n";
+    oss << "Text: " << formatTweetText(entry.text, 94) << "\n";
+
+    return oss.str();
+}
+
+/**
+ * @brief Builds the in-memory search indexes (completion tries and fuzzy name index)
+ *        if they are missing or the database has changed since they were built.
+ *
+ * Writes made through the connections sharing the indexes are applied to them
+ * directly and never force a rebuild; see `IndexVersion`. The lock is handed to the
+ * caller, who reads the indexes under it.
+ *
+ * @param[out] lock Receives `search_lock`, held whether or not the indexes are current.
+ * @return true if the indexes are current; false if they could not be built.
+ */
+bool Pond::_refreshSearchIndexes(std::unique_lock<std::mutex>& lock) {
+  Pond::Indexes& indexes = *this->_indexes;
+  const int64_t version = IndexVersion::read(this->_db);
+  lock = std::unique_lock<std::mutex>(indexes.search_lock);
+  if (version < 0) {
+    return false;
+  }
+  if (indexes.search_version.current(version)) {
+    return true;
+  }
+
+  indexes.hashtag_completions.clear();
+  indexes.user_completions.clear();
+  indexes.name_tokens.clear();
+  indexes.indexed_users.clear();
+  indexes.search_version.loaded(-1);
+
+  sqlite3_stmt* stmt;
+  const char* hashtags_query =
+    "SELECT LOWER(h.term), COUNT(*) FROM hashtag_mentions h "
+    "JOIN live_tweets t ON t.tid = h.tid "
+    "GROUP BY LOWER(h.term)";
+
+  if (sqlite3_prepare_v2(this->_db, hashtags_query, -1, &stmt, nullptr) != SQLITE_OK) {
+    sqlite3_finalize(stmt);
+    return false;
+  }
+  while (sqlite3_step(stmt) == SQLITE_ROW) {
+    std::string term = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
+    indexes.hashtag_completions.add(_completionKey(term), term, sqlite3_column_int64(stmt, 1));
+  }
+  sqlite3_finalize(stmt);
+
+  // Users sharing a name share one completion weighted by all of their followers
+  const char* users_query =
+    "SELECT u.usr, u.name, COUNT(f.flwer) FROM live_users u "
+    "LEFT JOIN follows f ON f.flwee = u.usr "
+    "GROUP BY u.usr";
+
+  if (sqlite3_prepare_v2(this->_db, users_query, -1, &stmt, nullptr) != SQLITE_OK) {
+    sqlite3_finalize(stmt);
+    return false;
+  }
+  std::vector<std::pair<std::string, int32_t>> name_words;
+  while (sqlite3_step(stmt) == SQLITE_ROW) {
+    const unsigned char* name = sqlite3_column_text(stmt, 1);
+    if (!name) continue;
+    const int32_t user_id = sqlite3_column_int(stmt, 0);
+    std::string display = reinterpret_cast<const char*>(name);
+    uint32_t followers = sqlite3_column_int(stmt, 2);
+    indexes.user_completions.add(_completionKey(display), display, followers);
+    indexes.indexed_users[user_id] = {display, followers};
+    for (std::string& word : _nameWords(display)) {
+      name_words.push_back({std::move(word), user_id});
+    }
+  }
+  sqlite3_finalize(stmt);
+  indexes.name_tokens.load(std::move(name_words));
+
+  indexes.search_version.loaded(version);
+  return true;
+}
+
+/**
+ * @brief Splits a user name into its distinct lowercase words.
+ *
+ * Each word is indexed separately, so a search for a first or last name alone still
+ * matches.
+ *
+ * @param name The user's name.
+ * @return The words the name is fuzzy-searched by.
+ */
+std::vector<std::string> Pond::_nameWords(const std::string& name) {
+  std::string lowered = name;
+  std::transform(lowered.begin(), lowered.end(), lowered.begin(), ::tolower);
+
+  std::vector<std::string> words;
+  std::istringstream iss(lowered);
+  std::string word;
+  while (iss >> word) {
+    if (std::find(words.begin(), words.end(), word) == words.end()) {
+      words.push_back(word);
+    }
+  }
+  return words;
+}
+
+/**
+ * @brief Normalizes a term into the key it is completed by.
+ *
+ * @param term The hashtag or user name.
+ * @return The term in lowercase, without a leading `#`.
+ */
+std::string Pond::_completionKey(const std::string& term) {
+  std::string key = (!term.empty() && term[0] == '#') ? term.substr(1) : term;
+  std::transform(key.begin(), key.end(), key.begin(), ::tolower);
+  return key;
+}
+
+/**
+ * @brief Extracts the `@name` and `@id` mentions of a new quack and notifies the
+ *        mentioned users.
+ *
+ * A mention is `@` followed by either a user ID or a user's name written without
+ * spaces (case-insensitive), e.g. `@mariablake`. Trailing punctuation is ignored. A
+ * name shared by several users mentions all of them.
+ *
+ * @param quack_id The unique ID of the quack.
+ * @param author_id The unique ID of the quack's author.
+ * @param text The text of the quack.
+ * @param notified_id A user who was already notified about this quack and is not
+ *        notified again, or 0.
+ * @return true if every mention was recorded; false otherwise.
+ */
+bool Pond::_recordMentions(const int32_t& quack_id, const int32_t& author_id, const std::string& text, const int32_t& notified_id) {
+  std::unordered_set<std::string> handles;
+  std::istringstream iss(text);
+  std::string word;
+  while (iss >> word) {
+    if (word[0] != '@') continue;
+
+    std::string handle = word.substr(1);
+    while (!handle.empty() && !std::isalnum(static_cast<unsigned char>(handle.back()))) {
+      handle.pop_back();
+    }
+    std::transform(handle.begin(), handle.end(), handle.begin(), ::tolower);
+    if (!handle.empty()) {
+      handles.insert(handle);
+    }
+  }
+  if (handles.empty()) {
+    return true;
+  }
+
+  // Both lookups are index seeks: the primary key and the users_by_handle index
+  const char* id_query = "SELECT usr FROM live_users WHERE usr = ?";
+  const char* name_query = "SELECT usr FROM live_users WHERE REPLACE(LOWER(name), ' ', '') = ?";
+
+  std::unordered_set<int32_t> mentioned;
+  for (const std::string& handle : handles) {
+    const bool is_id = handle.size() <= 9 && std::all_of(handle.begin(), handle.end(), ::isdigit);
+
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(this->_db, is_id ? id_query : name_query, -1, &stmt, nullptr) != SQLITE_OK) {
+      sqlite3_finalize(stmt);
+      return false;
+    }
+    if (is_id) {
+      sqlite3_bind_int(stmt, 1, std::stoi(handle));
+    } else {
+      sqlite3_bind_text(stmt, 1, handle.c_str(), -1, SQLITE_STATIC);
+    }
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+      mentioned.insert(sqlite3_column_int(stmt, 0));
+    }
+    sqlite3_finalize(stmt);
+  }
+
+  const char* query =
+    "INSERT OR IGNORE INTO mentions (usr, tid) "
+    "VALUES (?, ?)";
+
+  bool recorded = true;
+  for (const int32_t& user_id : mentioned) {
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(this->_db, query, -1, &stmt, nullptr) != SQLITE_OK) {
+      sqlite3_finalize(stmt);
+      return false;
+    }
+    sqlite3_bind_int(stmt, 1, user_id);
+    sqlite3_bind_int(stmt, 2, quack_id);
+    recorded = sqlite3_step(stmt) == SQLITE_DONE && recorded;
+    sqlite3_finalize(stmt);
+
+    if (user_id != notified_id) {
+      recorded = this->_notify(user_id, NotificationKind::MENTION, author_id, quack_id, text) && recorded;
+    }
+  }
+
+  return recorded;
+}
+
+/**
+ * @brief Appends a notification to a user's inbox and bumps their unread count.
+ *
+ * Users are never notified about their own actions.
+ *
+ * @param user_id The unique ID of the user to notify.
+ * @param kind The kind of event.
+ * @param actor_id The unique ID of the user who caused the event.
+ * @param quack_id The unique ID of the quack involved, or 0.
+ * @param text The text of the quack involved, shortened into the snippet.
+ * @return true if the notification was written or skipped; false otherwise.
+ */
+bool Pond::_notify(const int32_t& user_id, const Pond::NotificationKind& kind, const int32_t& actor_id, const int32_t& quack_id, const std::string& text) {
+  if (user_id == actor_id) {
+    return true;
+  }
+
+  // Cut the snippet on a character boundary so multi-byte UTF-8 is never split
+  std::string snippet = text;
+  if (snippet.size() > NOTIFICATION_SNIPPET_LENGTH) {
+    size_t cut = NOTIFICATION_SNIPPET_LENGTH;
+    while (cut > 0 && (static_cast<unsigned char>(snippet[cut]) & 0xC0) == 0x80) {
+      --cut;
+    }
+    snippet = snippet.substr(0, cut) + "...";
+  }
+  const std::string actor_name = this->getUsername(actor_id);
+
+  const char* query =
+    "INSERT INTO notifications (usr, kind, actor, actor_name, tid, snippet, ndate, ntime) "
+    "VALUES (?, ?, ?, ?, ?, ?, ?, ?)";
+
+  sqlite3_stmt* stmt;
+  if (sqlite3_prepare_v2(this->_db, query, -1, &stmt, nullptr) != SQLITE_OK) {
+    sqlite3_finalize(stmt);
+    return false;
+  }
+
+  sqlite3_bind_int(stmt, 1, user_id);
+  sqlite3_bind_int(stmt, 2, static_cast<int>(kind));
+  sqlite3_bind_int(stmt, 3, actor_id);
+  sqlite3_bind_text(stmt, 4, actor_name.c_str(), -1, SQLITE_STATIC);
+  sqlite3_bind_int(stmt, 5, quack_id);
+  sqlite3_bind_text(stmt, 6, snippet.c_str(), -1, SQLITE_STATIC);
+  sqlite3_bind_text(stmt, 7, this->_getDate().c_str(), -1, SQLITE_TRANSIENT);
+  sqlite3_bind_text(stmt, 8, this->_getTime().c_str(), -1, SQLITE_TRANSIENT);
+
+  bool notified = sqlite3_step(stmt) == SQLITE_DONE;
+  sqlite3_finalize(stmt);
+  if (!notified) {
+    return false;
+  }
+
+  const char* state_query =
+    "INSERT INTO notification_state (usr, unread, last_read) "
+    "VALUES (?, 1, 0) "
+    "ON CONFLICT (usr) DO UPDATE SET unread = unread + 1";
+
+  if (sqlite3_prepare_v2(this->_db, state_query, -1, &stmt, nullptr) != SQLITE_OK) {
+    sqlite3_finalize(stmt);
+    return false;
+  }
+
+  sqlite3_bind_int(stmt, 1, user_id);
+
+  notified = sqlite3_step(stmt) == SQLITE_DONE;
+  sqlite3_finalize(stmt);
+
+  return notified;
+}
+
+/**
+ * @brief Loads the follower sketch of a user, building it from `follows` if needed.
+ *
+ * @param user_id The unique ID of the user whose followers are sketched.
+ * @param[out] sketch The sketch that will hold the user's followers.
+ * @param store Whether a sketch built here is stored; only inside a write.
+ * @return true if the sketch was loaded or built; false if an error occurred.
+ */
+bool Pond::_loadFollowerSketch(const int32_t& user_id, HyperLogLog& sketch, const bool& store) {
+  const char* select_query =
+    "SELECT sketch FROM follower_sketches WHERE usr = ?";
+
+  sqlite3_stmt* stmt;
+  if (sqlite3_prepare_v2(this->_db, select_query, -1, &stmt, nullptr) != SQLITE_OK) {
+    sqlite3_finalize(stmt);
+    return false;
+  }
+
+  sqlite3_bind_int(stmt, 1, user_id);
+
+  bool loaded = false;
+  if (sqlite3_step(stmt) == SQLITE_ROW) {
+    loaded = sketch.fromBytes(sqlite3_column_blob(stmt, 0), sqlite3_column_bytes(stmt, 0));
+  }
+  sqlite3_finalize(stmt);
+
+  if (loaded) {
+    return true;
+  }
+
+  // No stored sketch, build it from the follows table
+  const char* follows_query =
+    "SELECT flwer FROM follow_graph WHERE flwee = ?";
+
+  if (sqlite3_prepare_v2(this->_db, follows_query, -1, &stmt, nullptr) != SQLITE_OK) {
+    sqlite3_finalize(stmt);
+    return false;
+  }
+
+  sqlite3_bind_int(stmt, 1, user_id);
+
+  sketch = HyperLogLog();
+  while (sqlite3_step(stmt) == SQLITE_ROW) {
+    sketch.add(sqlite3_column_int(stmt, 0));
+  }
+  sqlite3_finalize(stmt);
+  if (!store) {
+    return true;
+  }
+
+  const char* store_query =
+    "INSERT OR REPLACE INTO follower_sketches (usr, sketch) "
+    "VALUES (?, ?)";
+
+  if (sqlite3_prepare_v2(this->_db, store_query, -1, &stmt, nullptr) != SQLITE_OK) {
+    sqlite3_finalize(stmt);
+    return false;
+  }
+
+  std::string bytes = sketch.toBytes();
+  sqlite3_bind_int(stmt, 1, user_id);
+  sqlite3_bind_blob(stmt, 2, bytes.data(), bytes.size(), SQLITE_STATIC);
+
+  bool stored = sqlite3_step(stmt) == SQLITE_DONE;
+  sqlite3_finalize(stmt);
+
+  return stored;
+}
+
+/**
+ * @brief Adds a new follower to a user's stored follower sketch.
+ *
+ * If the user has no stored sketch yet, nothing is done; it will be built from the
+ * `follows` table (including the new follower) the first time it is needed.
+ *
+ * @param user_id The unique ID of the user being followed.
+ * @param follower_id The unique ID of the new follower.
+ * @return true if the sketch is up to date; false if an error occurred.
+ */
+bool Pond::_addFollowerToSketch(const int32_t& user_id, const int32_t& follower_id) {
+  const char* select_query =
+    "SELECT sketch FROM follower_sketches WHERE usr = ?";
+
+  sqlite3_stmt* stmt;
+  if (sqlite3_prepare_v2(this->_db, select_query, -1, &stmt, nullptr) != SQLITE_OK) {
+    sqlite3_finalize(stmt);
+    return false;
+  }
+
+  sqlite3_bind_int(stmt, 1, user_id);
+
+  HyperLogLog sketch;
+  bool exists = sqlite3_step(stmt) == SQLITE_ROW &&
+    sketch.fromBytes(sqlite3_column_blob(stmt, 0), sqlite3_column_bytes(stmt, 0));
+  sqlite3_finalize(stmt);
+
+  if (!exists) {
+    return true;
+  }
+
+  sketch.add(follower_id);
+
+  const char* update_query =
+    "UPDATE follower_sketches SET sketch = ? WHERE usr = ?";
+
+  if (sqlite3_prepare_v2(this->_db, update_query, -1, &stmt, nullptr) != SQLITE_OK) {
+    sqlite3_finalize(stmt);
+    return false;
+  }
+
+  std::string bytes = sketch.toBytes();
+  sqlite3_bind_blob(stmt, 1, bytes.data(), bytes.size(), SQLITE_STATIC);
+  sqlite3_bind_int(stmt, 2, user_id);
+
+  bool updated = sqlite3_step(stmt) == SQLITE_DONE;
+  sqlite3_finalize(stmt);
+
+  return updated;
 }
 
 /**
- * @brief Retrieves a quack from the database using its unique ID.
+ * @brief Computes how deep in a quack's cascade a new requack sits.
  *
- * @param quack_id The unique ID of the quack to retrieve.
- * @return A Pond::Quack struct containing the quack's information.
+ * A requacker who follows the author is at depth 1. Otherwise the depth is one more
+ * than the shallowest requacker of the quack they follow, or 1 if they follow none.
+ *
+ * @param quack_id The unique ID of the quack being requacked.
+ * @param user_id The unique ID of the requacker.
+ * @param writer_id The unique ID of the quack's author.
+ * @return The cascade depth of the requack.
  */
-Pond::Quack Pond::getQuackFromID(const int32_t& quack_id) {
-  Pond::Quack quack;
+uint32_t Pond::_getCascadeDepth(const int32_t& quack_id, const int32_t& user_id, const int32_t& writer_id) {
+  uint32_t depth = 1;
 
   const char* query =
-    "SELECT tid, writer_id, text, tdate, ttime, replyto_tid "
-    "FROM tweets "
-    "WHERE tid = ?";
+    "SELECT CASE "
+    "  WHEN EXISTS (SELECT 1 FROM follow_graph WHERE flwer = ?1 AND flwee = ?2) THEN 1 "
+    "  ELSE COALESCE(("
+    "    SELECT MIN(c.depth) "
+    "    FROM requack_cascades c "
+    "    JOIN follow_graph f ON f.flwee = c.retweeter_id "
+    "    WHERE c.tid = ?3 AND f.flwer = ?1"
+    "  ), 0) + 1 "
+    "END";
 
   sqlite3_stmt* stmt;
   if (sqlite3_prepare_v2(this->_db, query, -1, &stmt, nullptr) != SQLITE_OK) {
     sqlite3_finalize(stmt);
-    return quack;
+    return depth;
   }
 
-  sqlite3_bind_int(stmt, 1, quack_id);
+  sqlite3_bind_int(stmt, 1, user_id);    // requacker
+  sqlite3_bind_int(stmt, 2, writer_id);  // author
+  sqlite3_bind_int(stmt, 3, quack_id);   // tid
 
   if (sqlite3_step(stmt) == SQLITE_ROW) {
-    quack.tid = sqlite3_column_int(stmt, 0);
-    quack.writer_id = sqlite3_column_int(stmt, 1);
-    quack.text = (const char*)sqlite3_column_text(stmt, 2);
-    quack.date = (const char*)sqlite3_column_text(stmt, 3);
-    quack.time = (const char*)sqlite3_column_text(stmt, 4);
-    quack.replyto_tid = sqlite3_column_int(stmt, 5);
+    depth = sqlite3_column_int(stmt, 0);
   }
 
   sqlite3_finalize(stmt);
-  return quack;
+  return depth;
 }
 
 /**
- * @brief Retrieves the list of followers for a specified user.
- *
- * This method queries the database to find all users who follow the specified user
- * and returns their IDs and names.
+ * @brief Folds a new requack into the quack's reach sketch and cascade depth.
  *
- * @param user_id The unique ID of the user whose followers are to be retrieved.
- * @return A vector of `Pond::User` objects, where each object contains:
- *         - `usr`: The unique ID of the follower.
- *         - `name`: The name of the follower.
+ * The requack's depth is recorded first so that later requackers who follow this user
+ * chain off it. If the quack has no reach row yet it is built by replaying every
+ * requack; otherwise the requacker's follower sketch is merged in O(registers).
  *
- * @note If no followers are found or if an error occurs during the query, the method
- *       returns an empty vector.
+ * @param quack_id The unique ID of the requacked quack.
+ * @param user_id The unique ID of the requacker.
+ * @param writer_id The unique ID of the quack's author.
+ * @return true if the reach was updated; false if an error occurred.
  */
-std::vector<Pond::User> Pond::getFollowers(const int32_t& user_id) {
-  std::vector<Pond::User> results;
+bool Pond::_updateReach(const int32_t& quack_id, const int32_t& user_id, const int32_t& writer_id) {
+  uint32_t depth = this->_getCascadeDepth(quack_id, user_id, writer_id);
 
-  const char* query =
-    "SELECT u.usr, u.name "
-    "FROM follows f "
-    "JOIN users u ON f.flwer = u.usr "
-    "WHERE f.flwee = ?";
+  const char* cascade_query =
+    "INSERT OR REPLACE INTO requack_cascades (tid, retweeter_id, depth) "
+    "VALUES (?, ?, ?)";
 
   sqlite3_stmt* stmt;
-  if (sqlite3_prepare_v2(this->_db, query, -1, &stmt, nullptr) != SQLITE_OK) {
+  if (sqlite3_prepare_v2(this->_db, cascade_query, -1, &stmt, nullptr) != SQLITE_OK) {
     sqlite3_finalize(stmt);
-    return results;
+    return false;
   }
 
-  sqlite3_bind_int(stmt, 1, user_id);
+  sqlite3_bind_int(stmt, 1, quack_id);
+  sqlite3_bind_int(stmt, 2, user_id);
+  sqlite3_bind_int(stmt, 3, depth);
 
-  while (sqlite3_step(stmt) == SQLITE_ROW) {
-    Pond::User user;
-    user.usr = sqlite3_column_int(stmt, 0); 
-    user.name = (const char*)(sqlite3_column_text(stmt, 1)); 
-    results.push_back(user);
+  bool recorded = sqlite3_step(stmt) == SQLITE_DONE;
+  sqlite3_finalize(stmt);
+  if (!recorded) {
+    return false;
+  }
+
+  const char* select_query =
+    "SELECT sketch FROM quack_reach WHERE tid = ?";
+
+  if (sqlite3_prepare_v2(this->_db, select_query, -1, &stmt, nullptr) != SQLITE_OK) {
+    sqlite3_finalize(stmt);
+    return false;
   }
 
+  sqlite3_bind_int(stmt, 1, quack_id);
+
+  HyperLogLog reach;
+  bool exists = sqlite3_step(stmt) == SQLITE_ROW &&
+    reach.fromBytes(sqlite3_column_blob(stmt, 0), sqlite3_column_bytes(stmt, 0));
   sqlite3_finalize(stmt);
-  return results;
+
+  // First requack seen for this quack, replay its whole history
+  if (!exists) {
+    uint32_t max_depth;
+    return this->_buildReach(quack_id, reach, max_depth, true);
+  }
+
+  HyperLogLog followers;
+  if (!this->_loadFollowerSketch(user_id, followers, true)) {
+    return false;
+  }
+  reach.merge(followers);
+
+  const char* update_query =
+    "UPDATE quack_reach "
+    "SET sketch = ?, max_depth = MAX(max_depth, ?) "
+    "WHERE tid = ?";
+
+  if (sqlite3_prepare_v2(this->_db, update_query, -1, &stmt, nullptr) != SQLITE_OK) {
+    sqlite3_finalize(stmt);
+    return false;
+  }
+
+  std::string bytes = reach.toBytes();
+  sqlite3_bind_blob(stmt, 1, bytes.data(), bytes.size(), SQLITE_STATIC);
+  sqlite3_bind_int(stmt, 2, depth);
+  sqlite3_bind_int(stmt, 3, quack_id);
+
+  bool updated = sqlite3_step(stmt) == SQLITE_DONE;
+  sqlite3_finalize(stmt);
+
+  return updated;
 }
 
 /**
- * @brief Retrieves a list of users that a specified user is following.
- *
- * This method queries the database to find all user IDs of the users whom the 
- * specified user has chosen to follow.
+ * @brief Builds a quack's reach sketch from scratch by replaying its requacks.
  *
- * @param user_id The unique ID of the user whose following list is to be retrieved.
- * @return A vector of integers where each integer represents the unique ID of a user 
- *         that the specified user is following.
+ * The sketch starts as the author's followers. Each non-spam requack is then replayed
+ * in date order, working out the cascade depths of requacks that predate reach
+ * tracking and merging every requacker's follower sketch. Depths are worked out in
+ * memory, so a read can build the sketch without writing anything.
  *
- * @note If the user is not following anyone or if an error occurs during the query, 
- *       the method returns an empty vector.
+ * @param quack_id The unique ID of the quack.
+ * @param[out] reach The quack's reach sketch.
+ * @param[out] max_depth The deepest requack chain.
+ * @param store Whether to store the sketch, the depths and any follower sketch built
+ *              on the way; only inside a write.
+ * @return true if the sketch was built, and stored if asked; false if the quack does
+ *         not exist or an error occurred.
  */
-std::vector<int32_t> Pond::getFollows(const int32_t& user_id) {
-  std::vector<int32_t> results;
-
-  const char* query =
-  "SELECT flwee "
-  "FROM follows "
-  "WHERE flwer = ?";
+bool Pond::_buildReach(const int32_t& quack_id, HyperLogLog& reach, uint32_t& max_depth, const bool& store) {
+  const char* writer_query =
+    "SELECT writer_id FROM tweets WHERE tid = ?";
 
   sqlite3_stmt* stmt;
-  if (sqlite3_prepare_v2(this->_db, query, -1, &stmt, nullptr) != SQLITE_OK) {
+  if (sqlite3_prepare_v2(this->_db, writer_query, -1, &stmt, nullptr) != SQLITE_OK) {
     sqlite3_finalize(stmt);
-    return results;
+    return false;
   }
 
-  sqlite3_bind_int(stmt, 1, user_id);
+  sqlite3_bind_int(stmt, 1, quack_id);
+
+  bool found = sqlite3_step(stmt) == SQLITE_ROW;
+  int32_t writer_id = found ? sqlite3_column_int(stmt, 0) : 0;
+  sqlite3_finalize(stmt);
+  if (!found) {
+    return false;
+  }
+
+  reach = HyperLogLog();
+  if (!this->_loadFollowerSketch(writer_id, reach, store)) {
+    return false;
+  }
 
+  const char* requack_query =
+    "SELECT r.retweeter_id, c.depth "
+    "FROM retweets r "
+    "LEFT JOIN requack_cascades c ON c.tid = r.tid AND c.retweeter_id = r.retweeter_id "
+    "WHERE r.tid = ? AND r.spam = 0 "
+    "ORDER BY r.rdate";
+
+  if (sqlite3_prepare_v2(this->_db, requack_query, -1, &stmt, nullptr) != SQLITE_OK) {
+    sqlite3_finalize(stmt);
+    return false;
+  }
+
+  sqlite3_bind_int(stmt, 1, quack_id);
+
+  std::vector<std::pair<int32_t, uint32_t>> requacks;
+  std::unordered_map<int32_t, uint32_t> depths;
   while (sqlite3_step(stmt) == SQLITE_ROW) {
-    results.push_back(sqlite3_column_int(stmt, 0));
+    uint32_t depth = sqlite3_column_type(stmt, 1) == SQLITE_NULL ? 0 : sqlite3_column_int(stmt, 1);
+    requacks.push_back({sqlite3_column_int(stmt, 0), depth});
+    if (depth > 0) {
+      depths[requacks.back().first] = depth;
+    }
+  }
+  sqlite3_finalize(stmt);
+
+  const char* cascade_query =
+    "INSERT OR REPLACE INTO requack_cascades (tid, retweeter_id, depth) "
+    "VALUES (?, ?, ?)";
+
+  max_depth = 0;
+  for (auto& [retweeter_id, depth] : requacks) {
+    if (depth == 0) {
+      depth = this->_replayCascadeDepth(retweeter_id, writer_id, depths);
+      depths[retweeter_id] = depth;
+      if (store) {
+        if (sqlite3_prepare_v2(this->_db, cascade_query, -1, &stmt, nullptr) == SQLITE_OK) {
+          sqlite3_bind_int(stmt, 1, quack_id);
+          sqlite3_bind_int(stmt, 2, retweeter_id);
+          sqlite3_bind_int(stmt, 3, depth);
+          sqlite3_step(stmt);
+        }
+        sqlite3_finalize(stmt);
+      }
+    }
+    max_depth = std::max(max_depth, depth);
+
+    HyperLogLog followers;
+    if (this->_loadFollowerSketch(retweeter_id, followers, store)) {
+      reach.merge(followers);
+    }
+  }
+  if (!store) {
+    return true;
+  }
+
+  const char* store_query =
+    "INSERT OR REPLACE INTO quack_reach (tid, sketch, max_depth) "
+    "VALUES (?, ?, ?)";
+
+  if (sqlite3_prepare_v2(this->_db, store_query, -1, &stmt, nullptr) != SQLITE_OK) {
+    sqlite3_finalize(stmt);
+    return false;
   }
 
+  std::string bytes = reach.toBytes();
+  sqlite3_bind_int(stmt, 1, quack_id);
+  sqlite3_bind_blob(stmt, 2, bytes.data(), bytes.size(), SQLITE_STATIC);
+  sqlite3_bind_int(stmt, 3, max_depth);
+
+  bool stored = sqlite3_step(stmt) == SQLITE_DONE;
   sqlite3_finalize(stmt);
 
-  return results;
+  return stored;
 }
 
 /**
- * @brief Retrieves all quacks created by a specified user.
+ * @brief Works out the cascade depth of a requack being replayed, from the depths of
+ *        the quack's requacks known so far.
  *
- * This method queries the database to fetch all quacks (tweets) authored by the given 
- * user, sorted by date and time in descending order (most recent first).
- *
- * @param user_id The unique ID of the user whose quacks are to be retrieved.
- * @return A vector of `Pond::Quack` objects, where each object contains:
- *         - `tid`: The unique ID of the quack.
- *         - `writer_id`: The unique ID of the user who authored the quack.
- *         - `text`: The text content of the quack.
- *         - `date`: The date the quack was created (format: YYYY-MM-DD).
- *         - `time`: The time the quack was created (format: HH:MM:SS).
- *         - `replyto_tid`: The unique ID of the quack this quack is replying to, 
- *           or 0 if it is not a reply.
+ * The same rule as `_getCascadeDepth`, read from memory rather than `requack_cascades`,
+ * so depths replayed earlier count without having been written.
  *
- * @note If the user has not authored any quacks or if an error occurs during the query, 
- *       the method returns an empty vector.
+ * @param user_id The unique ID of the requacker.
+ * @param writer_id The unique ID of the quack's author.
+ * @param depths The depth of each requacker of the quack known so far.
+ * @return The cascade depth of the requack.
  */
-std::vector<Pond::Quack> Pond::getQuacks(const int32_t& user_id) {
-  std::vector<Pond::Quack> results;
-
+uint32_t Pond::_replayCascadeDepth(const int32_t& user_id, const int32_t& writer_id,
+                                   const std::unordered_map<int32_t, uint32_t>& depths) {
   const char* query =
-    "SELECT tid, writer_id, text, tdate, ttime, replyto_tid "
-    "FROM tweets "
-    "WHERE writer_id = ? "
-    "ORDER BY tdate DESC, ttime DESC";
+    "SELECT flwee FROM follow_graph WHERE flwer = ?";
 
   sqlite3_stmt* stmt;
   if (sqlite3_prepare_v2(this->_db, query, -1, &stmt, nullptr) != SQLITE_OK) {
     sqlite3_finalize(stmt);
-    return results;
+    return 1;
   }
 
   sqlite3_bind_int(stmt, 1, user_id);
 
+  uint32_t shallowest = 0;
   while (sqlite3_step(stmt) == SQLITE_ROW) {
-    Pond::Quack quack;
-    quack.tid =  sqlite3_column_int(stmt, 0);
-    quack.writer_id = sqlite3_column_int(stmt, 1);
-    quack.text = (const char*)(sqlite3_column_text(stmt, 2));
-    quack.date = (const char*)(sqlite3_column_text(stmt, 3));
-    quack.time = (const char*)(sqlite3_column_text(stmt, 4));
-    quack.replyto_tid = sqlite3_column_int(stmt, 5);
-
-    results.push_back(quack);
+    const int32_t followee = sqlite3_column_int(stmt, 0);
+    if (followee == writer_id) {
+      shallowest = 0;
+      break;
+    }
+    auto depth = depths.find(followee);
+    if (depth != depths.end() && (shallowest == 0 || depth->second < shallowest)) {
+      shallowest = depth->second;
+    }
   }
-
   sqlite3_finalize(stmt);
-  return results;
-}
 
-// =============================================================================
-// Private Methods
-// =============================================================================
+  return shallowest + 1;
+}
 
 /**
  * @brief Generates a unique ID for a new user by determining the maximum existing user ID.
@@ -1103,17 +4289,114 @@ bool Pond::_getUniqueQuackID(int32_t& unique_id) {
   return true;
 }
 
+/**
+ * @brief Bumps the current hour, day and month buckets of an activity by one.
+ *
+ * @param activity The kind of activity that just happened.
+ * @return true if the rollups were updated; false otherwise.
+ */
+bool Pond::_recordActivity(const Pond::Activity& activity) {
+  std::time_t rn = std::time(nullptr);
+  std::tm gmt;
+  char hour[14];
+  std::strftime(hour, sizeof(hour), "%F %H", gmtime_r(&rn, &gmt));
+  const std::string hour_bucket = hour;
+
+  const char* query =
+    "INSERT INTO activity_rollups (granularity, bucket, metric, count) "
+    "VALUES (0, ?1, ?4, 1), (1, ?2, ?4, 1), (2, ?3, ?4, 1) "
+    "ON CONFLICT (granularity, metric, bucket) DO UPDATE SET count = count + 1";
+
+  sqlite3_stmt* stmt;
+  if (sqlite3_prepare_v2(this->_db, query, -1, &stmt, nullptr) != SQLITE_OK) {
+    sqlite3_finalize(stmt);
+    return false;
+  }
+
+  const std::string day_bucket = hour_bucket.substr(0, 10);
+  const std::string month_bucket = hour_bucket.substr(0, 7);
+  sqlite3_bind_text(stmt, 1, hour_bucket.c_str(), -1, SQLITE_STATIC);
+  sqlite3_bind_text(stmt, 2, day_bucket.c_str(), -1, SQLITE_STATIC);
+  sqlite3_bind_text(stmt, 3, month_bucket.c_str(), -1, SQLITE_STATIC);
+  sqlite3_bind_text(stmt, 4, _activityName(activity), -1, SQLITE_STATIC);
+
+  bool recorded = sqlite3_step(stmt) == SQLITE_DONE;
+  sqlite3_finalize(stmt);
+
+  return recorded;
+}
+
+/**
+ * @brief Adds the sum of one bucket range to a running total.
+ *
+ * @param activity The kind of activity to sum.
+ * @param granularity The bucket size to read.
+ * @param from Inclusive first bucket key.
+ * @param to Exclusive last bucket key.
+ * @param[out] total The running total to add to.
+ * @return true if the range was read; false otherwise.
+ */
+bool Pond::_sumActivity(const Pond::Activity& activity, const Pond::Granularity& granularity, const std::string& from, const std::string& to, uint64_t& total) {
+  if (from >= to) {
+    return true;
+  }
+
+  const char* query =
+    "SELECT IFNULL(SUM(count), 0) "
+    "FROM activity_rollups "
+    "WHERE granularity = ? AND metric = ? AND bucket >= ? AND bucket < ?";
+
+  sqlite3_stmt* stmt;
+  if (sqlite3_prepare_v2(this->_db, query, -1, &stmt, nullptr) != SQLITE_OK) {
+    sqlite3_finalize(stmt);
+    return false;
+  }
+
+  sqlite3_bind_int(stmt, 1, static_cast<int>(granularity));
+  sqlite3_bind_text(stmt, 2, _activityName(activity), -1, SQLITE_STATIC);
+  sqlite3_bind_text(stmt, 3, from.c_str(), -1, SQLITE_STATIC);
+  sqlite3_bind_text(stmt, 4, to.c_str(), -1, SQLITE_STATIC);
+
+  bool summed = sqlite3_step(stmt) == SQLITE_ROW;
+  if (summed) {
+    total += sqlite3_column_int64(stmt, 0);
+  }
+
+  sqlite3_finalize(stmt);
+  return summed;
+}
+
+/**
+ * @brief Retrieves the name an activity is stored under in the rollup table.
+ *
+ * @param activity The kind of activity.
+ * @return The stored metric name.
+ */
+const char* Pond::_activityName(const Pond::Activity& activity) {
+  switch (activity) {
+    case Activity::QUACKS:           return "quacks";
+    case Activity::REPLIES:          return "replies";
+    case Activity::REQUACKS:         return "requacks";
+    case Activity::SPAM_REQUACKS:    return "spam_requacks";
+    case Activity::NEW_USERS:        return "new_users";
+    case Activity::FOLLOWS:          return "follows";
+    case Activity::HASHTAG_MENTIONS: return "hashtag_mentions";
+  }
+  return "";
+}
+
 /**
  * @brief Retrieves the current time in GMT as a formatted string (HH:MM:SS).
  *
  * @return A string representing the current time in "HH:MM:SS" format.
  */
-char* Pond::_getTime() {
+std::string Pond::_getTime() {
   std::time_t rn = std::time(nullptr);
-  std::tm* gmt = std::gmtime(&rn);
+  std::tm gmt;
+  gmtime_r(&rn, &gmt);
 
-  char* t = new char[9];
-  std::strftime(t, 9, "%H:%M:%S", gmt);
+  char t[9];
+  std::strftime(t, sizeof(t), "%H:%M:%S", &gmt);
 
   return t;
 }
@@ -1123,13 +4406,14 @@ char* Pond::_getTime() {
  *
  * @return A string representing the current date in "YYYY-MM-DD" format.
  */
-char* Pond::_getDate() {
+std::string Pond::_getDate() {
   std::time_t rn = std::time(nullptr);
-  std::tm* gmt = std::gmtime(&rn);
+  std::tm gmt;
+  gmtime_r(&rn, &gmt);
 
-  char* t = new char[11];
+  char t[11];
   // yyyy-mm-dd
-  std::strftime(t, 11, "%F", gmt);
+  std::strftime(t, sizeof(t), "%F", &gmt);
 
   return t;
 }
@@ -1148,7 +4432,9 @@ char* Pond::_getDate() {
 bool Pond::_listExists(const std::string &list_name, const int32_t &user_id) {
   bool exists = false;
 
-  const char* query = "SELECT 1 FROM lists WHERE owner_id = ? AND lname = ?";
+  const char* query =
+    "SELECT 1 FROM lists WHERE owner_id = ?1 AND lname = ?2 "
+    "AND NOT EXISTS (SELECT 1 FROM tombstones WHERE kind = 2 AND id = ?1 AND lname = ?2)";
 
   sqlite3_stmt* stmt;
   if (sqlite3_prepare_v2(this->_db, query, -1, &stmt, nullptr) != SQLITE_OK) {
@@ -1172,6 +4458,97 @@ bool Pond::_listExists(const std::string &list_name, const int32_t &user_id) {
   }
 }
 
+/**
+ * @brief Checks whether a quack or user exists and has not been deleted.
+ *
+ * A quack is also gone once its author or the quack it replies to is deleted.
+ *
+ * @param kind `DeletedKind::QUACK` or `DeletedKind::USER`.
+ * @param id The quack or user ID.
+ * @return true if the quack or user can be read.
+ */
+bool Pond::_isLive(const Pond::DeletedKind& kind, const int32_t& id) {
+  const char* query = kind == DeletedKind::QUACK
+    ? "SELECT 1 FROM live_tweets WHERE tid = ?"
+    : "SELECT 1 FROM live_users WHERE usr = ?";
+
+  sqlite3_stmt* stmt;
+  if (sqlite3_prepare_v2(this->_db, query, -1, &stmt, nullptr) != SQLITE_OK) {
+    sqlite3_finalize(stmt);
+    return false;
+  }
+  sqlite3_bind_int(stmt, 1, id);
+  const bool live = sqlite3_step(stmt) == SQLITE_ROW;
+  sqlite3_finalize(stmt);
+  return live;
+}
+
+/**
+ * @brief Records a deletion of a user or a list, hiding the deleted rows from every read.
+ *
+ * The tombstone is a single row, so deleting even the busiest user holds the write
+ * lock no longer than any other write. Lists are in no index, so deleting one leaves
+ * the shared indexes current; the caller takes anything else out of them.
+ *
+ * @param query An `INSERT OR IGNORE INTO tombstones` statement.
+ * @param bind Binds the statement's parameters.
+ * @return true if a tombstone was added; false if there was nothing to delete.
+ */
+bool Pond::_addTombstone(const char* query, const std::function<void(sqlite3_stmt*)>& bind) {
+  bool own_transaction;
+  if (!this->_beginWrite(own_transaction)) {
+    return false;
+  }
+
+  sqlite3_stmt* stmt;
+  if (sqlite3_prepare_v2(this->_db, query, -1, &stmt, nullptr) != SQLITE_OK) {
+    std::cerr << "SQL Error (delete): " << sqlite3_errmsg(this->_db) << std::endl;
+    sqlite3_finalize(stmt);
+    return this->_endWrite(own_transaction, false);
+  }
+  bind(stmt);
+
+  bool deleted = false;
+  if (sqlite3_step(stmt) != SQLITE_DONE) {
+    std::cerr << "SQL Error (delete): " << sqlite3_errmsg(this->_db) << std::endl;
+  } else {
+    deleted = sqlite3_changes(this->_db) > 0;
+  }
+  sqlite3_finalize(stmt);
+
+  if (deleted) {
+    this->_invalidateCaches();
+  }
+  return this->_endWrite(own_transaction, deleted);
+}
+
+/**
+ * @brief Takes the notifications a deletion is about to hide out of their users'
+ *        unread counts, so the badge never counts what the inbox no longer shows.
+ *
+ * Must run in the deletion's write, before its tombstones are added.
+ *
+ * @param match The condition on `live_notifications n` selecting the notifications,
+ *        with the deleted ID as `?1`.
+ * @param id The ID of the deleted quack or user.
+ * @return true if the counts were adjusted; false if the write failed.
+ */
+bool Pond::_hideNotifications(const std::string& match, const int32_t& id) {
+  sqlite3_stmt* stmt;
+  if (sqlite3_prepare_v2(this->_db, hideNotificationsQuery(match).c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
+    std::cerr << "SQL Error (delete): " << sqlite3_errmsg(this->_db) << std::endl;
+    sqlite3_finalize(stmt);
+    return false;
+  }
+  sqlite3_bind_int(stmt, 1, id);
+  const bool adjusted = sqlite3_step(stmt) == SQLITE_DONE;
+  if (!adjusted) {
+    std::cerr << "SQL Error (delete): " << sqlite3_errmsg(this->_db) << std::endl;
+  }
+  sqlite3_finalize(stmt);
+  return adjusted;
+}
+
 /**
  * @brief Formats a tweet's text to fit within a specified line width.
  *
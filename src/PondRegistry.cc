@@ -0,0 +1,502 @@
+#include "PondRegistry.hh"
+
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+
+#include "CacheManager.hh"
+
+/**
+ * @brief Checks that a tenant name is safe to use in file names and protocol lines.
+ *
+ * @param name The name.
+ * @return true if the name is 1 to 64 letters, digits, `-` or `_`.
+ */
+static bool validName(const std::string& name) {
+  if (name.empty() || name.size() > 64) {
+    return false;
+  }
+  return std::all_of(name.begin(), name.end(), [](const char& c) {
+    return std::isalnum(static_cast<unsigned char>(c)) || c == '-' || c == '_';
+  });
+}
+
+/**
+ * @brief Purges one batch of deleted rows; queued again until nothing is left.
+ */
+static bool purgeStep(Pond& pond) {
+  return pond.purgeDeleted() > 0;
+}
+
+// =============================================================================
+// Public Methods
+// =============================================================================
+
+/**
+ * @brief Starts the I/O threads; no tenant is registered yet.
+ *
+ * @param options The configuration of the registry.
+ */
+PondRegistry::PondRegistry(const Options& options)
+  : _options(options) {
+  for (uint32_t i = 0; i < std::max(this->_options.io_threads, 1u); ++i) {
+    this->_threads.emplace_back(&PondRegistry::_work, this);
+  }
+}
+
+/**
+ * @brief Finishes every queued call, drops queued background jobs, then stops the
+ *        I/O threads and closes every connection.
+ */
+PondRegistry::~PondRegistry() {
+  {
+    std::lock_guard<std::mutex> lock(this->_lock);
+    this->_stopping = true;
+  }
+  this->_ready_cv.notify_all();
+  for (std::thread& thread : this->_threads) {
+    thread.join();
+  }
+
+  for (auto& [name, tenant] : this->_tenants) {
+    tenant->idle.clear();
+    tenant->shared = {};
+    CacheManager::shared().removeGroup(tenant->cache_group);
+  }
+}
+
+/**
+ * @brief Registers a tenant with the default quota.
+ *
+ * @param name The tenant's name: letters, digits, `-` and `_`.
+ * @param db_filename The tenant's database file; it is not opened yet.
+ * @return true if the tenant was added; false if the name is invalid or taken.
+ */
+bool PondRegistry::add(const std::string& name, const std::string& db_filename) {
+  return this->add(name, db_filename, this->_options.quota);
+}
+
+/**
+ * @brief Registers a tenant.
+ *
+ * @param name The tenant's name: letters, digits, `-` and `_`.
+ * @param db_filename The tenant's database file; it is not opened yet.
+ * @param quota The tenant's quota.
+ * @return true if the tenant was added; false if the name is invalid or taken.
+ */
+bool PondRegistry::add(const std::string& name, const std::string& db_filename, const Quota& quota) {
+  if (!validName(name)) {
+    return false;
+  }
+
+  std::lock_guard<std::mutex> lock(this->_lock);
+  if (this->_tenants.count(name)) {
+    return false;
+  }
+  std::unique_ptr<Tenant> tenant = std::make_unique<Tenant>();
+  tenant->name = name;
+  tenant->db_filename = db_filename;
+  tenant->quota = quota;
+  tenant->quota.max_connections = std::max(quota.max_connections, 1u);
+  tenant->facade = std::make_unique<AsyncPond>(*this, name);
+  tenant->cache_group = CacheManager::shared().addGroup(quota.cache_bytes);
+  tenant->stats.name = name;
+  this->_tenants.emplace(name, std::move(tenant));
+  return true;
+}
+
+/**
+ * @brief Registers every `<name>.db` file of a directory as tenant `<name>`.
+ *
+ * Files whose name is not a valid tenant name are skipped.
+ *
+ * @param directory The directory.
+ * @return The number of tenants added.
+ */
+size_t PondRegistry::addDirectory(const std::string& directory) {
+  size_t added = 0;
+  std::error_code error;
+  for (const auto& entry : std::filesystem::directory_iterator(directory, error)) {
+    if (entry.is_regular_file() && entry.path().extension() == ".db" &&
+        this->add(entry.path().stem().string(), entry.path().string())) {
+      ++added;
+    }
+  }
+  if (error) {
+    std::cerr << "Registry Error: Can't list " << directory << " (" << error.message() << ")" << std::endl;
+  }
+  return added;
+}
+
+/**
+ * @brief Retrieves the facade through which a tenant is called.
+ *
+ * @param name The tenant's name.
+ * @return The facade, valid for the registry's lifetime, or nullptr if there is no
+ *         such tenant.
+ */
+AsyncPond* PondRegistry::tenant(const std::string& name) {
+  std::lock_guard<std::mutex> lock(this->_lock);
+  auto it = this->_tenants.find(name);
+  return it == this->_tenants.end() ? nullptr : it->second->facade.get();
+}
+
+/**
+ * @brief Retrieves the names of every tenant.
+ *
+ * @return The names, sorted.
+ */
+std::vector<std::string> PondRegistry::tenants() const {
+  std::lock_guard<std::mutex> lock(this->_lock);
+  std::vector<std::string> names;
+  names.reserve(this->_tenants.size());
+  for (const auto& [name, tenant] : this->_tenants) {
+    names.push_back(name);
+  }
+  return names;
+}
+
+/**
+ * @brief Queues a background job for a tenant, run when no call is waiting.
+ *
+ * @param name The tenant's name.
+ * @param step Called with one of the tenant's connections; returning true queues
+ *             it again, e.g. until a purge has nothing left.
+ * @return true if the job was queued; false if there is no such tenant.
+ */
+bool PondRegistry::background(const std::string& name, std::function<bool(Pond&)> step) {
+  std::lock_guard<std::mutex> lock(this->_lock);
+  auto it = this->_tenants.find(name);
+  if (it == this->_tenants.end()) {
+    return false;
+  }
+  it->second->background.push_back(std::move(step));
+  this->_schedule(*it->second);
+  return true;
+}
+
+/**
+ * @brief Queues a background purge of a tenant's deleted rows.
+ *
+ * @param name The tenant's name.
+ * @return true if the purge was queued; false if there is no such tenant.
+ */
+bool PondRegistry::purge(const std::string& name) {
+  return this->background(name, purgeStep);
+}
+
+/**
+ * @brief Closes every connection idle for longer than `Options::idle_timeout`.
+ *
+ * Called by the I/O threads when they have been idle themselves; calling it directly
+ * is only needed to reclaim memory at once.
+ *
+ * @return The number of connections closed.
+ */
+size_t PondRegistry::closeIdle() {
+  std::vector<std::unique_ptr<Pond>> closed;
+  std::vector<Shared> released;
+  {
+    std::lock_guard<std::mutex> lock(this->_lock);
+    this->_closeIdle(Clock::now() - this->_options.idle_timeout, 0, closed, released);
+  }
+  return closed.size();
+}
+
+/**
+ * @brief Retrieves the counters of the registry and every tenant.
+ *
+ * @return A snapshot of the counters.
+ */
+PondRegistry::Stats PondRegistry::stats() const {
+  std::lock_guard<std::mutex> lock(this->_lock);
+  Stats stats;
+  stats.open = this->_open;
+  stats.opens = this->_opens;
+  stats.closes = this->_closes;
+  for (const auto& [name, tenant] : this->_tenants) {
+    TenantStats tenant_stats = tenant->stats;
+    tenant_stats.open = tenant->open;
+    tenant_stats.busy = tenant->busy;
+    tenant_stats.queued = tenant->jobs.size();
+    tenant_stats.cache_bytes = tenant->shared.caches ? tenant->shared.caches->bytes() : 0;
+    stats.tenants.push_back(std::move(tenant_stats));
+  }
+  return stats;
+}
+
+/**
+ * @brief Prints the counters as a table, one row per tenant.
+ *
+ * @param out The stream to print to.
+ */
+void PondRegistry::report(std::ostream& out) const {
+  const Stats stats = this->stats();
+  out << stats.tenants.size() << " tenants, " << stats.open << " connections open; "
+      << stats.opens << " opened, " << stats.closes << " closed\n";
+  out << std::left << std::setw(20) << "tenant" << std::right
+      << std::setw(10) << "calls" << std::setw(12) << "background" << std::setw(13) << "avg wait ms"
+      << std::setw(8) << "queued" << std::setw(6) << "open" << std::setw(6) << "busy"
+      << std::setw(8) << "opens" << std::setw(8) << "closes" << std::setw(10) << "failures"
+      << std::setw(11) << "cache KiB" << "\n";
+  for (const TenantStats& tenant : stats.tenants) {
+    out << std::left << std::setw(20) << tenant.name << std::right
+        << std::setw(10) << tenant.calls << std::setw(12) << tenant.background
+        << std::setw(13) << std::fixed << std::setprecision(2) << (tenant.calls ? tenant.wait_ms / tenant.calls : 0.0)
+        << std::setw(8) << tenant.queued << std::setw(6) << tenant.open << std::setw(6) << tenant.busy
+        << std::setw(8) << tenant.opens << std::setw(8) << tenant.closes << std::setw(10) << tenant.failures
+        << std::setw(11) << (tenant.cache_bytes + 512) / 1024 << "\n";
+  }
+}
+
+// =============================================================================
+// Private Methods
+// =============================================================================
+
+/**
+ * @brief Queues a call for a tenant; called by the tenant's facade.
+ *
+ * @param name The tenant's name.
+ * @param job Called with one of the tenant's connections, or nullptr if none could
+ *            be opened.
+ */
+void PondRegistry::_submit(const std::string& name, std::function<void(Pond*)> job) {
+  {
+    std::lock_guard<std::mutex> lock(this->_lock);
+    auto it = this->_tenants.find(name);
+    if (it != this->_tenants.end()) {
+      it->second->jobs.push_back({std::move(job), Clock::now()});
+      this->_schedule(*it->second);
+      return;
+    }
+  }
+  // Facades are only handed out for registered tenants, which are never removed
+  job(nullptr);
+}
+
+/**
+ * @brief Retrieves the number of calls queued for a tenant.
+ *
+ * @param name The tenant's name.
+ * @return The queue length.
+ */
+size_t PondRegistry::_queued(const std::string& name) const {
+  std::lock_guard<std::mutex> lock(this->_lock);
+  auto it = this->_tenants.find(name);
+  return it == this->_tenants.end() ? 0 : it->second->jobs.size();
+}
+
+/**
+ * @brief Puts a tenant in the ready queues it has work for; the caller holds `_lock`.
+ *
+ * A tenant whose connections are all busy waits out of the queues; finishing one of
+ * its calls schedules it again.
+ *
+ * @param tenant The tenant.
+ */
+void PondRegistry::_schedule(Tenant& tenant) {
+  if (tenant.busy >= tenant.quota.max_connections) {
+    return;
+  }
+  if (!tenant.jobs.empty() && !tenant.ready) {
+    tenant.ready = true;
+    this->_ready.push_back(&tenant);
+    this->_ready_cv.notify_one();
+  }
+  if (!tenant.background.empty() && !tenant.background_ready) {
+    tenant.background_ready = true;
+    this->_background_ready.push_back(&tenant);
+    this->_ready_cv.notify_one();
+  }
+}
+
+/**
+ * @brief Opens a connection for a tenant, outside `_lock`.
+ *
+ * @param tenant The tenant.
+ * @param shared The tenant's caches and indexes.
+ * @return The connection, or nullptr if it could not be opened.
+ */
+std::unique_ptr<Pond> PondRegistry::_connect(const Tenant& tenant, const Shared& shared) {
+  std::unique_ptr<Pond> pond = std::make_unique<Pond>();
+  if (pond->loadDatabase(tenant.db_filename)) {
+    std::cerr << "Registry Error: Can't open database of tenant " << tenant.name << std::endl;
+    return nullptr;
+  }
+  pond->setPageCacheLimit(tenant.quota.page_cache_kib);
+  pond->setCaches(shared.caches, true);
+  pond->setIndexes(shared.indexes);
+  return pond;
+}
+
+/**
+ * @brief Closes idle connections, least recently used first; the caller holds `_lock`.
+ *
+ * A tenant left with no open connection also gives up its caches and indexes.
+ *
+ * @param idle_before Close connections last used before this time.
+ * @param excess Also close this many more, whenever they were last used.
+ * @param[out] closed Receives the closed connections, destroyed outside `_lock`.
+ * @param[out] released Receives the released caches and indexes, destroyed outside `_lock`.
+ */
+void PondRegistry::_closeIdle(const Clock::time_point& idle_before, size_t excess,
+                              std::vector<std::unique_ptr<Pond>>& closed,
+                              std::vector<Shared>& released) {
+  std::vector<std::pair<Clock::time_point, Tenant*>> candidates;
+  for (auto& [name, tenant] : this->_tenants) {
+    for (const Connection& connection : tenant->idle) {
+      candidates.emplace_back(connection.last_used, tenant.get());
+    }
+  }
+  std::sort(candidates.begin(), candidates.end(), [](const auto& a, const auto& b) {
+    return a.first < b.first;
+  });
+
+  // Each tenant's idle connections are in the order they were last used, so the
+  // globally oldest one of a tenant is always at the front of its list
+  for (const auto& [last_used, tenant] : candidates) {
+    if (last_used >= idle_before && excess == 0) {
+      break;
+    }
+    if (excess > 0) {
+      --excess;
+    }
+    closed.push_back(std::move(tenant->idle.front().pond));
+    tenant->idle.erase(tenant->idle.begin());
+    --tenant->open;
+    --this->_open;
+    ++this->_closes;
+    ++tenant->stats.closes;
+    if (tenant->open == 0 && tenant->shared.caches) {
+      released.push_back(std::move(tenant->shared));
+    }
+  }
+}
+
+/**
+ * @brief Runs calls and background jobs on one I/O thread until the registry is
+ *        destroyed.
+ *
+ * Tenants with a queued call are served first, in turn; background jobs only run when
+ * no call is waiting. A connection is taken from the tenant's idle list, or opened if
+ * there is none, and returned to the list after the call. A thread that waits a whole
+ * `idle_timeout` for work closes the connections that have been idle as long.
+ */
+void PondRegistry::_work() {
+  std::unique_lock<std::mutex> lock(this->_lock);
+  while (true) {
+    if (this->_ready.empty() && (this->_stopping || this->_background_ready.empty())) {
+      if (this->_stopping) {
+        return;
+      }
+      const bool woken = this->_ready_cv.wait_for(lock, this->_options.idle_timeout, [this] {
+        return this->_stopping || !this->_ready.empty() || !this->_background_ready.empty();
+      });
+      if (!woken) {
+        std::vector<std::unique_ptr<Pond>> closed;
+        std::vector<Shared> released;
+        this->_closeIdle(Clock::now() - this->_options.idle_timeout, 0, closed, released);
+        lock.unlock();
+        closed.clear();
+        released.clear();
+        lock.lock();
+      }
+      continue;
+    }
+
+    const bool background = this->_ready.empty();
+    std::deque<Tenant*>& queue = background ? this->_background_ready : this->_ready;
+    Tenant* tenant = queue.front();
+    queue.pop_front();
+    (background ? tenant->background_ready : tenant->ready) = false;
+    if (tenant->busy >= tenant->quota.max_connections) {
+      continue;
+    }
+
+    Job job;
+    std::function<bool(Pond&)> step;
+    if (background) {
+      step = std::move(tenant->background.front());
+      tenant->background.pop_front();
+      ++tenant->stats.background;
+    } else {
+      job = std::move(tenant->jobs.front());
+      tenant->jobs.pop_front();
+      ++tenant->stats.calls;
+      tenant->stats.wait_ms += std::chrono::duration<double, std::milli>(Clock::now() - job.queued).count();
+    }
+
+    ++tenant->busy;
+    std::unique_ptr<Pond> pond;
+    Shared shared;
+    if (!tenant->idle.empty()) {
+      pond = std::move(tenant->idle.back().pond);
+      tenant->idle.pop_back();
+    } else {
+      if (!tenant->shared.caches) {
+        tenant->shared.caches = std::make_shared<Pond::Caches>(tenant->cache_group);
+        tenant->shared.indexes = std::make_shared<Pond::Indexes>();
+      }
+      shared = tenant->shared;
+      ++tenant->open;
+      ++this->_open;
+    }
+    this->_schedule(*tenant);
+
+    // Make room under `max_open` by closing the least recently used idle connections
+    std::vector<std::unique_ptr<Pond>> closed;
+    std::vector<Shared> released;
+    if (this->_open > this->_options.max_open) {
+      this->_closeIdle(Clock::time_point::min(), this->_open - this->_options.max_open, closed, released);
+    }
+    lock.unlock();
+    closed.clear();
+    released.clear();
+
+    const bool opening = !pond;
+    if (opening) {
+      pond = this->_connect(*tenant, shared);
+      shared = {};
+    }
+    bool again = false;
+    if (background) {
+      again = pond && step(*pond);
+    } else {
+      job.run(pond.get());
+    }
+
+    lock.lock();
+    --tenant->busy;
+    if (pond) {
+      tenant->idle.push_back({std::move(pond), Clock::now()});
+      if (opening) {
+        ++tenant->stats.opens;
+        ++this->_opens;
+      }
+    } else {
+      --tenant->open;
+      --this->_open;
+      ++tenant->stats.failures;
+      if (tenant->open == 0) {
+        released.push_back(std::move(tenant->shared));
+      }
+    }
+    if (again && !this->_stopping) {
+      tenant->background.push_back(std::move(step));
+    }
+    // Deletions left over from an earlier run are purged once the tenant is in use
+    if (opening && tenant->open > 0 && !tenant->resumed) {
+      tenant->resumed = true;
+      tenant->background.push_back(purgeStep);
+    }
+    this->_schedule(*tenant);
+
+    if (!released.empty()) {
+      lock.unlock();
+      released.clear();
+      lock.lock();
+    }
+  }
+}
@@ -0,0 +1,154 @@
+#include "Prefetcher.hh"
+
+// =============================================================================
+// Public Methods
+// =============================================================================
+
+/**
+ * @brief Constructs a prefetcher; no connection is opened until the first prefetch.
+ *
+ * @param db_filename The database the foreground Pond has open.
+ * @param caches The foreground Pond's caches, filled by the prefetches.
+ * @param scheduler The scheduler prefetches run on.
+ */
+Prefetcher::Prefetcher(const std::string& db_filename, std::shared_ptr<Pond::Caches> caches, TaskScheduler& scheduler)
+  : _db_filename(db_filename), _caches(std::move(caches)), _scheduler(scheduler) {}
+
+/**
+ * @brief Drops the waiting prefetches and waits for the running one to finish.
+ */
+Prefetcher::~Prefetcher() {
+  std::unique_lock<std::mutex> lock(this->_lock);
+  this->_pending.clear();
+  this->_idle.wait(lock, [this] {
+    return !this->_draining;
+  });
+}
+
+/**
+ * @brief Loads what the main page of a session shows first: the user's name, feed
+ *        and followers.
+ *
+ * Meant to be called as soon as the user ID is known, so the feed query overlaps the
+ * password prompt and the credential check. Nothing is shown until login succeeds.
+ *
+ * @param user_id The user logging in.
+ * @param mode The feed mode the main page opens in.
+ */
+void Prefetcher::prefetchSession(const int32_t& user_id, const Pond::FeedMode& mode) {
+  this->_enqueue([user_id, mode](Pond& pond) {
+    pond.getFeedEntries(user_id, mode);
+    pond.getUsername(user_id);
+    pond.getFollowers(user_id);
+  });
+}
+
+/**
+ * @brief Loads a user's feed.
+ *
+ * @param user_id The user whose feed is loaded.
+ * @param mode The feed mode.
+ */
+void Prefetcher::prefetchFeed(const int32_t& user_id, const Pond::FeedMode& mode) {
+  this->_enqueue([user_id, mode](Pond& pond) {
+    pond.getFeedEntries(user_id, mode);
+  });
+}
+
+/**
+ * @brief Loads what a user's profile page shows: name, followers, follows and quacks.
+ *
+ * Each profile is its own prefetch, queued so the first user listed runs first.
+ *
+ * @param user_ids The users whose profiles are loaded, most likely first.
+ */
+void Prefetcher::prefetchProfiles(const std::vector<int32_t>& user_ids) {
+  for (auto user_id = user_ids.rbegin(); user_id != user_ids.rend(); ++user_id) {
+    this->_enqueue([user_id = *user_id](Pond& pond) {
+      pond.getUsername(user_id);
+      pond.getFollowers(user_id);
+      pond.getFollows(user_id);
+      pond.getQuacks(user_id);
+    });
+  }
+}
+
+/**
+ * @brief Blocks until no prefetch is waiting or running.
+ */
+void Prefetcher::wait() {
+  std::unique_lock<std::mutex> lock(this->_lock);
+  this->_idle.wait(lock, [this] {
+    return !this->_draining;
+  });
+}
+
+// =============================================================================
+// Private Methods
+// =============================================================================
+
+/**
+ * @brief Queues a prefetch and starts a drain task if none is running.
+ *
+ * The queue is a stack: the user has usually moved on from older hints, so the newest
+ * runs first and the oldest is dropped once `MAX_PENDING` are waiting. One drain task
+ * at a time keeps the single prefetch connection on one thread.
+ *
+ * @param job The prefetch, run with the prefetch connection.
+ */
+void Prefetcher::_enqueue(std::function<void(Pond&)> job) {
+  {
+    std::lock_guard<std::mutex> lock(this->_lock);
+    if (this->_unavailable) {
+      return;
+    }
+    this->_pending.push_front(std::move(job));
+    if (this->_pending.size() > MAX_PENDING) {
+      this->_pending.pop_back();
+    }
+    if (this->_draining) {
+      return;
+    }
+    this->_draining = true;
+  }
+  this->_scheduler.submit([this] {
+    this->_drain();
+  }, TaskScheduler::Priority::BACKGROUND);
+}
+
+/**
+ * @brief Runs queued prefetches until the queue is empty.
+ *
+ * If the prefetch connection cannot be opened, prefetching is turned off for good;
+ * the foreground Pond still answers every query itself.
+ */
+void Prefetcher::_drain() {
+  if (!this->_pond) {
+    std::unique_ptr<Pond> pond = std::make_unique<Pond>();
+    if (pond->loadDatabase(this->_db_filename)) {
+      std::lock_guard<std::mutex> lock(this->_lock);
+      this->_unavailable = true;
+      this->_pending.clear();
+      this->_draining = false;
+      this->_idle.notify_all();
+      return;
+    }
+    pond->setCaches(this->_caches);
+    this->_pond = std::move(pond);
+  }
+
+  while (true) {
+    std::function<void(Pond&)> job;
+    {
+      std::lock_guard<std::mutex> lock(this->_lock);
+      if (this->_pending.empty()) {
+        this->_draining = false;
+        this->_idle.notify_all();
+        return;
+      }
+      job = std::move(this->_pending.front());
+      this->_pending.pop_front();
+    }
+    job(*this->_pond);
+  }
+}
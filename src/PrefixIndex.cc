@@ -0,0 +1,263 @@
+#include "PrefixIndex.hh"
+
+#include <algorithm>
+
+// =============================================================================
+// Public Methods
+// =============================================================================
+
+/**
+ * @brief Constructs an empty index.
+ */
+PrefixIndex::PrefixIndex() {
+  this->clear();
+}
+
+/**
+ * @brief Adds to the weight of a term, inserting the term if needed.
+ *
+ * Weights never drop below zero; a term whose weight reaches zero stays completable.
+ * Only the nodes between the root and the term are refreshed, deepest first, because
+ * no other node's cache can contain the term.
+ *
+ * @param key The normalized key the term is looked up by.
+ * @param display The form of the term returned by completions.
+ * @param delta The change in weight.
+ */
+void PrefixIndex::add(const std::string& key, const std::string& display, const int64_t& delta) {
+  std::vector<uint32_t> path;
+  this->_insert(key, path);
+
+  Node& node = this->_nodes[path.back()];
+  if (node.term < 0) {
+    node.term = static_cast<int32_t>(this->_terms.size());
+    this->_terms.push_back({display, 0});
+  }
+
+  Term& term = this->_terms[node.term];
+  if (delta < 0 && static_cast<uint64_t>(-delta) > term.weight) {
+    term.weight = 0;
+  } else {
+    term.weight += delta;
+  }
+
+  for (auto it = path.rbegin(); it != path.rend(); ++it) {
+    this->_refresh(*it);
+  }
+}
+
+/**
+ * @brief Retrieves the heaviest terms whose key starts with a prefix.
+ *
+ * Up to `TOP_K` completions are served straight from the cache of the node the prefix
+ * ends in. Larger requests collect every term below that node instead.
+ *
+ * @param prefix The normalized prefix to complete.
+ * @param k The maximum number of completions to return.
+ * @return The completions, heaviest first.
+ */
+std::vector<PrefixIndex::Entry> PrefixIndex::complete(const std::string& prefix, const uint32_t& k) const {
+  std::vector<PrefixIndex::Entry> completions;
+
+  // The prefix may end part-way along an edge; the node below it covers the same terms
+  uint32_t node = 0;
+  size_t pos = 0;
+  while (pos < prefix.size()) {
+    int64_t child = this->_findChild(node, prefix[pos]);
+    if (child < 0) {
+      return completions;
+    }
+    const std::string& label = this->_nodes[child].label;
+    size_t length = std::min(label.size(), prefix.size() - pos);
+    if (label.compare(0, length, prefix, pos, length) != 0) {
+      return completions;
+    }
+    pos += length;
+    node = static_cast<uint32_t>(child);
+  }
+
+  std::vector<uint32_t> terms;
+  if (k <= TOP_K) {
+    const std::vector<uint32_t>& top = this->_nodes[node].top;
+    terms.assign(top.begin(), top.begin() + std::min<size_t>(k, top.size()));
+  } else {
+    std::vector<uint32_t> stack = {node};
+    while (!stack.empty()) {
+      const Node& current = this->_nodes[stack.back()];
+      stack.pop_back();
+      if (current.term >= 0) {
+        terms.push_back(current.term);
+      }
+      stack.insert(stack.end(), current.children.begin(), current.children.end());
+    }
+    auto middle = terms.begin() + std::min<size_t>(k, terms.size());
+    std::partial_sort(terms.begin(), middle, terms.end(), [this](const uint32_t& a, const uint32_t& b) {
+      return this->_ranksBefore(a, b);
+    });
+    terms.erase(middle, terms.end());
+  }
+
+  for (const uint32_t& term : terms) {
+    completions.push_back({this->_terms[term].display, this->_terms[term].weight});
+  }
+  return completions;
+}
+
+/**
+ * @brief Removes every term from the index.
+ */
+void PrefixIndex::clear() {
+  this->_nodes.assign(1, Node());
+  this->_terms.clear();
+}
+
+/**
+ * @brief Retrieves the number of terms in the index.
+ *
+ * @return The number of distinct keys added.
+ */
+size_t PrefixIndex::size() const {
+  return this->_terms.size();
+}
+
+/**
+ * @brief Estimates the heap memory held by the index.
+ *
+ * String capacities are counted in full even when they fit in the small-string buffer,
+ * so the estimate errs on the high side.
+ *
+ * @return The approximate number of bytes used by nodes, labels, caches and terms.
+ */
+size_t PrefixIndex::memoryUsage() const {
+  size_t bytes = this->_nodes.capacity() * sizeof(Node) + this->_terms.capacity() * sizeof(Term);
+  for (const Node& node : this->_nodes) {
+    bytes += (node.children.capacity() + node.top.capacity()) * sizeof(uint32_t);
+    bytes += node.label.capacity();
+  }
+  for (const Term& term : this->_terms) {
+    bytes += term.display.capacity();
+  }
+  return bytes;
+}
+
+// =============================================================================
+// Private Methods
+// =============================================================================
+
+/**
+ * @brief Walks to the node of a key, creating and splitting nodes along the way.
+ *
+ * When the key diverges part-way along an edge, the edge is split at the divergence
+ * point so that both the old suffix and the new one hang off a shared node.
+ *
+ * @param key The key to insert.
+ * @param[out] path The nodes from the root to the key's node.
+ */
+void PrefixIndex::_insert(const std::string& key, std::vector<uint32_t>& path) {
+  uint32_t node = 0;
+  size_t pos = 0;
+  path.push_back(node);
+
+  while (pos < key.size()) {
+    int64_t child = this->_findChild(node, key[pos]);
+
+    // No edge starts with the next byte: the rest of the key becomes a new leaf
+    if (child < 0) {
+      uint32_t leaf = static_cast<uint32_t>(this->_nodes.size());
+      this->_nodes.push_back(Node());
+      this->_nodes[leaf].label = key.substr(pos);
+
+      std::vector<uint32_t>& children = this->_nodes[node].children;
+      auto at = std::lower_bound(children.begin(), children.end(), key[pos], [this](const uint32_t& c, const char& byte) {
+        return this->_nodes[c].label[0] < byte;
+      });
+      children.insert(at, leaf);
+      path.push_back(leaf);
+      return;
+    }
+
+    const std::string& label = this->_nodes[child].label;
+    size_t common = 0;
+    while (common < label.size() && pos + common < key.size() && label[common] == key[pos + common]) {
+      ++common;
+    }
+
+    // The key leaves the edge part-way: split it at the divergence point
+    if (common < label.size()) {
+      uint32_t middle = static_cast<uint32_t>(this->_nodes.size());
+      this->_nodes.push_back(Node());
+      this->_nodes[middle].label = this->_nodes[child].label.substr(0, common);
+      this->_nodes[middle].children.push_back(static_cast<uint32_t>(child));
+      this->_nodes[child].label.erase(0, common);
+
+      std::vector<uint32_t>& children = this->_nodes[node].children;
+      *std::find(children.begin(), children.end(), static_cast<uint32_t>(child)) = middle;
+      child = middle;
+    }
+
+    node = static_cast<uint32_t>(child);
+    pos += common;
+    path.push_back(node);
+  }
+}
+
+/**
+ * @brief Finds the child of a node whose label starts with a byte.
+ *
+ * Children are kept sorted by their first byte, so this is a binary search.
+ *
+ * @param node The index of the parent node.
+ * @param byte The first byte of the child's label.
+ * @return The index of the child, or -1 if there is none.
+ */
+int64_t PrefixIndex::_findChild(const uint32_t& node, const char& byte) const {
+  const std::vector<uint32_t>& children = this->_nodes[node].children;
+  auto at = std::lower_bound(children.begin(), children.end(), byte, [this](const uint32_t& c, const char& b) {
+    return this->_nodes[c].label[0] < b;
+  });
+  if (at == children.end() || this->_nodes[*at].label[0] != byte) {
+    return -1;
+  }
+  return *at;
+}
+
+/**
+ * @brief Rebuilds a node's cached top terms from its own term and its children's caches.
+ *
+ * Each child's cache already holds its best `TOP_K`, so merging them is exact.
+ *
+ * @param node The index of the node.
+ */
+void PrefixIndex::_refresh(const uint32_t& node) {
+  std::vector<uint32_t> candidates;
+  if (this->_nodes[node].term >= 0) {
+    candidates.push_back(this->_nodes[node].term);
+  }
+  for (const uint32_t& child : this->_nodes[node].children) {
+    const std::vector<uint32_t>& top = this->_nodes[child].top;
+    candidates.insert(candidates.end(), top.begin(), top.end());
+  }
+
+  auto middle = candidates.begin() + std::min<size_t>(TOP_K, candidates.size());
+  std::partial_sort(candidates.begin(), middle, candidates.end(), [this](const uint32_t& a, const uint32_t& b) {
+    return this->_ranksBefore(a, b);
+  });
+  candidates.erase(middle, candidates.end());
+  candidates.shrink_to_fit();
+
+  this->_nodes[node].top = std::move(candidates);
+}
+
+/**
+ * @brief Checks whether one term ranks ahead of another.
+ *
+ * @param a The ID of the first term.
+ * @param b The ID of the second term.
+ * @return true if `a` is heavier, or equally heavy and alphabetically first.
+ */
+bool PrefixIndex::_ranksBefore(const uint32_t& a, const uint32_t& b) const {
+  if (this->_terms[a].weight != this->_terms[b].weight) {
+    return this->_terms[a].weight > this->_terms[b].weight;
+  }
+  return this->_terms[a].display < this->_terms[b].display;
+}
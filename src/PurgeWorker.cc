@@ -0,0 +1,120 @@
+#include "PurgeWorker.hh"
+
+#include <thread>
+
+// =============================================================================
+// Public Methods
+// =============================================================================
+
+/**
+ * @brief Constructs a worker; no connection is opened until it is first woken.
+ *
+ * @param db_filename The database to purge.
+ * @param scheduler The scheduler the purge runs on.
+ */
+PurgeWorker::PurgeWorker(const std::string& db_filename, TaskScheduler& scheduler)
+  : _db_filename(db_filename), _scheduler(scheduler) {}
+
+/**
+ * @brief Stops the purge after its current transaction and waits for it.
+ *
+ * Whatever is left stays hidden and is purged the next time a worker is woken.
+ */
+PurgeWorker::~PurgeWorker() {
+  std::unique_lock<std::mutex> lock(this->_lock);
+  this->_stopping = true;
+  this->_idle.wait(lock, [this] {
+    return !this->_running;
+  });
+}
+
+/**
+ * @brief Starts purging unless the purge is already running.
+ *
+ * A wake during a purge makes the running task look for work once more before it goes
+ * idle, so a deletion recorded just as it finished is not left behind.
+ */
+void PurgeWorker::wake() {
+  {
+    std::lock_guard<std::mutex> lock(this->_lock);
+    if (this->_stopping) {
+      return;
+    }
+    if (this->_running) {
+      this->_again = true;
+      return;
+    }
+    this->_running = true;
+  }
+  this->_scheduler.submit([this] {
+    this->_run();
+  }, TaskScheduler::Priority::BACKGROUND);
+}
+
+/**
+ * @brief Blocks until the purge has stopped.
+ */
+void PurgeWorker::wait() {
+  std::unique_lock<std::mutex> lock(this->_lock);
+  this->_idle.wait(lock, [this] {
+    return !this->_running;
+  });
+}
+
+/**
+ * @brief Retrieves the number of rows purged so far.
+ *
+ * @return The number of rows.
+ */
+uint64_t PurgeWorker::purged() const {
+  return this->_purged.load(std::memory_order_relaxed);
+}
+
+// =============================================================================
+// Private Methods
+// =============================================================================
+
+/**
+ * @brief Purges until no deletion is left, then marks the worker idle.
+ *
+ * A failed transaction (e.g. the lock could not be taken within the busy timeout)
+ * ends this run; the next wake retries it.
+ */
+void PurgeWorker::_run() {
+  if (!this->_pond) {
+    std::unique_ptr<Pond> pond = std::make_unique<Pond>();
+    if (pond->loadDatabase(this->_db_filename) == 0) {
+      pond->setCaches(nullptr);
+      this->_pond = std::move(pond);
+    }
+  }
+
+  while (this->_pond) {
+    int64_t removed;
+    while (true) {
+      {
+        std::lock_guard<std::mutex> lock(this->_lock);
+        this->_again = false;
+        if (this->_stopping) {
+          break;
+        }
+      }
+      removed = this->_pond->purgeDeleted();
+      if (removed <= 0) {
+        break;
+      }
+      this->_purged.fetch_add(removed, std::memory_order_relaxed);
+      std::this_thread::sleep_for(PURGE_PAUSE);
+    }
+
+    std::lock_guard<std::mutex> lock(this->_lock);
+    if (!this->_again || this->_stopping) {
+      break;
+    }
+  }
+
+  std::lock_guard<std::mutex> lock(this->_lock);
+  this->_running = false;
+  this->_again = false;
+  this->_idle.notify_all();
+}
@@ -13,28 +13,43 @@
  * a status code of ERROR_SQL.
  *
  * @param db_filename The name of the database file to load.
+ * @param profile Whether to count performance events around database operations
+ *                and rendering, reported when the program exits.
  *
  * @note Ensure that the provided `db_filename` points to a valid and
  * accessible database file to prevent the program from terminating.
  */
-Quacker::Quacker(const std::string& db_filename) {
+Quacker::Quacker(const std::string& db_filename, const bool& profile) {
   if (pond.loadDatabase(db_filename)) {
     std::cerr << "Database Error: Could Not Open" << db_filename << std::endl;
     exit(ERROR_SQL);
   }
+  prefetcher = std::make_unique<Prefetcher>(db_filename, pond.getCaches());
+  purger = std::make_unique<PurgeWorker>(db_filename);
+  purger->wake();
+  if (profile) {
+    profiler = std::make_unique<PerfCounters>();
+    pond.setProfiler(profiler.get());
+  }
 }
 
 /**
  * @brief Destructor for the Quacker class.
  *
  * This destructor clears the console by executing the `clear` system command 
- * and releases the memory allocated for the `_user_id` member variable.
+ * and releases the memory allocated for the `_user_id` member variable. When
+ * profiling, it prints the performance counter and cache reports to `std::cerr`.
  */
 Quacker::~Quacker() {
   std::system("clear");
   if (_user_id) {
     delete _user_id;
   }
+  if (profiler) {
+    pond.setProfiler(nullptr);
+    profiler->report(std::cerr);
+    CacheManager::shared().report(std::cerr);
+  }
 }
 
 /**
@@ -89,6 +104,11 @@ void Quacker::startPage() {
       case '3':
         std::system("clear");
         error = "";
+        // exit() skips the destructor, which would otherwise print the report
+        if (profiler) {
+          profiler->report(std::cerr);
+          CacheManager::shared().report(std::cerr);
+        }
         exit(0);
         break;
 
@@ -141,6 +161,9 @@ void Quacker::loginPage() {
       continue;
     }
 
+    // Load the first feed page while the password is typed and checked
+    this->prefetcher->prefetchSession(user_id, this->feed_mode);
+
     // Ask for the password
     std::cout << "Password: ";
     password = this->getHiddenPassword();
@@ -242,6 +265,8 @@ void Quacker::signupPage() {
  * - Displays the user feed and adjusts the number of visible posts based on user selection.
  * - Validates user input to ensure actions correspond to available menu options.
  * - Provides options for replying to or retweeting posts directly from the feed.
+ * - Toggles between the chronological and the engagement-ranked feed.
+ * - Shows the unread notification count and opens the notifications inbox.
  * - Handles logging out by cleaning up the session and redirecting to the start page.
  */
 void Quacker::mainPage() {
@@ -254,8 +279,11 @@ void Quacker::mainPage() {
 
     int32_t i = 1;
     char select;
+    const bool ranked = this->feed_mode == Pond::FeedMode::RANKED;
     std::cout << QUACKER_BANNER << "\nWelcome back, " << username 
-    << "! (User Id: " << *(this->_user_id) << ")\n\n-------------------------------------------- Your Feed ---------------------------------------------\n";
+    << "! (User Id: " << *(this->_user_id) << ")\n\n"
+    << (ranked ? "---------------------------------------- Your Feed (Ranked) ----------------------------------------\n"
+               : "-------------------------------------------- Your Feed ---------------------------------------------\n");
     std::cout << processFeed(FeedDisplayCount, error, i);
     std::cout << "\n" << error << "\n\n1. See More Of My Feed\n"
                                       "2. See Less Of My Feed\n"
@@ -265,7 +293,12 @@ void Quacker::mainPage() {
                                       "6. List Followers\n"
                                       "7. CREATE NEW POST\n"
                                       "8. Log Out\n"
-                                      "Selection: ";
+                                   << (ranked ? "9. Switch To Chronological Feed\n"
+                                              : "9. Switch To Ranked Feed\n")
+                                   << "N. Notifications (" << pond.getUnreadNotificationCount(*(this->_user_id)) << " unread)\n"
+                                   << "T. Trending\n"
+                                   << "Selection: ";
+    this->prefetcher->prefetchFeed(*(this->_user_id), ranked ? Pond::FeedMode::CHRONOLOGICAL : Pond::FeedMode::RANKED);
     std::cin >> select;
     if (std::cin.peek() != '\n') select = '0';
     // Consume any trailing '\n' and discard it
@@ -350,8 +383,26 @@ void Quacker::mainPage() {
         this->_user_id = nullptr;
         break;
 
+      case '9':
+        this->feed_mode = ranked ? Pond::FeedMode::CHRONOLOGICAL : Pond::FeedMode::RANKED;
+        FeedDisplayCount = 5;
+        error = "";
+        break;
+
+      case 'N':
+      case 'n':
+        this->notificationsPage();
+        error = "";
+        break;
+
+      case 'T':
+      case 't':
+        this->trendingPage();
+        error = "";
+        break;
+
       default:
-        error = "\nInvalid Input Entered [use: 1, 2, 3, ..., 9].\n";
+        error = "\nInvalid Input Entered [use: 1, 2, 3, ..., 9, N, T].\n";
         break;
     }
   }
@@ -383,6 +434,11 @@ void Quacker::postingPage() {
     if (quack_text.empty()) {
       break;
     }
+    const AdmissionController::Decision decision = admission.admit(*(this->_user_id), AdmissionController::Operation::QUACK);
+    if (!decision.admitted) {
+      description = "You are quacking too fast, try again in " + AdmissionController::describe(decision.retry_after) + ".";
+      continue;
+    }
     if (pond.addQuack(*(this->_user_id), quack_text) != nullptr) {
       std::cout << "Quack posted successfully!\n";
       std::cout << "Press Enter to return... ";
@@ -408,13 +464,14 @@ void Quacker::postingPage() {
  *
  * @details
  * - Retrieves and displays search results based on the input query.
+ * - Falls back to a typo-tolerant search when no name contains the query exactly.
  * - Allows users to interact with search results by selecting a user to view or follow.
  * - Handles navigation through paginated search results.
  * - Ensures input validation for selection and provides appropriate feedback for invalid inputs.
  * - Allows users to exit the interface by pressing Enter without input.
  */
 void Quacker::searchUsersPage() {
-  std::string description = "Search for a user or press Enter to return.";
+  std::string description = "Search for a user (end with * to autocomplete) or press Enter to return.";
   while (true) {
     // show search interface
     std::system("clear");
@@ -425,9 +482,18 @@ void Quacker::searchUsersPage() {
     std::getline(std::cin, search_term);
     search_term = trim(search_term);
     if (search_term.empty()) return;
+    if (search_term.back() == '*') {
+      search_term = trim(this->completeSearchTerm(search_term, Pond::CompletionKind::USER));
+      if (search_term.empty()) return;
+    }
 
-    // query
+    // query, falling back to similar names when nothing matches exactly
     std::vector<Pond::User> results = pond.searchForUsers(search_term);
+    bool fuzzy = false;
+    if (results.empty()) {
+      results = pond.searchForUsersFuzzy(search_term);
+      fuzzy = !results.empty();
+    }
 
     // display results
     if (results.empty()) {
@@ -447,20 +513,32 @@ void Quacker::searchUsersPage() {
       
       while(true){
         i = 1;
-        std::cout << "Found " << results.size() << " users matching the search term.\n\n";
+        if (fuzzy) {
+          std::cout << "No exact matches. Found " << results.size() << " users with similar names.\n\n";
+        } else {
+          std::cout << "Found " << results.size() << " users matching the search term.\n\n";
+        }
 
-        for (const Pond::User& result : results) {
-          ++i;
-          if((UserDisplayCount < i-1 || i <= UserDisplayCount-4) && UserDisplayCount < static_cast<int32_t>(results.size())) continue;
-          else if((i <= static_cast<int32_t>(results.size()-4)) && UserDisplayCount >= static_cast<int32_t>(results.size())) continue;
+        std::vector<int32_t> visible_ids;
+        {
+          PerfCounters::Scope profile(this->profiler.get(), "render user results");
+          for (const Pond::User& result : results) {
+            ++i;
+            if((UserDisplayCount < i-1 || i <= UserDisplayCount-4) && UserDisplayCount < static_cast<int32_t>(results.size())) continue;
+            else if((i <= static_cast<int32_t>(results.size()-4)) && UserDisplayCount >= static_cast<int32_t>(results.size())) continue;
+            visible_ids.push_back(result.usr);
 
-          std::ostringstream oss;
-          oss << "----------------------------------------------------------------------------------------------------\n";
-          oss << i-1 << ".\n";
-          oss << "  User ID: " << std::setw(40) << std::left << result.usr
-              << "Name: " << result.name << "\n\n";
-          std::cout << oss.str();
-        } std::cout << "----------------------------------------------------------------------------------------------------\n\n";
+            std::ostringstream oss;
+            oss << "----------------------------------------------------------------------------------------------------\n";
+            oss << i-1 << ".\n";
+            oss << "  User ID: " << std::setw(40) << std::left << result.usr
+                << "Name: " << result.name << "\n\n";
+            std::cout << oss.str();
+          }
+          profile.setRows(visible_ids.size());
+        }
+        std::cout << "----------------------------------------------------------------------------------------------------\n\n";
+        this->prefetcher->prefetchProfiles(visible_ids);
         if(5 > static_cast<int32_t>(results.size())){
           // Prompt the user to search again or return
           std::cout << "Select a user (1,2,3,...) to follow OR press Enter to return: ";
@@ -616,7 +694,9 @@ void Quacker::searchUsersPage() {
  * - Validates user input for result navigation and Quack interaction to ensure proper behavior.
  */
 void Quacker::searchQuacksPage() {
-  std::string description = "Search for a keyword or hashtag, or press Enter to return... ";
+  std::string description = "Search for keywords, \"phrases\" or #hashtags (end a single term with * to autocomplete a hashtag, or wrap in * to match inside words: *ack*).\n"
+                            "Narrow with from:<user>, since:YYYY-MM-DD, until:YYYY-MM-DD and is:reply; combine with OR, NOT or -, and (parentheses).\n"
+                            "Press Enter to return... ";
   while (true) {
     // show search interface
     std::system("clear");
@@ -627,6 +707,11 @@ void Quacker::searchQuacksPage() {
     std::getline(std::cin, search_term);
     search_term = trim(search_term);
     if (search_term.empty()) return;
+    // Only a single term is completed; a query with several is searched as written
+    if (search_term.back() == '*' && search_term.front() != '*' && search_term.find(' ') == std::string::npos) {
+      search_term = trim(this->completeSearchTerm(search_term, Pond::CompletionKind::HASHTAG));
+      if (search_term.empty()) return;
+    }
 
     // query
     std::vector<Pond::Quack> results = pond.searchForQuacks(search_term);
@@ -656,24 +741,29 @@ void Quacker::searchQuacksPage() {
       while(true){
         i = 1; 
 
-        for (const Pond::Quack& result : results) {
-          ++i;
+        {
+          PerfCounters::Scope profile(this->profiler.get(), "render quack results");
+          size_t rendered = 0;
+          for (const Pond::Quack& result : results) {
+            ++i;
 
-          if((QuackDisplayCount < i-1 || i <= QuackDisplayCount-4) && QuackDisplayCount < static_cast<int32_t>(results.size())) continue;
-          else if((i <= static_cast<int32_t>(results.size()-4)) && QuackDisplayCount >= static_cast<int32_t>(results.size())) continue;
+            if((QuackDisplayCount < i-1 || i <= QuackDisplayCount-4) && QuackDisplayCount < static_cast<int32_t>(results.size())) continue;
+            else if((i <= static_cast<int32_t>(results.size()-4)) && QuackDisplayCount >= static_cast<int32_t>(results.size())) continue;
 
-          std::ostringstream oss;
-          oss << i-1 << ".\n";
-          oss << "Quack ID: " << result.tid;
-          oss << ", Author: " << ((pond.getUsername(result.writer_id) != "") ? pond.getUsername(result.writer_id) : "Unknown");
-          oss << std::string(69 - oss.str().length(), ' ');
-          oss << "Date and Time: " << (result.date.empty() ? "Unknown" : result.date);
-          oss << " " << (result.time.empty() ? "Unknown" : result.time) << "\n\n";
-          oss << "Text: " << formatTweetText(result.text, 94) << "\n";
-          oss << "\n";
-          for(int i = 0; i < 100; ++i) oss << '-'; 
-          oss << '\n';
-          std::cout << oss.str();
+            std::ostringstream oss;
+            oss << i-1 << ".\n";
+            oss << "Quack ID: " << result.tid;
+            oss << ", Author: " << ((pond.getUsername(result.writer_id) != "") ? pond.getUsername(result.writer_id) : "Unknown");
+            oss << std::string(69 - oss.str().length(), ' ');
+            oss << "Date and Time: " << (result.date.empty() ? "Unknown" : result.date);
+            oss << " " << (result.time.empty() ? "Unknown" : result.time) << "\n\n";
+            oss << "Text: " << formatTweetText(result.text, 94) << "\n";
+            oss << "\n";
+            for(int i = 0; i < 100; ++i) oss << '-'; 
+            oss << '\n';
+            std::cout << oss.str();
+            profile.setRows(++rendered);
+          }
         }
         std::cout << '\n';
 
@@ -841,38 +931,44 @@ void Quacker::searchQuacksPage() {
     char select;
     std::cout << QUACKER_BANNER;
     std::cout << "\nActions For User:\n\n";
-    std::ostringstream oss;
-    oss << "----------------------------------------------------------------------------------------------------\n";
-    oss << "  User ID: " << std::setw(40) << std::left << user.usr
-        << "Name: " << user.name << "\n";
-    oss << "  Followers: " << std::setw(38) << std::left << pond.getFollowers(user.usr).size()
-        << "Follows: " << pond.getFollows(user.usr).size() << "\n  Quack Count: " << pond.getQuacks(user.usr).size() << "\n\n";
-    std::cout << oss.str();
-    std::cout << "------------------------------------------- User's Quacks ------------------------------------------\n\n";
+    std::vector<Pond::Quack> users_quacks;
+    {
+      PerfCounters::Scope profile(this->profiler.get(), "render profile");
+      size_t rendered = 0;
+      std::ostringstream oss;
+      oss << "----------------------------------------------------------------------------------------------------\n";
+      oss << "  User ID: " << std::setw(40) << std::left << user.usr
+          << "Name: " << user.name << "\n";
+      oss << "  Followers: " << std::setw(38) << std::left << pond.getFollowers(user.usr).size()
+          << "Follows: " << pond.getFollows(user.usr).size() << "\n  Quack Count: " << pond.getQuacks(user.usr).size() << "\n\n";
+      std::cout << oss.str();
+      std::cout << "------------------------------------------- User's Quacks ------------------------------------------\n\n";
     
-    std::vector<Pond::Quack> users_quacks = pond.getQuacks(user.usr);
+      users_quacks = pond.getQuacks(user.usr);
 
-    for (const Pond::Quack& result : users_quacks) {
-        ++i;
-        if(i-1 > hardstop) break;
-        if(hardstop >= static_cast<int32_t>(pond.getQuacks(user.usr).size())) {
-          if((i-1 <= (static_cast<int32_t>(pond.getQuacks(user.usr).size()-3)))) continue;
-        } else if((i-1 <= (hardstop-3))) continue;
-        std::ostringstream oss;
+      for (const Pond::Quack& result : users_quacks) {
+          ++i;
+          if(i-1 > hardstop) break;
+          if(hardstop >= static_cast<int32_t>(pond.getQuacks(user.usr).size())) {
+            if((i-1 <= (static_cast<int32_t>(pond.getQuacks(user.usr).size()-3)))) continue;
+          } else if((i-1 <= (hardstop-3))) continue;
+          std::ostringstream oss;
         
-        oss << i-1 << ".\n";
-        oss << "Quack ID: " << result.tid;
-        oss << ", Author: " << ((pond.getUsername(result.writer_id) != "") ? pond.getUsername(result.writer_id) : "Unknown");
-        oss << std::string(69 - oss.str().length(), ' ');
-        oss << "Date and Time: " << (result.date.empty() ? "Unknown" : result.date);
-        oss << " " << (result.time.empty() ? "Unknown" : result.time) << "\n\n";
-        oss << "Text: " << formatTweetText(result.text, 94) << "\n";
-
-        oss << "\n";
-        for(int i = 0; i < 100; ++i) oss << '-'; 
-        oss << '\n';
-        std::cout << oss.str();
-      }
+          oss << i-1 << ".\n";
+          oss << "Quack ID: " << result.tid;
+          oss << ", Author: " << ((pond.getUsername(result.writer_id) != "") ? pond.getUsername(result.writer_id) : "Unknown");
+          oss << std::string(69 - oss.str().length(), ' ');
+          oss << "Date and Time: " << (result.date.empty() ? "Unknown" : result.date);
+          oss << " " << (result.time.empty() ? "Unknown" : result.time) << "\n\n";
+          oss << "Text: " << formatTweetText(result.text, 94) << "\n";
+
+          oss << "\n";
+          for(int i = 0; i < 100; ++i) oss << '-'; 
+          oss << '\n';
+          std::cout << oss.str();
+          profile.setRows(++rendered);
+        }
+    }
 
     std::cout << error <<
       "\n\n1. See More Of The Users Quacks"
@@ -923,7 +1019,12 @@ void Quacker::searchQuacksPage() {
               break;
             }
           }
-          if (!already_follows) {
+          const AdmissionController::Decision decision = already_follows
+            ? AdmissionController::Decision{}
+            : admission.admit(user_id, AdmissionController::Operation::FOLLOW);
+          if (!decision.admitted) {
+            error = "\nYou are following too fast, try again in " + AdmissionController::describe(decision.retry_after) + ".";
+          } else if (!already_follows) {
             pond.follow(user_id, user.usr);
             std::cout << "You are now following " << user.name << "\n";
             std::cout << "Press Enter to return... ";
@@ -1026,9 +1127,14 @@ void Quacker::replyPage(const Pond::Quack& reply) {
     for(int i = 0; i < 100; ++i) std::cout << '-';
 
     std::string reply_text;
-    std::cout << "\n\nEnter your reply or press Enter to cancel: ";
+    std::cout << (error.empty() ? "" : "\n\n" + error) << "\n\nEnter your reply or press Enter to cancel: ";
     std::getline(std::cin, reply_text);
     if (reply_text.empty()) return;
+    const AdmissionController::Decision decision = admission.admit(user_id, AdmissionController::Operation::REPLY);
+    if (!decision.admitted) {
+      error = "You are replying too fast, try again in " + AdmissionController::describe(decision.retry_after) + ".";
+      continue;
+    }
     if (pond.addReply(user_id, reply.tid, reply_text)) {
       std::cout << "\nReply posted successfully!\n";
       std::cout << "Press Enter to return... ";
@@ -1057,6 +1163,7 @@ void Quacker::replyPage(const Pond::Quack& reply) {
  * - Users can reply to the Quack, which redirects to the reply interface.
  * - Users can requack the post, with validation to prevent duplicate requacks.
  * - Handles errors during requacking and provides feedback.
+ * - Lets authors delete their own quack, which hides it at once and purges it in the background.
  * - Allows users to exit the interface by selecting the return option.
  */
 void Quacker::quackPage(const Pond::Quack& reply) {
@@ -1077,17 +1184,21 @@ void Quacker::quackPage(const Pond::Quack& reply) {
     oss << "Date and Time: " << (reply.date.empty() ? "Unknown" : reply.date);
     oss << " " << (reply.time.empty() ? "Unknown" : reply.time) << "\n\n";
     oss << "Text: " << formatTweetText(reply.text, 94) << "\n\n";
-    oss << "Requack Count: " << pond.getRequackCount(reply.tid) << "     Reply Count: " << pond.getReplies(reply.tid).size() << "\n\n";
+    Pond::Reach reach = pond.getReach(reply.tid);
+    oss << "Requack Count: " << pond.getRequackCount(reply.tid) << "     Reply Count: " << pond.getReplies(reply.tid).size()
+        << "     Est. Reach: " << reach.estimated_reach << "     Cascade Depth: " << reach.cascade_depth << "\n\n";
 
     std::cout << oss.str();
-    
+
     for(int i = 0; i < 100; ++i) std::cout << '-';
 
+    const bool own = reply.writer_id == user_id;
     std::cout << error <<
       "\n\n1. Reply"
       "\n2. Requack"
-      "\n3. Return"
-      "\n\nSelection: ";
+      "\n3. Return";
+    if (own) std::cout << "\n4. Delete";
+    std::cout << "\n\nSelection: ";
     std::cin >> select;
     if (std::cin.peek() != '\n') select = '0';
     // Consume any trailing '\n' and discard it
@@ -1099,6 +1210,11 @@ void Quacker::quackPage(const Pond::Quack& reply) {
         break;
       case '2': {
         error = "";
+        const AdmissionController::Decision decision = admission.admit(user_id, AdmissionController::Operation::REQUACK);
+        if (!decision.admitted) {
+          error = "\n\nYou are requacking too fast, try again in " + AdmissionController::describe(decision.retry_after) + ".\n";
+          break;
+        }
         int32_t joebiden = pond.addRequack(user_id, reply.tid);
         if (joebiden == 0) {
           std::cout << "Requack successful!\n";
@@ -1122,13 +1238,228 @@ void Quacker::quackPage(const Pond::Quack& reply) {
       case '3':
         error = "";
         return;
+      case '4':
+        if (!own) {
+          error = "\n\nInvalid Input Entered [use: 1, 2, 3].\n";
+          break;
+        }
+        if (const AdmissionController::Decision decision = admission.admit(user_id, AdmissionController::Operation::DELETE); !decision.admitted) {
+          error = "\n\nYou are deleting too fast, try again in " + AdmissionController::describe(decision.retry_after) + ".\n";
+          break;
+        }
+        if (!pond.deleteQuack(user_id, reply.tid)) {
+          error = "\n\nError deleting, please try again.\n";
+          break;
+        }
+        this->purger->wake();
+        return;
       default:
-        error = "\n\nInvalid Input Entered [use: 1, 2, 3].\n";
+        error = own ? "\n\nInvalid Input Entered [use: 1, 2, 3, 4].\n" : "\n\nInvalid Input Entered [use: 1, 2, 3].\n";
         break;
     }
   }
 }
 
+/**
+ * @brief Displays the user's notifications inbox.
+ *
+ * Shows mentions, replies, requacks and new followers, newest first, one page at a
+ * time. Notifications that arrived since the inbox was last opened are flagged as new,
+ * and leaving the page marks them all as read.
+ *
+ * @details
+ * - Pages through the inbox with the cursor returned by each page (older/newer).
+ * - Opens the quack behind a mention, reply or requack, or the profile of a new follower.
+ * - Validates user input for navigation and selection.
+ */
+void Quacker::notificationsPage() {
+  const int32_t user_id = *(this->_user_id);
+  std::string error = "";
+
+  // Cursors of the pages before the current one, so "newer" can step back
+  std::vector<int64_t> previous_cursors;
+  int64_t cursor = 0;
+  std::vector<Pond::Notification> page = pond.getNotifications(user_id, cursor);
+
+  while (true) {
+    std::system("clear");
+    std::cout << QUACKER_BANNER << "\n--- Your Notifications ---\n\n";
+
+    if (page.empty()) {
+      std::cout << "You Have No Notifications :(\n";
+    }
+
+    int32_t i = 1;
+    for (const Pond::Notification& notification : page) {
+      std::ostringstream oss;
+      oss << i++ << ". " << (notification.unread ? "[NEW] " : "")
+          << (notification.actor_name.empty() ? "Unknown" : notification.actor_name);
+      switch (notification.kind) {
+        case Pond::NotificationKind::MENTION:
+          oss << " mentioned you in Quack " << notification.tid;
+          break;
+        case Pond::NotificationKind::REPLY:
+          oss << " replied to your quack with Quack " << notification.tid;
+          break;
+        case Pond::NotificationKind::REQUACK:
+          oss << " requacked your Quack " << notification.tid;
+          break;
+        case Pond::NotificationKind::FOLLOW:
+          oss << " (User Id: " << notification.actor << ") followed you";
+          break;
+      }
+      oss << std::string(std::max<int>(1, 66 - static_cast<int>(oss.str().length())), ' ');
+      oss << notification.date << " " << notification.time << "\n";
+      if (!notification.snippet.empty()) {
+        oss << "   " << notification.snippet << "\n";
+      }
+
+      std::cout << "----------------------------------------------------------------------------------------------------\n";
+      std::cout << oss.str();
+    }
+    std::cout << "----------------------------------------------------------------------------------------------------\n";
+
+    std::cout << error << "\nSelect a notification (1,2,3,...) to open it, O for older, N for newer, OR press Enter to return: ";
+    std::string input;
+    std::getline(std::cin, input);
+    error = "";
+
+    if (input.empty()) {
+      break;
+    }
+    else if (input == "O" || input == "o") {
+      std::vector<Pond::Notification> older;
+      if (page.size() == Pond::NOTIFICATION_PAGE_SIZE) {
+        older = pond.getNotifications(user_id, page.back().nid);
+      }
+      if (older.empty()) {
+        error = "\nNo Older Notifications.\n";
+        continue;
+      }
+      previous_cursors.push_back(cursor);
+      cursor = page.back().nid;
+      page = older;
+    }
+    else if (input == "N" || input == "n") {
+      if (previous_cursors.empty()) {
+        error = "\nNo Newer Notifications.\n";
+        continue;
+      }
+      cursor = previous_cursors.back();
+      previous_cursors.pop_back();
+      page = pond.getNotifications(user_id, cursor);
+    }
+    else {
+      std::regex positive_integer_regex("^[1-9]\\d*$");
+      if (!std::regex_match(input, positive_integer_regex) || std::stoul(input) > page.size()) {
+        error = "\nInvalid Input Entered [use: 1, 2, 3, ..., O, N].\n";
+        continue;
+      }
+
+      const Pond::Notification& notification = page[std::stoul(input) - 1];
+      if (notification.kind == Pond::NotificationKind::FOLLOW) {
+        this->userPage({notification.actor, notification.actor_name});
+      } else {
+        this->quackPage(pond.getQuackFromID(notification.tid));
+      }
+    }
+  }
+
+  pond.markNotificationsRead(user_id);
+}
+
+/**
+ * @brief Displays what is trending: the most requacked and replied-to quacks and the
+ *        accounts gaining the most followers.
+ *
+ * Every list is read from the in-memory leaderboards, so switching windows is instant.
+ *
+ * @details
+ * - Switches between the past hour, day and week.
+ * - Shows the user's own rank among accounts by followers gained.
+ * - Opens a listed quack, or the profile of a listed account.
+ * - Validates user input for navigation and selection.
+ */
+void Quacker::trendingPage() {
+  using Metric = EngagementBoards::Metric;
+  using Window = EngagementBoards::Window;
+  const int32_t user_id = *(this->_user_id);
+  const size_t TRENDING_COUNT = 5;
+  std::string error = "";
+  Window window = Window::DAY;
+
+  while (true) {
+    std::system("clear");
+    const char* window_name = window == Window::HOUR ? "Past Hour" : window == Window::DAY ? "Past Day" : "Past Week";
+    std::cout << QUACKER_BANNER << "\n--- Trending (" << window_name << ") ---\n";
+
+    // Quack IDs and user IDs behind each selection number, in display order
+    std::vector<std::pair<bool, int32_t>> choices;
+    auto showQuacks = [&](const char* title, const Metric& metric, const char* unit) {
+      std::cout << "\n" << title << ":\n";
+      const std::vector<Leaderboard::Entry> top = pond.getTopQuacks(metric, window, TRENDING_COUNT);
+      if (top.empty()) {
+        std::cout << "  Nothing Yet :(\n";
+      }
+      for (const Leaderboard::Entry& entry : top) {
+        const Pond::Quack quack = pond.getQuackFromID(entry.id);
+        const std::string author = pond.getUsername(quack.writer_id);
+        choices.push_back({true, entry.id});
+        std::cout << "  " << choices.size() << ". [" << entry.score << " " << unit << "] "
+                  << (author.empty() ? "Unknown" : author) << ": " << formatTweetText(quack.text, 70) << "\n";
+      }
+    };
+    showQuacks("Most Requacked Quacks", Metric::REQUACKS, "requacks");
+    showQuacks("Most Replied-To Quacks", Metric::REPLIES, "replies");
+
+    std::cout << "\nAccounts Gaining The Most Followers:\n";
+    const std::vector<Leaderboard::Entry> accounts = pond.getTopAccounts(Metric::FOLLOWERS, window, TRENDING_COUNT);
+    if (accounts.empty()) {
+      std::cout << "  Nothing Yet :(\n";
+    }
+    for (const Leaderboard::Entry& entry : accounts) {
+      const std::string name = pond.getUsername(entry.id);
+      choices.push_back({false, entry.id});
+      std::cout << "  " << choices.size() << ". [+" << entry.score << " followers] "
+                << (name.empty() ? "Unknown" : name) << " (User Id: " << entry.id << ")\n";
+    }
+    const size_t rank = pond.getAccountRank(user_id, Metric::FOLLOWERS, window);
+    std::cout << "\nYour Rank: " << (rank ? "#" + std::to_string(rank) : std::string("Unranked")) << "\n";
+
+    std::cout << error << "\nSelect an entry (1,2,3,...) to open it, H/D/W for the past hour/day/week, OR press Enter to return: ";
+    std::string input;
+    std::getline(std::cin, input);
+    error = "";
+
+    if (input.empty()) {
+      break;
+    }
+    else if (input == "H" || input == "h") {
+      window = Window::HOUR;
+    }
+    else if (input == "D" || input == "d") {
+      window = Window::DAY;
+    }
+    else if (input == "W" || input == "w") {
+      window = Window::WEEK;
+    }
+    else {
+      std::regex positive_integer_regex("^[1-9]\\d*$");
+      if (!std::regex_match(input, positive_integer_regex) || std::stoul(input) > choices.size()) {
+        error = "\nInvalid Input Entered [use: 1, 2, 3, ..., H, D, W].\n";
+        continue;
+      }
+
+      const auto& [is_quack, id] = choices[std::stoul(input) - 1];
+      if (is_quack) {
+        this->quackPage(pond.getQuackFromID(id));
+      } else {
+        this->userPage({id, pond.getUsername(id)});
+      }
+    }
+  }
+}
+
 /**
  * @brief Displays the list of followers and allows interaction with the follower profiles.
  *
@@ -1338,6 +1669,7 @@ void Quacker::followersPage() {
  *   - Ensures `FeedDisplayCount` does not go below zero.
  *   - Limits displayed Quacks to the requested count or the maximum available.
  * - Populates a list of visible Quack IDs for interaction with displayed items.
+ * - Uses the chronological or ranked feed depending on `feed_mode`.
  *
  * @param FeedDisplayCount The number of Quacks to display, adjusted as needed.
  * @param error A reference to an error message string, set if display limits are exceeded.
@@ -1345,8 +1677,10 @@ void Quacker::followersPage() {
  * @return A formatted string representing the visible portion of the feed.
  */
 std::string Quacker::processFeed(int32_t& FeedDisplayCount, std::string& error, int32_t& i) {
+    PerfCounters::Scope profile(this->profiler.get(), "render feed");
     const std::int32_t user_id = *(this->_user_id);
-    std::vector<std::string> feed = pond.getFeed(user_id);
+    std::vector<std::string> feed = pond.getFeed(user_id, this->feed_mode);
+    profile.setRows(feed.size());
 
     int32_t maxQuacks = feed.size();
     i = 1;
@@ -1517,6 +1851,56 @@ bool Quacker::isID(std::string str) {
   return *p == 0;
 }
 
+/**
+ * @brief Lets the user pick a completion for a search term that ends in `*`.
+ *
+ * Quack searches complete their last keyword against hashtags; user searches
+ * complete the whole term against user names.
+ *
+ * @param search_term The search term, ending in `*`.
+ * @param kind Whether to complete hashtags or user names.
+ * @return The search term with the completed part replaced by the chosen completion,
+ *         or simply without the `*` if none was chosen.
+ */
+std::string Quacker::completeSearchTerm(const std::string& search_term, const Pond::CompletionKind& kind) {
+  std::string term = search_term.substr(0, search_term.size() - 1);
+
+  // Only the last keyword of a quack search is completed
+  size_t start = 0;
+  if (kind == Pond::CompletionKind::HASHTAG) {
+    size_t space = term.find_last_of(' ');
+    start = space == std::string::npos ? 0 : space + 1;
+  }
+  const std::string prefix = term.substr(start);
+
+  std::vector<PrefixIndex::Entry> completions = pond.complete(prefix, kind);
+  if (completions.empty()) {
+    return term;
+  }
+
+  std::cout << "\nCompletions for \"" << prefix << "\":\n";
+  int32_t i = 1;
+  for (const PrefixIndex::Entry& completion : completions) {
+    std::cout << "  " << i++ << ". " << std::setw(40) << std::left << completion.term
+              << completion.weight << (kind == Pond::CompletionKind::HASHTAG ? " quacks\n" : " followers\n");
+  }
+
+  std::cout << "\nSelect a completion (1,2,3,...) OR press Enter to search for \"" << term << "\": ";
+  std::string input;
+  std::getline(std::cin, input);
+  std::regex positive_integer_regex("^[1-9]\\d*$");
+  while (!input.empty() && (!std::regex_match(input, positive_integer_regex) || std::stoul(input) > completions.size())) {
+    std::cout << "\033[A\033[2K" << std::flush;
+    std::cout << "Input Is Invalid: Select a completion (1,2,3,...) OR press Enter to search for \"" << term << "\": ";
+    std::getline(std::cin, input);
+  }
+  if (input.empty()) {
+    return term;
+  }
+
+  return term.substr(0, start) + completions[std::stoul(input) - 1].term;
+}
+
 /**
  * @brief Trims leading and trailing whitespace from a string.
  * 
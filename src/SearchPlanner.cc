@@ -0,0 +1,708 @@
+#include "SearchPlanner.hh"
+
+#include <algorithm>
+#include <iterator>
+
+// `LIMIT` of a count that should not stop early
+static constexpr uint64_t UNLIMITED = std::numeric_limits<uint64_t>::max();
+
+/**
+ * @brief Multiplies without overflowing past UNLIMITED.
+ *
+ * @param a A factor.
+ * @param b The other factor.
+ * @return The product, or UNLIMITED if it does not fit.
+ */
+static uint64_t saturatingMultiply(const uint64_t& a, const uint64_t& b) {
+  if (a != 0 && b > UNLIMITED / a) {
+    return UNLIMITED;
+  }
+  return a * b;
+}
+
+/**
+ * @brief Orders the terms of a conjunction for counting: exact index counts first, so
+ *        that they bound the counts that follow, and text scans last.
+ *
+ * @param kind The kind of a term.
+ * @return The term's rank; lower ranks are counted first.
+ */
+static int countingRank(const SearchQuery::Kind& kind) {
+  switch (kind) {
+    case SearchQuery::Kind::HASHTAG:
+    case SearchQuery::Kind::AUTHOR:   return 0;
+    case SearchQuery::Kind::DATES:
+    case SearchQuery::Kind::REPLY:    return 1;
+    case SearchQuery::Kind::AND:
+    case SearchQuery::Kind::OR:       return 2;
+    case SearchQuery::Kind::WORD:
+    case SearchQuery::Kind::PHRASE:
+    case SearchQuery::Kind::FRAGMENT: return 3;
+    case SearchQuery::Kind::NOT:      return 4;
+  }
+  return 4;
+}
+
+/**
+ * @brief Retrieves the name of an access path, as printed by `explain`.
+ *
+ * @param access The access path.
+ * @return The name.
+ */
+static const char* accessName(const SearchPlanner::Access& access) {
+  switch (access) {
+    case SearchPlanner::Access::HASHTAG_INDEX: return "hashtag index";
+    case SearchPlanner::Access::AUTHOR_INDEX:  return "author index";
+    case SearchPlanner::Access::DATE_INDEX:    return "date index";
+    case SearchPlanner::Access::REPLY_INDEX:   return "reply index";
+    case SearchPlanner::Access::TEXT_SCAN:     return "text scan";
+    case SearchPlanner::Access::FULL_SCAN:     return "full scan";
+    case SearchPlanner::Access::INTERSECT:     return "intersect";
+    case SearchPlanner::Access::UNION:         return "union";
+    case SearchPlanner::Access::NONE:          return "row check";
+  }
+  return "";
+}
+
+/**
+ * @brief Retrieves the name of a role, as printed by `explain`.
+ *
+ * @param role The role.
+ * @return The name.
+ */
+static const char* roleName(const SearchPlanner::Role& role) {
+  switch (role) {
+    case SearchPlanner::Role::ROOT:      return "search";
+    case SearchPlanner::Role::DRIVER:    return "driver";
+    case SearchPlanner::Role::INTERSECT: return "intersect";
+    case SearchPlanner::Role::FILTER:    return "filter";
+    case SearchPlanner::Role::EXCLUDE:   return "exclude";
+    case SearchPlanner::Role::BRANCH:    return "branch";
+    case SearchPlanner::Role::NEGATED:   return "not";
+  }
+  return "";
+}
+
+/**
+ * @brief Appends the description of a step and its children.
+ *
+ * Steps checked per row print no estimate: they may not have been counted.
+ *
+ * @param plan The step.
+ * @param depth The step's nesting depth.
+ * @param out The text to append to.
+ */
+static void explainStep(const SearchPlanner::Plan& plan, const size_t& depth, std::string& out) {
+  // An exclusion lists the negated term, so that term is what is described
+  const bool excluded = plan.role == SearchPlanner::Role::EXCLUDE;
+  const SearchPlanner::Plan& step = excluded ? plan.children.front() : plan;
+  const bool checked = plan.role == SearchPlanner::Role::FILTER;
+
+  out.append(depth * 2, ' ');
+  out += roleName(plan.role);
+  out += ' ';
+  out += step.node ? SearchQuery::describe(*step.node) : "every quack";
+  out += ": ";
+  out += accessName(checked ? SearchPlanner::Access::NONE : step.access);
+  if (!checked && step.access != SearchPlanner::Access::NONE) {
+    out += step.capped ? ", over " : ", ~";
+    out += std::to_string(step.estimate);
+    out += step.estimate == 1 && !step.capped ? " quack" : " quacks";
+  }
+  out += '\n';
+
+  // Below a row check every step is a row check too
+  if (!checked && !excluded) {
+    for (const SearchPlanner::Plan& child : plan.children) {
+      explainStep(child, depth + 1, out);
+    }
+  }
+}
+
+/**
+ * @brief Sorts IDs ascending and drops duplicates.
+ *
+ * @param ids The IDs.
+ */
+static void sortUnique(std::vector<int32_t>& ids) {
+  std::sort(ids.begin(), ids.end());
+  ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+}
+
+// =============================================================================
+// Public Methods
+// =============================================================================
+
+/**
+ * @brief Constructs a planner reading from a Pond's connection.
+ *
+ * @param pond The Pond to search.
+ */
+SearchPlanner::SearchPlanner(Pond& pond)
+  : _pond(pond) {}
+
+/**
+ * @brief Releases the statements prepared by the planner.
+ */
+SearchPlanner::~SearchPlanner() {
+  sqlite3_finalize(this->_tag_check);
+}
+
+/**
+ * @brief Compiles a query into a plan.
+ *
+ * A query that cannot be listed at all, such as a lone negation, is checked against
+ * every quack.
+ *
+ * @param query The parsed query, which must outlive the plan.
+ * @return The plan.
+ */
+SearchPlanner::Plan SearchPlanner::compile(const SearchQuery::Node& query) {
+  Plan plan = this->_compile(query, UNLIMITED);
+  if (plan.access == Access::NONE) {
+    Plan root;
+    root.node = &query;
+    root.access = Access::INTERSECT;
+    root.children.emplace_back();
+
+    Plan& scan = root.children.front();
+    scan.access = Access::FULL_SCAN;
+    scan.role = Role::DRIVER;
+    scan.estimate = scan.cost = root.estimate = root.cost = this->_total();
+
+    std::vector<Plan> terms;
+    terms.push_back(std::move(plan));
+    this->_assign(root, terms);
+    plan = std::move(root);
+  }
+  plan.role = Role::ROOT;
+  return plan;
+}
+
+/**
+ * @brief Runs a plan.
+ *
+ * @param plan The plan, from `compile`.
+ * @param results Set to the matching quacks, newest first.
+ * @return true if every step ran to the end; false if a statement failed.
+ */
+bool SearchPlanner::execute(const Plan& plan, std::vector<Pond::Quack>& results) {
+  results.clear();
+  if (plan.access == Access::INTERSECT && plan.children.empty()) {
+    return !this->_failed;   // an empty query matches nothing
+  }
+
+  const std::vector<int32_t> quack_ids = this->_produce(plan);
+  this->_fetch(quack_ids);
+  results.reserve(quack_ids.size());
+  for (const int32_t& quack_id : quack_ids) {
+    const Pond::Quack& quack = this->_rows.at(quack_id);
+    // A quack listed by an index may have been deleted since
+    if (quack.tid != 0) {
+      results.push_back(quack);
+    }
+  }
+  std::sort(results.begin(), results.end(), [](const Pond::Quack& a, const Pond::Quack& b) {
+    if (a.date != b.date) return a.date > b.date;
+    if (a.time != b.time) return a.time > b.time;
+    return a.tid > b.tid;
+  });
+  return !this->_failed;
+}
+
+/**
+ * @brief Describes a plan, one step per line.
+ *
+ * @param plan The plan.
+ * @return The description.
+ */
+std::string SearchPlanner::explain(const Plan& plan) {
+  std::string text;
+  explainStep(plan, 0, text);
+  return text;
+}
+
+// =============================================================================
+// Private Methods
+// =============================================================================
+
+/**
+ * @brief Compiles one node.
+ *
+ * Counts stop past `budget`, so a term far less selective than one already counted
+ * costs little more than that one. Text terms are scanned while planning, since the
+ * scan is what tells how many quacks contain them, unless the budget is so small that
+ * checking rows is cheaper.
+ *
+ * @param node The node.
+ * @param budget The longest list worth counting; counts stop past it.
+ * @return The node's plan.
+ */
+SearchPlanner::Plan SearchPlanner::_compile(const SearchQuery::Node& node, const uint64_t& budget) {
+  Plan plan;
+  plan.node = &node;
+
+  switch (node.kind) {
+    case SearchQuery::Kind::AND:
+      return this->_compileAnd(node, budget);
+
+    case SearchQuery::Kind::OR: {
+      plan.access = Access::UNION;
+      for (const SearchQuery::Node& child : node.children) {
+        Plan branch = this->_compile(child, budget);
+        branch.role = Role::BRANCH;
+        if (branch.access == Access::NONE) {
+          plan.access = Access::NONE;
+        }
+        plan.estimate = std::min(plan.estimate + branch.estimate, this->_total());
+        plan.capped = plan.capped || branch.capped;
+        plan.cost += branch.cost;
+        plan.children.push_back(std::move(branch));
+      }
+      return plan;
+    }
+
+    case SearchQuery::Kind::NOT: {
+      // Cannot be listed, but its term's list may be subtracted from a conjunction's
+      Plan negated = this->_compile(node.children.front(), budget);
+      negated.role = Role::NEGATED;
+      plan.children.push_back(std::move(negated));
+      return plan;
+    }
+
+    case SearchQuery::Kind::HASHTAG:
+      plan.access = Access::HASHTAG_INDEX;
+      this->_count("FROM hashtag_mentions WHERE LOWER(term) = ?1", [&](sqlite3_stmt* stmt) {
+        sqlite3_bind_text(stmt, 1, node.text.c_str(), -1, SQLITE_STATIC);
+      }, budget, plan);
+      return plan;
+
+    case SearchQuery::Kind::AUTHOR: {
+      plan.access = Access::AUTHOR_INDEX;
+      // Both lookups are index seeks: the primary key and the users_by_handle index
+      const bool is_id = node.text.size() <= 9 && std::all_of(node.text.begin(), node.text.end(), ::isdigit);
+      if (is_id) {
+        plan.authors = this->_column("SELECT usr FROM live_users WHERE usr = ?1", [&](sqlite3_stmt* stmt) {
+          sqlite3_bind_int(stmt, 1, std::stoi(node.text));
+        });
+      } else {
+        plan.authors = this->_column("SELECT usr FROM live_users WHERE REPLACE(LOWER(name), ' ', '') = ?1", [&](sqlite3_stmt* stmt) {
+          sqlite3_bind_text(stmt, 1, node.text.c_str(), -1, SQLITE_STATIC);
+        });
+      }
+      sortUnique(plan.authors);
+      for (const int32_t& author : plan.authors) {
+        Plan part;
+        this->_count("FROM tweets WHERE writer_id = ?1", [&](sqlite3_stmt* stmt) {
+          sqlite3_bind_int(stmt, 1, author);
+        }, budget, part);
+        plan.estimate += part.estimate;
+        plan.capped = plan.capped || part.capped;
+      }
+      plan.cost = plan.estimate;
+      return plan;
+    }
+
+    case SearchQuery::Kind::DATES:
+      plan.access = Access::DATE_INDEX;
+      this->_count("FROM tweets WHERE tdate BETWEEN ?1 AND ?2", [&](sqlite3_stmt* stmt) {
+        sqlite3_bind_text(stmt, 1, node.since.c_str(), -1, SQLITE_STATIC);
+        sqlite3_bind_text(stmt, 2, node.until.empty() ? "9999-99-99" : node.until.c_str(), -1, SQLITE_STATIC);
+      }, budget, plan);
+      return plan;
+
+    case SearchQuery::Kind::REPLY:
+      plan.access = Access::REPLY_INDEX;
+      this->_count("FROM tweets WHERE replyto_tid > 0", [](sqlite3_stmt*) {}, budget, plan);
+      return plan;
+
+    case SearchQuery::Kind::WORD:
+    case SearchQuery::Kind::PHRASE:
+    case SearchQuery::Kind::FRAGMENT:
+      plan.access = Access::TEXT_SCAN;
+      if (budget < SCAN_ROWS) {
+        // Unknown until scanned; as costly as reading everything
+        plan.estimate = plan.cost = this->_total();
+        return plan;
+      }
+      plan.candidates = this->_scanText(node);
+      sortUnique(plan.candidates);
+      plan.scanned = true;
+      plan.estimate = plan.cost = plan.candidates.size();
+      return plan;
+  }
+  return plan;
+}
+
+/**
+ * @brief Compiles a conjunction, choosing its driver, intersections and filters.
+ *
+ * Terms are counted with exact index counts first, each count bounding the next. The
+ * cheapest term that can be listed drives, ties going to the longest text; a
+ * conjunction with nothing to list is driven by a full scan.
+ *
+ * @param node The conjunction.
+ * @param budget The longest list worth counting.
+ * @return The conjunction's plan.
+ */
+SearchPlanner::Plan SearchPlanner::_compileAnd(const SearchQuery::Node& node, const uint64_t& budget) {
+  Plan plan;
+  plan.node = &node;
+  plan.access = Access::INTERSECT;
+
+  std::vector<const SearchQuery::Node*> order;
+  for (const SearchQuery::Node& child : node.children) {
+    order.push_back(&child);
+  }
+  std::stable_sort(order.begin(), order.end(), [](const SearchQuery::Node* a, const SearchQuery::Node* b) {
+    return countingRank(a->kind) < countingRank(b->kind);
+  });
+
+  uint64_t bound = budget;
+  std::vector<Plan> terms;
+  for (const SearchQuery::Node* child : order) {
+    Plan term = this->_compile(*child, bound);
+    if (term.access != Access::NONE && !term.capped) {
+      // Anything longer than this would not be intersected, so stop counting there
+      bound = std::min(bound, saturatingMultiply(term.estimate, INTERSECT_RATIO) + 1);
+    }
+    terms.push_back(std::move(term));
+  }
+  if (terms.empty()) {
+    return plan;
+  }
+
+  auto driver = terms.end();
+  for (auto it = terms.begin(); it != terms.end(); ++it) {
+    if (it->access == Access::NONE) continue;
+    if (driver == terms.end() || it->cost < driver->cost ||
+        (it->cost == driver->cost && it->node->text.size() > driver->node->text.size())) {
+      driver = it;
+    }
+  }
+
+  if (driver == terms.end()) {
+    Plan scan;
+    scan.access = Access::FULL_SCAN;
+    scan.estimate = scan.cost = this->_total();
+    plan.children.push_back(std::move(scan));
+  } else {
+    plan.children.push_back(std::move(*driver));
+    terms.erase(driver);
+  }
+  Plan& first = plan.children.front();
+  first.role = Role::DRIVER;
+  plan.estimate = first.estimate;
+  plan.capped = first.capped;
+  plan.cost = first.cost;
+  this->_assign(plan, terms);
+  return plan;
+}
+
+/**
+ * @brief Decides how the terms of a conjunction narrow its driver's list.
+ *
+ * A term is intersected, or subtracted if it is the negation of a term that can be
+ * listed, when its list is at most `INTERSECT_RATIO` times longer than the driver's;
+ * it is checked per row otherwise. A text term scanned while planning is intersected
+ * whatever its length, since its list is already in memory.
+ *
+ * @param plan The conjunction, whose only child is its driver.
+ * @param terms The other terms, moved into `plan`.
+ */
+void SearchPlanner::_assign(Plan& plan, std::vector<Plan>& terms) {
+  const uint64_t limit = saturatingMultiply(plan.children.front().estimate, INTERSECT_RATIO);
+  auto listable = [&](const Plan& term) {
+    if (term.access == Access::TEXT_SCAN) {
+      return term.scanned;
+    }
+    return term.access != Access::NONE && !term.capped && term.cost <= limit;
+  };
+
+  for (Plan& term : terms) {
+    if (listable(term)) {
+      term.role = Role::INTERSECT;
+      plan.cost += term.cost;
+      if (term.estimate < plan.estimate) {
+        plan.estimate = term.estimate;
+        plan.capped = false;
+      }
+    } else if (term.node && term.node->kind == SearchQuery::Kind::NOT && listable(term.children.front())) {
+      term.role = Role::EXCLUDE;
+      plan.cost += term.children.front().cost;
+    } else {
+      term.role = Role::FILTER;
+    }
+  }
+  // Lists before row checks, so that rows are only read for what survives the lists
+  std::stable_partition(terms.begin(), terms.end(), [](const Plan& term) {
+    return term.role != Role::FILTER;
+  });
+  std::move(terms.begin(), terms.end(), std::back_inserter(plan.children));
+}
+
+/**
+ * @brief Lists the quacks matching a step.
+ *
+ * @param plan The step, which must have an access other than NONE.
+ * @return The IDs of the matching quacks, ascending; deleted quacks may be included.
+ */
+std::vector<int32_t> SearchPlanner::_produce(const Plan& plan) {
+  std::vector<int32_t> quack_ids;
+  const SearchQuery::Node* node = plan.node;
+
+  switch (plan.access) {
+    case Access::HASHTAG_INDEX:
+      quack_ids = this->_column("SELECT tid FROM hashtag_mentions WHERE LOWER(term) = ?1", [&](sqlite3_stmt* stmt) {
+        sqlite3_bind_text(stmt, 1, node->text.c_str(), -1, SQLITE_STATIC);
+      });
+      break;
+
+    case Access::AUTHOR_INDEX:
+      for (const int32_t& author : plan.authors) {
+        std::vector<int32_t> written = this->_column("SELECT tid FROM tweets WHERE writer_id = ?1", [&](sqlite3_stmt* stmt) {
+          sqlite3_bind_int(stmt, 1, author);
+        });
+        quack_ids.insert(quack_ids.end(), written.begin(), written.end());
+      }
+      break;
+
+    case Access::DATE_INDEX:
+      quack_ids = this->_column("SELECT tid FROM tweets WHERE tdate BETWEEN ?1 AND ?2", [&](sqlite3_stmt* stmt) {
+        sqlite3_bind_text(stmt, 1, node->since.c_str(), -1, SQLITE_STATIC);
+        sqlite3_bind_text(stmt, 2, node->until.empty() ? "9999-99-99" : node->until.c_str(), -1, SQLITE_STATIC);
+      });
+      break;
+
+    case Access::REPLY_INDEX:
+      quack_ids = this->_column("SELECT tid FROM tweets WHERE replyto_tid > 0", [](sqlite3_stmt*) {});
+      break;
+
+    case Access::FULL_SCAN:
+      quack_ids = this->_column("SELECT tid FROM tweets", [](sqlite3_stmt*) {});
+      break;
+
+    case Access::TEXT_SCAN:
+      quack_ids = plan.scanned ? plan.candidates : this->_scanText(*node);
+      break;
+
+    case Access::UNION:
+      for (const Plan& branch : plan.children) {
+        std::vector<int32_t> listed = this->_produce(branch);
+        std::vector<int32_t> merged;
+        merged.reserve(quack_ids.size() + listed.size());
+        std::set_union(quack_ids.begin(), quack_ids.end(), listed.begin(), listed.end(), std::back_inserter(merged));
+        quack_ids.swap(merged);
+      }
+      return quack_ids;
+
+    case Access::INTERSECT: {
+      quack_ids = this->_produce(plan.children.front());
+      std::vector<const Plan*> filters;
+      for (size_t i = 1; i < plan.children.size() && !quack_ids.empty(); ++i) {
+        const Plan& term = plan.children[i];
+        if (term.role == Role::FILTER) {
+          filters.push_back(&term);
+          continue;
+        }
+        std::vector<int32_t> narrowed;
+        if (term.role == Role::EXCLUDE) {
+          const std::vector<int32_t> listed = this->_produce(term.children.front());
+          std::set_difference(quack_ids.begin(), quack_ids.end(), listed.begin(), listed.end(), std::back_inserter(narrowed));
+        } else {
+          const std::vector<int32_t> listed = this->_produce(term);
+          std::set_intersection(quack_ids.begin(), quack_ids.end(), listed.begin(), listed.end(), std::back_inserter(narrowed));
+        }
+        quack_ids.swap(narrowed);
+      }
+      if (!filters.empty() && !quack_ids.empty()) {
+        this->_fetch(quack_ids);
+        std::erase_if(quack_ids, [&](const int32_t& quack_id) {
+          const Pond::Quack& quack = this->_rows.at(quack_id);
+          return !std::all_of(filters.begin(), filters.end(), [&](const Plan* filter) {
+            return this->_matches(*filter, quack);
+          });
+        });
+      }
+      return quack_ids;
+    }
+
+    case Access::NONE:
+      break;
+  }
+
+  sortUnique(quack_ids);
+  return quack_ids;
+}
+
+/**
+ * @brief Checks whether a quack matches a step.
+ *
+ * @param plan The step.
+ * @param quack The quack's row.
+ * @return true if it matches.
+ */
+bool SearchPlanner::_matches(const Plan& plan, const Pond::Quack& quack) {
+  if (quack.tid == 0) {
+    return false;
+  }
+  if (plan.access == Access::INTERSECT) {
+    return std::all_of(plan.children.begin(), plan.children.end(), [&](const Plan& term) {
+      return this->_matches(term, quack);
+    });
+  }
+  if (!plan.node) {
+    return true;   // full scan
+  }
+
+  const SearchQuery::Node& node = *plan.node;
+  switch (node.kind) {
+    case SearchQuery::Kind::AND:
+      return true;   // compiled as INTERSECT; an empty conjunction
+    case SearchQuery::Kind::OR:
+      return std::any_of(plan.children.begin(), plan.children.end(), [&](const Plan& branch) {
+        return this->_matches(branch, quack);
+      });
+    case SearchQuery::Kind::NOT:
+      return !this->_matches(plan.children.front(), quack);
+    case SearchQuery::Kind::WORD:
+    case SearchQuery::Kind::PHRASE:
+      return Pond::_hasWord(quack.text.c_str(), quack.text.size(), node.text);
+    case SearchQuery::Kind::FRAGMENT: {
+      std::string text = quack.text;
+      std::transform(text.begin(), text.end(), text.begin(), [](const char& c) {
+        return c >= 'A' && c <= 'Z' ? static_cast<char>(c + ('a' - 'A')) : c;
+      });
+      return text.find(node.text) != std::string::npos;
+    }
+    case SearchQuery::Kind::HASHTAG: {
+      const char* query = "SELECT 1 FROM hashtag_mentions WHERE tid = ?1 AND LOWER(term) = ?2";
+      if (!this->_tag_check && sqlite3_prepare_v2(this->_pond._db, query, -1, &this->_tag_check, nullptr) != SQLITE_OK) {
+        std::cerr << "SQL Error (hashtag check): " << sqlite3_errmsg(this->_pond._db) << std::endl;
+        sqlite3_finalize(this->_tag_check);
+        this->_tag_check = nullptr;
+        this->_failed = true;
+        return false;
+      }
+      sqlite3_bind_int(this->_tag_check, 1, quack.tid);
+      sqlite3_bind_text(this->_tag_check, 2, node.text.c_str(), -1, SQLITE_STATIC);
+      const bool tagged = sqlite3_step(this->_tag_check) == SQLITE_ROW;
+      sqlite3_reset(this->_tag_check);
+      return tagged;
+    }
+    case SearchQuery::Kind::AUTHOR:
+      return std::binary_search(plan.authors.begin(), plan.authors.end(), quack.writer_id);
+    case SearchQuery::Kind::DATES:
+      return quack.date >= node.since && (node.until.empty() || quack.date <= node.until);
+    case SearchQuery::Kind::REPLY:
+      return quack.replyto_tid > 0;
+  }
+  return false;
+}
+
+/**
+ * @brief Lists the quacks matching a text term with the in-memory text scan.
+ *
+ * Words and phrases are checked as whole words against the scanned text itself, so no
+ * row is read for the many quacks that merely contain their letters.
+ *
+ * @param node The word, phrase or fragment.
+ * @return The IDs of the matching quacks, newest first.
+ */
+std::vector<int32_t> SearchPlanner::_scanText(const SearchQuery::Node& node) {
+  if (node.kind == SearchQuery::Kind::FRAGMENT) {
+    return this->_pond._indexes->text_scan.search(this->_pond._db, node.text);
+  }
+  return this->_pond._indexes->text_scan.search(this->_pond._db, node.text, 0, [&node](const char* text, const size_t& size) {
+    return Pond::_hasWord(text, size, node.text);
+  });
+}
+
+/**
+ * @brief Reads the rows of quacks not read yet, in one batch.
+ *
+ * @param quack_ids The quacks.
+ */
+void SearchPlanner::_fetch(const std::vector<int32_t>& quack_ids) {
+  std::vector<int32_t> missing;
+  for (const int32_t& quack_id : quack_ids) {
+    if (this->_rows.find(quack_id) == this->_rows.end()) {
+      missing.push_back(quack_id);
+    }
+  }
+  std::vector<Pond::Quack> rows = this->_pond.getQuacksFromIDs(missing);
+  for (size_t i = 0; i < missing.size(); ++i) {
+    this->_rows.emplace(missing[i], std::move(rows[i]));
+  }
+}
+
+/**
+ * @brief Runs a query and collects its first column.
+ *
+ * @param query The SQL query.
+ * @param bind Binds the query's parameters.
+ * @return The values, in the order returned.
+ */
+std::vector<int32_t> SearchPlanner::_column(const char* query, const std::function<void(sqlite3_stmt*)>& bind) {
+  std::vector<int32_t> values;
+  sqlite3_stmt* stmt;
+  if (sqlite3_prepare_v2(this->_pond._db, query, -1, &stmt, nullptr) != SQLITE_OK) {
+    std::cerr << "SQL Error (search plan): " << sqlite3_errmsg(this->_pond._db) << std::endl;
+    sqlite3_finalize(stmt);
+    this->_failed = true;
+    return values;
+  }
+  bind(stmt);
+
+  int rc;
+  while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+    values.push_back(sqlite3_column_int(stmt, 0));
+  }
+  if (rc != SQLITE_DONE) {
+    this->_failed = true;
+  }
+  sqlite3_finalize(stmt);
+  return values;
+}
+
+/**
+ * @brief Counts the rows of a query, stopping past a budget.
+ *
+ * A budget of 0 counts nothing, for terms that will only be checked per row.
+ *
+ * @param from The query's `FROM ... WHERE ...` clause.
+ * @param bind Binds the clause's parameters.
+ * @param budget The most rows worth counting.
+ * @param plan Set to the count.
+ */
+void SearchPlanner::_count(const std::string& from, const std::function<void(sqlite3_stmt*)>& bind, const uint64_t& budget, Plan& plan) {
+  plan.estimate = plan.cost = 0;
+  if (budget == 0) {
+    plan.capped = true;
+    return;
+  }
+
+  // SQLite treats a negative LIMIT as none
+  const std::string limit = budget == UNLIMITED ? "-1" : std::to_string(budget);
+  const std::string query = "SELECT COUNT(*) FROM (SELECT 1 " + from + " LIMIT " + limit + ")";
+  const std::vector<int32_t> count = this->_column(query.c_str(), bind);
+  if (!count.empty()) {
+    plan.estimate = plan.cost = static_cast<uint64_t>(count.front());
+  }
+  plan.capped = budget != UNLIMITED && plan.estimate >= budget;
+}
+
+/**
+ * @brief Retrieves an upper bound on the number of quacks.
+ *
+ * The largest quack ID is one index seek away, unlike an exact count.
+ *
+ * @return The bound.
+ */
+uint64_t SearchPlanner::_total() {
+  if (this->_quacks == 0) {
+    const std::vector<int32_t> largest = this->_column("SELECT IFNULL(MAX(tid), 0) FROM tweets", [](sqlite3_stmt*) {});
+    this->_quacks = largest.empty() ? 1 : std::max<uint64_t>(1, static_cast<uint64_t>(std::max(largest.front(), 0)));
+  }
+  return this->_quacks;
+}
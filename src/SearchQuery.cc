@@ -0,0 +1,350 @@
+#include "SearchQuery.hh"
+
+#include <algorithm>
+#include <cctype>
+
+/**
+ * @brief Lowercases ASCII letters, leaving every other byte unchanged.
+ *
+ * @param text The text.
+ * @return The lowercased text.
+ */
+static std::string lowercase(std::string text) {
+  for (char& c : text) {
+    if (c >= 'A' && c <= 'Z') c += 'a' - 'A';
+  }
+  return text;
+}
+
+/**
+ * @brief Checks whether a text is a date written as YYYY-MM-DD.
+ *
+ * @param text The text.
+ * @return true if it has the shape of a date.
+ */
+static bool isDate(const std::string& text) {
+  if (text.size() != 10 || text[4] != '-' || text[7] != '-') {
+    return false;
+  }
+  for (size_t i : {0, 1, 2, 3, 5, 6, 8, 9}) {
+    if (!std::isdigit(static_cast<unsigned char>(text[i]))) return false;
+  }
+  return true;
+}
+
+// =============================================================================
+// Public Methods
+// =============================================================================
+
+/**
+ * @brief Parses a query.
+ *
+ * @param query The query text.
+ * @return The normalized tree; an `AND` without children if the query has no terms.
+ */
+SearchQuery::Node SearchQuery::parse(const std::string& query) {
+  const std::vector<Token> tokens = _tokenize(query);
+  Node root;
+  size_t at = 0;
+  while (at < tokens.size()) {
+    Node alternatives = _parseOr(tokens, at);
+    if (!alternatives.children.empty() || alternatives.kind != Kind::AND) {
+      root.children.push_back(std::move(alternatives));
+    }
+    // A closing parenthesis without an opening one ends `_parseOr` early; skip it
+    if (at < tokens.size()) ++at;
+  }
+  _normalize(root);
+  return root;
+}
+
+/**
+ * @brief Prints a tree as a canonical query.
+ *
+ * @param node The tree.
+ * @return The query, with explicit operators and parentheses.
+ */
+std::string SearchQuery::describe(const Node& node) {
+  switch (node.kind) {
+    case Kind::AND:
+    case Kind::OR: {
+      const char* separator = node.kind == Kind::AND ? " AND " : " OR ";
+      std::string text = "(";
+      for (size_t i = 0; i < node.children.size(); ++i) {
+        if (i > 0) text += separator;
+        text += describe(node.children[i]);
+      }
+      return text + ")";
+    }
+    case Kind::NOT:      return "NOT " + describe(node.children.front());
+    case Kind::WORD:     return node.text;
+    case Kind::PHRASE:   return "\"" + node.text + "\"";
+    case Kind::FRAGMENT: return "*" + node.text + "*";
+    case Kind::HASHTAG:  return node.text;
+    case Kind::AUTHOR:   return "from:" + node.text;
+    case Kind::REPLY:    return "is:reply";
+    case Kind::DATES: {
+      std::string text;
+      if (!node.since.empty()) text += "since:" + node.since;
+      if (!node.since.empty() && !node.until.empty()) text += " ";
+      if (!node.until.empty()) text += "until:" + node.until;
+      return text;
+    }
+  }
+  return "";
+}
+
+// =============================================================================
+// Private Methods
+// =============================================================================
+
+/**
+ * @brief Splits a query into tokens.
+ *
+ * Parentheses, commas and quotes end a bare term as whitespace does, so `(a,b)` is
+ * five tokens.
+ *
+ * @param query The query text.
+ * @return The tokens.
+ */
+std::vector<SearchQuery::Token> SearchQuery::_tokenize(const std::string& query) {
+  std::vector<Token> tokens;
+  size_t at = 0;
+  while (at < query.size()) {
+    const char c = query[at];
+    if (std::isspace(static_cast<unsigned char>(c))) {
+      ++at;
+    } else if (c == '(') {
+      tokens.push_back({Token::Type::OPEN, {}});
+      ++at;
+    } else if (c == ')') {
+      tokens.push_back({Token::Type::CLOSE, {}});
+      ++at;
+    } else if (c == ',') {
+      tokens.push_back({Token::Type::OR, {}});
+      ++at;
+    } else if (c == '-' && at + 1 < query.size() && !std::isspace(static_cast<unsigned char>(query[at + 1]))) {
+      tokens.push_back({Token::Type::NOT, {}});
+      ++at;
+    } else if (c == '"') {
+      size_t end = query.find('"', at + 1);
+      if (end == std::string::npos) end = query.size();
+      // Words of a phrase are compared one space apart
+      std::string phrase;
+      for (size_t i = at + 1; i < end; ++i) {
+        const bool space = std::isspace(static_cast<unsigned char>(query[i]));
+        if (!space) {
+          phrase += query[i];
+        } else if (!phrase.empty() && phrase.back() != ' ') {
+          phrase += ' ';
+        }
+      }
+      if (!phrase.empty() && phrase.back() == ' ') phrase.pop_back();
+      if (!phrase.empty()) {
+        Node term;
+        term.kind = phrase.find(' ') == std::string::npos ? Kind::WORD : Kind::PHRASE;
+        term.text = lowercase(phrase);
+        tokens.push_back({Token::Type::TERM, std::move(term)});
+      }
+      at = std::min(end + 1, query.size());
+    } else {
+      size_t end = at;
+      while (end < query.size() && !std::isspace(static_cast<unsigned char>(query[end])) &&
+             query[end] != '(' && query[end] != ')' && query[end] != ',' && query[end] != '"') {
+        ++end;
+      }
+      const std::string word = query.substr(at, end - at);
+      if (word == "AND") tokens.push_back({Token::Type::AND, {}});
+      else if (word == "OR") tokens.push_back({Token::Type::OR, {}});
+      else if (word == "NOT") tokens.push_back({Token::Type::NOT, {}});
+      else tokens.push_back({Token::Type::TERM, _term(word)});
+      at = end;
+    }
+  }
+  return tokens;
+}
+
+/**
+ * @brief Classifies a bare (unquoted) term.
+ *
+ * @param word The term as written.
+ * @return The term's node.
+ */
+SearchQuery::Node SearchQuery::_term(const std::string& word) {
+  Node term;
+  const std::string lowered = lowercase(word);
+  if (lowered.rfind("from:", 0) == 0 && lowered.size() > 5) {
+    term.kind = Kind::AUTHOR;
+    term.text = lowered.substr(lowered[5] == '@' ? 6 : 5);
+  } else if (lowered.rfind("since:", 0) == 0 && isDate(lowered.substr(6))) {
+    term.kind = Kind::DATES;
+    term.since = lowered.substr(6);
+  } else if (lowered.rfind("until:", 0) == 0 && isDate(lowered.substr(6))) {
+    term.kind = Kind::DATES;
+    term.until = lowered.substr(6);
+  } else if (lowered == "is:reply") {
+    term.kind = Kind::REPLY;
+  } else if (lowered.size() > 1 && lowered.front() == '#') {
+    term.kind = Kind::HASHTAG;
+    term.text = lowered;
+  } else if (lowered.size() > 2 && lowered.front() == '*' && lowered.back() == '*') {
+    term.kind = Kind::FRAGMENT;
+    term.text = lowered.substr(1, lowered.size() - 2);
+  } else {
+    term.kind = Kind::WORD;
+    term.text = lowered;
+  }
+  return term;
+}
+
+/**
+ * @brief Parses alternatives: `and (OR and)*`.
+ *
+ * An empty alternative, as in `a OR OR b`, is dropped.
+ *
+ * @param tokens The tokens.
+ * @param at The next token, advanced past the alternatives.
+ * @return The alternatives' node.
+ */
+SearchQuery::Node SearchQuery::_parseOr(const std::vector<Token>& tokens, size_t& at) {
+  Node alternatives;
+  alternatives.kind = Kind::OR;
+  while (true) {
+    Node conjunction = _parseAnd(tokens, at);
+    if (!conjunction.children.empty()) {
+      alternatives.children.push_back(std::move(conjunction));
+    }
+    if (at < tokens.size() && tokens[at].type == Token::Type::OR) {
+      ++at;
+      continue;
+    }
+    break;
+  }
+  if (alternatives.children.empty()) {
+    return Node{};
+  }
+  return alternatives;
+}
+
+/**
+ * @brief Parses conjunctions: `unary ([AND] unary)*`.
+ *
+ * @param tokens The tokens.
+ * @param at The next token, advanced past the conjunction.
+ * @return The conjunction's node.
+ */
+SearchQuery::Node SearchQuery::_parseAnd(const std::vector<Token>& tokens, size_t& at) {
+  Node conjunction;
+  while (at < tokens.size()) {
+    if (tokens[at].type == Token::Type::AND) {
+      ++at;
+      continue;
+    }
+    Node node;
+    if (!_parseUnary(tokens, at, node)) {
+      break;
+    }
+    conjunction.children.push_back(std::move(node));
+  }
+  return conjunction;
+}
+
+/**
+ * @brief Parses a negation, a parenthesized group or a term.
+ *
+ * @param tokens The tokens.
+ * @param at The next token, advanced past what was parsed.
+ * @param node Set to the node parsed.
+ * @return true if a node was parsed; false at the end of a group or of the query.
+ */
+bool SearchQuery::_parseUnary(const std::vector<Token>& tokens, size_t& at, Node& node) {
+  while (at < tokens.size()) {
+    const Token& token = tokens[at];
+    switch (token.type) {
+      case Token::Type::TERM:
+        node = token.term;
+        ++at;
+        return true;
+      case Token::Type::NOT: {
+        ++at;
+        Node negated;
+        if (!_parseUnary(tokens, at, negated)) {
+          return false;
+        }
+        node = Node{Kind::NOT, "", "", "", {}};
+        node.children.push_back(std::move(negated));
+        return true;
+      }
+      case Token::Type::OPEN: {
+        ++at;
+        Node group = _parseOr(tokens, at);
+        if (at < tokens.size() && tokens[at].type == Token::Type::CLOSE) {
+          ++at;
+        }
+        if (group.kind == Kind::AND && group.children.empty()) {
+          continue;   // `()`: nothing to match, look for the next term
+        }
+        node = std::move(group);
+        return true;
+      }
+      case Token::Type::AND:
+        ++at;
+        continue;
+      case Token::Type::OR:
+      case Token::Type::CLOSE:
+        return false;
+    }
+  }
+  return false;
+}
+
+/**
+ * @brief Flattens, simplifies and merges date bounds, bottom up.
+ *
+ * @param node The tree to normalize in place.
+ */
+void SearchQuery::_normalize(Node& node) {
+  for (Node& child : node.children) {
+    _normalize(child);
+  }
+
+  if (node.kind == Kind::NOT) {
+    Node& child = node.children.front();
+    if (child.kind == Kind::NOT) {
+      Node inner = std::move(child.children.front());
+      node = std::move(inner);
+    }
+    return;
+  }
+  if (node.kind != Kind::AND && node.kind != Kind::OR) {
+    return;
+  }
+
+  std::vector<Node> flat;
+  for (Node& child : node.children) {
+    if (child.kind == node.kind) {
+      for (Node& grandchild : child.children) flat.push_back(std::move(grandchild));
+    } else {
+      flat.push_back(std::move(child));
+    }
+  }
+  node.children.clear();
+  size_t dates = flat.size();   // index of the conjunction's date range, once there is one
+  for (Node& child : flat) {
+    // The tightest bounds of one conjunction form a single range
+    if (node.kind == Kind::AND && child.kind == Kind::DATES) {
+      if (dates < node.children.size()) {
+        Node& range = node.children[dates];
+        if (range.since.empty() || child.since > range.since) range.since = child.since;
+        if (range.until.empty() || (!child.until.empty() && child.until < range.until)) range.until = child.until;
+        continue;
+      }
+      dates = node.children.size();
+    }
+    node.children.push_back(std::move(child));
+  }
+  if (node.children.size() == 1) {
+    Node only = std::move(node.children.front());
+    node = std::move(only);
+  }
+}
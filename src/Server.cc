@@ -0,0 +1,502 @@
+#include "Server.hh"
+
+#include "JsonWriter.hh"
+
+#include <arpa/inet.h>
+#include <cctype>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <netinet/in.h>
+#include <sstream>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// =============================================================================
+// Public Methods
+// =============================================================================
+
+/**
+ * @brief Constructs a server with the given options.
+ *
+ * @param options The configuration of the server.
+ */
+Server::Server(const Options& options)
+  : _options(options) {}
+
+/**
+ * @brief Serves connections until SIGINT or SIGTERM.
+ *
+ * The signals are blocked before any thread starts and read from a `signalfd` on the
+ * loop, so shutdown happens between events rather than inside a handler.
+ *
+ * @return true if the server shut down cleanly; false if it could not start.
+ */
+bool Server::run() {
+  sigset_t signals;
+  sigemptyset(&signals);
+  sigaddset(&signals, SIGINT);
+  sigaddset(&signals, SIGTERM);
+  pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+  this->_loop = std::make_unique<EventLoop>();
+  if (!this->_loop->valid()) {
+    std::cerr << "Server Error: Can't create event loop" << std::endl;
+    return false;
+  }
+
+  sockaddr_in address = {};
+  address.sin_family = AF_INET;
+  address.sin_port = htons(this->_options.port);
+  if (inet_pton(AF_INET, this->_options.address.c_str(), &address.sin_addr) != 1) {
+    std::cerr << "Server Error: Invalid address " << this->_options.address << std::endl;
+    return false;
+  }
+
+  this->_listener = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  int reuse = 1;
+  setsockopt(this->_listener, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+  if (this->_listener < 0 ||
+      bind(this->_listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+      listen(this->_listener, SOMAXCONN) != 0) {
+    std::cerr << "Server Error: Can't listen on " << this->_options.address << ":" << this->_options.port
+              << " (" << std::strerror(errno) << ")" << std::endl;
+    if (this->_listener >= 0) close(this->_listener);
+    return false;
+  }
+
+  int signal_fd = signalfd(-1, &signals, SFD_NONBLOCK | SFD_CLOEXEC);
+  PondRegistry::Options registry;
+  registry.io_threads = this->_options.io_threads;
+  registry.idle_timeout = std::chrono::seconds(std::max(this->_options.idle_timeout_s, 1u));
+  registry.quota = this->_options.quota;
+  this->_registry = std::make_unique<PondRegistry>(registry);
+  this->_logins = std::make_unique<SessionManager>(std::chrono::seconds(this->_options.session_timeout_s));
+  if (std::filesystem::is_directory(this->_options.db_filename)) {
+    this->_registry->addDirectory(this->_options.db_filename);
+  } else {
+    this->_default_tenant = "default";
+    this->_registry->add(this->_default_tenant, this->_options.db_filename);
+    this->_registry->purge(this->_default_tenant);
+  }
+
+  this->_loop->watch(this->_listener, [this](uint32_t) {
+    this->_accept();
+  });
+  this->_loop->watch(signal_fd, [this](uint32_t) {
+    this->_loop->stop();
+  });
+
+  std::cerr << "Serving " << this->_options.db_filename << " on " << this->_options.address << ":"
+            << this->_options.port << " (" << this->_registry->tenants().size() << " communities served, "
+            << this->_options.io_threads << " I/O threads)" << std::endl;
+  this->_loop->run();
+  std::cerr << "Shutting down with " << this->_sessions << " open sessions" << std::endl;
+
+  this->_loop->unwatch(this->_listener);
+  this->_loop->unwatch(signal_fd);
+  close(this->_listener);
+  close(signal_fd);
+
+  // Finish the I/O calls in flight while the loop they resume on still exists
+  this->_registry->report(std::cerr);
+  for (const auto& [tenant, admission] : this->_admissions) {
+    std::cerr << tenant << " ";
+    admission->report(std::cerr);
+  }
+  this->_registry.reset();
+  return true;
+}
+
+// =============================================================================
+// Private Methods
+// =============================================================================
+
+/**
+ * @brief Accepts every pending connection and starts a session for each.
+ *
+ * The listener is edge-triggered, so it is drained until `accept4` would block.
+ */
+void Server::_accept() {
+  while (true) {
+    int fd = accept4(this->_listener, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (fd < 0) {
+      if (errno == EINTR || errno == ECONNABORTED) continue;
+      return;
+    }
+
+    std::shared_ptr<Connection> connection = std::make_shared<Connection>(*this->_loop, fd);
+    if (connection->start()) {
+      spawn(this->_session(std::move(connection)));
+    }
+  }
+}
+
+/**
+ * @brief Runs one client session until it quits or disconnects.
+ *
+ * @param connection The client's connection.
+ * @return The session coroutine.
+ */
+Task<void> Server::_session(std::shared_ptr<Connection> connection) {
+  ++this->_sessions;
+  Session session;
+  session.json = this->_options.json;
+  if (!this->_default_tenant.empty()) {
+    session.tenant = this->_default_tenant;
+    session.pond = this->_registry->tenant(session.tenant);
+  }
+
+  bool open = co_await connection->write("OK Quacker server ready\n");
+  while (open) {
+    std::optional<std::string> line = co_await connection->readLine();
+    if (!line) {
+      break;
+    }
+
+    std::istringstream words(*line);
+    std::string command;
+    words >> command;
+    for (char& c : command) c = static_cast<char>(std::toupper(static_cast<unsigned char>(c)));
+
+    if (command == "QUIT") {
+      co_await connection->write("OK bye\n");
+      break;
+    }
+    std::string reply = co_await this->_execute(*line, session, connection->hangup());
+    open = co_await connection->write(reply);
+  }
+
+  --this->_sessions;
+}
+
+/**
+ * @brief Executes one command line and builds its reply.
+ *
+ * @param line The command line.
+ * @param session The session, updated by `USE`, `LOGIN`, `RESUME`, `LOGOUT` and `FORMAT`.
+ * @param hangup Cancelled if the client's connection fails.
+ * @return The reply, ending in a newline.
+ */
+Task<std::string> Server::_execute(const std::string& line, Session& session, const CancellationToken& hangup) {
+  std::istringstream words(line);
+  std::string command;
+  words >> command;
+  for (char& c : command) c = static_cast<char>(std::toupper(static_cast<unsigned char>(c)));
+
+  std::string rest;
+  std::getline(words >> std::ws, rest);
+
+  const AsyncPond::CallOptions options = AsyncPond::CallOptions::within(std::chrono::milliseconds(this->_options.deadline_ms), hangup);
+  std::ostringstream reply;
+  JsonWriter json;
+
+  if (command == "HELP" || command.empty()) {
+    co_return "OK COMMUNITIES USE FORMAT LOGIN RESUME LOGOUT FEED QUACK REQUACK UNQUACK SEARCH USERS FOLLOW UNFOLLOW NOTIFICATIONS QUIT\n";
+  }
+
+  if (command == "FORMAT") {
+    if (rest != "text" && rest != "json") {
+      co_return "ERR usage: FORMAT text|json\n";
+    }
+    session.json = rest == "json";
+    co_return "OK format " + rest + "\n";
+  }
+
+  if (command == "COMMUNITIES") {
+    const std::vector<std::string> names = this->_registry->tenants();
+    reply << "OK " << names.size() << "\n";
+    for (const std::string& name : names) {
+      if (session.json) {
+        json.value(name).endLine();
+      } else {
+        reply << name << "\n";
+      }
+    }
+    co_return reply.str() + json.take();
+  }
+
+  if (command == "USE") {
+    AsyncPond* pond = this->_registry->tenant(rest);
+    if (!pond) {
+      co_return "ERR unknown community " + _field(rest) + "\n";
+    }
+    session.tenant = rest;
+    session.pond = pond;
+    session.token.clear();
+    co_return "OK using " + rest + "\n";
+  }
+
+  // A session can be resumed from any community; it switches to the session's own
+  if (command == "RESUME") {
+    std::optional<SessionManager::Session> login = this->_logins->find(rest);
+    AsyncPond* pond = login ? this->_registry->tenant(login->tenant) : nullptr;
+    if (!pond) {
+      co_return "ERR unknown or expired session\n";
+    }
+    session.tenant = login->tenant;
+    session.pond = pond;
+    session.token = rest;
+    reply << "OK resumed " << login->user_id << "\n";
+    co_return reply.str();
+  }
+
+  if (command == "LOGOUT") {
+    if (session.token.empty()) {
+      co_return "ERR login required\n";
+    }
+    this->_logins->remove(session.token);
+    session.token.clear();
+    co_return "OK\n";
+  }
+
+  if (!session.pond) {
+    co_return "ERR no community selected (USE <community>)\n";
+  }
+
+  if (command == "LOGIN") {
+    int32_t id = 0;
+    std::string password;
+    std::istringstream args(rest);
+    if (!(args >> id >> password)) {
+      co_return "ERR usage: LOGIN <user id> <password>\n";
+    }
+    // Only the stored hash is read on an I/O thread; the slow check runs on the worker pool
+    AsyncResult<std::string> stored = co_await session.pond->getPasswordHash(id, options);
+    if (!stored.ok()) co_return _failure(stored.status);
+    SessionManager::Verification verification = co_await this->_logins->verify(password, stored.value);
+    if (!verification.valid) co_return "ERR invalid user id or password\n";
+    if (!verification.rehashed.empty()) {
+      co_await session.pond->setPasswordHash(id, verification.rehashed, options);
+    }
+
+    session.token = this->_logins->create(session.tenant, id);
+    AsyncResult<std::string> name = co_await session.pond->getUsername(id, options);
+    reply << "OK session " << session.token << " " << (name.ok() ? _field(name.value) : std::to_string(id)) << "\n";
+    co_return reply.str();
+  }
+
+  if (command == "SEARCH" || command == "USERS") {
+    if (rest.empty()) {
+      co_return "ERR usage: " + command + " <keywords>\n";
+    }
+    if (command == "SEARCH") {
+      AsyncResult<std::vector<Pond::Quack>> quacks = co_await session.pond->searchForQuacks(rest, options);
+      if (!quacks.ok()) co_return _failure(quacks.status);
+      reply << "OK " << quacks.value.size() << "\n";
+      for (const Pond::Quack& quack : quacks.value) {
+        if (session.json) {
+          json.quack(quack).endLine();
+        } else {
+          reply << quack.tid << "\t" << quack.writer_id << "\t" << quack.date << " " << quack.time
+                << "\t" << _field(quack.text) << "\n";
+        }
+      }
+    } else {
+      AsyncResult<std::vector<Pond::User>> users = co_await session.pond->searchForUsers(rest, options);
+      if (!users.ok()) co_return _failure(users.status);
+      reply << "OK " << users.value.size() << "\n";
+      for (const Pond::User& user : users.value) {
+        if (session.json) {
+          json.user(user).endLine();
+        } else {
+          reply << user.usr << "\t" << _field(user.name) << "\n";
+        }
+      }
+    }
+    co_return reply.str() + json.take();
+  }
+
+  if (command != "FEED" && command != "QUACK" && command != "REQUACK" && command != "UNQUACK" &&
+      command != "FOLLOW" && command != "UNFOLLOW" && command != "NOTIFICATIONS") {
+    co_return "ERR unknown command " + _field(command) + "\n";
+  }
+  if (session.token.empty()) {
+    co_return "ERR login required\n";
+  }
+  std::optional<SessionManager::Session> login = this->_logins->find(session.token);
+  if (!login) {
+    session.token.clear();
+    co_return "ERR session expired, login required\n";
+  }
+  const int32_t user_id = login->user_id;
+
+  // Writes are rate limited per user, then wait their turn for one of the write slots
+  AdmissionController::Ticket slot;
+  if (command != "FEED" && command != "NOTIFICATIONS") {
+    AdmissionController::Operation operation = AdmissionController::Operation::FOLLOW;
+    if (command == "QUACK") operation = AdmissionController::Operation::QUACK;
+    else if (command == "REQUACK") operation = AdmissionController::Operation::REQUACK;
+    else if (command == "UNQUACK") operation = AdmissionController::Operation::DELETE;
+
+    AdmissionController& admission = this->_admissionOf(session.tenant);
+    const AdmissionController::Decision decision = admission.admit(user_id, operation);
+    if (!decision.admitted) {
+      reply << "ERR rate limited, retry after " << decision.retry_after.count() << " ms\n";
+      co_return reply.str();
+    }
+    slot = co_await admission.enter(user_id);
+    if (!slot) {
+      reply << "ERR busy, retry after " << slot.retryAfter().count() << " ms\n";
+      co_return reply.str();
+    }
+  }
+
+  if (command == "FEED") {
+    // "more" continues from the session's cursor; anything else starts over, and an order
+    // given explicitly becomes the session's preference
+    Pond::FeedMode mode = login->feed_mode;
+    size_t offset = 0;
+    if (rest == "more") {
+      offset = login->feed_offset;
+    } else if (rest == "ranked") {
+      mode = Pond::FeedMode::RANKED;
+    } else if (rest == "chronological") {
+      mode = Pond::FeedMode::CHRONOLOGICAL;
+    }
+    AsyncResult<std::vector<Pond::FeedEntry>> feed = co_await session.pond->getFeedPage(user_id, mode, offset, FEED_PAGE, options);
+    if (!feed.ok()) co_return _failure(feed.status);
+    const size_t sent = feed.value.size();
+    this->_logins->update(session.token, [mode, offset, sent](SessionManager::Session& state) {
+      state.feed_mode = mode;
+      state.feed_offset = offset + sent;
+    });
+    reply << "OK " << feed.value.size() << "\n";
+    for (const Pond::FeedEntry& entry : feed.value) {
+      if (session.json) {
+        json.feedEntry(entry).endLine();
+      } else {
+        reply << entry.tid << "\t" << entry.type << "\t" << _field(entry.author) << "\t" << entry.date << " "
+              << entry.time << "\t" << _field(entry.text) << "\n";
+      }
+    }
+  } else if (command == "QUACK") {
+    AsyncResult<std::optional<int32_t>> quack = co_await session.pond->addQuack(user_id, rest, options);
+    if (!quack.ok()) co_return _failure(quack.status);
+    if (!quack.value) co_return co_await this->_rejected(session, user_id, "ERR quack rejected\n", options);
+    reply << "OK quacked " << *quack.value << "\n";
+  } else if (command == "REQUACK") {
+    int32_t quack_id = 0;
+    std::istringstream args(rest);
+    if (!(args >> quack_id)) {
+      co_return "ERR usage: REQUACK <quack id>\n";
+    }
+    AsyncResult<int32_t> requack = co_await session.pond->addRequack(user_id, quack_id, options);
+    if (!requack.ok()) co_return _failure(requack.status);
+    if (requack.value == 1) co_return "ERR already requacked\n";
+    if (requack.value != 0) co_return co_await this->_rejected(session, user_id, "ERR requack rejected\n", options);
+    reply << "OK\n";
+  } else if (command == "UNQUACK") {
+    int32_t quack_id = 0;
+    std::istringstream args(rest);
+    if (!(args >> quack_id)) {
+      co_return "ERR usage: UNQUACK <quack id>\n";
+    }
+    AsyncResult<bool> deleted = co_await session.pond->deleteQuack(user_id, quack_id, options);
+    if (!deleted.ok()) co_return _failure(deleted.status);
+    if (!deleted.value) co_return "ERR not deleted\n";
+    this->_registry->purge(session.tenant);
+    reply << "OK\n";
+  } else if (command == "FOLLOW" || command == "UNFOLLOW") {
+    int32_t other = 0;
+    std::istringstream args(rest);
+    if (!(args >> other)) {
+      co_return "ERR usage: " + command + " <user id>\n";
+    }
+    AsyncResult<bool> changed = command == "FOLLOW"
+      ? co_await session.pond->follow(user_id, other, options)
+      : co_await session.pond->unfollow(user_id, other, options);
+    if (!changed.ok()) co_return _failure(changed.status);
+    if (!changed.value) co_return co_await this->_rejected(session, user_id, "ERR not changed\n", options);
+    reply << "OK\n";
+  } else {
+    int64_t before = 0;
+    std::istringstream args(rest);
+    args >> before;
+    AsyncResult<std::vector<Pond::Notification>> page = co_await session.pond->getNotifications(user_id, before, options);
+    if (!page.ok()) co_return _failure(page.status);
+    reply << "OK " << page.value.size() << "\n";
+    for (const Pond::Notification& notification : page.value) {
+      if (session.json) {
+        json.notification(notification).endLine();
+      } else {
+        reply << notification.nid << "\t" << static_cast<int>(notification.kind) << "\t"
+              << _field(notification.actor_name) << "\t" << notification.tid << "\t" << _field(notification.snippet) << "\n";
+      }
+    }
+  }
+  co_return reply.str() + json.take();
+}
+
+/**
+ * @brief Builds the reply to a rejected write, ending the user's sessions if the write
+ *        was rejected because the user has been deleted.
+ *
+ * Logins are checked without the database, so a user deleted while logged in is only
+ * noticed when the database turns down one of their writes.
+ *
+ * @param session The session, logged out if the user has been deleted.
+ * @param user_id The unique ID of the user.
+ * @param reply The reply if the user still exists.
+ * @param options The deadline and cancellation of the command.
+ * @return The reply, ending in a newline.
+ */
+Task<std::string> Server::_rejected(Session& session, const int32_t& user_id, const std::string& reply,
+                                    const AsyncPond::CallOptions& options) {
+  AsyncResult<std::string> name = co_await session.pond->getUsername(user_id, options);
+  if (!name.ok() || !name.value.empty()) {
+    co_return reply;
+  }
+  this->_logins->revoke(session.tenant, user_id);
+  session.token.clear();
+  co_return "ERR user deleted, login required\n";
+}
+
+/**
+ * @brief Retrieves the admission controller of a community, creating it on first use.
+ *
+ * Each community is its own database with its own writer, so each has its own write
+ * slots and buckets; a user ID names different users in different communities.
+ *
+ * @param tenant The community.
+ * @return The controller.
+ */
+AdmissionController& Server::_admissionOf(const std::string& tenant) {
+  std::unique_ptr<AdmissionController>& admission = this->_admissions[tenant];
+  if (!admission) {
+    admission = std::make_unique<AdmissionController>(this->_options.admission);
+  }
+  return *admission;
+}
+
+/**
+ * @brief Formats the error reply of a call that did not complete.
+ *
+ * @param status How the call ended.
+ * @return The reply.
+ */
+std::string Server::_failure(const AsyncStatus& status) {
+  switch (status) {
+    case AsyncStatus::CANCELLED:   return "ERR cancelled\n";
+    case AsyncStatus::TIMED_OUT:   return "ERR timed out\n";
+    case AsyncStatus::UNAVAILABLE: return "ERR database unavailable\n";
+    default:                       return "ERR failed\n";
+  }
+}
+
+/**
+ * @brief Replaces tabs and line breaks so a field fits in one reply column.
+ *
+ * @param field The field.
+ * @return The field, safe to join with tabs.
+ */
+std::string Server::_field(const std::string& field) {
+  std::string safe = field;
+  for (char& c : safe) {
+    if (c == '\t' || c == '\n' || c == '\r') c = ' ';
+  }
+  return safe;
+}
@@ -0,0 +1,213 @@
+#include "SessionManager.hh"
+
+#include <random>
+
+#include "PasswordHash.hh"
+
+// =============================================================================
+// Public Methods
+// =============================================================================
+
+/**
+ * @brief Constructs an empty session table.
+ *
+ * @param idle_timeout How long a session may go unused before it expires.
+ * @param scheduler The worker pool passwords are checked on.
+ */
+SessionManager::SessionManager(const std::chrono::seconds& idle_timeout, TaskScheduler& scheduler)
+  : _idle_timeout(std::max(idle_timeout, std::chrono::seconds(1))), _scheduler(scheduler) {}
+
+/**
+ * @brief Checks a password against a stored hash on the worker pool.
+ *
+ * An empty `stored` (no such user) is checked against a dummy hash, so an unknown user
+ * takes as long to reject as a wrong password.
+ *
+ * @param password The password entered.
+ * @param stored The stored hash or plain-text password, or empty if there is none.
+ * @return The awaitable check.
+ */
+SessionManager::Verify SessionManager::verify(const std::string& password, const std::string& stored) {
+  return Verify(this->_scheduler, password, stored);
+}
+
+/**
+ * @brief Starts a session for a logged-in user.
+ *
+ * @param tenant The community the user belongs to.
+ * @param user_id The unique ID of the user.
+ * @return The session's token.
+ */
+std::string SessionManager::create(const std::string& tenant, const int32_t& user_id) {
+  static const char* const digits = "0123456789abcdef";
+  std::random_device random;
+  std::string token(32, '0');
+  for (size_t i = 0; i < token.size(); i += 8) {
+    uint32_t word = random();
+    for (size_t j = 0; j < 8; ++j, word >>= 4) {
+      token[i + j] = digits[word & 0xf];
+    }
+  }
+
+  const auto now = std::chrono::steady_clock::now();
+  Shard& shard = this->_shard(token);
+  std::lock_guard<std::mutex> lock(shard.lock);
+  // Sweep at most a few times per timeout, so creating stays O(1) amortized
+  if (now - shard.last_sweep >= this->_idle_timeout / 4) {
+    this->_sweep(shard, now);
+    shard.last_sweep = now;
+  }
+  shard.sessions[token] = Session{tenant, user_id, Pond::FeedMode::CHRONOLOGICAL, 0, now};
+  return token;
+}
+
+/**
+ * @brief Looks up a session and marks it used.
+ *
+ * @param token The session's token.
+ * @return A copy of the session, or nothing if the token is unknown or expired.
+ */
+std::optional<SessionManager::Session> SessionManager::find(const std::string& token) {
+  std::optional<Session> found;
+  this->update(token, [&found](Session& session) {
+    found = session;
+  });
+  return found;
+}
+
+/**
+ * @brief Changes a session and marks it used.
+ *
+ * @param token The session's token.
+ * @param change Called with the session, under its shard's lock.
+ * @return true if the session exists; false if the token is unknown or expired.
+ */
+bool SessionManager::update(const std::string& token, const std::function<void(Session&)>& change) {
+  const auto now = std::chrono::steady_clock::now();
+  Shard& shard = this->_shard(token);
+  std::lock_guard<std::mutex> lock(shard.lock);
+
+  auto it = shard.sessions.find(token);
+  if (it == shard.sessions.end()) {
+    return false;
+  }
+  if (now - it->second.last_used > this->_idle_timeout) {
+    shard.sessions.erase(it);
+    return false;
+  }
+  it->second.last_used = now;
+  change(it->second);
+  return true;
+}
+
+/**
+ * @brief Ends a session.
+ *
+ * @param token The session's token.
+ * @return true if the session existed.
+ */
+bool SessionManager::remove(const std::string& token) {
+  Shard& shard = this->_shard(token);
+  std::lock_guard<std::mutex> lock(shard.lock);
+  return shard.sessions.erase(token) > 0;
+}
+
+/**
+ * @brief Ends every session of a user, e.g. once the user has been deleted.
+ *
+ * Sessions are sharded by token, not by user, so every shard is searched; this is
+ * only done when a user is deleted.
+ *
+ * @param tenant The community the user belongs to.
+ * @param user_id The unique ID of the user.
+ * @return The number of sessions ended.
+ */
+size_t SessionManager::revoke(const std::string& tenant, const int32_t& user_id) {
+  size_t revoked = 0;
+  for (Shard& shard : this->_shards) {
+    std::lock_guard<std::mutex> lock(shard.lock);
+    revoked += std::erase_if(shard.sessions, [&](const auto& entry) {
+      return entry.second.user_id == user_id && entry.second.tenant == tenant;
+    });
+  }
+  return revoked;
+}
+
+/**
+ * @brief Drops every expired session.
+ *
+ * @return The number of sessions dropped.
+ */
+size_t SessionManager::expire() {
+  const auto now = std::chrono::steady_clock::now();
+  size_t dropped = 0;
+  for (Shard& shard : this->_shards) {
+    std::lock_guard<std::mutex> lock(shard.lock);
+    dropped += this->_sweep(shard, now);
+    shard.last_sweep = now;
+  }
+  return dropped;
+}
+
+/**
+ * @brief Retrieves the number of sessions, including expired ones not yet dropped.
+ *
+ * @return The number of sessions.
+ */
+size_t SessionManager::size() const {
+  size_t count = 0;
+  for (const Shard& shard : this->_shards) {
+    std::lock_guard<std::mutex> lock(shard.lock);
+    count += shard.sessions.size();
+  }
+  return count;
+}
+
+// =============================================================================
+// Private Methods
+// =============================================================================
+
+/**
+ * @brief Checks a password against a stored hash.
+ *
+ * @param password The password entered.
+ * @param stored The stored hash or plain-text password, or empty if there is none.
+ * @return Whether it matches, and the hash to store instead if the old one is weak.
+ */
+SessionManager::Verification SessionManager::_verify(const std::string& password, const std::string& stored) {
+  if (stored.empty()) {
+    static const std::string dummy = PasswordHash::hash("");
+    PasswordHash::verify(password, dummy);
+    return {};
+  }
+
+  Verification verification;
+  verification.valid = PasswordHash::verify(password, stored);
+  if (verification.valid && PasswordHash::needsRehash(stored)) {
+    verification.rehashed = PasswordHash::hash(password);
+  }
+  return verification;
+}
+
+/**
+ * @brief Retrieves the shard of a token.
+ *
+ * @param token The token.
+ * @return The shard.
+ */
+SessionManager::Shard& SessionManager::_shard(const std::string& token) {
+  return this->_shards[std::hash<std::string>{}(token) % SHARDS];
+}
+
+/**
+ * @brief Drops the expired sessions of a shard; its lock must be held.
+ *
+ * @param shard The shard.
+ * @param now The current time.
+ * @return The number of sessions dropped.
+ */
+size_t SessionManager::_sweep(Shard& shard, const std::chrono::steady_clock::time_point& now) {
+  return std::erase_if(shard.sessions, [&](const auto& entry) {
+    return now - entry.second.last_used > this->_idle_timeout;
+  });
+}
@@ -0,0 +1,389 @@
+#include "TaskScheduler.hh"
+
+#include <chrono>
+
+namespace {
+
+// The scheduler and worker index of the current thread, if it is a worker
+thread_local const TaskScheduler* t_scheduler = nullptr;
+thread_local uint32_t t_worker = 0;
+
+// Background tasks running on this thread; nested ones reuse the outer task's slot
+thread_local uint32_t t_background_depth = 0;
+
+constexpr size_t INTERACTIVE = static_cast<size_t>(TaskScheduler::Priority::INTERACTIVE);
+constexpr size_t BACKGROUND = static_cast<size_t>(TaskScheduler::Priority::BACKGROUND);
+
+} // namespace
+
+// =============================================================================
+// Public Methods
+// =============================================================================
+
+/**
+ * @brief Starts a scheduler.
+ *
+ * With a single worker, background tasks may use it; otherwise one worker is always
+ * left for interactive tasks.
+ *
+ * @param threads The number of workers; 0 uses every hardware thread.
+ */
+TaskScheduler::TaskScheduler(const uint32_t& threads) {
+  uint32_t count = threads > 0 ? threads : std::max(1u, std::thread::hardware_concurrency());
+  this->_background_limit = std::max(1u, count - 1);
+
+  for (uint32_t i = 0; i < count; ++i) {
+    this->_workers.push_back(std::make_unique<Worker>());
+  }
+  for (uint32_t i = 0; i < count; ++i) {
+    this->_workers[i]->thread = std::thread(&TaskScheduler::_work, this, i);
+  }
+}
+
+/**
+ * @brief Runs every queued task, then stops the workers.
+ */
+TaskScheduler::~TaskScheduler() {
+  {
+    std::lock_guard<std::mutex> lock(this->_sleep_lock);
+    this->_stopping = true;
+  }
+  this->_wake.notify_all();
+  for (auto& worker : this->_workers) {
+    worker->thread.join();
+  }
+}
+
+/**
+ * @brief Retrieves the process-wide scheduler, sized to the machine's cores.
+ *
+ * @return The shared scheduler, started on first use.
+ */
+TaskScheduler& TaskScheduler::shared() {
+  static TaskScheduler scheduler;
+  return scheduler;
+}
+
+/**
+ * @brief Queues a task that nobody waits on.
+ *
+ * @param task The task to run.
+ * @param priority The priority of the task.
+ */
+void TaskScheduler::submit(std::function<void()> task, const Priority& priority) {
+  this->_push(std::move(task), priority);
+}
+
+/**
+ * @brief Runs a function over `[begin, end)` in chunks and waits for all of them.
+ *
+ * The calling thread runs the last chunk itself and then helps with the rest, so a
+ * range that fits in one chunk never touches the queues.
+ *
+ * @param begin The first index.
+ * @param end One past the last index.
+ * @param body Called with the bounds of each chunk.
+ * @param grain The largest number of indices per chunk.
+ * @param priority The priority of the chunks.
+ */
+void TaskScheduler::parallelFor(const size_t& begin, const size_t& end, const std::function<void(size_t, size_t)>& body, const size_t& grain, const Priority& priority) {
+  if (begin >= end) {
+    return;
+  }
+  const size_t step = std::max<size_t>(grain, 1);
+
+  TaskGroup group(*this, priority);
+  size_t from = begin;
+  while (end - from > step) {
+    const size_t to = from + step;
+    group.run([&body, from, to] {
+      body(from, to);
+    });
+    from = to;
+  }
+  body(from, end);
+  group.wait();
+}
+
+/**
+ * @brief Retrieves the number of workers.
+ *
+ * @return The number of worker threads.
+ */
+uint32_t TaskScheduler::size() const {
+  return static_cast<uint32_t>(this->_workers.size());
+}
+
+/**
+ * @brief Retrieves a snapshot of the scheduler's counters.
+ *
+ * The counters are read one at a time while workers keep running, so they are only
+ * mutually consistent when the scheduler is idle.
+ *
+ * @return The current metrics.
+ */
+TaskScheduler::Metrics TaskScheduler::metrics() const {
+  Metrics metrics;
+  metrics.workers = this->size();
+  metrics.submitted = this->_submitted;
+  metrics.executed = this->_executed;
+  metrics.steals = this->_steals;
+  metrics.queued_interactive = this->_queued[INTERACTIVE];
+  metrics.queued_background = this->_queued[BACKGROUND];
+  metrics.peak_queued = this->_peak_queued;
+  return metrics;
+}
+
+// =============================================================================
+// TaskGroup
+// =============================================================================
+
+/**
+ * @brief Constructs an empty group.
+ *
+ * @param scheduler The scheduler that runs the group's tasks.
+ * @param priority The priority of every task in the group.
+ */
+TaskScheduler::TaskGroup::TaskGroup(TaskScheduler& scheduler, const Priority& priority)
+  : _scheduler(scheduler), _priority(priority) {}
+
+/**
+ * @brief Waits for any tasks still running.
+ */
+TaskScheduler::TaskGroup::~TaskGroup() {
+  this->wait();
+}
+
+/**
+ * @brief Submits a task to the group.
+ *
+ * The count is dropped under the group's lock so that a waiter that sees it reach zero
+ * cannot destroy the group while the task is still notifying it.
+ *
+ * @param task The task to run.
+ */
+void TaskScheduler::TaskGroup::run(std::function<void()> task) {
+  ++this->_pending;
+  this->_scheduler._push([this, task = std::move(task)] {
+    task();
+    std::lock_guard<std::mutex> lock(this->_lock);
+    if (--this->_pending == 0) {
+      this->_finished.notify_all();
+    }
+  }, this->_priority);
+}
+
+/**
+ * @brief Runs queued tasks until every task of the group has finished.
+ *
+ * The waiting thread only helps with tasks of the group's priority or higher, so an
+ * interactive caller never ends up running a batch task. When nothing is runnable it
+ * sleeps briefly and looks again, since its own tasks may be running elsewhere.
+ */
+void TaskScheduler::TaskGroup::wait() {
+  while (this->_pending > 0) {
+    if (this->_scheduler._runOne(this->_priority)) {
+      continue;
+    }
+    std::unique_lock<std::mutex> lock(this->_lock);
+    this->_finished.wait_for(lock, std::chrono::milliseconds(1), [this] {
+      return this->_pending == 0;
+    });
+  }
+  std::lock_guard<std::mutex> lock(this->_lock);
+}
+
+/**
+ * @brief Checks whether every task of the group has finished.
+ *
+ * @return true if no task of the group is queued or running.
+ */
+bool TaskScheduler::TaskGroup::done() const {
+  return this->_pending == 0;
+}
+
+// =============================================================================
+// Private Methods
+// =============================================================================
+
+/**
+ * @brief Queues a task on the current worker, or the injection queue elsewhere.
+ *
+ * The queued count is raised before the task becomes visible, so it never drops below
+ * the number of tasks a thief can find.
+ *
+ * @param task The task to run.
+ * @param priority The priority of the task.
+ */
+void TaskScheduler::_push(std::function<void()> task, const Priority& priority) {
+  const size_t p = static_cast<size_t>(priority);
+  const size_t queued = ++this->_queued[p] + this->_queued[1 - p];
+  size_t peak = this->_peak_queued;
+  while (queued > peak && !this->_peak_queued.compare_exchange_weak(peak, queued)) {}
+  ++this->_submitted;
+
+  if (t_scheduler == this) {
+    Worker& worker = *this->_workers[t_worker];
+    std::lock_guard<std::mutex> lock(worker.lock);
+    worker.queues[p].push_back(std::move(task));
+  } else {
+    std::lock_guard<std::mutex> lock(this->_injection_lock);
+    this->_injection[p].push_back(std::move(task));
+  }
+  this->_wakeOne();
+}
+
+/**
+ * @brief Takes and runs one queued task.
+ *
+ * Interactive tasks are always tried first. A background task needs one of the
+ * `_background_limit` slots, unless the thread is already inside a background task
+ * (e.g. waiting on its `parallelFor`), which would otherwise deadlock on its own slot.
+ *
+ * @param lowest The lowest priority the caller may run.
+ * @return true if a task was run; false if none was available.
+ */
+bool TaskScheduler::_runOne(const Priority& lowest) {
+  std::function<void()> task;
+  if (this->_take(Priority::INTERACTIVE, task)) {
+    task();
+    ++this->_executed;
+    return true;
+  }
+  if (lowest == Priority::INTERACTIVE || this->_queued[BACKGROUND] == 0) {
+    return false;
+  }
+
+  const bool nested = t_background_depth > 0;
+  if (!nested) {
+    uint32_t running = this->_background_running;
+    do {
+      if (running >= this->_background_limit) {
+        return false;
+      }
+    } while (!this->_background_running.compare_exchange_weak(running, running + 1));
+  }
+
+  const bool taken = this->_take(Priority::BACKGROUND, task);
+  if (taken) {
+    ++t_background_depth;
+    task();
+    --t_background_depth;
+    ++this->_executed;
+  }
+  if (!nested) {
+    --this->_background_running;
+    this->_wakeOne();
+  }
+  return taken;
+}
+
+/**
+ * @brief Takes a task of one priority: own deque, then injection queue, then steals.
+ *
+ * The owner pops the newest task; injected and stolen tasks are the oldest. Victims
+ * are scanned starting after the current worker so thieves spread out.
+ *
+ * @param priority The priority to take.
+ * @param[out] task The task taken.
+ * @return true if a task was taken.
+ */
+bool TaskScheduler::_take(const Priority& priority, std::function<void()>& task) {
+  const size_t p = static_cast<size_t>(priority);
+  if (this->_queued[p] == 0) {
+    return false;
+  }
+
+  const bool is_worker = t_scheduler == this;
+  if (is_worker) {
+    Worker& own = *this->_workers[t_worker];
+    std::lock_guard<std::mutex> lock(own.lock);
+    if (!own.queues[p].empty()) {
+      task = std::move(own.queues[p].back());
+      own.queues[p].pop_back();
+      --this->_queued[p];
+      return true;
+    }
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(this->_injection_lock);
+    if (!this->_injection[p].empty()) {
+      task = std::move(this->_injection[p].front());
+      this->_injection[p].pop_front();
+      --this->_queued[p];
+      return true;
+    }
+  }
+
+  const size_t count = this->_workers.size();
+  const size_t start = is_worker ? t_worker : 0;
+  for (size_t k = 1; k <= count; ++k) {
+    const size_t victim = (start + k) % count;
+    if (is_worker && victim == t_worker) {
+      continue;
+    }
+    Worker& other = *this->_workers[victim];
+    std::lock_guard<std::mutex> lock(other.lock);
+    if (!other.queues[p].empty()) {
+      task = std::move(other.queues[p].front());
+      other.queues[p].pop_front();
+      --this->_queued[p];
+      ++this->_steals;
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * @brief Checks whether a worker has a task it may run right now.
+ *
+ * @return true if an interactive task is queued, or a background task is queued and
+ *         a background slot is free.
+ */
+bool TaskScheduler::_hasRunnable() const {
+  return this->_queued[INTERACTIVE] > 0 ||
+         (this->_queued[BACKGROUND] > 0 && this->_background_running < this->_background_limit);
+}
+
+/**
+ * @brief Runs tasks until the scheduler stops.
+ *
+ * Once stopping, a worker keeps going until no task is left in any queue.
+ *
+ * @param index The index of the worker.
+ */
+void TaskScheduler::_work(const uint32_t& index) {
+  t_scheduler = this;
+  t_worker = index;
+
+  while (true) {
+    if (this->_runOne(Priority::BACKGROUND)) {
+      continue;
+    }
+    std::unique_lock<std::mutex> lock(this->_sleep_lock);
+    if (this->_stopping) {
+      if (this->_queued[INTERACTIVE] == 0 && this->_queued[BACKGROUND] == 0) {
+        return;
+      }
+      // Only tasks waiting for a background slot (or being pushed) are left
+      this->_wake.wait_for(lock, std::chrono::milliseconds(1));
+      continue;
+    }
+    this->_wake.wait(lock, [this] {
+      return this->_stopping || this->_hasRunnable();
+    });
+  }
+}
+
+/**
+ * @brief Wakes one sleeping worker.
+ *
+ * Taking the sleep lock orders the wake-up after any worker's check of its predicate,
+ * so a wake-up cannot fall between the check and the wait.
+ */
+void TaskScheduler::_wakeOne() {
+  { std::lock_guard<std::mutex> lock(this->_sleep_lock); }
+  this->_wake.notify_one();
+}
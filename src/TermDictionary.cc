@@ -0,0 +1,205 @@
+#include "TermDictionary.hh"
+
+#include <algorithm>
+#include <iterator>
+
+// =============================================================================
+// Public Methods
+// =============================================================================
+
+/**
+ * @brief Adds a value under a term, inserting the term if needed.
+ *
+ * Values for known terms are appended in place. New terms go to a small unsorted
+ * buffer that is merged into the sorted terms once it reaches `MERGE_THRESHOLD`.
+ *
+ * @param term The term to index.
+ * @param value The value to store with the term.
+ */
+void TermDictionary::insert(const std::string& term, const int32_t& value) {
+  auto sorted = std::lower_bound(this->_sorted.begin(), this->_sorted.end(), term, [](const Entry& entry, const std::string& t) {
+    return entry.term < t;
+  });
+  if (sorted != this->_sorted.end() && sorted->term == term) {
+    sorted->values.push_back(value);
+    return;
+  }
+
+  auto pending = std::find_if(this->_pending.begin(), this->_pending.end(), [&term](const Entry& entry) {
+    return entry.term == term;
+  });
+  if (pending != this->_pending.end()) {
+    pending->values.push_back(value);
+    return;
+  }
+
+  this->_pending.push_back({term, {value}});
+  if (this->_pending.size() >= MERGE_THRESHOLD) {
+    this->_merge();
+  }
+}
+
+/**
+ * @brief Replaces the contents of the dictionary in one sort.
+ *
+ * Preferred over repeated `insert` calls when building from scratch.
+ *
+ * @param postings (term, value) pairs; a term may appear any number of times.
+ */
+void TermDictionary::load(std::vector<std::pair<std::string, int32_t>> postings) {
+  this->clear();
+  std::sort(postings.begin(), postings.end());
+
+  for (auto& [term, value] : postings) {
+    if (this->_sorted.empty() || this->_sorted.back().term != term) {
+      this->_sorted.push_back({std::move(term), {}});
+    }
+    this->_sorted.back().values.push_back(value);
+  }
+}
+
+/**
+ * @brief Finds every term within an edit distance of a query.
+ *
+ * The sorted terms are walked in order while keeping one edit-distance row per prefix
+ * length. A term only computes the rows past its common prefix with the previous term,
+ * and a row whose minimum exceeds `max_distance` skips every term sharing that prefix.
+ * Buffered inserts are compared one by one.
+ *
+ * @param query The term to search for.
+ * @param max_distance The largest edit distance accepted.
+ * @return The matching terms in no particular order. Pointers stay valid until the
+ *         next insert or clear.
+ */
+std::vector<TermDictionary::Match> TermDictionary::search(const std::string& query, const uint32_t& max_distance) const {
+  std::vector<TermDictionary::Match> matches;
+
+  // rows[d] is the edit-distance row of the query against the first d bytes of a term
+  std::vector<std::vector<uint32_t>> rows(1, std::vector<uint32_t>(query.size() + 1));
+  for (size_t j = 0; j <= query.size(); ++j) {
+    rows[0][j] = static_cast<uint32_t>(j);
+  }
+
+  const std::string* previous = nullptr;
+  size_t computed = 0;   // rows[0..computed] are valid for prefixes of *previous
+  size_t i = 0;
+  while (i < this->_sorted.size()) {
+    const Entry& entry = this->_sorted[i];
+    const std::string& term = entry.term;
+
+    size_t depth = 0;
+    if (previous) {
+      size_t limit = std::min({computed, term.size(), previous->size()});
+      while (depth < limit && term[depth] == (*previous)[depth]) {
+        ++depth;
+      }
+    }
+
+    bool pruned = false;
+    for (; depth < term.size(); ++depth) {
+      if (rows.size() <= depth + 1) {
+        rows.emplace_back(query.size() + 1);
+      }
+      if (_nextRow(query, rows[depth], term[depth], rows[depth + 1]) > max_distance) {
+        // Terms sharing this prefix are contiguous and start here; skip all of them
+        const size_t length = depth + 1;
+        auto end = std::partition_point(this->_sorted.begin() + i, this->_sorted.end(), [&term, &length](const Entry& other) {
+          return other.term.compare(0, length, term, 0, length) == 0;
+        });
+        i = end - this->_sorted.begin();
+        previous = &term;
+        computed = length;
+        pruned = true;
+        break;
+      }
+    }
+    if (pruned) {
+      continue;
+    }
+
+    uint32_t distance = rows[term.size()][query.size()];
+    if (distance <= max_distance) {
+      matches.push_back({&term, distance, &entry.values});
+    }
+    previous = &term;
+    computed = term.size();
+    ++i;
+  }
+
+  std::vector<uint32_t> row(query.size() + 1);
+  std::vector<uint32_t> next(query.size() + 1);
+  for (const Entry& entry : this->_pending) {
+    row = rows[0];
+    for (const char& byte : entry.term) {
+      _nextRow(query, row, byte, next);
+      row.swap(next);
+    }
+    if (row[query.size()] <= max_distance) {
+      matches.push_back({&entry.term, row[query.size()], &entry.values});
+    }
+  }
+
+  return matches;
+}
+
+/**
+ * @brief Removes every term from the dictionary.
+ */
+void TermDictionary::clear() {
+  this->_sorted.clear();
+  this->_pending.clear();
+}
+
+/**
+ * @brief Retrieves the number of distinct terms in the dictionary.
+ *
+ * @return The number of terms.
+ */
+size_t TermDictionary::size() const {
+  return this->_sorted.size() + this->_pending.size();
+}
+
+// =============================================================================
+// Private Methods
+// =============================================================================
+
+/**
+ * @brief Sorts the buffered inserts into the dictionary.
+ *
+ * Buffered terms are never already present (see `insert`), so this is a plain merge of
+ * two sorted runs.
+ */
+void TermDictionary::_merge() {
+  auto by_term = [](const Entry& a, const Entry& b) {
+    return a.term < b.term;
+  };
+  std::sort(this->_pending.begin(), this->_pending.end(), by_term);
+
+  std::vector<Entry> merged;
+  merged.reserve(this->_sorted.size() + this->_pending.size());
+  std::merge(std::make_move_iterator(this->_sorted.begin()), std::make_move_iterator(this->_sorted.end()),
+             std::make_move_iterator(this->_pending.begin()), std::make_move_iterator(this->_pending.end()),
+             std::back_inserter(merged), by_term);
+
+  this->_sorted.swap(merged);
+  this->_pending.clear();
+}
+
+/**
+ * @brief Computes one row of the edit-distance table.
+ *
+ * @param query The search query.
+ * @param previous The row of the prefix one byte shorter.
+ * @param byte The byte appended to the prefix.
+ * @param[out] row The row of the longer prefix.
+ * @return The smallest value in the new row.
+ */
+uint32_t TermDictionary::_nextRow(const std::string& query, const std::vector<uint32_t>& previous, const char& byte, std::vector<uint32_t>& row) {
+  row[0] = previous[0] + 1;
+  uint32_t best = row[0];
+  for (size_t j = 1; j <= query.size(); ++j) {
+    row[j] = std::min({previous[j] + 1, row[j - 1] + 1, previous[j - 1] + (query[j - 1] != byte ? 1u : 0u)});
+    best = std::min(best, row[j]);
+  }
+  return best;
+}
@@ -0,0 +1,388 @@
+#include "TextScanEngine.hh"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+// Text per parallel chunk: large enough to amortize a task, small enough to spread
+static constexpr size_t SCAN_CHUNK_BYTES = 256 * 1024;
+
+/**
+ * @brief Lowercases an ASCII letter, leaving every other byte unchanged.
+ *
+ * @param c The byte.
+ * @return The folded byte.
+ */
+static inline char foldCase(const char& c) {
+  return c >= 'A' && c <= 'Z' ? static_cast<char>(c + ('a' - 'A')) : c;
+}
+
+/**
+ * @brief Finds the first occurrence of a needle with `memchr` on its first byte.
+ *
+ * @param haystack The text to search.
+ * @param length The length of the text.
+ * @param needle The non-empty text to find.
+ * @return The offset of the first occurrence, or `length` if there is none.
+ */
+static size_t findScalar(const char* haystack, const size_t& length, const std::string& needle) {
+  const size_t k = needle.size();
+  if (k > length) {
+    return length;
+  }
+  const char* p = haystack;
+  const char* end = haystack + (length - k + 1);
+  while ((p = static_cast<const char*>(std::memchr(p, needle[0], end - p))) != nullptr) {
+    if (std::memcmp(p + 1, needle.data() + 1, k - 1) == 0) {
+      return p - haystack;
+    }
+    ++p;
+  }
+  return length;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+/**
+ * @brief Finds the first occurrence of a needle 32 positions at a time.
+ *
+ * Each step compares 32 bytes with the needle's first byte and the 32 bytes `k - 1`
+ * further on with its last byte; only positions where both match are compared in full.
+ * The tail shorter than a step is left to `findScalar`.
+ *
+ * @param haystack The text to search.
+ * @param length The length of the text.
+ * @param needle The non-empty text to find.
+ * @return The offset of the first occurrence, or `length` if there is none.
+ */
+__attribute__((target("avx2")))
+static size_t findAvx2(const char* haystack, const size_t& length, const std::string& needle) {
+  const size_t k = needle.size();
+  const __m256i first = _mm256_set1_epi8(needle[0]);
+  const __m256i last = _mm256_set1_epi8(needle[k - 1]);
+
+  size_t i = 0;
+  for (; i + k - 1 + 32 <= length; i += 32) {
+    const __m256i block_first = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(haystack + i));
+    const __m256i block_last = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(haystack + i + k - 1));
+    uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(
+      _mm256_and_si256(_mm256_cmpeq_epi8(first, block_first), _mm256_cmpeq_epi8(last, block_last))));
+
+    while (mask != 0) {
+      const size_t position = i + __builtin_ctz(mask);
+      if (k <= 2 || std::memcmp(haystack + position + 1, needle.data() + 1, k - 2) == 0) {
+        return position;
+      }
+      mask &= mask - 1;
+    }
+  }
+  return i + findScalar(haystack + i, length - i, needle);
+}
+#endif
+
+/**
+ * @brief Picks the fastest search the CPU supports, once per process.
+ *
+ * @return The search function.
+ */
+static size_t (*findFunction())(const char*, const size_t&, const std::string&) {
+#if defined(__x86_64__) || defined(__i386__)
+  static const bool avx2 = __builtin_cpu_supports("avx2");
+  if (avx2) {
+    return findAvx2;
+  }
+#endif
+  return findScalar;
+}
+
+// =============================================================================
+// Public Methods
+// =============================================================================
+
+/**
+ * @brief Constructs an empty engine, loaded on first search.
+ *
+ * @param scheduler The scheduler the chunks of a search run on.
+ */
+TextScanEngine::TextScanEngine(TaskScheduler& scheduler) : _scheduler(scheduler) {}
+
+/**
+ * @brief Loads the text if it has not been loaded or the database has changed since
+ *        it was.
+ *
+ * Quacks posted through the connections sharing the engine are recorded in it and
+ * move its version past them, so only a write made elsewhere reloads it.
+ *
+ * @param db The connection to read through.
+ * @return true if the text is current; false if it could not be loaded.
+ */
+bool TextScanEngine::refresh(sqlite3* db) {
+  std::lock_guard<std::mutex> lock(this->_lock);
+  return this->_refresh(db);
+}
+
+/**
+ * @brief Forgets the loaded text, so the next search loads it again; for changes a
+ *        connection made without recording them, e.g. deletions.
+ */
+void TextScanEngine::invalidate() {
+  std::lock_guard<std::mutex> lock(this->_lock);
+  this->_version.invalidate();
+}
+
+/**
+ * @brief Moves the text past a write whose quacks were recorded in it.
+ *
+ * @param from The version of the tables when the write began.
+ * @param to The version of the tables once the write is done.
+ */
+void TextScanEngine::advance(const int64_t& from, const int64_t& to) {
+  std::lock_guard<std::mutex> lock(this->_lock);
+  this->_version.advance(from, to);
+}
+
+/**
+ * @brief Retrieves the number of loads and invalidations of the text so far.
+ *
+ * @return The count.
+ */
+uint64_t TextScanEngine::loads() const {
+  std::lock_guard<std::mutex> lock(this->_lock);
+  return this->_version.loads();
+}
+
+/**
+ * @brief Records a quack posted through a connection sharing the engine, as the newest
+ *        one.
+ *
+ * Ignored until the text has been loaded, since the load will read it.
+ *
+ * @param quack_id The unique ID of the quack.
+ * @param text The text of the quack.
+ */
+void TextScanEngine::addQuack(const int32_t& quack_id, const std::string& text) {
+  std::lock_guard<std::mutex> lock(this->_lock);
+  if (!this->_version.isLoaded()) {
+    return;
+  }
+  this->_append(quack_id, text.data(), text.size());
+}
+
+/**
+ * @brief Takes quacks deleted through a connection sharing the engine out of the text.
+ *
+ * The text of each quack is blanked in place with '\0', which no fragment can match,
+ * so the arena needs no compacting; the space comes back at the next load. Ignored
+ * until the text has been loaded, since the load will leave the quacks out.
+ *
+ * @param quack_ids The unique IDs of the quacks.
+ */
+void TextScanEngine::removeQuacks(const std::vector<int32_t>& quack_ids) {
+  std::lock_guard<std::mutex> lock(this->_lock);
+  if (!this->_version.isLoaded() || quack_ids.empty()) {
+    return;
+  }
+  std::vector<int32_t> removed(quack_ids);
+  std::sort(removed.begin(), removed.end());
+  for (size_t quack = 0; quack < this->_tids.size(); ++quack) {
+    if (std::binary_search(removed.begin(), removed.end(), this->_tids[quack])) {
+      std::fill(this->_arena.begin() + this->_offsets[quack], this->_arena.begin() + this->_offsets[quack + 1], '\0');
+    }
+  }
+}
+
+/**
+ * @brief Finds the quacks whose text contains a fragment, ignoring ASCII case.
+ *
+ * The engine stays locked until the scan is done, so it must not be searched from a
+ * task of the scheduler it scans on.
+ *
+ * @param db The connection to load the text through.
+ * @param fragment The text to look for, anywhere in a quack, even inside a word.
+ * @param limit The most quacks to return; 0 returns every match.
+ * @param accept If set, also checks the lowercased text of each quack containing the
+ *        fragment, e.g. for whole words; called concurrently from the scan's tasks.
+ * @return The IDs of the matching quacks, newest first.
+ */
+std::vector<int32_t> TextScanEngine::search(
+  sqlite3* db,
+  const std::string& fragment,
+  const size_t& limit,
+  const std::function<bool(const char*, const size_t&)>& accept
+) {
+  // A '\0' would match across the end of a quack
+  if (fragment.empty() || fragment.find('\0') != std::string::npos) {
+    return {};
+  }
+  std::lock_guard<std::mutex> lock(this->_lock);
+  if (!this->_refresh(db)) {
+    return {};
+  }
+
+  std::string needle(fragment.size(), '\0');
+  std::transform(fragment.begin(), fragment.end(), needle.begin(), foldCase);
+
+  // Chunks hold whole quacks, so every match lies within one chunk
+  const size_t count = this->_tids.size();
+  const size_t grain = std::max<size_t>(1, count * SCAN_CHUNK_BYTES / std::max<size_t>(this->_arena.size(), 1));
+  std::vector<int32_t> matches = this->_scheduler.parallelReduce(
+    0, count, std::vector<int32_t>{},
+    [&](size_t first, size_t last) { return this->_scan(first, last, needle, accept); },
+    [](std::vector<int32_t> all, std::vector<int32_t> chunk) {
+      all.insert(all.end(), chunk.begin(), chunk.end());
+      return all;
+    },
+    grain);
+
+  std::reverse(matches.begin(), matches.end());
+  if (limit > 0 && matches.size() > limit) {
+    matches.resize(limit);
+  }
+  return matches;
+}
+
+/**
+ * @brief Retrieves the number of quacks loaded.
+ *
+ * @return The number of quacks in the arena.
+ */
+size_t TextScanEngine::size() const {
+  std::lock_guard<std::mutex> lock(this->_lock);
+  return this->_tids.size();
+}
+
+/**
+ * @brief Retrieves the memory held by the arena and offsets.
+ *
+ * @return The size in bytes.
+ */
+size_t TextScanEngine::bytes() const {
+  std::lock_guard<std::mutex> lock(this->_lock);
+  return this->_arena.capacity() + this->_offsets.capacity() * sizeof(size_t) +
+         this->_tids.capacity() * sizeof(int32_t);
+}
+
+// =============================================================================
+// Private Methods
+// =============================================================================
+
+/**
+ * @brief Loads the text unless it is current; the caller holds `_lock`.
+ *
+ * @param db The connection to read through.
+ * @return true if the text is current; false if it could not be loaded.
+ */
+bool TextScanEngine::_refresh(sqlite3* db) {
+  const int64_t version = IndexVersion::read(db);
+  if (version < 0) {
+    return false;
+  }
+  if (this->_version.current(version)) {
+    return true;
+  }
+  const bool loaded = this->_load(db);
+  this->_version.loaded(loaded ? version : -1);
+  return loaded;
+}
+
+/**
+ * @brief Reads the text of every live quack, oldest first, into an empty arena.
+ *
+ * Quacks posted through the connections sharing the engine are the newest, so
+ * appending them keeps the arena in date order.
+ *
+ * @param db The connection to read through.
+ * @return true if the table was read; false otherwise.
+ */
+bool TextScanEngine::_load(sqlite3* db) {
+  this->_arena.clear();
+  this->_offsets.assign(1, 0);
+  this->_tids.clear();
+
+  const char* query =
+    "SELECT tid, text FROM live_tweets "
+    "ORDER BY tdate, ttime, tid";
+
+  sqlite3_stmt* stmt;
+  if (sqlite3_prepare_v2(db, query, -1, &stmt, nullptr) != SQLITE_OK) {
+    std::cerr << "SQL Error (text scan): " << sqlite3_errmsg(db) << std::endl;
+    sqlite3_finalize(stmt);
+    return false;
+  }
+
+  int rc;
+  while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+    const char* text = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
+    this->_append(sqlite3_column_int(stmt, 0), text ? text : "", static_cast<size_t>(sqlite3_column_bytes(stmt, 1)));
+  }
+  sqlite3_finalize(stmt);
+
+  if (rc != SQLITE_DONE) {
+    std::cerr << "SQL Error (text scan): " << sqlite3_errmsg(db) << std::endl;
+    return false;
+  }
+  return true;
+}
+
+/**
+ * @brief Appends a quack to the arena.
+ *
+ * @param quack_id The unique ID of the quack.
+ * @param text The text, lowercased as it is copied.
+ * @param length The length of the text.
+ */
+void TextScanEngine::_append(const int32_t& quack_id, const char* text, const size_t& length) {
+  if (this->_offsets.empty()) {
+    this->_offsets.push_back(0);
+  }
+  const size_t start = this->_arena.size();
+  this->_arena.resize(start + length + 1);
+  std::transform(text, text + length, this->_arena.begin() + start, foldCase);
+  this->_arena.back() = '\0';
+  this->_offsets.push_back(this->_arena.size());
+  this->_tids.push_back(quack_id);
+}
+
+/**
+ * @brief Finds the quacks of a range that contain a fragment.
+ *
+ * After a match the scan resumes at the next quack, so each quack is reported once.
+ *
+ * @param first The index of the first quack.
+ * @param last One past the index of the last quack.
+ * @param needle The lowercased fragment.
+ * @param accept If set, also checks the text of each quack containing the fragment.
+ * @return The IDs of the matching quacks, oldest first.
+ */
+std::vector<int32_t> TextScanEngine::_scan(
+  const size_t& first,
+  const size_t& last,
+  const std::string& needle,
+  const std::function<bool(const char*, const size_t&)>& accept
+) const {
+  static const auto find = findFunction();
+  std::vector<int32_t> matches;
+  const char* arena = this->_arena.data();
+  const size_t end = this->_offsets[last];
+
+  size_t from = this->_offsets[first];
+  size_t quack = first;
+  while (from < end) {
+    const size_t position = from + find(arena + from, end - from, needle);
+    if (position >= end) {
+      break;
+    }
+    // The quack holding the match: the last one starting at or before it
+    quack = std::upper_bound(this->_offsets.begin() + quack + 1, this->_offsets.begin() + last + 1, position)
+            - this->_offsets.begin() - 1;
+    const size_t start = this->_offsets[quack];
+    if (!accept || accept(arena + start, this->_offsets[quack + 1] - start - 1)) {
+      matches.push_back(this->_tids[quack]);
+    }
+    from = this->_offsets[quack + 1];
+  }
+  return matches;
+}
@@ -2,7 +2,10 @@
 #include <iostream>
 
 #include "definitions.hh"
+#include "DigestJob.hh"
+#include "JsonWriter.hh"
 #include "Quacker.hh"
+#include "Server.hh"
 
 /**
  * @brief Main function for the Quacker application.
@@ -10,21 +13,290 @@
  * This function initializes the Quacker application with a database file
  * specified via command-line arguments. It checks for proper usage and
  * the existence of the provided file before proceeding.
+ *
+ * Maintenance commands run against the database and exit without starting
+ * the interactive interface:
+ * - `quacker --backfill-rollups <filename>` rebuilds the activity rollups.
+ * - `quacker --prune-spam <filename> [--days N] [--batch N]` folds spam requacks older
+ *   than the retention period into the spam ledger.
+ * - `quacker --delete-user <filename> <user id>` deletes a user, their quacks and lists.
+ * - `quacker --purge <filename>` removes the rows of everything deleted but not yet purged.
+ * - `quacker --hash-passwords <filename>` replaces plain-text passwords with salted hashes.
+ * - `quacker --digest <filename> <output_dir> [--threads N] [--shards N] [--top N] [--days N]`
+ *   writes the daily digest of every user into sharded files, resuming an interrupted run.
+ * - `quacker --json <filename> <query>` writes the result of a query to standard output as
+ *   JSON lines, one object per row. The queries are `feed <user id> [ranked]`,
+ *   `search <keywords>`, `users <keywords>`, `quacks <user id>` and
+ *   `notifications <user id>`. Search keywords use the query language of
+ *   `Pond::searchForQuacks`.
+ * - `quacker --explain-search <filename> <query>` prints the plan a search query would run
+ *   with, and how many quacks each step is expected to list.
+ * - `quacker --serve <filename|directory> <port> [--bind ADDR] [--io-threads N] [--deadline-ms N]
+ *   [--idle-timeout S] [--max-connections N] [--cache-kib N] [--session-timeout S]
+ *   [--format text|json] [--rate-limit OP=PER_MINUTE/BURST]... [--max-writes N]` serves the
+ *   line-based network protocol until interrupted; a directory is served as one community
+ *   per `.db` file, each with at most `--max-connections` connections and `--cache-kib` of
+ *   read caches. Logins are kept as sessions until unused for `--session-timeout` seconds.
+ *   `--format` sets the row format sessions start with. `--rate-limit` changes the write
+ *   rate limit of one operation (quack, reply, requack, follow or delete; a rate of 0
+ *   disables it), and `--max-writes` the writes run at once per community.
+ *
+ * `quacker <filename> --profile` runs the interactive interface and, on exit, prints
+ * hardware performance counters per database operation and rendering step.
  * 
  * @param argc Number of command-line arguments.
  * @param argv Array of command-line argument strings.
  * @return int Exit status code. Returns ERROR_USAGE for incorrect usage,
- *         ERROR_FILE if the file is not found, or 0 for success.
+ *         ERROR_FILE if the file is not found, ERROR_SQL if a maintenance
+ *         command fails, or 0 for success.
  */
 int main(int argc, char* argv[]) {
-  if (argc != 2) {
-    std::cerr << "Incorrect Usage: Expected quacker <filename>" << std::endl;
+  if (argc == 3 && std::string(argv[1]) == "--backfill-rollups") {
+    if (!std::filesystem::exists(argv[2])) {
+      std::cerr << "File Not Found: Cannot find database " << argv[2] << std::endl;
+      return ERROR_FILE;
+    }
+
+    Pond pond;
+    if (pond.loadDatabase(argv[2]) || !pond.backfillActivity()) {
+      std::cerr << "Database Error: Could not backfill rollups for " << argv[2] << std::endl;
+      return ERROR_SQL;
+    }
+    std::cout << "Activity rollups rebuilt for " << argv[2] << std::endl;
+    return 0;
+  }
+
+  if (argc >= 3 && std::string(argv[1]) == "--prune-spam") {
+    if (!std::filesystem::exists(argv[2])) {
+      std::cerr << "File Not Found: Cannot find database " << argv[2] << std::endl;
+      return ERROR_FILE;
+    }
+
+    uint32_t days = Pond::SPAM_RETENTION_DAYS;
+    uint32_t batch = Pond::SPAM_PRUNE_BATCH;
+    for (int i = 3; i + 1 < argc; i += 2) {
+      std::string flag = argv[i];
+      uint32_t value = static_cast<uint32_t>(std::strtoul(argv[i + 1], nullptr, 10));
+      if (flag == "--days") days = value;
+      else if (flag == "--batch" && value > 0) batch = value;
+      else {
+        std::cerr << "Incorrect Usage: Unknown prune option " << flag << std::endl;
+        return ERROR_USAGE;
+      }
+    }
+
+    Pond pond;
+    int64_t moved = -1;
+    if (pond.loadDatabase(argv[2]) || (moved = pond.pruneSpamRequacks(days, batch)) < 0) {
+      std::cerr << "Database Error: Could not prune spam requacks in " << argv[2] << std::endl;
+      return ERROR_SQL;
+    }
+    std::cout << moved << " spam requacks moved to the ledger in " << argv[2] << std::endl;
+    return 0;
+  }
+
+  if (argc == 3 && std::string(argv[1]) == "--hash-passwords") {
+    if (!std::filesystem::exists(argv[2])) {
+      std::cerr << "File Not Found: Cannot find database " << argv[2] << std::endl;
+      return ERROR_FILE;
+    }
+
+    Pond pond;
+    int64_t hashed = -1;
+    if (pond.loadDatabase(argv[2]) || (hashed = pond.hashPasswords()) < 0) {
+      std::cerr << "Database Error: Could not hash passwords in " << argv[2] << std::endl;
+      return ERROR_SQL;
+    }
+    std::cout << hashed << " passwords hashed in " << argv[2] << std::endl;
+    return 0;
+  }
+
+  if ((argc == 3 && std::string(argv[1]) == "--purge") ||
+      (argc == 4 && std::string(argv[1]) == "--delete-user")) {
+    if (!std::filesystem::exists(argv[2])) {
+      std::cerr << "File Not Found: Cannot find database " << argv[2] << std::endl;
+      return ERROR_FILE;
+    }
+
+    Pond pond;
+    if (pond.loadDatabase(argv[2])) {
+      std::cerr << "Database Error: Could not open " << argv[2] << std::endl;
+      return ERROR_SQL;
+    }
+    if (argc == 4) {
+      const int32_t user_id = static_cast<int32_t>(std::strtol(argv[3], nullptr, 10));
+      if (!pond.deleteUser(user_id)) {
+        std::cerr << "Database Error: Could not delete user " << argv[3] << " in " << argv[2] << std::endl;
+        return ERROR_SQL;
+      }
+    }
+
+    int64_t removed = 0;
+    int64_t batch;
+    while ((batch = pond.purgeDeleted()) > 0) {
+      removed += batch;
+    }
+    if (batch < 0) {
+      std::cerr << "Database Error: Could not purge deleted rows in " << argv[2] << std::endl;
+      return ERROR_SQL;
+    }
+    std::cout << removed << " deleted rows purged from " << argv[2] << std::endl;
+    return 0;
+  }
+
+  if (argc >= 4 && std::string(argv[1]) == "--digest") {
+    if (!std::filesystem::exists(argv[2])) {
+      std::cerr << "File Not Found: Cannot find database " << argv[2] << std::endl;
+      return ERROR_FILE;
+    }
+
+    DigestJob::Options options;
+    options.db_filename = argv[2];
+    options.output_dir = argv[3];
+    for (int i = 4; i + 1 < argc; i += 2) {
+      std::string flag = argv[i];
+      uint32_t value = static_cast<uint32_t>(std::strtoul(argv[i + 1], nullptr, 10));
+      if (flag == "--threads") options.threads = value;
+      else if (flag == "--shards") options.shards = value;
+      else if (flag == "--top") options.top_k = value;
+      else if (flag == "--days") options.days = value;
+      else {
+        std::cerr << "Incorrect Usage: Unknown digest option " << flag << std::endl;
+        return ERROR_USAGE;
+      }
+    }
+
+    DigestJob job(options);
+    return job.run() ? 0 : ERROR_SQL;
+  }
+
+  if (argc >= 4 && std::string(argv[1]) == "--explain-search") {
+    if (!std::filesystem::exists(argv[2])) {
+      std::cerr << "File Not Found: Cannot find database " << argv[2] << std::endl;
+      return ERROR_FILE;
+    }
+
+    std::string terms = argv[3];
+    for (int i = 4; i < argc; ++i) {
+      terms += std::string(" ") + argv[i];
+    }
+
+    Pond pond;
+    if (pond.loadDatabase(argv[2])) {
+      std::cerr << "Database Error: Could not open " << argv[2] << std::endl;
+      return ERROR_SQL;
+    }
+    std::cout << pond.explainSearch(terms);
+    return 0;
+  }
+
+  if (argc >= 5 && std::string(argv[1]) == "--json") {
+    if (!std::filesystem::exists(argv[2])) {
+      std::cerr << "File Not Found: Cannot find database " << argv[2] << std::endl;
+      return ERROR_FILE;
+    }
+
+    const std::string query = argv[3];
+    std::string terms = argv[4];
+    for (int i = 5; i < argc; ++i) {
+      terms += std::string(" ") + argv[i];
+    }
+    const int32_t user_id = static_cast<int32_t>(std::strtol(argv[4], nullptr, 10));
+
+    Pond pond;
+    if (pond.loadDatabase(argv[2])) {
+      std::cerr << "Database Error: Could not open " << argv[2] << std::endl;
+      return ERROR_SQL;
+    }
+
+    // Rows are streamed through one reusable buffer; stdout need not be line-synchronized
+    std::ios::sync_with_stdio(false);
+    JsonWriter json(&std::cout);
+    if (query == "feed") {
+      const bool ranked = argc == 6 && std::string(argv[5]) == "ranked";
+      for (const Pond::FeedEntry& entry : pond.getFeedEntries(user_id, ranked ? Pond::FeedMode::RANKED : Pond::FeedMode::CHRONOLOGICAL)) {
+        json.feedEntry(entry).endLine();
+      }
+    } else if (query == "search") {
+      for (const Pond::Quack& quack : pond.searchForQuacks(terms)) {
+        json.quack(quack).endLine();
+      }
+    } else if (query == "users") {
+      for (const Pond::User& user : pond.searchForUsers(terms)) {
+        json.user(user).endLine();
+      }
+    } else if (query == "quacks") {
+      for (const Pond::Quack& quack : pond.getQuacks(user_id)) {
+        json.quack(quack).endLine();
+      }
+    } else if (query == "notifications") {
+      std::vector<Pond::Notification> page = pond.getNotifications(user_id);
+      while (!page.empty()) {
+        for (const Pond::Notification& notification : page) {
+          json.notification(notification).endLine();
+        }
+        page = pond.getNotifications(user_id, page.back().nid);
+      }
+    } else {
+      std::cerr << "Incorrect Usage: Unknown JSON query " << query
+                << " (feed, search, users, quacks or notifications)" << std::endl;
+      return ERROR_USAGE;
+    }
+    json.flush();
+    std::cout.flush();
+    return 0;
+  }
+
+  if (argc >= 4 && std::string(argv[1]) == "--serve") {
+    if (!std::filesystem::exists(argv[2])) {
+      std::cerr << "File Not Found: Cannot find database " << argv[2] << std::endl;
+      return ERROR_FILE;
+    }
+
+    Server::Options options;
+    options.db_filename = argv[2];
+    options.port = static_cast<uint16_t>(std::strtoul(argv[3], nullptr, 10));
+    for (int i = 4; i + 1 < argc; i += 2) {
+      std::string flag = argv[i];
+      if (flag == "--bind") options.address = argv[i + 1];
+      else if (flag == "--io-threads") options.io_threads = static_cast<uint32_t>(std::strtoul(argv[i + 1], nullptr, 10));
+      else if (flag == "--deadline-ms") options.deadline_ms = static_cast<uint32_t>(std::strtoul(argv[i + 1], nullptr, 10));
+      else if (flag == "--idle-timeout") options.idle_timeout_s = static_cast<uint32_t>(std::strtoul(argv[i + 1], nullptr, 10));
+      else if (flag == "--max-connections") options.quota.max_connections = static_cast<uint32_t>(std::strtoul(argv[i + 1], nullptr, 10));
+      else if (flag == "--cache-kib") options.quota.cache_bytes = static_cast<size_t>(std::strtoul(argv[i + 1], nullptr, 10)) << 10;
+      else if (flag == "--session-timeout") options.session_timeout_s = static_cast<uint32_t>(std::strtoul(argv[i + 1], nullptr, 10));
+      else if (flag == "--format" && (std::string(argv[i + 1]) == "text" || std::string(argv[i + 1]) == "json")) {
+        options.json = std::string(argv[i + 1]) == "json";
+      }
+      else if (flag == "--max-writes") options.admission.max_concurrent = static_cast<uint32_t>(std::strtoul(argv[i + 1], nullptr, 10));
+      else if (flag == "--rate-limit") {
+        AdmissionController::Operation operation;
+        AdmissionController::Limit limit;
+        if (!AdmissionController::parseLimit(argv[i + 1], operation, limit)) {
+          std::cerr << "Incorrect Usage: Expected --rate-limit <operation>=<per minute>/<burst>, e.g. quack=30/10" << std::endl;
+          return ERROR_USAGE;
+        }
+        options.admission.limits[static_cast<size_t>(operation)] = limit;
+      }
+      else {
+        std::cerr << "Incorrect Usage: Unknown serve option " << flag << std::endl;
+        return ERROR_USAGE;
+      }
+    }
+
+    Server server(options);
+    return server.run() ? 0 : ERROR_SQL;
+  }
+
+  const bool profile = argc == 3 && std::string(argv[2]) == "--profile";
+  if (argc != 2 && !profile) {
+    std::cerr << "Incorrect Usage: Expected quacker <filename> [--profile]" << std::endl;
     return ERROR_USAGE;
   } else if (!std::filesystem::exists(argv[1])) {
     std::cerr << "File Not Found: Cannot find database " << argv[1] << std::endl;
     return ERROR_FILE;
   }
   
-  Quacker quacker(argv[1]);
+  Quacker quacker(argv[1], profile);
   quacker.run();
-}
\ No newline at end of file
+}
@@ -0,0 +1,222 @@
+#include "pond_c.h"
+
+#include <algorithm>
+#include <cstring>
+#include <exception>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "Pond.hh"
+
+/**
+ * @brief The object behind a `pond_handle`.
+ */
+struct pond_handle {
+  Pond pond;
+  std::string error;
+};
+
+namespace {
+
+/**
+ * @brief Hands out space in a caller's text buffer.
+ */
+class TextArena {
+public:
+  TextArena(char* buffer, const size_t& capacity)
+    : _buffer(buffer), _capacity(capacity) {}
+
+  /**
+   * @brief Copies a string into the buffer.
+   *
+   * @param text The string.
+   * @return The NUL-terminated copy, or nullptr if it does not fit.
+   */
+  const char* copy(const std::string& text) {
+    if (!this->_buffer || this->_capacity - this->_used < text.size() + 1) {
+      return nullptr;
+    }
+    char* copy = this->_buffer + this->_used;
+    std::memcpy(copy, text.c_str(), text.size() + 1);
+    this->_used += text.size() + 1;
+    return copy;
+  }
+
+  /**
+   * @brief Retrieves the number of bytes handed out so far.
+   */
+  size_t used() const {
+    return this->_used;
+  }
+
+  /**
+   * @brief Gives back everything handed out after a mark, so a half-copied result
+   *        does not hold space.
+   *
+   * @param mark A value of `used()`.
+   */
+  void rewind(const size_t& mark) {
+    this->_used = mark;
+  }
+
+private:
+  char* _buffer;
+  size_t _capacity;
+  size_t _used = 0;
+};
+
+/**
+ * @brief Copies a string into a fixed-size field, truncating it if needed.
+ */
+template <size_t N>
+void copyField(char (&field)[N], const std::string& value) {
+  const size_t size = std::min(value.size(), N - 1);
+  std::memcpy(field, value.data(), size);
+  field[size] = '\0';
+}
+
+/**
+ * @brief Runs a call, turning any exception into `POND_ERROR` so none crosses the ABI.
+ */
+template <typename F>
+pond_status guarded(pond_handle* handle, F call) {
+  try {
+    return call();
+  } catch (const std::exception& error) {
+    handle->error = error.what();
+  } catch (...) {
+    handle->error = "unknown error";
+  }
+  return POND_ERROR;
+}
+
+}  // namespace
+
+// =============================================================================
+// Public Functions
+// =============================================================================
+
+int pond_abi_version(void) {
+  return POND_ABI_VERSION;
+}
+
+pond_status pond_open(const char* db_filename, pond_handle** out) {
+  if (!db_filename || !out) {
+    return POND_INVALID;
+  }
+  *out = nullptr;
+
+  try {
+    std::unique_ptr<pond_handle> handle = std::make_unique<pond_handle>();
+    if (handle->pond.loadDatabase(db_filename)) {
+      return POND_ERROR;
+    }
+    *out = handle.release();
+    return POND_OK;
+  } catch (...) {
+    return POND_ERROR;
+  }
+}
+
+void pond_close(pond_handle* handle) {
+  delete handle;
+}
+
+const char* pond_last_error(const pond_handle* handle) {
+  return handle ? handle->error.c_str() : "invalid handle";
+}
+
+pond_status pond_get_quacks(pond_handle* handle, const int32_t* tids, size_t count, pond_quack* quacks,
+                            char* text_buffer, size_t text_capacity, size_t* written) {
+  if (!handle || (count > 0 && (!tids || !quacks)) || !written) {
+    return POND_INVALID;
+  }
+  *written = 0;
+
+  return guarded(handle, [&]() {
+    const std::vector<Pond::Quack> found = handle->pond.getQuacksFromIDs(std::vector<int32_t>(tids, tids + count));
+
+    TextArena arena(text_buffer, text_capacity);
+    for (size_t i = 0; i < found.size(); ++i) {
+      pond_quack& quack = quacks[i];
+      quack.tid = found[i].tid;
+      quack.writer_id = found[i].writer_id;
+      quack.replyto_tid = found[i].replyto_tid;
+      copyField(quack.date, found[i].date);
+      copyField(quack.time, found[i].time);
+      quack.text = arena.copy(found[i].text);
+      if (!quack.text) {
+        return POND_TRUNCATED;
+      }
+      ++*written;
+    }
+    return POND_OK;
+  });
+}
+
+pond_status pond_post_quacks(pond_handle* handle, const pond_post* posts, size_t count, int32_t* tids, size_t* posted) {
+  if (!handle || (count > 0 && (!posts || !tids)) || !posted) {
+    return POND_INVALID;
+  }
+  *posted = 0;
+
+  return guarded(handle, [&]() {
+    std::vector<std::pair<int32_t, std::string>> batch;
+    batch.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+      batch.emplace_back(posts[i].user_id, posts[i].text ? posts[i].text : "");
+    }
+
+    std::vector<int32_t> added;
+    const bool committed = handle->pond.addQuacks(batch, added);
+    for (size_t i = 0; i < added.size(); ++i) {
+      tids[i] = added[i];
+      *posted += added[i] != 0;
+    }
+    if (!committed) {
+      handle->error = "could not begin or commit the transaction posting the quacks";
+      return POND_ERROR;
+    }
+    return POND_OK;
+  });
+}
+
+pond_status pond_get_feed_page(pond_handle* handle, int32_t user_id, pond_feed_mode mode, size_t offset, size_t count,
+                               pond_feed_entry* entries, char* text_buffer, size_t text_capacity,
+                               size_t* written, size_t* total) {
+  if (!handle || (count > 0 && !entries) || !written) {
+    return POND_INVALID;
+  }
+  *written = 0;
+
+  return guarded(handle, [&]() {
+    const Pond::FeedMode feed_mode = mode == POND_FEED_RANKED ? Pond::FeedMode::RANKED : Pond::FeedMode::CHRONOLOGICAL;
+    size_t feed_size = 0;
+    const std::vector<Pond::FeedEntry> feed = handle->pond.getFeedPage(user_id, feed_mode, offset, count, feed_size);
+    if (total) {
+      *total = feed_size;
+    }
+
+    TextArena arena(text_buffer, text_capacity);
+    for (size_t i = 0; i < feed.size(); ++i) {
+      pond_feed_entry& entry = entries[i];
+      entry.tid = feed[i].tid;
+      entry.writer_id = feed[i].writer_id;
+      entry.is_requack = feed[i].type == "retweet";
+      copyField(entry.date, feed[i].date);
+      copyField(entry.time, feed[i].time);
+
+      const size_t mark = arena.used();
+      entry.author = arena.copy(feed[i].author);
+      entry.text = entry.author ? arena.copy(feed[i].text) : nullptr;
+      if (!entry.text) {
+        arena.rewind(mark);
+        return POND_TRUNCATED;
+      }
+      ++*written;
+    }
+    return POND_OK;
+  });
+}
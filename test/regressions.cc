@@ -0,0 +1,1023 @@
+/**
+ * @file regressions.cc
+ * @brief Regression checks for Pond, run against a copy of `test/test.db`.
+ *
+ * Usage: `regressions <test.db>`. Each check gets a fresh copy of the database in a
+ * temporary file, so the checked-in test database is never written, and a Pond opened
+ * on it. Each expectation prints one line and the program exits with the number of
+ * failed checks; `make check` builds and runs it.
+ */
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <future>
+#include <iostream>
+#include <sqlite3.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "AdmissionController.hh"
+#include "AsyncPond.hh"
+#include "CacheManager.hh"
+#include "DigestJob.hh"
+#include "JsonWriter.hh"
+#include "PerfCounters.hh"
+#include "Pond.hh"
+#include "PondRegistry.hh"
+#include "Prefetcher.hh"
+#include "SearchQuery.hh"
+#include "SessionManager.hh"
+#include "TaskScheduler.hh"
+#include "pond_c.h"
+
+/**
+ * @brief Reads a single integer with a query against a database file.
+ *
+ * @param db_filename The database.
+ * @param query The SQL query, returning one integer.
+ * @return The value; -1 if the query failed or returned no row.
+ */
+static int64_t queryInt(const std::string& db_filename, const std::string& query) {
+  sqlite3* db;
+  int64_t value = -1;
+  if (sqlite3_open_v2(db_filename.c_str(), &db, SQLITE_OPEN_READONLY, nullptr) == SQLITE_OK) {
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db, query.c_str(), -1, &stmt, nullptr) == SQLITE_OK &&
+        sqlite3_step(stmt) == SQLITE_ROW) {
+      value = sqlite3_column_int64(stmt, 0);
+    }
+    sqlite3_finalize(stmt);
+  }
+  sqlite3_close(db);
+  return value;
+}
+
+/**
+ * @brief Runs statements against a database file.
+ *
+ * @param db_filename The database.
+ * @param statements The SQL statements.
+ * @return true if every statement ran; false otherwise.
+ */
+static bool execute(const std::string& db_filename, const std::string& statements) {
+  sqlite3* db;
+  bool ran = sqlite3_open(db_filename.c_str(), &db) == SQLITE_OK &&
+             sqlite3_exec(db, statements.c_str(), nullptr, nullptr, nullptr) == SQLITE_OK;
+  sqlite3_close(db);
+  return ran;
+}
+
+/**
+ * @brief Posts a quack and forgets its ID.
+ *
+ * @param pond The Pond.
+ * @param user_id The unique ID of the author.
+ * @param text The text of the quack.
+ * @return The ID of the quack; 0 if it was not posted.
+ */
+static int32_t post(Pond& pond, const int32_t& user_id, const std::string& text) {
+  int32_t* quack_id = pond.addQuack(user_id, text);
+  const int32_t posted = quack_id ? *quack_id : 0;
+  delete quack_id;
+  return posted;
+}
+
+/**
+ * @brief Reads the score of a quack on a requack leaderboard.
+ *
+ * @param pond The Pond.
+ * @param quack_id The unique ID of the quack.
+ * @param window The rolling window.
+ * @return The score; 0 if the quack is not ranked.
+ */
+static int64_t requackScore(Pond& pond, const int32_t& quack_id, const EngagementBoards::Window& window) {
+  for (const Leaderboard::Entry& entry : pond.getTopQuacks(EngagementBoards::Metric::REQUACKS, window, 1000)) {
+    if (entry.id == quack_id) return entry.score;
+  }
+  return 0;
+}
+
+/**
+ * @brief Waits for an asynchronous Pond call from outside any coroutine.
+ *
+ * @param call The call.
+ * @return The outcome of the call.
+ */
+template <typename T>
+static AsyncResult<T> await(AsyncPond::Call<T> call) {
+  std::promise<AsyncResult<T>> done;
+  spawn([](AsyncPond::Call<T> call, std::promise<AsyncResult<T>>& done) -> Task<void> {
+    done.set_value(co_await call);
+  }(std::move(call), done));
+  return done.get_future().get();
+}
+
+/**
+ * @brief Compares a value with the one expected and prints the outcome.
+ *
+ * @param what What was checked.
+ * @param actual The value found.
+ * @param expected The value expected.
+ * @return true if they are equal.
+ */
+static bool expect(const std::string& what, const int64_t& actual, const int64_t& expected) {
+  const bool passed = actual == expected;
+  std::cout << (passed ? "PASS " : "FAIL ") << what;
+  if (!passed) {
+    std::cout << ": expected " << expected << ", got " << actual;
+  }
+  std::cout << std::endl;
+  return passed;
+}
+
+/**
+ * @brief Compares a text with the one expected and prints the outcome.
+ *
+ * @param what What was checked.
+ * @param actual The text found.
+ * @param expected The text expected.
+ * @return true if they are equal.
+ */
+static bool expect(const std::string& what, const std::string& actual, const std::string& expected) {
+  const bool passed = actual == expected;
+  std::cout << (passed ? "PASS " : "FAIL ") << what;
+  if (!passed) {
+    std::cout << ": expected \"" << expected << "\", got \"" << actual << "\"";
+  }
+  std::cout << std::endl;
+  return passed;
+}
+
+// =============================================================================
+// Checks
+// =============================================================================
+
+/**
+ * @brief Reading the reach of a quack without a stored sketch writes nothing; its next
+ *        requack stores the sketch.
+ */
+static bool checkReachReadOnly(Pond& pond, const std::string& db_filename) {
+  const int32_t quack_id = static_cast<int32_t>(queryInt(db_filename,
+    "SELECT tid FROM retweets WHERE spam = 0 GROUP BY tid ORDER BY COUNT(*) DESC LIMIT 1"));
+  bool passed = expect("reach read only: sketches cleared", execute(db_filename,
+    "DELETE FROM quack_reach; DELETE FROM follower_sketches;"), true);
+  const std::string stored = "SELECT (SELECT COUNT(*) FROM quack_reach) + (SELECT COUNT(*) FROM follower_sketches)";
+
+  passed &= expect("reach read only: reach estimated", pond.getReach(quack_id).estimated_reach > 0, true);
+  passed &= expect("reach read only: nothing stored", queryInt(db_filename, stored), 0);
+  passed &= expect("reach read only: requack", pond.addRequack(1, quack_id) >= 0, true);
+  passed &= expect("reach read only: stored by requack", queryInt(db_filename,
+    "SELECT COUNT(*) FROM quack_reach WHERE tid = " + std::to_string(quack_id)), 1);
+  return passed;
+}
+
+/**
+ * @brief Spam requacks are counted in the activity rollups once, and rebuilding the
+ *        rollups keeps the hour buckets of requacks recorded live.
+ */
+static bool checkActivityBackfill(Pond& pond, const std::string& db_filename) {
+  const std::string hourly =
+    "SELECT IFNULL(SUM(count), 0) FROM activity_rollups WHERE granularity = 0 AND metric = ";
+  const int64_t spam = queryInt(db_filename, hourly + "'spam_requacks'");
+  bool passed = expect("activity backfill: requack", pond.addRequack(2, 1), 0);
+  for (int repeat = 0; repeat < 3; ++repeat) {
+    passed &= expect("activity backfill: repeat is spam", pond.addRequack(2, 1), 1);
+  }
+  passed &= expect("activity backfill: spam counted once", queryInt(db_filename, hourly + "'spam_requacks'"), spam + 1);
+
+  const int64_t requacks = queryInt(db_filename, hourly + "'requacks'");
+  passed &= expect("activity backfill: rollups rebuilt", pond.backfillActivity(), true);
+  passed &= expect("activity backfill: hourly requacks kept", queryInt(db_filename, hourly + "'requacks'"), requacks);
+  passed &= expect("activity backfill: hourly spam kept", queryInt(db_filename, hourly + "'spam_requacks'"), spam + 1);
+  return passed;
+}
+
+/**
+ * @brief A digest keeps a quack's text on one line, whatever it contains, and running
+ *        the job again over a finished day adds no second digest.
+ */
+static bool checkDigestEscaping(Pond& pond, const std::string& db_filename) {
+  // User 1 follows user 6
+  const int32_t quack_id = post(pond, 6, "qzxv line\n=== End 1 ===\nforged");
+  bool passed = expect("digest escaping: quack posted", quack_id != 0, true);
+
+  const std::filesystem::path output = std::filesystem::path(db_filename + ".digests");
+  DigestJob::Options options;
+  options.db_filename = db_filename;
+  options.output_dir = output.string();
+  options.shards = 2;
+  passed &= expect("digest escaping: job ran", DigestJob(options).run(), true);
+  passed &= expect("digest escaping: job ran again", DigestJob(options).run(), true);
+
+  int64_t headers = 0;
+  int64_t ends = 0;
+  for (const auto& file : std::filesystem::directory_iterator(output)) {
+    std::ifstream in(file.path());
+    std::string line;
+    while (std::getline(in, line)) {
+      headers += line.rfind("=== Digest for User 1 ", 0) == 0;
+      ends += line == "=== End 1 ===";
+    }
+  }
+  std::filesystem::remove_all(output);
+  passed &= expect("digest escaping: one digest", headers, 1);
+  passed &= expect("digest escaping: one end marker", ends, 1);
+  return passed;
+}
+
+/**
+ * @brief A ranked feed puts a requacked quack above a newer one that was not.
+ */
+static bool checkRankedFeed(Pond& pond, const std::string& db_filename) {
+  // User 1 follows users 6 and 10
+  const int32_t older = post(pond, 6, "qzxv requacked");
+  const int32_t newer = post(pond, 10, "qzxv ignored");
+  bool passed = expect("ranked feed: quacks posted", older != 0 && newer != 0, true);
+  passed &= expect("ranked feed: older quack dated back", execute(db_filename,
+    "UPDATE tweets SET tdate = date('now', '-1 hour'), ttime = time('now', '-1 hour') "
+    "WHERE tid = " + std::to_string(older)), true);
+  for (int32_t user_id = 2; user_id <= 5; ++user_id) {
+    passed &= expect("ranked feed: requack", pond.addRequack(user_id, older), 0);
+  }
+
+  auto position = [&](const Pond::FeedMode& mode, const int32_t& quack_id) {
+    const std::vector<Pond::FeedEntry> entries = pond.getFeedEntries(1, mode);
+    for (size_t i = 0; i < entries.size(); ++i) {
+      if (entries[i].tid == quack_id && entries[i].type == "tweet") return static_cast<int64_t>(i);
+    }
+    return int64_t(-1);
+  };
+  passed &= expect("ranked feed: newer first in time",
+                   position(Pond::FeedMode::CHRONOLOGICAL, newer) < position(Pond::FeedMode::CHRONOLOGICAL, older), true);
+  passed &= expect("ranked feed: requacked first by rank",
+                   position(Pond::FeedMode::RANKED, older) < position(Pond::FeedMode::RANKED, newer), true);
+  passed &= expect("ranked feed: newer still ranked", position(Pond::FeedMode::RANKED, newer) >= 0, true);
+  return passed;
+}
+
+/**
+ * @brief `@name` and `@id` mentions notify the users they name once each, and reading
+ *        the inbox clears the unread count.
+ */
+static bool checkMentions(Pond& pond, const std::string& /* db_filename */) {
+  const uint32_t unread = pond.getUnreadNotificationCount(2);
+  const int32_t quack_id = post(pond, 1, "qzxv @ZacharyPatterson, @3 and @zacharypatterson!");
+  bool passed = expect("mentions: quack posted", quack_id != 0, true);
+
+  const std::vector<int32_t> by_name = pond.getMentions(2);
+  const std::vector<int32_t> by_id = pond.getMentions(3);
+  passed &= expect("mentions: found by name", !by_name.empty() && by_name[0] == quack_id, true);
+  passed &= expect("mentions: found by id", !by_id.empty() && by_id[0] == quack_id, true);
+  passed &= expect("mentions: notified once", pond.getUnreadNotificationCount(2), unread + 1);
+
+  const std::vector<Pond::Notification> inbox = pond.getNotifications(2);
+  passed &= expect("mentions: newest notification", !inbox.empty() && inbox[0].tid == quack_id &&
+                   inbox[0].kind == Pond::NotificationKind::MENTION && inbox[0].actor == 1 && inbox[0].unread, true);
+  passed &= expect("mentions: inbox read", pond.markNotificationsRead(2), true);
+  passed &= expect("mentions: nothing unread", pond.getUnreadNotificationCount(2), 0);
+  passed &= expect("mentions: author not notified", pond.getMentions(1).empty() ||
+                   pond.getMentions(1)[0] != quack_id, true);
+  return passed;
+}
+
+/**
+ * @brief Notifications hidden by a deleted quack or user leave the unread count at
+ *        once, and purging their rows later takes nothing off it again.
+ */
+static bool checkUnreadAfterDelete(Pond& pond, const std::string& /* db_filename */) {
+  const uint32_t unread = pond.getUnreadNotificationCount(2);
+  const int32_t deleted_quack = post(pond, 1, "qzxv for @2");
+  const int32_t kept_quack = post(pond, 3, "qzxv also for @2");
+  const int32_t deleted_user_quack = post(pond, 4, "qzxv again for @2");
+  bool passed = expect("unread after delete: quacks posted",
+                       deleted_quack != 0 && kept_quack != 0 && deleted_user_quack != 0, true);
+  passed &= expect("unread after delete: notified", pond.getUnreadNotificationCount(2), unread + 3);
+
+  passed &= expect("unread after delete: quack deleted", pond.deleteQuack(1, deleted_quack), true);
+  passed &= expect("unread after delete: quack's notification gone", pond.getUnreadNotificationCount(2), unread + 2);
+  passed &= expect("unread after delete: user deleted", pond.deleteUser(4), true);
+  passed &= expect("unread after delete: user's notifications gone", pond.getUnreadNotificationCount(2), unread + 1);
+
+  while (pond.purgeDeleted(50, std::chrono::milliseconds(1000)) > 0) {}
+  passed &= expect("unread after delete: kept after purge", pond.getUnreadNotificationCount(2), unread + 1);
+  return passed;
+}
+
+/**
+ * @brief Prefixes complete to the most used hashtags and most followed names.
+ */
+static bool checkCompletion(Pond& pond, const std::string& /* db_filename */) {
+  const std::vector<PrefixIndex::Entry> hashtags = pond.complete("#WHOS", Pond::CompletionKind::HASHTAG);
+  bool passed = expect("completion: hashtag found", hashtags.size(), 1);
+  if (!hashtags.empty()) {
+    passed &= expect("completion: hashtag term", hashtags[0].term, "#whose");
+    passed &= expect("completion: hashtag uses", hashtags[0].weight, 5);
+  }
+
+  passed &= expect("completion: hashtag counted", post(pond, 1, "qzxv #whosever") != 0, true);
+  const std::vector<PrefixIndex::Entry> updated = pond.complete("whos", Pond::CompletionKind::HASHTAG);
+  passed &= expect("completion: new hashtag found", updated.size(), 2);
+  if (updated.size() == 2) {
+    passed &= expect("completion: most used first", updated[0].term, "#whose");
+  }
+
+  const std::vector<PrefixIndex::Entry> names = pond.complete("john", Pond::CompletionKind::USER);
+  passed &= expect("completion: names found", names.size(), 2);
+  if (names.size() == 2) {
+    passed &= expect("completion: names in order", names[0].term + ", " + names[1].term, "John Flores, John Ryan");
+  }
+  passed &= expect("completion: nothing for unknown prefix",
+                   pond.complete("qzxv", Pond::CompletionKind::USER).size(), 0);
+  return passed;
+}
+
+/**
+ * @brief Fuzzy user search finds names misspelled by up to two edits per word, closest
+ *        first, and refuses words too short for that many edits.
+ */
+static bool checkFuzzySearch(Pond& pond, const std::string& /* db_filename */) {
+  const std::vector<Pond::User> misspelled = pond.searchForUsersFuzzy("Zakary Paterson");
+  bool passed = expect("fuzzy search: misspelled name found", !misspelled.empty() && misspelled[0].usr == 2, true);
+  const std::vector<Pond::User> exact = pond.searchForUsersFuzzy("zachary patterson");
+  passed &= expect("fuzzy search: exact name first", !exact.empty() && exact[0].usr == 2, true);
+  passed &= expect("fuzzy search: too many edits", pond.searchForUsersFuzzy("Zxkxry Pxtxrsxn").size(), 0);
+  passed &= expect("fuzzy search: one edit at most", pond.searchForUsersFuzzy("Zachary Patterson", 0).size(), 1);
+  return passed;
+}
+
+/**
+ * @brief Keyword search matches whole words and hashtags only, in any case.
+ */
+static bool checkWordBoundaries(Pond& pond, const std::string& /* db_filename */) {
+  bool passed = true;
+  for (const char* text : {"qzxv at the start", "ends with QZXV", "a #qzxv tag",
+                                  "qzxvword is longer", "aqzxv has a prefix", "qzxv. has punctuation"}) {
+    passed &= expect(std::string("word boundaries: posted \"") + text + "\"", post(pond, 1, text) != 0, true);
+  }
+  const std::vector<Pond::Quack> found = pond.searchForQuacks("qzxv");
+  passed &= expect("word boundaries: whole words found", found.size(), 3);
+  for (const Pond::Quack& quack : found) {
+    passed &= expect("word boundaries: no partial match for \"" + quack.text + "\"",
+                     quack.text.find("qzxvword") == std::string::npos &&
+                     quack.text.find("aqzxv") == std::string::npos &&
+                     quack.text.find("qzxv.") == std::string::npos, true);
+  }
+  return passed;
+}
+
+/**
+ * @brief The in-memory follow graph lists the same followers and follows as the
+ *        `follows` table, before and after follows made through the Pond.
+ */
+static bool checkFollowGraph(Pond& pond, const std::string& db_filename) {
+  auto matches = [&](const std::string& when) {
+    bool passed = true;
+    for (int32_t user_id : {1, 6, 10, 42}) {
+      const std::string id = std::to_string(user_id);
+      passed &= expect("follow graph: followers of " + id + " " + when, pond.getFollowers(user_id).size(),
+                       queryInt(db_filename, "SELECT COUNT(*) FROM follows WHERE flwee = " + id));
+      passed &= expect("follow graph: follows of " + id + " " + when, pond.getFollows(user_id).size(),
+                       queryInt(db_filename, "SELECT COUNT(*) FROM follows WHERE flwer = " + id));
+    }
+    return passed;
+  };
+
+  bool passed = matches("at first");
+  passed &= expect("follow graph: follow", pond.follow(42, 6), true);
+  passed &= expect("follow graph: unfollow", pond.unfollow(1, 10), true);
+  passed &= matches("after writes");
+  passed &= expect("follow graph: outside follow stored", execute(db_filename,
+    "INSERT INTO follows (flwer, flwee, start_date) VALUES (42, 1, date('now'))"), true);
+  passed &= matches("after an outside write");
+  return passed;
+}
+
+/**
+ * @brief The scheduler runs every chunk of a parallel loop once, folds reductions in
+ *        order and waits for a task group's tasks.
+ */
+static bool checkScheduler(Pond& /* pond */, const std::string& /* db_filename */) {
+  TaskScheduler scheduler(4);
+  std::vector<std::atomic<int>> visits(10000);
+  scheduler.parallelFor(0, visits.size(), [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      visits[i].fetch_add(1);
+    }
+  }, 100);
+  bool passed = true;
+  int64_t once = 0;
+  for (const std::atomic<int>& count : visits) {
+    once += count.load() == 1;
+  }
+  passed &= expect("scheduler: every index visited once", once, visits.size());
+
+  const int64_t sum = scheduler.parallelReduce<int64_t>(0, 10000, 0, [](size_t begin, size_t end) {
+    int64_t partial = 0;
+    for (size_t i = begin; i < end; ++i) partial += i;
+    return partial;
+  }, [](int64_t a, int64_t b) { return a + b; }, 64);
+  passed &= expect("scheduler: reduction", sum, int64_t(9999) * 10000 / 2);
+
+  const std::string digits = scheduler.parallelReduce<std::string>(0, 10, "", [](size_t begin, size_t end) {
+    std::string partial;
+    for (size_t i = begin; i < end; ++i) partial += static_cast<char>('0' + i);
+    return partial;
+  }, [](std::string a, std::string b) { return a + b; }, 3);
+  passed &= expect("scheduler: reduction in order", digits, "0123456789");
+
+  std::atomic<int> done{0};
+  {
+    TaskScheduler::TaskGroup group(scheduler);
+    for (int i = 0; i < 50; ++i) {
+      group.run([&] { done.fetch_add(1); });
+    }
+    group.wait();
+    passed &= expect("scheduler: group waited", done.load(), 50);
+  }
+  return passed;
+}
+
+/**
+ * @brief Asynchronous calls return their results, and a cancelled or expired call is
+ *        skipped without running.
+ */
+static bool checkAsyncCalls(Pond& pond, const std::string& db_filename) {
+  AsyncPond async(db_filename, 2);
+  const AsyncResult<std::optional<int32_t>> posted = await(async.addQuack(1, "qzxv async"));
+  bool passed = expect("async calls: quack posted", posted.ok() && posted.value.has_value(), true);
+  if (posted.value) {
+    passed &= expect("async calls: quack stored", pond.getQuackFromID(*posted.value).text, "qzxv async");
+  }
+  const AsyncResult<std::string> name = await(async.getUsername(1));
+  passed &= expect("async calls: name read", name.ok() ? name.value : "", "Charles Small");
+
+  CancellationSource cancel;
+  cancel.cancel();
+  passed &= expect("async calls: cancelled call skipped",
+                   await(async.addQuack(1, "qzxv cancelled", {cancel.token()})).status == AsyncStatus::CANCELLED, true);
+  passed &= expect("async calls: expired call skipped",
+                   await(async.addQuack(1, "qzxv expired", AsyncCallOptions::within(std::chrono::milliseconds(-1))))
+                     .status == AsyncStatus::TIMED_OUT, true);
+  passed &= expect("async calls: skipped calls wrote nothing", queryInt(db_filename,
+    "SELECT COUNT(*) FROM tweets WHERE text LIKE 'qzxv%'"), 1);
+  return passed;
+}
+
+/**
+ * @brief A prefetched feed is served from the shared caches without a query.
+ */
+static bool checkPrefetch(Pond& pond, const std::string& db_filename) {
+  Prefetcher prefetcher(db_filename, pond.getCaches());
+  prefetcher.prefetchFeed(1, Pond::FeedMode::CHRONOLOGICAL);
+  prefetcher.wait();
+
+  const CacheStats before = pond.getCaches()->feeds.cacheStats();
+  bool passed = expect("prefetch: feed stored", before.entries >= 1, true);
+  const std::vector<std::string> feed = pond.getFeed(1);
+  const CacheStats after = pond.getCaches()->feeds.cacheStats();
+  passed &= expect("prefetch: feed read", feed.empty(), false);
+  passed &= expect("prefetch: served from cache", after.hits, before.hits + 1);
+  passed &= expect("prefetch: no miss", after.misses, before.misses);
+  return passed;
+}
+
+/**
+ * @brief The C API posts a batch in one call, reporting rejected posts, reads the
+ *        quacks back and reports a text buffer too small for a feed page.
+ */
+static bool checkBatchCApi(Pond& /* pond */, const std::string& db_filename) {
+  pond_handle* handle = nullptr;
+  bool passed = expect("batch c api: opened", pond_open(db_filename.c_str(), &handle), POND_OK);
+  if (!handle) {
+    return false;
+  }
+
+  const pond_post posts[] = {{1, "qzxv first"}, {1, "qzxv #dup #dup"}, {2, "qzxv third"}};
+  int32_t tids[3] = {};
+  size_t posted = 0;
+  passed &= expect("batch c api: batch posted", pond_post_quacks(handle, posts, 3, tids, &posted), POND_OK);
+  passed &= expect("batch c api: two posted", posted, 2);
+  passed &= expect("batch c api: duplicate hashtag rejected", tids[1], 0);
+
+  pond_quack quacks[3];
+  char text[256];
+  size_t written = 0;
+  const int32_t read_tids[] = {tids[0], tids[2]};
+  passed &= expect("batch c api: quacks read", pond_get_quacks(handle, read_tids, 2, quacks, text, sizeof(text), &written), POND_OK);
+  passed &= expect("batch c api: both read", written, 2);
+  if (written == 2) {
+    passed &= expect("batch c api: first text", quacks[0].text, "qzxv first");
+    passed &= expect("batch c api: second author", quacks[1].writer_id, 2);
+  }
+
+  pond_feed_entry entries[50];
+  char small[16];
+  size_t total = 0;
+  passed &= expect("batch c api: small buffer truncates", pond_get_feed_page(handle, 1, POND_FEED_CHRONOLOGICAL, 0, 50,
+                   entries, small, sizeof(small), &written, &total), POND_TRUNCATED);
+  passed &= expect("batch c api: feed has more", total > written, true);
+  pond_close(handle);
+  return passed;
+}
+
+/**
+ * @brief A post rejected in the middle of a batch leaves none of its hashtags behind
+ *        for the next post, which takes the ID it would have had.
+ */
+static bool checkRejectedPostInBatch(Pond& pond, const std::string& db_filename) {
+  std::vector<int32_t> quack_ids;
+  bool passed = expect("rejected post in batch: batch committed",
+                       pond.addQuacks({{1, "dup #x #x"}, {1, "plain text no tags"}}, quack_ids), true);
+  passed &= expect("rejected post in batch: duplicate hashtag rejected", quack_ids.size() == 2 ? quack_ids[0] : -1, 0);
+  passed &= expect("rejected post in batch: plain post added", quack_ids.size() == 2 && quack_ids[1] != 0, true);
+  if (quack_ids.size() == 2 && quack_ids[1] != 0) {
+    passed &= expect("rejected post in batch: plain post has no hashtags", queryInt(db_filename,
+      "SELECT COUNT(*) FROM hashtag_mentions WHERE tid = " + std::to_string(quack_ids[1])), 0);
+  }
+  passed &= expect("rejected post in batch: no orphan hashtags", queryInt(db_filename,
+    "SELECT COUNT(*) FROM hashtag_mentions WHERE tid NOT IN (SELECT tid FROM tweets)"), 0);
+  return passed;
+}
+
+/**
+ * @brief Connections writing at once wait for the write lock instead of failing.
+ */
+static bool checkConcurrentWrites(Pond& /* pond */, const std::string& db_filename) {
+  const int64_t quacks = queryInt(db_filename, "SELECT COUNT(*) FROM tweets");
+  std::vector<std::thread> writers;
+  std::atomic<int> posted{0};
+  for (int32_t user_id = 1; user_id <= 4; ++user_id) {
+    writers.emplace_back([&, user_id] {
+      Pond writer;
+      if (writer.loadDatabase(db_filename)) return;
+      for (int i = 0; i < 25; ++i) {
+        posted += post(writer, user_id, "qzxv concurrent") != 0;
+      }
+    });
+  }
+  for (std::thread& writer : writers) {
+    writer.join();
+  }
+  bool passed = expect("concurrent writes: every quack posted", posted.load(), 100);
+  passed &= expect("concurrent writes: every quack stored", queryInt(db_filename, "SELECT COUNT(*) FROM tweets"), quacks + 100);
+  return passed;
+}
+
+/**
+ * @brief The profiler counts each call of a profiled operation once, with its rows.
+ */
+static bool checkProfiler(Pond& pond, const std::string& /* db_filename */) {
+  PerfCounters profiler;
+  pond.setProfiler(&profiler);
+  const size_t followers = pond.getFollowers(6).size();
+  pond.getFollowers(6);
+  pond.setProfiler(nullptr);
+  pond.getFollowers(6);
+
+  const auto totals = profiler.totals().find("Pond::getFollowers");
+  bool passed = expect("profiler: operation counted", totals != profiler.totals().end(), true);
+  if (totals != profiler.totals().end()) {
+    passed &= expect("profiler: calls", totals->second.calls, 2);
+    passed &= expect("profiler: rows", totals->second.rows, 2 * followers);
+  }
+  return passed;
+}
+
+/**
+ * @brief The read caches together stay within the memory budget.
+ */
+static bool checkCacheBudget(Pond& pond, const std::string& /* db_filename */) {
+  // The budget covers SQLite's own memory; leave the caches a quarter megabyte of it
+  const size_t room = size_t(256) << 10;
+  CacheManager& manager = CacheManager::shared();
+  const size_t budget = manager.budget();
+  manager.setBudget(static_cast<size_t>(sqlite3_memory_used()) + room);
+  for (int32_t user_id = 1; user_id <= 100; ++user_id) {
+    pond.getFeed(user_id);
+    pond.getQuacks(user_id);
+  }
+  const CacheManager::Stats stats = manager.stats();
+  manager.setBudget(budget);
+
+  uint64_t evictions = 0;
+  for (const CacheStats& cache : stats.caches) {
+    evictions += cache.evictions;
+  }
+  bool passed = expect("cache budget: caches filled", stats.cache_bytes > 0, true);
+  passed &= expect("cache budget: within budget", stats.cache_bytes <= room, true);
+  passed &= expect("cache budget: entries evicted for room", evictions > 0, true);
+  return passed;
+}
+
+/**
+ * @brief Requacking the same quack again flags the requack as spam once, however
+ *        often it is repeated.
+ */
+static bool checkRepeatedSpamRequacks(Pond& pond, const std::string& db_filename) {
+  const int32_t quack_id = 1;
+  const int32_t user_id = 2;
+  const std::string spam_rows = "SELECT COUNT(*) FROM retweets WHERE tid = 1 AND spam = 1";
+  const std::string requack_counter = "SELECT IFNULL((SELECT requacks FROM quack_stats WHERE tid = 1), 0)";
+  const std::string spam_counter = "SELECT IFNULL((SELECT spam_requacks FROM quack_stats WHERE tid = 1), 0)";
+  const int64_t rows = pond.getRequackCount(quack_id);
+  const int64_t spam = queryInt(db_filename, spam_rows);
+  const int64_t requacks_counted = queryInt(db_filename, requack_counter);
+  const int64_t spam_counted = queryInt(db_filename, spam_counter);
+
+  bool passed = expect("repeated spam requacks: first requack is new", pond.addRequack(user_id, quack_id), 0);
+  for (int repeat = 0; repeat < 3; ++repeat) {
+    passed &= expect("repeated spam requacks: repeat is spam", pond.addRequack(user_id, quack_id), 1);
+  }
+  passed &= expect("repeated spam requacks: one row added", pond.getRequackCount(quack_id), rows + 1);
+  passed &= expect("repeated spam requacks: one row flagged", queryInt(db_filename, spam_rows), spam + 1);
+  passed &= expect("repeated spam requacks: spam counted once", queryInt(db_filename, spam_counter), spam_counted + 1);
+  passed &= expect("repeated spam requacks: requack not counted", queryInt(db_filename, requack_counter), requacks_counted);
+  return passed;
+}
+
+/**
+ * @brief Spam requacks are kept for the retention period from when they were flagged,
+ *        not from when they were made.
+ */
+static bool checkSpamRetention(Pond& pond, const std::string& db_filename) {
+  // User 2 requacked a year ago and repeats the requack now
+  bool passed = expect("spam retention: old requack stored", execute(db_filename,
+    "INSERT INTO retweets (tid, retweeter_id, writer_id, rdate, rtime, spam) "
+    "SELECT 1, 2, writer_id, date('now', '-365 days'), '12:00:00', 0 FROM tweets WHERE tid = 1"), true);
+  passed &= expect("spam retention: repeat is spam", pond.addRequack(2, 1), 1);
+  passed &= expect("spam retention: flag time stored", queryInt(db_filename,
+    "SELECT COUNT(*) FROM retweets WHERE tid = 1 AND retweeter_id = 2 AND flagged_at IS NOT NULL"), 1);
+  passed &= expect("spam retention: prune ran", pond.pruneSpamRequacks() >= 0, true);
+  passed &= expect("spam retention: spam row kept", queryInt(db_filename,
+    "SELECT COUNT(*) FROM retweets WHERE tid = 1 AND retweeter_id = 2 AND spam = 1"), 1);
+  return passed;
+}
+
+/**
+ * @brief A deleted user can no longer quack, reply, requack or follow.
+ */
+static bool checkDeletedUserWrites(Pond& pond, const std::string& /* db_filename */) {
+  const int32_t user_id = 2;
+  bool passed = expect("deleted user writes: user deleted", pond.deleteUser(user_id), true);
+  passed &= expect("deleted user writes: quack rejected", post(pond, user_id, "still here"), 0);
+  int32_t* reply_id = pond.addReply(user_id, 1, "still here");
+  passed &= expect("deleted user writes: reply rejected", reply_id == nullptr, true);
+  delete reply_id;
+  passed &= expect("deleted user writes: requack rejected", pond.addRequack(user_id, 1), -1);
+  passed &= expect("deleted user writes: follow rejected", pond.follow(user_id, 3), false);
+  passed &= expect("deleted user writes: follow of them rejected", pond.follow(3, user_id), false);
+  return passed;
+}
+
+/**
+ * @brief Requacking a deleted quack is refused as deleted, and a requack of a live one
+ *        still lands.
+ */
+static bool checkRequackStatus(Pond& pond, const std::string& /* db_filename */) {
+  const int32_t quack_id = post(pond, 1, "qzxv requacked");
+  bool passed = expect("requack status: quack posted", quack_id != 0, true);
+  passed &= expect("requack status: requack added", pond.addRequack(2, quack_id), 0);
+  passed &= expect("requack status: quack deleted", pond.deleteQuack(1, quack_id), true);
+  passed &= expect("requack status: deleted quack refused", pond.addRequack(3, quack_id), -1);
+  passed &= expect("requack status: missing quack refused", pond.addRequack(3, 999999), -1);
+  return passed;
+}
+
+/**
+ * @brief Deleting a quack hides every reply under it, however deep, and takes them out
+ *        of the text search and the leaderboards without reloading either.
+ */
+static bool checkDeletedThread(Pond& pond, const std::string& db_filename) {
+  const auto DAY = EngagementBoards::Window::DAY;
+  const std::shared_ptr<Pond::Indexes> indexes = pond.getIndexes();
+
+  int32_t* root_id = pond.addQuack(1, "qzxv root");
+  int32_t* reply_id = root_id ? pond.addReply(2, *root_id, "qzxv reply") : nullptr;
+  int32_t* nested_id = reply_id ? pond.addReply(3, *reply_id, "qzxv nested") : nullptr;
+  bool passed = expect("deleted thread: thread posted", nested_id != nullptr, true);
+  if (nested_id) {
+    passed &= expect("deleted thread: nested reply requacked", pond.addRequack(1, *nested_id), 0);
+    passed &= expect("deleted thread: thread found", pond.searchQuackText("qzxv").size(), 3);
+    passed &= expect("deleted thread: nested reply ranked", requackScore(pond, *nested_id, DAY), 1);
+    const uint64_t loads = indexes->loads();
+
+    passed &= expect("deleted thread: root deleted", pond.deleteQuack(1, *root_id), true);
+    passed &= expect("deleted thread: nested reply hidden", queryInt(db_filename,
+      "SELECT COUNT(*) FROM live_tweets WHERE tid = " + std::to_string(*nested_id)), 0);
+    passed &= expect("deleted thread: thread not found", pond.searchQuackText("qzxv").size(), 0);
+    passed &= expect("deleted thread: nested reply unranked", requackScore(pond, *nested_id, DAY), 0);
+    passed &= expect("deleted thread: not reloaded", indexes->loads(), loads);
+  }
+  delete root_id;
+  delete reply_id;
+  delete nested_id;
+  return passed;
+}
+
+/**
+ * @brief Purging a deleted user takes their follows out of the follow graph and the
+ *        follower counts of name completion without reloading either.
+ */
+static bool checkPurgeKeepsIndexes(Pond& pond, const std::string& /* db_filename */) {
+  // User 1 is one of the four followers of user 6, John Flores
+  auto weight = [&]() {
+    for (const PrefixIndex::Entry& entry : pond.complete("john flores", Pond::CompletionKind::USER)) {
+      if (entry.term == "John Flores") return static_cast<int64_t>(entry.weight);
+    }
+    return int64_t(-1);
+  };
+  bool passed = expect("purge keeps indexes: user deleted", pond.deleteUser(1), true);
+  passed &= expect("purge keeps indexes: deleted follower hidden", pond.getFollowers(6).size(), 3);
+  const int64_t followers = weight();
+  const uint64_t loads = pond.getIndexes()->loads();
+
+  int64_t removed = 0;
+  int64_t purged;
+  while ((purged = pond.purgeDeleted(20, std::chrono::milliseconds(1000))) > 0) {
+    removed += purged;
+  }
+  passed &= expect("purge keeps indexes: purged", removed > 0 && purged == 0, true);
+  passed &= expect("purge keeps indexes: followers", pond.getFollowers(6).size(), 3);
+  passed &= expect("purge keeps indexes: completion weight", weight(), followers - 1);
+  passed &= expect("purge keeps indexes: not reloaded", pond.getIndexes()->loads(), loads);
+  return passed;
+}
+
+/**
+ * @brief Tenants are hosted side by side, each call reaching its own database only.
+ */
+static bool checkRegistry(Pond& /* pond */, const std::string& db_filename) {
+  const std::string other_filename = db_filename + ".other";
+  std::filesystem::copy_file(db_filename, other_filename, std::filesystem::copy_options::overwrite_existing);
+
+  bool passed = true;
+  {
+    PondRegistry registry(PondRegistry::Options{});
+    passed &= expect("registry: first tenant added", registry.add("first", db_filename), true);
+    passed &= expect("registry: second tenant added", registry.add("second", other_filename), true);
+    passed &= expect("registry: duplicate refused", registry.add("first", other_filename), false);
+    passed &= expect("registry: unknown tenant", registry.tenant("third") == nullptr, true);
+
+    AsyncPond* first = registry.tenant("first");
+    const AsyncResult<std::optional<int32_t>> posted = await(first->addQuack(1, "qzxv tenant"));
+    passed &= expect("registry: quack posted", posted.ok() && posted.value.has_value(), true);
+    passed &= expect("registry: other tenant reads", await(registry.tenant("second")->getUsername(1)).value, "Charles Small");
+    passed &= expect("registry: calls counted", registry.stats().tenants.size(), 2);
+  }
+  passed &= expect("registry: written to its tenant", queryInt(db_filename,
+    "SELECT COUNT(*) FROM tweets WHERE text = 'qzxv tenant'"), 1);
+  passed &= expect("registry: not to the other", queryInt(other_filename,
+    "SELECT COUNT(*) FROM tweets WHERE text = 'qzxv tenant'"), 0);
+  std::filesystem::remove(other_filename);
+  return passed;
+}
+
+/**
+ * @brief Connections sharing indexes see each other's posts without reloading them,
+ *        and reload them for a post made around them.
+ */
+static bool checkSharedIndexes(Pond& pond, const std::string& db_filename) {
+  Pond reader;
+  if (reader.loadDatabase(db_filename)) {
+    return expect("shared indexes: second connection opened", false, true);
+  }
+  reader.setIndexes(pond.getIndexes());
+  const std::shared_ptr<Pond::Indexes> indexes = pond.getIndexes();
+
+  bool passed = expect("shared indexes: no match yet", reader.searchQuackText("qzxv").size(), 0);
+  const uint64_t loads = indexes->loads();
+  passed &= expect("shared indexes: quack posted", post(pond, 1, "qzxv shared") != 0, true);
+  passed &= expect("shared indexes: post seen", reader.searchQuackText("qzxv").size(), 1);
+  passed &= expect("shared indexes: not reloaded", indexes->loads(), loads);
+
+  passed &= expect("shared indexes: outside post stored", execute(db_filename,
+    "INSERT INTO tweets (tid, writer_id, text, tdate, ttime, replyto_tid) "
+    "SELECT MAX(tid) + 1, 1, 'qzxv outside', date('now'), time('now'), NULL FROM tweets"), true);
+  passed &= expect("shared indexes: outside post seen", reader.searchQuackText("qzxv").size(), 2);
+  return passed;
+}
+
+/**
+ * @brief Flagging a requack as spam takes it out of the leaderboards once, from the
+ *        buckets it was counted in, and requacks keep their time of day across reloads.
+ */
+static bool checkLeaderboardAfterSpam(Pond& pond, const std::string& db_filename) {
+  const int32_t quack_id = 1;
+  const auto DAY = EngagementBoards::Window::DAY;
+  const auto WEEK = EngagementBoards::Window::WEEK;
+  const auto HOUR = EngagementBoards::Window::HOUR;
+
+  // User 2 requacked two days ago: in the weekly board but not in the daily one
+  bool passed = expect("leaderboard after spam: old requack stored", execute(db_filename,
+    "INSERT INTO retweets (tid, retweeter_id, writer_id, rdate, rtime, spam) "
+    "SELECT 1, 2, writer_id, date('now', '-2 days'), '12:00:00', 0 FROM tweets WHERE tid = 1"), true);
+  const int64_t day = requackScore(pond, quack_id, DAY);
+  const int64_t week = requackScore(pond, quack_id, WEEK);
+
+  passed &= expect("leaderboard after spam: new requack", pond.addRequack(3, quack_id), 0);
+  passed &= expect("leaderboard after spam: daily score", requackScore(pond, quack_id, DAY), day + 1);
+  for (int repeat = 0; repeat < 3; ++repeat) {
+    passed &= expect("leaderboard after spam: repeat is spam", pond.addRequack(2, quack_id), 1);
+  }
+  passed &= expect("leaderboard after spam: daily score kept", requackScore(pond, quack_id, DAY), day + 1);
+  passed &= expect("leaderboard after spam: weekly score", requackScore(pond, quack_id, WEEK), week);
+
+  Pond reloaded;
+  if (reloaded.loadDatabase(db_filename)) {
+    return expect("leaderboard after spam: database reloads", false, true);
+  }
+  passed &= expect("leaderboard after spam: hourly score after reload", requackScore(reloaded, quack_id, HOUR), 1);
+  passed &= expect("leaderboard after spam: weekly score after reload", requackScore(reloaded, quack_id, WEEK), week);
+  return passed;
+}
+
+/**
+ * @brief Text search finds fragments inside words, in any case, newest first.
+ */
+static bool checkSubstringScan(Pond& pond, const std::string& /* db_filename */) {
+  const int32_t first = post(pond, 1, "aQzXvquack inside a word");
+  const int32_t second = post(pond, 2, "QZXVQUACK shouting");
+  bool passed = expect("substring scan: quacks posted", first != 0 && second != 0, true);
+  const std::vector<Pond::Quack> found = pond.searchQuackText("zxvqua");
+  passed &= expect("substring scan: both found", found.size(), 2);
+  if (found.size() == 2) {
+    passed &= expect("substring scan: newest first", found[0].tid, second);
+  }
+  passed &= expect("substring scan: limit", pond.searchQuackText("zxvqua", 1).size(), 1);
+  passed &= expect("substring scan: no false match", pond.searchQuackText("zxvquax").size(), 0);
+  return passed;
+}
+
+/**
+ * @brief Sessions are found by their token until revoked, and logins replace plain-text
+ *        passwords with salted hashes that still match.
+ */
+static bool checkSessions(Pond& pond, const std::string& db_filename) {
+  SessionManager sessions;
+  const std::string token = sessions.create("pond", 1);
+  const std::string other = sessions.create("pond", 2);
+  bool passed = expect("sessions: tokens differ", token != other && !token.empty(), true);
+  const std::optional<SessionManager::Session> session = sessions.find(token);
+  passed &= expect("sessions: found", session.has_value() && session->user_id == 1, true);
+  passed &= expect("sessions: unknown token", sessions.find(token + "x").has_value(), false);
+  passed &= expect("sessions: revoked", sessions.revoke("pond", 1), 1);
+  passed &= expect("sessions: gone once revoked", sessions.find(token).has_value(), false);
+  passed &= expect("sessions: others kept", sessions.find(other).has_value(), true);
+
+  // User 1's password is stored as the plain text "1"
+  int32_t* user_id = pond.checkLogin(1, "1");
+  passed &= expect("sessions: plain password matched", user_id != nullptr, true);
+  delete user_id;
+  passed &= expect("sessions: password hashed", queryInt(db_filename, "SELECT pwd <> '1' FROM users WHERE usr = 1"), 1);
+  user_id = pond.checkLogin(1, "1");
+  passed &= expect("sessions: hash matched", user_id != nullptr, true);
+  delete user_id;
+  user_id = pond.checkLogin(1, "2");
+  passed &= expect("sessions: wrong password refused", user_id == nullptr, true);
+  delete user_id;
+  return passed;
+}
+
+/**
+ * @brief The JSON writer escapes strings and separates values and lines.
+ */
+static bool checkJsonWriter(Pond& pond, const std::string& /* db_filename */) {
+  JsonWriter writer;
+  writer.beginObject().key("text").value(std::string_view("say \"hi\"\n\\\x01")).key("n").value(int64_t(-42))
+        .key("list").beginArray().value(true).null().endArray().endObject();
+  writer.endLine();
+  bool passed = expect("json writer: object", writer.take(),
+                       "{\"text\":\"say \\\"hi\\\"\\n\\\\\\u0001\",\"n\":-42,\"list\":[true,null]}\n");
+
+  writer.quack(pond.getQuackFromID(1));
+  writer.endLine();
+  const std::string line = writer.take();
+  passed &= expect("json writer: quack on one line", line.find('\n') == line.size() - 1, true);
+  passed &= expect("json writer: quack id", line.find("\"tid\":1,") != std::string::npos, true);
+  return passed;
+}
+
+/**
+ * @brief Writes beyond a user's burst are rejected with the time until one more would
+ *        be admitted, without affecting other users.
+ */
+static bool checkAdmission(Pond& /* pond */, const std::string& /* db_filename */) {
+  AdmissionController::Options options;
+  options.limits[static_cast<size_t>(AdmissionController::Operation::QUACK)] = {60, 2};
+  AdmissionController admission(options);
+  const auto QUACK = AdmissionController::Operation::QUACK;
+
+  bool passed = expect("admission: first admitted", admission.admit(1, QUACK).admitted, true);
+  passed &= expect("admission: burst admitted", admission.admit(1, QUACK).admitted, true);
+  const AdmissionController::Decision rejected = admission.admit(1, QUACK);
+  passed &= expect("admission: beyond burst rejected", rejected.admitted, false);
+  passed &= expect("admission: retry within a second",
+                   rejected.retry_after.count() > 0 && rejected.retry_after.count() <= 1000, true);
+  passed &= expect("admission: other users admitted", admission.admit(2, QUACK).admitted, true);
+  passed &= expect("admission: other operations admitted",
+                   admission.admit(1, AdmissionController::Operation::FOLLOW).admitted, true);
+  passed &= expect("admission: throttled counted", admission.stats().throttled, 1);
+  passed &= expect("admission: retry described", AdmissionController::describe(std::chrono::milliseconds(1500)).empty(), false);
+  return passed;
+}
+
+/**
+ * @brief Queries parse into the canonical tree of the search language, and each kind
+ *        of term finds the quacks it should.
+ */
+static bool checkQueryLanguage(Pond& pond, const std::string& /* db_filename */) {
+  auto parsed = [](const std::string& query) { return SearchQuery::describe(SearchQuery::parse(query)); };
+  bool passed = expect("query language: implied and", parsed("duck pond"), "(duck AND pond)");
+  passed &= expect("query language: and before or", parsed("duck OR goose -pond"), "(duck OR (goose AND NOT pond))");
+  passed &= expect("query language: commas", parsed("#nice, staff"), "(#nice OR staff)");
+  passed &= expect("query language: double negation", parsed("NOT -duck"), "duck");
+  passed &= expect("query language: phrase", parsed("\"Rubber  Duck\" from:JaneDoe"), "(\"rubber duck\" AND from:janedoe)");
+  passed &= expect("query language: dates merged", parsed("since:2024-01-01 until:2024-02-29 duck"),
+                   "(since:2024-01-01 until:2024-02-29 AND duck)");
+  passed &= expect("query language: bad date is a word", parsed("since:yesterday"), "since:yesterday");
+
+  // User 1 is Charles Small
+  passed &= expect("query language: quacks posted", post(pond, 1, "qzxv rubber duck") != 0 &&
+                   post(pond, 1, "qzxv duck rubber") != 0 && post(pond, 2, "qzxv rubber duck") != 0, true);
+  passed &= expect("query language: phrase search", pond.searchForQuacks("qzxv \"rubber duck\"").size(), 2);
+  passed &= expect("query language: author by id", pond.searchForQuacks("qzxv from:1").size(), 2);
+  passed &= expect("query language: author by name", pond.searchForQuacks("qzxv from:charlessmall").size(), 2);
+  passed &= expect("query language: negated author", pond.searchForQuacks("qzxv -from:1").size(), 1);
+  passed &= expect("query language: or", pond.searchForQuacks("qzxv (from:1 OR from:2)").size(), 3);
+  passed &= expect("query language: and not", pond.searchForQuacks("qzxv AND NOT \"duck rubber\"").size(), 2);
+  passed &= expect("query language: since", pond.searchForQuacks("qzxv since:2000-01-01").size(), 3);
+  passed &= expect("query language: until", pond.searchForQuacks("qzxv until:2000-01-01").size(), 0);
+  return passed;
+}
+
+/**
+ * @brief Runs the checks.
+ *
+ * @param argc The number of command-line arguments.
+ * @param argv The path of the test database.
+ * @return The number of failed checks.
+ */
+int main(int argc, char* argv[]) {
+  if (argc != 2 || !std::filesystem::exists(argv[1])) {
+    std::cerr << "Usage: regressions <test.db>" << std::endl;
+    return 1;
+  }
+
+  const std::vector<std::pair<std::string, std::function<bool(Pond&, const std::string&)>>> checks = {
+    {"reach_read_only", checkReachReadOnly},
+    {"activity_backfill", checkActivityBackfill},
+    {"digest_escaping", checkDigestEscaping},
+    {"ranked_feed", checkRankedFeed},
+    {"mentions", checkMentions},
+    {"unread_after_delete", checkUnreadAfterDelete},
+    {"completion", checkCompletion},
+    {"fuzzy_search", checkFuzzySearch},
+    {"word_boundaries", checkWordBoundaries},
+    {"follow_graph", checkFollowGraph},
+    {"scheduler", checkScheduler},
+    {"async_calls", checkAsyncCalls},
+    {"prefetch", checkPrefetch},
+    {"batch_c_api", checkBatchCApi},
+    {"rejected_post_in_batch", checkRejectedPostInBatch},
+    {"concurrent_writes", checkConcurrentWrites},
+    {"profiler", checkProfiler},
+    {"cache_budget", checkCacheBudget},
+    {"repeated_spam_requacks", checkRepeatedSpamRequacks},
+    {"spam_retention", checkSpamRetention},
+    {"deleted_user_writes", checkDeletedUserWrites},
+    {"requack_status", checkRequackStatus},
+    {"deleted_thread", checkDeletedThread},
+    {"purge_keeps_indexes", checkPurgeKeepsIndexes},
+    {"registry", checkRegistry},
+    {"shared_indexes", checkSharedIndexes},
+    {"leaderboard_after_spam", checkLeaderboardAfterSpam},
+    {"substring_scan", checkSubstringScan},
+    {"sessions", checkSessions},
+    {"json_writer", checkJsonWriter},
+    {"admission", checkAdmission},
+    {"query_language", checkQueryLanguage},
+  };
+
+  int failed = 0;
+  for (const auto& [name, check] : checks) {
+    // Every check starts from a fresh copy of the test database, with a Pond open on it
+    const std::filesystem::path copy = std::filesystem::temp_directory_path() / ("pond_" + name + ".db");
+    std::filesystem::copy_file(argv[1], copy, std::filesystem::copy_options::overwrite_existing);
+    bool passed;
+    {
+      Pond pond;
+      passed = pond.loadDatabase(copy.string()) == SQLITE_OK ? check(pond, copy.string())
+                                                             : expect(name + ": database loads", false, true);
+    }
+    if (!passed) {
+      ++failed;
+    }
+    std::filesystem::remove(copy);
+  }
+
+  std::cout << (checks.size() - failed) << " of " << checks.size() << " checks passed" << std::endl;
+  return failed;
+}